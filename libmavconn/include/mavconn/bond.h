@@ -0,0 +1,148 @@
+/**
+ * @brief MAVConn bonded link class
+ * @file bond.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <mavconn/interface.h>
+
+namespace mavconn {
+/**
+ * @brief Several redundant links to the same remote, seen as one
+ *
+ * Frame received by more than one member is delivered once,
+ * duplicates are found by (sysid, compid, seq, msgid, checksum).
+ *
+ * Messages are sent by healthy member with lowest lag,
+ * or lowest RTT + jitter if all healthy members are probed (probe= option of member URL),
+ * critical messages (commands, mode and param changes) by all open members.
+ * Lag of member is how late its copies come after first copy of the frame.
+ *
+ * Closed member is reopened in background, bond itself stays open until close().
+ */
+class MAVConnBond : public MAVConnInterface {
+public:
+	//! Separator of member URLs in open_url()
+	static constexpr char URL_SEPARATOR = '|';
+
+	//! Member without Rx for this time is not used for Tx, if other ones are healthy [s]
+	static constexpr float HEALTH_TIMEOUT = 3.0;
+	//! Period of closed member reopen attempts [s]
+	static constexpr float REOPEN_INTERVAL = 2.0;
+	//! Copy older than that is taken as new frame with reused seq [s]
+	static constexpr float DEDUP_WINDOW = 1.0;
+
+	struct MemberStat {
+		std::string url;
+		bool open;
+		bool healthy;
+		bool active;		//!< selected for Tx
+		uint64_t rx_frames;	//!< frames delivered first by this member
+		uint64_t rx_dups;	//!< copies dropped
+		uint64_t tx_frames;
+		float lag_ms;		//!< mean delay of copies after first one
+		uint64_t reopens;
+		float rtt_ms;		//!< probed round trip, 0 - not probed
+		float jitter_ms;
+	};
+
+	/**
+	 * @param[in] urls  member URLs, opened by open_url() with bond system and component ids
+	 * @throws DeviceError if no member could be opened
+	 */
+	MAVConnBond(uint8_t system_id, uint8_t component_id, std::vector<std::string> urls);
+	~MAVConnBond();
+
+	void close() override;
+
+	void send_message(const mavlink::mavlink_message_t *message) override;
+	void send_message(const mavlink::Message &message, const uint8_t source_compid) override;
+	void send_bytes(const uint8_t *bytes, size_t length) override;
+	void add_tx_lane(TxPolicy policy, const std::vector<mavlink::msgid_t> &msgids, size_t capacity) override;
+
+	inline bool is_open() override {
+		return open_flag;
+	}
+
+	/**
+	 * Replace list of messages sent by all members.
+	 * Default: SET_MODE, PARAM_SET, COMMAND_INT, COMMAND_LONG.
+	 */
+	void set_critical_messages(const std::vector<mavlink::msgid_t> &msgids);
+
+	std::vector<MemberStat> get_members();
+
+private:
+	struct Member {
+		std::string url;
+		Ptr link;			//!< nullptr while closed, guarded by members_mutex
+
+		std::atomic<bool> open;
+		std::atomic<int64_t> last_rx_ns;	//!< steady clock
+		std::atomic<uint64_t> rx_frames, rx_dups, tx_frames, reopens;
+		float lag_ms;			//!< EWMA, guarded by rx_mutex
+		std::shared_ptr<LinkProbe> probe;	//!< of current link, guarded by rx_mutex
+	};
+
+	//! Last frame seen with given seq of one source
+	struct Seen {
+		mavlink::msgid_t msgid;
+		uint16_t checksum;
+		int64_t stamp_ns;		//!< steady clock, 0 - never
+		size_t member;
+	};
+
+	std::atomic<bool> open_flag;
+	std::vector<std::unique_ptr<Member>> members;	//!< size fixed after constructor
+	std::mutex members_mutex;
+
+	std::mutex rx_mutex;			//!< members have own IO threads
+	std::unordered_map<uint16_t, std::array<Seen, 256>> seen;
+
+	std::mutex tx_mutex;
+	std::vector<bool> critical;		//!< indexed by msgid, guarded by tx_mutex
+	struct Lane {
+		TxPolicy policy;
+		std::vector<mavlink::msgid_t> msgids;
+		size_t capacity;
+	};
+	std::vector<Lane> lanes;		//!< reapplied on reopen, guarded by members_mutex
+
+	std::thread reopen_thread;
+	std::mutex reopen_mutex;
+	std::condition_variable reopen_cond;
+
+	//! Open member link and connect callbacks
+	bool open_member(size_t idx);
+	//! Deliver frames of member @a link not seen from other members. Member IO thread.
+	void member_rx(size_t idx, MAVConnInterface *link,
+			const mavlink::mavlink_message_t *messages, const Framing *framings, size_t count);
+	void member_closed(size_t idx);
+	void do_reopen();
+
+	//! Tx member: healthy with lowest lag or RTT, else any open, SIZE_MAX if none
+	size_t select_member();
+	void send_frame(const mavlink::mavlink_message_t *message);
+	Ptr member_link(size_t idx);
+};
+}	// namespace mavconn
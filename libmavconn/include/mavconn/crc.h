@@ -0,0 +1,78 @@
+/**
+ * @brief MAVConn CRC-16/X25 kernel
+ * @file crc.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mavconn {
+namespace crc {
+
+//! Initial value of CRC-16/MCRF4XX (aka X.25 in MAVLink sources)
+static constexpr uint16_t X25_INIT = 0xffff;
+
+/**
+ * @brief Table for byte-at-a-time CRC-X25 (reflected poly 0x8408)
+ *
+ * Gives exactly the same results as mavlink crc_accumulate(),
+ * but one table lookup per byte instead of shift sequence.
+ */
+struct X25Table {
+	uint16_t t[256];
+
+	constexpr X25Table() : t{} {
+		for (size_t i = 0; i < 256; i++) {
+			uint16_t crc = i;
+			for (int bit = 0; bit < 8; bit++)
+				crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : (crc >> 1);
+			t[i] = crc;
+		}
+	}
+};
+
+//! Compile-time generated table
+static constexpr X25Table x25_table {};
+
+/**
+ * @brief Accumulate one byte into CRC
+ */
+inline uint16_t x25_accumulate(uint8_t data, uint16_t crc)
+{
+	return (crc >> 8) ^ x25_table.t[(crc ^ data) & 0xff];
+}
+
+/**
+ * @brief Accumulate buffer into CRC
+ *
+ * Inner loop unrolled by four, compiler keeps crc in register.
+ */
+inline uint16_t x25_accumulate(const uint8_t *buf, size_t len, uint16_t crc)
+{
+	for (; len >= 4; len -= 4, buf += 4) {
+		crc = (crc >> 8) ^ x25_table.t[(crc ^ buf[0]) & 0xff];
+		crc = (crc >> 8) ^ x25_table.t[(crc ^ buf[1]) & 0xff];
+		crc = (crc >> 8) ^ x25_table.t[(crc ^ buf[2]) & 0xff];
+		crc = (crc >> 8) ^ x25_table.t[(crc ^ buf[3]) & 0xff];
+	}
+	for (; len > 0; len--)
+		crc = (crc >> 8) ^ x25_table.t[(crc ^ *buf++) & 0xff];
+
+	return crc;
+}
+}	// namespace crc
+}	// namespace mavconn
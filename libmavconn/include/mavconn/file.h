@@ -0,0 +1,101 @@
+/**
+ * @brief MAVConn tlog replay link class
+ * @file file.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <mavconn/interface.h>
+#include <mavconn/tlog.h>
+
+namespace mavconn {
+
+/**
+ * @brief Replays .tlog file as received data
+ *
+ * Records are passed through parse_buffer(), so filters, recorder and
+ * callbacks see them as from real link. Receive stamps are recorded ones,
+ * so replay with same file gives same results.
+ *
+ * Sent frames are counted and discarded, or written to capture file.
+ * Link is closed at end of file.
+ */
+class MAVConnFile : public MAVConnInterface {
+public:
+	//! Replay starts after that if start() not called [sec]
+	static constexpr float DEFAULT_START_DELAY = 1.0;
+
+	/**
+	 * @param[id] path         .tlog to replay
+	 * @param[id] speed        time scale, 2.0 - twice faster, 0 - as fast as possible
+	 * @param[id] capture      .tlog for sent frames, empty - discard them
+	 * @param[id] start_delay  auto start after that, so callbacks may be set, < 0 - wait for start()
+	 */
+	MAVConnFile(uint8_t system_id = 1, uint8_t component_id = MAV_COMP_ID_UDP_BRIDGE,
+			std::string path = "", float speed = 1.0,
+			std::string capture = "", float start_delay = DEFAULT_START_DELAY);
+	~MAVConnFile();
+
+	void close() override;
+
+	void send_message(const mavlink::mavlink_message_t *message) override;
+	void send_message(const mavlink::Message &message, const uint8_t source_compid) override;
+	void send_bytes(const uint8_t *bytes, size_t length) override;
+
+	inline bool is_open() override {
+		return open_flag;
+	}
+
+	//! Begin replay now
+	void start();
+
+	//! Records replayed so far
+	inline size_t get_replayed() const {
+		return replayed.load(std::memory_order_relaxed);
+	}
+
+private:
+	FILE *fp;
+	float speed;
+	float start_delay;
+	std::shared_ptr<TlogRecorder> capture;
+
+	std::mutex tx_mutex;
+	mavlink::mavlink_status_t bytes_status;		//!< send_bytes() parser
+	mavlink::mavlink_message_t bytes_buffer;
+
+	std::atomic<bool> open_flag;
+	std::atomic<size_t> replayed;
+	std::thread rx_thread;
+
+	//! wakes replay thread on start() and close()
+	std::mutex mutex;
+	std::condition_variable cond;
+	bool started;
+
+	//! Read next record, false at end of file
+	bool read_record(uint64_t &stamp_us, uint8_t *frame, size_t &len);
+	//! Sleep until @a deadline, false if closed
+	bool wait_until(std::chrono::steady_clock::time_point deadline);
+	void capture_tx(const mavlink::mavlink_message_t &msg);
+
+	void do_replay();
+};
+}	// namespace mavconn
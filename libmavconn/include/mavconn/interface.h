@@ -23,10 +23,12 @@
 
 #include <boost/system/system_error.hpp>
 
+#include <array>
 #include <deque>
 #include <mutex>
 #include <vector>
 #include <atomic>
+#include <cerrno>
 #include <chrono>
 #include <thread>
 #include <memory>
@@ -35,6 +37,14 @@
 #include <stdexcept>
 #include <unordered_map>
 #include <mavconn/mavlink_dialect.h>
+#include <mavconn/link_probe.h>
+#include <mavconn/link_stats.h>
+#include <mavconn/rx_filter.h>
+#include <mavconn/signing.h>
+#include <mavconn/thread_sched.h>
+#include <mavconn/trace.h>
+#include <mavconn/tlog.h>
+#include <mavconn/tx_flow.h>
 
 
 namespace mavconn {
@@ -58,6 +68,19 @@ enum class Protocol : uint8_t {
 	V20 = 2		//!< MAVLink v2.0
 };
 
+//! Rx frame parser implementation
+enum class Parser : uint8_t {
+	CHAR = 0,	//!< mavlink_frame_char_buffer() state machine, byte by byte
+	BLOCK = 1	//!< block scanning parser: memchr() for STX, whole frame at once
+};
+
+//! Tx lane policy, see MAVConnInterface::add_tx_lane()
+enum class TxPolicy : uint8_t {
+	NEVER_DROP = 0,		//!< commands, mission protocol: served first, overflow throws
+	REPLACE_LATEST = 1,	//!< setpoints: queued message with same id is replaced by new one
+	DROP_OLDEST = 2		//!< streaming telemetry: oldest queued message dropped on overflow, served last
+};
+
 /**
  * @brief Common exception for communication error
  */
@@ -100,6 +123,7 @@ private:
 
 public:
 	using ReceivedCb = std::function<void (const mavlink::mavlink_message_t *message, const Framing framing)>;
+	using ReceivedBatchCb = std::function<void (const mavlink::mavlink_message_t *messages, const Framing *framings, size_t count)>;
 	using ClosedCb = std::function<void (void)>;
 	using Ptr = std::shared_ptr<MAVConnInterface>;
 	using ConstPtr = std::shared_ptr<MAVConnInterface const>;
@@ -167,6 +191,40 @@ public:
 	 */
 	virtual void send_bytes(const uint8_t *bytes, size_t length) = 0;
 
+	//! Default capacity of Tx lane.
+	static constexpr size_t DEFAULT_TX_LANE_SIZE = 100;
+
+	/**
+	 * @brief Route messages with @a msgids to own Tx lane
+	 *
+	 * Lanes are served before default queue, except DROP_OLDEST, which are served after it.
+	 * So commands are not stuck behind telemetry on saturated link.
+	 * Overflow of NEVER_DROP and REPLACE_LATEST lanes throws std::length_error as usual.
+	 *
+	 * @note Should be called before sending.
+	 */
+	virtual void add_tx_lane(TxPolicy policy, const std::vector<mavlink::msgid_t> &msgids,
+			size_t capacity = DEFAULT_TX_LANE_SIZE);
+
+	/**
+	 * @brief Throttle low priority Tx by radio feedback, see TxFlowControl
+	 *
+	 * Priority are TxShaper::DEFAULT_PRIORITY and ids of NEVER_DROP and REPLACE_LATEST lanes.
+	 * Throttled frames are dropped and counted as Tx drops.
+	 *
+	 * @note Serial, UDP and TCP client links only.
+	 */
+	void set_tx_flow_control(bool enable, const TxFlowControl::Options &opts = TxFlowControl::Options());
+
+	//! RADIO_STATUS of radio on this link
+	void tx_flow_feedback(uint8_t txbuf, uint8_t rssi, uint8_t remrssi) {
+		tx_flow.feedback(txbuf, rssi, remrssi);
+	}
+
+	TxFlowControl::Stat get_tx_flow_stat() {
+		return tx_flow.get_stat();
+	}
+
 	/**
 	 * @brief Send message and ignore possible drop due to Tx queue limit
 	 */
@@ -191,13 +249,41 @@ public:
 
 	//! Message receive callback
 	ReceivedCb message_received_cb;
+	/**
+	 * @brief Batch message receive callback
+	 *
+	 * Called once per read with contiguous arrays of all frames parsed from it.
+	 * If set, @a message_received_cb is not called.
+	 */
+	ReceivedBatchCb message_received_batch_cb;
 	//! Port closed notification callback
 	ClosedCb port_closed_cb;
 
 	virtual mavlink::mavlink_status_t get_status();
 	virtual IOStat get_iostat();
+	/**
+	 * Counters per link, message id and remote component.
+	 * Unlike get_iostat() it does not reset anything, so may be called by several users.
+	 */
+	virtual LinkStats::Snapshot get_link_stats();
 	virtual bool is_open() = 0;
 
+	/**
+	 * Set scheduling policy and CPU affinity of IO threads.
+	 *
+	 * Connection on shared pool changes all connections of that pool.
+	 *
+	 * @return 0 or errno, ENOTSUP if connection has no IO threads
+	 */
+	virtual int set_io_sched(const utils::ThreadSched &sched) {
+		return ENOTSUP;
+	}
+
+	//! Effective settings of IO threads, empty if connection has none
+	virtual std::vector<utils::ThreadSched> get_io_sched() {
+		return {};
+	}
+
 	inline uint8_t get_system_id() {
 		return sys_id;
 	}
@@ -217,14 +303,137 @@ public:
 	void set_protocol_version(Protocol pver);
 	Protocol get_protocol_version();
 
+	/**
+	 * Select Rx frame parser.
+	 *
+	 * Both parsers give same @a Framing results.
+	 * Partially received frame is dropped on switch.
+	 */
+	inline void set_parser(Parser parser) {
+		parser_type = parser;
+	}
+	inline Parser get_parser() {
+		return parser_type;
+	}
+
+	/**
+	 * Limit of bytes coalesced into one gathered write.
+	 *
+	 * Used by stream transports (serial, TCP), messages are sent
+	 * as is, only syscall count changes. 0 means one message per write.
+	 */
+	inline void set_tx_gather_bytes(size_t bytes) {
+		tx_gather_bytes = bytes;
+	}
+	inline size_t get_tx_gather_bytes() {
+		return tx_gather_bytes;
+	}
+
+	/**
+	 * Enable binary trace of Rx/Tx frames into ring of @a capacity events.
+	 * 0 disables tracing. Ring is allocated on first call and kept,
+	 * so later calls only switch tracing on and off.
+	 *
+	 * @note Does nothing if library built with -DMAVCONN_TRACE=OFF.
+	 */
+	void set_trace(size_t capacity);
+
+	/**
+	 * Receive time of frame passed to receive callback, CLOCK_REALTIME [ns].
+	 *
+	 * UDP gives kernel timestamp of datagram (SO_TIMESTAMPNS),
+	 * stream transports time of read completion.
+	 * Valid only inside @a message_received_cb or @a message_received_batch_cb,
+	 * @a index is position of frame in batch.
+	 */
+	inline uint64_t get_rx_stamp(size_t index = 0) const {
+		return m_rx_stamps[index];
+	}
+
+	//! Current CLOCK_REALTIME [ns], same clock as get_rx_stamp()
+	static inline uint64_t rx_stamp_now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+	/**
+	 * Receive filter of this link, checked by parser after frame header.
+	 * May be changed from any thread at run time.
+	 * TCP server shares it with accepted clients.
+	 */
+	inline std::shared_ptr<RxFilter> get_rx_filter() {
+		return rx_filter;
+	}
+
+	//! Trace ring, nullptr if tracing never enabled
+	inline std::shared_ptr<TraceRing> get_trace() {
+		return m_trace_storage;
+	}
+
+	/**
+	 * Record received and sent frames of this link to tlog.
+	 * nullptr stops recording. Recorder may be shared by several links,
+	 * TCP server passes it to clients accepted later.
+	 */
+	void set_recorder(std::shared_ptr<TlogRecorder> recorder);
+
+	inline std::shared_ptr<TlogRecorder> get_recorder() {
+		return std::atomic_load(&m_recorder);
+	}
+
+	/**
+	 * MAVLink 2 signing of this link: outgoing mavlink::Message frames are signed,
+	 * received frames are verified before receive callback.
+	 * Frames passed as mavlink_message_t are forwarded as is.
+	 * Set before link is used, nullptr disables signing.
+	 * TCP server gives each accepted client own state with same options.
+	 */
+	void set_signing(std::shared_ptr<MessageSigning> signing);
+
+	inline std::shared_ptr<MessageSigning> get_signing() {
+		return m_signing_storage;
+	}
+
+	/**
+	 * Active RTT probing of this link: PING from probe component id
+	 * is sent from Rx path, replies are consumed before receive callback.
+	 * Set before link is used, nullptr disables probing.
+	 * Not supported by bond, its members are probed instead.
+	 */
+	void set_link_probe(std::shared_ptr<LinkProbe> probe);
+
+	inline std::shared_ptr<LinkProbe> get_link_probe() {
+		return m_probe_storage;
+	}
+
 	/**
 	 * @brief Construct connection from URL
 	 *
 	 * Supported URL schemas:
 	 * - serial://
 	 * - udp://
+	 * - udp-s://
 	 * - tcp://
 	 * - tcp-l://
+	 * - shm://
+	 * - local:// (in-process shm://)
+	 * - file:// (tlog replay)
+	 *
+	 * Several URLs separated by '|' open redundant links as one MAVConnBond.
+	 *
+	 * Common query arguments:
+	 * - ids=sysid,compid
+	 * - parser=char|block
+	 * - gather=bytes
+	 * - batch=N (udp only, Linux)
+	 * - lane=never|latest|oldest:msgid,msgid...[:capacity]
+	 * - pool=name[:threads[:cpu,cpu...]]
+	 * - trace=N
+	 * - tlog=path[:max_file_bytes[:max_files]]
+	 * - peers=N&peer_timeout=sec (udp-s only)
+	 * - allow=msgid,msgid... or deny=msgid,msgid...
+	 * - rate=msgid:hz,msgid:hz...
+	 * - sign=keyfile[:link_id[:window_sec]]&sign_unsigned=0|1
 	 *
 	 * Please see user's documentation for details.
 	 *
@@ -247,25 +456,92 @@ protected:
 	static constexpr size_t MAX_PACKET_SIZE = MAVLINK_MAX_PACKET_LEN + 16;
 	//! Maximum count of transmission buffers.
 	static constexpr size_t MAX_TXQ_SIZE = 1000;
-
-	//! This map merge all dialect mavlink_msg_entry_t structs. Needed for packet parser.
-	static std::unordered_map<mavlink::msgid_t, const mavlink::mavlink_msg_entry_t*> message_entries;
+	//! Maximum count of buffers in one gathered write.
+	static constexpr size_t MAX_TX_IOV = 64;
+	//! Default limit of gathered write size.
+	static constexpr size_t DEFAULT_TX_GATHER_BYTES = 4096;
 
 	//! Channel number used for logging.
 	size_t conn_id;
 
+	//! Link counters, also passed to TxQueue of transport
+	LinkStats link_stats;
+
+	//! Radio feedback throttle, checked by send_message() of transport
+	TxFlowControl tx_flow;
+
+	//! @return false if frame is throttled, it is counted as drop
+	inline bool tx_flow_admit(mavlink::msgid_t msgid) {
+		if (tx_flow.admit(msgid))
+			return true;
+
+		link_stats.tx_drop();
+		return false;
+	}
+
+	//! Never nullptr, replaced only before link started
+	std::shared_ptr<RxFilter> rx_filter;
+
+	//! Active signing, nullptr - off. Owned by m_signing_storage.
+	inline MessageSigning *signing_p() {
+		return m_signing.load(std::memory_order_relaxed);
+	}
+
+	//! Send probe if due, IO thread. Transports using rx_frames() call it themselves.
+	inline void probe_poll() {
+		auto probe = m_probe.load(std::memory_order_relaxed);
+		if (probe)
+			probe_send(probe);
+	}
+
+	//! Sign frame finalized by transport itself
+	inline void sign_tx(mavlink::mavlink_message_t *msg, uint8_t crc_extra) {
+		auto signing = signing_p();
+		if (signing)
+			signing->sign(*msg, crc_extra);
+	}
+
 	inline mavlink::mavlink_status_t *get_status_p() {
 		return &m_status;
 	}
 
+	/**
+	 * Copy of status with reserved Tx sequence number.
+	 * Lets concurrent senders serialize mavlink::Message without lock.
+	 */
+	mavlink::mavlink_status_t get_tx_status();
+
 	inline mavlink::mavlink_message_t *get_buffer_p() {
 		return &m_buffer;
 	}
 
+	/**
+	 * Set receive time of data passed to next parse_buffer() or rx_frames() calls.
+	 */
+	inline void set_rx_stamp(uint64_t stamp_ns) {
+		m_rx_stamp = stamp_ns;
+	}
+
 	/**
 	 * Parse buffer and emit massage_received.
+	 *
+	 * @param[in] flush  if false batch callback is postponed until rx_flush(),
+	 *                   so several reads may be delivered as one batch.
 	 */
-	void parse_buffer(const char *pfx, uint8_t *buf, const size_t bufsize, size_t bytes_received);
+	void parse_buffer(const char *pfx, uint8_t *buf, const size_t bufsize, size_t bytes_received, bool flush = true);
+
+	/**
+	 * Deliver frames collected by parse_buffer() to message_received_batch_cb.
+	 */
+	void rx_flush(const char *pfx);
+
+	/**
+	 * Deliver already framed messages, used by transports which do not need parser.
+	 *
+	 * @a messages are passed to callbacks as is, no copy is made.
+	 * They should stay valid until return.
+	 */
+	void rx_frames(const char *pfx, mavlink::mavlink_message_t *messages, size_t count);
 
 	void iostat_tx_add(size_t bytes);
 	void iostat_rx_add(size_t bytes);
@@ -274,11 +550,115 @@ protected:
 	void log_send(const char *pfx, const mavlink::mavlink_message_t *msg);
 	void log_send_obj(const char *pfx, const mavlink::Message &msg);
 
-private:
-	friend const mavlink::mavlink_msg_entry_t* mavlink::mavlink_get_msg_entry(uint32_t msgid);
+	//! Record trace event, one atomic load if tracing is off
+	inline void trace(TraceEvent::Dir dir, mavlink::msgid_t msgid, size_t len,
+			uint8_t seq, uint8_t sysid, uint8_t compid, Framing framing = Framing::ok) {
+#ifdef MAVCONN_TRACE
+		auto ring = m_trace.load(std::memory_order_acquire);
+		if (ring == nullptr)
+			return;
+
+		auto stamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				steady_clock::now().time_since_epoch());
+
+		ring->record(TraceEvent {
+				uint64_t(stamp.count()), uint32_t(conn_id), msgid, uint16_t(len),
+				seq, sysid, compid, dir, uint8_t(framing), 0 });
+#endif
+	}
+
+	//! Trace queued frame, @a len is result of TxQueue::emplace_msg()
+	inline void trace_tx(const mavlink::mavlink_message_t *msg, size_t len) {
+		trace(len ? TraceEvent::TX : TraceEvent::TX_DROP, msg->msgid, len, msg->seq, msg->sysid, msg->compid);
+		if (len)
+			record(*msg, rx_stamp_now());
+	}
+
+	//! Append frame to tlog, one atomic load if recording is off
+	inline void record(const mavlink::mavlink_message_t &msg, uint64_t stamp_ns) {
+		if (!m_recording.load(std::memory_order_acquire))
+			return;
+
+		auto rec = std::atomic_load(&m_recorder);
+		if (rec)
+			rec->write(msg, stamp_ns);
+	}
+
+	/**
+	 * Record message queued by send_message(const mavlink::Message &).
+	 * It is serialized once more with Tx sequence @a seq, only if recording.
+	 */
+	inline void record_tx_obj(const mavlink::Message &message, uint8_t seq, uint8_t source_compid, size_t len) {
+		if (len && m_recording.load(std::memory_order_acquire))
+			record_obj(message, seq, source_compid);
+	}
 
+private:
 	mavlink::mavlink_status_t m_status;
 	mavlink::mavlink_message_t m_buffer;
+	std::atomic<uint8_t> m_tx_seq;
+
+	std::atomic<Parser> parser_type;
+	std::atomic<size_t> tx_gather_bytes;
+	Parser m_active_parser;		//!< parser used on previous parse_buffer() call, IO thread only
+
+	std::atomic<TraceRing*> m_trace;		//!< active ring, nullptr - tracing off
+	std::shared_ptr<TraceRing> m_trace_storage;
+
+	std::atomic<bool> m_recording;			//!< fast path check of m_recorder
+	std::shared_ptr<TlogRecorder> m_recorder;	//!< accessed by std::atomic_load/store
+
+	std::atomic<MessageSigning*> m_signing;
+	std::shared_ptr<MessageSigning> m_signing_storage;
+
+	std::atomic<LinkProbe*> m_probe;		//!< nullptr - probing off
+	std::shared_ptr<LinkProbe> m_probe_storage;
+
+	void probe_send(LinkProbe *probe);
+	//! @return true if @a msg is reply to own probe
+	inline bool probe_reply(const mavlink::mavlink_message_t &msg) {
+		auto probe = m_probe.load(std::memory_order_relaxed);
+		return probe && msg.msgid == mavlink::common::msg::PING::MSG_ID
+		       && probe->reply(msg, sys_id, LinkProbe::clock::now());
+	}
+
+	void record_obj(const mavlink::Message &message, uint8_t seq, uint8_t source_compid);
+
+	//! Tail of frame split between two reads (block parser)
+	std::array<uint8_t, MAVLINK_MAX_PACKET_LEN> m_rx_pending;
+	size_t m_rx_pending_len;
+
+	//! Frames parsed from current read, delivered by message_received_batch_cb
+	std::vector<mavlink::mavlink_message_t> m_rx_batch;
+	std::vector<Framing> m_rx_batch_framing;
+	std::vector<uint64_t> m_rx_batch_stamp;
+	size_t m_rx_batch_count;
+	bool m_rx_batching;
+
+	uint64_t m_rx_stamp;		//!< receive time of current read
+	const uint64_t *m_rx_stamps;	//!< stamps of frames in callback
+
+	/**
+	 * Get storage for next received frame: batch slot or @a local
+	 */
+	inline mavlink::mavlink_message_t &rx_slot(mavlink::mavlink_message_t &local) {
+		if (!m_rx_batching)
+			return local;
+
+		if (m_rx_batch_count == m_rx_batch.size()) {
+			m_rx_batch.resize(m_rx_batch_count * 2);
+			m_rx_batch_framing.resize(m_rx_batch_count * 2);
+			m_rx_batch_stamp.resize(m_rx_batch_count * 2);
+		}
+
+		return m_rx_batch[m_rx_batch_count];
+	}
+
+	void rx_commit(const char *pfx, mavlink::mavlink_message_t &message, Framing framing);
+
+	void parse_buffer_char(const char *pfx, const uint8_t *buf, size_t bytes_received);
+	void parse_buffer_block(const char *pfx, const uint8_t *buf, size_t bytes_received);
+	void parse_block(const char *pfx, const uint8_t *buf, size_t len);
 
 	std::atomic<size_t> tx_total_bytes, rx_total_bytes;
 	std::recursive_mutex iostat_mutex;
@@ -287,15 +667,5 @@ private:
 
 	//! monotonic counter (increment only)
 	static std::atomic<size_t> conn_id_counter;
-
-	//! init_msg_entry() once flag
-	static std::once_flag init_flag;
-
-	/**
-	 * Initialize message_entries map
-	 *
-	 * autogenerated. placed in mavlink_helpers.cpp
-	 */
-	static void init_msg_entry();
 };
 }	// namespace mavconn
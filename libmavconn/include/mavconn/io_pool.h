@@ -0,0 +1,105 @@
+/**
+ * @brief MAVConn IO thread pool
+ * @file io_pool.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <boost/asio.hpp>
+#include <mavconn/thread_sched.h>
+
+namespace mavconn {
+/**
+ * @brief io_service with set of threads running it.
+ *
+ * By default each connection creates private pool with one thread.
+ * Shared pool runs handlers of many connections on fixed number of threads,
+ * handlers of one connection are serialized by connection's strand.
+ *
+ * Shared pools are registered by name, see get().
+ */
+class IOPool {
+public:
+	using Ptr = std::shared_ptr<IOPool>;
+
+	/**
+	 * Start @a nthreads threads.
+	 *
+	 * @param[in] thread_name  name of threads, index appended if nthreads > 1
+	 * @param[in] cpus         pin threads to these CPUs (round robin), empty - no pinning
+	 */
+	IOPool(size_t nthreads, const std::string &thread_name, const std::vector<int> &cpus = {});
+	~IOPool();
+
+	boost::asio::io_service io_service;
+
+	inline size_t size() const {
+		return threads.size();
+	}
+
+	/**
+	 * Stop io_service and join threads.
+	 * Used by connections owning private pool.
+	 */
+	void stop();
+
+	/**
+	 * Wait until handlers already queued to @a strand finished.
+	 *
+	 * Used by connection on shared pool after closing its sockets,
+	 * so no handler uses connection after destruction.
+	 *
+	 * @note Does not wait if called from pool thread.
+	 */
+	void sync(boost::asio::io_service::strand &strand);
+
+	/**
+	 * Set scheduling policy and CPU affinity of all pool threads.
+	 *
+	 * Affects every connection on the pool. Empty @a sched.cpus keeps pinning.
+	 *
+	 * @return 0 or errno of first failed thread
+	 */
+	int set_sched(const utils::ThreadSched &sched);
+
+	//! Effective settings of each pool thread, empty after stop()
+	std::vector<utils::ThreadSched> get_sched();
+
+	/**
+	 * Find shared pool @a name or create new one.
+	 *
+	 * Pool exists while connections (or user) hold pointer to it.
+	 * @a nthreads and @a cpus used only for new pool.
+	 *
+	 * @param[in] nthreads  0 - std::thread::hardware_concurrency()
+	 */
+	static Ptr get(const std::string &name, size_t nthreads = 0, const std::vector<int> &cpus = {});
+
+private:
+	std::unique_ptr<boost::asio::io_service::work> io_work;
+	std::vector<std::thread> threads;
+	std::mutex threads_mutex;	//!< stop() vs. sched calls
+	std::once_flag stop_once;
+
+	static std::mutex registry_mutex;
+	static std::map<std::string, std::weak_ptr<IOPool>> registry;
+};
+}	// namespace mavconn
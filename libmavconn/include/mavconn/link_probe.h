@@ -0,0 +1,126 @@
+/**
+ * @brief MAVConn active link probing
+ * @file link_probe.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mavconn/mavlink_dialect.h>
+
+namespace mavconn {
+/**
+ * @brief Round trip, jitter and loss of one link, measured by PING.
+ *
+ * Broadcast PING is sent from own component id, remote answers with PING
+ * targeted to that component and same seq, so replies are told apart from
+ * other traffic and from TIMESYNC of sys_time plugin.
+ *
+ * Probes are sent from Rx path, at most one per @a interval,
+ * so there is no timer thread, and a link without Rx is not probed.
+ * poll() and reply() are called by Rx thread of the link only,
+ * estimates are atomics and may be read from any thread.
+ */
+class LinkProbe {
+public:
+	using clock = std::chrono::steady_clock;
+
+	//! Probes waiting for reply, older ones are lost
+	static constexpr size_t MAX_OUTSTANDING = 8;
+	//! MAV_COMP_ID_USER1, not used by autopilots
+	static constexpr uint8_t DEFAULT_COMPID = 25;
+
+	struct Options {
+		clock::duration interval;
+		clock::duration timeout;	//!< probe without reply is lost
+		uint8_t compid;			//!< source component of probes
+
+		Options() :
+			interval(std::chrono::seconds(1)),
+			timeout(std::chrono::seconds(3)),
+			compid(DEFAULT_COMPID)
+		{ }
+	};
+
+	struct Stats {
+		uint64_t sent;
+		uint64_t received;
+		uint64_t lost;
+		float rtt_ms;		//!< smoothed round trip, 0 - not measured yet
+		float jitter_ms;	//!< smoothed deviation of round trip
+		float rtt_min_ms;
+		float loss;		//!< smoothed lost share of probes, 0..1
+	};
+
+	explicit LinkProbe(const Options &opts = Options());
+
+	inline const Options &get_options() const {
+		return opts;
+	}
+
+	/**
+	 * Make next probe if it is due.
+	 * @return false if nothing to send now
+	 */
+	bool poll(clock::time_point now, mavlink::common::msg::PING &ping);
+
+	/**
+	 * Check received PING.
+	 * @param sysid  own system id
+	 * @return true if @a msg is reply to own probe, it should not be delivered further
+	 */
+	bool reply(const mavlink::mavlink_message_t &msg, uint8_t sysid, clock::time_point now);
+
+	Stats get_stats() const;
+
+	inline bool have_rtt() const {
+		return rtt_ms.load(std::memory_order_relaxed) > 0.0f;
+	}
+
+	/**
+	 * Request timeout from link conditions: rtt + 4 * jitter, like RFC 6298.
+	 * @return @a def while not measured, else value limited to [min, max]
+	 */
+	clock::duration timeout(clock::duration def, clock::duration min, clock::duration max) const;
+
+private:
+	struct Pending {
+		uint32_t seq;
+		clock::time_point sent;
+		bool waiting;
+	};
+
+	const Options opts;
+
+	//! Rx thread only
+	std::array<Pending, MAX_OUTSTANDING> pending;
+	uint32_t next_seq;
+	clock::time_point next_probe;
+
+	std::atomic<uint64_t> sent;
+	std::atomic<uint64_t> received;
+	std::atomic<uint64_t> lost;
+	std::atomic<float> rtt_ms;
+	std::atomic<float> jitter_ms;
+	std::atomic<float> rtt_min_ms;
+	std::atomic<float> loss;
+
+	void expire(clock::time_point now);
+	void loss_sample(float lost_);
+};
+}	// namespace mavconn
@@ -0,0 +1,134 @@
+/**
+ * @brief MAVConn link statistics
+ * @file link_stats.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <mavconn/mavlink_dialect.h>
+
+namespace mavconn {
+enum class Framing : uint8_t;
+
+/**
+ * @brief Lock-free link counters: totals, per message id and per remote component.
+ *
+ * Tables are fixed open addressing hashes, insert is done by CAS on key,
+ * so counters are updated without locks from Rx thread and senders.
+ * Message ids which do not fit in table are counted in @a OTHER_MSGID entry.
+ */
+class LinkStats {
+public:
+	static constexpr size_t MSG_SLOTS = 256;
+	static constexpr size_t PEER_SLOTS = 64;
+	//! Catch-all entry for message ids after table is full
+	static constexpr mavlink::msgid_t OTHER_MSGID = UINT32_MAX;
+
+	struct MsgStat {
+		mavlink::msgid_t msgid;
+		uint64_t rx_count;
+		uint64_t rx_bytes;
+		uint64_t tx_count;
+		uint64_t tx_bytes;
+	};
+
+	struct PeerStat {
+		uint8_t sysid;
+		uint8_t compid;
+		uint64_t rx_count;
+		uint64_t seq_lost;	//!< frames lost by sequence number gaps
+	};
+
+	struct Snapshot {
+		uint64_t rx_count;
+		uint64_t rx_bytes;
+		uint64_t tx_count;
+		uint64_t tx_bytes;
+		uint64_t crc_errors;
+		uint64_t signature_errors;
+		uint64_t seq_lost;
+		uint64_t rx_filtered;		//!< dropped by RxFilter
+		uint64_t tx_drops;		//!< overflow, DROP_OLDEST and REPLACE_LATEST drops
+		uint64_t tx_queue_high_water;	//!< max queued buffers seen by writer
+
+		std::vector<MsgStat> messages;
+		std::vector<PeerStat> peers;
+	};
+
+	LinkStats();
+
+	//! Frame size on wire
+	static size_t frame_length(const mavlink::mavlink_message_t &msg);
+
+	//! Account received frame. Rx thread only.
+	void rx_frame(const mavlink::mavlink_message_t &msg, Framing framing);
+	//! Account frame dropped by RxFilter, only header fields are used. Rx thread only.
+	void rx_filtered_frame(const mavlink::mavlink_message_t &msg);
+	//! Account queued frame. Any thread.
+	void tx_frame(mavlink::msgid_t msgid, size_t bytes);
+
+	inline void tx_drop() {
+		tx_drops.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	//! Update high-water mark. Writer only.
+	inline void tx_queue_depth(size_t depth) {
+		if (depth > tx_high_water.load(std::memory_order_relaxed))
+			tx_high_water.store(depth, std::memory_order_relaxed);
+	}
+
+	Snapshot snapshot() const;
+
+	//! Add counters of @a other to @a dst, used to sum TCP server clients
+	static void merge(Snapshot &dst, const Snapshot &other);
+
+private:
+	struct MsgSlot {
+		std::atomic<mavlink::msgid_t> msgid;
+		std::atomic<uint64_t> rx_count;
+		std::atomic<uint64_t> rx_bytes;
+		std::atomic<uint64_t> tx_count;
+		std::atomic<uint64_t> tx_bytes;
+	};
+
+	struct PeerSlot {
+		std::atomic<uint32_t> key;	//!< 0x10000 | sysid << 8 | compid, 0 - empty
+		std::atomic<uint64_t> rx_count;
+		std::atomic<uint64_t> seq_lost;
+		uint8_t last_seq;		//!< Rx thread only
+	};
+
+	static constexpr mavlink::msgid_t EMPTY_MSGID = UINT32_MAX - 1;
+
+	std::array<MsgSlot, MSG_SLOTS> msgs;
+	MsgSlot other_msgs;
+	std::array<PeerSlot, PEER_SLOTS> peers;
+
+	std::atomic<uint64_t> crc_errors;
+	std::atomic<uint64_t> signature_errors;
+	std::atomic<uint64_t> seq_lost;
+	std::atomic<uint64_t> rx_filtered;
+	std::atomic<uint64_t> tx_drops;
+	std::atomic<uint64_t> tx_high_water;
+
+	MsgSlot &msg_slot(mavlink::msgid_t msgid);
+	PeerSlot *peer_slot(uint32_t key);
+	void rx_seq(const mavlink::mavlink_message_t &msg);
+};
+}	// namespace mavconn
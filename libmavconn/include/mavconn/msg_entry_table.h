@@ -0,0 +1,183 @@
+/**
+ * @brief MAVConn compile-time message entry table
+ * @file msg_entry_table.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mavconn/mavlink_dialect.h>
+
+namespace mavconn {
+namespace msg_entry {
+
+using mavlink::mavlink_msg_entry_t;
+
+//! MESSAGE_ENTRIES array of one dialect, sorted by msgid
+struct DialectEntries {
+	const mavlink_msg_entry_t *entries;
+	size_t size;
+};
+
+static constexpr size_t PAGE_SIZE = 256;
+static constexpr size_t DIRECT_PAGES = 256;	//!< msgids below 65536 are looked up directly
+static constexpr uint16_t NONE = UINT16_MAX;
+
+/**
+ * @brief All dialects merged into one sorted array and two-level index.
+ *
+ * Page 0 is empty, so lookup of direct range is two loads without branches.
+ * Rare msgids >= 65536 are found by binary search.
+ */
+template<size_t N, size_t P>
+struct Table {
+	mavlink_msg_entry_t entries[N];
+	uint8_t page_of[DIRECT_PAGES];		//!< msgid >> 8 -> page, 0 - no entries
+	uint16_t pages[P + 1][PAGE_SIZE];	//!< msgid & 0xff -> index in entries
+
+	constexpr const mavlink_msg_entry_t *find(uint32_t msgid) const {
+		if (msgid < DIRECT_PAGES * PAGE_SIZE) {
+			auto idx = pages[page_of[msgid >> 8]][msgid & 0xff];
+			return (idx != NONE) ? &entries[idx] : nullptr;
+		}
+
+		size_t lo = 0, hi = N;
+		while (lo < hi) {
+			size_t mid = (lo + hi) / 2;
+			if (entries[mid].msgid < msgid)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		return (lo < N && entries[lo].msgid == msgid) ? &entries[lo] : nullptr;
+	}
+
+	static constexpr size_t size() {
+		return N;
+	}
+};
+
+//! @return true if every dialect is sorted by msgid
+template<size_t D>
+constexpr bool is_sorted(const DialectEntries (&dialects)[D])
+{
+	for (size_t d = 0; d < D; d++)
+		for (size_t i = 1; i < dialects[d].size; i++)
+			if (dialects[d].entries[i - 1].msgid >= dialects[d].entries[i].msgid)
+				return false;
+
+	return true;
+}
+
+/**
+ * k-way merge step: index of dialect with smallest head msgid.
+ * Ties resolved to first dialect, so entry of common wins, others skipped.
+ */
+template<size_t D>
+constexpr size_t merge_next(const DialectEntries (&dialects)[D], const size_t (&pos)[D])
+{
+	size_t best = D;
+	for (size_t d = 0; d < D; d++) {
+		if (pos[d] == dialects[d].size)
+			continue;
+		if (best == D || dialects[d].entries[pos[d]].msgid < dialects[best].entries[pos[best]].msgid)
+			best = d;
+	}
+
+	return best;
+}
+
+//! Advance all heads equal to @a msgid
+template<size_t D>
+constexpr void merge_skip(const DialectEntries (&dialects)[D], size_t (&pos)[D], uint32_t msgid)
+{
+	for (size_t d = 0; d < D; d++)
+		if (pos[d] < dialects[d].size && dialects[d].entries[pos[d]].msgid == msgid)
+			pos[d]++;
+}
+
+//! Number of unique msgids
+template<size_t D>
+constexpr size_t count_entries(const DialectEntries (&dialects)[D])
+{
+	size_t pos[D] {};
+	size_t n = 0;
+
+	for (auto d = merge_next(dialects, pos); d != D; d = merge_next(dialects, pos), n++)
+		merge_skip(dialects, pos, dialects[d].entries[pos[d]].msgid);
+
+	return n;
+}
+
+//! Number of direct pages having entries
+template<size_t D>
+constexpr size_t count_pages(const DialectEntries (&dialects)[D])
+{
+	size_t pos[D] {};
+	size_t n = 0;
+	uint32_t last_page = UINT32_MAX;
+
+	for (auto d = merge_next(dialects, pos); d != D; d = merge_next(dialects, pos)) {
+		auto msgid = dialects[d].entries[pos[d]].msgid;
+		auto page = msgid / PAGE_SIZE;
+		if (page < DIRECT_PAGES && page != last_page) {
+			last_page = page;
+			n++;
+		}
+
+		merge_skip(dialects, pos, msgid);
+	}
+
+	return n;
+}
+
+template<size_t N, size_t P, size_t D>
+constexpr Table<N, P> make_table(const DialectEntries (&dialects)[D])
+{
+	static_assert(P < 256, "page index overflow");
+	static_assert(N < NONE, "entry index overflow");
+
+	Table<N, P> t {};
+	size_t pos[D] {};
+	size_t n = 0, npages = 0;
+	uint32_t last_page = UINT32_MAX;
+
+	for (auto &page : t.pages)
+		for (auto &idx : page)
+			idx = NONE;
+
+	for (auto d = merge_next(dialects, pos); d != D; d = merge_next(dialects, pos), n++) {
+		auto &e = dialects[d].entries[pos[d]];
+		auto page = e.msgid / PAGE_SIZE;
+
+		t.entries[n] = e;
+		if (page < DIRECT_PAGES) {
+			if (page != last_page) {
+				last_page = page;
+				t.page_of[page] = ++npages;
+			}
+
+			t.pages[npages][e.msgid % PAGE_SIZE] = n;
+		}
+
+		merge_skip(dialects, pos, e.msgid);
+	}
+
+	return t;
+}
+}	// namespace msg_entry
+}	// namespace mavconn
@@ -18,52 +18,121 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
 #include <mavconn/mavlink_dialect.h>
+#include <mavconn/signing.h>
 
 namespace mavconn {
 /**
  * @brief Message buffer for internal use in libmavconn
+ *
+ * Buffers are stored in preallocated Tx queue slots (TxRing, TxLane),
+ * so no allocation happens on send.
+ *
+ * MAVLink v2 frames of mavlink::Message are finalized in place:
+ * header and payload of packed mavlink_message_t have wire layout,
+ * so message is serialized right into @a data and no second copy needed.
+ * In that case frame starts at @a off.
+ *
+ * Broadcast frame is serialized once and referenced from queues
+ * of all receivers by @a shared, each queue keeps only its write position.
+ *
+ * Signing is deferred: frame is signed by IO thread when taken for write (sign()),
+ * so signature timestamps are increasing in wire order even if concurrent senders
+ * or Tx lanes reorder frames. Shared frame is copied then, it is signed per receiver.
  */
 struct MsgBuffer {
 	//! Maximum buffer size with padding for CRC bytes (280 + padding)
 	static constexpr ssize_t MAX_SIZE = MAVLINK_MAX_PACKET_LEN + 16;
-	uint8_t data[MAX_SIZE];
+	alignas(mavlink::mavlink_message_t) uint8_t data[MAX_SIZE];
 	ssize_t len;
 	ssize_t pos;
+	ssize_t off;	//!< frame offset in data
+	std::shared_ptr<MsgBuffer> shared;	//!< immutable frame used instead of @a data
+	MessageSigning *signing;		//!< sign before write, nullptr - done or not needed
+	uint8_t crc_extra;
 
 	MsgBuffer() :
+		len(0),
 		pos(0),
-		len(0)
+		off(0),
+		signing(nullptr),
+		crc_extra(0)
 	{ }
 
+	/**
+	 * @brief Buffer referencing shared frame
+	 * @param[in] signing  sign MAVLink 2 frame before write if not nullptr
+	 */
+	explicit MsgBuffer(std::shared_ptr<MsgBuffer> frame, MessageSigning *signing = nullptr, uint8_t crc_extra = 0) :
+		len(frame->len),
+		pos(0),
+		off(0),
+		shared(std::move(frame)),
+		signing(nullptr),
+		crc_extra(0)
+	{
+		sign_later(signing, crc_extra);
+	}
+
 	/**
 	 * @brief Buffer constructor from mavlink_message_t
+	 * @param[in] signing  sign MAVLink 2 frame before write if not nullptr
 	 */
-	explicit MsgBuffer(const mavlink::mavlink_message_t *msg) :
-		pos(0)
+	explicit MsgBuffer(const mavlink::mavlink_message_t *msg, MessageSigning *signing = nullptr, uint8_t crc_extra = 0) :
+		pos(0),
+		off(0),
+		signing(nullptr),
+		crc_extra(0)
 	{
 		len = mavlink::mavlink_msg_to_send_buffer(data, msg);
 		// paranoic check, it must be less than MAVLINK_MAX_PACKET_LEN
 		assert(len < MAX_SIZE);
+		sign_later(signing, crc_extra);
 	}
 
 	/**
 	 * @brief Buffer constructor for mavlink::Message derived object.
+	 * @param[in] signing  sign MAVLink 2 frame before write if not nullptr
 	 */
-	MsgBuffer(const mavlink::Message &obj, mavlink::mavlink_status_t *status, uint8_t sysid, uint8_t compid) :
-		pos(0)
+	MsgBuffer(const mavlink::Message &obj, mavlink::mavlink_status_t *status, uint8_t sysid, uint8_t compid,
+			MessageSigning *signing = nullptr) :
+		pos(0),
+		off(0),
+		signing(nullptr),
+		crc_extra(0)
 	{
-		mavlink::mavlink_message_t msg;
-		mavlink::MsgMap map(msg);
-
 		auto mi = obj.get_message_info();
 
+		if (!inplace_ok || (status->flags & MAVLINK_STATUS_FLAG_OUT_MAVLINK1)) {
+			mavlink::mavlink_message_t msg;
+			mavlink::MsgMap map(msg);
+
+			obj.serialize(map);
+			mavlink::mavlink_finalize_message_buffer(&msg, sysid, compid, status, mi.min_length, mi.length, mi.crc_extra);
+
+			len = mavlink::mavlink_msg_to_send_buffer(data, &msg);
+			// paranoic check, it must be less than MAVLINK_MAX_PACKET_LEN
+			assert(len < MAX_SIZE);
+			sign_later(signing, mi.crc_extra);
+			return;
+		}
+
+		auto msg = new (data) mavlink::mavlink_message_t;
+		mavlink::MsgMap map(msg);
+
 		obj.serialize(map);
-		mavlink::mavlink_finalize_message_buffer(&msg, sysid, compid, status, mi.min_length, mi.length, mi.crc_extra);
+		mavlink::mavlink_finalize_message_buffer(msg, sysid, compid, status, mi.min_length, mi.length, mi.crc_extra);
 
-		len = mavlink::mavlink_msg_to_send_buffer(data, &msg);
-		// paranoic check, it must be less than MAVLINK_MAX_PACKET_LEN
-		assert(len < MAX_SIZE);
+		// finalize already put CRC right after payload
+		off = offsetof(mavlink::mavlink_message_t, magic);
+		len = MAVLINK_NUM_HEADER_BYTES + msg->len + MAVLINK_NUM_CHECKSUM_BYTES;
+		sign_later(signing, mi.crc_extra);
+
+		assert(off + len + MAVLINK_SIGNATURE_BLOCK_LEN < MAX_SIZE);
 	}
 
 	/**
@@ -71,24 +140,74 @@ struct MsgBuffer {
 	 * @param[in] nbytes should be less than MAX_SIZE
 	 */
 	MsgBuffer(const uint8_t *bytes, ssize_t nbytes) :
+		len(nbytes),
 		pos(0),
-		len(nbytes)
+		off(0),
+		signing(nullptr),
+		crc_extra(0)
 	{
 		assert(0 < nbytes && nbytes < MAX_SIZE);
 		memcpy(data, bytes, nbytes);
 	}
 
-	virtual ~MsgBuffer() {
-		pos = 0;
-		len = 0;
-	}
-
 	uint8_t *dpos() {
-		return data + pos;
+		if (shared)
+			return shared->data + shared->off + pos;
+
+		return data + off + pos;
 	}
 
 	ssize_t nbytes() {
 		return len - pos;
 	}
+
+	//! Frame length on the wire, with signature to be added by sign()
+	ssize_t tx_len() const {
+		return len + (signing ? MAVLINK_SIGNATURE_BLOCK_LEN : 0);
+	}
+
+	/**
+	 * @brief Sign deferred frame. IO thread only, right before frame is written.
+	 *
+	 * Frame taken for write is not dropped nor replaced (TxLane),
+	 * so signed timestamp is used on the wire in the order of sign() calls.
+	 */
+	void sign() {
+		if (signing == nullptr)
+			return;
+
+		if (shared) {
+			memcpy(data, shared->data + shared->off, len);
+			off = 0;
+			shared.reset();
+		}
+
+		size_t n = len;
+		signing->sign_frame(data + off, n, crc_extra);
+		len = n;
+		signing = nullptr;
+	}
+
+private:
+	//! Keep @a signing_ for sign() if frame is unsigned MAVLink 2 one
+	void sign_later(MessageSigning *signing_, uint8_t crc_extra_) {
+		const uint8_t *frame = shared ? shared->data + shared->off : data + off;
+
+		if (signing_ == nullptr || !signing_->get_options().sign_outgoing ||
+				frame[0] != MAVLINK_STX || (frame[2] & MAVLINK_IFLAG_SIGNED))
+			return;
+
+		signing = signing_;
+		crc_extra = crc_extra_;
+	}
+
+	//! v2 header (magic .. msgid) is contiguous with payload
+	static constexpr bool inplace_ok =
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		offsetof(mavlink::mavlink_message_t, payload64) - offsetof(mavlink::mavlink_message_t, magic) == MAVLINK_NUM_HEADER_BYTES &&
+		sizeof(mavlink::mavlink_message_t) <= MAX_SIZE;
+#else
+		false;
+#endif
 };
 }	// namespace mavconn
@@ -0,0 +1,94 @@
+/**
+ * @brief MAVConn message router
+ * @file router.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <vector>
+#include <mavconn/interface.h>
+
+namespace mavconn {
+/**
+ * @brief Forward frames between links by target address
+ *
+ * Router learns link of each (sysid, compid) from received frames.
+ * Then frame is forwarded:
+ *  - untargeted or target_system = 0: to all other links;
+ *  - target component seen: to its link only;
+ *  - target system seen: to links where that system was seen;
+ *  - target system never seen: to all other links, as before routing.
+ *
+ * Frame is never sent back to link it came from.
+ * Learning and lookup are lock-free, route() may be called by several IO threads.
+ */
+class Router {
+public:
+	using LinkId = size_t;
+
+	//! Links are kept in 64 bit mask
+	static constexpr size_t MAX_LINKS = 64;
+
+	struct RouteStat {
+		uint8_t sysid;
+		uint8_t compid;
+		LinkId link;
+	};
+
+	Router();
+
+	/**
+	 * Add link to route to.
+	 * @note Links should be added before first route() call.
+	 */
+	LinkId add_link(MAVConnInterface::Ptr link);
+
+	/**
+	 * Learn source of @a msg received by link @a src and forward it.
+	 * @return number of links frame sent to
+	 */
+	size_t route(LinkId src, const mavlink::mavlink_message_t *msg);
+
+	/**
+	 * Remember that (sysid, compid) lives behind @a link.
+	 */
+	void learn(LinkId link, uint8_t sysid, uint8_t compid);
+
+	/**
+	 * Mask of links where frame from @a src should be sent.
+	 */
+	uint64_t select(LinkId src, const mavlink::mavlink_message_t *msg);
+
+	/**
+	 * Get target_system and target_component fields of frame.
+	 * Trimmed (v2) or absent fields are 0.
+	 *
+	 * @return false for message without target
+	 */
+	static bool get_target(const mavlink::mavlink_message_t *msg, uint8_t &sysid, uint8_t &compid);
+
+	std::vector<RouteStat> get_routes();
+
+private:
+	std::vector<MAVConnInterface::Ptr> links;
+
+	//! links where sysid seen
+	std::array<std::atomic<uint64_t>, 256> sys_links;
+	//! sysid << 8 | compid -> link + 1, 0 - not seen
+	std::array<std::atomic<uint8_t>, 65536> comp_link;
+};
+}	// namespace mavconn
@@ -0,0 +1,105 @@
+/**
+ * @brief MAVConn receive filter
+ * @file rx_filter.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <mavconn/mavlink_dialect.h>
+
+namespace mavconn {
+/**
+ * @brief Allow/deny list of message ids with optional rate caps.
+ *
+ * Checked by parser right after frame header, so dropped frame
+ * costs no CRC, no callback and no forwarding.
+ *
+ * Lists may be changed from any thread while link is running,
+ * update is applied word by word, so few frames may see mixed old and new lists.
+ */
+class RxFilter {
+public:
+	enum class Mode : uint8_t {
+		NONE = 0,	//!< pass all
+		ALLOW = 1,	//!< pass only listed ids
+		DENY = 2,	//!< drop listed ids
+	};
+
+	//! Ids below that are in bitmap, bigger ones are looked up under lock
+	static constexpr size_t BITMAP_SIZE = 65536;
+
+	struct RateLimit {
+		mavlink::msgid_t msgid;
+		float rate_hz;		//!< max frames per second, 0 - drop all
+	};
+
+	struct Stat {
+		uint64_t dropped;	//!< by allow/deny list
+		uint64_t rate_limited;
+	};
+
+	RxFilter();
+
+	void set_mode(Mode mode, const std::vector<mavlink::msgid_t> &msgids);
+	Mode get_mode() {
+		return mode;
+	}
+
+	//! Replace all rate caps, empty vector removes them
+	void set_rate_limits(const std::vector<RateLimit> &limits);
+
+	/**
+	 * @return true if frame should be parsed. Rx thread only.
+	 */
+	inline bool accept(mavlink::msgid_t msgid) {
+		if (!active.load(std::memory_order_relaxed))
+			return true;
+
+		return accept_slow(msgid);
+	}
+
+	Stat get_stat();
+
+private:
+	using Bitmap = std::array<std::atomic<uint64_t>, BITMAP_SIZE / 64>;
+
+	struct Rate {
+		int64_t interval_ns;
+		int64_t next_ns;	//!< Rx thread only
+	};
+
+	std::atomic<bool> active;	//!< any list or cap set
+	std::atomic<Mode> mode;
+	Bitmap drop;			//!< by list
+	Bitmap limited;			//!< has rate cap
+
+	std::mutex mutex;
+	std::vector<mavlink::msgid_t> high_ids;	//!< listed ids >= BITMAP_SIZE
+	std::unordered_map<mavlink::msgid_t, Rate> rates;
+
+	std::atomic<uint64_t> dropped;
+	std::atomic<uint64_t> rate_limited;
+
+	bool accept_slow(mavlink::msgid_t msgid);
+	void update_active();
+};
+}	// namespace mavconn
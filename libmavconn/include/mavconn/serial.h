@@ -18,9 +18,13 @@
 #pragma once
 
 #include <atomic>
+#include <thread>
+#include <vector>
 #include <boost/asio.hpp>
 #include <mavconn/interface.h>
+#include <mavconn/io_pool.h>
 #include <mavconn/msgbuffer.h>
+#include <mavconn/tx_queue.h>
 
 namespace mavconn {
 /**
@@ -37,9 +41,11 @@ public:
 	 *
 	 * @param[in] device    TTY device path
 	 * @param[in] baudrate  serial baudrate
+	 * @param[in] io_pool   shared IO pool (optional), nullptr - own IO thread
 	 */
 	MAVConnSerial(uint8_t system_id = 1, uint8_t component_id = MAV_COMP_ID_UDP_BRIDGE,
-			std::string device = DEFAULT_DEVICE, unsigned baudrate = DEFAULT_BAUDRATE, bool hwflow = false);
+			std::string device = DEFAULT_DEVICE, unsigned baudrate = DEFAULT_BAUDRATE, bool hwflow = false,
+			IOPool::Ptr io_pool = nullptr);
 	~MAVConnSerial();
 
 	void close() override;
@@ -47,22 +53,91 @@ public:
 	void send_message(const mavlink::mavlink_message_t *message) override;
 	void send_message(const mavlink::Message &message, const uint8_t source_compid) override;
 	void send_bytes(const uint8_t *bytes, size_t length) override;
+	void add_tx_lane(TxPolicy policy, const std::vector<mavlink::msgid_t> &msgids, size_t capacity) override;
 
 	inline bool is_open() override {
 		return serial_dev.is_open();
 	}
+	inline int set_io_sched(const utils::ThreadSched &sched) override {
+		return io_pool->set_sched(sched);
+	}
+	inline std::vector<utils::ThreadSched> get_io_sched() override {
+		return io_pool->get_sched();
+	}
+
+	//! Upper limit for set_rx_buffer_size()
+	static constexpr size_t MAX_RX_BUF_SIZE = 64 * 1024;
+
+	//! Inter-arrival of reads since previous call
+	struct ReadStat {
+		uint64_t reads;		//!< completed reads
+		float bytes_per_read;	//!< mean read size [B]
+		float gap_avg_ms;	//!< mean time between reads [ms]
+		float gap_max_ms;	//!< max time between reads [ms]
+	};
+
+	/**
+	 * Set ASYNC_LOW_LATENCY flag of UART driver (enabled by default).
+	 * Linux only, ignored on other systems.
+	 */
+	void set_low_latency(bool enable);
+
+	/**
+	 * Set termios VMIN and VTIME (1/10 s).
+	 * Default raw mode values VMIN=1, VTIME=0 wake reader on each received byte.
+	 */
+	void set_read_timing(uint8_t vmin, uint8_t vtime);
+
+	/**
+	 * Size of read buffer, takes effect on next read.
+	 * Small buffer bounds parse latency, large one lowers syscall rate.
+	 */
+	void set_rx_buffer_size(size_t bytes);
+	inline size_t get_rx_buffer_size() {
+		return rx_buf_size;
+	}
+
+	/**
+	 * Read in dedicated thread with SCHED_FIFO @a priority instead of IO service.
+	 *
+	 * Thread takes over at next read completion and runs until close().
+	 * Priority is not changed if process lacks CAP_SYS_NICE, warning only.
+	 * Linux only.
+	 */
+	void set_rt_read_thread(int priority);
+
+	/**
+	 * Statistics of read completions.
+	 * Resets counters, so should be used by one reader (diagnostics).
+	 */
+	ReadStat get_read_stat();
 
 private:
-	boost::asio::io_service io_service;
-	std::thread io_thread;
+	IOPool::Ptr io_pool;
+	bool own_pool;
+	boost::asio::io_service::strand strand;
 	boost::asio::serial_port serial_dev;
 
-	std::atomic<bool> tx_in_progress;
-	std::deque<MsgBuffer> tx_q;
-	std::array<uint8_t, MsgBuffer::MAX_SIZE> rx_buf;
+	TxQueue tx_q;
+	std::array<boost::asio::const_buffer, MAX_TX_IOV> tx_iov;
+	std::vector<uint8_t> rx_buf;		//!< used only by current reader
+	std::atomic<size_t> rx_buf_size;
 	std::recursive_mutex mutex;
 
+	std::atomic<int> rt_priority;		//!< requested read thread priority, 0 - IO service
+	std::atomic<bool> rx_thread_run;
+	std::thread rx_thread;
+
+	std::atomic<uint64_t> rx_reads, rx_read_bytes;
+	std::atomic<uint64_t> rx_gap_sum_ns, rx_gap_max_ns;
+	steady_clock::time_point rx_last_read;
+
+	//! Stamp and account completed read of @a bytes, then parse it
+	void rx_complete(size_t bytes);
+	void stop_rx_thread();
+
 	void do_read();
-	void do_write(bool check_tx_state);
+	void do_read_thread();
+	void do_write();
 };
 }	// namespace mavconn
@@ -0,0 +1,59 @@
+/**
+ * @brief MAVConn SHA-256 for MAVLink 2 signing
+ * @file sha256.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace mavconn {
+namespace sha256 {
+
+static constexpr size_t BLOCK_SIZE = 64;
+static constexpr size_t DIGEST_SIZE = 32;
+
+using Digest = std::array<uint8_t, DIGEST_SIZE>;
+
+/**
+ * @brief Block compression function.
+ *
+ * Selected once by CPU features: SHA-NI on x86, crypto extension on ARMv8,
+ * table driven C++ otherwise.
+ */
+enum class Impl {
+	GENERIC,
+	SHA_NI,
+	ARMV8,
+};
+
+//! Hash @a len bytes of @a data
+Digest digest(const uint8_t *data, size_t len);
+
+//! Implementation used by digest()
+Impl get_impl();
+
+/**
+ * Force implementation, for tests and benchmarks.
+ * @return false if not supported by this CPU or build
+ */
+bool set_impl(Impl impl);
+
+const char *to_string(Impl impl);
+
+}	// namespace sha256
+}	// namespace mavconn
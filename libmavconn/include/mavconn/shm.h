@@ -0,0 +1,94 @@
+/**
+ * @brief MAVConn shared memory link class
+ * @file shm.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <mavconn/interface.h>
+
+namespace mavconn {
+struct SHMSegment;
+
+/**
+ * @brief Shared memory interface for processes on the same host
+ *
+ * Segment "/mavconn-<name>" holds two single-producer/single-consumer rings
+ * of mavlink_message_t, one per direction. First process attached takes
+ * side 0, second side 1, so both ends use the same URL.
+ *
+ * Sender serializes message right into ring slot, receiver passes slot
+ * to message_received_cb without copy. Sleeping receiver is woken by futex.
+ *
+ * In-process variant (local:// URL) keeps same segment in private memory, named
+ * per process, e.g. for components composed into one container.
+ *
+ * @note Linux only.
+ */
+class MAVConnSHM : public MAVConnInterface {
+public:
+	static constexpr auto DEFAULT_NAME = "mavlink";
+	//! Slots in each ring
+	static constexpr size_t RING_SLOTS = 256;
+
+	/**
+	 * @param[id] name  segment name, should be same for both ends
+	 * @param[in] in_process  segment is not shared with other processes
+	 */
+	MAVConnSHM(uint8_t system_id = 1, uint8_t component_id = MAV_COMP_ID_UDP_BRIDGE,
+			std::string name = DEFAULT_NAME, bool in_process = false);
+	~MAVConnSHM();
+
+	void close() override;
+
+	void send_message(const mavlink::mavlink_message_t *message) override;
+	void send_message(const mavlink::Message &message, const uint8_t source_compid) override;
+	void send_bytes(const uint8_t *bytes, size_t length) override;
+
+	inline bool is_open() override {
+		return open_flag;
+	}
+
+	//! Side of segment used by this end, 0 or 1
+	inline int get_side() {
+		return side;
+	}
+
+private:
+	std::string shm_name;
+	SHMSegment *seg;
+	std::shared_ptr<SHMSegment> local_seg;	//!< owner of in-process segment
+	int side;
+
+	std::atomic<bool> open_flag;
+	std::thread rx_thread;
+
+	//! serializes local senders, ring has single producer
+	std::mutex tx_mutex;
+	mavlink::mavlink_status_t bytes_status;		//!< send_bytes() parser
+	mavlink::mavlink_message_t bytes_buffer;
+
+	//! Get free Tx slot, nullptr if ring full or peer not attached. Called with tx_mutex.
+	mavlink::mavlink_message_t *tx_slot();
+	void tx_commit();
+
+	//! Release segment, it is never unmapped by close(), rx thread may still run
+	void unmap();
+	void do_recv();
+};
+}	// namespace mavconn
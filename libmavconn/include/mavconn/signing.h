@@ -0,0 +1,158 @@
+/**
+ * @brief MAVConn MAVLink 2 message signing
+ * @file signing.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <mavconn/mavlink_dialect.h>
+
+namespace mavconn {
+enum class Framing : uint8_t;
+
+/**
+ * @brief Signing and verification of MAVLink 2 frames of one link.
+ *
+ * Replaces mavlink_signing_t of mavlink_status_t:
+ * hash is done by accelerated SHA-256 (see sha256.h) over one contiguous buffer,
+ * and cheap replay and timestamp checks are done before the hash,
+ * so flood of replayed frames costs table lookup only.
+ *
+ * sign() may be called from any sender thread (timestamp is atomic),
+ * but frames queued by MsgBuffer are signed by IO thread when taken for write,
+ * so timestamps follow wire order, whatever lane the frame waited in.
+ * verify() is called by parser from Rx thread only.
+ */
+class MessageSigning {
+public:
+	using Key = std::array<uint8_t, 32>;
+
+	//! Replay table size, frames of new streams are rejected after that
+	static constexpr size_t MAX_STREAMS = 64;
+
+	struct Options {
+		Key key;
+		uint8_t link_id;
+		//! Max age of first frame of unknown stream, relative to local timestamp
+		std::chrono::seconds timestamp_window;
+		bool sign_outgoing;
+		bool accept_unsigned;		//!< pass all unsigned frames
+		std::vector<mavlink::msgid_t> unsigned_msgids;	//!< unsigned frames passed anyway
+
+		Options() :
+			key{},
+			link_id(0),
+			timestamp_window(60),
+			sign_outgoing(true),
+			accept_unsigned(false),
+			unsigned_msgids{109}	// RADIO_STATUS, injected by radio modems
+		{ }
+	};
+
+	struct Stats {
+		uint64_t tx_signed;
+		uint64_t rx_signed;		//!< good signatures
+		uint64_t bad_signature;
+		uint64_t replay;		//!< timestamp not newer than last of stream
+		uint64_t stale;			//!< new stream outside of timestamp window
+		uint64_t streams_full;		//!< new stream rejected, replay table full
+		uint64_t unsigned_rejected;
+		uint64_t unsigned_accepted;
+	};
+
+	explicit MessageSigning(const Options &opts);
+
+	inline const Options &get_options() const {
+		return opts;
+	}
+
+	/**
+	 * Sign finalized MAVLink 2 frame: set flag, update CRC and write signature.
+	 * Payload CRC bytes are written after payload, like finalize does.
+	 * MAVLink 1 frames and frames already signed are left as is.
+	 *
+	 * @param[in] crc_extra   of message, CRC is calculated again with flag set
+	 *
+	 * @return true if frame signed
+	 */
+	bool sign(mavlink::mavlink_message_t &msg, uint8_t crc_extra);
+
+	/**
+	 * Sign finalized MAVLink 2 frame in wire format, same as sign() does.
+	 * Signature is appended to the frame, buffer should have room for it.
+	 *
+	 * @param[in,out] len   frame length
+	 *
+	 * @return true if frame signed
+	 */
+	bool sign_frame(uint8_t *frame, size_t &len, uint8_t crc_extra);
+
+	/**
+	 * Check frame with good CRC.
+	 * Rx thread only.
+	 *
+	 * @return Framing::ok or Framing::bad_signature
+	 */
+	Framing verify(const mavlink::mavlink_message_t &msg);
+
+	Stats get_stats();
+
+	//! Current time as signature timestamp: 10 us units since 1 January 2015 GMT
+	static uint64_t timestamp_now();
+
+	/**
+	 * Parse key: 64 hex digits, or passphrase hashed by SHA-256
+	 * (same as MAVProxy "signing setup" does).
+	 */
+	static Key key_from_string(const std::string &str);
+
+private:
+	Options opts;
+
+	//! Last timestamp sent or seen, next sent is always bigger
+	std::atomic<uint64_t> local_ts;
+
+	//! Replay table, Rx thread only. Key is sysid << 16 | compid << 8 | link_id.
+	std::array<uint32_t, MAX_STREAMS> stream_key;
+	std::array<uint64_t, MAX_STREAMS> stream_ts;
+	size_t n_streams;
+	size_t last_stream;	//!< index of previous match, frames usually come in bursts from one stream
+
+	//! Sorted copy of unsigned_msgids
+	std::vector<mavlink::msgid_t> unsigned_ids;
+
+	std::atomic<uint64_t> tx_signed;
+	std::atomic<uint64_t> rx_signed;
+	std::atomic<uint64_t> bad_signature;
+	std::atomic<uint64_t> replay;
+	std::atomic<uint64_t> stale;
+	std::atomic<uint64_t> streams_full;
+	std::atomic<uint64_t> unsigned_rejected;
+	std::atomic<uint64_t> unsigned_accepted;
+
+	uint64_t next_timestamp();
+	size_t find_stream(uint32_t key);
+	Framing verify_unsigned(const mavlink::mavlink_message_t &msg);
+
+	//! First 6 bytes of SHA-256(key | header | payload | CRC | link_id, timestamp)
+	void calc_signature(const mavlink::mavlink_message_t &msg, const uint8_t *sig7, uint8_t *out);
+};
+}	// namespace mavconn
@@ -22,7 +22,9 @@
 #include <cstring>
 #include <boost/asio.hpp>
 #include <mavconn/interface.h>
+#include <mavconn/io_pool.h>
 #include <mavconn/msgbuffer.h>
+#include <mavconn/tx_queue.h>
 
 
 namespace mavconn {
@@ -41,14 +43,16 @@ public:
 	 * Create generic TCP client (connect to the server)
 	 * @param[id] server_addr    remote host
 	 * @param[id] server_port    remote port
+	 * @param[id] io_pool        shared IO pool (optional), nullptr - own IO thread
 	 */
 	MAVConnTCPClient(uint8_t system_id = 1, uint8_t component_id = MAV_COMP_ID_UDP_BRIDGE,
-			std::string server_host = DEFAULT_SERVER_HOST, unsigned short server_port = DEFAULT_SERVER_PORT);
+			std::string server_host = DEFAULT_SERVER_HOST, unsigned short server_port = DEFAULT_SERVER_PORT,
+			IOPool::Ptr io_pool = nullptr);
 	/**
 	 * Special client variation for use in MAVConnTCPServer
 	 */
 	explicit MAVConnTCPClient(uint8_t system_id, uint8_t component_id,
-			boost::asio::io_service &server_io);
+			IOPool::Ptr server_pool);
 	~MAVConnTCPClient();
 
 	void close() override;
@@ -56,24 +60,31 @@ public:
 	void send_message(const mavlink::mavlink_message_t *message) override;
 	void send_message(const mavlink::Message &message, const uint8_t source_compid) override;
 	void send_bytes(const uint8_t *bytes, size_t length) override;
+	void add_tx_lane(TxPolicy policy, const std::vector<mavlink::msgid_t> &msgids, size_t capacity) override;
 
 	inline bool is_open() override {
 		return socket.is_open();
 	}
+	inline int set_io_sched(const utils::ThreadSched &sched) override {
+		return io_pool->set_sched(sched);
+	}
+	inline std::vector<utils::ThreadSched> get_io_sched() override {
+		return io_pool->get_sched();
+	}
 
 private:
 	friend class MAVConnTCPServer;
-	boost::asio::io_service io_service;
-	std::unique_ptr<boost::asio::io_service::work> io_work;
-	std::thread io_thread;
+	IOPool::Ptr io_pool;
+	bool own_pool;
+	boost::asio::io_service::strand strand;
 
 	boost::asio::ip::tcp::socket socket;
 	boost::asio::ip::tcp::endpoint server_ep;
 
 	std::atomic<bool> is_destroying;
 
-	std::atomic<bool> tx_in_progress;
-	std::deque<MsgBuffer> tx_q;
+	TxQueue tx_q;
+	std::array<boost::asio::const_buffer, MAX_TX_IOV> tx_iov;
 	std::array<uint8_t, MsgBuffer::MAX_SIZE> rx_buf;
 	std::recursive_mutex mutex;
 
@@ -82,8 +93,16 @@ private:
 	 */
 	void client_connected(size_t server_channel);
 
+	/**
+	 * Queue frame serialized by server and shared with other clients.
+	 * @param[in] crc_extra  sign frame with signing of this client, if set
+	 * @return false on Tx queue overflow
+	 */
+	bool send_frame(const mavlink::mavlink_message_t *message, const std::shared_ptr<MsgBuffer> &frame,
+			int crc_extra = -1);
+
 	void do_recv();
-	void do_send(bool check_tx_state);
+	void do_send();
 };
 
 /**
@@ -100,9 +119,12 @@ public:
 	/**
 	 * @param[id] server_addr    bind host
 	 * @param[id] server_port    bind port
+	 * @param[id] io_pool        shared IO pool (optional), nullptr - own IO thread.
+	 *                           Accepted clients use the same pool.
 	 */
 	MAVConnTCPServer(uint8_t system_id = 1, uint8_t component_id = MAV_COMP_ID_UDP_BRIDGE,
-			std::string bind_host = DEFAULT_BIND_HOST, unsigned short bind_port = DEFAULT_BIND_PORT);
+			std::string bind_host = DEFAULT_BIND_HOST, unsigned short bind_port = DEFAULT_BIND_PORT,
+			IOPool::Ptr io_pool = nullptr);
 	~MAVConnTCPServer();
 
 	void close() override;
@@ -110,17 +132,25 @@ public:
 	void send_message(const mavlink::mavlink_message_t *message) override;
 	void send_message(const mavlink::Message &message, const uint8_t source_compid) override;
 	void send_bytes(const uint8_t *bytes, size_t length) override;
+	void add_tx_lane(TxPolicy policy, const std::vector<mavlink::msgid_t> &msgids, size_t capacity) override;
 
 	mavlink::mavlink_status_t get_status() override;
 	IOStat get_iostat() override;
+	LinkStats::Snapshot get_link_stats() override;
 	inline bool is_open() override {
 		return acceptor.is_open();
 	}
+	inline int set_io_sched(const utils::ThreadSched &sched) override {
+		return io_pool->set_sched(sched);
+	}
+	inline std::vector<utils::ThreadSched> get_io_sched() override {
+		return io_pool->get_sched();
+	}
 
 private:
-	boost::asio::io_service io_service;
-	std::unique_ptr<boost::asio::io_service::work> io_work;
-	std::thread io_thread;
+	IOPool::Ptr io_pool;
+	bool own_pool;
+	boost::asio::io_service::strand strand;
 
 	boost::asio::ip::tcp::acceptor acceptor;
 	boost::asio::ip::tcp::endpoint bind_ep;
@@ -130,10 +160,24 @@ private:
 	std::list<std::shared_ptr<MAVConnTCPClient> > client_list;
 	std::recursive_mutex mutex;
 
+	//! lanes applied to accepted clients
+	struct TxLaneConfig {
+		TxPolicy policy;
+		std::vector<mavlink::msgid_t> msgids;
+		size_t capacity;
+	};
+	std::vector<TxLaneConfig> tx_lanes;
+
 	void do_accept();
 
+	/**
+	 * Serialize once and queue to all clients. Called with mutex held.
+	 * @param[in] crc_extra  frame is signed by each client, -1 - sent as is
+	 */
+	void broadcast(const mavlink::mavlink_message_t *message, int crc_extra = -1);
+
 	// client slots
 	void client_closed(std::weak_ptr<MAVConnTCPClient> weak_instp);
-	void recv_message(const mavlink::mavlink_message_t *message, const Framing framing);
+	void recv_message_batch(const mavlink::mavlink_message_t *messages, const Framing *framings, size_t count);
 };
 }	// namespace mavconn
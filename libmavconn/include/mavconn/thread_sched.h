@@ -0,0 +1,88 @@
+/**
+ * @brief MAVConn thread scheduling and CPU affinity
+ * @file thread_sched.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+namespace mavconn {
+namespace utils {
+/**
+ * @brief Scheduling policy, priority and CPU affinity of a thread.
+ *
+ * Text form, used by URL query and parameters: "fifo:50", "rr:10", "other",
+ * CPU list: "2,3" or "0-3,6".
+ */
+struct ThreadSched {
+	enum class Policy {
+		OTHER,	//!< SCHED_OTHER, kernel default
+		FIFO,	//!< SCHED_FIFO
+		RR,	//!< SCHED_RR
+	};
+
+	Policy policy;
+	int priority;		//!< 1..99 for FIFO and RR
+	std::vector<int> cpus;	//!< affinity mask, empty - any CPU
+
+	ThreadSched() :
+		policy(Policy::OTHER),
+		priority(0)
+	{ }
+
+	//! nothing to change
+	inline bool empty() const {
+		return policy == Policy::OTHER && cpus.empty();
+	}
+
+	/**
+	 * Parse text form
+	 *
+	 * @throws std::invalid_argument
+	 */
+	static ThreadSched parse(const std::string &policy, const std::string &cpus = "");
+	static std::vector<int> parse_cpus(const std::string &cpus);
+
+	std::string to_string() const;
+};
+
+/**
+ * Set scheduling and affinity of thread @a th
+ *
+ * @return 0 or errno, e.g. EPERM without CAP_SYS_NICE
+ */
+int set_thread_sched(pthread_t th, const ThreadSched &sched);
+
+//! Effective scheduling and affinity of thread @a th
+ThreadSched get_thread_sched(pthread_t th);
+
+inline int set_this_thread_sched(const ThreadSched &sched) {
+	return set_thread_sched(pthread_self(), sched);
+}
+
+/**
+ * Lock current and future pages of the process in RAM (mlockall)
+ *
+ * @return 0 or errno, e.g. ENOMEM when over RLIMIT_MEMLOCK
+ */
+int lock_process_memory();
+
+//! Pages of the process are locked by lock_process_memory()
+bool is_process_memory_locked();
+}	// namespace utils
+}	// namespace mavconn
@@ -0,0 +1,128 @@
+/**
+ * @brief MAVConn tlog recorder
+ * @file tlog.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <cstdint>
+#include <mavconn/mavlink_dialect.h>
+
+namespace mavconn {
+
+/**
+ * @brief Records raw frames to .tlog files.
+ *
+ * Each record is big endian receive time [us since epoch] followed by
+ * frame bytes, as written by QGroundControl and MAVProxy.
+ *
+ * Writers only copy record into preallocated mmap()ed ring, background
+ * thread writes it to file. If ring is full record is dropped, IO threads
+ * never wait for disk.
+ *
+ * May be shared by several links.
+ */
+class TlogRecorder {
+public:
+	static constexpr size_t DEFAULT_RING_BYTES = 4 * 1024 * 1024;
+	//! Ring is written out at least that often
+	static constexpr std::chrono::milliseconds FLUSH_PERIOD { 200 };
+
+	struct Options {
+		std::string path;	//!< file, numbered before extension when rotating
+		size_t ring_bytes;
+		size_t max_file_bytes;	//!< rotate when file would grow above, 0 - one file
+		size_t max_files;	//!< rotated files kept, older removed, 0 - keep all
+
+		explicit Options(std::string path_ = "") :
+			path(path_),
+			ring_bytes(DEFAULT_RING_BYTES),
+			max_file_bytes(0),
+			max_files(0)
+		{ }
+	};
+
+	/**
+	 * Opens first file and starts writer thread.
+	 * Throws std::system_error if file could not be created.
+	 */
+	explicit TlogRecorder(const Options &opts);
+
+	//! Writes out rest of ring
+	~TlogRecorder();
+
+	TlogRecorder(const TlogRecorder &) = delete;
+	TlogRecorder &operator=(const TlogRecorder &) = delete;
+
+	/**
+	 * Append record, any thread.
+	 * @return false if ring is full and record dropped
+	 */
+	bool write(uint64_t stamp_us, const uint8_t *frame, size_t len);
+
+	//! Append mavlink frame, @a stamp_ns is CLOCK_REALTIME [ns]
+	bool write(const mavlink::mavlink_message_t &msg, uint64_t stamp_ns);
+
+	//! Wait until records appended before call are written to file
+	void flush();
+
+	//! Records dropped on ring overflow
+	inline uint64_t get_dropped() const {
+		return dropped.load(std::memory_order_relaxed);
+	}
+
+	//! Bytes written to files
+	inline uint64_t get_written_bytes() const {
+		return written_bytes.load(std::memory_order_relaxed);
+	}
+
+	//! Name of rotated file @a index
+	static std::string file_name(const Options &opts, size_t index);
+
+private:
+	Options opts;
+
+	uint8_t *ring;
+	size_t ring_size;	//!< mapping size, page aligned
+
+	std::mutex mutex;
+	std::condition_variable cond;		//!< wakes writer thread
+	std::condition_variable flushed_cond;	//!< wakes flush() callers
+	uint64_t head;			//!< bytes appended, ring position is head % ring_size
+	uint64_t tail;			//!< bytes written out
+	uint64_t file_bytes_queued;	//!< bytes appended to current file, including written
+	std::deque<uint64_t> rotate_marks;	//!< ring positions where next file starts
+	bool flush_requested;
+	bool stop;
+
+	std::atomic<uint64_t> dropped;
+	std::atomic<uint64_t> written_bytes;
+
+	int fd;
+	size_t file_index;
+	std::thread writer;
+
+	void open_file();
+	void write_file(uint64_t from, uint64_t to);
+	void writer_loop();
+};
+}	// namespace mavconn
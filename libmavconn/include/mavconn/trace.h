@@ -0,0 +1,92 @@
+/**
+ * @brief MAVConn binary frame trace
+ * @file trace.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace mavconn {
+
+/**
+ * @brief One traced frame, 24 bytes.
+ *
+ * Dump file is "MVTRACE1" magic followed by raw events in host byte order.
+ */
+struct TraceEvent {
+	enum Dir : uint8_t {
+		RX = 0,
+		TX = 1,
+		TX_DROP = 2,	//!< Tx queue overflow
+	};
+
+	uint64_t stamp_ns;	//!< steady_clock time
+	uint32_t conn_id;
+	uint32_t msgid;
+	uint16_t len;		//!< frame length on wire, 0 for dropped
+	uint8_t seq;
+	uint8_t sysid;
+	uint8_t compid;
+	uint8_t dir;		//!< @a Dir
+	uint8_t framing;	//!< @a Framing value of received frame
+	uint8_t reserved;
+};
+
+static_assert(sizeof(TraceEvent) == 24, "TraceEvent layout");
+
+/**
+ * @brief Lock-free ring of last trace events.
+ *
+ * Any thread may record, oldest events are overwritten.
+ * Each slot is guarded by its own sequence number, so dump() skips slots
+ * which are being written instead of waiting for writers.
+ */
+class TraceRing {
+public:
+	//! @param[in] capacity  rounded up to power of two
+	explicit TraceRing(size_t capacity);
+
+	inline size_t capacity() const {
+		return mask + 1;
+	}
+
+	void record(const TraceEvent &ev);
+
+	//! Copy of stored events, oldest first
+	std::vector<TraceEvent> dump() const;
+
+	//! Write dump() to file @a path. @return false on IO error
+	bool dump_file(const std::string &path) const;
+
+	static constexpr const char *FILE_MAGIC = "MVTRACE1";
+
+private:
+	static constexpr size_t WORDS = sizeof(TraceEvent) / sizeof(uint64_t);
+
+	struct Slot {
+		std::atomic<uint64_t> ver;	//!< 2*pos+1 - writing, 2*pos+2 - event of pos is stored
+		std::atomic<uint64_t> words[WORDS];
+	};
+
+	size_t mask;
+	std::unique_ptr<Slot[]> slots;
+	std::atomic<uint64_t> head;
+};
+}	// namespace mavconn
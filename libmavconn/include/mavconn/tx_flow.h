@@ -0,0 +1,112 @@
+/**
+ * @brief MAVConn radio feedback flow control
+ * @file tx_flow.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+#include <mavconn/mavlink_dialect.h>
+
+namespace mavconn {
+/**
+ * @brief Throttles low priority Tx by radio buffer feedback.
+ *
+ * RADIO_STATUS txbuf (free buffer, percent) below low mark halves admitted
+ * share of low priority frames, above high mark share grows by step
+ * (AIMD, like MAVProxy and QGC do for SiK radios). Low RSSI on either side
+ * holds the share. Without feedback for @a timeout share is restored.
+ *
+ * Priority ids and ids routed to NEVER_DROP/REPLACE_LATEST lanes are always admitted.
+ * Frames are admitted by fractional credit, so throttled stream keeps even spacing.
+ *
+ * One atomic load if feedback never arrived.
+ */
+class TxFlowControl {
+public:
+	using steady_clock = std::chrono::steady_clock;
+
+	struct Options {
+		uint8_t txbuf_low;	//!< [%] decrease below
+		uint8_t txbuf_high;	//!< [%] increase above
+		uint8_t rssi_low;	//!< raw RSSI, 0 - not used
+		float min_share;	//!< admitted share floor
+		float increase;		//!< share step per feedback
+		steady_clock::duration timeout;
+
+		Options() :
+			txbuf_low(30),
+			txbuf_high(70),
+			rssi_low(0),
+			min_share(0.1f),
+			increase(0.1f),
+			timeout(std::chrono::seconds(5))
+		{ }
+	};
+
+	struct Stat {
+		uint64_t admitted;
+		uint64_t throttled;
+		float share;		//!< current admitted share of low priority frames
+		uint8_t txbuf;		//!< last feedback
+	};
+
+	TxFlowControl();
+
+	/**
+	 * Set options and priority ids, resets state. Any thread.
+	 * @param enable  false - everything is admitted, feedback ignored
+	 */
+	void configure(bool enable, const Options &opts,
+			const std::vector<mavlink::msgid_t> &priority);
+
+	//! Add ids which are never throttled, e.g. of lane, kept by configure()
+	void add_priority(const std::vector<mavlink::msgid_t> &msgids);
+
+	//! RADIO_STATUS values
+	void feedback(uint8_t txbuf, uint8_t rssi, uint8_t remrssi,
+			steady_clock::time_point now = steady_clock::now());
+
+	//! @return false if frame should be dropped
+	inline bool admit(mavlink::msgid_t msgid) {
+		if (!active.load(std::memory_order_acquire))
+			return true;
+
+		return admit_slow(msgid, steady_clock::now());
+	}
+
+	bool admit_slow(mavlink::msgid_t msgid, steady_clock::time_point now);
+
+	Stat get_stat();
+
+private:
+	std::mutex mutex;
+	std::atomic<bool> enabled;
+	std::atomic<bool> active;	//!< enabled and throttling
+	Options opts;
+	std::unordered_set<mavlink::msgid_t> priority;
+	std::vector<mavlink::msgid_t> lane_priority;
+
+	float share;
+	float credit;
+	steady_clock::time_point last_feedback;
+	Stat stat;
+};
+}	// namespace mavconn
@@ -0,0 +1,209 @@
+/**
+ * @brief MAVConn Tx queue with priority lanes
+ * @file tx_queue.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <mavconn/interface.h>
+#include <mavconn/link_stats.h>
+#include <mavconn/tx_ring.h>
+
+namespace mavconn {
+/**
+ * @brief Bounded Tx lane with overflow policy.
+ *
+ * Lanes carry selected messages only (commands, setpoints),
+ * so plain mutex is used. Buffers are preallocated,
+ * queue order is kept as slot indexes, so drop and replace do not copy buffers.
+ *
+ * Buffers given to consumer by front()/gather() are not dropped nor replaced
+ * until consume() is called.
+ */
+class TxLane {
+public:
+	TxLane(TxPolicy policy, size_t capacity, LinkStats *stats = nullptr);
+
+	const TxPolicy policy;
+
+	/**
+	 * @brief Construct MsgBuffer according to lane policy. Any thread.
+	 * @return frame length, 0 on overflow
+	 */
+	template<typename ... Args>
+	size_t emplace(mavlink::msgid_t msgid, Args && ... args) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		size_t idx;
+		size_t locked = locked_count();
+		bool replace = false;
+
+		if (policy == TxPolicy::REPLACE_LATEST) {
+			for (size_t i = locked; i < count && !replace; i++) {
+				idx = slot_at(i);
+				replace = pool_msgid[idx] == msgid;
+			}
+		}
+
+		if (!replace) {
+			if (count == order.size()) {
+				if (policy != TxPolicy::DROP_OLDEST || locked == count)
+					return 0;
+
+				free_slots.push_back(slot_at(locked));
+				remove_at(locked);
+				if (stats)
+					stats->tx_drop();
+			}
+
+			idx = free_slots.back();
+			free_slots.pop_back();
+			order[(head + count) % order.size()] = idx;
+			count++;
+		}
+		else if (stats) {
+			// replaced message never sent
+			stats->tx_drop();
+		}
+
+		pool[idx].~MsgBuffer();
+		new (&pool[idx]) MsgBuffer(std::forward<Args>(args)...);
+		pool_msgid[idx] = msgid;
+		return pool[idx].tx_len();
+	}
+
+	bool empty();
+	size_t size();
+	MsgBuffer *front();
+	MsgBuffer *partial();
+	size_t gather(boost::asio::const_buffer *iov, size_t max_iov, size_t max_bytes);
+	void consume(size_t bytes);
+
+private:
+	LinkStats *stats;
+	std::mutex mutex;
+	std::vector<MsgBuffer> pool;
+	std::vector<mavlink::msgid_t> pool_msgid;
+	std::vector<uint16_t> free_slots;
+	std::vector<uint16_t> order;	//!< ring of pool indexes
+	size_t head;
+	size_t count;
+	size_t inflight;		//!< front entries given to consumer
+
+	inline uint16_t slot_at(size_t i) {
+		return order[(head + i) % order.size()];
+	}
+
+	//! entries which must stay in place
+	inline size_t locked_count() {
+		if (inflight == 0 && count > 0 && pool[slot_at(0)].pos > 0)
+			return 1;
+		return inflight;
+	}
+
+	void remove_at(size_t i);
+};
+
+/**
+ * @brief Tx queue of connection: default lock-free ring plus optional lanes.
+ *
+ * Service order: NEVER_DROP and REPLACE_LATEST lanes (in order of add_lane()),
+ * then default ring, then DROP_OLDEST lanes.
+ * Partially written buffer is always finished before lane switch.
+ *
+ * Consumer interface is the same as of TxRing:
+ * need_wakeup(), next(), gather(), consume().
+ * Buffers are signed when next() or gather() gives them for write,
+ * so frames of a signed link leave in timestamp order.
+ */
+class TxQueue {
+public:
+	/**
+	 * @param[in] stats  drops, high-water mark and Tx per message counters, optional
+	 */
+	explicit TxQueue(size_t capacity, LinkStats *stats = nullptr);
+
+	/**
+	 * @brief Route @a msgids to new lane.
+	 * @note Not thread safe, should be called before sending.
+	 */
+	void add_lane(TxPolicy policy, const std::vector<mavlink::msgid_t> &msgids, size_t capacity);
+
+	//! Put to default ring (send_bytes())
+	template<typename ... Args>
+	bool emplace(Args && ... args) {
+		if (ring.emplace(std::forward<Args>(args)...) > 0)
+			return true;
+
+		if (stats)
+			stats->tx_drop();
+		return false;
+	}
+
+	/**
+	 * Put to lane selected by @a msgid
+	 * @return frame length, 0 if queue is full
+	 */
+	template<typename ... Args>
+	size_t emplace_msg(mavlink::msgid_t msgid, Args && ... args) {
+		size_t len = 0;
+		auto it = lane_map.end();
+
+		if (!lane_map.empty())
+			it = lane_map.find(msgid);
+
+		if (it != lane_map.end())
+			len = it->second->emplace(msgid, std::forward<Args>(args)...);
+		else
+			len = ring.emplace(std::forward<Args>(args)...);
+
+		if (stats) {
+			if (len > 0)
+				stats->tx_frame(msgid, len);
+			else
+				stats->tx_drop();
+		}
+
+		return len;
+	}
+
+	//! @return true if caller should start consumer
+	bool need_wakeup() {
+		return !busy.exchange(true);
+	}
+
+	MsgBuffer *next();
+	size_t gather(boost::asio::const_buffer *iov, size_t max_iov, size_t max_bytes);
+	void consume(size_t bytes);
+
+private:
+	LinkStats *stats;
+	TxRing ring;
+	std::vector<std::unique_ptr<TxLane>> high_lanes;
+	std::vector<std::unique_ptr<TxLane>> low_lanes;
+	std::unordered_map<mavlink::msgid_t, TxLane *> lane_map;
+	std::atomic<bool> busy;
+
+	TxLane *current;	//!< lane of last next(), nullptr - ring
+
+	MsgBuffer *pick();
+	bool empty();
+	void update_high_water();
+};
+}	// namespace mavconn
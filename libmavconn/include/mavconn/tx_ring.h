@@ -0,0 +1,250 @@
+/**
+ * @brief MAVConn Tx ring
+ * @file tx_ring.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <new>
+#include <utility>
+#include <cstdint>
+#include <boost/asio/buffer.hpp>
+#include <mavconn/msgbuffer.h>
+
+namespace mavconn {
+/**
+ * @brief ConstBufferSequence over part of caller's array.
+ *
+ * Unlike std::vector it does not allocate when async operation copies it.
+ */
+struct ConstBufferRange {
+	using value_type = boost::asio::const_buffer;
+	using const_iterator = const boost::asio::const_buffer *;
+
+	const_iterator first;
+	const_iterator last;
+
+	const_iterator begin() const {
+		return first;
+	}
+	const_iterator end() const {
+		return last;
+	}
+};
+
+/**
+ * @brief Bounded multi-producer single-consumer queue of MsgBuffer slots.
+ *
+ * All slots are preallocated, so send_message() does not allocate.
+ * Each slot carries sequence number (D. Vyukov's bounded queue):
+ * producers claim a slot by CAS on head, consumer (IO thread) owns tail.
+ *
+ * Consumer wakeup is done once per burst: only producer which
+ * found ring idle (need_wakeup() returns true) should post writer to IO thread,
+ * writer then drains ring by next() until it returns nullptr.
+ *
+ * @note Capacity is not required to be power of two,
+ *       so it is exactly MAX_TXQ_SIZE like old std::deque limit.
+ */
+class TxRing {
+public:
+	static constexpr size_t CACHE_LINE = 64;
+
+	explicit TxRing(size_t capacity_) :
+		capacity(capacity_),
+		head(0),
+		busy(false),
+		tail(0)
+	{
+		// over-aligned new is C++17, so align slot array by hand
+		storage.reset(new uint8_t[capacity * sizeof(Slot) + CACHE_LINE]);
+		auto addr = reinterpret_cast<uintptr_t>(storage.get());
+		slots = reinterpret_cast<Slot *>((addr + CACHE_LINE - 1) & ~uintptr_t(CACHE_LINE - 1));
+
+		for (size_t i = 0; i < capacity; i++)
+			new (&slots[i]) Slot(i);
+	}
+
+	~TxRing() {
+		for (size_t i = 0; i < capacity; i++)
+			slots[i].~Slot();
+	}
+
+	TxRing(const TxRing &) = delete;
+	TxRing &operator=(const TxRing &) = delete;
+
+	/**
+	 * @brief Construct MsgBuffer in free slot. Any thread.
+	 * @return frame length, 0 if ring is full
+	 */
+	template<typename ... Args>
+	size_t emplace(Args && ... args) {
+		Slot *slot;
+		size_t pos = head.load(std::memory_order_relaxed);
+
+		for (;;) {
+			slot = &slots[pos % capacity];
+			size_t seq = slot->seq.load(std::memory_order_acquire);
+			intptr_t diff = intptr_t(seq) - intptr_t(pos);
+
+			if (diff == 0) {
+				if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+				return 0;
+			else
+				pos = head.load(std::memory_order_relaxed);
+		}
+
+		slot->buf.~MsgBuffer();
+		new (&slot->buf) MsgBuffer(std::forward<Args>(args)...);
+		size_t len = slot->buf.tx_len();
+		slot->seq.store(pos + 1, std::memory_order_release);
+		return len;
+	}
+
+	/**
+	 * @brief Mark ring busy after emplace(). Any thread.
+	 * @return true if caller should start consumer
+	 */
+	bool need_wakeup() {
+		return !busy.exchange(true);
+	}
+
+	/**
+	 * @brief Buffer to write or nullptr if ring drained. Consumer only.
+	 *
+	 * On nullptr ring is marked idle, and consumer should stop.
+	 */
+	MsgBuffer *next() {
+		auto buf = front();
+		if (buf != nullptr)
+			return buf;
+
+		busy = false;
+		// producer could publish right before busy cleared and skip wakeup
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (front() == nullptr || busy.exchange(true))
+			return nullptr;
+
+		return front();
+	}
+
+	/**
+	 * @brief Number of claimed slots. Consumer only.
+	 */
+	size_t size() {
+		return head.load(std::memory_order_relaxed) - tail;
+	}
+
+	/**
+	 * @brief Oldest published buffer or nullptr. Consumer only.
+	 */
+	MsgBuffer *front() {
+		Slot &slot = slots[tail % capacity];
+		if (slot.seq.load(std::memory_order_acquire) != tail + 1)
+			return nullptr;
+
+		return &slot.buf;
+	}
+
+	/**
+	 * @brief Fill @a iov with published buffers for gathered write. Consumer only.
+	 *
+	 * First buffer is always taken, following are added while
+	 * total size stays within @a max_bytes.
+	 * Taken buffers are signed (MsgBuffer::sign()).
+	 * Should be called after next() returned non-null.
+	 *
+	 * @return number of entries in @a iov
+	 */
+	size_t gather(boost::asio::const_buffer *iov, size_t max_iov, size_t max_bytes) {
+		size_t cnt = 0, total = 0;
+
+		for (size_t pos = tail; cnt < max_iov; pos++) {
+			Slot &slot = slots[pos % capacity];
+			if (slot.seq.load(std::memory_order_acquire) != pos + 1)
+				break;
+
+			size_t len = slot.buf.tx_len() - slot.buf.pos;
+			if (cnt > 0 && total + len > max_bytes)
+				break;
+
+			slot.buf.sign();
+			iov[cnt++] = boost::asio::const_buffer(slot.buf.dpos(), len);
+			total += len;
+		}
+
+		return cnt;
+	}
+
+	/**
+	 * @brief Account @a bytes written from buffers given by gather(). Consumer only.
+	 *
+	 * Fully written buffers are released, partially written one stays at front.
+	 */
+	void consume(size_t bytes) {
+		while (bytes > 0) {
+			auto buf = front();
+			assert(buf != nullptr);
+
+			size_t n = std::min<size_t>(bytes, buf->nbytes());
+			buf->pos += n;
+			bytes -= n;
+
+			if (buf->nbytes() == 0)
+				pop();
+		}
+	}
+
+	/**
+	 * @brief Release buffer returned by front(). Consumer only.
+	 */
+	void pop() {
+		Slot &slot = slots[tail % capacity];
+		slot.buf.shared.reset();	// do not hold broadcast frame until slot reused
+		slot.seq.store(tail + capacity, std::memory_order_release);
+		tail++;
+	}
+
+private:
+	struct Slot {
+		std::atomic<size_t> seq;
+		MsgBuffer buf;
+		uint8_t pad[CACHE_LINE - (sizeof(std::atomic<size_t>) + sizeof(MsgBuffer)) % CACHE_LINE];
+
+		explicit Slot(size_t seq_) :
+			seq(seq_)
+		{ }
+	};
+
+	const size_t capacity;
+	std::unique_ptr<uint8_t[]> storage;
+	Slot *slots;
+
+	// keep producer and consumer indexes on different cache lines
+	uint8_t pad0[CACHE_LINE];
+	std::atomic<size_t> head;
+	std::atomic<bool> busy;
+	uint8_t pad1[CACHE_LINE - sizeof(std::atomic<size_t>) - sizeof(std::atomic<bool>)];
+	size_t tail;
+	uint8_t pad2[CACHE_LINE - sizeof(size_t)];
+};
+}	// namespace mavconn
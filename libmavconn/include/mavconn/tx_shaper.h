@@ -0,0 +1,107 @@
+/**
+ * @brief MAVConn forwarding shaper
+ * @file tx_shaper.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <mavconn/mavlink_dialect.h>
+
+namespace mavconn {
+/**
+ * @brief Token bucket shaper for slow forwarding links.
+ *
+ * Each stream (msgid from one sysid/compid) may have rate cap,
+ * all streams share total byte budget. Frame which can not go now
+ * waits in one slot per stream, newer sample replaces it,
+ * so stream is delayed at most by one frame and never gets stale data.
+ *
+ * Priority ids (heartbeat, commands, missions) are always sent at once,
+ * they are counted in budget but never wait for it.
+ *
+ * Shaper has no timer: waiting frames are flushed by next shape() call,
+ * which on busy link comes every few milliseconds.
+ */
+class TxShaper {
+public:
+	using SendFn = std::function<void (const mavlink::mavlink_message_t *msg)>;
+
+	struct RateLimit {
+		mavlink::msgid_t msgid;
+		float rate_hz;		//!< 0 - drop all
+	};
+
+	struct Stat {
+		uint64_t forwarded;
+		uint64_t replaced;	//!< waiting sample replaced by newer, never sent
+		uint64_t dropped;	//!< by 0 rate
+		size_t waiting;
+	};
+
+	//! Default priority ids: HEARTBEAT, COMMAND_*, MISSION_*
+	static const std::vector<mavlink::msgid_t> DEFAULT_PRIORITY;
+
+	TxShaper();
+
+	/**
+	 * Set shaping, may be called from any thread.
+	 *
+	 * @param budget_Bps  total bytes per second, 0 - unlimited
+	 */
+	void configure(float budget_Bps, const std::vector<RateLimit> &limits,
+			const std::vector<mavlink::msgid_t> &priority = DEFAULT_PRIORITY);
+
+	/**
+	 * Send waiting frames which may go now, then shape @a count new ones.
+	 * Forwarding thread only.
+	 *
+	 * @param now_ns  time of batch, e.g. its rx stamp, so no clock read per frame
+	 */
+	void shape(const mavlink::mavlink_message_t *msgs, size_t count, int64_t now_ns, const SendFn &send);
+
+	Stat get_stat();
+
+private:
+	struct Stream {
+		int64_t interval_ns;	//!< 0 - no cap, INT64_MAX - drop
+		int64_t next_ns;
+		bool waiting;
+		mavlink::mavlink_message_t msg;
+	};
+
+	std::mutex mutex;
+	bool active;
+	double budget_Bps;
+	double burst;		//!< bucket size, bytes
+	double tokens;
+	int64_t last_ns;
+
+	std::unordered_map<mavlink::msgid_t, int64_t> intervals;
+	std::unordered_set<mavlink::msgid_t> priority;
+	std::unordered_map<uint64_t, Stream> streams;	//!< msgid << 16 | sysid << 8 | compid
+	std::vector<uint64_t> waiting;			//!< streams with waiting frame, in order of arrival
+
+	Stat stat;
+
+	void refill(int64_t now_ns);
+	bool try_send(Stream &s, const mavlink::mavlink_message_t *msg, size_t len, int64_t now_ns, const SendFn &send);
+};
+}	// namespace mavconn
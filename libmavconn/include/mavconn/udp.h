@@ -18,9 +18,18 @@
 #pragma once
 
 #include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
 #include <boost/asio.hpp>
 #include <mavconn/interface.h>
+#include <mavconn/io_pool.h>
 #include <mavconn/msgbuffer.h>
+#include <mavconn/tx_queue.h>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
 
 namespace mavconn {
 /**
@@ -38,16 +47,35 @@ public:
 	//! Markers for broadcast modes. Not valid domain names.
 	static constexpr auto BROADCAST_REMOTE_HOST = "***i want broadcast***";
 	static constexpr auto PERMANENT_BROADCAST_REMOTE_HOST = "***permanent broadcast***";
+	//! Marker for server mode: every sender becomes a peer
+	static constexpr auto SERVER_REMOTE_HOST = "***server***";
+
+	//! Server mode peer table defaults
+	static constexpr size_t DEFAULT_MAX_PEERS = 16;
+	static constexpr size_t MAX_PEERS = 32;
+	static constexpr float DEFAULT_PEER_TIMEOUT = 10.0;
+
+	//! Server mode peer counters
+	struct PeerStat {
+		std::string address;
+		uint64_t rx_packets;
+		uint64_t rx_bytes;
+		uint64_t tx_packets;
+		uint64_t tx_bytes;
+		float idle;		//!< seconds since last received datagram
+	};
 
 	/**
 	 * @param[id] bind_host    bind host
 	 * @param[id] bind_port    bind port
 	 * @param[id] remote_host  remote host (optional)
 	 * @param[id] remote_port  remote port (optional)
+	 * @param[id] io_pool      shared IO pool (optional), nullptr - own IO thread
 	 */
 	MAVConnUDP(uint8_t system_id = 1, uint8_t component_id = MAV_COMP_ID_UDP_BRIDGE,
 			std::string bind_host = DEFAULT_BIND_HOST, unsigned short bind_port = DEFAULT_BIND_PORT,
-			std::string remote_host = DEFAULT_REMOTE_HOST, unsigned short remote_port = DEFAULT_REMOTE_PORT);
+			std::string remote_host = DEFAULT_REMOTE_HOST, unsigned short remote_port = DEFAULT_REMOTE_PORT,
+			IOPool::Ptr io_pool = nullptr);
 	~MAVConnUDP();
 
 	void close() override;
@@ -55,16 +83,52 @@ public:
 	void send_message(const mavlink::mavlink_message_t *message) override;
 	void send_message(const mavlink::Message &message, const uint8_t source_compid) override;
 	void send_bytes(const uint8_t *bytes, size_t length) override;
+	void add_tx_lane(TxPolicy policy, const std::vector<mavlink::msgid_t> &msgids, size_t capacity) override;
 
 	inline bool is_open() override {
 		return socket.is_open();
 	}
+	inline int set_io_sched(const utils::ThreadSched &sched) override {
+		return io_pool->set_sched(sched);
+	}
+	inline std::vector<utils::ThreadSched> get_io_sched() override {
+		return io_pool->get_sched();
+	}
+
+	//! Upper limit for set_batch_size()
+	static constexpr size_t MAX_BATCH_SIZE = 64;
+
+	/**
+	 * Receive and send up to @a n datagrams per syscall (recvmmsg/sendmmsg).
+	 *
+	 * 0 or 1 disables batch mode. Linux only, ignored on other systems.
+	 */
+	void set_batch_size(size_t n);
+	inline size_t get_batch_size() {
+		return batch_size;
+	}
+
+	/**
+	 * Server mode peer table limits.
+	 *
+	 * New sender is added while table has less than @a max_peers
+	 * (up to MAX_PEERS), peer silent for @a timeout seconds is removed.
+	 */
+	void set_peer_limits(size_t max_peers, float timeout);
+
+	//! Server mode peers. Empty in other modes.
+	std::vector<PeerStat> get_peers();
+
+	inline bool is_server() {
+		return server_mode;
+	}
 
 private:
-	boost::asio::io_service io_service;
-	std::unique_ptr<boost::asio::io_service::work> io_work;
-	std::thread io_thread;
+	IOPool::Ptr io_pool;
+	bool own_pool;
+	boost::asio::io_service::strand strand;
 	bool permanent_broadcast;
+	bool server_mode;
 
 	std::atomic<bool> remote_exists;
 	boost::asio::ip::udp::socket socket;
@@ -73,12 +137,54 @@ private:
 	boost::asio::ip::udp::endpoint last_remote_ep;
 	boost::asio::ip::udp::endpoint bind_ep;
 
-	std::atomic<bool> tx_in_progress;
-	std::deque<MsgBuffer> tx_q;
+	TxQueue tx_q;
 	std::array<uint8_t, MsgBuffer::MAX_SIZE> rx_buf;
 	std::recursive_mutex mutex;
 
+	std::atomic<size_t> batch_size;
+
+	//! server mode peer, touched by IO thread, read by get_peers()
+	struct Peer {
+		boost::asio::ip::udp::endpoint ep;
+		steady_clock::time_point last_rx;
+		uint64_t rx_packets;
+		uint64_t rx_bytes;
+		uint64_t tx_packets;
+		uint64_t tx_bytes;
+	};
+
+	std::vector<Peer> peers;
+	std::mutex peers_mutex;
+	size_t max_peers;
+	steady_clock::duration peer_timeout;
+
+	//! Account datagram from @a ep, add new peer. IO thread.
+	void peer_rx(const boost::asio::ip::udp::endpoint &ep, size_t bytes);
+	//! Remove idle peers. Called with peers_mutex held.
+	void expire_peers(steady_clock::time_point now);
+	//! Send queued frames to all peers. IO thread.
+	void do_sendpeers();
+
+#ifdef __linux__
+	//! recvmmsg() storage, allocated by IO thread on first use
+	struct RxBatch {
+		std::vector<mmsghdr> hdr;
+		std::vector<iovec> iov;
+		std::vector<sockaddr_storage> addr;
+		std::vector<std::array<uint8_t, MsgBuffer::MAX_SIZE>> buf;
+		std::vector<std::array<uint8_t, CMSG_SPACE(sizeof(timespec))>> ctl;	//!< SO_TIMESTAMPNS
+	} rx_batch;
+
+	//! sendmmsg() headers, point to TxRing buffers
+	std::array<boost::asio::const_buffer, MAX_BATCH_SIZE> tx_bufs;
+	std::array<iovec, MAX_BATCH_SIZE> tx_iov;
+	std::array<mmsghdr, MAX_BATCH_SIZE> tx_hdr;
+
+	void do_recvmmsg();
+	void do_sendmmsg();
+#endif
+
 	void do_recvfrom();
-	void do_sendto(bool check_tx_state);
+	void do_sendto();
 };
 }	// namespace mavconn
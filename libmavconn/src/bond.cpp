@@ -0,0 +1,443 @@
+/**
+ * @brief MAVConn bonded link class
+ * @file bond.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <cassert>
+#include <cmath>
+
+#include <mavconn/console_bridge_compat.h>
+#include <mavconn/thread_utils.h>
+#include <mavconn/bond.h>
+
+namespace mavconn {
+
+using mavlink::mavlink_message_t;
+using mavlink::msgid_t;
+
+#define PFX	"mavconn: bond"
+#define PFXd	PFX "%zu: "
+
+static constexpr auto RLX = std::memory_order_relaxed;
+
+static inline int64_t steady_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			steady_clock::now().time_since_epoch()).count();
+}
+
+static inline int64_t sec_to_ns(float sec)
+{
+	return int64_t(sec * 1e9);
+}
+
+MAVConnBond::MAVConnBond(uint8_t system_id, uint8_t component_id,
+		std::vector<std::string> urls) :
+	MAVConnInterface(system_id, component_id),
+	open_flag(false)
+{
+	set_critical_messages({
+			mavlink::common::msg::SET_MODE::MSG_ID,
+			mavlink::common::msg::PARAM_SET::MSG_ID,
+			mavlink::common::msg::COMMAND_INT::MSG_ID,
+			mavlink::common::msg::COMMAND_LONG::MSG_ID,
+		});
+
+	for (auto &url : urls) {
+		std::unique_ptr<Member> m(new Member);
+		m->url = url;
+		m->open = false;
+		m->last_rx_ns = 0;
+		m->rx_frames = 0;
+		m->rx_dups = 0;
+		m->tx_frames = 0;
+		m->reopens = 0;
+		m->lag_ms = 0.0;
+		members.emplace_back(std::move(m));
+	}
+
+	size_t opened = 0;
+	for (size_t i = 0; i < members.size(); i++)
+		opened += open_member(i);
+
+	if (opened == 0)
+		throw DeviceError("bond", "no member link could be opened");
+
+	CONSOLE_BRIDGE_logInform(PFXd "%zu of %zu links open", conn_id, opened, members.size());
+
+	open_flag = true;
+	reopen_thread = std::thread([this] () {
+				utils::set_this_thread_name("mbond%zu", conn_id);
+				do_reopen();
+			});
+}
+
+MAVConnBond::~MAVConnBond()
+{
+	close();
+}
+
+bool MAVConnBond::open_member(size_t idx)
+{
+	auto &m = *members[idx];
+	Ptr link;
+
+	try {
+		link = MAVConnInterface::open_url(m.url, sys_id, comp_id);
+	}
+	catch (DeviceError &err) {
+		CONSOLE_BRIDGE_logWarn(PFXd "%s: %s", conn_id, m.url.c_str(), err.what());
+		return false;
+	}
+
+	// callbacks are set once, member is replaced on reopen
+	link->message_received_batch_cb = [this, idx, lp = link.get()](const mavlink_message_t *msgs, const Framing *framings, size_t count) {
+		member_rx(idx, lp, msgs, framings, count);
+	};
+	link->port_closed_cb = [this, idx]() {
+		member_closed(idx);
+	};
+
+	std::lock_guard<std::mutex> lock(members_mutex);
+	for (auto &lane : lanes)
+		link->add_tx_lane(lane.policy, lane.msgids, lane.capacity);
+
+	m.link = link;
+	m.last_rx_ns = 0;
+	{
+		std::lock_guard<std::mutex> rx_lock(rx_mutex);
+		m.probe = link->get_link_probe();
+	}
+	m.open = true;
+	return true;
+}
+
+MAVConnInterface::Ptr MAVConnBond::member_link(size_t idx)
+{
+	std::lock_guard<std::mutex> lock(members_mutex);
+	return members[idx]->link;
+}
+
+void MAVConnBond::close()
+{
+	if (!open_flag.exchange(false))
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(reopen_mutex);
+		reopen_cond.notify_all();
+	}
+
+	if (reopen_thread.joinable())
+		reopen_thread.join();
+
+	// member IO threads are stopped by their close()
+	std::vector<Ptr> links;
+	{
+		std::lock_guard<std::mutex> lock(members_mutex);
+		for (auto &m : members)
+			links.emplace_back(std::move(m->link));
+	}
+
+	for (auto &link : links)
+		if (link)
+			link->close();
+
+	if (port_closed_cb)
+		port_closed_cb();
+}
+
+void MAVConnBond::member_closed(size_t idx)
+{
+	auto &m = *members[idx];
+
+	// called from member IO thread, link is released by reopen thread
+	if (m.open.exchange(false) && open_flag)
+		CONSOLE_BRIDGE_logWarn(PFXd "%s: link closed, fail over", conn_id, m.url.c_str());
+}
+
+void MAVConnBond::do_reopen()
+{
+	auto interval = std::chrono::duration<float>(float(REOPEN_INTERVAL));
+
+	while (open_flag) {
+		{
+			std::unique_lock<std::mutex> lock(reopen_mutex);
+			reopen_cond.wait_for(lock, interval, [this] () { return !open_flag; });
+		}
+
+		for (size_t i = 0; i < members.size() && open_flag; i++) {
+			auto &m = *members[i];
+			if (m.open)
+				continue;
+
+			// drop closed link outside of its own IO thread
+			Ptr old;
+			{
+				std::lock_guard<std::mutex> lock(members_mutex);
+				old = std::move(m.link);
+			}
+			old.reset();
+
+			if (open_member(i)) {
+				m.reopens.fetch_add(1, RLX);
+				CONSOLE_BRIDGE_logInform(PFXd "%s: link reopened", conn_id, m.url.c_str());
+			}
+		}
+	}
+}
+
+void MAVConnBond::member_rx(size_t idx, MAVConnInterface *link,
+		const mavlink_message_t *messages, const Framing *framings, size_t count)
+{
+	auto &m = *members[idx];
+	auto now = steady_ns();
+	auto window = sec_to_ns(DEDUP_WINDOW);
+
+	m.last_rx_ns.store(now, RLX);
+
+	std::lock_guard<std::mutex> lock(rx_mutex);
+	for (size_t i = 0; i < count; i++) {
+		auto &msg = messages[i];
+
+		// member already counted bad frames in its own stats
+		if (framings[i] != Framing::ok)
+			continue;
+
+		auto &s = seen[msg.sysid << 8 | msg.compid][msg.seq];
+		if (s.stamp_ns != 0 && now - s.stamp_ns < window
+				&& s.msgid == msg.msgid && s.checksum == msg.checksum) {
+			if (s.member != idx) {
+				float lag = (now - s.stamp_ns) / 1e6f;
+				m.lag_ms += (lag - m.lag_ms) * 0.1f;
+			}
+
+			m.rx_dups.fetch_add(1, RLX);
+			continue;
+		}
+
+		s = Seen { msg.msgid, msg.checksum, now, idx };
+		m.lag_ms -= m.lag_ms * 0.1f;
+		m.rx_frames.fetch_add(1, RLX);
+
+		iostat_rx_add(LinkStats::frame_length(msg));
+		set_rx_stamp(link->get_rx_stamp(i));
+		rx_frames(PFX, const_cast<mavlink_message_t *>(&msg), 1);
+	}
+}
+
+size_t MAVConnBond::select_member()
+{
+	auto now = steady_ns();
+	auto timeout = sec_to_ns(HEALTH_TIMEOUT);
+	size_t best = SIZE_MAX, best_rtt = SIZE_MAX, any_open = SIZE_MAX;
+	float best_lag = INFINITY, best_delay = INFINITY;
+	bool all_probed = true;
+
+	std::lock_guard<std::mutex> lock(rx_mutex);
+	for (size_t i = 0; i < members.size(); i++) {
+		auto &m = *members[i];
+		if (!m.open)
+			continue;
+
+		if (any_open == SIZE_MAX)
+			any_open = i;
+
+		auto last_rx = m.last_rx_ns.load(RLX);
+		if (last_rx == 0 || now - last_rx >= timeout)
+			continue;
+
+		if (m.lag_ms < best_lag) {
+			best = i;
+			best_lag = m.lag_ms;
+		}
+
+		// lag compares only members which got the same frames, RTT is absolute
+		if (!m.probe || !m.probe->have_rtt()) {
+			all_probed = false;
+			continue;
+		}
+
+		auto st = m.probe->get_stats();
+		float delay = st.rtt_ms + st.jitter_ms;
+		if (delay < best_delay) {
+			best_rtt = i;
+			best_delay = delay;
+		}
+	}
+
+	if (all_probed && best_rtt != SIZE_MAX)
+		return best_rtt;
+
+	return (best != SIZE_MAX) ? best : any_open;
+}
+
+void MAVConnBond::send_frame(const mavlink_message_t *message)
+{
+	bool all;
+	{
+		std::lock_guard<std::mutex> lock(tx_mutex);
+		all = message->msgid < critical.size() && critical[message->msgid];
+	}
+
+	auto len = LinkStats::frame_length(*message);
+	size_t sent = 0;
+
+	auto send = [&](size_t idx) {
+		auto link = member_link(idx);
+		if (!link || !link->is_open())
+			return;
+
+		// overflow of one member should not stop others
+		try {
+			link->send_message(message);
+		}
+		catch (std::length_error &) {
+			return;
+		}
+
+		members[idx]->tx_frames.fetch_add(1, RLX);
+		sent++;
+	};
+
+	if (all) {
+		for (size_t i = 0; i < members.size(); i++)
+			send(i);
+	}
+	else {
+		auto idx = select_member();
+		if (idx != SIZE_MAX)
+			send(idx);
+	}
+
+	if (sent == 0) {
+		link_stats.tx_drop();
+		trace_tx(message, 0);
+		throw std::length_error("MAVConnBond::send_message: no link could queue message");
+	}
+
+	link_stats.tx_frame(message->msgid, len);
+	trace_tx(message, len);
+	iostat_tx_add(len);
+}
+
+void MAVConnBond::send_message(const mavlink_message_t *message)
+{
+	assert(message != nullptr);
+
+	if (!is_open()) {
+		CONSOLE_BRIDGE_logError(PFXd "send: channel closed!", conn_id);
+		return;
+	}
+
+	log_send(PFX, message);
+	send_frame(message);
+}
+
+void MAVConnBond::send_message(const mavlink::Message &message, const uint8_t source_compid)
+{
+	if (!is_open()) {
+		CONSOLE_BRIDGE_logError(PFXd "send: channel closed!", conn_id);
+		return;
+	}
+
+	log_send_obj(PFX, message);
+
+	// serialized once, so all members send the same seq
+	mavlink_message_t msg;
+	mavlink::MsgMap map(msg);
+	auto mi = message.get_message_info();
+	auto status = get_tx_status();
+
+	message.serialize(map);
+	mavlink::mavlink_finalize_message_buffer(&msg, sys_id, source_compid, &status,
+			mi.min_length, mi.length, mi.crc_extra);
+	sign_tx(&msg, mi.crc_extra);
+
+	send_frame(&msg);
+}
+
+void MAVConnBond::send_bytes(const uint8_t *bytes, size_t length)
+{
+	if (!is_open()) {
+		CONSOLE_BRIDGE_logError(PFXd "send: channel closed!", conn_id);
+		return;
+	}
+
+	auto idx = select_member();
+	auto link = (idx != SIZE_MAX) ? member_link(idx) : nullptr;
+	if (!link)
+		throw std::length_error("MAVConnBond::send_bytes: no open link");
+
+	link->send_bytes(bytes, length);
+	iostat_tx_add(length);
+}
+
+void MAVConnBond::add_tx_lane(TxPolicy policy, const std::vector<msgid_t> &msgids, size_t capacity)
+{
+	std::lock_guard<std::mutex> lock(members_mutex);
+	lanes.push_back(Lane { policy, msgids, capacity });
+
+	for (auto &m : members)
+		if (m->link)
+			m->link->add_tx_lane(policy, msgids, capacity);
+}
+
+void MAVConnBond::set_critical_messages(const std::vector<msgid_t> &msgids)
+{
+	std::lock_guard<std::mutex> lock(tx_mutex);
+	critical.clear();
+
+	for (auto msgid : msgids) {
+		if (msgid >= critical.size())
+			critical.resize(msgid + 1);
+
+		critical[msgid] = true;
+	}
+}
+
+std::vector<MAVConnBond::MemberStat> MAVConnBond::get_members()
+{
+	std::vector<MemberStat> ret;
+	auto active = select_member();
+	auto now = steady_ns();
+	auto timeout = sec_to_ns(HEALTH_TIMEOUT);
+
+	std::lock_guard<std::mutex> lock(rx_mutex);
+	for (size_t i = 0; i < members.size(); i++) {
+		auto &m = *members[i];
+		auto last_rx = m.last_rx_ns.load(RLX);
+		LinkProbe::Stats probe {};
+		if (m.probe)
+			probe = m.probe->get_stats();
+
+		ret.push_back(MemberStat {
+				m.url,
+				m.open,
+				m.open && last_rx != 0 && now - last_rx < timeout,
+				i == active,
+				m.rx_frames.load(RLX),
+				m.rx_dups.load(RLX),
+				m.tx_frames.load(RLX),
+				m.lag_ms,
+				m.reopens.load(RLX),
+				probe.rtt_ms,
+				probe.jitter_ms,
+			});
+	}
+
+	return ret;
+}
+}	// namespace mavconn
@@ -0,0 +1,262 @@
+/**
+ * @brief MAVConn tlog replay link class
+ * @file file.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include <mavconn/console_bridge_compat.h>
+#include <mavconn/thread_utils.h>
+#include <mavconn/file.h>
+
+namespace mavconn {
+
+using mavlink::mavlink_message_t;
+using steady_clock = std::chrono::steady_clock;
+
+#define PFX	"mavconn: file"
+#define PFXd	PFX "%zu: "
+
+constexpr float MAVConnFile::DEFAULT_START_DELAY;
+
+MAVConnFile::MAVConnFile(uint8_t system_id, uint8_t component_id,
+		std::string path, float speed_, std::string capture_path, float start_delay_) :
+	MAVConnInterface(system_id, component_id),
+	fp(nullptr),
+	speed(std::max(speed_, 0.0f)),
+	start_delay(start_delay_),
+	bytes_status {},
+	bytes_buffer {},
+	open_flag(false),
+	replayed(0),
+	started(false)
+{
+	fp = std::fopen(path.c_str(), "rb");
+	if (fp == nullptr)
+		throw DeviceError("file", errno);
+
+	if (!capture_path.empty()) {
+		try {
+			capture = std::make_shared<TlogRecorder>(TlogRecorder::Options(capture_path));
+		}
+		catch (std::system_error &ex) {
+			std::fclose(fp);
+			throw DeviceError("file", ex.what());
+		}
+	}
+
+	CONSOLE_BRIDGE_logInform(PFXd "replay %s, speed %.2f", conn_id, path.c_str(), speed);
+
+	open_flag = true;
+	rx_thread = std::thread([this] () {
+				utils::set_this_thread_name("mfile%zu", conn_id);
+				do_replay();
+			});
+}
+
+MAVConnFile::~MAVConnFile()
+{
+	close();
+
+	if (rx_thread.get_id() == std::this_thread::get_id())
+		rx_thread.detach();
+	else if (rx_thread.joinable())
+		rx_thread.join();
+
+	if (fp != nullptr)
+		std::fclose(fp);
+}
+
+void MAVConnFile::close()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!open_flag.exchange(false))
+			return;
+	}
+
+	cond.notify_all();
+
+	// close() may be called from message handler, or by replay thread at end of file,
+	// then thread is joined by destructor
+	if (rx_thread.get_id() != std::this_thread::get_id() && rx_thread.joinable())
+		rx_thread.join();
+
+	if (capture)
+		capture->flush();
+
+	if (port_closed_cb)
+		port_closed_cb();
+}
+
+void MAVConnFile::start()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		started = true;
+	}
+
+	cond.notify_all();
+}
+
+void MAVConnFile::capture_tx(const mavlink_message_t &msg)
+{
+	auto len = LinkStats::frame_length(msg);
+
+	link_stats.tx_frame(msg.msgid, len);
+	trace(TraceEvent::TX, msg.msgid, len, msg.seq, msg.sysid, msg.compid);
+	record(msg, rx_stamp_now());
+	iostat_tx_add(len);
+
+	if (capture)
+		capture->write(msg, rx_stamp_now());
+}
+
+void MAVConnFile::send_message(const mavlink_message_t *message)
+{
+	assert(message != nullptr);
+
+	if (!is_open()) {
+		CONSOLE_BRIDGE_logError(PFXd "send: channel closed!", conn_id);
+		return;
+	}
+
+	log_send(PFX, message);
+	capture_tx(*message);
+}
+
+void MAVConnFile::send_message(const mavlink::Message &message, const uint8_t source_compid)
+{
+	if (!is_open()) {
+		CONSOLE_BRIDGE_logError(PFXd "send: channel closed!", conn_id);
+		return;
+	}
+
+	log_send_obj(PFX, message);
+
+	mavlink_message_t msg;
+	mavlink::MsgMap map(msg);
+	auto mi = message.get_message_info();
+	auto status = get_tx_status();
+
+	message.serialize(map);
+	mavlink::mavlink_finalize_message_buffer(&msg, sys_id, source_compid, &status,
+			mi.min_length, mi.length, mi.crc_extra);
+
+	// frames are recorded in order of signature timestamps
+	std::lock_guard<std::mutex> lock(tx_mutex);
+	sign_tx(&msg, mi.crc_extra);
+	capture_tx(msg);
+}
+
+void MAVConnFile::send_bytes(const uint8_t *bytes, size_t length)
+{
+	if (!is_open()) {
+		CONSOLE_BRIDGE_logError(PFXd "send: channel closed!", conn_id);
+		return;
+	}
+
+	// capture file holds whole frames, so raw bytes are framed first
+	std::lock_guard<std::mutex> lock(tx_mutex);
+	for (; length > 0; length--) {
+		mavlink::mavlink_status_t status;
+		mavlink_message_t msg;
+
+		auto framing = mavlink::mavlink_frame_char_buffer(&bytes_buffer, &bytes_status, *bytes++, &msg, &status);
+		if (framing == mavlink::MAVLINK_FRAMING_OK)
+			capture_tx(msg);
+	}
+}
+
+bool MAVConnFile::read_record(uint64_t &stamp_us, uint8_t *frame, size_t &len)
+{
+	uint8_t stamp[8];
+	if (std::fread(stamp, 1, sizeof(stamp), fp) != sizeof(stamp))
+		return false;
+
+	stamp_us = 0;
+	for (auto b : stamp)
+		stamp_us = (stamp_us << 8) | b;
+
+	// magic, len and incompat_flags give frame length
+	if (std::fread(frame, 1, 3, fp) != 3)
+		return false;
+
+	if (frame[0] == MAVLINK_STX_MAVLINK1) {
+		len = MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1 + frame[1] + MAVLINK_NUM_CHECKSUM_BYTES;
+	}
+	else if (frame[0] == MAVLINK_STX) {
+		len = MAVLINK_NUM_HEADER_BYTES + frame[1] + MAVLINK_NUM_CHECKSUM_BYTES;
+		if (frame[2] & MAVLINK_IFLAG_SIGNED)
+			len += MAVLINK_SIGNATURE_BLOCK_LEN;
+	}
+	else {
+		CONSOLE_BRIDGE_logError(PFXd "bad record at offset %ld, replay stopped", conn_id, std::ftell(fp) - 3);
+		return false;
+	}
+
+	return std::fread(frame + 3, 1, len - 3, fp) == len - 3;
+}
+
+bool MAVConnFile::wait_until(steady_clock::time_point deadline)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	cond.wait_until(lock, deadline, [this] { return !open_flag; });
+	return open_flag;
+}
+
+void MAVConnFile::do_replay()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		auto pred = [this] { return started || !open_flag; };
+		if (start_delay < 0)
+			cond.wait(lock, pred);
+		else
+			cond.wait_for(lock, std::chrono::duration<float>(start_delay), pred);
+
+		if (!open_flag)
+			return;
+	}
+
+	uint8_t frame[MAVLINK_MAX_PACKET_LEN];
+	uint64_t stamp_us, first_us = 0;
+	size_t len;
+	auto wall_start = steady_clock::now();
+
+	while (open_flag && read_record(stamp_us, frame, len)) {
+		if (replayed == 0)
+			first_us = stamp_us;
+
+		// original spacing scaled by speed; clock jumps in log are replayed as is
+		if (speed > 0 && stamp_us > first_us) {
+			auto offset = std::chrono::duration<double, std::micro>((stamp_us - first_us) / speed);
+			if (!wait_until(wall_start + std::chrono::duration_cast<steady_clock::duration>(offset)))
+				break;
+		}
+
+		iostat_rx_add(len);
+		set_rx_stamp(stamp_us * 1000);
+		parse_buffer(PFX, frame, sizeof(frame), len);
+		replayed.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	CONSOLE_BRIDGE_logInform(PFXd "replay done, %zu records", conn_id, get_replayed());
+	close();
+}
+}	// namespace mavconn
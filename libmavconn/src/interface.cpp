@@ -16,14 +16,22 @@
  */
 
 #include <set>
+#include <fstream>
 #include <cassert>
+#include <cstring>
+#include <algorithm>
 
 #include <mavconn/console_bridge_compat.h>
+#include <mavconn/crc.h>
 #include <mavconn/interface.h>
 #include <mavconn/msgbuffer.h>
+#include <mavconn/bond.h>
+#include <mavconn/file.h>
 #include <mavconn/serial.h>
+#include <mavconn/shm.h>
 #include <mavconn/udp.h>
 #include <mavconn/tcp.h>
+#include <mavconn/tx_shaper.h>
 
 namespace mavconn {
 #define PFX	"mavconn: "
@@ -31,17 +39,38 @@ namespace mavconn {
 using mavlink::mavlink_message_t;
 using mavlink::mavlink_status_t;
 
+//! Default Rx parser, may be changed by -DMAVCONN_DEFAULT_PARSER=BLOCK
+#ifndef MAVCONN_DEFAULT_PARSER
+#define MAVCONN_DEFAULT_PARSER CHAR
+#endif
+
 // static members
-std::once_flag MAVConnInterface::init_flag;
-std::unordered_map<mavlink::msgid_t, const mavlink::mavlink_msg_entry_t*> MAVConnInterface::message_entries {};
 std::atomic<size_t> MAVConnInterface::conn_id_counter {0};
 
 
 MAVConnInterface::MAVConnInterface(uint8_t system_id, uint8_t component_id) :
 	sys_id(system_id),
 	comp_id(component_id),
+	rx_filter(std::make_shared<RxFilter>()),
 	m_status {},
+	m_tx_seq(0),
 	m_buffer {},
+	parser_type(Parser::MAVCONN_DEFAULT_PARSER),
+	tx_gather_bytes(DEFAULT_TX_GATHER_BYTES),
+	m_active_parser(Parser::MAVCONN_DEFAULT_PARSER),
+	m_trace(nullptr),
+	m_recording(false),
+	m_signing(nullptr),
+	m_probe(nullptr),
+	m_rx_pending {},
+	m_rx_pending_len(0),
+	m_rx_batch(32),
+	m_rx_batch_framing(32),
+	m_rx_batch_stamp(32),
+	m_rx_batch_count(0),
+	m_rx_batching(false),
+	m_rx_stamp(0),
+	m_rx_stamps(&m_rx_stamp),
 	tx_total_bytes(0),
 	rx_total_bytes(0),
 	last_tx_total_bytes(0),
@@ -49,12 +78,20 @@ MAVConnInterface::MAVConnInterface(uint8_t system_id, uint8_t component_id) :
 	last_iostat(steady_clock::now())
 {
 	conn_id = conn_id_counter.fetch_add(1);
-	std::call_once(init_flag, init_msg_entry);
 }
 
 mavlink_status_t MAVConnInterface::get_status()
 {
-	return m_status;
+	auto status = m_status;
+	status.current_tx_seq = m_tx_seq;
+	return status;
+}
+
+mavlink_status_t MAVConnInterface::get_tx_status()
+{
+	auto status = m_status;
+	status.current_tx_seq = m_tx_seq.fetch_add(1);
+	return status;
 }
 
 MAVConnInterface::IOStat MAVConnInterface::get_iostat()
@@ -74,14 +111,25 @@ MAVConnInterface::IOStat MAVConnInterface::get_iostat()
 	auto dt = now - last_iostat;
 	last_iostat = now;
 
-	float dt_s = std::chrono::duration_cast<std::chrono::seconds>(dt).count();
+	float dt_s = std::chrono::duration<float>(dt).count();
 
-	stat.tx_speed = d_tx / dt_s;
-	stat.rx_speed = d_rx / dt_s;
+	if (dt_s > 0.0f) {
+		stat.tx_speed = d_tx / dt_s;
+		stat.rx_speed = d_rx / dt_s;
+	}
+	else {
+		stat.tx_speed = 0.0f;
+		stat.rx_speed = 0.0f;
+	}
 
 	return stat;
 }
 
+LinkStats::Snapshot MAVConnInterface::get_link_stats()
+{
+	return link_stats.snapshot();
+}
+
 void MAVConnInterface::iostat_tx_add(size_t bytes)
 {
 	tx_total_bytes += bytes;
@@ -92,16 +140,140 @@ void MAVConnInterface::iostat_rx_add(size_t bytes)
 	rx_total_bytes += bytes;
 }
 
-void MAVConnInterface::parse_buffer(const char *pfx, uint8_t *buf, const size_t bufsize, size_t bytes_received)
+void MAVConnInterface::parse_buffer(const char *pfx, uint8_t *buf, const size_t bufsize, size_t bytes_received, bool flush)
 {
-	mavlink::mavlink_status_t status;
-	mavlink::mavlink_message_t message;
-
 	assert(bufsize >= bytes_received);
 
 	iostat_rx_add(bytes_received);
+
+	auto parser = parser_type.load();
+	if (parser != m_active_parser) {
+		// drop partial frame of previous parser
+		m_status.parse_state = mavlink::MAVLINK_PARSE_STATE_IDLE;
+		m_rx_pending_len = 0;
+		m_active_parser = parser;
+	}
+
+	m_rx_batching = bool(message_received_batch_cb);
+	probe_poll();
+
+	if (parser == Parser::BLOCK)
+		parse_buffer_block(pfx, buf, bytes_received);
+	else
+		parse_buffer_char(pfx, buf, bytes_received);
+
+	if (flush)
+		rx_flush(pfx);
+}
+
+void MAVConnInterface::rx_flush(const char *pfx)
+{
+	if (m_rx_batch_count > 0) {
+		auto count = m_rx_batch_count;
+		m_rx_batch_count = 0;
+
+		if (console_bridge::getLogLevel() <= console_bridge::CONSOLE_BRIDGE_LOG_DEBUG) {
+			for (size_t i = 0; i < count; i++)
+				log_recv(pfx, m_rx_batch[i], m_rx_batch_framing[i]);
+		}
+
+		if (message_received_batch_cb) {
+			m_rx_stamps = m_rx_batch_stamp.data();
+			message_received_batch_cb(m_rx_batch.data(), m_rx_batch_framing.data(), count);
+			m_rx_stamps = &m_rx_stamp;
+		}
+	}
+}
+
+void MAVConnInterface::rx_frames(const char *pfx, mavlink_message_t *messages, size_t count)
+{
+	size_t passed = 0;
+	auto signing = signing_p();
+	for (size_t i = 0; i < count; i++) {
+		auto &msg = messages[i];
+		if (!rx_filter->accept(msg.msgid)) {
+			link_stats.rx_filtered_frame(msg);
+			continue;
+		}
+
+		if (signing && signing->verify(msg) != Framing::ok) {
+			link_stats.rx_frame(msg, Framing::bad_signature);
+			continue;
+		}
+
+		link_stats.rx_frame(msg, Framing::ok);
+		trace(TraceEvent::RX, msg.msgid, LinkStats::frame_length(msg), msg.seq, msg.sysid, msg.compid);
+		record(msg, m_rx_stamp);
+		log_recv(pfx, msg, Framing::ok);
+
+		if (probe_reply(msg))
+			continue;
+
+		// compact in place, caller owns frames until return
+		if (passed != i)
+			messages[passed] = msg;
+		passed++;
+	}
+
+	count = passed;
+	if (count == 0)
+		return;
+
+	if (message_received_batch_cb) {
+		if (m_rx_batch_framing.size() < count)
+			m_rx_batch_framing.resize(count);
+
+		if (m_rx_batch_stamp.size() < count)
+			m_rx_batch_stamp.resize(count);
+
+		std::fill_n(m_rx_batch_framing.begin(), count, Framing::ok);
+		std::fill_n(m_rx_batch_stamp.begin(), count, m_rx_stamp);
+		m_rx_stamps = m_rx_batch_stamp.data();
+		message_received_batch_cb(messages, m_rx_batch_framing.data(), count);
+		m_rx_stamps = &m_rx_stamp;
+		return;
+	}
+
+	if (message_received_cb) {
+		for (size_t i = 0; i < count; i++)
+			message_received_cb(&messages[i], Framing::ok);
+	}
+}
+
+void MAVConnInterface::rx_commit(const char *pfx, mavlink::mavlink_message_t &message, Framing framing)
+{
+	link_stats.rx_frame(message, framing);
+	trace(TraceEvent::RX, message.msgid, LinkStats::frame_length(message),
+			message.seq, message.sysid, message.compid, framing);
+	if (framing == Framing::ok) {
+		record(message, m_rx_stamp);
+
+		// slot of batch is reused by next frame
+		if (probe_reply(message))
+			return;
+	}
+
+	if (m_rx_batching) {
+		// message already stored in slot returned by rx_slot()
+		m_rx_batch_stamp[m_rx_batch_count] = m_rx_stamp;
+		m_rx_batch_framing[m_rx_batch_count++] = framing;
+		return;
+	}
+
+	log_recv(pfx, message, framing);
+
+	if (message_received_cb)
+		message_received_cb(&message, framing);
+}
+
+void MAVConnInterface::parse_buffer_char(const char *pfx, const uint8_t *buf, size_t bytes_received)
+{
+	mavlink::mavlink_status_t status;
+	mavlink::mavlink_message_t local_message;
+
 	for (; bytes_received > 0; bytes_received--) {
 		auto c = *buf++;
+		auto &message = rx_slot(local_message);
 
 		// based on mavlink_parse_char()
 		auto msg_received = static_cast<Framing>(mavlink::mavlink_frame_char_buffer(&m_buffer, &m_status, c, &message, &status));
@@ -116,17 +288,211 @@ void MAVConnInterface::parse_buffer(const char *pfx, uint8_t *buf, const size_t
 			}
 		}
 
-		if (msg_received != Framing::incomplete) {
-			log_recv(pfx, message, msg_received);
+		if (msg_received == Framing::ok && !rx_filter->accept(message.msgid)) {
+			// CRC already done by char parser, still saves dispatch
+			link_stats.rx_filtered_frame(message);
+			continue;
+		}
+
+		// m_status.signing is never set, so signed frames come here as ok
+		auto signing = signing_p();
+		if (msg_received == Framing::ok && signing)
+			msg_received = signing->verify(message);
 
-			if (message_received_cb)
-				message_received_cb(&message, msg_received);
+		if (msg_received != Framing::incomplete)
+			rx_commit(pfx, message, msg_received);
+	}
+}
+
+void MAVConnInterface::parse_buffer_block(const char *pfx, const uint8_t *buf, size_t bytes_received)
+{
+	while (bytes_received > 0) {
+		if (m_rx_pending_len == 0) {
+			parse_block(pfx, buf, bytes_received);
+			return;
 		}
+
+		// frame split between reads: glue saved tail with head of new data.
+		// Saved tail always shorter than one frame, so at least one byte fits.
+		size_t n = std::min(bytes_received, m_rx_pending.size() - m_rx_pending_len);
+		std::memcpy(m_rx_pending.data() + m_rx_pending_len, buf, n);
+		buf += n;
+		bytes_received -= n;
+
+		size_t len = m_rx_pending_len + n;
+		m_rx_pending_len = 0;
+		parse_block(pfx, m_rx_pending.data(), len);
+	}
+}
+
+/**
+ * Parse contiguous block of bytes.
+ *
+ * Same framing rules as mavlink_frame_char_buffer(),
+ * but header checked once and payload copied with one memcpy().
+ * Incomplete frame at the end of block saved to m_rx_pending.
+ */
+void MAVConnInterface::parse_block(const char *pfx, const uint8_t *buf, size_t len)
+{
+	const uint8_t *p = buf;
+	const uint8_t *end = buf + len;
+
+	auto find_stx = [end](const uint8_t *from, uint8_t c) -> const uint8_t * {
+		auto ret = static_cast<const uint8_t *>(std::memchr(from, c, end - from));
+		return (ret != nullptr) ? ret : end;
+	};
+
+	// next v2.0 and v1.0 STX positions, memchr() called again only when we pass it
+	auto next_stx = find_stx(p, MAVLINK_STX);
+	auto next_stx1 = find_stx(p, MAVLINK_STX_MAVLINK1);
+
+	while (p < end) {
+		if (next_stx < p)
+			next_stx = find_stx(p, MAVLINK_STX);
+		if (next_stx1 < p)
+			next_stx1 = find_stx(p, MAVLINK_STX_MAVLINK1);
+
+		// bytes before STX are silently dropped, like char parser do
+		p = std::min(next_stx, next_stx1);
+		if (p == end)
+			break;
+
+		const size_t avail = end - p;
+		const bool is_v1 = (*p == MAVLINK_STX_MAVLINK1);
+		const size_t header_len = (is_v1) ? MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1 : MAVLINK_NUM_HEADER_BYTES;
+
+		if (avail < header_len) {
+			std::memmove(m_rx_pending.data(), p, avail);
+			m_rx_pending_len = avail;
+			return;
+		}
+
+		m_status.parse_error = 0;
+
+		if (!is_v1 && (p[2] & ~MAVLINK_IFLAG_MASK) != 0) {
+			// unknown incompat flags. char parser drops STX, LEN and flags byte.
+			mavlink::_mav_parse_error(&m_status);
+			p += 3;
+			continue;
+		}
+
+		const size_t payload_len = p[1];
+		const size_t signature_len = (!is_v1 && (p[2] & MAVLINK_IFLAG_SIGNED)) ? MAVLINK_SIGNATURE_BLOCK_LEN : 0;
+		const size_t frame_len = header_len + payload_len + MAVLINK_NUM_CHECKSUM_BYTES + signature_len;
+
+		if (avail < frame_len) {
+			std::memmove(m_rx_pending.data(), p, avail);
+			m_rx_pending_len = avail;
+			return;
+		}
+
+		mavlink::mavlink_message_t local_message;
+		auto &message = rx_slot(local_message);
+		message.magic = p[0];
+		message.len = payload_len;
+		if (is_v1) {
+			message.incompat_flags = 0;
+			message.compat_flags = 0;
+			message.seq = p[2];
+			message.sysid = p[3];
+			message.compid = p[4];
+			message.msgid = p[5];
+			m_status.flags |= MAVLINK_STATUS_FLAG_IN_MAVLINK1;
+		}
+		else {
+			message.incompat_flags = p[2];
+			message.compat_flags = p[3];
+			message.seq = p[4];
+			message.sysid = p[5];
+			message.compid = p[6];
+			message.msgid = p[7] | (p[8] << 8) | (p[9] << 16);
+			m_status.flags &= ~MAVLINK_STATUS_FLAG_IN_MAVLINK1;
+		}
+
+		if (!rx_filter->accept(message.msgid)) {
+			// skipped without CRC check, as good frame
+			link_stats.rx_filtered_frame(message);
+			p += frame_len;
+			continue;
+		}
+
+		auto payload = _MAV_PAYLOAD_NON_CONST(&message);
+		std::memcpy(payload, p + header_len, payload_len);
+
+		// zero-fill truncated MAVLink 2.0 payload
+		auto e = mavlink::mavlink_get_msg_entry(message.msgid);
+		if (e != nullptr && payload_len < e->max_msg_len)
+			std::memset(payload + payload_len, 0, e->max_msg_len - payload_len);
+
+		uint16_t checksum = crc::x25_accumulate(p + 1, header_len - 1 + payload_len, crc::X25_INIT);
+		checksum = crc::x25_accumulate((e != nullptr) ? e->crc_extra : 0, checksum);
+		message.checksum = checksum;
+
+		const uint8_t *ck = p + header_len + payload_len;
+		message.ck[0] = ck[0];
+		message.ck[1] = ck[1];
+
+		Framing framing;
+		bool rejected = false;
+		auto own_signing = signing_p();
+		if (ck[0] != (checksum & 0xff) || ck[1] != (checksum >> 8)) {
+			framing = Framing::bad_crc;
+		}
+		else if (own_signing) {
+			std::memcpy(message.signature, ck + MAVLINK_NUM_CHECKSUM_BYTES, signature_len);
+			framing = own_signing->verify(message);
+			rejected = framing != Framing::ok;
+		}
+		else if (signature_len > 0) {
+			std::memcpy(message.signature, ck + MAVLINK_NUM_CHECKSUM_BYTES, signature_len);
+
+			auto signing = m_status.signing;
+			bool sig_ok = mavlink::mavlink_signature_check(signing, m_status.signing_streams, &message);
+			if (!sig_ok && signing && signing->accept_unsigned_callback &&
+					signing->accept_unsigned_callback(&m_status, message.msgid))
+				sig_ok = true;
+
+			framing = (sig_ok) ? Framing::ok : Framing::bad_signature;
+		}
+		else {
+			auto signing = m_status.signing;
+			if (signing && (signing->accept_unsigned_callback == nullptr ||
+					!signing->accept_unsigned_callback(&m_status, message.msgid)))
+				framing = Framing::bad_signature;
+			else
+				framing = Framing::ok;
+		}
+
+		if (framing == Framing::ok) {
+			m_status.current_rx_seq = message.seq;
+			if (m_status.packet_rx_success_count == 0)
+				m_status.packet_rx_drop_count = 0;
+			m_status.packet_rx_success_count++;
+
+			p += frame_len;
+		}
+		else if (rejected) {
+			// good frame with wrong, replayed or missing signature, skipped as whole
+			p += frame_len;
+		}
+		else {
+			// resync like parse_buffer_char(): error reported on CRC byte
+			// (or last signature byte), and if that byte is STX it starts new frame.
+			const uint8_t *last = (framing == Framing::bad_crc || signature_len == 0) ? ck + 1 : p + frame_len - 1;
+
+			mavlink::_mav_parse_error(&m_status);
+			p = (*last == MAVLINK_STX) ? last : last + 1;
+		}
+
+		rx_commit(pfx, message, framing);
 	}
 }
 
 void MAVConnInterface::log_recv(const char *pfx, mavlink_message_t &msg, Framing framing)
 {
+	if (console_bridge::getLogLevel() > console_bridge::CONSOLE_BRIDGE_LOG_DEBUG)
+		return;
+
 	const char *framing_str = (framing == Framing::ok) ? "OK" :
 			(framing == Framing::bad_crc) ? "!CRC" :
 			(framing == Framing::bad_signature) ? "!SIG" : "ERR";
@@ -142,6 +508,9 @@ void MAVConnInterface::log_recv(const char *pfx, mavlink_message_t &msg, Framing
 
 void MAVConnInterface::log_send(const char *pfx, const mavlink_message_t *msg)
 {
+	if (console_bridge::getLogLevel() > console_bridge::CONSOLE_BRIDGE_LOG_DEBUG)
+		return;
+
 	const char *proto_version_str = (msg->magic == MAVLINK_STX) ? "v2.0" : "v1.0";
 
 	CONSOLE_BRIDGE_logDebug("%s%zu: send: %s Message-Id: %u [%u bytes] IDs: %u.%u Seq: %u",
@@ -152,9 +521,86 @@ void MAVConnInterface::log_send(const char *pfx, const mavlink_message_t *msg)
 
 void MAVConnInterface::log_send_obj(const char *pfx, const mavlink::Message &msg)
 {
+	// to_yaml() is expensive, do not build string which will be filtered anyway
+	if (console_bridge::getLogLevel() > console_bridge::CONSOLE_BRIDGE_LOG_DEBUG)
+		return;
+
 	CONSOLE_BRIDGE_logDebug("%s%zu: send: %s", pfx, conn_id, msg.to_yaml().c_str());
 }
 
+void MAVConnInterface::set_trace(size_t capacity)
+{
+#ifdef MAVCONN_TRACE
+	if (capacity == 0) {
+		m_trace = nullptr;
+		return;
+	}
+
+	if (!m_trace_storage)
+		m_trace_storage = std::make_shared<TraceRing>(capacity);
+
+	m_trace = m_trace_storage.get();
+#else
+	if (capacity > 0)
+		CONSOLE_BRIDGE_logWarn(PFX "%zu: tracing disabled at build time", conn_id);
+#endif
+}
+
+void MAVConnInterface::set_recorder(std::shared_ptr<TlogRecorder> recorder)
+{
+	m_recording = false;
+	std::atomic_store(&m_recorder, recorder);
+	m_recording = bool(recorder);
+}
+
+void MAVConnInterface::set_signing(std::shared_ptr<MessageSigning> signing)
+{
+	m_signing = signing.get();
+	m_signing_storage = std::move(signing);
+}
+
+void MAVConnInterface::set_link_probe(std::shared_ptr<LinkProbe> probe)
+{
+	m_probe = probe.get();
+	m_probe_storage = std::move(probe);
+}
+
+void MAVConnInterface::probe_send(LinkProbe *probe)
+{
+	mavlink::common::msg::PING ping {};
+	if (!probe->poll(LinkProbe::clock::now(), ping))
+		return;
+
+	send_message_ignore_drop(ping, probe->get_options().compid);
+}
+
+void MAVConnInterface::record_obj(const mavlink::Message &message, uint8_t seq, uint8_t source_compid)
+{
+	mavlink_message_t msg;
+	mavlink::MsgMap map(msg);
+	auto mi = message.get_message_info();
+
+	// same header as queued frame
+	auto status = *get_status_p();
+	status.current_tx_seq = seq;
+
+	message.serialize(map);
+	mavlink::mavlink_finalize_message_buffer(&msg, sys_id, source_compid, &status,
+			mi.min_length, mi.length, mi.crc_extra);
+
+	record(msg, rx_stamp_now());
+}
+
+void MAVConnInterface::add_tx_lane(TxPolicy policy, const std::vector<mavlink::msgid_t> &msgids, size_t capacity)
+{
+	CONSOLE_BRIDGE_logWarn(PFX "%zu: Tx lanes are not supported by this connection", conn_id);
+}
+
+void MAVConnInterface::set_tx_flow_control(bool enable, const TxFlowControl::Options &opts)
+{
+	tx_flow.configure(enable, opts, TxShaper::DEFAULT_PRIORITY);
+}
+
 void MAVConnInterface::send_message_ignore_drop(const mavlink::mavlink_message_t *msg)
 {
 	try {
@@ -233,38 +679,396 @@ static void url_parse_host(std::string host,
 	port_out = std::stoi(port);
 }
 
+/**
+ * Split query to key=value pairs
+ */
+static std::vector<std::pair<std::string, std::string> > url_split_query(const std::string &query)
+{
+	std::vector<std::pair<std::string, std::string> > ret;
+	std::istringstream ss(query);
+	std::string arg;
+
+	while (std::getline(ss, arg, '&')) {
+		if (arg.empty())
+			continue;
+
+		auto eq_pos = arg.find('=');
+		if (eq_pos == std::string::npos)
+			ret.emplace_back(arg, "");
+		else
+			ret.emplace_back(arg.substr(0, eq_pos), arg.substr(eq_pos + 1));
+	}
+
+	return ret;
+}
+
 /**
  * Parse ?ids=sid,cid
  */
 static void url_parse_query(std::string query, uint8_t &sysid, uint8_t &compid)
 {
-	const std::string ids_end("ids=");
-	std::string sys, comp;
+	for (auto &kv : url_split_query(query)) {
+		if (kv.first != "ids")
+			continue;
+
+		auto comma_pos = kv.second.find(',');
+		if (comma_pos == std::string::npos) {
+			CONSOLE_BRIDGE_logError(PFX "URL: no comma in ids= query");
+			return;
+		}
+
+		sysid = std::stoi(kv.second.substr(0, comma_pos));
+		compid = std::stoi(kv.second.substr(comma_pos + 1));
+
+		CONSOLE_BRIDGE_logDebug(PFX "URL: found system/component id = [%u, %u]", sysid, compid);
+	}
+}
+
+/**
+ * Parse ?pool=name[:threads[:cpu,cpu...]]
+ *
+ * @return shared pool or nullptr if not requested
+ */
+static IOPool::Ptr url_parse_pool(std::string query)
+{
+	for (auto &kv : url_split_query(query)) {
+		if (kv.first != "pool")
+			continue;
+
+		auto &value = kv.second;
+		auto colon1 = value.find(':');
+		auto name = value.substr(0, colon1);
+		size_t nthreads = 0;
+		std::vector<int> cpus;
+
+		if (name.empty()) {
+			CONSOLE_BRIDGE_logError(PFX "URL: empty pool name");
+			return nullptr;
+		}
+
+		if (colon1 != std::string::npos) {
+			auto colon2 = value.find(':', colon1 + 1);
+			nthreads = std::stoul(value.substr(colon1 + 1, colon2 - colon1 - 1));
+
+			if (colon2 != std::string::npos) {
+				std::istringstream ss(value.substr(colon2 + 1));
+				std::string cpu;
+				while (std::getline(ss, cpu, ','))
+					cpus.push_back(std::stoi(cpu));
+			}
+		}
+
+		CONSOLE_BRIDGE_logDebug(PFX "URL: IO pool %s", name.c_str());
+		return IOPool::get(name, nthreads, cpus);
+	}
+
+	return nullptr;
+}
+
+/**
+ * Parse lane=never|latest|oldest:msgid,msgid...[:capacity]
+ */
+static void url_parse_lane(std::string value, MAVConnInterface::Ptr conn)
+{
+	static const std::unordered_map<std::string, TxPolicy> policies{{
+		{"never", TxPolicy::NEVER_DROP},
+		{"latest", TxPolicy::REPLACE_LATEST},
+		{"oldest", TxPolicy::DROP_OLDEST},
+	}};
+
+	auto colon1 = value.find(':');
+	if (colon1 == std::string::npos) {
+		CONSOLE_BRIDGE_logError(PFX "URL: no message ids in lane= query");
+		return;
+	}
 
-	if (query.empty())
+	auto policy_it = policies.find(value.substr(0, colon1));
+	if (policy_it == policies.end()) {
+		CONSOLE_BRIDGE_logError(PFX "URL: unknown lane policy: %s", value.substr(0, colon1).c_str());
 		return;
+	}
+
+	auto colon2 = value.find(':', colon1 + 1);
+	auto ids = value.substr(colon1 + 1, colon2 - colon1 - 1);
+	size_t capacity = MAVConnInterface::DEFAULT_TX_LANE_SIZE;
+	if (colon2 != std::string::npos)
+		capacity = std::stoul(value.substr(colon2 + 1));
+
+	std::vector<mavlink::msgid_t> msgids;
+	std::istringstream ss(ids);
+	std::string id;
+	while (std::getline(ss, id, ','))
+		msgids.push_back(std::stoul(id));
+
+	CONSOLE_BRIDGE_logDebug(PFX "URL: lane %s: %zu messages, capacity %zu",
+			policy_it->first.c_str(), msgids.size(), capacity);
+	conn->add_tx_lane(policy_it->second, msgids, capacity);
+}
+
+/**
+ * Parse tlog=path[:max_file_bytes[:max_files]]
+ */
+static void url_parse_tlog(std::string value, MAVConnInterface::Ptr conn)
+{
+	auto colon1 = value.find(':');
+	TlogRecorder::Options opts(value.substr(0, colon1));
+
+	if (colon1 != std::string::npos) {
+		auto colon2 = value.find(':', colon1 + 1);
+		opts.max_file_bytes = std::stoul(value.substr(colon1 + 1, colon2 - colon1 - 1));
+		if (colon2 != std::string::npos)
+			opts.max_files = std::stoul(value.substr(colon2 + 1));
+	}
 
-	auto ids_it = std::search(query.begin(), query.end(),
-			ids_end.begin(), ids_end.end());
-	if (ids_it == query.end()) {
-		CONSOLE_BRIDGE_logWarn(PFX "URL: unknown query arguments");
+	try {
+		conn->set_recorder(std::make_shared<TlogRecorder>(opts));
+	}
+	catch (std::system_error &ex) {
+		CONSOLE_BRIDGE_logError(PFX "URL: tlog: %s", ex.what());
+	}
+}
+
+/**
+ * Parse sign=keyfile[:link_id[:window_sec]]
+ *
+ * Key is read from file (64 hex digits or passphrase),
+ * so secret does not appear in URL and in logs.
+ */
+static void url_parse_signing(std::string value, bool accept_unsigned, MAVConnInterface::Ptr conn)
+{
+	auto colon1 = value.find(':');
+	auto path = value.substr(0, colon1);
+	MessageSigning::Options opts;
+
+	if (colon1 != std::string::npos) {
+		auto colon2 = value.find(':', colon1 + 1);
+		opts.link_id = std::stoul(value.substr(colon1 + 1, colon2 - colon1 - 1));
+		if (colon2 != std::string::npos)
+			opts.timestamp_window = std::chrono::seconds(std::stoul(value.substr(colon2 + 1)));
+	}
+
+	std::ifstream file(path);
+	std::string secret;
+	if (!std::getline(file, secret) || secret.empty()) {
+		CONSOLE_BRIDGE_logError(PFX "URL: sign: can't read key from %s", path.c_str());
 		return;
 	}
 
-	std::advance(ids_it, ids_end.length());
-	auto comma_it = std::find(ids_it, query.end(), ',');
-	if (comma_it == query.end()) {
-		CONSOLE_BRIDGE_logError(PFX "URL: no comma in ids= query");
+	opts.key = MessageSigning::key_from_string(secret);
+	opts.accept_unsigned = accept_unsigned;
+	conn->set_signing(std::make_shared<MessageSigning>(opts));
+}
+
+/**
+ * Parse probe=interval_sec[:compid]
+ */
+static void url_parse_probe(std::string value, MAVConnInterface::Ptr conn)
+{
+	if (std::dynamic_pointer_cast<MAVConnBond>(conn)) {
+		CONSOLE_BRIDGE_logWarn(PFX "URL: probe= of bond, set it on member links");
+		return;
+	}
+
+	auto colon = value.find(':');
+	LinkProbe::Options opts;
+	opts.interval = std::chrono::duration_cast<LinkProbe::clock::duration>(
+			std::chrono::duration<float>(std::stof(value.substr(0, colon))));
+	// reply later than three intervals is taken as lost
+	opts.timeout = std::max<LinkProbe::clock::duration>(opts.timeout, 3 * opts.interval);
+	if (colon != std::string::npos)
+		opts.compid = std::stoul(value.substr(colon + 1));
+
+	CONSOLE_BRIDGE_logDebug(PFX "URL: probe every %s s from component %u",
+			value.substr(0, colon).c_str(), opts.compid);
+	conn->set_link_probe(std::make_shared<LinkProbe>(opts));
+}
+
+/**
+ * Parse allow=msgid,... or deny=msgid,... and rate=msgid:hz,...
+ */
+static void url_parse_filter(const std::string &key, std::string value, MAVConnInterface::Ptr conn)
+{
+	auto filter = conn->get_rx_filter();
+	std::istringstream ss(value);
+	std::string item;
+
+	if (key == "rate") {
+		std::vector<RxFilter::RateLimit> limits;
+		while (std::getline(ss, item, ',')) {
+			auto colon = item.find(':');
+			if (colon == std::string::npos) {
+				CONSOLE_BRIDGE_logError(PFX "URL: no rate in rate= item: %s", item.c_str());
+				continue;
+			}
+
+			limits.push_back(RxFilter::RateLimit {
+					mavlink::msgid_t(std::stoul(item.substr(0, colon))),
+					std::stof(item.substr(colon + 1)) });
+		}
+
+		filter->set_rate_limits(limits);
 		return;
 	}
 
-	sys.assign(ids_it, comma_it);
-	comp.assign(comma_it + 1, query.end());
+	std::vector<mavlink::msgid_t> msgids;
+	while (std::getline(ss, item, ','))
+		msgids.push_back(std::stoul(item));
+
+	filter->set_mode((key == "allow") ? RxFilter::Mode::ALLOW : RxFilter::Mode::DENY, msgids);
+}
+
+/**
+ * Apply common query options to constructed connection
+ *
+ * ?parser=char|block&gather=bytes&batch=N&lane=policy:msgid,...[:capacity]&trace=N&peers=N&peer_timeout=sec
+ * &tlog=path[:max_file_bytes[:max_files]]
+ * &sign=keyfile[:link_id[:window_sec]]&sign_unsigned=0|1
+ * &probe=interval_sec[:compid]
+ * &allow=msgid,...|deny=msgid,...&rate=msgid:hz,...
+ * &sched=fifo:prio|rr:prio|other&cpus=cpu,first-last,...  (IO threads, whole pool if shared)
+ * serial only: &low_latency=0|1&vmin=N&vtime=N&rx_buf=bytes&rt_prio=N
+ * file only: &speed=scale&capture=path&delay=sec
+ */
+static void url_parse_options(std::string query, MAVConnInterface::Ptr conn)
+{
+	size_t max_peers = MAVConnUDP::DEFAULT_MAX_PEERS;
+	float peer_timeout = MAVConnUDP::DEFAULT_PEER_TIMEOUT;
+	bool peer_limits = false;
+	auto serial = std::dynamic_pointer_cast<MAVConnSerial>(conn);
+	auto file = std::dynamic_pointer_cast<MAVConnFile>(conn);
+	int vmin = -1, vtime = 0;
+	std::string sched_policy, sched_cpus;
+	std::string sign;
+	bool sign_unsigned = false;
+
+	for (auto &kv : url_split_query(query)) {
+		auto &key = kv.first;
+		auto &value = kv.second;
+
+		if (key == "ids" || key == "pool") {
+			// already processed by url_parse_query() and url_parse_pool()
+		}
+		else if (file && (key == "speed" || key == "capture" || key == "delay")) {
+			// already processed by url_parse_file()
+		}
+		else if (key == "parser") {
+			if (value == "block")
+				conn->set_parser(Parser::BLOCK);
+			else if (value == "char")
+				conn->set_parser(Parser::CHAR);
+			else
+				CONSOLE_BRIDGE_logWarn(PFX "URL: unknown parser: %s", value.c_str());
+		}
+		else if (key == "gather") {
+			conn->set_tx_gather_bytes(std::stoul(value));
+		}
+		else if (key == "trace") {
+			conn->set_trace(std::stoul(value));
+		}
+		else if (key == "tlog") {
+			url_parse_tlog(value, conn);
+		}
+		else if (key == "sign") {
+			sign = value;
+		}
+		else if (key == "sign_unsigned") {
+			sign_unsigned = std::stoi(value) != 0;
+		}
+		else if (key == "probe") {
+			url_parse_probe(value, conn);
+		}
+		else if (key == "lane") {
+			url_parse_lane(value, conn);
+		}
+		else if (key == "allow" || key == "deny" || key == "rate") {
+			url_parse_filter(key, value, conn);
+		}
+		else if (key == "sched") {
+			sched_policy = value;
+		}
+		else if (key == "cpus") {
+			sched_cpus = value;
+		}
+		else if (key == "peers") {
+			max_peers = std::stoul(value);
+			peer_limits = true;
+		}
+		else if (key == "peer_timeout") {
+			peer_timeout = std::stof(value);
+			peer_limits = true;
+		}
+		else if (key == "batch") {
+			auto udp = std::dynamic_pointer_cast<MAVConnUDP>(conn);
+			if (udp)
+				udp->set_batch_size(std::stoul(value));
+			else
+				CONSOLE_BRIDGE_logWarn(PFX "URL: batch= supported only by udp");
+		}
+		else if (key == "low_latency" || key == "vmin" || key == "vtime" || key == "rx_buf" || key == "rt_prio") {
+			if (!serial)
+				CONSOLE_BRIDGE_logWarn(PFX "URL: %s= supported only by serial", key.c_str());
+			else if (key == "low_latency")
+				serial->set_low_latency(std::stoi(value) != 0);
+			else if (key == "vmin")
+				vmin = std::stoi(value);
+			else if (key == "vtime")
+				vtime = std::stoi(value);
+			else if (key == "rx_buf")
+				serial->set_rx_buffer_size(std::stoul(value));
+			else
+				serial->set_rt_read_thread(std::stoi(value));
+		}
+		else {
+			CONSOLE_BRIDGE_logWarn(PFX "URL: unknown query argument: %s", key.c_str());
+		}
+	}
+
+	if (!sign.empty())
+		url_parse_signing(sign, sign_unsigned, conn);
+	else if (sign_unsigned)
+		CONSOLE_BRIDGE_logWarn(PFX "URL: sign_unsigned= without sign=");
+
+	if (serial && vmin >= 0)
+		serial->set_read_timing(vmin, vtime);
+
+	if (!sched_policy.empty() || !sched_cpus.empty()) {
+		try {
+			auto sched = utils::ThreadSched::parse(sched_policy, sched_cpus);
+			int ret = conn->set_io_sched(sched);
+			if (ret != 0)
+				CONSOLE_BRIDGE_logWarn(PFX "URL: IO threads %s: %s", sched.to_string().c_str(), strerror(ret));
+			else
+				CONSOLE_BRIDGE_logInform(PFX "URL: IO threads %s", sched.to_string().c_str());
+		}
+		catch (std::invalid_argument &ex) {
+			CONSOLE_BRIDGE_logError(PFX "URL: sched/cpus: %s", ex.what());
+		}
+	}
+
+	if (peer_limits) {
+		auto udp = std::dynamic_pointer_cast<MAVConnUDP>(conn);
+		if (udp && udp->is_server())
+			udp->set_peer_limits(max_peers, peer_timeout);
+		else
+			CONSOLE_BRIDGE_logWarn(PFX "URL: peers= and peer_timeout= supported only by udp-s");
+	}
+}
+
+static MAVConnInterface::Ptr url_parse_udp_server(
+		std::string host, std::string query,
+		uint8_t system_id, uint8_t component_id)
+{
+	std::string bind_host;
+	int bind_port;
 
-	sysid = std::stoi(sys);
-	compid = std::stoi(comp);
+	// udp-s://0.0.0.0:14550
+	url_parse_host(host, bind_host, bind_port, "0.0.0.0", MAVConnUDP::DEFAULT_REMOTE_PORT);
+	url_parse_query(query, system_id, component_id);
 
-	CONSOLE_BRIDGE_logDebug(PFX "URL: found system/component id = [%u, %u]", sysid, compid);
+	return std::make_shared<MAVConnUDP>(system_id, component_id,
+			bind_host, bind_port,
+			std::string(MAVConnUDP::SERVER_REMOTE_HOST), 0,
+			url_parse_pool(query));
 }
 
 static MAVConnInterface::Ptr url_parse_serial(
@@ -279,7 +1083,7 @@ static MAVConnInterface::Ptr url_parse_serial(
 	url_parse_query(query, system_id, component_id);
 
 	return std::make_shared<MAVConnSerial>(system_id, component_id,
-			file_path, baudrate, hwflow);
+			file_path, baudrate, hwflow, url_parse_pool(query));
 }
 
 static MAVConnInterface::Ptr url_parse_udp(
@@ -309,7 +1113,8 @@ static MAVConnInterface::Ptr url_parse_udp(
 
 	return std::make_shared<MAVConnUDP>(system_id, component_id,
 			bind_host, bind_port,
-			remote_host, remote_port);
+			remote_host, remote_port,
+			url_parse_pool(query));
 }
 
 static MAVConnInterface::Ptr url_parse_tcp_client(
@@ -324,7 +1129,7 @@ static MAVConnInterface::Ptr url_parse_tcp_client(
 	url_parse_query(query, system_id, component_id);
 
 	return std::make_shared<MAVConnTCPClient>(system_id, component_id,
-			server_host, server_port);
+			server_host, server_port, url_parse_pool(query));
 }
 
 static MAVConnInterface::Ptr url_parse_tcp_server(
@@ -339,7 +1144,45 @@ static MAVConnInterface::Ptr url_parse_tcp_server(
 	url_parse_query(query, system_id, component_id);
 
 	return std::make_shared<MAVConnTCPServer>(system_id, component_id,
-			bind_host, bind_port);
+			bind_host, bind_port, url_parse_pool(query));
+}
+
+static MAVConnInterface::Ptr url_parse_shm(
+		std::string host, std::string query,
+		uint8_t system_id, uint8_t component_id, bool in_process)
+{
+	// shm://mavlink or local://mavlink
+	if (host.empty())
+		host = MAVConnSHM::DEFAULT_NAME;
+
+	url_parse_query(query, system_id, component_id);
+
+	return std::make_shared<MAVConnSHM>(system_id, component_id, host, in_process);
+}
+
+static MAVConnInterface::Ptr url_parse_file(
+		std::string path, std::string query,
+		uint8_t system_id, uint8_t component_id)
+{
+	float speed = 1.0, start_delay = MAVConnFile::DEFAULT_START_DELAY;
+	std::string capture;
+
+	// file:///var/log/flight.tlog?speed=0&capture=/tmp/sent.tlog
+	url_parse_query(query, system_id, component_id);
+	for (auto &kv : url_split_query(query)) {
+		if (kv.first == "speed")
+			speed = std::stof(kv.second);
+		else if (kv.first == "capture")
+			capture = kv.second;
+		else if (kv.first == "delay")
+			start_delay = std::stof(kv.second);
+	}
+
+	if (path.empty())
+		throw DeviceError("url", "file path not given");
+
+	return std::make_shared<MAVConnFile>(system_id, component_id,
+			path, speed, capture, start_delay);
 }
 
 MAVConnInterface::Ptr MAVConnInterface::open_url(std::string url,
@@ -349,6 +1192,19 @@ MAVConnInterface::Ptr MAVConnInterface::open_url(std::string url,
 	 * http://stackoverflow.com/questions/2616011/easy-way-to-parse-a-url-in-c-cross-platform
 	 */
 
+	// redundant links: url|url...
+	if (url.find(MAVConnBond::URL_SEPARATOR) != std::string::npos) {
+		std::vector<std::string> urls;
+		std::stringstream ss(url);
+		std::string member;
+
+		while (std::getline(ss, member, MAVConnBond::URL_SEPARATOR))
+			if (!member.empty())
+				urls.push_back(member);
+
+		return std::make_shared<MAVConnBond>(system_id, component_id, urls);
+	}
+
 	const std::string proto_end("://");
 	std::string proto;
 	std::string host;
@@ -388,21 +1244,34 @@ MAVConnInterface::Ptr MAVConnInterface::open_url(std::string url,
 			url.c_str(), proto.c_str(), host.c_str(),
 			path.c_str(), query.c_str());
 
+	MAVConnInterface::Ptr conn;
 	if (proto == "udp")
-		return url_parse_udp(host, query, system_id, component_id, false, false);
+		conn = url_parse_udp(host, query, system_id, component_id, false, false);
 	else if (proto == "udp-b")
-		return url_parse_udp(host, query, system_id, component_id, true, false);
+		conn = url_parse_udp(host, query, system_id, component_id, true, false);
 	else if (proto == "udp-pb")
-		return url_parse_udp(host, query, system_id, component_id, true, true);
+		conn = url_parse_udp(host, query, system_id, component_id, true, true);
+	else if (proto == "udp-s")
+		conn = url_parse_udp_server(host, query, system_id, component_id);
 	else if (proto == "tcp")
-		return url_parse_tcp_client(host, query, system_id, component_id);
+		conn = url_parse_tcp_client(host, query, system_id, component_id);
 	else if (proto == "tcp-l")
-		return url_parse_tcp_server(host, query, system_id, component_id);
+		conn = url_parse_tcp_server(host, query, system_id, component_id);
 	else if (proto == "serial")
-		return url_parse_serial(path, query, system_id, component_id, false);
+		conn = url_parse_serial(path, query, system_id, component_id, false);
+	else if (proto == "shm")
+		conn = url_parse_shm(host, query, system_id, component_id, false);
+	else if (proto == "local")
+		conn = url_parse_shm(host, query, system_id, component_id, true);
+	else if (proto == "file")
+		// relative path starts in host part, which is lowercased
+		conn = url_parse_file(std::string(proto_it, path_it) + path, query, system_id, component_id);
 	else if (proto == "serial-hwfc")
-		return url_parse_serial(path, query, system_id, component_id, true);
+		conn = url_parse_serial(path, query, system_id, component_id, true);
 	else
 		throw DeviceError("url", "Unknown URL type");
+
+	url_parse_options(query, conn);
+	return conn;
 }
 }	// namespace mavconn
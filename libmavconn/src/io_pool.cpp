@@ -0,0 +1,153 @@
+/**
+ * @brief MAVConn IO thread pool
+ * @file io_pool.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <future>
+#include <cstring>
+
+#include <mavconn/console_bridge_compat.h>
+#include <mavconn/thread_utils.h>
+#include <mavconn/io_pool.h>
+
+namespace mavconn {
+
+#define PFX	"mavconn: pool: "
+
+std::mutex IOPool::registry_mutex;
+std::map<std::string, std::weak_ptr<IOPool>> IOPool::registry;
+
+//! pool of current thread, used to prevent self-wait in sync()
+static thread_local IOPool *this_thread_pool = nullptr;
+
+
+IOPool::IOPool(size_t nthreads, const std::string &thread_name, const std::vector<int> &cpus) :
+	io_service(),
+	io_work(new boost::asio::io_service::work(io_service))
+{
+	if (nthreads == 0)
+		nthreads = 1;
+
+	for (size_t i = 0; i < nthreads; i++) {
+		threads.emplace_back([this, i, nthreads, thread_name] () {
+				if (nthreads > 1)
+					utils::set_this_thread_name("%s%zu", thread_name.c_str(), i);
+				else
+					utils::set_this_thread_name("%s", thread_name.c_str());
+
+				this_thread_pool = this;
+				io_service.run();
+			});
+
+		if (cpus.empty())
+			continue;
+
+		int cpu = cpus[i % cpus.size()];
+#ifdef __linux__
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		CPU_SET(cpu, &cpuset);
+
+		int ret = pthread_setaffinity_np(threads.back().native_handle(), sizeof(cpuset), &cpuset);
+		if (ret != 0)
+			CONSOLE_BRIDGE_logWarn(PFX "%s: failed to pin thread to CPU %d: %s",
+					thread_name.c_str(), cpu, strerror(ret));
+#else
+		CONSOLE_BRIDGE_logWarn(PFX "%s: CPU pinning is not supported on this system", thread_name.c_str());
+#endif
+	}
+}
+
+IOPool::~IOPool()
+{
+	stop();
+}
+
+void IOPool::stop()
+{
+	std::call_once(stop_once, [this] () {
+			io_work.reset();
+			io_service.stop();
+
+			std::lock_guard<std::mutex> lock(threads_mutex);
+			for (auto &th : threads) {
+				// close() may be called from connection handler
+				if (th.get_id() == std::this_thread::get_id())
+					th.detach();
+				else if (th.joinable())
+					th.join();
+			}
+
+			threads.clear();
+
+			io_service.reset();
+		});
+}
+
+void IOPool::sync(boost::asio::io_service::strand &strand)
+{
+	if (this_thread_pool == this || io_service.stopped())
+		return;
+
+	std::promise<void> done;
+	auto done_future = done.get_future();
+
+	strand.post([&done] () { done.set_value(); });
+	done_future.wait();
+}
+
+int IOPool::set_sched(const utils::ThreadSched &sched)
+{
+	std::lock_guard<std::mutex> lock(threads_mutex);
+
+	int first_err = 0;
+	for (auto &th : threads) {
+		int ret = utils::set_thread_sched(th.native_handle(), sched);
+		if (ret != 0 && first_err == 0)
+			first_err = ret;
+	}
+
+	return first_err;
+}
+
+std::vector<utils::ThreadSched> IOPool::get_sched()
+{
+	std::lock_guard<std::mutex> lock(threads_mutex);
+	std::vector<utils::ThreadSched> ret;
+
+	for (auto &th : threads)
+		ret.push_back(utils::get_thread_sched(th.native_handle()));
+
+	return ret;
+}
+
+IOPool::Ptr IOPool::get(const std::string &name, size_t nthreads, const std::vector<int> &cpus)
+{
+	std::lock_guard<std::mutex> lock(registry_mutex);
+
+	auto pool = registry[name].lock();
+	if (pool)
+		return pool;
+
+	if (nthreads == 0)
+		nthreads = std::max(1U, std::thread::hardware_concurrency());
+
+	CONSOLE_BRIDGE_logInform(PFX "%s: starting %zu threads", name.c_str(), nthreads);
+
+	pool = std::make_shared<IOPool>(nthreads, "mio-" + name, cpus);
+	registry[name] = pool;
+	return pool;
+}
+}	// namespace mavconn
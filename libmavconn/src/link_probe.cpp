@@ -0,0 +1,155 @@
+/**
+ * @brief MAVConn active link probing
+ * @file link_probe.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <mavconn/link_probe.h>
+
+namespace mavconn {
+
+using mavlink::mavlink_message_t;
+
+static constexpr auto RLX = std::memory_order_relaxed;
+
+//! EWMA gains of RFC 6298
+static constexpr float RTT_GAIN = 1.0f / 8;
+static constexpr float JITTER_GAIN = 1.0f / 4;
+//! Loss is averaged over about 16 probes
+static constexpr float LOSS_GAIN = 1.0f / 16;
+
+constexpr size_t LinkProbe::MAX_OUTSTANDING;
+constexpr uint8_t LinkProbe::DEFAULT_COMPID;
+
+LinkProbe::LinkProbe(const Options &opts_) :
+	opts(opts_),
+	pending{},
+	next_seq(0),
+	next_probe{},
+	sent(0),
+	received(0),
+	lost(0),
+	rtt_ms(0.0f),
+	jitter_ms(0.0f),
+	rtt_min_ms(0.0f),
+	loss(0.0f)
+{ }
+
+void LinkProbe::loss_sample(float lost_)
+{
+	// single writer, Rx thread
+	float l = loss.load(RLX);
+	loss.store(l + (lost_ - l) * LOSS_GAIN, RLX);
+}
+
+void LinkProbe::expire(clock::time_point now)
+{
+	for (auto &p : pending) {
+		if (p.waiting && now - p.sent > opts.timeout) {
+			p.waiting = false;
+			lost.fetch_add(1, RLX);
+			loss_sample(1.0f);
+		}
+	}
+}
+
+bool LinkProbe::poll(clock::time_point now, mavlink::common::msg::PING &ping)
+{
+	if (now < next_probe)
+		return false;
+
+	next_probe = now + opts.interval;
+	expire(now);
+
+	auto &p = pending[next_seq % MAX_OUTSTANDING];
+	if (p.waiting) {
+		// timeout longer than MAX_OUTSTANDING intervals
+		lost.fetch_add(1, RLX);
+		loss_sample(1.0f);
+	}
+
+	p = Pending { next_seq, now, true };
+
+	ping.time_usec = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+	ping.seq = next_seq++;
+	ping.target_system = 0;		// broadcast, remote answers to sender
+	ping.target_component = 0;
+
+	sent.fetch_add(1, RLX);
+	return true;
+}
+
+bool LinkProbe::reply(const mavlink_message_t &msg, uint8_t sysid, clock::time_point now)
+{
+	mavlink::common::msg::PING ping;
+	mavlink::MsgMap map(&msg);
+	ping.deserialize(map);
+
+	if (ping.target_system != sysid || ping.target_component != opts.compid)
+		return false;
+
+	auto &p = pending[ping.seq % MAX_OUTSTANDING];
+	if (!p.waiting || p.seq != ping.seq)
+		return true;	// own late or duplicated reply, already counted as lost
+
+	p.waiting = false;
+	received.fetch_add(1, RLX);
+	loss_sample(0.0f);
+
+	float rtt = std::chrono::duration<float, std::milli>(now - p.sent).count();
+	float srtt = rtt_ms.load(RLX);
+	if (srtt <= 0.0f) {
+		rtt_ms.store(std::max(rtt, 1e-3f), RLX);
+		jitter_ms.store(rtt / 2, RLX);
+		rtt_min_ms.store(rtt, RLX);
+		return true;
+	}
+
+	float jitter = jitter_ms.load(RLX);
+	jitter_ms.store(jitter + (std::fabs(rtt - srtt) - jitter) * JITTER_GAIN, RLX);
+	rtt_ms.store(std::max(srtt + (rtt - srtt) * RTT_GAIN, 1e-3f), RLX);
+	if (rtt < rtt_min_ms.load(RLX))
+		rtt_min_ms.store(rtt, RLX);
+
+	return true;
+}
+
+LinkProbe::Stats LinkProbe::get_stats() const
+{
+	Stats ret;
+
+	ret.sent = sent.load(RLX);
+	ret.received = received.load(RLX);
+	ret.lost = lost.load(RLX);
+	ret.rtt_ms = rtt_ms.load(RLX);
+	ret.jitter_ms = jitter_ms.load(RLX);
+	ret.rtt_min_ms = rtt_min_ms.load(RLX);
+	ret.loss = loss.load(RLX);
+
+	return ret;
+}
+
+LinkProbe::clock::duration LinkProbe::timeout(clock::duration def, clock::duration min, clock::duration max) const
+{
+	float rtt = rtt_ms.load(RLX);
+	if (rtt <= 0.0f)
+		return def;
+
+	auto t = std::chrono::duration_cast<clock::duration>(
+			std::chrono::duration<float, std::milli>(rtt + 4 * jitter_ms.load(RLX)));
+	return std::min(std::max(t, min), max);
+}
+}	// namespace mavconn
@@ -0,0 +1,275 @@
+/**
+ * @brief MAVConn link statistics
+ * @file link_stats.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <unordered_map>
+#include <mavconn/interface.h>
+#include <mavconn/link_stats.h>
+
+namespace mavconn {
+
+using mavlink::msgid_t;
+using mavlink::mavlink_message_t;
+
+static constexpr auto RLX = std::memory_order_relaxed;
+
+size_t LinkStats::frame_length(const mavlink_message_t &msg)
+{
+	if (msg.magic == MAVLINK_STX_MAVLINK1)
+		return MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1 + msg.len + MAVLINK_NUM_CHECKSUM_BYTES;
+
+	size_t len = MAVLINK_NUM_HEADER_BYTES + msg.len + MAVLINK_NUM_CHECKSUM_BYTES;
+	if (msg.incompat_flags & MAVLINK_IFLAG_SIGNED)
+		len += MAVLINK_SIGNATURE_BLOCK_LEN;
+
+	return len;
+}
+
+static inline void slot_init(std::atomic<uint64_t> &c)
+{
+	c.store(0, RLX);
+}
+
+LinkStats::LinkStats()
+{
+	for (auto &slot : msgs) {
+		slot.msgid.store(EMPTY_MSGID, RLX);
+		slot_init(slot.rx_count);
+		slot_init(slot.rx_bytes);
+		slot_init(slot.tx_count);
+		slot_init(slot.tx_bytes);
+	}
+
+	other_msgs.msgid.store(OTHER_MSGID, RLX);
+	slot_init(other_msgs.rx_count);
+	slot_init(other_msgs.rx_bytes);
+	slot_init(other_msgs.tx_count);
+	slot_init(other_msgs.tx_bytes);
+
+	for (auto &slot : peers) {
+		slot.key.store(0, RLX);
+		slot_init(slot.rx_count);
+		slot_init(slot.seq_lost);
+		slot.last_seq = 0;
+	}
+
+	slot_init(crc_errors);
+	slot_init(signature_errors);
+	slot_init(seq_lost);
+	slot_init(rx_filtered);
+	slot_init(tx_drops);
+	slot_init(tx_high_water);
+}
+
+LinkStats::MsgSlot &LinkStats::msg_slot(msgid_t msgid)
+{
+	size_t idx = (msgid * 2654435761U) % MSG_SLOTS;
+
+	for (size_t i = 0; i < MSG_SLOTS; i++, idx = (idx + 1) % MSG_SLOTS) {
+		auto &slot = msgs[idx];
+		auto key = slot.msgid.load(std::memory_order_acquire);
+		if (key == msgid)
+			return slot;
+
+		if (key == EMPTY_MSGID) {
+			if (slot.msgid.compare_exchange_strong(key, msgid, std::memory_order_acq_rel))
+				return slot;
+			// other thread took the slot, it may be for the same id
+			if (key == msgid)
+				return slot;
+		}
+	}
+
+	return other_msgs;
+}
+
+LinkStats::PeerSlot *LinkStats::peer_slot(uint32_t key)
+{
+	size_t idx = (key * 2654435761U) % PEER_SLOTS;
+
+	// Rx thread is the only writer
+	for (size_t i = 0; i < PEER_SLOTS; i++, idx = (idx + 1) % PEER_SLOTS) {
+		auto &slot = peers[idx];
+		auto slot_key = slot.key.load(RLX);
+		if (slot_key == key)
+			return &slot;
+
+		if (slot_key == 0) {
+			slot.key.store(key, std::memory_order_release);
+			return &slot;
+		}
+	}
+
+	return nullptr;
+}
+
+void LinkStats::rx_frame(const mavlink_message_t &msg, Framing framing)
+{
+	if (framing == Framing::bad_crc) {
+		crc_errors.fetch_add(1, RLX);
+		return;
+	}
+	else if (framing == Framing::bad_signature) {
+		signature_errors.fetch_add(1, RLX);
+		return;
+	}
+
+	auto &ms = msg_slot(msg.msgid);
+	ms.rx_count.fetch_add(1, RLX);
+	ms.rx_bytes.fetch_add(frame_length(msg), RLX);
+
+	rx_seq(msg);
+}
+
+void LinkStats::rx_filtered_frame(const mavlink_message_t &msg)
+{
+	rx_filtered.fetch_add(1, RLX);
+
+	// filtered frames still move sequence, else they are counted as lost
+	rx_seq(msg);
+}
+
+void LinkStats::rx_seq(const mavlink_message_t &msg)
+{
+	auto ps = peer_slot(0x10000 | msg.sysid << 8 | msg.compid);
+	if (ps == nullptr)
+		return;
+
+	if (ps->rx_count.load(RLX) > 0) {
+		uint8_t lost = msg.seq - ps->last_seq - 1;
+		if (lost > 0) {
+			ps->seq_lost.fetch_add(lost, RLX);
+			seq_lost.fetch_add(lost, RLX);
+		}
+	}
+
+	ps->last_seq = msg.seq;
+	ps->rx_count.fetch_add(1, RLX);
+}
+
+void LinkStats::tx_frame(msgid_t msgid, size_t bytes)
+{
+	auto &ms = msg_slot(msgid);
+	ms.tx_count.fetch_add(1, RLX);
+	ms.tx_bytes.fetch_add(bytes, RLX);
+}
+
+LinkStats::Snapshot LinkStats::snapshot() const
+{
+	Snapshot ret {};
+
+	auto add_msg = [&ret](const MsgSlot &slot, msgid_t msgid) {
+		MsgStat st {
+			msgid,
+			slot.rx_count.load(RLX),
+			slot.rx_bytes.load(RLX),
+			slot.tx_count.load(RLX),
+			slot.tx_bytes.load(RLX),
+		};
+
+		if (st.rx_count == 0 && st.tx_count == 0)
+			return;
+
+		ret.rx_count += st.rx_count;
+		ret.rx_bytes += st.rx_bytes;
+		ret.tx_count += st.tx_count;
+		ret.tx_bytes += st.tx_bytes;
+		ret.messages.push_back(st);
+	};
+
+	for (auto &slot : msgs) {
+		auto msgid = slot.msgid.load(std::memory_order_acquire);
+		if (msgid != EMPTY_MSGID)
+			add_msg(slot, msgid);
+	}
+	add_msg(other_msgs, OTHER_MSGID);
+
+	for (auto &slot : peers) {
+		auto key = slot.key.load(std::memory_order_acquire);
+		if (key == 0)
+			continue;
+
+		ret.peers.push_back(PeerStat {
+			uint8_t(key >> 8),
+			uint8_t(key),
+			slot.rx_count.load(RLX),
+			slot.seq_lost.load(RLX),
+		});
+	}
+
+	std::sort(ret.messages.begin(), ret.messages.end(),
+			[](const MsgStat &a, const MsgStat &b) { return a.msgid < b.msgid; });
+	std::sort(ret.peers.begin(), ret.peers.end(),
+			[](const PeerStat &a, const PeerStat &b) {
+				return (a.sysid << 8 | a.compid) < (b.sysid << 8 | b.compid);
+			});
+
+	ret.crc_errors = crc_errors.load(RLX);
+	ret.signature_errors = signature_errors.load(RLX);
+	ret.seq_lost = seq_lost.load(RLX);
+	ret.rx_filtered = rx_filtered.load(RLX);
+	ret.tx_drops = tx_drops.load(RLX);
+	ret.tx_queue_high_water = tx_high_water.load(RLX);
+
+	return ret;
+}
+
+void LinkStats::merge(Snapshot &dst, const Snapshot &other)
+{
+	// [[[cog:
+	// for f in ('rx_count', 'rx_bytes', 'tx_count', 'tx_bytes', 'crc_errors', 'signature_errors', 'seq_lost', 'rx_filtered', 'tx_drops'):
+	//     cog.outl("dst.{f:16s} += other.{f};".format(**locals()))
+	// ]]]
+	dst.rx_count         += other.rx_count;
+	dst.rx_bytes         += other.rx_bytes;
+	dst.tx_count         += other.tx_count;
+	dst.tx_bytes         += other.tx_bytes;
+	dst.crc_errors       += other.crc_errors;
+	dst.signature_errors += other.signature_errors;
+	dst.seq_lost         += other.seq_lost;
+	dst.rx_filtered      += other.rx_filtered;
+	dst.tx_drops         += other.tx_drops;
+	// [[[end]]] (checksum: 2ae82e3506a55d4f5d376c4d96d7ab2d)
+
+	dst.tx_queue_high_water = std::max(dst.tx_queue_high_water, other.tx_queue_high_water);
+
+	std::unordered_map<msgid_t, size_t> index;
+	for (size_t i = 0; i < dst.messages.size(); i++)
+		index[dst.messages[i].msgid] = i;
+
+	for (auto &st : other.messages) {
+		auto it = index.find(st.msgid);
+		if (it == index.end()) {
+			index[st.msgid] = dst.messages.size();
+			dst.messages.push_back(st);
+			continue;
+		}
+
+		auto &d = dst.messages[it->second];
+		d.rx_count += st.rx_count;
+		d.rx_bytes += st.rx_bytes;
+		d.tx_count += st.tx_count;
+		d.tx_bytes += st.tx_bytes;
+	}
+
+	// clients are different remotes, peers just appended
+	dst.peers.insert(dst.peers.end(), other.peers.begin(), other.peers.end());
+
+	std::sort(dst.messages.begin(), dst.messages.end(),
+			[](const MsgStat &a, const MsgStat &b) { return a.msgid < b.msgid; });
+}
+}	// namespace mavconn
@@ -20,37 +20,27 @@
 @# EmPy template of dialect helpers source file
 @#
 
-#include <mavconn/console_bridge_compat.h>
 #include <mavconn/interface.h>
+#include <mavconn/msg_entry_table.h>
 
 // AUTOMATIC GENERATED FILE!
 // from src/mavlink_helpers.cpp.em
 
 using mavconn::MAVConnInterface;
+namespace me = mavconn::msg_entry;
 
-void MAVConnInterface::init_msg_entry()
-{
-	CONSOLE_BRIDGE_logDebug("mavconn: Initialize message_entries map");
+//! MESSAGE_ENTRIES of all dialects. Order matters: entry of first dialect wins.
+static constexpr me::DialectEntries dialect_entries[] = {
+	@[for dialect in MAVLINK_V20_DIALECTS]{ &mavlink::@(dialect)::MESSAGE_ENTRIES[0], @(' ' * (20 - len(dialect)))mavlink::@(dialect)::MESSAGE_ENTRIES.size() },
+	@[end for]
+};
 
-	auto load = [&](const char *dialect, const mavlink::mavlink_msg_entry_t & e) {
-		auto it = message_entries.find(e.msgid);
-		if (it != message_entries.end()) {
-			if (memcmp(&e, it->second, sizeof(e)) != 0) {
-				CONSOLE_BRIDGE_logDebug("mavconn: init: message from %s, MSG-ID %d ignored! Table has different entry.", dialect, e.msgid);
-			}
-			else {
-				CONSOLE_BRIDGE_logDebug("mavconn: init: message from %s, MSG-ID %d in table.", dialect, e.msgid);
-			}
-		}
-		else {
-			CONSOLE_BRIDGE_logDebug("mavconn: init: add message entry for %s, MSG-ID %d", dialect, e.msgid);
-			message_entries[e.msgid] = &e;
-		}
-	};
+static_assert(me::is_sorted(dialect_entries), "dialect MESSAGE_ENTRIES should be sorted by msgid");
 
-	@[for dialect in MAVLINK_V20_DIALECTS]for (auto &e : mavlink::@dialect::MESSAGE_ENTRIES) @(' ' * (20 - len(dialect))) load("@dialect", e);
-	@[end for]
-}
+//! Merged table, built by compiler, so no initialization needed at run time
+static constexpr auto msg_entries = me::make_table<
+	me::count_entries(dialect_entries),
+	me::count_pages(dialect_entries)>(dialect_entries);
 
 std::vector<std::string> MAVConnInterface::get_known_dialects()
 {
@@ -65,9 +55,5 @@ std::vector<std::string> MAVConnInterface::get_known_dialects()
  */
 const mavlink::mavlink_msg_entry_t* mavlink::mavlink_get_msg_entry(uint32_t msgid)
 {
-	auto it = MAVConnInterface::message_entries.find(msgid);
-	if (it != MAVConnInterface::message_entries.end())
-		return it->second;
-	else
-		return nullptr;
+	return msg_entries.find(msgid);
 }
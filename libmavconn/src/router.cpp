@@ -0,0 +1,125 @@
+/**
+ * @brief MAVConn message router
+ * @file router.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <cassert>
+#include <mavconn/router.h>
+
+namespace mavconn {
+
+using mavlink::mavlink_message_t;
+
+static constexpr auto RLX = std::memory_order_relaxed;
+
+Router::Router()
+{
+	for (auto &m : sys_links)
+		m.store(0, RLX);
+	for (auto &l : comp_link)
+		l.store(0, RLX);
+}
+
+Router::LinkId Router::add_link(MAVConnInterface::Ptr link)
+{
+	assert(links.size() < MAX_LINKS);
+
+	links.emplace_back(std::move(link));
+	return links.size() - 1;
+}
+
+void Router::learn(LinkId link, uint8_t sysid, uint8_t compid)
+{
+	uint64_t bit = uint64_t(1) << link;
+
+	// stores only on change, so steady traffic does not bounce cache lines
+	if (!(sys_links[sysid].load(RLX) & bit))
+		sys_links[sysid].fetch_or(bit, RLX);
+
+	auto &cl = comp_link[sysid << 8 | compid];
+	if (cl.load(RLX) != link + 1)
+		cl.store(link + 1, RLX);
+}
+
+bool Router::get_target(const mavlink_message_t *msg, uint8_t &sysid, uint8_t &compid)
+{
+	sysid = compid = 0;
+
+	auto e = mavlink::mavlink_get_msg_entry(msg->msgid);
+	if (e == nullptr || !(e->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_SYSTEM))
+		return false;
+
+	auto payload = reinterpret_cast<const uint8_t *>(_MAV_PAYLOAD(msg));
+	if (e->target_system_ofs < msg->len)
+		sysid = payload[e->target_system_ofs];
+	if ((e->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_COMPONENT) && e->target_component_ofs < msg->len)
+		compid = payload[e->target_component_ofs];
+
+	return true;
+}
+
+uint64_t Router::select(LinkId src, const mavlink_message_t *msg)
+{
+	uint64_t all = ((links.size() < 64) ? (uint64_t(1) << links.size()) : 0) - 1;
+	uint64_t others = all & ~(uint64_t(1) << src);
+	uint8_t sysid, compid;
+
+	if (!get_target(msg, sysid, compid) || sysid == 0)
+		return others;
+
+	auto sys_mask = sys_links[sysid].load(RLX);
+	if (sys_mask == 0)
+		return others;
+
+	if (compid != 0) {
+		auto link = comp_link[sysid << 8 | compid].load(RLX);
+		if (link != 0)
+			return (uint64_t(1) << (link - 1)) & others;
+	}
+
+	return sys_mask & others;
+}
+
+size_t Router::route(LinkId src, const mavlink_message_t *msg)
+{
+	learn(src, msg->sysid, msg->compid);
+
+	auto mask = select(src, msg);
+	size_t sent = 0;
+
+	for (size_t i = 0; mask != 0; i++, mask >>= 1) {
+		if (!(mask & 1))
+			continue;
+
+		links[i]->send_message_ignore_drop(msg);
+		sent++;
+	}
+
+	return sent;
+}
+
+std::vector<Router::RouteStat> Router::get_routes()
+{
+	std::vector<RouteStat> ret;
+
+	for (size_t key = 0; key < comp_link.size(); key++) {
+		auto link = comp_link[key].load(RLX);
+		if (link != 0)
+			ret.push_back(RouteStat { uint8_t(key >> 8), uint8_t(key), link - 1u });
+	}
+
+	return ret;
+}
+}	// namespace mavconn
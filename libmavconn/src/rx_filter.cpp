@@ -0,0 +1,143 @@
+/**
+ * @brief MAVConn receive filter
+ * @file rx_filter.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <mavconn/rx_filter.h>
+
+namespace mavconn {
+
+using mavlink::msgid_t;
+
+static constexpr auto RLX = std::memory_order_relaxed;
+
+static inline bool test_bit(const std::array<std::atomic<uint64_t>, RxFilter::BITMAP_SIZE / 64> &bm, msgid_t msgid)
+{
+	return bm[msgid / 64].load(RLX) & (uint64_t(1) << (msgid % 64));
+}
+
+RxFilter::RxFilter() :
+	active(false),
+	mode(Mode::NONE),
+	dropped(0),
+	rate_limited(0)
+{
+	for (auto &w : drop)
+		w.store(0, RLX);
+	for (auto &w : limited)
+		w.store(0, RLX);
+}
+
+void RxFilter::set_mode(Mode new_mode, const std::vector<msgid_t> &msgids)
+{
+	std::array<uint64_t, BITMAP_SIZE / 64> listed {};
+	std::vector<msgid_t> high;
+
+	for (auto msgid : msgids) {
+		if (msgid < BITMAP_SIZE)
+			listed[msgid / 64] |= uint64_t(1) << (msgid % 64);
+		else
+			high.push_back(msgid);
+	}
+
+	std::sort(high.begin(), high.end());
+
+	std::lock_guard<std::mutex> lock(mutex);
+	for (size_t i = 0; i < drop.size(); i++) {
+		uint64_t w = (new_mode == Mode::ALLOW) ? ~listed[i] :
+				(new_mode == Mode::DENY) ? listed[i] : 0;
+		drop[i].store(w, RLX);
+	}
+
+	high_ids = std::move(high);
+	mode = new_mode;
+	update_active();
+}
+
+void RxFilter::set_rate_limits(const std::vector<RateLimit> &limits)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// clear bits first, accept_slow() does not expect bit without entry
+	for (auto &w : limited)
+		w.store(0, RLX);
+
+	rates.clear();
+	for (auto &l : limits) {
+		int64_t interval = (l.rate_hz > 0) ? int64_t(1e9 / l.rate_hz) : INT64_MAX;
+		rates[l.msgid] = Rate { interval, 0 };
+
+		if (l.msgid < BITMAP_SIZE)
+			limited[l.msgid / 64].fetch_or(uint64_t(1) << (l.msgid % 64), RLX);
+	}
+
+	update_active();
+}
+
+void RxFilter::update_active()
+{
+	active = mode != Mode::NONE || !rates.empty();
+}
+
+bool RxFilter::accept_slow(msgid_t msgid)
+{
+	if (msgid < BITMAP_SIZE) {
+		if (test_bit(drop, msgid)) {
+			dropped.fetch_add(1, RLX);
+			return false;
+		}
+
+		if (!test_bit(limited, msgid))
+			return true;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (msgid >= BITMAP_SIZE) {
+		// rare extension ids
+		bool listed = std::binary_search(high_ids.begin(), high_ids.end(), msgid);
+		auto m = mode.load(RLX);
+		if ((m == Mode::ALLOW && !listed) || (m == Mode::DENY && listed)) {
+			dropped.fetch_add(1, RLX);
+			return false;
+		}
+	}
+
+	auto it = rates.find(msgid);
+	if (it == rates.end())
+		return true;
+
+	auto now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+
+	auto &r = it->second;
+	if (r.interval_ns == INT64_MAX || now_ns < r.next_ns) {
+		rate_limited.fetch_add(1, RLX);
+		return false;
+	}
+
+	// keep average rate, but do not accumulate credit while idle
+	r.next_ns = (now_ns - r.next_ns < r.interval_ns) ? r.next_ns + r.interval_ns : now_ns + r.interval_ns;
+	return true;
+}
+
+RxFilter::Stat RxFilter::get_stat()
+{
+	return Stat {
+		dropped.load(RLX),
+		rate_limited.load(RLX),
+	};
+}
+}	// namespace mavconn
@@ -15,13 +15,22 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <cstring>
 
 #include <mavconn/console_bridge_compat.h>
 #include <mavconn/thread_utils.h>
 #include <mavconn/serial.h>
 
 #if defined(__linux__)
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
 #include <linux/serial.h>
 #endif
 
@@ -38,13 +47,23 @@ using mavlink::mavlink_message_t;
 
 
 MAVConnSerial::MAVConnSerial(uint8_t system_id, uint8_t component_id,
-		std::string device, unsigned baudrate, bool hwflow) :
+		std::string device, unsigned baudrate, bool hwflow,
+		IOPool::Ptr io_pool_) :
 	MAVConnInterface(system_id, component_id),
-	tx_in_progress(false),
-	tx_q {},
-	rx_buf {},
-	io_service(),
-	serial_dev(io_service)
+	io_pool(io_pool_ ? io_pool_ : std::make_shared<IOPool>(1, utils::format("mserial%zu", conn_id))),
+	own_pool(!io_pool_),
+	strand(io_pool->io_service),
+	serial_dev(io_pool->io_service),
+	tx_q(MAX_TXQ_SIZE, &link_stats),
+	rx_buf(MsgBuffer::MAX_SIZE),
+	rx_buf_size(MsgBuffer::MAX_SIZE),
+	rt_priority(0),
+	rx_thread_run(false),
+	rx_reads(0),
+	rx_read_bytes(0),
+	rx_gap_sum_ns(0),
+	rx_gap_max_ns(0),
+	rx_last_read(steady_clock::now())
 {
 	using SPB = boost::asio::serial_port_base;
 
@@ -89,34 +108,18 @@ MAVConnSerial::MAVConnSerial(uint8_t system_id, uint8_t component_id,
 		}
 #endif
 
-#if defined(__linux__)
-		// Enable low latency mode on Linux
-		{
-			int fd = serial_dev.native_handle();
-
-			struct serial_struct ser_info;
-			ioctl(fd, TIOCGSERIAL, &ser_info);
-
-			ser_info.flags |= ASYNC_LOW_LATENCY;
-
-			ioctl(fd, TIOCSSERIAL, &ser_info);
-		}
-#endif
 	}
 	catch (boost::system::system_error &err) {
 		throw DeviceError("serial", err);
 	}
 
+	// Enable low latency mode on Linux
+	set_low_latency(true);
+
 	// NOTE: shared_from_this() should not be used in constructors
 
 	// give some work to io_service before start
-	io_service.post(std::bind(&MAVConnSerial::do_read, this));
-
-	// run io_service for async io
-	io_thread = std::thread([this] () {
-				utils::set_this_thread_name("mserial%zu", conn_id);
-				io_service.run();
-			});
+	strand.post(std::bind(&MAVConnSerial::do_read, this));
 }
 
 MAVConnSerial::~MAVConnSerial()
@@ -126,24 +129,125 @@ MAVConnSerial::~MAVConnSerial()
 
 void MAVConnSerial::close()
 {
-	lock_guard lock(mutex);
-	if (!is_open())
-		return;
-
-	serial_dev.cancel();
-	serial_dev.close();
+	// reader thread uses fd, so stop it before close
+	stop_rx_thread();
 
-	io_service.stop();
+	{
+		lock_guard lock(mutex);
+		if (!is_open())
+			return;
 
-	if (io_thread.joinable())
-		io_thread.join();
+		serial_dev.cancel();
+		serial_dev.close();
+	}
 
-	io_service.reset();
+	if (own_pool)
+		io_pool->stop();
+	else
+		io_pool->sync(strand);
 
 	if (port_closed_cb)
 		port_closed_cb();
 }
 
+void MAVConnSerial::set_low_latency(bool enable)
+{
+#if defined(__linux__)
+	int fd = serial_dev.native_handle();
+
+	struct serial_struct ser_info;
+	if (ioctl(fd, TIOCGSERIAL, &ser_info) < 0) {
+		// e.g. USB CDC ACM, which has no such flag
+		CONSOLE_BRIDGE_logDebug(PFXd "TIOCGSERIAL: %s", conn_id, strerror(errno));
+		return;
+	}
+
+	if (enable)
+		ser_info.flags |= ASYNC_LOW_LATENCY;
+	else
+		ser_info.flags &= ~ASYNC_LOW_LATENCY;
+
+	if (ioctl(fd, TIOCSSERIAL, &ser_info) < 0)
+		CONSOLE_BRIDGE_logWarn(PFXd "TIOCSSERIAL: %s", conn_id, strerror(errno));
+#endif
+}
+
+void MAVConnSerial::set_read_timing(uint8_t vmin, uint8_t vtime)
+{
+#if defined(__linux__)
+	int fd = serial_dev.native_handle();
+
+	termios tio;
+	if (tcgetattr(fd, &tio) < 0) {
+		CONSOLE_BRIDGE_logWarn(PFXd "tcgetattr: %s", conn_id, strerror(errno));
+		return;
+	}
+
+	tio.c_cc[VMIN] = vmin;
+	tio.c_cc[VTIME] = vtime;
+
+	if (tcsetattr(fd, TCSANOW, &tio) < 0)
+		CONSOLE_BRIDGE_logWarn(PFXd "tcsetattr: %s", conn_id, strerror(errno));
+#endif
+}
+
+void MAVConnSerial::set_rx_buffer_size(size_t bytes)
+{
+	rx_buf_size = std::max<size_t>(1, std::min(bytes, size_t(MAX_RX_BUF_SIZE)));
+}
+
+void MAVConnSerial::set_rt_read_thread(int priority)
+{
+#if defined(__linux__)
+	rt_priority = priority;
+#else
+	CONSOLE_BRIDGE_logWarn(PFXd "RT read thread supported only on Linux", conn_id);
+#endif
+}
+
+MAVConnSerial::ReadStat MAVConnSerial::get_read_stat()
+{
+	ReadStat ret {};
+
+	ret.reads = rx_reads.exchange(0);
+	auto bytes = rx_read_bytes.exchange(0);
+	auto gap_sum = rx_gap_sum_ns.exchange(0);
+	ret.gap_max_ms = rx_gap_max_ns.exchange(0) / 1e6f;
+
+	if (ret.reads > 0) {
+		ret.bytes_per_read = float(bytes) / ret.reads;
+		ret.gap_avg_ms = gap_sum / 1e6f / ret.reads;
+	}
+
+	return ret;
+}
+
+void MAVConnSerial::rx_complete(size_t bytes)
+{
+	constexpr auto RLX = std::memory_order_relaxed;
+
+	auto now = steady_clock::now();
+	uint64_t gap = std::chrono::duration_cast<std::chrono::nanoseconds>(now - rx_last_read).count();
+	rx_last_read = now;
+
+	// only current reader writes, so load/store is enough for max
+	rx_reads.fetch_add(1, RLX);
+	rx_read_bytes.fetch_add(bytes, RLX);
+	rx_gap_sum_ns.fetch_add(gap, RLX);
+	if (gap > rx_gap_max_ns.load(RLX))
+		rx_gap_max_ns.store(gap, RLX);
+
+	set_rx_stamp(rx_stamp_now());
+	parse_buffer(PFX, rx_buf.data(), rx_buf.size(), bytes);
+}
+
+void MAVConnSerial::add_tx_lane(TxPolicy policy, const std::vector<mavlink::msgid_t> &msgids, size_t capacity)
+{
+	tx_q.add_lane(policy, msgids, capacity);
+	if (policy != TxPolicy::DROP_OLDEST)
+		tx_flow.add_priority(msgids);
+}
+
 void MAVConnSerial::send_bytes(const uint8_t *bytes, size_t length)
 {
 	if (!is_open()) {
@@ -151,15 +255,11 @@ void MAVConnSerial::send_bytes(const uint8_t *bytes, size_t length)
 		return;
 	}
 
-	{
-		lock_guard lock(mutex);
-
-		if (tx_q.size() >= MAX_TXQ_SIZE)
-			throw std::length_error("MAVConnSerial::send_bytes: TX queue overflow");
+	if (!tx_q.emplace(bytes, length))
+		throw std::length_error("MAVConnSerial::send_bytes: TX queue overflow");
 
-		tx_q.emplace_back(bytes, length);
-	}
-	io_service.post(std::bind(&MAVConnSerial::do_write, shared_from_this(), true));
+	if (tx_q.need_wakeup())
+		strand.post(std::bind(&MAVConnSerial::do_write, shared_from_this()));
 }
 
 void MAVConnSerial::send_message(const mavlink_message_t *message)
@@ -173,15 +273,16 @@ void MAVConnSerial::send_message(const mavlink_message_t *message)
 
 	log_send(PFX, message);
 
-	{
-		lock_guard lock(mutex);
+	if (!tx_flow_admit(message->msgid))
+		return;
 
-		if (tx_q.size() >= MAX_TXQ_SIZE)
-			throw std::length_error("MAVConnSerial::send_message: TX queue overflow");
+	auto len = tx_q.emplace_msg(message->msgid, message);
+	trace_tx(message, len);
+	if (!len)
+		throw std::length_error("MAVConnSerial::send_message: TX queue overflow");
 
-		tx_q.emplace_back(message);
-	}
-	io_service.post(std::bind(&MAVConnSerial::do_write, shared_from_this(), true));
+	if (tx_q.need_wakeup())
+		strand.post(std::bind(&MAVConnSerial::do_write, shared_from_this()));
 }
 
 void MAVConnSerial::send_message(const mavlink::Message &message, const uint8_t source_compid)
@@ -193,51 +294,124 @@ void MAVConnSerial::send_message(const mavlink::Message &message, const uint8_t
 
 	log_send_obj(PFX, message);
 
-	{
-		lock_guard lock(mutex);
+	auto msgid = message.get_message_info().id;
+	if (!tx_flow_admit(msgid))
+		return;
 
-		if (tx_q.size() >= MAX_TXQ_SIZE)
-			throw std::length_error("MAVConnSerial::send_message: TX queue overflow");
+	auto status = get_tx_status();
+	auto seq = status.current_tx_seq;
+	auto len = tx_q.emplace_msg(msgid, message, &status, sys_id, source_compid, signing_p());
+	trace(len ? TraceEvent::TX : TraceEvent::TX_DROP, msgid, len, seq, sys_id, source_compid);
+	record_tx_obj(message, seq, source_compid, len);
+	if (!len)
+		throw std::length_error("MAVConnSerial::send_message: TX queue overflow");
 
-		tx_q.emplace_back(message, get_status_p(), sys_id, source_compid);
-	}
-	io_service.post(std::bind(&MAVConnSerial::do_write, shared_from_this(), true));
+	if (tx_q.need_wakeup())
+		strand.post(std::bind(&MAVConnSerial::do_write, shared_from_this()));
 }
 
 void MAVConnSerial::do_read(void)
 {
-	auto sthis = shared_from_this();
+	std::shared_ptr<MAVConnSerial> sthis;
+	try {
+		sthis = shared_from_this();
+	}
+	catch (std::bad_weak_ptr &) {
+		// first call is posted by constructor and may run before make_shared() returns
+		if (is_open())
+			strand.post(std::bind(&MAVConnSerial::do_read, this));
+		return;
+	}
+
+	if (rx_buf.size() != rx_buf_size)
+		rx_buf.resize(rx_buf_size);
+
+#if defined(__linux__)
+	// no read pending here, so reader can be handed over to thread
+	if (rt_priority > 0 && !rx_thread_run.exchange(true)) {
+		rx_thread = std::thread(&MAVConnSerial::do_read_thread, this);
+		return;
+	}
+#endif
+
 	serial_dev.async_read_some(
 			buffer(rx_buf),
-			[sthis] (error_code error, size_t bytes_transferred) {
+			strand.wrap([sthis] (error_code error, size_t bytes_transferred) {
 				if (error) {
 					CONSOLE_BRIDGE_logError(PFXd "receive: %s", sthis->conn_id, error.message().c_str());
 					sthis->close();
 					return;
 				}
 
-				sthis->parse_buffer(PFX, sthis->rx_buf.data(), sthis->rx_buf.size(), bytes_transferred);
+				sthis->rx_complete(bytes_transferred);
 				sthis->do_read();
-			});
+			}));
 }
 
-void MAVConnSerial::do_write(bool check_tx_state)
+void MAVConnSerial::stop_rx_thread()
 {
-	if (check_tx_state && tx_in_progress)
+	if (!rx_thread_run.exchange(false))
 		return;
 
-	lock_guard lock(mutex);
-	if (tx_q.empty())
+	// close() may be called from message handler
+	if (rx_thread.get_id() == std::this_thread::get_id())
+		rx_thread.detach();
+	else if (rx_thread.joinable())
+		rx_thread.join();
+}
+
+void MAVConnSerial::do_read_thread()
+{
+#if defined(__linux__)
+	utils::set_this_thread_name("msrx%zu", conn_id);
+
+	sched_param sp {};
+	sp.sched_priority = rt_priority;
+	int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+	if (ret != 0)
+		CONSOLE_BRIDGE_logWarn(PFXd "RT read thread: SCHED_FIFO %d: %s", conn_id, sp.sched_priority, strerror(ret));
+	else
+		CONSOLE_BRIDGE_logInform(PFXd "RT read thread: SCHED_FIFO %d", conn_id, sp.sched_priority);
+
+	int fd = serial_dev.native_handle();
+	pollfd pfd { fd, POLLIN, 0 };
+
+	while (rx_thread_run) {
+		if (rx_buf.size() != rx_buf_size)
+			rx_buf.resize(rx_buf_size);
+
+		// timeout only to notice stop request
+		ret = ::poll(&pfd, 1, 100);
+		if (ret == 0 || (ret < 0 && errno == EINTR))
+			continue;
+
+		ssize_t n = (ret > 0) ? ::read(fd, rx_buf.data(), rx_buf.size()) : -1;
+		if (n > 0) {
+			rx_complete(n);
+			continue;
+		}
+		else if (n < 0 && (errno == EAGAIN || errno == EINTR))
+			continue;
+
+		CONSOLE_BRIDGE_logError(PFXd "receive: %s", conn_id, (n == 0) ? "device closed" : strerror(errno));
+		close();
+		return;
+	}
+#endif
+}
+
+void MAVConnSerial::do_write()
+{
+	// IO thread owns ring tail until next() marks it idle
+	if (tx_q.next() == nullptr)
 		return;
 
-	tx_in_progress = true;
+	// coalesce queued messages into one gathered write
+	auto iovcnt = tx_q.gather(tx_iov.data(), tx_iov.size(), get_tx_gather_bytes());
 	auto sthis = shared_from_this();
-	auto &buf_ref = tx_q.front();
 	serial_dev.async_write_some(
-			buffer(buf_ref.dpos(), buf_ref.nbytes()),
-			[sthis, &buf_ref] (error_code error, size_t bytes_transferred) {
-				assert(bytes_transferred <= buf_ref.len);
-
+			ConstBufferRange{tx_iov.data(), tx_iov.data() + iovcnt},
+			strand.wrap([sthis] (error_code error, size_t bytes_transferred) {
 				if (error) {
 					CONSOLE_BRIDGE_logError(PFXd "write: %s", sthis->conn_id, error.message().c_str());
 					sthis->close();
@@ -245,22 +419,8 @@ void MAVConnSerial::do_write(bool check_tx_state)
 				}
 
 				sthis->iostat_tx_add(bytes_transferred);
-				lock_guard lock(sthis->mutex);
-
-				if (sthis->tx_q.empty()) {
-					sthis->tx_in_progress = false;
-					return;
-				}
-
-				buf_ref.pos += bytes_transferred;
-				if (buf_ref.nbytes() == 0) {
-					sthis->tx_q.pop_front();
-				}
-
-				if (!sthis->tx_q.empty())
-					sthis->do_write(false);
-				else
-					sthis->tx_in_progress = false;
-			});
+				sthis->tx_q.consume(bytes_transferred);
+				sthis->do_write();
+			}));
 }
 }	// namespace mavconn
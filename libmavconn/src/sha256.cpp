@@ -0,0 +1,288 @@
+/**
+ * @brief MAVConn SHA-256 for MAVLink 2 signing
+ * @file sha256.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <atomic>
+#include <cstring>
+#include <mavconn/sha256.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define MAVCONN_SHA256_X86
+#elif defined(__aarch64__) && defined(__linux__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define MAVCONN_SHA256_ARMV8
+#endif
+
+namespace mavconn {
+namespace sha256 {
+
+using CompressFn = void (*)(uint32_t state[8], const uint8_t *data, size_t blocks);
+
+alignas(16) static const uint32_t K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t H0[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+static inline uint32_t rotr(uint32_t x, int n)
+{
+	return (x >> n) | (x << (32 - n));
+}
+
+static inline uint32_t load_be32(const uint8_t *p)
+{
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+static void compress_generic(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+	for (; blocks > 0; blocks--, data += BLOCK_SIZE) {
+		uint32_t w[64];
+		for (int i = 0; i < 16; i++)
+			w[i] = load_be32(data + i * 4);
+		for (int i = 16; i < 64; i++) {
+			uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+			uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+
+		uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+		uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+		for (int i = 0; i < 64; i++) {
+			uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+			uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+	}
+}
+
+#ifdef MAVCONN_SHA256_X86
+__attribute__((target("sha,sse4.1")))
+static void compress_sha_ni(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+	// instructions work on ABEF and CDGH halves
+	__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[0])), 0xb1);
+	__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[4])), 0x1b);
+	__m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+	for (; blocks > 0; blocks--, data += BLOCK_SIZE) {
+		const __m128i abef = state0, cdgh = state1;
+		__m128i msg[4];
+
+		for (int i = 0; i < 4; i++)
+			msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i * 16)), bswap);
+
+		// four rounds per step, schedule of step i + 4 reuses slot of step i
+		for (int i = 0; i < 16; i++) {
+			__m128i wk = _mm_add_epi32(msg[i & 3], _mm_load_si128(reinterpret_cast<const __m128i *>(&K[i * 4])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0e));
+
+			if (i < 12) {
+				__m128i t = _mm_sha256msg1_epu32(msg[i & 3], msg[(i + 1) & 3]);
+				t = _mm_add_epi32(t, _mm_alignr_epi8(msg[(i + 3) & 3], msg[(i + 2) & 3], 4));
+				msg[i & 3] = _mm_sha256msg2_epu32(t, msg[(i + 3) & 3]);
+			}
+		}
+
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1b);
+	state1 = _mm_shuffle_epi32(state1, 0xb1);
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(&state[0]), _mm_blend_epi16(tmp, state1, 0xf0));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(&state[4]), _mm_alignr_epi8(state1, tmp, 8));
+}
+
+static bool have_sha_ni()
+{
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+
+	const bool sse = (ecx & bit_SSSE3) && (ecx & bit_SSE4_1);
+	if (!sse || !__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return false;
+
+	return ebx & (1u << 29);	// SHA
+}
+#endif	// MAVCONN_SHA256_X86
+
+#ifdef MAVCONN_SHA256_ARMV8
+__attribute__((target("+crypto")))
+static void compress_armv8(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+	uint32x4_t state0 = vld1q_u32(&state[0]);
+	uint32x4_t state1 = vld1q_u32(&state[4]);
+
+	for (; blocks > 0; blocks--, data += BLOCK_SIZE) {
+		const uint32x4_t abcd = state0, efgh = state1;
+		uint32x4_t msg[4];
+
+		for (int i = 0; i < 4; i++)
+			msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i * 16)));
+
+		for (int i = 0; i < 16; i++) {
+			uint32x4_t wk = vaddq_u32(msg[i & 3], vld1q_u32(&K[i * 4]));
+			uint32x4_t prev = state0;
+			state0 = vsha256hq_u32(state0, state1, wk);
+			state1 = vsha256h2q_u32(state1, prev, wk);
+
+			if (i < 12)
+				msg[i & 3] = vsha256su1q_u32(vsha256su0q_u32(msg[i & 3], msg[(i + 1) & 3]),
+						msg[(i + 2) & 3], msg[(i + 3) & 3]);
+		}
+
+		state0 = vaddq_u32(state0, abcd);
+		state1 = vaddq_u32(state1, efgh);
+	}
+
+	vst1q_u32(&state[0], state0);
+	vst1q_u32(&state[4], state1);
+}
+
+static bool have_armv8()
+{
+	return getauxval(AT_HWCAP) & HWCAP_SHA2;
+}
+#endif	// MAVCONN_SHA256_ARMV8
+
+static CompressFn impl_fn(Impl impl)
+{
+	switch (impl) {
+#ifdef MAVCONN_SHA256_X86
+	case Impl::SHA_NI:
+		return (have_sha_ni()) ? compress_sha_ni : nullptr;
+#endif
+#ifdef MAVCONN_SHA256_ARMV8
+	case Impl::ARMV8:
+		return (have_armv8()) ? compress_armv8 : nullptr;
+#endif
+	case Impl::GENERIC:
+		return compress_generic;
+	default:
+		return nullptr;
+	}
+}
+
+static Impl detect_impl()
+{
+	for (auto impl : {Impl::SHA_NI, Impl::ARMV8}) {
+		if (impl_fn(impl) != nullptr)
+			return impl;
+	}
+
+	return Impl::GENERIC;
+}
+
+static std::atomic<Impl> active_impl {detect_impl()};
+static std::atomic<CompressFn> compress {impl_fn(active_impl)};
+
+Digest digest(const uint8_t *data, size_t len)
+{
+	auto fn = compress.load(std::memory_order_relaxed);
+	uint32_t state[8];
+	std::memcpy(state, H0, sizeof(state));
+
+	const size_t full = len / BLOCK_SIZE;
+	fn(state, data, full);
+
+	// padding: 0x80, zeros, bit length big endian
+	uint8_t tail[BLOCK_SIZE * 2] = {};
+	const size_t rest = len - full * BLOCK_SIZE;
+	std::memcpy(tail, data + full * BLOCK_SIZE, rest);
+	tail[rest] = 0x80;
+
+	const size_t tail_blocks = (rest + 9 > BLOCK_SIZE) ? 2 : 1;
+	const uint64_t bits = uint64_t(len) * 8;
+	for (int i = 0; i < 8; i++)
+		tail[tail_blocks * BLOCK_SIZE - 1 - i] = bits >> (i * 8);
+
+	fn(state, tail, tail_blocks);
+
+	Digest out;
+	for (int i = 0; i < 8; i++) {
+		out[i * 4 + 0] = state[i] >> 24;
+		out[i * 4 + 1] = state[i] >> 16;
+		out[i * 4 + 2] = state[i] >> 8;
+		out[i * 4 + 3] = state[i];
+	}
+
+	return out;
+}
+
+Impl get_impl()
+{
+	return active_impl;
+}
+
+bool set_impl(Impl impl)
+{
+	auto fn = impl_fn(impl);
+	if (fn == nullptr)
+		return false;
+
+	compress = fn;
+	active_impl = impl;
+	return true;
+}
+
+const char *to_string(Impl impl)
+{
+	switch (impl) {
+	case Impl::GENERIC:	return "generic";
+	case Impl::SHA_NI:	return "sha-ni";
+	case Impl::ARMV8:	return "armv8";
+	default:		return "unknown";
+	}
+}
+
+}	// namespace sha256
+}	// namespace mavconn
@@ -0,0 +1,411 @@
+/**
+ * @brief MAVConn shared memory link class
+ * @file shm.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <unordered_map>
+
+#include <mavconn/console_bridge_compat.h>
+#include <mavconn/thread_utils.h>
+#include <mavconn/shm.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+namespace mavconn {
+
+using mavlink::mavlink_message_t;
+
+#define PFX	"mavconn: shm"
+#define PFXd	PFX "%zu: "
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "shared memory rings need lock-free atomics");
+
+//! Ring written by one side, read by other
+struct SHMRing {
+	alignas(64) std::atomic<uint32_t> head;		//!< producer position, also futex word
+	alignas(64) std::atomic<uint32_t> tail;		//!< consumer position
+	std::atomic<uint32_t> waiting;			//!< consumer sleeps on futex
+	alignas(64) mavlink_message_t slots[MAVConnSHM::RING_SLOTS];
+};
+
+struct SHMSegment {
+	//! "MVS" and layout version
+	static constexpr uint32_t MAGIC = 0x4d565301;
+
+	std::atomic<uint32_t> magic;
+	std::atomic<int32_t> pid[2];			//!< attached process, 0 - free
+	SHMRing ring[2];				//!< ring[i] is written by side i
+};
+
+#ifdef __linux__
+
+static inline void futex_wait(std::atomic<uint32_t> *addr, uint32_t val, long timeout_ms)
+{
+	struct timespec ts = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000 };
+	syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAIT, val, &ts, nullptr, 0);
+}
+
+static inline void futex_wake(std::atomic<uint32_t> *addr)
+{
+	syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+static inline bool pid_alive(int32_t pid)
+{
+	return pid != 0 && (kill(pid, 0) == 0 || errno != ESRCH);
+}
+
+//! Segments of in-process links, unmapped with last end
+static std::mutex local_mutex;
+static std::unordered_map<std::string, std::weak_ptr<SHMSegment>> local_segments;
+
+static std::shared_ptr<SHMSegment> local_segment(const std::string &name)
+{
+	std::lock_guard<std::mutex> lock(local_mutex);
+
+	auto &weak = local_segments[name];
+	auto segment = weak.lock();
+	if (!segment) {
+		// anonymous mapping: zero filled and page aligned, like shm segment
+		void *addr = mmap(nullptr, sizeof(SHMSegment), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (addr == MAP_FAILED)
+			throw DeviceError("shm", errno);
+
+		segment.reset(static_cast<SHMSegment *>(addr), [](SHMSegment *p) {
+					munmap(p, sizeof(SHMSegment));
+				});
+		weak = segment;
+	}
+
+	return segment;
+}
+
+static SHMSegment *shm_map(const std::string &shm_name)
+{
+	int fd = shm_open(shm_name.c_str(), O_RDWR | O_CREAT, 0660);
+	if (fd < 0)
+		throw DeviceError("shm", errno);
+
+	// both ends may create segment, ftruncate() to same size is harmless
+	struct stat st;
+	if (fstat(fd, &st) < 0 || (size_t(st.st_size) < sizeof(SHMSegment) && ftruncate(fd, sizeof(SHMSegment)) < 0)) {
+		int err = errno;
+		::close(fd);
+		throw DeviceError("shm", err);
+	}
+
+	void *addr = mmap(nullptr, sizeof(SHMSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (addr == MAP_FAILED)
+		throw DeviceError("shm", errno);
+
+	// new segment is zero filled, which is valid empty state
+	return static_cast<SHMSegment *>(addr);
+}
+
+MAVConnSHM::MAVConnSHM(uint8_t system_id, uint8_t component_id,
+		std::string name, bool in_process) :
+	MAVConnInterface(system_id, component_id),
+	shm_name((in_process) ? name : "/mavconn-" + name),
+	seg(nullptr),
+	side(-1),
+	open_flag(false),
+	bytes_status {},
+	bytes_buffer {}
+{
+	if (in_process) {
+		local_seg = local_segment(name);
+		seg = local_seg.get();
+	}
+	else
+		seg = shm_map(shm_name);
+
+	uint32_t magic = 0;
+	seg->magic.compare_exchange_strong(magic, SHMSegment::MAGIC);
+	if (seg->magic != SHMSegment::MAGIC) {
+		unmap();
+		throw DeviceError("shm", "segment has unknown format");
+	}
+
+	// take free side or side of dead process
+	int32_t self = getpid();
+	for (int i = 0; i < 2 && side < 0; i++) {
+		int32_t pid = 0;
+		if (seg->pid[i].compare_exchange_strong(pid, self))
+			side = i;
+		else if (!pid_alive(pid) && seg->pid[i].compare_exchange_strong(pid, self))
+			side = i;
+	}
+
+	if (side < 0) {
+		unmap();
+		throw DeviceError("shm", "both sides of segment are in use");
+	}
+
+	// drop frames sent to previous user of this side
+	auto &rx_ring = seg->ring[1 - side];
+	rx_ring.tail = rx_ring.head.load();
+
+	CONSOLE_BRIDGE_logInform(PFXd "%s segment %s side %d", conn_id,
+			(local_seg) ? "in-process" : "shared", shm_name.c_str(), side);
+
+	open_flag = true;
+	rx_thread = std::thread([this] () {
+				utils::set_this_thread_name("mshm%zu", conn_id);
+				do_recv();
+			});
+}
+
+MAVConnSHM::~MAVConnSHM()
+{
+	close();
+	unmap();
+}
+
+void MAVConnSHM::unmap()
+{
+	if (seg != nullptr && !local_seg)
+		munmap(seg, sizeof(SHMSegment));
+
+	seg = nullptr;
+	local_seg.reset();
+}
+
+void MAVConnSHM::close()
+{
+	if (!open_flag.exchange(false))
+		return;
+
+	futex_wake(&seg->ring[1 - side].head);
+
+	// close() may be called from message handler
+	if (rx_thread.get_id() == std::this_thread::get_id())
+		rx_thread.detach();
+	else if (rx_thread.joinable())
+		rx_thread.join();
+
+	seg->pid[side] = 0;
+	if (seg->pid[1 - side] == 0 && !local_seg)
+		shm_unlink(shm_name.c_str());
+
+	if (port_closed_cb)
+		port_closed_cb();
+}
+
+mavlink_message_t *MAVConnSHM::tx_slot()
+{
+	auto &ring = seg->ring[side];
+
+	if (seg->pid[1 - side] == 0)
+		return nullptr;
+
+	auto head = ring.head.load(std::memory_order_relaxed);
+	if (head - ring.tail.load(std::memory_order_acquire) >= RING_SLOTS)
+		return nullptr;
+
+	return &ring.slots[head % RING_SLOTS];
+}
+
+void MAVConnSHM::tx_commit()
+{
+	auto &ring = seg->ring[side];
+	auto &msg = ring.slots[ring.head.load(std::memory_order_relaxed) % RING_SLOTS];
+	auto len = LinkStats::frame_length(msg);
+
+	link_stats.tx_frame(msg.msgid, len);
+	trace(TraceEvent::TX, msg.msgid, len, msg.seq, msg.sysid, msg.compid);
+	record(msg, rx_stamp_now());
+	iostat_tx_add(len);
+
+	// seq_cst pairs with consumer's store of waiting flag
+	ring.head.fetch_add(1, std::memory_order_seq_cst);
+	if (ring.waiting.load(std::memory_order_seq_cst))
+		futex_wake(&ring.head);
+}
+
+void MAVConnSHM::send_message(const mavlink_message_t *message)
+{
+	assert(message != nullptr);
+
+	if (!is_open()) {
+		CONSOLE_BRIDGE_logError(PFXd "send: channel closed!", conn_id);
+		return;
+	}
+
+	log_send(PFX, message);
+
+	std::lock_guard<std::mutex> lock(tx_mutex);
+	auto slot = tx_slot();
+	if (slot == nullptr) {
+		if (seg->pid[1 - side] == 0) {
+			CONSOLE_BRIDGE_logDebug(PFXd "send: Remote not attached, message dropped.", conn_id);
+			return;
+		}
+
+		link_stats.tx_drop();
+		trace_tx(message, 0);
+		throw std::length_error("MAVConnSHM::send_message: TX queue overflow");
+	}
+
+	*slot = *message;
+	tx_commit();
+}
+
+void MAVConnSHM::send_message(const mavlink::Message &message, const uint8_t source_compid)
+{
+	if (!is_open()) {
+		CONSOLE_BRIDGE_logError(PFXd "send: channel closed!", conn_id);
+		return;
+	}
+
+	log_send_obj(PFX, message);
+
+	std::lock_guard<std::mutex> lock(tx_mutex);
+	auto slot = tx_slot();
+	if (slot == nullptr) {
+		if (seg->pid[1 - side] == 0) {
+			CONSOLE_BRIDGE_logDebug(PFXd "send: Remote not attached, message dropped.", conn_id);
+			return;
+		}
+
+		link_stats.tx_drop();
+		trace(TraceEvent::TX_DROP, message.get_message_info().id, 0, 0, sys_id, source_compid);
+		throw std::length_error("MAVConnSHM::send_message: TX queue overflow");
+	}
+
+	// serialize right into shared memory
+	auto mi = message.get_message_info();
+	auto status = get_tx_status();
+	mavlink::MsgMap map(slot);
+
+	message.serialize(map);
+	mavlink::mavlink_finalize_message_buffer(slot, sys_id, source_compid, &status,
+			mi.min_length, mi.length, mi.crc_extra);
+	sign_tx(slot, mi.crc_extra);
+
+	tx_commit();
+}
+
+void MAVConnSHM::send_bytes(const uint8_t *bytes, size_t length)
+{
+	if (!is_open()) {
+		CONSOLE_BRIDGE_logError(PFXd "send: channel closed!", conn_id);
+		return;
+	}
+
+	// ring carries whole frames, so raw bytes are framed first
+	std::lock_guard<std::mutex> lock(tx_mutex);
+	for (; length > 0; length--) {
+		mavlink::mavlink_status_t status;
+		mavlink_message_t msg;
+
+		auto framing = mavlink::mavlink_frame_char_buffer(&bytes_buffer, &bytes_status, *bytes++, &msg, &status);
+		if (framing != mavlink::MAVLINK_FRAMING_OK)
+			continue;
+
+		auto slot = tx_slot();
+		if (slot == nullptr) {
+			CONSOLE_BRIDGE_logDebug(PFXd "send: ring full or remote not attached, frame dropped.", conn_id);
+			link_stats.tx_drop();
+			continue;
+		}
+
+		*slot = msg;
+		tx_commit();
+	}
+}
+
+void MAVConnSHM::do_recv()
+{
+	auto &ring = seg->ring[1 - side];
+
+	while (open_flag) {
+		auto tail = ring.tail.load(std::memory_order_relaxed);
+		auto head = ring.head.load(std::memory_order_acquire);
+
+		if (head == tail) {
+			ring.waiting.store(1, std::memory_order_seq_cst);
+			if (ring.head.load(std::memory_order_seq_cst) == tail && open_flag)
+				futex_wait(&ring.head, tail, 100);
+
+			ring.waiting.store(0, std::memory_order_relaxed);
+			continue;
+		}
+
+		// deliver contiguous run of slots, up to ring wrap
+		size_t count = std::min<size_t>(head - tail, RING_SLOTS - tail % RING_SLOTS);
+		auto msgs = &ring.slots[tail % RING_SLOTS];
+
+		size_t bytes = 0;
+		for (size_t i = 0; i < count; i++)
+			bytes += LinkStats::frame_length(msgs[i]);
+		iostat_rx_add(bytes);
+
+		set_rx_stamp(rx_stamp_now());
+		probe_poll();
+		rx_frames(PFX, msgs, count);
+
+		// slots are released after callbacks returned
+		ring.tail.store(tail + count, std::memory_order_release);
+	}
+}
+
+#else
+
+MAVConnSHM::MAVConnSHM(uint8_t system_id, uint8_t component_id,
+		std::string name, bool in_process) :
+	MAVConnInterface(system_id, component_id),
+	shm_name(name),
+	seg(nullptr),
+	side(-1),
+	open_flag(false)
+{
+	throw DeviceError("shm", "shared memory link supported only on Linux");
+}
+
+MAVConnSHM::~MAVConnSHM()
+{ }
+
+void MAVConnSHM::unmap()
+{ }
+
+void MAVConnSHM::close()
+{ }
+
+void MAVConnSHM::send_message(const mavlink_message_t *message)
+{ }
+
+void MAVConnSHM::send_message(const mavlink::Message &message, const uint8_t source_compid)
+{ }
+
+void MAVConnSHM::send_bytes(const uint8_t *bytes, size_t length)
+{ }
+
+void MAVConnSHM::do_recv()
+{ }
+
+#endif
+}	// namespace mavconn
@@ -0,0 +1,310 @@
+/**
+ * @brief MAVConn MAVLink 2 message signing
+ * @file signing.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <mavconn/crc.h>
+#include <mavconn/interface.h>
+#include <mavconn/sha256.h>
+#include <mavconn/signing.h>
+
+namespace mavconn {
+
+using mavlink::mavlink_message_t;
+
+static constexpr auto RLX = std::memory_order_relaxed;
+
+//! 1 January 2015 GMT - 1 January 1970 [s]
+static constexpr uint64_t EPOCH_2015 = 1420070400ULL;
+//! Signature timestamp units per second
+static constexpr uint64_t TS_PER_SEC = 100000;
+//! link_id and 48-bit timestamp
+static constexpr size_t SIG_HEAD_LEN = 7;
+//! truncated SHA-256
+static constexpr size_t SIG_HASH_LEN = 6;
+
+constexpr size_t MessageSigning::MAX_STREAMS;
+
+MessageSigning::MessageSigning(const Options &opts_) :
+	opts(opts_),
+	local_ts(timestamp_now()),
+	stream_key{},
+	stream_ts{},
+	n_streams(0),
+	last_stream(0),
+	unsigned_ids(opts_.unsigned_msgids),
+	tx_signed(0),
+	rx_signed(0),
+	bad_signature(0),
+	replay(0),
+	stale(0),
+	streams_full(0),
+	unsigned_rejected(0),
+	unsigned_accepted(0)
+{
+	std::sort(unsigned_ids.begin(), unsigned_ids.end());
+}
+
+uint64_t MessageSigning::timestamp_now()
+{
+	auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+
+	return (uint64_t(us) - EPOCH_2015 * 1000000ULL) / (1000000ULL / TS_PER_SEC);
+}
+
+uint64_t MessageSigning::next_timestamp()
+{
+	// strictly increasing, even if several senders sign in the same 10 us
+	uint64_t cur = local_ts.load(RLX);
+	uint64_t next;
+	do {
+		next = std::max(timestamp_now(), cur + 1);
+	} while (!local_ts.compare_exchange_weak(cur, next, RLX));
+
+	return next;
+}
+
+//! Wire header, same bytes as mavlink_msg_to_send_buffer() writes
+static inline void header_bytes(const mavlink_message_t &msg, uint8_t *hdr)
+{
+	hdr[0] = msg.magic;
+	hdr[1] = msg.len;
+	hdr[2] = msg.incompat_flags;
+	hdr[3] = msg.compat_flags;
+	hdr[4] = msg.seq;
+	hdr[5] = msg.sysid;
+	hdr[6] = msg.compid;
+	hdr[7] = msg.msgid & 0xff;
+	hdr[8] = (msg.msgid >> 8) & 0xff;
+	hdr[9] = (msg.msgid >> 16) & 0xff;
+}
+
+void MessageSigning::calc_signature(const mavlink_message_t &msg, const uint8_t *sig7, uint8_t *out)
+{
+	uint8_t buf[sizeof(Key) + MAVLINK_NUM_HEADER_BYTES + MAVLINK_MAX_PAYLOAD_LEN + MAVLINK_NUM_CHECKSUM_BYTES + SIG_HEAD_LEN];
+	uint8_t *p = buf;
+
+	std::memcpy(p, opts.key.data(), opts.key.size());
+	p += opts.key.size();
+	header_bytes(msg, p);
+	p += MAVLINK_NUM_HEADER_BYTES;
+	std::memcpy(p, _MAV_PAYLOAD(&msg), msg.len);
+	p += msg.len;
+	// checksum is set by parsers and by finalize, ck[] only by parsers
+	*p++ = msg.checksum & 0xff;
+	*p++ = msg.checksum >> 8;
+	std::memcpy(p, sig7, SIG_HEAD_LEN);
+	p += SIG_HEAD_LEN;
+
+	auto hash = sha256::digest(buf, p - buf);
+	std::memcpy(out, hash.data(), SIG_HASH_LEN);
+}
+
+bool MessageSigning::sign(mavlink_message_t &msg, uint8_t crc_extra)
+{
+	if (!opts.sign_outgoing || msg.magic != MAVLINK_STX || (msg.incompat_flags & MAVLINK_IFLAG_SIGNED))
+		return false;
+
+	msg.incompat_flags |= MAVLINK_IFLAG_SIGNED;
+
+	// flag is covered by CRC
+	uint8_t hdr[MAVLINK_NUM_HEADER_BYTES];
+	header_bytes(msg, hdr);
+	auto payload = _MAV_PAYLOAD_NON_CONST(&msg);
+	uint16_t checksum = crc::x25_accumulate(hdr + 1, MAVLINK_NUM_HEADER_BYTES - 1, crc::X25_INIT);
+	checksum = crc::x25_accumulate(reinterpret_cast<const uint8_t *>(payload), msg.len, checksum);
+	checksum = crc::x25_accumulate(crc_extra, checksum);
+
+	msg.checksum = checksum;
+	msg.ck[0] = checksum & 0xff;
+	msg.ck[1] = checksum >> 8;
+	payload[msg.len] = msg.ck[0];
+	payload[msg.len + 1] = msg.ck[1];
+
+	uint64_t ts = next_timestamp();
+	auto sig = msg.signature;
+	sig[0] = opts.link_id;
+	for (size_t i = 0; i < 6; i++)
+		sig[1 + i] = (ts >> (8 * i)) & 0xff;
+
+	calc_signature(msg, sig, sig + SIG_HEAD_LEN);
+	tx_signed.fetch_add(1, RLX);
+	return true;
+}
+
+bool MessageSigning::sign_frame(uint8_t *frame, size_t &len, uint8_t crc_extra)
+{
+	if (!opts.sign_outgoing || len < MAVLINK_NUM_NON_PAYLOAD_BYTES || frame[0] != MAVLINK_STX ||
+			(frame[2] & MAVLINK_IFLAG_SIGNED))
+		return false;
+
+	const size_t plen = frame[1];
+	assert(len == MAVLINK_NUM_HEADER_BYTES + plen + MAVLINK_NUM_CHECKSUM_BYTES);
+
+	frame[2] |= MAVLINK_IFLAG_SIGNED;
+
+	uint16_t checksum = crc::x25_accumulate(frame + 1, MAVLINK_NUM_HEADER_BYTES - 1 + plen, crc::X25_INIT);
+	checksum = crc::x25_accumulate(crc_extra, checksum);
+	frame[MAVLINK_NUM_HEADER_BYTES + plen] = checksum & 0xff;
+	frame[MAVLINK_NUM_HEADER_BYTES + plen + 1] = checksum >> 8;
+
+	uint64_t ts = next_timestamp();
+	auto sig = frame + len;
+	sig[0] = opts.link_id;
+	for (size_t i = 0; i < 6; i++)
+		sig[1 + i] = (ts >> (8 * i)) & 0xff;
+
+	// header, payload and CRC are contiguous, so hash goes over frame as is
+	uint8_t buf[sizeof(Key) + MAVLINK_NUM_HEADER_BYTES + MAVLINK_MAX_PAYLOAD_LEN + MAVLINK_NUM_CHECKSUM_BYTES + SIG_HEAD_LEN];
+	std::memcpy(buf, opts.key.data(), opts.key.size());
+	std::memcpy(buf + opts.key.size(), frame, len + SIG_HEAD_LEN);
+
+	auto hash = sha256::digest(buf, opts.key.size() + len + SIG_HEAD_LEN);
+	std::memcpy(sig + SIG_HEAD_LEN, hash.data(), SIG_HASH_LEN);
+
+	len += MAVLINK_SIGNATURE_BLOCK_LEN;
+	tx_signed.fetch_add(1, RLX);
+	return true;
+}
+
+size_t MessageSigning::find_stream(uint32_t key)
+{
+	if (n_streams > 0 && stream_key[last_stream] == key)
+		return last_stream;
+
+	for (size_t i = 0; i < n_streams; i++)
+		if (stream_key[i] == key)
+			return last_stream = i;
+
+	return MAX_STREAMS;
+}
+
+Framing MessageSigning::verify_unsigned(const mavlink_message_t &msg)
+{
+	if (opts.accept_unsigned ||
+			std::binary_search(unsigned_ids.begin(), unsigned_ids.end(), msg.msgid)) {
+		unsigned_accepted.fetch_add(1, RLX);
+		return Framing::ok;
+	}
+
+	unsigned_rejected.fetch_add(1, RLX);
+	return Framing::bad_signature;
+}
+
+Framing MessageSigning::verify(const mavlink_message_t &msg)
+{
+	if (msg.magic != MAVLINK_STX || !(msg.incompat_flags & MAVLINK_IFLAG_SIGNED))
+		return verify_unsigned(msg);
+
+	const uint8_t *sig = msg.signature;
+	uint64_t ts = 0;
+	for (size_t i = 0; i < 6; i++)
+		ts |= uint64_t(sig[1 + i]) << (8 * i);
+
+	// replay and age checked before hash
+	const uint32_t key = (uint32_t(msg.sysid) << 16) | (uint32_t(msg.compid) << 8) | sig[0];
+	size_t idx = find_stream(key);
+	if (idx < MAX_STREAMS) {
+		if (ts <= stream_ts[idx]) {
+			replay.fetch_add(1, RLX);
+			return Framing::bad_signature;
+		}
+	}
+	else {
+		if (n_streams == MAX_STREAMS) {
+			streams_full.fetch_add(1, RLX);
+			return Framing::bad_signature;
+		}
+
+		uint64_t now = std::max(timestamp_now(), local_ts.load(RLX));
+		if (ts + opts.timestamp_window.count() * TS_PER_SEC < now) {
+			stale.fetch_add(1, RLX);
+			return Framing::bad_signature;
+		}
+	}
+
+	uint8_t hash[SIG_HASH_LEN];
+	calc_signature(msg, sig, hash);
+	if (std::memcmp(hash, sig + SIG_HEAD_LEN, SIG_HASH_LEN) != 0) {
+		bad_signature.fetch_add(1, RLX);
+		return Framing::bad_signature;
+	}
+
+	if (idx == MAX_STREAMS) {
+		idx = last_stream = n_streams++;
+		stream_key[idx] = key;
+	}
+
+	stream_ts[idx] = ts;
+
+	// local timestamp follows newest good one, like mavlink_signature_check()
+	uint64_t cur = local_ts.load(RLX);
+	while (ts > cur && !local_ts.compare_exchange_weak(cur, ts, RLX)) {
+	}
+
+	rx_signed.fetch_add(1, RLX);
+	return Framing::ok;
+}
+
+MessageSigning::Stats MessageSigning::get_stats()
+{
+	Stats ret;
+
+	ret.tx_signed = tx_signed.load(RLX);
+	ret.rx_signed = rx_signed.load(RLX);
+	ret.bad_signature = bad_signature.load(RLX);
+	ret.replay = replay.load(RLX);
+	ret.stale = stale.load(RLX);
+	ret.streams_full = streams_full.load(RLX);
+	ret.unsigned_rejected = unsigned_rejected.load(RLX);
+	ret.unsigned_accepted = unsigned_accepted.load(RLX);
+
+	return ret;
+}
+
+static int hex_digit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+
+	return -1;
+}
+
+MessageSigning::Key MessageSigning::key_from_string(const std::string &str)
+{
+	Key key;
+
+	bool is_hex = str.size() == key.size() * 2 &&
+			std::all_of(str.begin(), str.end(), [](char c) { return hex_digit(c) >= 0; });
+	if (is_hex) {
+		for (size_t i = 0; i < key.size(); i++)
+			key[i] = (hex_digit(str[2 * i]) << 4) | hex_digit(str[2 * i + 1]);
+
+		return key;
+	}
+
+	auto hash = sha256::digest(reinterpret_cast<const uint8_t *>(str.data()), str.size());
+	std::copy(hash.begin(), hash.end(), key.begin());
+	return key;
+}
+}	// namespace mavconn
@@ -68,17 +68,18 @@ static bool resolve_address_tcp(io_service &io, size_t chan, std::string host, u
 /* -*- TCP client variant -*- */
 
 MAVConnTCPClient::MAVConnTCPClient(uint8_t system_id, uint8_t component_id,
-		std::string server_host, unsigned short server_port) :
+		std::string server_host, unsigned short server_port,
+		IOPool::Ptr io_pool_) :
 	MAVConnInterface(system_id, component_id),
+	io_pool(io_pool_ ? io_pool_ : std::make_shared<IOPool>(1, utils::format("mtcp%zu", conn_id))),
+	own_pool(!io_pool_),
+	strand(io_pool->io_service),
+	socket(io_pool->io_service),
 	is_destroying(false),
-	tx_in_progress(false),
-	tx_q {},
-	rx_buf {},
-	io_service(),
-	io_work(new io_service::work(io_service)),
-	socket(io_service)
+	tx_q(MAX_TXQ_SIZE, &link_stats),
+	rx_buf {}
 {
-	if (!resolve_address_tcp(io_service, conn_id, server_host, server_port, server_ep))
+	if (!resolve_address_tcp(io_pool->io_service, conn_id, server_host, server_port, server_ep))
 		throw DeviceError("tcp: resolve", "Bind address resolve failed");
 
 	CONSOLE_BRIDGE_logInform(PFXd "Server address: %s", conn_id, to_string_ss(server_ep).c_str());
@@ -94,22 +95,19 @@ MAVConnTCPClient::MAVConnTCPClient(uint8_t system_id, uint8_t component_id,
 	// NOTE: shared_from_this() should not be used in constructors
 
 	// give some work to io_service before start
-	io_service.post(std::bind(&MAVConnTCPClient::do_recv, this));
-
-	// run io_service for async io
-	io_thread = std::thread([this] () {
-				utils::set_this_thread_name("mtcp%zu", conn_id);
-				io_service.run();
-			});
+	strand.post(std::bind(&MAVConnTCPClient::do_recv, this));
 }
 
 MAVConnTCPClient::MAVConnTCPClient(uint8_t system_id, uint8_t component_id,
-		boost::asio::io_service &server_io) :
+		IOPool::Ptr server_pool) :
 	MAVConnInterface(system_id, component_id),
-	tx_in_progress(false),
-	tx_q {},
-	rx_buf {},
-	socket(server_io)
+	io_pool(server_pool),
+	own_pool(false),
+	strand(io_pool->io_service),
+	socket(io_pool->io_service),
+	is_destroying(false),
+	tx_q(MAX_TXQ_SIZE, &link_stats),
+	rx_buf {}
 {
 	// waiting when server call client_connected()
 }
@@ -120,12 +118,7 @@ void MAVConnTCPClient::client_connected(size_t server_channel)
 			server_channel, conn_id, to_string_ss(server_ep).c_str());
 
 	// start recv
-#if BOOST_ASIO_VERSION >= 101200
-	boost::asio::post(socket.get_executor(),
-		std::bind(&MAVConnTCPClient::do_recv, shared_from_this()));
-#else
-	socket.get_io_service().post(std::bind(&MAVConnTCPClient::do_recv, shared_from_this()));
-#endif
+	strand.post(std::bind(&MAVConnTCPClient::do_recv, shared_from_this()));
 }
 
 MAVConnTCPClient::~MAVConnTCPClient()
@@ -136,26 +129,33 @@ MAVConnTCPClient::~MAVConnTCPClient()
 
 void MAVConnTCPClient::close()
 {
-	if (!is_open())
-		return;
-	lock_guard lock(mutex);
-
-	socket.shutdown(boost::asio::ip::tcp::socket::shutdown_send);
-	socket.cancel();
-	socket.close();
-
-	io_work.reset();
-	io_service.stop();
+	{
+		lock_guard lock(mutex);
+		// handler may close link at the same time
+		if (!is_open())
+			return;
 
-	if (io_thread.joinable())
-		io_thread.join();
+		socket.shutdown(boost::asio::ip::tcp::socket::shutdown_send);
+		socket.cancel();
+		socket.close();
+	}
 
-	io_service.reset();
+	if (own_pool)
+		io_pool->stop();
+	else
+		io_pool->sync(strand);
 
 	if (port_closed_cb)
 		port_closed_cb();
 }
 
+void MAVConnTCPClient::add_tx_lane(TxPolicy policy, const std::vector<mavlink::msgid_t> &msgids, size_t capacity)
+{
+	tx_q.add_lane(policy, msgids, capacity);
+	if (policy != TxPolicy::DROP_OLDEST)
+		tx_flow.add_priority(msgids);
+}
+
 void MAVConnTCPClient::send_bytes(const uint8_t *bytes, size_t length)
 {
 	if (!is_open()) {
@@ -163,20 +163,11 @@ void MAVConnTCPClient::send_bytes(const uint8_t *bytes, size_t length)
 		return;
 	}
 
-	{
-		lock_guard lock(mutex);
-
-		if (tx_q.size() >= MAX_TXQ_SIZE)
-			throw std::length_error("MAVConnTCPClient::send_bytes: TX queue overflow");
+	if (!tx_q.emplace(bytes, length))
+		throw std::length_error("MAVConnTCPClient::send_bytes: TX queue overflow");
 
-		tx_q.emplace_back(bytes, length);
-	}
-#if BOOST_ASIO_VERSION >= 101200
-	boost::asio::post(socket.get_executor(),
-		std::bind(&MAVConnTCPClient::do_send, shared_from_this(), true));
-#else
-	socket.get_io_service().post(std::bind(&MAVConnTCPClient::do_send, shared_from_this(), true));
-#endif
+	if (tx_q.need_wakeup())
+		strand.post(std::bind(&MAVConnTCPClient::do_send, shared_from_this()));
 }
 
 void MAVConnTCPClient::send_message(const mavlink_message_t *message)
@@ -190,20 +181,16 @@ void MAVConnTCPClient::send_message(const mavlink_message_t *message)
 
 	log_send(PFX, message);
 
-	{
-		lock_guard lock(mutex);
+	if (!tx_flow_admit(message->msgid))
+		return;
 
-		if (tx_q.size() >= MAX_TXQ_SIZE)
-			throw std::length_error("MAVConnTCPClient::send_message: TX queue overflow");
+	auto len = tx_q.emplace_msg(message->msgid, message);
+	trace_tx(message, len);
+	if (!len)
+		throw std::length_error("MAVConnTCPClient::send_message: TX queue overflow");
 
-		tx_q.emplace_back(message);
-	}
-#if BOOST_ASIO_VERSION >= 101200
-	boost::asio::post(socket.get_executor(),
-		std::bind(&MAVConnTCPClient::do_send, shared_from_this(), true));
-#else
-	socket.get_io_service().post(std::bind(&MAVConnTCPClient::do_send, shared_from_this(), true));
-#endif
+	if (tx_q.need_wakeup())
+		strand.post(std::bind(&MAVConnTCPClient::do_send, shared_from_this()));
 }
 
 void MAVConnTCPClient::send_message(const mavlink::Message &message, const uint8_t source_compid)
@@ -215,20 +202,39 @@ void MAVConnTCPClient::send_message(const mavlink::Message &message, const uint8
 
 	log_send_obj(PFX, message);
 
-	{
-		lock_guard lock(mutex);
+	auto msgid = message.get_message_info().id;
+	if (!tx_flow_admit(msgid))
+		return;
 
-		if (tx_q.size() >= MAX_TXQ_SIZE)
-			throw std::length_error("MAVConnTCPClient::send_message: TX queue overflow");
+	auto status = get_tx_status();
+	auto seq = status.current_tx_seq;
+	auto len = tx_q.emplace_msg(msgid, message, &status, sys_id, source_compid, signing_p());
+	trace(len ? TraceEvent::TX : TraceEvent::TX_DROP, msgid, len, seq, sys_id, source_compid);
+	record_tx_obj(message, seq, source_compid, len);
+	if (!len)
+		throw std::length_error("MAVConnTCPClient::send_message: TX queue overflow");
 
-		tx_q.emplace_back(message, get_status_p(), sys_id, source_compid);
-	}
-#if BOOST_ASIO_VERSION >= 101200
-	boost::asio::post(socket.get_executor(),
-		std::bind(&MAVConnTCPClient::do_send, shared_from_this(), true));
-#else
-	socket.get_io_service().post(std::bind(&MAVConnTCPClient::do_send, shared_from_this(), true));
-#endif
+	if (tx_q.need_wakeup())
+		strand.post(std::bind(&MAVConnTCPClient::do_send, shared_from_this()));
+}
+
+bool MAVConnTCPClient::send_frame(const mavlink_message_t *message, const std::shared_ptr<MsgBuffer> &frame,
+		int crc_extra)
+{
+	// closed client will be removed from server list soon
+	if (!is_open())
+		return true;
+
+	auto signing = (crc_extra >= 0) ? signing_p() : nullptr;
+	auto len = tx_q.emplace_msg(message->msgid, frame, signing, uint8_t(crc_extra));
+	trace_tx(message, len);
+	if (!len)
+		return false;
+
+	if (tx_q.need_wakeup())
+		strand.post(std::bind(&MAVConnTCPClient::do_send, shared_from_this()));
+
+	return true;
 }
 
 void MAVConnTCPClient::do_recv()
@@ -236,38 +242,45 @@ void MAVConnTCPClient::do_recv()
 	if (is_destroying) {
 		return;
 	}
-	auto sthis = shared_from_this();
+
+	std::shared_ptr<MAVConnTCPClient> sthis;
+	try {
+		sthis = shared_from_this();
+	}
+	catch (std::bad_weak_ptr &) {
+		// first call is posted by constructor and may run before make_shared() returns
+		if (is_open())
+			strand.post(std::bind(&MAVConnTCPClient::do_recv, this));
+		return;
+	}
+
 	socket.async_receive(
 			buffer(rx_buf),
-			[sthis] (error_code error, size_t bytes_transferred) {
+			strand.wrap([sthis] (error_code error, size_t bytes_transferred) {
 				if (error) {
 					CONSOLE_BRIDGE_logError(PFXd "receive: %s", sthis->conn_id, error.message().c_str());
 					sthis->close();
 					return;
 				}
 
+				sthis->set_rx_stamp(rx_stamp_now());
 				sthis->parse_buffer(PFX, sthis->rx_buf.data(), sthis->rx_buf.size(), bytes_transferred);
 				sthis->do_recv();
-			});
+			}));
 }
 
-void MAVConnTCPClient::do_send(bool check_tx_state)
+void MAVConnTCPClient::do_send()
 {
-	if (check_tx_state && tx_in_progress)
-		return;
-
-	lock_guard lock(mutex);
-	if (tx_q.empty())
+	// IO thread owns ring tail until next() marks it idle
+	if (tx_q.next() == nullptr)
 		return;
 
-	tx_in_progress = true;
+	// coalesce queued messages into one gathered write
+	auto iovcnt = tx_q.gather(tx_iov.data(), tx_iov.size(), get_tx_gather_bytes());
 	auto sthis = shared_from_this();
-	auto &buf_ref = tx_q.front();
 	socket.async_send(
-			buffer(buf_ref.dpos(), buf_ref.nbytes()),
-			[sthis, &buf_ref] (error_code error, size_t bytes_transferred) {
-				assert(bytes_transferred <= buf_ref.len);
-
+			ConstBufferRange{tx_iov.data(), tx_iov.data() + iovcnt},
+			strand.wrap([sthis] (error_code error, size_t bytes_transferred) {
 				if (error) {
 					CONSOLE_BRIDGE_logError(PFXd "send: %s", sthis->conn_id, error.message().c_str());
 					sthis->close();
@@ -275,36 +288,25 @@ void MAVConnTCPClient::do_send(bool check_tx_state)
 				}
 
 				sthis->iostat_tx_add(bytes_transferred);
-				lock_guard lock(sthis->mutex);
-
-				if (sthis->tx_q.empty()) {
-					sthis->tx_in_progress = false;
-					return;
-				}
-
-				buf_ref.pos += bytes_transferred;
-				if (buf_ref.nbytes() == 0) {
-					sthis->tx_q.pop_front();
-				}
-
-				if (!sthis->tx_q.empty())
-					sthis->do_send(false);
-				else
-					sthis->tx_in_progress = false;
-			});
+				sthis->tx_q.consume(bytes_transferred);
+				sthis->do_send();
+			}));
 }
 
 
 /* -*- TCP server variant -*- */
 
 MAVConnTCPServer::MAVConnTCPServer(uint8_t system_id, uint8_t component_id,
-		std::string server_host, unsigned short server_port) :
+		std::string server_host, unsigned short server_port,
+		IOPool::Ptr io_pool_) :
 	MAVConnInterface(system_id, component_id),
-	io_service(),
-	acceptor(io_service),
+	io_pool(io_pool_ ? io_pool_ : std::make_shared<IOPool>(1, utils::format("mtcps%zu", conn_id))),
+	own_pool(!io_pool_),
+	strand(io_pool->io_service),
+	acceptor(io_pool->io_service),
 	is_destroying(false)
 {
-	if (!resolve_address_tcp(io_service, conn_id, server_host, server_port, bind_ep))
+	if (!resolve_address_tcp(io_pool->io_service, conn_id, server_host, server_port, bind_ep))
 		throw DeviceError("tcp-l: resolve", "Bind address resolve failed");
 
 	CONSOLE_BRIDGE_logInform(PFXd "Bind address: %s", conn_id, to_string_ss(bind_ep).c_str());
@@ -320,13 +322,7 @@ MAVConnTCPServer::MAVConnTCPServer(uint8_t system_id, uint8_t component_id,
 	}
 
 	// give some work to io_service before start
-	io_service.post(std::bind(&MAVConnTCPServer::do_accept, this));
-
-	// run io_service for async io
-	io_thread = std::thread([this] () {
-				utils::set_this_thread_name("mtcps%zu", conn_id);
-				io_service.run();
-			});
+	strand.post(std::bind(&MAVConnTCPServer::do_accept, this));
 }
 
 MAVConnTCPServer::~MAVConnTCPServer()
@@ -337,18 +333,27 @@ MAVConnTCPServer::~MAVConnTCPServer()
 
 void MAVConnTCPServer::close()
 {
-	lock_guard lock(mutex);
-	if (!is_open())
-		return;
+	std::list<std::shared_ptr<MAVConnTCPClient> > clients;
+	{
+		lock_guard lock(mutex);
+		if (!is_open())
+			return;
 
-	CONSOLE_BRIDGE_logInform(PFXd "Terminating server. "
-			"All connections will be closed.", conn_id);
+		CONSOLE_BRIDGE_logInform(PFXd "Terminating server. "
+				"All connections will be closed.", conn_id);
 
-	io_service.stop();
-	acceptor.close();
+		acceptor.close();
+		clients = client_list;
+	}
+
+	// clients do not stop with server io_service if it is shared
+	for (auto &instp : clients)
+		instp->close();
 
-	if (io_thread.joinable())
-		io_thread.join();
+	if (own_pool)
+		io_pool->stop();
+	else
+		io_pool->sync(strand);
 
 	if (port_closed_cb)
 		port_closed_cb();
@@ -401,6 +406,26 @@ MAVConnInterface::IOStat MAVConnTCPServer::get_iostat()
 	return iostat;
 }
 
+LinkStats::Snapshot MAVConnTCPServer::get_link_stats()
+{
+	auto stats = link_stats.snapshot();
+
+	lock_guard lock(mutex);
+	for (auto &instp : client_list)
+		LinkStats::merge(stats, instp->get_link_stats());
+
+	return stats;
+}
+
+void MAVConnTCPServer::add_tx_lane(TxPolicy policy, const std::vector<mavlink::msgid_t> &msgids, size_t capacity)
+{
+	lock_guard lock(mutex);
+
+	tx_lanes.push_back({policy, msgids, capacity});
+	for (auto &instp : client_list)
+		instp->add_tx_lane(policy, msgids, capacity);
+}
+
 void MAVConnTCPServer::send_bytes(const uint8_t *bytes, size_t length)
 {
 	lock_guard lock(mutex);
@@ -412,17 +437,52 @@ void MAVConnTCPServer::send_bytes(const uint8_t *bytes, size_t length)
 void MAVConnTCPServer::send_message(const mavlink_message_t *message)
 {
 	lock_guard lock(mutex);
-	for (auto &instp : client_list) {
-		instp->send_message(message);
-	}
+	broadcast(message);
 }
 
 void MAVConnTCPServer::send_message(const mavlink::Message &message, const uint8_t source_compid)
 {
 	lock_guard lock(mutex);
-	for (auto &instp : client_list) {
-		instp->send_message(message, source_compid);
+	if (client_list.empty())
+		return;
+
+	log_send_obj(PFX, message);
+
+	// serialize with server's sequence, same frame goes to all clients
+	mavlink_message_t msg;
+	mavlink::MsgMap map(msg);
+	auto mi = message.get_message_info();
+	auto status = get_tx_status();
+
+	message.serialize(map);
+	mavlink::mavlink_finalize_message_buffer(&msg, sys_id, source_compid, &status, mi.min_length, mi.length, mi.crc_extra);
+
+	// each client signs with own timestamps, in order of its writes
+	broadcast(&msg, signing_p() ? mi.crc_extra : -1);
+}
+
+void MAVConnTCPServer::broadcast(const mavlink_message_t *message, int crc_extra)
+{
+	if (client_list.empty())
+		return;
+
+	// single client: frame copied to its queue, no allocation needed
+	if (client_list.size() == 1 && crc_extra < 0) {
+		client_list.front()->send_message(message);
+		return;
 	}
+
+	log_send(PFX, message);
+
+	auto frame = std::make_shared<MsgBuffer>(message);
+	bool overflow = false;
+
+	// overflow of one slow client should not stop others
+	for (auto &instp : client_list)
+		overflow |= !instp->send_frame(message, frame, crc_extra);
+
+	if (overflow)
+		throw std::length_error("MAVConnTCPServer::send_message: TX queue overflow");
 }
 
 void MAVConnTCPServer::do_accept()
@@ -430,12 +490,34 @@ void MAVConnTCPServer::do_accept()
 	if (is_destroying) {
 		return;
 	}
-	auto sthis = shared_from_this();
-	auto acceptor_client = std::make_shared<MAVConnTCPClient>(sys_id, comp_id, io_service);
+
+	std::shared_ptr<MAVConnTCPServer> sthis;
+	try {
+		sthis = shared_from_this();
+	}
+	catch (std::bad_weak_ptr &) {
+		// first call is posted by constructor and may run before make_shared() returns
+		if (is_open())
+			strand.post(std::bind(&MAVConnTCPServer::do_accept, this));
+		return;
+	}
+
+	auto acceptor_client = std::make_shared<MAVConnTCPClient>(sys_id, comp_id, io_pool);
+	acceptor_client->set_parser(get_parser());
+	acceptor_client->set_tx_gather_bytes(get_tx_gather_bytes());
+	acceptor_client->rx_filter = rx_filter;
+	acceptor_client->set_recorder(get_recorder());
+	if (auto signing = get_signing())
+		acceptor_client->set_signing(std::make_shared<MessageSigning>(signing->get_options()));
+	{
+		lock_guard lock(mutex);
+		for (auto &lane : tx_lanes)
+			acceptor_client->add_tx_lane(lane.policy, lane.msgids, lane.capacity);
+	}
 	acceptor.async_accept(
 			acceptor_client->socket,
 			acceptor_client->server_ep,
-			[sthis, acceptor_client] (error_code error) {
+			strand.wrap([sthis, acceptor_client] (error_code error) {
 				if (error) {
 					CONSOLE_BRIDGE_logError(PFXd "accept: %s", sthis->conn_id, error.message().c_str());
 					sthis->close();
@@ -446,12 +528,13 @@ void MAVConnTCPServer::do_accept()
 
 				std::weak_ptr<MAVConnTCPClient> weak_client{acceptor_client};
 				acceptor_client->client_connected(sthis->conn_id);
-				acceptor_client->message_received_cb = std::bind(&MAVConnTCPServer::recv_message, sthis, std::placeholders::_1, std::placeholders::_2);
+				acceptor_client->message_received_batch_cb = std::bind(&MAVConnTCPServer::recv_message_batch, sthis,
+						std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
 				acceptor_client->port_closed_cb = [weak_client, sthis] () { sthis->client_closed(weak_client); };
 
 				sthis->client_list.push_back(acceptor_client);
 				sthis->do_accept();
-			});
+			}));
 }
 
 void MAVConnTCPServer::client_closed(std::weak_ptr<MAVConnTCPClient> weak_instp)
@@ -468,9 +551,14 @@ void MAVConnTCPServer::client_closed(std::weak_ptr<MAVConnTCPClient> weak_instp)
 	}
 }
 
-void MAVConnTCPServer::recv_message(const mavlink_message_t *message, const Framing framing)
+void MAVConnTCPServer::recv_message_batch(const mavlink_message_t *messages, const Framing *framings, size_t count)
 {
-	if (message_received_cb)
-		message_received_cb(message, framing);
+	if (message_received_batch_cb) {
+		message_received_batch_cb(messages, framings, count);
+	}
+	else if (message_received_cb) {
+		for (size_t i = 0; i < count; i++)
+			message_received_cb(&messages[i], framings[i]);
+	}
 }
 }	// namespace mavconn
@@ -0,0 +1,178 @@
+/**
+ * @brief MAVConn thread scheduling and CPU affinity
+ * @file thread_sched.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include <mavconn/thread_sched.h>
+
+namespace mavconn {
+namespace utils {
+
+static std::atomic<bool> memory_locked { false };
+
+std::vector<int> ThreadSched::parse_cpus(const std::string &cpus)
+{
+	std::vector<int> ret;
+	std::istringstream ss(cpus);
+	std::string item;
+
+	while (std::getline(ss, item, ',')) {
+		if (item.empty())
+			continue;
+
+		auto dash = item.find('-');
+		int first = std::stoi(item.substr(0, dash));
+		int last = (dash != std::string::npos) ? std::stoi(item.substr(dash + 1)) : first;
+		if (first < 0 || last < first || last >= CPU_SETSIZE)
+			throw std::invalid_argument("bad CPU range: " + item);
+
+		for (int cpu = first; cpu <= last; cpu++)
+			ret.push_back(cpu);
+	}
+
+	return ret;
+}
+
+ThreadSched ThreadSched::parse(const std::string &policy, const std::string &cpus)
+{
+	ThreadSched ret;
+	auto colon = policy.find(':');
+	auto name = policy.substr(0, colon);
+
+	if (name == "fifo")
+		ret.policy = Policy::FIFO;
+	else if (name == "rr")
+		ret.policy = Policy::RR;
+	else if (name == "other" || name.empty())
+		ret.policy = Policy::OTHER;
+	else
+		throw std::invalid_argument("unknown policy: " + name);
+
+	if (ret.policy != Policy::OTHER) {
+		if (colon == std::string::npos)
+			throw std::invalid_argument("no priority: " + policy);
+
+		ret.priority = std::stoi(policy.substr(colon + 1));
+		if (ret.priority < 1 || ret.priority > 99)
+			throw std::invalid_argument("priority out of 1..99: " + policy);
+	}
+
+	ret.cpus = parse_cpus(cpus);
+	return ret;
+}
+
+std::string ThreadSched::to_string() const
+{
+	std::ostringstream ss;
+
+	switch (policy) {
+	case Policy::FIFO:	ss << "fifo:" << priority; break;
+	case Policy::RR:	ss << "rr:" << priority; break;
+	default:		ss << "other"; break;
+	}
+
+	ss << " cpus ";
+	if (cpus.empty())
+		ss << "any";
+
+	for (size_t i = 0; i < cpus.size(); i++)
+		ss << ((i > 0) ? "," : "") << cpus[i];
+
+	return ss.str();
+}
+
+int set_thread_sched(pthread_t th, const ThreadSched &sched)
+{
+	sched_param sp {};
+	int policy = SCHED_OTHER;
+
+	if (sched.policy == ThreadSched::Policy::FIFO)
+		policy = SCHED_FIFO;
+	else if (sched.policy == ThreadSched::Policy::RR)
+		policy = SCHED_RR;
+
+	sp.sched_priority = (policy != SCHED_OTHER) ? sched.priority : 0;
+	int ret = pthread_setschedparam(th, policy, &sp);
+	if (ret != 0 || sched.cpus.empty())
+		return ret;
+
+#ifdef __linux__
+	cpu_set_t cpuset;
+	CPU_ZERO(&cpuset);
+	for (auto cpu : sched.cpus)
+		CPU_SET(cpu, &cpuset);
+
+	return pthread_setaffinity_np(th, sizeof(cpuset), &cpuset);
+#else
+	return ENOTSUP;
+#endif
+}
+
+ThreadSched get_thread_sched(pthread_t th)
+{
+	ThreadSched ret;
+	sched_param sp {};
+	int policy;
+
+	if (pthread_getschedparam(th, &policy, &sp) == 0) {
+		if (policy == SCHED_FIFO)
+			ret.policy = ThreadSched::Policy::FIFO;
+		else if (policy == SCHED_RR)
+			ret.policy = ThreadSched::Policy::RR;
+
+		ret.priority = sp.sched_priority;
+	}
+
+#ifdef __linux__
+	cpu_set_t cpuset;
+	CPU_ZERO(&cpuset);
+	if (pthread_getaffinity_np(th, sizeof(cpuset), &cpuset) == 0) {
+		// all CPUs allowed is reported as "any"
+		if (size_t(CPU_COUNT(&cpuset)) >= std::thread::hardware_concurrency())
+			return ret;
+
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if (CPU_ISSET(cpu, &cpuset))
+				ret.cpus.push_back(cpu);
+		}
+	}
+#endif
+
+	return ret;
+}
+
+int lock_process_memory()
+{
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+		return errno;
+
+	memory_locked = true;
+	return 0;
+}
+
+bool is_process_memory_locked()
+{
+	return memory_locked;
+}
+}	// namespace utils
+}	// namespace mavconn
@@ -0,0 +1,243 @@
+/**
+ * @brief MAVConn tlog recorder
+ * @file tlog.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <mavconn/console_bridge_compat.h>
+#include <mavconn/thread_utils.h>
+#include <mavconn/tlog.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace mavconn {
+
+#define PFX	"mavconn: tlog: "
+
+constexpr size_t TlogRecorder::DEFAULT_RING_BYTES;
+constexpr std::chrono::milliseconds TlogRecorder::FLUSH_PERIOD;
+
+TlogRecorder::TlogRecorder(const Options &opts_) :
+	opts(opts_),
+	ring(nullptr),
+	ring_size(0),
+	head(0),
+	tail(0),
+	file_bytes_queued(0),
+	flush_requested(false),
+	stop(false),
+	dropped(0),
+	written_bytes(0),
+	fd(-1),
+	file_index(0)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	ring_size = (std::max<size_t>(opts.ring_bytes, MAVLINK_MAX_PACKET_LEN + 8) + page - 1) / page * page;
+
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_POPULATE
+	// preallocated, first records do not page fault in IO thread
+	flags |= MAP_POPULATE;
+#endif
+
+	void *addr = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (addr == MAP_FAILED)
+		throw std::system_error(errno, std::system_category(), "tlog ring");
+
+	ring = static_cast<uint8_t *>(addr);
+
+	open_file();
+	if (fd < 0) {
+		int err = errno;
+		munmap(ring, ring_size);
+		throw std::system_error(err, std::system_category(), file_name(opts, 0));
+	}
+
+	writer = std::thread([this] {
+		utils::set_this_thread_name("mtlog");
+		writer_loop();
+	});
+}
+
+TlogRecorder::~TlogRecorder()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+
+	cond.notify_one();
+	writer.join();
+
+	if (fd >= 0)
+		::close(fd);
+
+	munmap(ring, ring_size);
+}
+
+std::string TlogRecorder::file_name(const Options &opts, size_t index)
+{
+	if (opts.max_file_bytes == 0)
+		return opts.path;
+
+	// flight.tlog -> flight.0001.tlog
+	auto num = utils::format(".%04zu", index);
+	auto slash = opts.path.rfind('/');
+	auto dot = opts.path.rfind('.');
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return opts.path + num;
+
+	return opts.path.substr(0, dot) + num + opts.path.substr(dot);
+}
+
+//! Copy to ring position @a pos, wraps at @a size
+static inline void ring_copy(uint8_t *ring, size_t size, uint64_t pos, const uint8_t *data, size_t len)
+{
+	size_t off = pos % size;
+	size_t first = std::min(len, size - off);
+
+	std::memcpy(ring + off, data, first);
+	std::memcpy(ring, data + first, len - first);
+}
+
+bool TlogRecorder::write(uint64_t stamp_us, const uint8_t *frame, size_t len)
+{
+	uint8_t stamp[8];
+	for (size_t i = 0; i < sizeof(stamp); i++)
+		stamp[i] = stamp_us >> (56 - 8 * i);
+
+	const size_t rlen = sizeof(stamp) + len;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	if (head - tail + rlen > ring_size) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	// rotation is decided here, so files are split at record boundary
+	if (opts.max_file_bytes > 0 && file_bytes_queued > 0 &&
+			file_bytes_queued + rlen > opts.max_file_bytes) {
+		rotate_marks.push_back(head);
+		file_bytes_queued = 0;
+	}
+
+	ring_copy(ring, ring_size, head, stamp, sizeof(stamp));
+	ring_copy(ring, ring_size, head + sizeof(stamp), frame, len);
+	head += rlen;
+	file_bytes_queued += rlen;
+
+	bool wake = head - tail >= ring_size / 2;
+	lock.unlock();
+
+	if (wake)
+		cond.notify_one();
+
+	return true;
+}
+
+bool TlogRecorder::write(const mavlink::mavlink_message_t &msg, uint64_t stamp_ns)
+{
+	uint8_t frame[MAVLINK_MAX_PACKET_LEN];
+	auto len = mavlink::mavlink_msg_to_send_buffer(frame, &msg);
+
+	return write(stamp_ns / 1000, frame, len);
+}
+
+void TlogRecorder::flush()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	auto target = head;
+
+	flush_requested = true;
+	cond.notify_one();
+	flushed_cond.wait(lock, [&] { return tail >= target || stop; });
+}
+
+void TlogRecorder::open_file()
+{
+	if (fd >= 0)
+		::close(fd);
+
+	auto name = file_name(opts, file_index);
+	fd = ::open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		CONSOLE_BRIDGE_logError(PFX "%s: %s", name.c_str(), strerror(errno));
+
+	if (opts.max_files > 0 && file_index >= opts.max_files)
+		::unlink(file_name(opts, file_index - opts.max_files).c_str());
+
+	file_index++;
+}
+
+void TlogRecorder::write_file(uint64_t from, uint64_t to)
+{
+	while (from < to && fd >= 0) {
+		size_t off = from % ring_size;
+		size_t len = std::min<uint64_t>(to - from, ring_size - off);
+
+		ssize_t ret = ::write(fd, ring + off, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			CONSOLE_BRIDGE_logError(PFX "write: %s", strerror(errno));
+			return;
+		}
+
+		from += ret;
+		written_bytes.fetch_add(ret, std::memory_order_relaxed);
+	}
+}
+
+void TlogRecorder::writer_loop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true) {
+		cond.wait_for(lock, FLUSH_PERIOD, [this] {
+			return stop || flush_requested || head - tail >= ring_size / 2;
+		});
+
+		while (tail != head) {
+			uint64_t to = head;
+			bool rotate = !rotate_marks.empty() && rotate_marks.front() <= to;
+			if (rotate)
+				to = rotate_marks.front();
+
+			// ring bytes [tail, to) are not touched by writers until tail moves
+			lock.unlock();
+			write_file(tail, to);
+			if (rotate)
+				open_file();
+			lock.lock();
+
+			tail = to;
+			if (rotate)
+				rotate_marks.pop_front();
+		}
+
+		flush_requested = false;
+		flushed_cond.notify_all();
+
+		if (stop)
+			break;
+	}
+}
+}	// namespace mavconn
@@ -0,0 +1,104 @@
+/**
+ * @brief MAVConn binary frame trace
+ * @file trace.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <mavconn/trace.h>
+
+namespace mavconn {
+
+constexpr const char *TraceRing::FILE_MAGIC;
+
+TraceRing::TraceRing(size_t capacity) :
+	head(0)
+{
+	size_t cap = 1;
+	while (cap < capacity)
+		cap <<= 1;
+
+	mask = cap - 1;
+	slots.reset(new Slot[cap]);
+
+	for (size_t i = 0; i < cap; i++) {
+		slots[i].ver.store(0, std::memory_order_relaxed);
+		for (auto &w : slots[i].words)
+			w.store(0, std::memory_order_relaxed);
+	}
+}
+
+void TraceRing::record(const TraceEvent &ev)
+{
+	uint64_t words[WORDS];
+	std::memcpy(words, &ev, sizeof(ev));
+
+	auto pos = head.fetch_add(1, std::memory_order_relaxed);
+	auto &slot = slots[pos & mask];
+
+	slot.ver.store(2 * pos + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	for (size_t i = 0; i < WORDS; i++)
+		slot.words[i].store(words[i], std::memory_order_relaxed);
+
+	slot.ver.store(2 * pos + 2, std::memory_order_release);
+}
+
+std::vector<TraceEvent> TraceRing::dump() const
+{
+	std::vector<TraceEvent> ret;
+
+	auto end = head.load(std::memory_order_acquire);
+	auto begin = (end > capacity()) ? end - capacity() : 0;
+	ret.reserve(end - begin);
+
+	for (auto pos = begin; pos < end; pos++) {
+		auto &slot = slots[pos & mask];
+		uint64_t words[WORDS];
+
+		auto ver = slot.ver.load(std::memory_order_acquire);
+		if (ver != 2 * pos + 2)
+			continue;	// not yet written or already overwritten
+
+		for (size_t i = 0; i < WORDS; i++)
+			words[i] = slot.words[i].load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.ver.load(std::memory_order_relaxed) != ver)
+			continue;
+
+		TraceEvent ev;
+		std::memcpy(&ev, words, sizeof(ev));
+		ret.push_back(ev);
+	}
+
+	return ret;
+}
+
+bool TraceRing::dump_file(const std::string &path) const
+{
+	auto events = dump();
+
+	FILE *fp = std::fopen(path.c_str(), "wb");
+	if (fp == nullptr)
+		return false;
+
+	bool ok = std::fwrite(FILE_MAGIC, 1, 8, fp) == 8 &&
+		std::fwrite(events.data(), sizeof(TraceEvent), events.size(), fp) == events.size();
+
+	return (std::fclose(fp) == 0) && ok;
+}
+}	// namespace mavconn
@@ -0,0 +1,116 @@
+/**
+ * @brief MAVConn radio feedback flow control
+ * @file tx_flow.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <mavconn/tx_flow.h>
+
+namespace mavconn {
+
+using mavlink::msgid_t;
+
+TxFlowControl::TxFlowControl() :
+	enabled(false),
+	active(false),
+	share(1.0f),
+	credit(0.0f),
+	stat {}
+{
+	stat.share = 1.0f;
+	stat.txbuf = 100;
+}
+
+void TxFlowControl::configure(bool enable, const Options &opts_, const std::vector<msgid_t> &priority_)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	opts = opts_;
+	opts.min_share = std::min(std::max(opts.min_share, 0.01f), 1.0f);
+	priority.clear();
+	priority.insert(priority_.begin(), priority_.end());
+	priority.insert(lane_priority.begin(), lane_priority.end());
+
+	share = 1.0f;
+	credit = 0.0f;
+	stat = Stat {};
+	stat.share = 1.0f;
+	stat.txbuf = 100;
+
+	enabled = enable;
+	active = false;
+}
+
+void TxFlowControl::add_priority(const std::vector<msgid_t> &msgids)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	lane_priority.insert(lane_priority.end(), msgids.begin(), msgids.end());
+	priority.insert(msgids.begin(), msgids.end());
+}
+
+void TxFlowControl::feedback(uint8_t txbuf, uint8_t rssi, uint8_t remrssi, steady_clock::time_point now)
+{
+	if (!enabled)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	last_feedback = now;
+	stat.txbuf = txbuf;
+
+	bool weak = opts.rssi_low > 0 && (rssi < opts.rssi_low || remrssi < opts.rssi_low);
+
+	if (txbuf < opts.txbuf_low)
+		share = std::max(share * 0.5f, opts.min_share);
+	else if (txbuf > opts.txbuf_high && !weak)
+		share = std::min(share + opts.increase, 1.0f);
+
+	stat.share = share;
+	active = share < 1.0f;
+}
+
+bool TxFlowControl::admit_slow(msgid_t msgid, steady_clock::time_point now)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// radio gone or replaced, nothing to throttle by
+	if (now - last_feedback > opts.timeout) {
+		share = 1.0f;
+		stat.share = share;
+		active = false;
+	}
+
+	if (priority.count(msgid) || share >= 1.0f) {
+		stat.admitted++;
+		return true;
+	}
+
+	credit += share;
+	if (credit >= 1.0f) {
+		credit -= 1.0f;
+		stat.admitted++;
+		return true;
+	}
+
+	stat.throttled++;
+	return false;
+}
+
+TxFlowControl::Stat TxFlowControl::get_stat()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stat;
+}
+}	// namespace mavconn
@@ -0,0 +1,246 @@
+/**
+ * @brief MAVConn Tx queue with priority lanes
+ * @file tx_queue.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <mavconn/tx_queue.h>
+
+namespace mavconn {
+
+/* -*- TxLane -*- */
+
+TxLane::TxLane(TxPolicy policy_, size_t capacity, LinkStats *stats_) :
+	policy(policy_),
+	stats(stats_),
+	pool(capacity),
+	pool_msgid(capacity),
+	order(capacity),
+	head(0),
+	count(0),
+	inflight(0)
+{
+	assert(capacity > 0 && capacity <= UINT16_MAX);
+
+	free_slots.reserve(capacity);
+	for (size_t i = capacity; i > 0; i--)
+		free_slots.push_back(i - 1);
+}
+
+void TxLane::remove_at(size_t i)
+{
+	for (; i + 1 < count; i++)
+		order[(head + i) % order.size()] = slot_at(i + 1);
+
+	count--;
+}
+
+bool TxLane::empty()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return count == 0;
+}
+
+size_t TxLane::size()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return count;
+}
+
+MsgBuffer *TxLane::front()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (count == 0)
+		return nullptr;
+
+	inflight = std::max<size_t>(inflight, 1);
+	return &pool[slot_at(0)];
+}
+
+MsgBuffer *TxLane::partial()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (count == 0 || pool[slot_at(0)].pos == 0)
+		return nullptr;
+
+	return &pool[slot_at(0)];
+}
+
+size_t TxLane::gather(boost::asio::const_buffer *iov, size_t max_iov, size_t max_bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	size_t cnt = 0, total = 0;
+
+	for (; cnt < count && cnt < max_iov; cnt++) {
+		auto &buf = pool[slot_at(cnt)];
+		size_t len = buf.tx_len() - buf.pos;
+		if (cnt > 0 && total + len > max_bytes)
+			break;
+
+		buf.sign();
+		iov[cnt] = boost::asio::const_buffer(buf.dpos(), len);
+		total += len;
+	}
+
+	inflight = cnt;
+	return cnt;
+}
+
+void TxLane::consume(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	while (bytes > 0) {
+		assert(count > 0);
+		auto idx = slot_at(0);
+		auto &buf = pool[idx];
+
+		size_t n = std::min<size_t>(bytes, buf.nbytes());
+		buf.pos += n;
+		bytes -= n;
+
+		if (buf.nbytes() == 0) {
+			buf.shared.reset();
+			free_slots.push_back(idx);
+			head = (head + 1) % order.size();
+			count--;
+		}
+	}
+
+	inflight = 0;
+}
+
+
+/* -*- TxQueue -*- */
+
+TxQueue::TxQueue(size_t capacity, LinkStats *stats_) :
+	stats(stats_),
+	ring(capacity),
+	busy(false),
+	current(nullptr)
+{ }
+
+void TxQueue::add_lane(TxPolicy policy, const std::vector<mavlink::msgid_t> &msgids, size_t capacity)
+{
+	std::unique_ptr<TxLane> lane(new TxLane(policy, capacity, stats));
+
+	for (auto msgid : msgids)
+		lane_map[msgid] = lane.get();
+
+	if (policy == TxPolicy::DROP_OLDEST)
+		low_lanes.emplace_back(std::move(lane));
+	else
+		high_lanes.emplace_back(std::move(lane));
+}
+
+MsgBuffer *TxQueue::pick()
+{
+	MsgBuffer *buf;
+
+	// stream links should not interleave frames
+	if (current != nullptr) {
+		if ((buf = current->partial()) != nullptr)
+			return buf;
+	}
+	else if ((buf = ring.front()) != nullptr && buf->pos > 0)
+		return buf;
+
+	for (auto &lane : high_lanes) {
+		if ((buf = lane->front()) != nullptr) {
+			current = lane.get();
+			return buf;
+		}
+	}
+
+	if ((buf = ring.front()) != nullptr) {
+		current = nullptr;
+		return buf;
+	}
+
+	for (auto &lane : low_lanes) {
+		if ((buf = lane->front()) != nullptr) {
+			current = lane.get();
+			return buf;
+		}
+	}
+
+	return nullptr;
+}
+
+bool TxQueue::empty()
+{
+	if (ring.front() != nullptr)
+		return false;
+
+	for (auto &lane : high_lanes)
+		if (!lane->empty())
+			return false;
+
+	for (auto &lane : low_lanes)
+		if (!lane->empty())
+			return false;
+
+	return true;
+}
+
+void TxQueue::update_high_water()
+{
+	size_t depth = ring.size();
+
+	for (auto &lane : high_lanes)
+		depth += lane->size();
+	for (auto &lane : low_lanes)
+		depth += lane->size();
+
+	stats->tx_queue_depth(depth);
+}
+
+MsgBuffer *TxQueue::next()
+{
+	auto buf = pick();
+	if (buf != nullptr) {
+		if (stats)
+			update_high_water();
+		buf->sign();
+		return buf;
+	}
+
+	busy = false;
+	// producer could publish right before busy cleared and skip wakeup
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (empty() || busy.exchange(true))
+		return nullptr;
+
+	buf = pick();
+	if (buf != nullptr)
+		buf->sign();
+	return buf;
+}
+
+size_t TxQueue::gather(boost::asio::const_buffer *iov, size_t max_iov, size_t max_bytes)
+{
+	if (current != nullptr)
+		return current->gather(iov, max_iov, max_bytes);
+
+	return ring.gather(iov, max_iov, max_bytes);
+}
+
+void TxQueue::consume(size_t bytes)
+{
+	if (current != nullptr)
+		current->consume(bytes);
+	else
+		ring.consume(bytes);
+}
+}	// namespace mavconn
@@ -0,0 +1,177 @@
+/**
+ * @brief MAVConn forwarding shaper
+ * @file tx_shaper.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2018 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <climits>
+#include <mavconn/link_stats.h>
+#include <mavconn/tx_shaper.h>
+
+namespace mavconn {
+
+using mavlink::mavlink_message_t;
+using mavlink::msgid_t;
+
+const std::vector<msgid_t> TxShaper::DEFAULT_PRIORITY {
+	0,				// HEARTBEAT
+	37, 38, 39, 40, 41, 42, 43,	// MISSION_REQUEST_PARTIAL_LIST .. MISSION_REQUEST_LIST
+	44, 45, 46, 47, 51, 73,		// MISSION_COUNT .. MISSION_ITEM_INT
+	75, 76, 77, 80,			// COMMAND_INT, COMMAND_LONG, COMMAND_ACK, COMMAND_CANCEL
+};
+
+//! Bucket holds at least that, so biggest frame can always go
+static constexpr double MIN_BURST = MAVLINK_MAX_PACKET_LEN;
+
+TxShaper::TxShaper() :
+	active(false),
+	budget_Bps(0.0),
+	burst(0.0),
+	tokens(0.0),
+	last_ns(0),
+	stat {}
+{ }
+
+void TxShaper::configure(float budget, const std::vector<RateLimit> &limits, const std::vector<msgid_t> &prio)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	budget_Bps = std::max(budget, 0.0f);
+	burst = std::max(budget_Bps / 10.0, MIN_BURST);
+	tokens = burst;
+
+	intervals.clear();
+	for (auto &l : limits)
+		intervals[l.msgid] = (l.rate_hz > 0.0f) ? int64_t(1e9 / l.rate_hz) : INT64_MAX;
+
+	priority = std::unordered_set<msgid_t>(prio.begin(), prio.end());
+
+	// caps may be removed, waiting frames go on next shape()
+	for (auto &kv : streams) {
+		auto it = intervals.find(kv.first >> 16);
+		kv.second.interval_ns = (it != intervals.end()) ? it->second : 0;
+	}
+
+	active = budget_Bps > 0.0 || !intervals.empty() || !waiting.empty();
+}
+
+void TxShaper::refill(int64_t now_ns)
+{
+	if (budget_Bps > 0.0 && now_ns > last_ns)
+		tokens = std::min(burst, tokens + (now_ns - last_ns) * 1e-9 * budget_Bps);
+
+	last_ns = now_ns;
+}
+
+bool TxShaper::try_send(Stream &s, const mavlink_message_t *msg, size_t len, int64_t now_ns, const SendFn &send)
+{
+	// clock stepped back, do not hold stream until it catches up
+	if (s.interval_ns > 0 && s.next_ns - now_ns > s.interval_ns)
+		s.next_ns = now_ns;
+
+	if (now_ns < s.next_ns || (budget_Bps > 0.0 && tokens < len))
+		return false;
+
+	send(msg);
+	stat.forwarded++;
+	tokens -= len;
+
+	// keep average rate if called a bit late, restart after long pause
+	if (s.interval_ns > 0)
+		s.next_ns = (now_ns - s.next_ns < s.interval_ns) ? s.next_ns + s.interval_ns : now_ns + s.interval_ns;
+
+	return true;
+}
+
+void TxShaper::shape(const mavlink_message_t *msgs, size_t count, int64_t now_ns, const SendFn &send)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!active) {
+		for (size_t i = 0; i < count; i++)
+			send(&msgs[i]);
+
+		stat.forwarded += count;
+		return;
+	}
+
+	refill(now_ns);
+
+	// oldest waiting first, so budget is shared fairly
+	auto wend = std::remove_if(waiting.begin(), waiting.end(), [&](uint64_t key) {
+			auto &s = streams[key];
+			if (s.interval_ns == INT64_MAX)
+				stat.dropped++;
+			else if (!try_send(s, &s.msg, LinkStats::frame_length(s.msg), now_ns, send))
+				return false;
+
+			s.waiting = false;
+			return true;
+		});
+	waiting.erase(wend, waiting.end());
+
+	for (size_t i = 0; i < count; i++) {
+		auto &msg = msgs[i];
+		auto len = LinkStats::frame_length(msg);
+
+		if (priority.count(msg.msgid)) {
+			send(&msg);
+			stat.forwarded++;
+			tokens -= len;
+			continue;
+		}
+
+		uint64_t key = uint64_t(msg.msgid) << 16 | msg.sysid << 8 | msg.compid;
+		auto it = streams.find(key);
+		if (it == streams.end()) {
+			auto iv = intervals.find(msg.msgid);
+			Stream s {};
+			s.interval_ns = (iv != intervals.end()) ? iv->second : 0;
+			it = streams.emplace(key, s).first;
+		}
+
+		auto &s = it->second;
+		if (s.interval_ns == INT64_MAX) {
+			stat.dropped++;
+			continue;
+		}
+
+		if (s.waiting) {
+			s.msg = msg;
+			stat.replaced++;
+			continue;
+		}
+
+		if (try_send(s, &msg, len, now_ns, send))
+			continue;
+
+		s.msg = msg;
+		s.waiting = true;
+		waiting.push_back(key);
+	}
+
+	if (budget_Bps == 0.0 && intervals.empty() && waiting.empty())
+		active = false;
+}
+
+TxShaper::Stat TxShaper::get_stat()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto ret = stat;
+	ret.waiting = waiting.size();
+	return ret;
+}
+}	// namespace mavconn
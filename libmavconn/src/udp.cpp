@@ -15,12 +15,20 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <cstring>
 
 #include <mavconn/console_bridge_compat.h>
 #include <mavconn/thread_utils.h>
 #include <mavconn/udp.h>
 
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+#endif
+
 namespace mavconn {
 
 using boost::system::error_code;
@@ -64,30 +72,65 @@ static bool resolve_address_udp(io_service &io, size_t chan, std::string host, u
 	return result;
 }
 
+#ifdef __linux__
+//! Kernel timestamp of last datagram read from @a fd
+static uint64_t socket_rx_stamp(int fd)
+{
+	struct timespec ts;
+	if (ioctl(fd, SIOCGSTAMPNS, &ts) < 0)
+		return MAVConnInterface::rx_stamp_now();
+
+	return uint64_t(ts.tv_sec) * 1000000000UL + ts.tv_nsec;
+}
+
+//! SCM_TIMESTAMPNS of datagram received by recvmmsg()
+static uint64_t cmsg_rx_stamp(msghdr &hdr)
+{
+	for (auto cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+			struct timespec ts;
+			memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+			return uint64_t(ts.tv_sec) * 1000000000UL + ts.tv_nsec;
+		}
+	}
+
+	return MAVConnInterface::rx_stamp_now();
+}
+#endif
+
 
 MAVConnUDP::MAVConnUDP(uint8_t system_id, uint8_t component_id,
 		std::string bind_host, unsigned short bind_port,
-		std::string remote_host, unsigned short remote_port) :
+		std::string remote_host, unsigned short remote_port,
+		IOPool::Ptr io_pool_) :
 	MAVConnInterface(system_id, component_id),
+	io_pool(io_pool_ ? io_pool_ : std::make_shared<IOPool>(1, utils::format("mudp%zu", conn_id))),
+	own_pool(!io_pool_),
 	remote_exists(false),
-	tx_in_progress(false),
-	tx_q {},
+	tx_q(MAX_TXQ_SIZE, &link_stats),
+	batch_size(0),
 	rx_buf {},
-	io_service(),
-	io_work(new io_service::work(io_service)),
-	socket(io_service),
-	permanent_broadcast(false)
+	strand(io_pool->io_service),
+	socket(io_pool->io_service),
+	permanent_broadcast(false),
+	server_mode(false),
+	max_peers(DEFAULT_MAX_PEERS),
+	peer_timeout(std::chrono::duration_cast<steady_clock::duration>(std::chrono::duration<float>(float(DEFAULT_PEER_TIMEOUT))))
 {
 	using udps = boost::asio::ip::udp::socket;
 
-	if (!resolve_address_udp(io_service, conn_id, bind_host, bind_port, bind_ep))
+	if (!resolve_address_udp(io_pool->io_service, conn_id, bind_host, bind_port, bind_ep))
 		throw DeviceError("udp: resolve", "Bind address resolve failed");
 
 	CONSOLE_BRIDGE_logInform(PFXd "Bind address: %s", conn_id, to_string_ss(bind_ep).c_str());
 
-	if (remote_host != "") {
+	if (remote_host == SERVER_REMOTE_HOST) {
+		server_mode = true;
+		CONSOLE_BRIDGE_logInform(PFXd "Server mode, waiting for peers", conn_id);
+	}
+	else if (remote_host != "") {
 		if (remote_host != BROADCAST_REMOTE_HOST && remote_host != PERMANENT_BROADCAST_REMOTE_HOST)
-			remote_exists = resolve_address_udp(io_service, conn_id, remote_host, remote_port, remote_ep);
+			remote_exists = resolve_address_udp(io_pool->io_service, conn_id, remote_host, remote_port, remote_ep);
 		else {
 			remote_exists = true;
 			remote_ep = udp::endpoint(boost::asio::ip::address_v4::broadcast(), remote_port);
@@ -109,6 +152,13 @@ MAVConnUDP::MAVConnUDP(uint8_t system_id, uint8_t component_id,
 
 		socket.bind(bind_ep);
 
+#ifdef __linux__
+		// kernel receive time, falls back to read time if not supported
+		int on = 1;
+		if (setsockopt(socket.native_handle(), SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0)
+			CONSOLE_BRIDGE_logWarn(PFXd "SO_TIMESTAMPNS: %s", conn_id, strerror(errno));
+#endif
+
 		if (remote_host == BROADCAST_REMOTE_HOST) {
 			socket.set_option(udps::broadcast(true));
 		} else if (remote_host == PERMANENT_BROADCAST_REMOTE_HOST) {
@@ -123,13 +173,7 @@ MAVConnUDP::MAVConnUDP(uint8_t system_id, uint8_t component_id,
 	// NOTE: shared_from_this() should not be used in constructors
 
 	// give some work to io_service before start
-	io_service.post(std::bind(&MAVConnUDP::do_recvfrom, this));
-
-	// run io_service for async io
-	io_thread = std::thread([this] () {
-				utils::set_this_thread_name("mudp%zu", conn_id);
-				io_service.run();
-			});
+	strand.post(std::bind(&MAVConnUDP::do_recvfrom, this));
 }
 
 MAVConnUDP::~MAVConnUDP()
@@ -139,25 +183,32 @@ MAVConnUDP::~MAVConnUDP()
 
 void MAVConnUDP::close()
 {
-	if (!is_open())
-		return;
-	lock_guard lock(mutex);
-
-	socket.cancel();
-	socket.close();
-
-	io_work.reset();
-	io_service.stop();
+	{
+		lock_guard lock(mutex);
+		// handler may close link at the same time
+		if (!is_open())
+			return;
 
-	if (io_thread.joinable())
-		io_thread.join();
+		socket.cancel();
+		socket.close();
+	}
 
-	io_service.reset();
+	if (own_pool)
+		io_pool->stop();
+	else
+		io_pool->sync(strand);
 
 	if (port_closed_cb)
 		port_closed_cb();
 }
 
+void MAVConnUDP::add_tx_lane(TxPolicy policy, const std::vector<mavlink::msgid_t> &msgids, size_t capacity)
+{
+	tx_q.add_lane(policy, msgids, capacity);
+	if (policy != TxPolicy::DROP_OLDEST)
+		tx_flow.add_priority(msgids);
+}
+
 void MAVConnUDP::send_bytes(const uint8_t *bytes, size_t length)
 {
 	if (!is_open()) {
@@ -170,15 +221,11 @@ void MAVConnUDP::send_bytes(const uint8_t *bytes, size_t length)
 		return;
 	}
 
-	{
-		lock_guard lock(mutex);
-
-		if (tx_q.size() >= MAX_TXQ_SIZE)
-			throw std::length_error("MAVConnUDP::send_bytes: TX queue overflow");
+	if (!tx_q.emplace(bytes, length))
+		throw std::length_error("MAVConnUDP::send_bytes: TX queue overflow");
 
-		tx_q.emplace_back(bytes, length);
-	}
-	io_service.post(std::bind(&MAVConnUDP::do_sendto, shared_from_this(), true));
+	if (tx_q.need_wakeup())
+		strand.post(std::bind(&MAVConnUDP::do_sendto, shared_from_this()));
 }
 
 void MAVConnUDP::send_message(const mavlink_message_t *message)
@@ -197,15 +244,16 @@ void MAVConnUDP::send_message(const mavlink_message_t *message)
 
 	log_send(PFX, message);
 
-	{
-		lock_guard lock(mutex);
+	if (!tx_flow_admit(message->msgid))
+		return;
 
-		if (tx_q.size() >= MAX_TXQ_SIZE)
-			throw std::length_error("MAVConnUDP::send_message: TX queue overflow");
+	auto len = tx_q.emplace_msg(message->msgid, message);
+	trace_tx(message, len);
+	if (!len)
+		throw std::length_error("MAVConnUDP::send_message: TX queue overflow");
 
-		tx_q.emplace_back(message);
-	}
-	io_service.post(std::bind(&MAVConnUDP::do_sendto, shared_from_this(), true));
+	if (tx_q.need_wakeup())
+		strand.post(std::bind(&MAVConnUDP::do_sendto, shared_from_this()));
 }
 
 void MAVConnUDP::send_message(const mavlink::Message &message, const uint8_t source_compid)
@@ -222,58 +270,274 @@ void MAVConnUDP::send_message(const mavlink::Message &message, const uint8_t sou
 
 	log_send_obj(PFX, message);
 
-	{
-		lock_guard lock(mutex);
+	auto msgid = message.get_message_info().id;
+	if (!tx_flow_admit(msgid))
+		return;
+
+	auto status = get_tx_status();
+	auto seq = status.current_tx_seq;
+	auto len = tx_q.emplace_msg(msgid, message, &status, sys_id, source_compid, signing_p());
+	trace(len ? TraceEvent::TX : TraceEvent::TX_DROP, msgid, len, seq, sys_id, source_compid);
+	record_tx_obj(message, seq, source_compid, len);
+	if (!len)
+		throw std::length_error("MAVConnUDP::send_message: TX queue overflow");
+
+	if (tx_q.need_wakeup())
+		strand.post(std::bind(&MAVConnUDP::do_sendto, shared_from_this()));
+}
+
+void MAVConnUDP::set_batch_size(size_t n)
+{
+#ifdef __linux__
+	if (n > MAX_BATCH_SIZE)
+		n = MAX_BATCH_SIZE;
 
-		if (tx_q.size() >= MAX_TXQ_SIZE)
-			throw std::length_error("MAVConnUDP::send_message: TX queue overflow");
+	batch_size = n;
+#else
+	if (n > 1)
+		CONSOLE_BRIDGE_logWarn(PFXd "batch mode is not supported on this system", conn_id);
+#endif
+}
 
-		tx_q.emplace_back(message, get_status_p(), sys_id, source_compid);
+void MAVConnUDP::set_peer_limits(size_t max_peers_, float timeout)
+{
+	std::lock_guard<std::mutex> lock(peers_mutex);
+
+	max_peers = std::max<size_t>(1, std::min(max_peers_, size_t(MAX_PEERS)));
+	peer_timeout = std::chrono::duration_cast<steady_clock::duration>(std::chrono::duration<float>(timeout));
+}
+
+std::vector<MAVConnUDP::PeerStat> MAVConnUDP::get_peers()
+{
+	std::lock_guard<std::mutex> lock(peers_mutex);
+	std::vector<PeerStat> ret;
+	auto now = steady_clock::now();
+
+	ret.reserve(peers.size());
+	for (auto &p : peers) {
+		ret.push_back(PeerStat {
+				to_string_ss(p.ep),
+				p.rx_packets, p.rx_bytes,
+				p.tx_packets, p.tx_bytes,
+				std::chrono::duration<float>(now - p.last_rx).count()
+			});
 	}
-	io_service.post(std::bind(&MAVConnUDP::do_sendto, shared_from_this(), true));
+
+	return ret;
 }
 
-void MAVConnUDP::do_recvfrom()
+void MAVConnUDP::expire_peers(steady_clock::time_point now)
 {
+	auto it = std::remove_if(peers.begin(), peers.end(), [&](const Peer &p) {
+				if (now - p.last_rx <= peer_timeout)
+					return false;
+
+				CONSOLE_BRIDGE_logInform(PFXd "Peer %s timed out", conn_id, to_string_ss(p.ep).c_str());
+				return true;
+			});
+
+	peers.erase(it, peers.end());
+	remote_exists = !peers.empty();
+}
+
+void MAVConnUDP::peer_rx(const udp::endpoint &ep, size_t bytes)
+{
+	auto now = steady_clock::now();
+	std::lock_guard<std::mutex> lock(peers_mutex);
+
+	auto it = std::find_if(peers.begin(), peers.end(), [&ep](const Peer &p) { return p.ep == ep; });
+	if (it == peers.end()) {
+		expire_peers(now);
+		if (peers.size() >= max_peers) {
+			CONSOLE_BRIDGE_logDebug(PFXd "Peer table full, %s ignored", conn_id, to_string_ss(ep).c_str());
+			return;
+		}
+
+		peers.push_back(Peer {ep, now, 0, 0, 0, 0});
+		it = peers.end() - 1;
+		remote_exists = true;
+
+		CONSOLE_BRIDGE_logInform(PFXd "Peer %s added (%zu peers)", conn_id, to_string_ss(ep).c_str(), peers.size());
+	}
+
+	it->last_rx = now;
+	it->rx_packets++;
+	it->rx_bytes += bytes;
+}
+
+void MAVConnUDP::do_sendpeers()
+{
+	// same ring ownership rules as do_sendto()
+	auto buf = tx_q.next();
+	if (buf == nullptr)
+		return;
+
 	auto sthis = shared_from_this();
+	std::lock_guard<std::mutex> lock(peers_mutex);
+
+	expire_peers(steady_clock::now());
+	size_t npeers = peers.size();
+	if (npeers == 0) {
+		// every peer gone, queued frames have no receiver
+		for (; buf != nullptr; buf = tx_q.next())
+			tx_q.consume(buf->nbytes());
+		return;
+	}
+
+#ifdef __linux__
+	// one sendmmsg() for several frames, each frame to all peers
+	size_t nbufs = tx_q.gather(tx_bufs.data(), std::max<size_t>(1, MAX_BATCH_SIZE / npeers), SIZE_MAX);
+	size_t cnt = 0;
+	for (size_t i = 0; i < nbufs; i++) {
+		tx_iov[i].iov_base = const_cast<void *>(tx_bufs[i].data());
+		tx_iov[i].iov_len = tx_bufs[i].size();
+
+		for (auto &p : peers) {
+			auto &hdr = tx_hdr[cnt++].msg_hdr;
+			hdr = {};
+			hdr.msg_name = p.ep.data();
+			hdr.msg_namelen = p.ep.size();
+			hdr.msg_iov = &tx_iov[i];
+			hdr.msg_iovlen = 1;
+		}
+	}
+
+	int ret = ::sendmmsg(socket.native_handle(), tx_hdr.data(), cnt, MSG_DONTWAIT);
+	if (ret < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			socket.async_wait(udp::socket::wait_write,
+					strand.wrap([sthis] (error_code error) {
+						if (error) {
+							CONSOLE_BRIDGE_logError(PFXd "sendto: %s", sthis->conn_id, error.message().c_str());
+							sthis->close();
+							return;
+						}
+
+						sthis->do_sendpeers();
+					}));
+			return;
+		}
+		else if (errno == ENETUNREACH || errno == EINTR) {
+			CONSOLE_BRIDGE_logWarn(PFXd "sendto: %s, retrying", conn_id, strerror(errno));
+			ret = 0;
+		}
+		else {
+			CONSOLE_BRIDGE_logError(PFXd "sendto: %s", conn_id, strerror(errno));
+			strand.post(std::bind(&MAVConnUDP::close, sthis));
+			return;
+		}
+	}
+
+	size_t wire_bytes = 0;
+	for (int k = 0; k < ret; k++) {
+		auto &p = peers[k % npeers];
+		p.tx_packets++;
+		p.tx_bytes += tx_iov[k / npeers].iov_len;
+		wire_bytes += tx_iov[k / npeers].iov_len;
+	}
+
+	// frame partially sent is not repeated to peers which already got it
+	size_t sent = (ret + npeers - 1) / npeers;
+	size_t bytes = 0;
+	for (size_t i = 0; i < sent; i++)
+		bytes += tx_iov[i].iov_len;
+#else
+	size_t wire_bytes = 0;
+	size_t bytes = buf->nbytes();
+	for (auto &p : peers) {
+		error_code ec;
+		socket.send_to(buffer(buf->dpos(), bytes), p.ep, 0, ec);
+		if (ec) {
+			CONSOLE_BRIDGE_logWarn(PFXd "sendto %s: %s", conn_id, to_string_ss(p.ep).c_str(), ec.message().c_str());
+			continue;
+		}
+
+		p.tx_packets++;
+		p.tx_bytes += bytes;
+		wire_bytes += bytes;
+	}
+#endif
+
+	iostat_tx_add(wire_bytes);
+	tx_q.consume(bytes);
+
+	// continue from io_service queue, so receive is not starved
+	strand.post(std::bind(&MAVConnUDP::do_sendto, sthis));
+}
+
+void MAVConnUDP::do_recvfrom()
+{
+	std::shared_ptr<MAVConnUDP> sthis;
+	try {
+		sthis = shared_from_this();
+	}
+	catch (std::bad_weak_ptr &) {
+		// first call is posted by constructor and may run before make_shared() returns
+		if (is_open())
+			strand.post(std::bind(&MAVConnUDP::do_recvfrom, this));
+		return;
+	}
+
+#ifdef __linux__
+	if (batch_size > 1) {
+		do_recvmmsg();
+		return;
+	}
+#endif
+
 	socket.async_receive_from(
 			buffer(rx_buf),
-			permanent_broadcast ? recv_ep : remote_ep,
-			[sthis] (error_code error, size_t bytes_transferred) {
+			(permanent_broadcast || server_mode) ? recv_ep : remote_ep,
+			strand.wrap([sthis] (error_code error, size_t bytes_transferred) {
 				if (error) {
 					CONSOLE_BRIDGE_logError(PFXd "receive: %s", sthis->conn_id, error.message().c_str());
 					sthis->close();
 					return;
 				}
 
-				if (!sthis->permanent_broadcast && sthis->remote_ep != sthis->last_remote_ep) {
+				if (sthis->server_mode)
+					sthis->peer_rx(sthis->recv_ep, bytes_transferred);
+				else if (!sthis->permanent_broadcast && sthis->remote_ep != sthis->last_remote_ep) {
 					CONSOLE_BRIDGE_logInform(PFXd "Remote address: %s", sthis->conn_id, to_string_ss(sthis->remote_ep).c_str());
 					sthis->remote_exists = true;
 					sthis->last_remote_ep = sthis->remote_ep;
 				}
 
+#ifdef __linux__
+				sthis->set_rx_stamp(socket_rx_stamp(sthis->socket.native_handle()));
+#else
+				sthis->set_rx_stamp(rx_stamp_now());
+#endif
 				sthis->parse_buffer(PFX, sthis->rx_buf.data(), sthis->rx_buf.size(), bytes_transferred);
 				sthis->do_recvfrom();
-			});
+			}));
 }
 
-void MAVConnUDP::do_sendto(bool check_tx_state)
+void MAVConnUDP::do_sendto()
 {
-	if (check_tx_state && tx_in_progress)
+	if (server_mode) {
+		do_sendpeers();
 		return;
+	}
+
+#ifdef __linux__
+	if (batch_size > 1) {
+		do_sendmmsg();
+		return;
+	}
+#endif
 
-	lock_guard lock(mutex);
-	if (tx_q.empty())
+	// IO thread owns ring tail until next() marks it idle
+	auto buf = tx_q.next();
+	if (buf == nullptr)
 		return;
 
-	tx_in_progress = true;
 	auto sthis = shared_from_this();
-	auto &buf_ref = tx_q.front();
 	socket.async_send_to(
-			buffer(buf_ref.dpos(), buf_ref.nbytes()),
+			buffer(buf->dpos(), buf->nbytes()),
 			remote_ep,
-			[sthis, &buf_ref] (error_code error, size_t bytes_transferred) {
-				assert(bytes_transferred <= buf_ref.len);
+			strand.wrap([sthis, buf] (error_code error, size_t bytes_transferred) {
+				assert(bytes_transferred <= buf->len);
 
 				if (error == boost::asio::error::network_unreachable) {
 					CONSOLE_BRIDGE_logWarn(PFXd "sendto: %s, retrying", sthis->conn_id, error.message().c_str());
@@ -286,22 +550,141 @@ void MAVConnUDP::do_sendto(bool check_tx_state)
 				}
 
 				sthis->iostat_tx_add(bytes_transferred);
-				lock_guard lock(sthis->mutex);
+				sthis->tx_q.consume(bytes_transferred);
+				sthis->do_sendto();
+			}));
+}
 
-				if (sthis->tx_q.empty()) {
-					sthis->tx_in_progress = false;
+#ifdef __linux__
+void MAVConnUDP::do_recvmmsg()
+{
+	auto sthis = shared_from_this();
+	socket.async_wait(udp::socket::wait_read,
+			strand.wrap([sthis] (error_code error) {
+				if (error) {
+					CONSOLE_BRIDGE_logError(PFXd "receive: %s", sthis->conn_id, error.message().c_str());
+					sthis->close();
 					return;
 				}
 
-				buf_ref.pos += bytes_transferred;
-				if (buf_ref.nbytes() == 0) {
-					sthis->tx_q.pop_front();
+				auto &rb = sthis->rx_batch;
+				size_t n = sthis->batch_size;
+				if (rb.hdr.size() < n) {
+					rb.hdr.resize(n);
+					rb.iov.resize(n);
+					rb.addr.resize(n);
+					rb.buf.resize(n);
+					rb.ctl.resize(n);
 				}
 
-				if (!sthis->tx_q.empty())
-					sthis->do_sendto(false);
-				else
-					sthis->tx_in_progress = false;
-			});
+				for (size_t i = 0; i < n; i++) {
+					rb.iov[i].iov_base = rb.buf[i].data();
+					rb.iov[i].iov_len = rb.buf[i].size();
+
+					auto &hdr = rb.hdr[i].msg_hdr;
+					hdr = {};
+					hdr.msg_name = &rb.addr[i];
+					hdr.msg_namelen = sizeof(rb.addr[i]);
+					hdr.msg_iov = &rb.iov[i];
+					hdr.msg_iovlen = 1;
+					hdr.msg_control = rb.ctl[i].data();
+					hdr.msg_controllen = rb.ctl[i].size();
+				}
+
+				int ret = ::recvmmsg(sthis->socket.native_handle(), rb.hdr.data(), n, MSG_DONTWAIT, nullptr);
+				if (ret < 0) {
+					if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+						CONSOLE_BRIDGE_logError(PFXd "receive: %s", sthis->conn_id, strerror(errno));
+						sthis->close();
+						return;
+					}
+
+					ret = 0;
+				}
+
+				for (int i = 0; i < ret; i++) {
+					auto &ep = (sthis->permanent_broadcast || sthis->server_mode) ? sthis->recv_ep : sthis->remote_ep;
+					auto &hdr = rb.hdr[i].msg_hdr;
+
+					memcpy(ep.data(), hdr.msg_name, std::min<size_t>(hdr.msg_namelen, ep.capacity()));
+					ep.resize(std::min<size_t>(hdr.msg_namelen, ep.capacity()));
+
+					if (sthis->server_mode)
+						sthis->peer_rx(sthis->recv_ep, rb.hdr[i].msg_len);
+					else if (!sthis->permanent_broadcast && sthis->remote_ep != sthis->last_remote_ep) {
+						CONSOLE_BRIDGE_logInform(PFXd "Remote address: %s", sthis->conn_id, to_string_ss(sthis->remote_ep).c_str());
+						sthis->remote_exists = true;
+						sthis->last_remote_ep = sthis->remote_ep;
+					}
+
+					sthis->set_rx_stamp(cmsg_rx_stamp(hdr));
+
+					// all datagrams of the batch delivered by one callback
+					sthis->parse_buffer(PFX, rb.buf[i].data(), rb.buf[i].size(), rb.hdr[i].msg_len, false);
+				}
+
+				sthis->rx_flush(PFX);
+				sthis->do_recvfrom();
+			}));
+}
+
+void MAVConnUDP::do_sendmmsg()
+{
+	// same ring ownership rules as do_sendto()
+	if (tx_q.next() == nullptr)
+		return;
+
+	size_t cnt = tx_q.gather(tx_bufs.data(), batch_size, SIZE_MAX);
+	for (size_t i = 0; i < cnt; i++) {
+		tx_iov[i].iov_base = const_cast<void *>(tx_bufs[i].data());
+		tx_iov[i].iov_len = tx_bufs[i].size();
+
+		auto &hdr = tx_hdr[i].msg_hdr;
+		hdr = {};
+		hdr.msg_name = remote_ep.data();
+		hdr.msg_namelen = remote_ep.size();
+		hdr.msg_iov = &tx_iov[i];
+		hdr.msg_iovlen = 1;
+	}
+
+	auto sthis = shared_from_this();
+	int ret = ::sendmmsg(socket.native_handle(), tx_hdr.data(), cnt, MSG_DONTWAIT);
+	if (ret < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			socket.async_wait(udp::socket::wait_write,
+					strand.wrap([sthis] (error_code error) {
+						if (error) {
+							CONSOLE_BRIDGE_logError(PFXd "sendto: %s", sthis->conn_id, error.message().c_str());
+							sthis->close();
+							return;
+						}
+
+						sthis->do_sendmmsg();
+					}));
+			return;
+		}
+		else if (errno == ENETUNREACH || errno == EINTR) {
+			CONSOLE_BRIDGE_logWarn(PFXd "sendto: %s, retrying", conn_id, strerror(errno));
+			// do not return, try to resend
+			ret = 0;
+		}
+		else {
+			CONSOLE_BRIDGE_logError(PFXd "sendto: %s", conn_id, strerror(errno));
+			close();
+			return;
+		}
+	}
+
+	// datagrams are sent whole
+	size_t bytes = 0;
+	for (int i = 0; i < ret; i++)
+		bytes += tx_iov[i].iov_len;
+
+	iostat_tx_add(bytes);
+	tx_q.consume(bytes);
+
+	// continue from io_service queue, so receive is not starved
+	strand.post(std::bind(&MAVConnUDP::do_sendto, sthis));
 }
+#endif
 }	// namespace mavconn
@@ -0,0 +1,376 @@
+/**
+ * Benchmark mavconn library
+ *
+ * Not a test, not run by ctest. Run by hand:
+ *     mavconn-bench [--benchmark_filter=regex]
+ *
+ * parse_buffer corpus is generated (mixed v1/v2 frames) or read
+ * from raw capture file given by MAVCONN_BENCH_CORPUS environment variable.
+ *
+ * Loopback benchmarks report msgs/s, bytes/s and p50/p99/p999 latency [us].
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <mavconn/interface.h>
+#include <mavconn/msgbuffer.h>
+#include <mavconn/serial.h>
+#include <mavconn/sha256.h>
+#include <mavconn/signing.h>
+#include <mavconn/tcp.h>
+#include <mavconn/thread_utils.h>
+#include <mavconn/udp.h>
+
+using namespace mavconn;
+using mavlink::mavlink_message_t;
+
+static inline int64_t now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			steady_clock::now().time_since_epoch()).count();
+}
+
+/* -*- parser -*- */
+
+//! Connection without transport, feeds parser directly
+class ParserFeed : public MAVConnInterface {
+public:
+	size_t frames = 0;
+
+	explicit ParserFeed(Parser parser) : MAVConnInterface(1, 1) {
+		set_parser(parser);
+		message_received_cb = [this](const mavlink_message_t *msg, const Framing framing) {
+			frames++;
+		};
+	}
+
+	void close() override {}
+	void send_message(const mavlink_message_t *message) override {}
+	void send_message(const mavlink::Message &message, const uint8_t source_compid) override {}
+	void send_bytes(const uint8_t *bytes, size_t length) override {}
+	bool is_open() override {
+		return true;
+	}
+
+	void feed(uint8_t *buf, size_t len) {
+		parse_buffer("bench: ", buf, len, len);
+	}
+};
+
+//! Mixed v1/v2 HEARTBEAT and COMMAND_LONG frames, some v2 payload trimmed
+static const std::vector<uint8_t> &corpus()
+{
+	static std::vector<uint8_t> data;
+	if (!data.empty())
+		return data;
+
+	auto path = std::getenv("MAVCONN_BENCH_CORPUS");
+	if (path != nullptr) {
+		std::ifstream f(path, std::ios::binary);
+		data.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+		if (!data.empty())
+			return data;
+	}
+
+	mavlink::mavlink_status_t v1 {}, v2 {};
+	v1.flags |= MAVLINK_STATUS_FLAG_OUT_MAVLINK1;
+
+	mavlink::common::msg::HEARTBEAT hb {};
+	mavlink::common::msg::COMMAND_LONG cmd {};
+
+	for (size_t i = 0; data.size() < 256 * 1024; i++) {
+		hb.custom_mode = i;
+		cmd.dummy[0] = i;
+
+		MsgBuffer buf = (i % 3 == 0) ? MsgBuffer(hb, &v1, 1, 1) :
+				(i % 3 == 1) ? MsgBuffer(hb, &v2, 1, 1) : MsgBuffer(cmd, &v2, 255, 190);
+		auto p = static_cast<const uint8_t *>(buf.dpos());
+		data.insert(data.end(), p, p + buf.nbytes());
+	}
+
+	return data;
+}
+
+static void BM_ParseBuffer(benchmark::State &state)
+{
+	auto data = corpus();
+	ParserFeed conn(Parser(state.range(0)));
+
+	for (auto _ : state)
+		conn.feed(data.data(), data.size());
+
+	state.SetLabel(state.range(0) == int(Parser::BLOCK) ? "block" : "char");
+	state.SetBytesProcessed(state.iterations() * data.size());
+	state.SetItemsProcessed(conn.frames);
+}
+BENCHMARK(BM_ParseBuffer)->Arg(int(Parser::CHAR))->Arg(int(Parser::BLOCK));
+
+/* -*- MsgBuffer -*- */
+
+static void BM_MsgBufferFromMessage(benchmark::State &state)
+{
+	mavlink::mavlink_status_t st {};
+	mavlink::common::msg::COMMAND_LONG cmd {};
+
+	for (auto _ : state) {
+		MsgBuffer buf(cmd, &st, 1, 1);
+		benchmark::DoNotOptimize(buf.dpos());
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MsgBufferFromMessage);
+
+static void BM_MsgBufferFromFrame(benchmark::State &state)
+{
+	mavlink::mavlink_status_t st {};
+	mavlink::common::msg::COMMAND_LONG cmd {};
+	mavlink_message_t msg;
+	mavlink::MsgMap map(msg);
+	auto mi = cmd.get_message_info();
+
+	cmd.serialize(map);
+	mavlink::mavlink_finalize_message_buffer(&msg, 1, 1, &st, mi.min_length, mi.length, mi.crc_extra);
+
+	for (auto _ : state) {
+		MsgBuffer buf(&msg);
+		benchmark::DoNotOptimize(buf.dpos());
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MsgBufferFromFrame);
+
+/* -*- signing -*- */
+
+//! Hash of longest signed frame: key, header, payload, CRC, link_id and timestamp
+static void BM_Sha256(benchmark::State &state)
+{
+	auto impl = sha256::Impl(state.range(0));
+	auto detected = sha256::get_impl();
+	if (!sha256::set_impl(impl)) {
+		state.SkipWithError("not supported by CPU");
+		return;
+	}
+
+	std::vector<uint8_t> data(32 + MAVLINK_NUM_HEADER_BYTES + MAVLINK_MAX_PAYLOAD_LEN + MAVLINK_NUM_CHECKSUM_BYTES + 7, 0x55);
+	for (auto _ : state)
+		benchmark::DoNotOptimize(sha256::digest(data.data(), data.size()));
+
+	sha256::set_impl(detected);
+	state.SetLabel(sha256::to_string(impl));
+	state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_Sha256)->Arg(int(sha256::Impl::GENERIC))->Arg(int(sha256::Impl::SHA_NI))->Arg(int(sha256::Impl::ARMV8));
+
+static void BM_MsgBufferSigned(benchmark::State &state)
+{
+	mavlink::mavlink_status_t st {};
+	mavlink::common::msg::COMMAND_LONG cmd {};
+	MessageSigning signing(MessageSigning::Options {});
+
+	for (auto _ : state) {
+		MsgBuffer buf(cmd, &st, 1, 1, &signing);
+		buf.sign();
+		benchmark::DoNotOptimize(buf.dpos());
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MsgBufferSigned);
+
+//! Parse signed corpus, arg 1 - replayed frames, rejected before hash
+static void BM_ParseSigned(benchmark::State &state)
+{
+	MessageSigning::Options opts;
+	MessageSigning tx(opts);
+	mavlink::mavlink_status_t st {};
+	mavlink::common::msg::HEARTBEAT hb {};
+	std::vector<uint8_t> data;
+
+	for (size_t i = 0; data.size() < 256 * 1024; i++) {
+		hb.custom_mode = i;
+		MsgBuffer buf(hb, &st, 1, 1, &tx);
+		buf.sign();
+		data.insert(data.end(), buf.dpos(), buf.dpos() + buf.nbytes());
+	}
+
+	ParserFeed conn(Parser::BLOCK);
+	auto replay = state.range(0) != 0;
+	if (replay) {
+		conn.set_signing(std::make_shared<MessageSigning>(opts));
+		conn.feed(data.data(), data.size());
+		conn.frames = 0;
+	}
+
+	for (auto _ : state) {
+		if (!replay) {
+			state.PauseTiming();
+			conn.set_signing(std::make_shared<MessageSigning>(opts));
+			state.ResumeTiming();
+		}
+
+		conn.feed(data.data(), data.size());
+	}
+
+	state.SetLabel(replay ? "replay" : "verify");
+	state.SetBytesProcessed(state.iterations() * data.size());
+	state.SetItemsProcessed(conn.frames);
+}
+BENCHMARK(BM_ParseSigned)->Arg(0)->Arg(1);
+
+/* -*- loopback -*- */
+
+/**
+ * Send HEARTBEATs with sequence number in custom_mode, receiver computes latency.
+ * At most WINDOW messages in flight, so Tx queue never overflows.
+ */
+class Loopback {
+public:
+	static constexpr size_t WINDOW = 64;
+	static constexpr size_t SLOTS = 4096;	//!< send stamps ring, > WINDOW
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	uint32_t received = 0;
+	size_t rx_bytes = 0;
+	std::vector<int64_t> send_ns;
+	std::vector<int64_t> latency_ns;
+
+	Loopback() : send_ns(SLOTS) {
+		latency_ns.reserve(1 << 20);
+	}
+
+	//! Install receive callback on @a rx
+	void attach(MAVConnInterface *rx) {
+		rx->message_received_cb = [this](const mavlink_message_t *msg, const Framing framing) {
+			uint32_t idx;
+			memcpy(&idx, _MAV_PAYLOAD(msg), sizeof(idx));
+
+			std::lock_guard<std::mutex> lock(mutex);
+			latency_ns.push_back(now_ns() - send_ns[idx % SLOTS]);
+			rx_bytes += LinkStats::frame_length(*msg);
+			received++;
+			cond.notify_one();
+		};
+	}
+
+	//! Wait until less than @a in_flight messages are not received
+	bool wait(uint32_t sent, size_t in_flight) {
+		std::unique_lock<std::mutex> lock(mutex);
+		return cond.wait_for(lock, std::chrono::seconds(1), [&]() { return sent - received <= in_flight; });
+	}
+
+	template<typename SendFn>
+	void run(benchmark::State &state, SendFn send) {
+		mavlink::common::msg::HEARTBEAT hb {};
+		uint32_t sent = 0;
+		size_t lost = 0;
+
+		for (auto _ : state) {
+			if (sent - received >= WINDOW && !wait(sent, WINDOW - 1)) {
+				// datagram lost, do not wait for it again
+				std::lock_guard<std::mutex> lock(mutex);
+				lost += sent - received;
+				received = sent;
+			}
+
+			hb.custom_mode = sent;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				send_ns[sent % SLOTS] = now_ns();
+			}
+			send(hb);
+			sent++;
+		}
+
+		if (!wait(sent, 0))
+			lost += sent - received;
+
+		report(state, lost);
+	}
+
+	void report(benchmark::State &state, size_t lost) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto &l = latency_ns;
+		std::sort(l.begin(), l.end());
+
+		auto pct = [&l](double p) {
+			return l.empty() ? 0.0 : l[std::min<size_t>(l.size() - 1, l.size() * p)] / 1e3;
+		};
+
+		state.SetItemsProcessed(l.size());
+		state.SetBytesProcessed(rx_bytes);
+		state.counters["msgs/s"] = benchmark::Counter(l.size(), benchmark::Counter::kIsRate);
+		state.counters["p50_us"] = pct(0.5);
+		state.counters["p99_us"] = pct(0.99);
+		state.counters["p999_us"] = pct(0.999);
+		state.counters["lost"] = lost;
+	}
+};
+
+static void BM_LoopbackUDP(benchmark::State &state)
+{
+	Loopback lb;
+	auto rx = std::make_shared<MAVConnUDP>(1, 1, "127.0.0.1", 45100);
+	auto tx = std::make_shared<MAVConnUDP>(1, 1, "127.0.0.1", 45101, "127.0.0.1", 45100);
+
+	lb.attach(rx.get());
+	lb.run(state, [&](const mavlink::Message &m) { tx->send_message(m, 1); });
+
+	tx->close();
+	rx->close();
+}
+BENCHMARK(BM_LoopbackUDP)->UseRealTime();
+
+static void BM_LoopbackTCP(benchmark::State &state)
+{
+	Loopback lb;
+	auto rx = std::make_shared<MAVConnTCPServer>(1, 1, "127.0.0.1", 57700);
+	auto tx = std::make_shared<MAVConnTCPClient>(1, 1, "127.0.0.1", 57700);
+
+	lb.attach(rx.get());
+	lb.run(state, [&](const mavlink::Message &m) { tx->send_message(m, 1); });
+
+	tx->close();
+	rx->close();
+}
+BENCHMARK(BM_LoopbackTCP)->UseRealTime();
+
+static void BM_LoopbackPTY(benchmark::State &state)
+{
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+		state.SkipWithError("no pty");
+		return;
+	}
+
+	Loopback lb;
+	mavlink::mavlink_status_t st {};
+	auto rx = MAVConnInterface::open_url(utils::format("serial://%s:921600", ptsname(master)));
+
+	// raw writes to master side, serial link reads slave side
+	lb.attach(rx.get());
+	lb.run(state, [&](const mavlink::Message &m) {
+			MsgBuffer buf(m, &st, 1, 1);
+			if (write(master, buf.dpos(), buf.nbytes()) < 0)
+				state.SkipWithError("pty write failed");
+		});
+
+	rx->close();
+	::close(master);
+}
+BENCHMARK(BM_LoopbackPTY)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -14,12 +14,30 @@
 //#include <rclcpp/rclcpp.hpp>
 
 #include <chrono>
+#include <random>
 #include <condition_variable>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include <mavconn/interface.h>
+#include <mavconn/bond.h>
+#include <mavconn/link_probe.h>
+#include <mavconn/file.h>
 #include <mavconn/serial.h>
+#include <mavconn/shm.h>
+#include <mavconn/thread_utils.h>
 #include <mavconn/udp.h>
 #include <mavconn/tcp.h>
+#include <mavconn/msgbuffer.h>
+#include <mavconn/router.h>
+#include <mavconn/sha256.h>
+#include <mavconn/signing.h>
+#include <mavconn/tx_shaper.h>
+#include <mavconn/tx_flow.h>
+#include <mavconn/msg_entry_table.h>
+#include <mavconn/tx_ring.h>
+#include <mavconn/tx_queue.h>
+#include <mavconn/tlog.h>
 
 using namespace mavconn;
 using mavlink::mavlink_message_t;
@@ -51,13 +69,17 @@ public:
 
 	void recv_message(const mavlink_message_t *message, const Framing framing) {
 		//printf("Got message %u, len: %u, framing: %d\n", message->msgid, message->len, int(framing));
+		std::lock_guard<std::mutex> lock(mutex);
 		message_id = message->msgid;
 		cond.notify_one();
 	}
 
+	//! reply may come before wait started, so wait for message_id change
 	bool wait_one() {
 		std::unique_lock<std::mutex> lock(mutex);
-		return cond.wait_for(lock, std::chrono::seconds(2)) == std::cv_status::no_timeout;
+		return cond.wait_for(lock, std::chrono::seconds(2), [this] () {
+				return message_id != std::numeric_limits<msgid_t>::max();
+			});
 	}
 };
 
@@ -81,8 +103,9 @@ TEST_F(UDP, send_message)
 
 	// create echo server
 	echo = std::make_shared<MAVConnUDP>(42, 200, "0.0.0.0", 45002);
-	echo->message_received_cb = [&](const mavlink_message_t * msg, const Framing framing) {
-		echo->send_message(msg);
+	// NOTE: IO loop keeps link alive after test scope, so do not capture local reference
+	echo->message_received_cb = [echo_p = echo.get()](const mavlink_message_t * msg, const Framing framing) {
+		echo_p->send_message(msg);
 	};
 
 	// create client
@@ -96,6 +119,216 @@ TEST_F(UDP, send_message)
 	EXPECT_EQ(message_id, msgid);
 }
 
+#ifdef __linux__
+TEST_F(UDP, send_message_batch)
+{
+	MAVConnInterface::Ptr echo, client;
+	std::atomic<size_t> received(0);
+	constexpr size_t count = 20;
+
+	// create echo server, recvmmsg/sendmmsg mode
+	echo = MAVConnInterface::open_url("udp://0.0.0.0:45010@/?batch=8");
+	ASSERT_EQ(std::dynamic_pointer_cast<MAVConnUDP>(echo)->get_batch_size(), 8);
+	echo->message_received_batch_cb = [echo_p = echo.get()](const mavlink_message_t *msgs, const Framing *framings, size_t cnt) {
+		for (size_t i = 0; i < cnt; i++)
+			echo_p->send_message(&msgs[i]);
+	};
+
+	// create client
+	client = std::make_shared<MAVConnUDP>(44, 200, "0.0.0.0", 45011, "localhost", 45010);
+	std::dynamic_pointer_cast<MAVConnUDP>(client)->set_batch_size(8);
+	client->message_received_cb = [&](const mavlink_message_t *msg, const Framing framing) {
+		if (++received == count)
+			cond.notify_one();
+	};
+
+	for (size_t i = 0; i < count; i++)
+		send_heartbeat(client.get());
+
+	std::unique_lock<std::mutex> lock(mutex);
+	EXPECT_TRUE(cond.wait_for(lock, std::chrono::seconds(2), [&]() { return received == count; }));
+}
+#endif
+
+TEST_F(UDP, rx_stamp)
+{
+	// both recvfrom (ioctl) and recvmmsg (cmsg) paths
+	for (size_t batch : {1, 4}) {
+		MAVConnInterface::Ptr receiver, client;
+		std::vector<uint64_t> stamps;
+
+		receiver = std::make_shared<MAVConnUDP>(42, 200, "0.0.0.0", 45018);
+		std::dynamic_pointer_cast<MAVConnUDP>(receiver)->set_batch_size(batch);
+		receiver->message_received_batch_cb = [&, rp = receiver.get()](const mavlink_message_t *msgs, const Framing *framings, size_t cnt) {
+			std::lock_guard<std::mutex> lock(mutex);
+			for (size_t i = 0; i < cnt; i++)
+				stamps.push_back(rp->get_rx_stamp(i));
+			cond.notify_one();
+		};
+
+		client = std::make_shared<MAVConnUDP>(44, 200, "0.0.0.0", 45019, "localhost", 45018);
+
+		auto t0 = MAVConnInterface::rx_stamp_now();
+		send_heartbeat(client.get());
+		send_heartbeat(client.get());
+
+		std::unique_lock<std::mutex> lock(mutex);
+		EXPECT_TRUE(cond.wait_for(lock, std::chrono::seconds(2), [&]() { return stamps.size() >= 2; }));
+		auto t1 = MAVConnInterface::rx_stamp_now();
+
+		for (auto stamp : stamps) {
+			EXPECT_GE(stamp, t0);
+			EXPECT_LE(stamp, t1);
+		}
+
+		lock.unlock();
+		receiver->close();
+		client->close();
+	}
+}
+
+TEST_F(UDP, shared_pool)
+{
+	MAVConnInterface::Ptr echo, client;
+
+	message_id = std::numeric_limits<msgid_t>::max();
+	auto msgid = mavlink::common::msg::HEARTBEAT::MSG_ID;
+
+	// both links on one pool, created by URL
+	echo = MAVConnInterface::open_url("udp://0.0.0.0:45012@/?pool=test-udp:2");
+	auto pool = IOPool::get("test-udp");
+	EXPECT_EQ(pool->size(), 2);
+
+	echo->message_received_cb = [echo_p = echo.get()](const mavlink_message_t * msg, const Framing framing) {
+		echo_p->send_message(msg);
+	};
+
+	client = std::make_shared<MAVConnUDP>(44, 200, "0.0.0.0", 45013, "localhost", 45012, pool);
+	client->message_received_cb = std::bind(&UDP::recv_message, this, std::placeholders::_1, std::placeholders::_2);
+
+	send_heartbeat(client.get());
+	send_heartbeat(client.get());
+	EXPECT_EQ(wait_one(), true);
+	EXPECT_EQ(message_id, msgid);
+
+	// closing one link should not stop others on the pool
+	echo->close();
+	EXPECT_FALSE(echo->is_open());
+	EXPECT_TRUE(client->is_open());
+	EXPECT_FALSE(pool->io_service.stopped());
+
+	client->close();
+}
+
+TEST_F(UDP, server_peers)
+{
+	MAVConnInterface::Ptr server, client1, client2;
+	std::atomic<int> replies(0);
+
+	server = MAVConnInterface::open_url("udp-s://0.0.0.0:45014?peers=4&peer_timeout=5");
+	auto udp = std::dynamic_pointer_cast<MAVConnUDP>(server);
+	ASSERT_NE(udp, nullptr);
+	EXPECT_TRUE(udp->is_server());
+
+	message_id = std::numeric_limits<msgid_t>::max();
+	server->message_received_cb = std::bind(&UDP::recv_message, this, std::placeholders::_1, std::placeholders::_2);
+
+	auto count_reply = [&replies](const mavlink_message_t * msg, const Framing framing) {
+		replies++;
+	};
+
+	client1 = std::make_shared<MAVConnUDP>(44, 200, "0.0.0.0", 45015, "localhost", 45014);
+	client1->message_received_cb = count_reply;
+	client2 = std::make_shared<MAVConnUDP>(45, 200, "0.0.0.0", 45016, "localhost", 45014);
+	client2->message_received_cb = count_reply;
+
+	send_heartbeat(client1.get());
+	send_heartbeat(client2.get());
+	EXPECT_EQ(wait_one(), true);
+
+	// second datagram may be still on the way
+	for (int i = 0; i < 100 && udp->get_peers().size() < 2; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	auto peers = udp->get_peers();
+	ASSERT_EQ(peers.size(), 2);
+	EXPECT_EQ(peers[0].rx_packets, 1);
+
+	// one frame goes to both peers
+	send_heartbeat(server.get());
+	for (int i = 0; i < 100 && replies < 2; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	EXPECT_EQ(replies, 2);
+	peers = udp->get_peers();
+	EXPECT_EQ(peers[0].tx_packets + peers[1].tx_packets, 2);
+
+	server->close();
+	client1->close();
+	client2->close();
+}
+
+TEST_F(UDP, bond)
+{
+	MAVConnInterface::Ptr fcu1, fcu2, bond;
+	std::atomic<size_t> fcu_rx[2] {{0}, {0}};
+	std::atomic<size_t> bond_rx(0);
+
+	// same FCU seen through two links
+	fcu1 = std::make_shared<MAVConnUDP>(1, 1, "0.0.0.0", 45020);
+	fcu2 = std::make_shared<MAVConnUDP>(1, 1, "0.0.0.0", 45021);
+	fcu1->message_received_cb = [&](const mavlink_message_t *msg, const Framing framing) { fcu_rx[0]++; };
+	fcu2->message_received_cb = [&](const mavlink_message_t *msg, const Framing framing) { fcu_rx[1]++; };
+
+	bond = MAVConnInterface::open_url("udp://:45022@localhost:45020|udp://:45023@localhost:45021");
+	auto bond_p = std::dynamic_pointer_cast<MAVConnBond>(bond);
+	ASSERT_NE(bond_p, nullptr);
+	bond->message_received_cb = [&](const mavlink_message_t *msg, const Framing framing) {
+		bond_rx++;
+		cond.notify_one();
+	};
+
+	// command goes by both links, so FCUs learn their remote
+	mavlink::common::msg::COMMAND_LONG cmd {};
+	bond->send_message(cmd);
+
+	auto wait = [&](std::function<bool()> pred) {
+		std::unique_lock<std::mutex> lock(mutex);
+		return cond.wait_for(lock, std::chrono::seconds(2), pred);
+	};
+	EXPECT_TRUE(wait([&]() { return fcu_rx[0] == 1 && fcu_rx[1] == 1; }));
+
+	// each frame is sent by both FCU links, bond delivers it once
+	mavlink::mavlink_status_t st {};
+	mavlink::common::msg::HEARTBEAT hb {};
+	for (size_t i = 0; i < 4; i++) {
+		MsgBuffer buf(hb, &st, 1, 1);
+		fcu1->send_bytes(buf.dpos(), buf.nbytes());
+		fcu2->send_bytes(buf.dpos(), buf.nbytes());
+	}
+
+	EXPECT_TRUE(wait([&]() {
+			uint64_t dups = 0;
+			for (auto &m : bond_p->get_members())
+				dups += m.rx_dups;
+			return bond_rx == 4 && dups == 4;
+		}));
+	EXPECT_EQ(bond_rx, 4);
+
+	// telemetry goes by one link
+	send_heartbeat(bond.get());
+	EXPECT_TRUE(wait([&]() { return fcu_rx[0] + fcu_rx[1] == 3; }));
+
+	auto members = bond_p->get_members();
+	ASSERT_EQ(members.size(), 2);
+	EXPECT_EQ(members[0].active + members[1].active, 1);
+	EXPECT_EQ(members[0].tx_frames + members[1].tx_frames, 3);
+
+	bond->close();
+	fcu1->close();
+	fcu2->close();
+}
+
 class TCP : public UDP {};
 
 TEST_F(TCP, bind_error)
@@ -121,8 +354,8 @@ TEST_F(TCP, send_message)
 
 	// create echo server
 	echo_server = std::make_shared<MAVConnTCPServer>(42, 200, "0.0.0.0", 57602);
-	echo_server->message_received_cb = [&](const mavlink_message_t * msg, const Framing framing) {
-		echo_server->send_message(msg);
+	echo_server->message_received_cb = [echo_p = echo_server.get()](const mavlink_message_t * msg, const Framing framing) {
+		echo_p->send_message(msg);
 	};
 
 	// create client
@@ -143,8 +376,8 @@ TEST_F(TCP, client_reconnect)
 
 	// create echo server
 	echo_server = std::make_shared<MAVConnTCPServer>(42, 200, "0.0.0.0", 57604);
-	echo_server->message_received_cb = [&](const mavlink_message_t * msg, const Framing framing) {
-		echo_server->send_message(msg);
+	echo_server->message_received_cb = [echo_p = echo_server.get()](const mavlink_message_t * msg, const Framing framing) {
+		echo_p->send_message(msg);
 	};
 
 	EXPECT_NO_THROW({
@@ -160,12 +393,114 @@ TEST_F(TCP, client_reconnect)
 		});
 }
 
+#ifdef __linux__
+class SHM : public UDP {};
+
+TEST_F(SHM, send_message)
+{
+	MAVConnInterface::Ptr echo, client;
+	auto name = utils::format("test-%d", getpid());
+
+	message_id = std::numeric_limits<msgid_t>::max();
+	auto msgid = mavlink::common::msg::HEARTBEAT::MSG_ID;
+
+	echo = std::make_shared<MAVConnSHM>(42, 200, name);
+	echo->message_received_cb = [echo_p = echo.get()](const mavlink_message_t * msg, const Framing framing) {
+		echo_p->send_message(msg);
+	};
+
+	client = std::make_shared<MAVConnSHM>(44, 200, name);
+	client->message_received_cb = std::bind(&SHM::recv_message, this, std::placeholders::_1, std::placeholders::_2);
+
+	EXPECT_THROW(std::make_shared<MAVConnSHM>(46, 200, name), DeviceError);
+
+	send_heartbeat(client.get());
+	EXPECT_EQ(wait_one(), true);
+	EXPECT_EQ(message_id, msgid);
+
+	auto st = client->get_link_stats();
+	EXPECT_EQ(st.tx_count, 1);
+	EXPECT_EQ(st.rx_count, 1);
+}
+
+TEST_F(SHM, in_process)
+{
+	MAVConnInterface::Ptr echo, client;
+
+	message_id = std::numeric_limits<msgid_t>::max();
+	auto msgid = mavlink::common::msg::HEARTBEAT::MSG_ID;
+
+	echo = MAVConnInterface::open_url("local://test-local", 42, 200);
+	echo->message_received_cb = [echo_p = echo.get()](const mavlink_message_t * msg, const Framing framing) {
+		echo_p->send_message(msg);
+	};
+
+	client = MAVConnInterface::open_url("local://test-local", 44, 200);
+	client->message_received_cb = std::bind(&SHM::recv_message, this, std::placeholders::_1, std::placeholders::_2);
+
+	EXPECT_THROW(MAVConnInterface::open_url("local://test-local", 46, 200), DeviceError);
+
+	send_heartbeat(client.get());
+	EXPECT_EQ(wait_one(), true);
+	EXPECT_EQ(message_id, msgid);
+
+	// side is free again after close
+	echo->close();
+	EXPECT_NO_THROW(echo = MAVConnInterface::open_url("local://test-local", 46, 200));
+}
+#endif
+
 TEST(SERIAL, open_error)
 {
 	MAVConnInterface::Ptr serial;
 	ASSERT_THROW(serial = std::make_shared<MAVConnSerial>(42, 200, "/some/magic/not/exist/path", 57600), DeviceError);
 }
 
+#ifdef __linux__
+TEST(SERIAL, rt_read_thread)
+{
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	ASSERT_GE(master, 0);
+	ASSERT_EQ(grantpt(master), 0);
+	ASSERT_EQ(unlockpt(master), 0);
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	size_t received = 0;
+
+	// SCHED_FIFO may be refused, read thread is started anyway
+	auto conn = MAVConnInterface::open_url(utils::format("serial://%s:115200?rt_prio=10&rx_buf=64&vmin=1&vtime=0", ptsname(master)));
+	auto serial = std::dynamic_pointer_cast<MAVConnSerial>(conn);
+	ASSERT_NE(serial, nullptr);
+	EXPECT_EQ(serial->get_rx_buffer_size(), 64);
+
+	conn->message_received_cb = [&](const mavlink_message_t *msg, const Framing framing) {
+		std::lock_guard<std::mutex> lock(mutex);
+		received++;
+		cond.notify_one();
+	};
+
+	// first frame completes asio read, rest are read by thread
+	mavlink::mavlink_status_t st {};
+	mavlink::common::msg::HEARTBEAT hb {};
+	for (size_t i = 0; i < 4; i++) {
+		MsgBuffer buf(hb, &st, 1, 1);
+		ASSERT_EQ(write(master, buf.dpos(), buf.nbytes()), buf.nbytes());
+
+		std::unique_lock<std::mutex> lock(mutex);
+		EXPECT_TRUE(cond.wait_for(lock, std::chrono::seconds(2), [&]() { return received == i + 1; }));
+	}
+
+	auto rs = serial->get_read_stat();
+	EXPECT_GE(rs.reads, 4);
+	EXPECT_GT(rs.bytes_per_read, 0);
+	EXPECT_EQ(serial->get_read_stat().reads, 0);
+
+	conn->close();
+	::close(master);
+}
+#endif
+
 #if 0
 TEST(URL, open_url_serial)
 {
@@ -238,6 +573,1418 @@ TEST(URL, open_url_tcp)
 		});
 }
 
+/**
+ * Connection without transport, used to feed parse_buffer() directly
+ */
+class ParserLoop : public MAVConnInterface {
+public:
+	struct Rx {
+		msgid_t msgid;
+		uint8_t seq;
+		uint8_t len;
+		Framing framing;
+
+		bool operator==(const Rx &other) const {
+			return msgid == other.msgid && seq == other.seq &&
+				len == other.len && framing == other.framing;
+		}
+	};
+
+	std::vector<Rx> received;
+
+	explicit ParserLoop(Parser parser) : MAVConnInterface(1, 1) {
+		set_parser(parser);
+		message_received_cb = [this](const mavlink_message_t *msg, const Framing framing) {
+			received.push_back(Rx{msg->msgid, msg->seq, msg->len, framing});
+		};
+	}
+
+	void close() override {}
+	void send_message(const mavlink_message_t *message) override {}
+	void send_message(const mavlink::Message &message, const uint8_t source_compid) override {}
+	void send_bytes(const uint8_t *bytes, size_t length) override {}
+	bool is_open() override {
+		return true;
+	}
+
+	void feed(uint8_t *buf, size_t len) {
+		parse_buffer("test: ", buf, len, len);
+	}
+};
+
+//! Link which only records sent frames
+class RecordLink : public MAVConnInterface {
+public:
+	std::vector<msgid_t> sent;
+
+	RecordLink() : MAVConnInterface(1, 1) {}
+
+	void close() override {}
+	void send_message(const mavlink_message_t *message) override {
+		sent.push_back(message->msgid);
+	}
+	void send_message(const mavlink::Message &message, const uint8_t source_compid) override {}
+	void send_bytes(const uint8_t *bytes, size_t length) override {}
+	bool is_open() override {
+		return true;
+	}
+};
+
+static mavlink_message_t make_frame(const mavlink::Message &m, uint8_t sysid, uint8_t compid)
+{
+	mavlink::mavlink_status_t st {};
+	mavlink_message_t msg;
+	mavlink::MsgMap map(msg);
+	auto mi = m.get_message_info();
+
+	m.serialize(map);
+	mavlink::mavlink_finalize_message_buffer(&msg, sysid, compid, &st, mi.min_length, mi.length, mi.crc_extra);
+	return msg;
+}
+
+TEST(ROUTER, targets)
+{
+	auto fcu = std::make_shared<RecordLink>();
+	auto gcs1 = std::make_shared<RecordLink>();
+	auto gcs2 = std::make_shared<RecordLink>();
+
+	Router router;
+	auto fcu_id = router.add_link(fcu);
+	auto gcs1_id = router.add_link(gcs1);
+	auto gcs2_id = router.add_link(gcs2);
+
+	mavlink::common::msg::HEARTBEAT hb {};
+	mavlink::common::msg::COMMAND_LONG cmd {};
+	auto cmd_msgid = mavlink::common::msg::COMMAND_LONG::MSG_ID;
+
+	mavlink_message_t buf;
+	auto frame = [&buf](const mavlink::Message &m, uint8_t sysid, uint8_t compid) {
+		buf = make_frame(m, sysid, compid);
+		return &buf;
+	};
+
+	// untargeted: everywhere except source
+	EXPECT_EQ(router.route(fcu_id, frame(hb, 1, 1)), 2);
+	EXPECT_EQ(router.route(gcs1_id, frame(hb, 255, 190)), 2);
+	EXPECT_EQ(router.route(gcs2_id, frame(hb, 254, 190)), 2);
+
+	// command to FCU goes only to FCU link
+	cmd.dummy[30] = 1;
+	cmd.dummy[31] = 1;
+	auto cmd_frame = make_frame(cmd, 255, 190);
+	uint8_t sysid, compid;
+	ASSERT_TRUE(Router::get_target(&cmd_frame, sysid, compid));
+	EXPECT_EQ(sysid, 1);
+	EXPECT_EQ(compid, 1);
+	EXPECT_EQ(router.select(gcs1_id, &cmd_frame), 1u << fcu_id);
+
+	fcu->sent.clear();
+	gcs2->sent.clear();
+	EXPECT_EQ(router.route(gcs1_id, &cmd_frame), 1);
+	EXPECT_EQ(fcu->sent, std::vector<msgid_t>{cmd_msgid});
+	EXPECT_TRUE(gcs2->sent.empty());
+
+	// reply to one GCS
+	cmd.dummy[30] = 254;
+	cmd.dummy[31] = 190;
+	EXPECT_EQ(router.select(fcu_id, frame(cmd, 1, 1)), 1u << gcs2_id);
+
+	// unknown component of known system: links of that system
+	cmd.dummy[30] = 1;
+	cmd.dummy[31] = 154;
+	EXPECT_EQ(router.select(gcs2_id, frame(cmd, 254, 190)), 1u << fcu_id);
+
+	// target behind source link is not sent back
+	EXPECT_EQ(router.select(fcu_id, frame(cmd, 1, 1)), 0);
+
+	// unknown system: as broadcast
+	cmd.dummy[30] = 42;
+	EXPECT_EQ(router.select(fcu_id, frame(cmd, 1, 1)), (1u << gcs1_id) | (1u << gcs2_id));
+
+	auto routes = router.get_routes();
+	ASSERT_EQ(routes.size(), 3);
+	EXPECT_EQ(routes[0].sysid, 1);
+	EXPECT_EQ(routes[0].link, fcu_id);
+}
+
+TEST(SHAPER, newest_sample)
+{
+	TxShaper shaper;
+	std::vector<mavlink_message_t> sent;
+	auto send = [&sent](const mavlink_message_t *msg) { sent.push_back(*msg); };
+	const int64_t ms = 1000000;
+
+	auto hb = make_frame(mavlink::common::msg::HEARTBEAT {}, 1, 1);
+	auto mode = make_frame(mavlink::common::msg::SET_MODE {}, 1, 1);
+	shaper.configure(0, {{mode.msgid, 10.0}});
+
+	for (uint8_t seq = 0; seq < 3; seq++) {
+		mode.seq = seq;
+		shaper.shape(&mode, 1, seq * 10 * ms, send);
+	}
+
+	// first goes, second waits, third replaces it
+	ASSERT_EQ(sent.size(), 1);
+	EXPECT_EQ(sent[0].seq, 0);
+
+	// heartbeat is never delayed
+	shaper.shape(&hb, 1, 30 * ms, send);
+	ASSERT_EQ(sent.size(), 2);
+	EXPECT_EQ(sent[1].msgid, hb.msgid);
+
+	// flushed by next call after interval
+	shaper.shape(nullptr, 0, 100 * ms, send);
+	ASSERT_EQ(sent.size(), 3);
+	EXPECT_EQ(sent[2].seq, 2);
+
+	auto st = shaper.get_stat();
+	EXPECT_EQ(st.forwarded, 3);
+	EXPECT_EQ(st.replaced, 1);
+	EXPECT_EQ(st.waiting, 0);
+
+	// 0 rate drops stream
+	shaper.configure(0, {{mode.msgid, 0.0}});
+	shaper.shape(&mode, 1, 200 * ms, send);
+	EXPECT_EQ(sent.size(), 3);
+	EXPECT_EQ(shaper.get_stat().dropped, 1);
+}
+
+TEST(SHAPER, budget)
+{
+	TxShaper shaper;
+	size_t sent = 0, sent_hb = 0;
+	auto send = [&](const mavlink_message_t *msg) { sent++; sent_hb += msg->msgid == 0; };
+
+	// 10 streams, more than one bucket
+	std::vector<mavlink_message_t> frames;
+	for (uint8_t compid = 1; compid <= 10; compid++) {
+		frames.push_back(make_frame(mavlink::common::msg::PARAM_SET {}, 1, compid));
+		frames.push_back(make_frame(mavlink::common::msg::HEARTBEAT {}, 1, compid));
+	}
+
+	auto len = LinkStats::frame_length(frames[0]);
+	shaper.configure(len * 10, {});
+
+	shaper.shape(frames.data(), frames.size(), 0, send);
+	EXPECT_EQ(sent_hb, 10);
+	EXPECT_LT(sent - sent_hb, 10);
+	EXPECT_GT(shaper.get_stat().waiting, 0);
+
+	// budget refills, all streams got their frame
+	for (int64_t t = 1; t <= 10; t++)
+		shaper.shape(nullptr, 0, t * 1000000000LL, send);
+
+	EXPECT_EQ(sent, 20);
+	EXPECT_EQ(shaper.get_stat().waiting, 0);
+}
+
+TEST(TXFLOW, aimd)
+{
+	TxFlowControl flow;
+	auto t = steady_clock::now();
+	const mavlink::msgid_t attitude = 30, heartbeat = 0;
+
+	// disabled: feedback ignored
+	flow.feedback(0, 200, 200, t);
+	EXPECT_TRUE(flow.admit(attitude));
+
+	flow.configure(true, TxFlowControl::Options(), TxShaper::DEFAULT_PRIORITY);
+
+	// radio buffer almost full: share halves
+	flow.feedback(10, 200, 200, t);
+	EXPECT_FLOAT_EQ(flow.get_stat().share, 0.5f);
+
+	size_t admitted = 0, hb = 0;
+	for (int i = 0; i < 100; i++) {
+		admitted += flow.admit_slow(attitude, t);
+		hb += flow.admit_slow(heartbeat, t);
+	}
+
+	EXPECT_EQ(admitted, 50);
+	EXPECT_EQ(hb, 100);
+	EXPECT_EQ(flow.get_stat().throttled, 50);
+
+	// floor
+	for (int i = 0; i < 10; i++)
+		flow.feedback(10, 200, 200, t);
+	EXPECT_FLOAT_EQ(flow.get_stat().share, 0.1f);
+
+	// middle band holds, free buffer increases by step
+	flow.feedback(50, 200, 200, t);
+	EXPECT_FLOAT_EQ(flow.get_stat().share, 0.1f);
+	flow.feedback(90, 200, 200, t);
+	EXPECT_FLOAT_EQ(flow.get_stat().share, 0.2f);
+
+	// no feedback: restored
+	EXPECT_TRUE(flow.admit_slow(attitude, t + std::chrono::seconds(10)));
+	EXPECT_FLOAT_EQ(flow.get_stat().share, 1.0f);
+}
+
+TEST(TXFLOW, weak_rssi_holds)
+{
+	TxFlowControl flow;
+	TxFlowControl::Options opts;
+	opts.rssi_low = 50;
+	auto t = steady_clock::now();
+
+	flow.configure(true, opts, {});
+	flow.add_priority({30});
+
+	flow.feedback(10, 200, 200, t);
+	flow.feedback(90, 200, 40, t);
+	EXPECT_FLOAT_EQ(flow.get_stat().share, 0.5f);
+
+	// lane ids are kept by configure()
+	flow.configure(true, opts, {});
+	flow.feedback(10, 200, 200, t);
+	EXPECT_TRUE(flow.admit_slow(30, t));
+	EXPECT_FALSE(flow.admit_slow(31, t));
+	EXPECT_TRUE(flow.admit_slow(31, t));
+}
+
+TEST(PARSER, block_same_as_char)
+{
+	std::mt19937 rng(42);
+	std::vector<uint8_t> stream;
+	mavlink::mavlink_status_t status {};
+
+	mavlink::common::msg::HEARTBEAT hb {};
+	for (int i = 0; i < 500; i++) {
+		hb.custom_mode = rng();
+		hb.type = i;
+
+		// mix v1.0 and v2.0 framing
+		if (rng() % 2)
+			status.flags |= MAVLINK_STATUS_FLAG_OUT_MAVLINK1;
+		else
+			status.flags &= ~MAVLINK_STATUS_FLAG_OUT_MAVLINK1;
+
+		MsgBuffer buf(hb, &status, 1, 1);
+
+		// corrupt some frames
+		if (rng() % 10 == 0)
+			buf.dpos()[rng() % buf.len] ^= 1 << (rng() % 8);
+
+		stream.insert(stream.end(), buf.dpos(), buf.dpos() + buf.len);
+
+		// and some junk between frames
+		if (rng() % 10 == 0) {
+			for (int j = rng() % 20; j > 0; j--)
+				stream.push_back(rng());
+		}
+	}
+
+	ParserLoop char_parser(Parser::CHAR), block_parser(Parser::BLOCK);
+
+	// feed by random sized chunks to check frames split between reads
+	for (size_t pos = 0; pos < stream.size(); ) {
+		size_t len = std::min<size_t>(1 + rng() % 100, stream.size() - pos);
+		char_parser.feed(stream.data() + pos, len);
+		block_parser.feed(stream.data() + pos, len);
+		pos += len;
+	}
+
+	EXPECT_GT(char_parser.received.size(), 400);
+	EXPECT_EQ(char_parser.received.size(), block_parser.received.size());
+	EXPECT_TRUE(char_parser.received == block_parser.received);
+	EXPECT_EQ(char_parser.get_status().packet_rx_success_count, block_parser.get_status().packet_rx_success_count);
+}
+
+TEST(PARSER, batch_callback)
+{
+	std::vector<uint8_t> stream;
+	mavlink::mavlink_status_t status {};
+	mavlink::common::msg::HEARTBEAT hb {};
+
+	for (int i = 0; i < 20; i++) {
+		MsgBuffer buf(hb, &status, 1, 1);
+		stream.insert(stream.end(), buf.dpos(), buf.dpos() + buf.len);
+	}
+
+	for (auto parser : {Parser::CHAR, Parser::BLOCK}) {
+		ParserLoop loop(parser);
+		std::vector<size_t> batches;
+		std::vector<uint8_t> seqs;
+
+		loop.message_received_batch_cb = [&](const mavlink_message_t *msgs, const Framing *framings, size_t count) {
+			batches.push_back(count);
+			for (size_t i = 0; i < count; i++) {
+				EXPECT_EQ(framings[i], Framing::ok);
+				seqs.push_back(msgs[i].seq);
+			}
+		};
+
+		// first read ends in the middle of a frame
+		size_t split = stream.size() / 2 + 3;
+		loop.feed(stream.data(), split);
+		loop.feed(stream.data() + split, stream.size() - split);
+
+		EXPECT_TRUE(loop.received.empty());
+		ASSERT_EQ(batches.size(), 2);
+		EXPECT_EQ(batches[0] + batches[1], 20);
+		for (size_t i = 0; i < seqs.size(); i++)
+			EXPECT_EQ(seqs[i], i);
+	}
+}
+
+TEST(PARSER, rx_filter)
+{
+	std::vector<uint8_t> stream;
+	mavlink::mavlink_status_t status {};
+	mavlink::common::msg::HEARTBEAT hb {};
+	mavlink::common::msg::COMMAND_LONG cmd {};
+
+	for (int i = 0; i < 10; i++) {
+		MsgBuffer hb_buf(hb, &status, 1, 1);
+		MsgBuffer cmd_buf(cmd, &status, 1, 1);
+		stream.insert(stream.end(), hb_buf.dpos(), hb_buf.dpos() + hb_buf.len);
+		stream.insert(stream.end(), cmd_buf.dpos(), cmd_buf.dpos() + cmd_buf.len);
+	}
+
+	msgid_t hb_id = mavlink::common::msg::HEARTBEAT::MSG_ID;
+	msgid_t cmd_id = mavlink::common::msg::COMMAND_LONG::MSG_ID;
+
+	for (auto parser : {Parser::CHAR, Parser::BLOCK}) {
+		ParserLoop loop(parser);
+		auto filter = loop.get_rx_filter();
+
+		filter->set_mode(RxFilter::Mode::DENY, {hb_id});
+		loop.feed(stream.data(), stream.size());
+		ASSERT_EQ(loop.received.size(), 10);
+		EXPECT_EQ(loop.received[0].msgid, cmd_id);
+
+		// filtered frames do not look lost
+		auto st = loop.get_link_stats();
+		EXPECT_EQ(st.rx_filtered, 10);
+		EXPECT_EQ(st.seq_lost, 0);
+
+		loop.received.clear();
+		filter->set_mode(RxFilter::Mode::ALLOW, {hb_id});
+		loop.feed(stream.data(), stream.size());
+		ASSERT_EQ(loop.received.size(), 10);
+		EXPECT_EQ(loop.received[0].msgid, hb_id);
+
+		// burst passes one frame per interval
+		loop.received.clear();
+		filter->set_mode(RxFilter::Mode::NONE, {});
+		filter->set_rate_limits({{cmd_id, 1.0}});
+		loop.feed(stream.data(), stream.size());
+		EXPECT_EQ(loop.received.size(), 11);
+
+		auto fst = filter->get_stat();
+		EXPECT_EQ(fst.dropped, 20);
+		EXPECT_EQ(fst.rate_limited, 9);
+	}
+}
+
+TEST(MSGBUFFER, inplace_same_as_copy)
+{
+	mavlink::mavlink_status_t st1 {}, st2 {};
+	mavlink::common::msg::HEARTBEAT hb {};
+
+	for (int i = 0; i < 4; i++) {
+		hb.custom_mode = i * 100;
+		hb.type = i;
+
+		MsgBuffer buf(hb, &st1, 1, 2);
+
+		mavlink::mavlink_message_t msg;
+		mavlink::MsgMap map(msg);
+		auto mi = hb.get_message_info();
+		hb.serialize(map);
+		mavlink::mavlink_finalize_message_buffer(&msg, 1, 2, &st2, mi.min_length, mi.length, mi.crc_extra);
+		MsgBuffer ref(&msg);
+
+		ASSERT_EQ(buf.nbytes(), ref.nbytes());
+		EXPECT_EQ(0, memcmp(buf.dpos(), ref.dpos(), ref.nbytes()));
+	}
+}
+
+static std::string hex(const sha256::Digest &d)
+{
+	static const char digits[] = "0123456789abcdef";
+	std::string ret;
+	for (auto b : d) {
+		ret.push_back(digits[b >> 4]);
+		ret.push_back(digits[b & 0xf]);
+	}
+
+	return ret;
+}
+
+TEST(SHA256, vectors)
+{
+	auto sha = [](const std::string &s) {
+			   return hex(sha256::digest(reinterpret_cast<const uint8_t *>(s.data()), s.size()));
+		   };
+
+	auto detected = sha256::get_impl();
+	for (auto impl : {sha256::Impl::GENERIC, sha256::Impl::SHA_NI, sha256::Impl::ARMV8}) {
+		if (!sha256::set_impl(impl))
+			continue;
+
+		SCOPED_TRACE(sha256::to_string(impl));
+		EXPECT_EQ(sha(""), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+		EXPECT_EQ(sha("abc"), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+		EXPECT_EQ(sha("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"),
+				"248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+		EXPECT_EQ(sha(std::string(1000000, 'a')),
+				"cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+	}
+
+	sha256::set_impl(detected);
+}
+
+//! MAVLink 2 frames signed by @a signing, or by mavlink_status_t::signing if nullptr
+static std::vector<uint8_t> signed_stream(mavlink::mavlink_status_t &status, MessageSigning *signing, size_t count)
+{
+	std::vector<uint8_t> stream;
+	mavlink::common::msg::HEARTBEAT hb {};
+
+	for (size_t i = 0; i < count; i++) {
+		hb.custom_mode = i;
+		MsgBuffer buf(hb, &status, 1, 1, signing);
+		buf.sign();	// as IO thread does on write
+		stream.insert(stream.end(), buf.dpos(), buf.dpos() + buf.len);
+	}
+
+	return stream;
+}
+
+TEST(SIGNING, sign_verify)
+{
+	MessageSigning::Options opts;
+	opts.key = MessageSigning::key_from_string("secret passphrase");
+	opts.link_id = 3;
+
+	mavlink::mavlink_status_t status {};
+	MessageSigning tx(opts);
+	auto stream = signed_stream(status, &tx, 20);
+	auto more = signed_stream(status, &tx, 5);
+	EXPECT_EQ(tx.get_stats().tx_signed, 25);
+
+	for (auto parser : {Parser::CHAR, Parser::BLOCK}) {
+		ParserLoop loop(parser);
+		loop.set_signing(std::make_shared<MessageSigning>(opts));
+
+		loop.feed(stream.data(), stream.size());
+		ASSERT_EQ(loop.received.size(), 20);
+		for (auto &rx : loop.received)
+			EXPECT_EQ(rx.framing, Framing::ok);
+
+		// same frames again are replay, next frames still pass
+		loop.received.clear();
+		loop.feed(stream.data(), stream.size());
+		loop.feed(more.data(), more.size());
+		ASSERT_EQ(loop.received.size(), 25);
+		EXPECT_EQ(loop.received[0].framing, Framing::bad_signature);
+		EXPECT_EQ(loop.received[24].framing, Framing::ok);
+
+		auto st = loop.get_signing()->get_stats();
+		EXPECT_EQ(st.rx_signed, 25);
+		EXPECT_EQ(st.replay, 20);
+		EXPECT_EQ(loop.get_link_stats().signature_errors, 20);
+	}
+}
+
+TEST(SIGNING, same_as_mavlink)
+{
+	MessageSigning::Options opts;
+	opts.key = MessageSigning::key_from_string(std::string(64, 'a'));
+	EXPECT_EQ(opts.key[0], 0xaa);
+	EXPECT_EQ(opts.key[31], 0xaa);
+
+	mavlink::mavlink_signing_t signing {};
+	signing.flags = MAVLINK_SIGNING_FLAG_SIGN_OUTGOING;
+	signing.timestamp = MessageSigning::timestamp_now();
+	std::copy(opts.key.begin(), opts.key.end(), signing.secret_key);
+
+	// signed by mavlink_sign_packet(), checked by MessageSigning
+	mavlink::mavlink_status_t status {};
+	status.signing = &signing;
+	auto stream = signed_stream(status, nullptr, 10);
+
+	ParserLoop loop(Parser::BLOCK);
+	loop.set_signing(std::make_shared<MessageSigning>(opts));
+	loop.feed(stream.data(), stream.size());
+	ASSERT_EQ(loop.received.size(), 10);
+	EXPECT_EQ(loop.received[9].framing, Framing::ok);
+
+	// signed by MessageSigning, checked by mavlink_frame_char_buffer()
+	mavlink::mavlink_status_t tx_status {};
+	MessageSigning tx(opts);
+	stream = signed_stream(tx_status, &tx, 10);
+
+	mavlink::mavlink_signing_streams_t streams {};
+	mavlink::mavlink_status_t rx_status {}, st;
+	mavlink::mavlink_message_t rx_buf {}, msg;
+	rx_status.signing = &signing;
+	rx_status.signing_streams = &streams;
+
+	size_t ok = 0;
+	for (auto c : stream)
+		if (mavlink::mavlink_frame_char_buffer(&rx_buf, &rx_status, c, &msg, &st) == mavlink::MAVLINK_FRAMING_OK)
+			ok++;
+
+	EXPECT_EQ(ok, 10);
+}
+
+TEST(SIGNING, rejects)
+{
+	MessageSigning::Options opts;
+	opts.key = MessageSigning::key_from_string("right");
+
+	mavlink::mavlink_status_t status {};
+	MessageSigning::Options wrong_opts = opts;
+	wrong_opts.key = MessageSigning::key_from_string("wrong");
+	MessageSigning wrong(wrong_opts);
+	auto bad_key = signed_stream(status, &wrong, 5);
+	auto no_sign = signed_stream(status, nullptr, 5);
+
+	// first frame of stream older than window
+	mavlink::mavlink_signing_t old {};
+	old.flags = MAVLINK_SIGNING_FLAG_SIGN_OUTGOING;
+	old.timestamp = MessageSigning::timestamp_now() - 120 * 100000;
+	std::copy(opts.key.begin(), opts.key.end(), old.secret_key);
+	mavlink::mavlink_status_t old_status {};
+	old_status.signing = &old;
+	auto stale = signed_stream(old_status, nullptr, 5);
+
+	mavlink::common::msg::RADIO_STATUS radio {};
+	MsgBuffer radio_buf(radio, &status, 51, 68);
+
+	for (auto parser : {Parser::CHAR, Parser::BLOCK}) {
+		ParserLoop loop(parser);
+		auto signing = std::make_shared<MessageSigning>(opts);
+		loop.set_signing(signing);
+
+		loop.feed(bad_key.data(), bad_key.size());
+		loop.feed(no_sign.data(), no_sign.size());
+		loop.feed(stale.data(), stale.size());
+		loop.feed(radio_buf.dpos(), radio_buf.len);
+
+		ASSERT_EQ(loop.received.size(), 16);
+		EXPECT_EQ(loop.received[15].framing, Framing::ok);
+
+		auto st = signing->get_stats();
+		EXPECT_EQ(st.bad_signature, 5);
+		EXPECT_EQ(st.unsigned_rejected, 5);
+		EXPECT_EQ(st.stale, 5);
+		EXPECT_EQ(st.unsigned_accepted, 1);
+		EXPECT_EQ(st.rx_signed, 0);
+	}
+
+	opts.accept_unsigned = true;
+	ParserLoop loop(Parser::BLOCK);
+	loop.set_signing(std::make_shared<MessageSigning>(opts));
+	loop.feed(no_sign.data(), no_sign.size());
+	ASSERT_EQ(loop.received.size(), 5);
+	EXPECT_EQ(loop.received[4].framing, Framing::ok);
+}
+
+namespace test_entries {
+using mavlink::mavlink_msg_entry_t;
+using namespace mavconn::msg_entry;
+
+constexpr mavlink_msg_entry_t first[] = {{0, 50, 9, 9, 0, 0, 0}, {300, 217, 22, 22, 0, 0, 0}};
+constexpr mavlink_msg_entry_t second[] = {{0, 1, 1, 1, 0, 0, 0}, {1, 124, 31, 31, 0, 0, 0}, {12900, 7, 3, 3, 0, 0, 0}, {70000, 9, 4, 4, 0, 0, 0}};
+
+constexpr DialectEntries dialects[] = {{first, 2}, {second, 4}};
+constexpr auto table = make_table<count_entries(dialects), count_pages(dialects)>(dialects);
+
+static_assert(is_sorted(dialects), "sorted");
+static_assert(table.size() == 5, "duplicate msgid merged");
+static_assert(table.find(0)->crc_extra == 50, "first dialect wins");
+static_assert(table.find(70000)->crc_extra == 9, "binary search range");
+}	// namespace test_entries
+
+TEST(MSGENTRY, lookup)
+{
+	using test_entries::table;
+
+	for (uint32_t msgid : {0, 1, 300, 12900, 70000}) {
+		auto e = table.find(msgid);
+		ASSERT_NE(e, nullptr);
+		EXPECT_EQ(e->msgid, msgid);
+	}
+
+	for (uint32_t msgid : {2, 256, 299, 12899, 65535, 69999, 0xffffff})
+		EXPECT_EQ(table.find(msgid), nullptr);
+
+	// generated table of dialects
+	msgid_t hb_id = mavlink::common::msg::HEARTBEAT::MSG_ID;
+	uint8_t hb_crc = mavlink::common::msg::HEARTBEAT::CRC_EXTRA;
+
+	auto hb = mavlink::mavlink_get_msg_entry(hb_id);
+	ASSERT_NE(hb, nullptr);
+	EXPECT_EQ(hb->crc_extra, hb_crc);
+}
+
+TEST(LINKSTATS, rx_counters)
+{
+	std::vector<uint8_t> stream;
+	mavlink::mavlink_status_t status {};
+	mavlink::common::msg::HEARTBEAT hb {};
+	size_t frame_len = 0;
+
+	for (int i = 0; i < 10; i++) {
+		MsgBuffer buf(hb, &status, 1, 1);
+		frame_len = buf.len;
+
+		// lost on the way
+		if (i == 3 || i == 4)
+			continue;
+
+		// bad crc
+		if (i == 7)
+			buf.dpos()[buf.len - 1] ^= 0xff;
+
+		stream.insert(stream.end(), buf.dpos(), buf.dpos() + buf.len);
+	}
+
+	ParserLoop loop(Parser::BLOCK);
+	loop.feed(stream.data(), stream.size());
+
+	auto st = loop.get_link_stats();
+	EXPECT_EQ(st.rx_count, 7);
+	EXPECT_EQ(st.rx_bytes, 7 * frame_len);
+	EXPECT_EQ(st.crc_errors, 1);
+	EXPECT_EQ(st.seq_lost, 3);
+
+	msgid_t msgid = mavlink::common::msg::HEARTBEAT::MSG_ID;
+	ASSERT_EQ(st.messages.size(), 1);
+	EXPECT_EQ(st.messages[0].msgid, msgid);
+	EXPECT_EQ(st.messages[0].rx_count, 7);
+
+	ASSERT_EQ(st.peers.size(), 1);
+	EXPECT_EQ(st.peers[0].sysid, 1);
+	EXPECT_EQ(st.peers[0].compid, 1);
+	EXPECT_EQ(st.peers[0].seq_lost, 3);
+}
+
+TEST(LINKSTATS, tx_counters)
+{
+	LinkStats stats;
+	TxQueue q(2, &stats);
+	uint8_t d[10] = {};
+
+	q.add_lane(TxPolicy::REPLACE_LATEST, {7}, 2);
+
+	EXPECT_TRUE(q.emplace_msg(5, d, 10));
+	EXPECT_TRUE(q.emplace_msg(5, d, 10));
+	EXPECT_FALSE(q.emplace_msg(5, d, 10));
+	EXPECT_TRUE(q.emplace_msg(7, d, 4));
+	EXPECT_TRUE(q.emplace_msg(7, d, 4));	// replaced
+
+	ASSERT_TRUE(q.need_wakeup());
+	ASSERT_NE(q.next(), nullptr);
+
+	auto st = stats.snapshot();
+	EXPECT_EQ(st.tx_drops, 2);
+	EXPECT_EQ(st.tx_queue_high_water, 3);
+	EXPECT_EQ(st.tx_count, 4);
+	EXPECT_EQ(st.tx_bytes, 28);
+
+	ASSERT_EQ(st.messages.size(), 2);
+	EXPECT_EQ(st.messages[0].msgid, 5);
+	EXPECT_EQ(st.messages[0].tx_count, 2);
+	EXPECT_EQ(st.messages[1].msgid, 7);
+	EXPECT_EQ(st.messages[1].tx_bytes, 8);
+}
+
+static mavlink_message_t ping_reply(uint32_t seq, uint8_t target_system, uint8_t target_component)
+{
+	mavlink::common::msg::PING ping {};
+	ping.seq = seq;
+	ping.target_system = target_system;
+	ping.target_component = target_component;
+
+	mavlink_message_t msg;
+	mavlink::MsgMap map(msg);
+	mavlink::mavlink_status_t status {};
+	auto mi = ping.get_message_info();
+
+	ping.serialize(map);
+	mavlink::mavlink_finalize_message_buffer(&msg, 1, 1, &status, mi.min_length, mi.length, mi.crc_extra);
+	return msg;
+}
+
+TEST(PROBE, rtt_jitter_loss)
+{
+	using std::chrono::milliseconds;
+
+	LinkProbe::Options opts;
+	opts.interval = milliseconds(100);
+	opts.timeout = milliseconds(250);
+	LinkProbe probe(opts);
+	mavlink::common::msg::PING ping {};
+	LinkProbe::clock::time_point t {};
+
+	EXPECT_EQ(probe.timeout(milliseconds(1000), milliseconds(50), milliseconds(5000)), milliseconds(1000));
+
+	// replies after 20 ms, 40 ms
+	ASSERT_TRUE(probe.poll(t, ping));
+	EXPECT_EQ(ping.seq, 0);
+	EXPECT_EQ(ping.target_system, 0);
+	EXPECT_FALSE(probe.poll(t + milliseconds(50), ping));
+	EXPECT_TRUE(probe.reply(ping_reply(0, 1, opts.compid), 1, t + milliseconds(20)));
+
+	t += milliseconds(100);
+	ASSERT_TRUE(probe.poll(t, ping));
+	EXPECT_EQ(ping.seq, 1);
+	EXPECT_TRUE(probe.reply(ping_reply(1, 1, opts.compid), 1, t + milliseconds(40)));
+
+	auto st = probe.get_stats();
+	EXPECT_EQ(st.sent, 2);
+	EXPECT_EQ(st.received, 2);
+	EXPECT_NEAR(st.rtt_ms, 20 + 20 / 8.0, 0.01);
+	EXPECT_NEAR(st.jitter_ms, 10 + (20 - 10) / 4.0, 0.01);
+	EXPECT_NEAR(st.rtt_min_ms, 20, 0.01);
+	EXPECT_EQ(st.loss, 0.0f);
+
+	// rtt + 4 * jitter, limited
+	auto timeout = probe.timeout(milliseconds(1000), milliseconds(50), milliseconds(5000));
+	EXPECT_NEAR(std::chrono::duration<double, std::milli>(timeout).count(), 22.5 + 4 * 12.5, 0.01);
+	EXPECT_EQ(probe.timeout(milliseconds(1000), milliseconds(100), milliseconds(5000)), milliseconds(100));
+
+	// no reply, expired on next poll after timeout
+	t += milliseconds(100);
+	ASSERT_TRUE(probe.poll(t, ping));
+	for (int i = 1; i <= 3; i++)
+		ASSERT_TRUE(probe.poll(t + i * milliseconds(100), ping));
+
+	st = probe.get_stats();
+	EXPECT_EQ(st.sent, 6);
+	EXPECT_EQ(st.lost, 1);
+	EXPECT_NEAR(st.loss, 1 / 16.0, 1e-4);
+
+	// late reply of lost probe is consumed, but not sampled
+	EXPECT_TRUE(probe.reply(ping_reply(2, 1, opts.compid), 1, t + milliseconds(300)));
+	EXPECT_EQ(probe.get_stats().received, 2);
+}
+
+TEST(PROBE, reply_matching)
+{
+	LinkProbe::Options opts;
+	for (auto parser : {Parser::CHAR, Parser::BLOCK}) {
+		for (bool batch : {false, true}) {
+			ParserLoop loop(parser);
+			auto probe = std::make_shared<LinkProbe>(opts);
+			loop.set_link_probe(probe);
+
+			size_t batched = 0;
+			if (batch)
+				loop.message_received_batch_cb = [&](const mavlink_message_t *msgs, const Framing *framings, size_t count) {
+					for (size_t i = 0; i < count; i++)
+						EXPECT_EQ(msgs[i].msgid, mavlink::common::msg::PING::MSG_ID);
+					batched += count;
+				};
+
+			// first feed sends probe seq 0
+			std::vector<uint8_t> stream;
+			for (auto &msg : {
+						ping_reply(0, 1, opts.compid),
+						ping_reply(0, 1, 1),		// reply to other component
+						ping_reply(0, 2, opts.compid),	// other system
+						ping_reply(0, 0, 0),		// request of remote
+					}) {
+				uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+				auto len = mavlink::mavlink_msg_to_send_buffer(buf, &msg);
+				stream.insert(stream.end(), buf, buf + len);
+			}
+
+			loop.feed(stream.data(), stream.size());
+
+			EXPECT_EQ(batch ? batched : loop.received.size(), 3);
+			auto st = probe->get_stats();
+			EXPECT_EQ(st.sent, 1);
+			EXPECT_EQ(st.received, 1);
+			EXPECT_TRUE(probe->have_rtt());
+		}
+	}
+}
+
+TEST(TRACE, ring_wrap)
+{
+	TraceRing ring(3);
+	ASSERT_EQ(ring.capacity(), 4);
+	EXPECT_TRUE(ring.dump().empty());
+
+	for (uint32_t i = 0; i < 6; i++) {
+		TraceEvent ev {};
+		ev.msgid = i;
+		ring.record(ev);
+	}
+
+	auto events = ring.dump();
+	ASSERT_EQ(events.size(), 4);
+	for (size_t i = 0; i < events.size(); i++)
+		EXPECT_EQ(events[i].msgid, i + 2);
+}
+
+#ifdef MAVCONN_TRACE
+TEST(TRACE, rx_frames)
+{
+	mavlink::mavlink_status_t status {};
+	mavlink::common::msg::HEARTBEAT hb {};
+	MsgBuffer buf(hb, &status, 1, 1);
+
+	ParserLoop loop(Parser::CHAR);
+	loop.feed(buf.dpos(), buf.len);
+	EXPECT_EQ(loop.get_trace(), nullptr);
+
+	loop.set_trace(16);
+	loop.feed(buf.dpos(), buf.len);
+	loop.set_trace(0);
+	loop.feed(buf.dpos(), buf.len);
+
+	auto ring = loop.get_trace();
+	ASSERT_NE(ring, nullptr);
+
+	auto events = ring->dump();
+	msgid_t msgid = mavlink::common::msg::HEARTBEAT::MSG_ID;
+	ASSERT_EQ(events.size(), 1);
+	EXPECT_EQ(events[0].dir, TraceEvent::RX);
+	EXPECT_EQ(events[0].msgid, msgid);
+	EXPECT_EQ(events[0].len, buf.len);
+	EXPECT_EQ(events[0].sysid, 1);
+	EXPECT_EQ(events[0].framing, uint8_t(Framing::ok));
+}
+#endif
+
+static std::vector<uint8_t> read_file(const std::string &path)
+{
+	std::vector<uint8_t> ret;
+	FILE *fp = std::fopen(path.c_str(), "rb");
+	if (fp == nullptr)
+		return ret;
+
+	uint8_t buf[4096];
+	size_t n;
+	while ((n = std::fread(buf, 1, sizeof(buf), fp)) > 0)
+		ret.insert(ret.end(), buf, buf + n);
+
+	std::fclose(fp);
+	return ret;
+}
+
+TEST(TLOG, record_format)
+{
+	char path[] = "/tmp/mavconn-tlog-XXXXXX";
+	::close(mkstemp(path));
+
+	const uint8_t frame[] = { 0xfd, 1, 2, 3 };
+	{
+		TlogRecorder::Options opts(path);
+		TlogRecorder rec(opts);
+		EXPECT_TRUE(rec.write(0x0102030405060708ULL, frame, sizeof(frame)));
+		rec.flush();
+		EXPECT_EQ(rec.get_written_bytes(), 8 + sizeof(frame));
+		EXPECT_TRUE(rec.write(1, frame, 1));
+	}
+
+	// big endian stamp, then frame; destructor writes the rest
+	std::vector<uint8_t> expected { 1, 2, 3, 4, 5, 6, 7, 8, 0xfd, 1, 2, 3, 0, 0, 0, 0, 0, 0, 0, 1, 0xfd };
+	EXPECT_EQ(read_file(path), expected);
+	::unlink(path);
+}
+
+TEST(TLOG, ring_full_drops)
+{
+	char path[] = "/tmp/mavconn-tlog-XXXXXX";
+	::close(mkstemp(path));
+
+	TlogRecorder::Options opts(path);
+	opts.ring_bytes = 1;	// rounded up to one page
+	TlogRecorder rec(opts);
+
+	std::vector<uint8_t> frame(1000);
+	size_t accepted = 0;
+	for (size_t i = 0; i < 64; i++)
+		accepted += rec.write(i, frame.data(), frame.size());
+
+	rec.flush();
+	EXPECT_EQ(accepted + rec.get_dropped(), 64);
+	EXPECT_EQ(rec.get_written_bytes(), accepted * (8 + frame.size()));
+	::unlink(path);
+}
+
+TEST(TLOG, rotation)
+{
+	char dir[] = "/tmp/mavconn-tlog-XXXXXX";
+	ASSERT_NE(mkdtemp(dir), nullptr);
+
+	TlogRecorder::Options opts(std::string(dir) + "/flight.tlog");
+	opts.max_file_bytes = 30;	// two 12 byte records per file
+	opts.max_files = 2;
+	EXPECT_EQ(TlogRecorder::file_name(opts, 3), std::string(dir) + "/flight.0003.tlog");
+
+	{
+		TlogRecorder rec(opts);
+		const uint8_t frame[] = { 0xfe, 0, 0, 0 };
+		for (size_t i = 0; i < 7; i++)
+			rec.write(i, frame, sizeof(frame));
+	}
+
+	// files 0 and 1 removed, 3 has last record
+	EXPECT_TRUE(read_file(TlogRecorder::file_name(opts, 0)).empty());
+	EXPECT_TRUE(read_file(TlogRecorder::file_name(opts, 1)).empty());
+	EXPECT_EQ(read_file(TlogRecorder::file_name(opts, 2)).size(), 24);
+	auto last = read_file(TlogRecorder::file_name(opts, 3));
+	ASSERT_EQ(last.size(), 12);
+	EXPECT_EQ(last[7], 6);
+
+	for (size_t i = 2; i < 4; i++)
+		::unlink(TlogRecorder::file_name(opts, i).c_str());
+	::rmdir(dir);
+}
+
+TEST(TLOG, rx_frames)
+{
+	char path[] = "/tmp/mavconn-tlog-XXXXXX";
+	::close(mkstemp(path));
+
+	mavlink::mavlink_status_t status {};
+	mavlink::common::msg::HEARTBEAT hb {};
+	MsgBuffer buf(hb, &status, 1, 1);
+
+	ParserLoop loop(Parser::CHAR);
+	auto rec = std::make_shared<TlogRecorder>(TlogRecorder::Options(path));
+	loop.set_recorder(rec);
+	loop.feed(buf.dpos(), buf.len);
+	loop.set_recorder(nullptr);
+	loop.feed(buf.dpos(), buf.len);
+	rec->flush();
+
+	auto data = read_file(path);
+	ASSERT_EQ(data.size(), 8 + buf.len);
+	EXPECT_TRUE(std::equal(data.begin() + 8, data.end(), buf.dpos()));
+	::unlink(path);
+}
+
+TEST(REPLAY, file_url)
+{
+	char path[] = "/tmp/mavconn-tlog-XXXXXX";
+	char capture[] = "/tmp/mavconn-tlog-XXXXXX";
+	::close(mkstemp(path));
+	::close(mkstemp(capture));
+
+	mavlink::mavlink_status_t status {};
+	mavlink::common::msg::HEARTBEAT hb {};
+	{
+		TlogRecorder::Options opts(path);
+		TlogRecorder rec(opts);
+		for (size_t i = 0; i < 3; i++) {
+			MsgBuffer buf(hb, &status, 1, 1);
+			rec.write(1000000 * (i + 1), buf.dpos(), buf.len);
+		}
+	}
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::vector<uint64_t> stamps;
+	bool closed = false;
+
+	// seconds apart in file, but replayed as fast as possible
+	auto conn = MAVConnInterface::open_url(utils::format("file://%s?speed=0&delay=-1&capture=%s", path, capture));
+	auto file = std::dynamic_pointer_cast<MAVConnFile>(conn);
+	ASSERT_NE(file, nullptr);
+
+	conn->message_received_cb = [&](const mavlink_message_t *msg, const Framing framing) {
+		EXPECT_EQ(framing, Framing::ok);
+		std::lock_guard<std::mutex> lock(mutex);
+		stamps.push_back(conn->get_rx_stamp());
+	};
+	conn->port_closed_cb = [&]() {
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+		cond.notify_one();
+	};
+
+	// sent while waiting for start, goes to capture file
+	conn->send_message(hb);
+	file->start();
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		ASSERT_TRUE(cond.wait_for(lock, std::chrono::milliseconds(500), [&]() { return closed; }));
+	}
+
+	// recorded stamps
+	std::vector<uint64_t> expected { 1000000000ULL, 2000000000ULL, 3000000000ULL };
+	EXPECT_EQ(stamps, expected);
+	EXPECT_EQ(file->get_replayed(), 3);
+	EXPECT_FALSE(conn->is_open());
+
+	conn.reset();
+	file.reset();
+
+	auto data = read_file(capture);
+	ASSERT_GT(data.size(), 8);
+	EXPECT_EQ(data[8], MAVLINK_STX);
+
+	::unlink(path);
+	::unlink(capture);
+}
+
+TEST(TXRING, overflow)
+{
+	TxRing ring(4);
+	uint8_t byte = 0;
+
+	for (size_t i = 0; i < 4; i++)
+		EXPECT_TRUE(ring.emplace(&byte, 1));
+	EXPECT_FALSE(ring.emplace(&byte, 1));
+
+	ring.pop();
+	EXPECT_TRUE(ring.emplace(&byte, 1));
+}
+
+TEST(TXRING, gather)
+{
+	TxRing ring(8);
+	std::array<boost::asio::const_buffer, 4> iov;
+	uint8_t data[100] = {};
+
+	for (size_t i = 0; i < 6; i++)
+		ASSERT_TRUE(ring.emplace(data, 30));
+
+	// byte cap
+	EXPECT_EQ(ring.gather(iov.data(), iov.size(), 70), 2);
+	// iov cap
+	EXPECT_EQ(ring.gather(iov.data(), iov.size(), 1000), 4);
+	// first buffer is taken even if bigger than cap
+	EXPECT_EQ(ring.gather(iov.data(), iov.size(), 0), 1);
+
+	// partial write leaves rest of second buffer at front
+	ring.consume(45);
+	auto buf = ring.front();
+	ASSERT_NE(buf, nullptr);
+	EXPECT_EQ(buf->nbytes(), 15);
+
+	EXPECT_EQ(ring.gather(iov.data(), iov.size(), 1000), 4);
+	EXPECT_EQ(boost::asio::buffer_size(iov[0]), 15);
+
+	ring.consume(15 + 4 * 30);
+	EXPECT_EQ(ring.front(), nullptr);
+}
+
+TEST(TXRING, shared_frame)
+{
+	TxRing ring1(2), ring2(2);
+	uint8_t data[20];
+
+	for (size_t i = 0; i < sizeof(data); i++)
+		data[i] = i;
+
+	auto frame = std::make_shared<MsgBuffer>(data, sizeof(data));
+	EXPECT_EQ(ring1.emplace(frame), sizeof(data));
+	EXPECT_EQ(ring2.emplace(frame), sizeof(data));
+	EXPECT_EQ(frame.use_count(), 3);
+
+	// write positions are independent
+	ring1.consume(5);
+	auto b1 = ring1.front(), b2 = ring2.front();
+	ASSERT_NE(b1, nullptr);
+	ASSERT_NE(b2, nullptr);
+	EXPECT_EQ(b1->nbytes(), 15);
+	EXPECT_EQ(b1->dpos()[0], 5);
+	EXPECT_EQ(b2->dpos(), frame->dpos());
+
+	ring1.consume(15);
+	EXPECT_EQ(frame.use_count(), 2);
+	ring2.consume(20);
+	EXPECT_EQ(frame.use_count(), 1);
+}
+
+TEST(TXRING, concurrent_producers)
+{
+	constexpr size_t producers = 4;
+	constexpr size_t per_producer = 10000;
+
+	TxRing ring(64);
+	std::vector<std::thread> threads;
+	std::vector<uint32_t> last(producers, 0);
+	size_t received = 0, wakeups = 0;
+	std::atomic<size_t> pending_wakeups(0);
+
+	for (size_t id = 0; id < producers; id++) {
+		threads.emplace_back([&, id]() {
+			for (uint32_t n = 1; n <= per_producer; n++) {
+				uint8_t data[5] = { uint8_t(id) };
+				memcpy(&data[1], &n, sizeof(n));
+
+				while (!ring.emplace(data, sizeof(data)))
+					std::this_thread::yield();
+
+				if (ring.need_wakeup())
+					pending_wakeups++;
+			}
+		});
+	}
+
+	while (received < producers * per_producer) {
+		if (pending_wakeups == 0) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		// act as IO thread started by one wakeup: drain until idle
+		pending_wakeups--;
+		wakeups++;
+		for (auto buf = ring.next(); buf != nullptr; buf = ring.next()) {
+			uint32_t n;
+			ASSERT_EQ(buf->len, 5);
+			memcpy(&n, &buf->data[1], sizeof(n));
+
+			// per producer order is preserved
+			EXPECT_EQ(n, last[buf->data[0]] + 1);
+			last[buf->data[0]] = n;
+
+			ring.pop();
+			received++;
+		}
+	}
+
+	for (auto &t : threads)
+		t.join();
+
+	EXPECT_EQ(pending_wakeups, 0);
+	EXPECT_EQ(ring.front(), nullptr);
+	EXPECT_LT(wakeups, producers * per_producer);
+}
+
+//! pop all messages from queue, return first byte of each
+static std::vector<uint8_t> drain(TxQueue &q)
+{
+	std::vector<uint8_t> ret;
+
+	for (auto buf = q.next(); buf != nullptr; buf = q.next()) {
+		ret.push_back(buf->data[0]);
+		q.consume(buf->nbytes());
+	}
+
+	return ret;
+}
+
+TEST(TXQUEUE, lane_order)
+{
+	TxQueue q(10);
+	uint8_t d[2];
+
+	q.add_lane(TxPolicy::DROP_OLDEST, {1}, 4);
+	q.add_lane(TxPolicy::NEVER_DROP, {2}, 4);
+
+	d[0] = 10; EXPECT_TRUE(q.emplace_msg(1, d, 2));
+	d[0] = 20; EXPECT_TRUE(q.emplace_msg(3, d, 2));
+	d[0] = 30; EXPECT_TRUE(q.emplace_msg(2, d, 2));
+	d[0] = 40; EXPECT_TRUE(q.emplace(d, 2));
+
+	EXPECT_TRUE(q.need_wakeup());
+	EXPECT_EQ(drain(q), std::vector<uint8_t>({30, 20, 40, 10}));
+	EXPECT_TRUE(q.need_wakeup());
+}
+
+TEST(TXQUEUE, lane_policies)
+{
+	TxQueue q(10);
+	uint8_t d[2];
+
+	q.add_lane(TxPolicy::NEVER_DROP, {1}, 2);
+	q.add_lane(TxPolicy::REPLACE_LATEST, {2, 3}, 2);
+	q.add_lane(TxPolicy::DROP_OLDEST, {4}, 2);
+
+	for (uint8_t i = 0; i < 3; i++) {
+		d[0] = 10 + i;
+		EXPECT_EQ(q.emplace_msg(1, d, 2) > 0, i < 2);
+		d[0] = 20 + i;
+		EXPECT_TRUE(q.emplace_msg(2, d, 2));
+		d[0] = 40 + i;
+		EXPECT_TRUE(q.emplace_msg(4, d, 2));
+	}
+
+	d[0] = 30;
+	EXPECT_TRUE(q.emplace_msg(3, d, 2));
+	d[0] = 31;
+	EXPECT_TRUE(q.emplace_msg(3, d, 2));
+
+	EXPECT_EQ(drain(q), std::vector<uint8_t>({10, 11, 22, 31, 41, 42}));
+}
+
+TEST(TXQUEUE, inflight_not_dropped)
+{
+	TxQueue q(10);
+	uint8_t d[10] = {};
+
+	q.add_lane(TxPolicy::DROP_OLDEST, {1}, 2);
+
+	d[0] = 1; q.emplace_msg(1, d, 10);
+	d[0] = 2; q.emplace_msg(1, d, 10);
+
+	// partial write of first one
+	auto buf = q.next();
+	ASSERT_NE(buf, nullptr);
+	EXPECT_EQ(buf->data[0], 1);
+	q.consume(5);
+
+	d[0] = 3; EXPECT_TRUE(q.emplace_msg(1, d, 10));
+
+	buf = q.next();
+	ASSERT_NE(buf, nullptr);
+	EXPECT_EQ(buf->nbytes(), 5);
+	q.consume(5);
+
+	EXPECT_EQ(drain(q), std::vector<uint8_t>({3}));
+}
+
+//! act as IO thread: gathered writes of all queued frames
+static void write_queued(TxQueue &q, std::vector<uint8_t> &stream)
+{
+	std::array<boost::asio::const_buffer, 8> iov;
+
+	while (q.next() != nullptr) {
+		size_t cnt = q.gather(iov.data(), iov.size(), 512);
+		size_t bytes = 0;
+
+		for (size_t i = 0; i < cnt; i++) {
+			auto p = static_cast<const uint8_t *>(iov[i].data());
+			stream.insert(stream.end(), p, p + iov[i].size());
+			bytes += iov[i].size();
+		}
+
+		q.consume(bytes);
+	}
+}
+
+TEST(TXQUEUE, signed_in_wire_order)
+{
+	namespace msg = mavlink::common::msg;
+
+	MessageSigning::Options opts;
+	opts.key = MessageSigning::key_from_string("secret passphrase");
+	MessageSigning signing(opts);
+
+	TxQueue q(1024);
+	q.add_lane(TxPolicy::NEVER_DROP, {msg::COMMAND_LONG::MSG_ID}, 64);
+
+	std::vector<uint8_t> stream;
+	mavlink::mavlink_status_t status {};
+	msg::HEARTBEAT hb {};
+	msg::COMMAND_LONG cmd {};
+	hb.mavlink_version = 3;		// last field, payload not trimmed
+
+	// command queued later overtakes heartbeat, length includes signature to be added
+	EXPECT_EQ(q.emplace_msg(hb.MSG_ID, hb, &status, 1, 1, &signing), MAVLINK_NUM_NON_PAYLOAD_BYTES + 9 + MAVLINK_SIGNATURE_BLOCK_LEN);
+	EXPECT_TRUE(q.emplace_msg(cmd.MSG_ID, cmd, &status, 1, 1, &signing));
+	EXPECT_TRUE(q.need_wakeup());
+	write_queued(q, stream);
+	EXPECT_EQ(signing.get_stats().tx_signed, 2);
+
+	// two senders and IO thread working at once
+	constexpr size_t per_sender = 2000;
+	std::atomic<size_t> queued(2);
+	std::atomic<size_t> pending_wakeups(0);
+	std::vector<std::thread> senders;
+
+	for (size_t i = 0; i < 2; i++) {
+		senders.emplace_back([&]() {
+			mavlink::mavlink_status_t st {};
+			msg::HEARTBEAT hb {};
+			msg::COMMAND_LONG cmd {};
+
+			for (size_t n = 0; n < per_sender; n++) {
+				// every 4th frame goes to priority lane
+				while (!((n % 4 == 0)
+						? q.emplace_msg(cmd.MSG_ID, cmd, &st, 1, 1, &signing)
+						: q.emplace_msg(hb.MSG_ID, hb, &st, 1, 1, &signing)))
+					std::this_thread::yield();
+
+				if (q.need_wakeup())
+					pending_wakeups++;
+				queued++;
+			}
+		});
+	}
+
+	size_t wrote_before = stream.size();
+	for (;;) {
+		bool done = queued == 2 + 2 * per_sender;
+		if (pending_wakeups == 0) {
+			if (done)
+				break;
+
+			std::this_thread::yield();
+			continue;
+		}
+
+		pending_wakeups--;
+		write_queued(q, stream);
+	}
+
+	for (auto &t : senders)
+		t.join();
+
+	EXPECT_GT(stream.size(), wrote_before);
+	EXPECT_EQ(signing.get_stats().tx_signed, 2 + 2 * per_sender);
+
+	for (auto parser : {Parser::CHAR, Parser::BLOCK}) {
+		ParserLoop loop(parser);
+		auto rx_signing = std::make_shared<MessageSigning>(opts);
+		loop.set_signing(rx_signing);
+
+		loop.feed(stream.data(), stream.size());
+		ASSERT_EQ(loop.received.size(), 2 + 2 * per_sender);
+		EXPECT_EQ(loop.received[0].msgid, msg::COMMAND_LONG::MSG_ID);
+
+		auto st = rx_signing->get_stats();
+		EXPECT_EQ(st.rx_signed, 2 + 2 * per_sender);
+		EXPECT_EQ(st.replay, 0);
+		EXPECT_EQ(st.bad_signature, 0);
+	}
+}
+
+TEST(THREAD_SCHED, parse)
+{
+	using utils::ThreadSched;
+
+	auto s = ThreadSched::parse("fifo:50", "0-2,5");
+	EXPECT_EQ(s.policy, ThreadSched::Policy::FIFO);
+	EXPECT_EQ(s.priority, 50);
+	EXPECT_EQ(s.cpus, std::vector<int>({0, 1, 2, 5}));
+	EXPECT_EQ(s.to_string(), "fifo:50 cpus 0,1,2,5");
+
+	s = ThreadSched::parse("rr:1");
+	EXPECT_EQ(s.policy, ThreadSched::Policy::RR);
+	EXPECT_TRUE(s.cpus.empty());
+
+	EXPECT_TRUE(ThreadSched::parse("other").empty());
+	EXPECT_THROW(ThreadSched::parse("fifo"), std::invalid_argument);
+	EXPECT_THROW(ThreadSched::parse("fifo:100"), std::invalid_argument);
+	EXPECT_THROW(ThreadSched::parse("idle:1"), std::invalid_argument);
+	EXPECT_THROW(ThreadSched::parse("other", "3-1"), std::invalid_argument);
+}
+
+TEST(THREAD_SCHED, io_pool)
+{
+	IOPool pool(2, "mtest");
+	utils::ThreadSched sched;
+	sched.cpus = {0};
+
+	// SCHED_OTHER needs no privileges
+	EXPECT_EQ(pool.set_sched(sched), 0);
+
+	auto eff = pool.get_sched();
+	ASSERT_EQ(eff.size(), 2);
+	for (auto &e : eff) {
+		EXPECT_EQ(e.policy, utils::ThreadSched::Policy::OTHER);
+		if (std::thread::hardware_concurrency() > 1)
+			EXPECT_EQ(e.cpus, std::vector<int>({0}));
+	}
+
+	pool.stop();
+	EXPECT_TRUE(pool.get_sched().empty());
+}
+
 int main(int argc, char **argv){
 	//ros::init(argc, argv, "mavconn_test", ros::init_options::AnonymousName);
 	::testing::InitGoogleTest(&argc, argv);
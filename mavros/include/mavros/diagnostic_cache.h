@@ -0,0 +1,65 @@
+/**
+ * @brief Cached diagnostic status entries
+ * @file diagnostic_cache.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <diagnostic_updater/diagnostic_updater.hpp>
+
+namespace mavros {
+/**
+ * @brief Part of diagnostic status which is formatted only when its source changes.
+ *
+ * Task run() passes a snapshot of the data the entries are made from.
+ * While it compares equal to the previous one, cached entries are copied
+ * to status instead of formatting them again.
+ *
+ * Not thread safe, intended for use from DiagnosticTask::run() only.
+ */
+template<class _Key>
+class DiagnosticCache {
+public:
+	DiagnosticCache() :
+		valid(false),
+		key()
+	{ }
+
+	/**
+	 * @brief Add cached entries to @a stat, rebuilding them with @a fill if @a key_ changed
+	 *
+	 * @a fill is called as fill(status, key), summary set by it is copied to @a stat too.
+	 */
+	template<class _Fill>
+	void add(diagnostic_updater::DiagnosticStatusWrapper &stat, const _Key &key_, _Fill &&fill)
+	{
+		if (!valid || !(key == key_)) {
+			cached = diagnostic_updater::DiagnosticStatusWrapper();
+			fill(cached, key_);
+			key = key_;
+			valid = true;
+		}
+
+		if (!cached.message.empty())
+			stat.summary(cached);
+
+		stat.values.insert(stat.values.end(), cached.values.begin(), cached.values.end());
+	}
+
+private:
+	bool valid;
+	_Key key;
+	diagnostic_updater::DiagnosticStatusWrapper cached;
+};
+}	// namespace mavros
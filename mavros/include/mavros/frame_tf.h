@@ -20,6 +20,7 @@
 #pragma once
 
 #include <array>
+#include <utility>
 #include <Eigen/Eigen>
 #include <Eigen/Geometry>
 #include <rclcpp/logging.hpp>
@@ -42,6 +43,18 @@ using Covariance6d = geometry_msgs::msg::PoseWithCovariance::_covariance_type;
 //! Type matching rosmsg for 9x9 covariance matrix
 using Covariance9d = std::array<double, 81>;
 
+/**
+ * @brief Batch of 3-D vectors in SoA layout: x of all vectors in column 0, y in 1, z in 2
+ */
+using Vector3dBatch = Eigen::Matrix<double, Eigen::Dynamic, 3>;
+
+/**
+ * @brief Batches of covariance matrices, column k holds row-major element k of all matrices
+ */
+using Covariance3dBatch = Eigen::Matrix<double, Eigen::Dynamic, 9>;
+using Covariance6dBatch = Eigen::Matrix<double, Eigen::Dynamic, 36>;
+using Covariance9dBatch = Eigen::Matrix<double, Eigen::Dynamic, 81>;
+
 //! Eigen::Map for Covariance3d
 using EigenMapCovariance3d = Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor> >;
 using EigenMapConstCovariance3d = Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor> >;
@@ -140,6 +153,109 @@ Covariance9d transform_static_frame(const Covariance9d &cov, const StaticTF tran
  */
 Eigen::Vector3d transform_static_frame(const Eigen::Vector3d &vec, const Eigen::Vector3d &map_origin, const StaticTF transform);
 
+/**
+ * @brief Batch variants of transform_static_frame().
+ *
+ * Static rotations are axis swaps and sign flips known at compile time,
+ * applied to whole columns, so Eigen vectorizes them over the batch.
+ * Covariances are transformed as R * cov * R^T.
+ */
+Vector3dBatch transform_static_frame(const Vector3dBatch &vecs, const StaticTF transform);
+Covariance3dBatch transform_static_frame(const Covariance3dBatch &cov, const StaticTF transform);
+Covariance6dBatch transform_static_frame(const Covariance6dBatch &cov, const StaticTF transform);
+Covariance9dBatch transform_static_frame(const Covariance9dBatch &cov, const StaticTF transform);
+
+/**
+ * @brief transform_static_frame() of batch into @a out.
+ *
+ * @a out keeps its storage if it already has same size, so it may be reused
+ * for a stream of batches without allocation. It should not alias @a vecs.
+ */
+void transform_static_frame(const Vector3dBatch &vecs, Vector3dBatch &out, const StaticTF transform);
+
+/**
+ * @brief Batch variants of transform_frame(), rotation matrix is built once per batch.
+ *
+ * Covariances are transformed as R * cov * R^T.
+ */
+Vector3dBatch transform_frame(const Vector3dBatch &vecs, const Eigen::Quaterniond &q);
+Covariance3dBatch transform_frame(const Covariance3dBatch &cov, const Eigen::Quaterniond &q);
+Covariance6dBatch transform_frame(const Covariance6dBatch &cov, const Eigen::Quaterniond &q);
+Covariance9dBatch transform_frame(const Covariance9dBatch &cov, const Eigen::Quaterniond &q);
+
+/**
+ * @brief Static rotation as axis swizzle: out[i] = ±in[index(i)]
+ */
+template<int X, int Y, int Z, bool NEG_X, bool NEG_Y, bool NEG_Z>
+struct AxisSwizzle {
+	static constexpr int index(int i) {
+		return (i == 0) ? X : (i == 1) ? Y : Z;
+	}
+
+	static constexpr bool negate(int i) {
+		return (i == 0) ? NEG_X : (i == 1) ? NEG_Y : NEG_Z;
+	}
+};
+
+template<StaticTF TF>
+struct StaticSwizzle;
+
+// NED <-> ENU: x, y swapped, z flipped
+template<> struct StaticSwizzle<StaticTF::NED_TO_ENU> : AxisSwizzle<1, 0, 2, false, false, true> { };
+template<> struct StaticSwizzle<StaticTF::ENU_TO_NED> : AxisSwizzle<1, 0, 2, false, false, true> { };
+// aircraft <-> base_link: +PI around X
+template<> struct StaticSwizzle<StaticTF::AIRCRAFT_TO_BASELINK> : AxisSwizzle<0, 1, 2, false, true, true> { };
+template<> struct StaticSwizzle<StaticTF::BASELINK_TO_AIRCRAFT> : AxisSwizzle<0, 1, 2, false, true, true> { };
+
+template<bool NEG>
+inline double swizzle_sign(double v) {
+	return NEG ? -v : v;
+}
+
+//! Element @a I of R * cov * R^T, N-D state made of 3-D blocks
+template<class S, size_t N, size_t I>
+inline double swizzle_covariance_element(const std::array<double, N * N> &cov) {
+	constexpr size_t i = I / N, j = I % N;
+	constexpr size_t src = ((i / 3) * 3 + S::index(i % 3)) * N + (j / 3) * 3 + S::index(j % 3);
+
+	return swizzle_sign<S::negate(i % 3) != S::negate(j % 3)>(cov[src]);
+}
+
+template<class S, size_t N, size_t ... I>
+inline std::array<double, N * N> swizzle_covariance(const std::array<double, N * N> &cov, std::index_sequence<I...>) {
+	return {{ swizzle_covariance_element<S, N, I>(cov)... }};
+}
+
+/**
+ * @brief Compile-time variants of transform_static_frame() for NED/ENU and aircraft/baselink.
+ *
+ * Reduce to element moves and sign flips, no branches or multiplications.
+ * Other types fall back to run-time variant.
+ */
+template<StaticTF TF, class T>
+inline T transform_static_frame(const T &in) {
+	return transform_static_frame(in, TF);
+}
+
+template<StaticTF TF>
+inline Eigen::Vector3d transform_static_frame(const Eigen::Vector3d &vec) {
+	using S = StaticSwizzle<TF>;
+
+	return Eigen::Vector3d(
+			swizzle_sign<S::negate(0)>(vec[S::index(0)]),
+			swizzle_sign<S::negate(1)>(vec[S::index(1)]),
+			swizzle_sign<S::negate(2)>(vec[S::index(2)]));
+}
+
+//! Covariance3d, Covariance6d and Covariance9d
+template<StaticTF TF, size_t SIZE>
+inline std::array<double, SIZE> transform_static_frame(const std::array<double, SIZE> &cov) {
+	constexpr size_t N = (SIZE == 9) ? 3 : (SIZE == 36) ? 6 : 9;
+	static_assert(N * N == SIZE && N % 3 == 0, "not a 3x3, 6x6 or 9x9 covariance");
+
+	return swizzle_covariance<StaticSwizzle<TF>, N>(cov, std::make_index_sequence<SIZE>());
+}
+
 }	// namespace detail
 
 // -*- frame tf -*-
@@ -187,7 +303,7 @@ inline T transform_orientation_baselink_aircraft(const T &in) {
  */
 template<class T>
 inline T transform_frame_ned_enu(const T &in) {
-	return detail::transform_static_frame(in, StaticTF::NED_TO_ENU);
+	return detail::transform_static_frame<StaticTF::NED_TO_ENU>(in);
 }
 
 /**
@@ -196,7 +312,12 @@ inline T transform_frame_ned_enu(const T &in) {
  */
 template<class T>
 inline T transform_frame_enu_ned(const T &in) {
-	return detail::transform_static_frame(in, StaticTF::ENU_TO_NED);
+	return detail::transform_static_frame<StaticTF::ENU_TO_NED>(in);
+}
+
+//! ENU to NED of batch into preallocated @a out
+inline void transform_frame_enu_ned(const Vector3dBatch &in, Vector3dBatch &out) {
+	detail::transform_static_frame(in, out, StaticTF::ENU_TO_NED);
 }
 
 /**
@@ -205,7 +326,7 @@ inline T transform_frame_enu_ned(const T &in) {
  */
 template<class T>
 inline T transform_frame_aircraft_baselink(const T &in) {
-	return detail::transform_static_frame(in, StaticTF::AIRCRAFT_TO_BASELINK);
+	return detail::transform_static_frame<StaticTF::AIRCRAFT_TO_BASELINK>(in);
 }
 
 /**
@@ -214,7 +335,7 @@ inline T transform_frame_aircraft_baselink(const T &in) {
  */
 template<class T>
 inline T transform_frame_baselink_aircraft(const T &in) {
-	return detail::transform_static_frame(in, StaticTF::BASELINK_TO_AIRCRAFT);
+	return detail::transform_static_frame<StaticTF::BASELINK_TO_AIRCRAFT>(in);
 }
 
 /**
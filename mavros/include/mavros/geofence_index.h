@@ -0,0 +1,146 @@
+/**
+ * @brief Geofence zones with fast point containment
+ * @file geofence_index.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <Eigen/Core>
+
+namespace mavros {
+/**
+ * @brief Keep-in and keep-out zones of FCU fence, in local ENU plane [m].
+ *
+ * Each polygon is indexed by uniform grid: cell keeps edges which may cross it
+ * and whether its reference point is inside, so a query counts crossings
+ * with few edges of one cell instead of whole polygon.
+ * Circles are checked directly.
+ *
+ * Index is immutable after construction, so it may be shared by setpoint
+ * plugins without locks.
+ */
+class GeofenceIndex {
+public:
+	using Ptr = std::shared_ptr<const GeofenceIndex>;
+
+	//! Grid would not be bigger, cells per axis
+	static constexpr size_t MAX_GRID = 64;
+
+	//! What setpoint plugins do with setpoint out of fence
+	enum class Action : uint8_t {
+		NONE,		//!< send as is
+		REJECT,		//!< drop setpoint
+		CLAMP,		//!< move to nearest allowed point
+	};
+
+	struct Zone {
+		bool inclusion;				//!< keep-in, otherwise keep-out
+		std::vector<Eigen::Vector2d> vertices;	//!< polygon, empty for circle
+		Eigen::Vector2d center;
+		double radius;				//!< circle [m], 0 for polygon
+	};
+
+	struct Options {
+		Action action;
+		//! Keep-in zones: true - point must be in any of them, false - in all of them
+		bool any_inclusion;
+		//! Distance of clamped point from boundary [m]
+		double margin;
+
+		Options() :
+			action(Action::REJECT),
+			any_inclusion(false),
+			margin(0.5)
+		{ }
+	};
+
+	//! Local plane of fence, for conversion of global coordinates
+	struct Origin {
+		double latitude;	//!< deg
+		double longitude;	//!< deg
+		Eigen::Vector2d local;	//!< ENU position of that point [m]
+	};
+
+	static Zone polygon(bool inclusion, std::vector<Eigen::Vector2d> vertices);
+	static Zone circle(bool inclusion, const Eigen::Vector2d &center, double radius);
+
+	GeofenceIndex(std::vector<Zone> zones, const Options &opts, const Origin &origin);
+
+	inline const Options &get_options() const {
+		return opts;
+	}
+
+	inline const Origin &get_origin() const {
+		return origin;
+	}
+
+	inline const std::vector<Zone> &get_zones() const {
+		return zones;
+	}
+
+	/**
+	 * Check point.
+	 * @return index of zone which point violates, -1 if point is allowed
+	 */
+	int check(const Eigen::Vector2d &p) const;
+
+	inline bool contains(const Eigen::Vector2d &p) const {
+		return check(p) < 0;
+	}
+
+	/**
+	 * Move point to nearest boundary of violated zones, @a margin inside of allowed area.
+	 * @return false if allowed point was not found, @a p is not changed then
+	 */
+	bool clamp(Eigen::Vector2d &p) const;
+
+	/**
+	 * Project global coordinates to local plane of @a origin.
+	 * Tangent plane with WGS-84 radii at origin, error grows with square of distance,
+	 * about 0.2 m at 1 km.
+	 */
+	static Eigen::Vector2d to_local(const Origin &origin, double latitude, double longitude);
+
+	//! Inverse of to_local()
+	static void to_global(const Origin &origin, const Eigen::Vector2d &p, double &latitude, double &longitude);
+
+private:
+	//! Polygon grid, cell edges are ranges of edge_ids
+	struct Grid {
+		Eigen::Vector2d min;
+		Eigen::Vector2d max;
+		Eigen::Vector2d inv_cell;	//!< cells per meter
+		Eigen::Vector2d cell;		//!< cell size
+		size_t nx;
+		size_t ny;
+		std::vector<uint32_t> cell_start;	//!< nx * ny + 1
+		std::vector<uint32_t> edge_ids;
+		std::vector<uint8_t> ref_inside;	//!< reference point of cell is inside
+	};
+
+	Options opts;
+	Origin origin;
+	std::vector<Zone> zones;
+	std::vector<Grid> grids;	//!< per zone, empty for circle
+	bool have_inclusion;
+
+	bool zone_contains(size_t idx, const Eigen::Vector2d &p) const;
+	Eigen::Vector2d cell_ref(const Grid &g, size_t cx, size_t cy) const;
+	void build_grid(const Zone &zone, Grid &g);
+	Eigen::Vector2d nearest_allowed(size_t idx, const Eigen::Vector2d &p) const;
+};
+}	// namespace mavros
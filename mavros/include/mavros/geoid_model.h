@@ -0,0 +1,138 @@
+/**
+ * @brief Geoid height models
+ * @file geoid_model.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mavros/seqlock.h>
+
+namespace mavros {
+/**
+ * @brief Geoid height above WGS-84 ellipsoid at given point.
+ *
+ * Implementations are safe to call from any thread.
+ */
+class GeoidModel {
+public:
+	using Ptr = std::shared_ptr<GeoidModel>;
+
+	virtual ~GeoidModel() = default;
+
+	/**
+	 * @brief Geoid height [m]
+	 * @param lat  latitude [deg]
+	 * @param lon  longitude [deg]
+	 */
+	virtual double operator()(double lat, double lon) const = 0;
+
+	/**
+	 * @brief Keep grid around point in RAM, so lookups near it do not touch dataset.
+	 *
+	 * Replaces previous tile. Default does nothing.
+	 *
+	 * @param radius  half-size of tile [deg]
+	 */
+	virtual void cache_tile(double lat, double lon, double radius) { }
+
+	/**
+	 * @brief Open GeographicLib dataset
+	 *
+	 * @param backend  "memory" - GeographicLib::Geoid loaded to RAM, cubic interpolation,
+	 *                 "mmap" - MappedGeoid
+	 * @param name     dataset name, e.g. "egm96-5"
+	 * @param path     dataset directory, empty - GeographicLib default
+	 * @throws std::exception if dataset can not be loaded
+	 */
+	static Ptr open(const std::string &backend, const std::string &name, const std::string &path = "");
+};
+
+/**
+ * @brief Geoid read from memory-mapped GeographicLib PGM file.
+ *
+ * Opening only maps file read-only: pages are faulted in on demand
+ * and shared by all processes using same dataset.
+ * Uses bilinear interpolation, like GeographicLib::Geoid with cubic = false.
+ */
+class MappedGeoid : public GeoidModel {
+public:
+	//! @throws std::runtime_error on bad file
+	explicit MappedGeoid(const std::string &filename);
+	~MappedGeoid() override;
+
+	MappedGeoid(const MappedGeoid &) = delete;
+	MappedGeoid &operator=(const MappedGeoid &) = delete;
+
+	double operator()(double lat, double lon) const override;
+	void cache_tile(double lat, double lon, double radius) override;
+
+private:
+	//! Copy of grid part, rows iy0.., columns ix0.. (wraps at 360 deg)
+	struct Tile {
+		int ix0, iy0;
+		int nx, ny;
+		std::vector<uint16_t> raw;
+	};
+
+	const uint8_t *map;
+	size_t map_size;
+	const uint8_t *data;	//!< big-endian 16 bit samples
+	int width, height;
+	double offset, scale;
+	double lonres, latres;	//!< samples per degree
+
+	std::shared_ptr<const Tile> tile;	//!< accessed by atomic_load/store
+
+	inline uint16_t rawval(int ix, int iy) const {
+		auto p = data + (size_t(iy) * width + ix) * 2;
+		return (p[0] << 8) | p[1];
+	}
+
+	void cell(double lat, double lon, int &ix, int &iy, double &fx, double &fy) const;
+};
+
+/**
+ * @brief Caches heights at corners of grid cell around last lookup.
+ *
+ * Vehicle moves only metres between samples, so while it stays in the cell
+ * lookup is bilinear interpolation of cached corners, wrapped model is not called.
+ * With @a cell_size equal to MappedGeoid grid step results are the same.
+ */
+class CachedGeoid : public GeoidModel {
+public:
+	//! @param cell_size  [deg]
+	CachedGeoid(GeoidModel::Ptr model, double cell_size);
+
+	double operator()(double lat, double lon) const override;
+
+	void cache_tile(double lat, double lon, double radius) override {
+		model->cache_tile(lat, lon, radius);
+	}
+
+private:
+	struct Cell {
+		bool valid;
+		int ix, iy;
+		double h00, h01, h10, h11;	//!< [lat][lon], 0 - south-west corner
+	};
+
+	GeoidModel::Ptr model;
+	double cell_size;
+	mutable SeqLock<Cell> cell;
+};
+}	// namespace mavros
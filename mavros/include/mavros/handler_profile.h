@@ -0,0 +1,127 @@
+/**
+ * @brief Handler execution time profile
+ * @file handler_profile.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace mavros {
+/**
+ * @brief Cheap monotonic tick counter.
+ *
+ * TSC on x86, virtual counter on aarch64, steady_clock [ns] elsewhere.
+ * Tick length is measured against steady_clock since object construction,
+ * so it needs no startup delay and gets more precise with time.
+ */
+class TickClock {
+public:
+	using steady_clock = std::chrono::steady_clock;
+
+	TickClock();
+
+	static inline uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#elif defined(__aarch64__)
+		uint64_t v;
+		asm volatile ("mrs %0, cntvct_el0" : "=r" (v));
+		return v;
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	//! [ns] per tick, 1.0 until some time passed
+	double ns_per_tick() const;
+
+private:
+	uint64_t ref_ticks;
+	steady_clock::time_point ref_time;
+};
+
+/**
+ * @brief Call count, total, max and log-linear histogram of durations.
+ *
+ * Durations are in ticks of TickClock. Histogram has 4 buckets per
+ * power of two (bucket width is 25% of its value).
+ *
+ * Single writer: record() is called only by thread running the handler,
+ * counters are relaxed atomics without read-modify-write,
+ * any thread may take snapshot().
+ */
+class HandlerProfile {
+public:
+	static constexpr size_t SUB_BITS = 2;
+	static constexpr size_t SUB = 1 << SUB_BITS;
+	static constexpr size_t MAX_MSB = 47;	//!< longer durations clamp to last bucket
+	static constexpr size_t NBUCKETS = (MAX_MSB - SUB_BITS + 2) * SUB;
+
+	struct Snapshot {
+		uint64_t calls;
+		uint64_t total;	//!< [tick]
+		uint64_t max;	//!< [tick]
+		std::array<uint64_t, NBUCKETS> hist;
+
+		//! @return upper bound of duration [tick] below which @a q of calls are, 0 - no calls
+		uint64_t percentile(double q) const;
+	};
+
+	HandlerProfile();
+
+	inline void record(uint64_t ticks) {
+		constexpr auto rlx = std::memory_order_relaxed;
+
+		calls.store(calls.load(rlx) + 1, rlx);
+		total.store(total.load(rlx) + ticks, rlx);
+		if (ticks > max.load(rlx))
+			max.store(ticks, rlx);
+
+		auto &b = hist[bucket(ticks)];
+		b.store(b.load(rlx) + 1, rlx);
+	}
+
+	Snapshot snapshot() const;
+
+	static inline size_t bucket(uint64_t ticks) {
+		if (ticks < SUB)
+			return ticks;
+
+		size_t msb = 63 - __builtin_clzll(ticks);
+		if (msb > MAX_MSB)
+			return NBUCKETS - 1;
+
+		return (msb - SUB_BITS + 1) * SUB + ((ticks >> (msb - SUB_BITS)) & (SUB - 1));
+	}
+
+	//! smallest value of bucket @a idx
+	static uint64_t bucket_lower(size_t idx);
+
+private:
+	std::atomic<uint64_t> calls;
+	std::atomic<uint64_t> total;
+	std::atomic<uint64_t> max;
+	std::array<std::atomic<uint64_t>, NBUCKETS> hist;
+};
+}	// namespace mavros
@@ -0,0 +1,182 @@
+/**
+ * @brief HIGH_LATENCY2 telemetry for low bandwidth GCS links
+ * @file high_latency.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mavconn/interface.h>
+#include <mavros/seqlock.h>
+
+namespace mavros {
+/**
+ * @brief Decides when GCS link is sent HIGH_LATENCY2 instead of forwarded streams.
+ *
+ * In AUTO mode link is considered slow when Tx queue drops frames
+ * or probed round trip is above threshold. Normal streams come back
+ * when round trip falls below half of threshold for @a hold.
+ * Without probe there is nothing to measure while streams are stopped,
+ * so normal mode is retried after @a hold, which doubles on each failed retry.
+ *
+ * While active only pass_msgids and HIGH_LATENCY2 made by the FCU are forwarded,
+ * default list keeps command acks and whole mission protocol, so GCS can
+ * still transfer missions over the slow link.
+ *
+ * update() is called by one timer, is_active() and pass() may be read from any thread.
+ */
+class HighLatencyMode {
+public:
+	using clock = std::chrono::steady_clock;
+
+	enum class Mode : uint8_t {
+		OFF,
+		ON,
+		AUTO,
+	};
+
+	//! longest retry hold, times @a hold
+	static constexpr unsigned MAX_BACKOFF = 8;
+	//! FCU -> GCS messages forwarded while active
+	static const std::vector<mavlink::msgid_t> DEFAULT_PASS;
+
+	struct Options {
+		Mode mode;
+		float rtt_threshold_ms;
+		clock::duration hold;		//!< shortest time in one state of AUTO
+		std::vector<mavlink::msgid_t> pass_msgids;
+
+		Options() :
+			mode(Mode::OFF),
+			rtt_threshold_ms(1000.0f),
+			hold(std::chrono::seconds(30)),
+			pass_msgids(DEFAULT_PASS)
+		{ }
+	};
+
+	explicit HighLatencyMode(const Options &opts = Options());
+
+	/**
+	 * Evaluate link conditions.
+	 * @param tx_drops  total Tx drops of the link
+	 * @param rtt_ms    smoothed round trip, 0 - not measured
+	 * @return true if is_active() changed
+	 */
+	bool update(clock::time_point now, uint64_t tx_drops, float rtt_ms);
+
+	inline bool is_active() const {
+		return active.load(std::memory_order_relaxed);
+	}
+
+	//! FCU frame @a msgid is forwarded while active
+	bool pass(mavlink::msgid_t msgid) const;
+
+	inline const Options &get_options() const {
+		return opts;
+	}
+
+	//! "off", "on" or "auto"
+	static bool parse_mode(const std::string &str, Mode &mode);
+	static const char *to_string(Mode mode);
+
+private:
+	const Options opts;
+	std::vector<mavlink::msgid_t> pass_sorted;
+	std::atomic<bool> active;
+
+	bool have_drops;
+	uint64_t last_drops;
+	bool retrying;			//!< left high latency, not yet confirmed for hold
+	unsigned backoff;
+	clock::time_point since;	//!< last change of active
+
+	bool set_active(bool value, clock::time_point now);
+};
+
+/**
+ * @brief Builds HIGH_LATENCY2 from FCU frames.
+ *
+ * Keeps last values of HEARTBEAT, GLOBAL_POSITION_INT, VFR_HUD, SYS_STATUS,
+ * GPS_RAW_INT, MISSION_CURRENT, NAV_CONTROLLER_OUTPUT and WIND_COV
+ * of the target component, so the report does not depend on loaded plugins.
+ * update() is called by FCU Rx thread only, make() by any other.
+ * Values are published by SeqLock, so Rx thread takes no lock.
+ */
+class HighLatencyEncoder {
+public:
+	HighLatencyEncoder();
+
+	void set_target(uint8_t sysid, uint8_t compid);
+
+	//! Account FCU frame, frames of other components are ignored
+	void update(const mavlink::mavlink_message_t &msg);
+
+	//! HEARTBEAT of the target was seen since reset()
+	bool ready();
+
+	//! Forget values, FCU lost; frame being accounted meanwhile may be kept
+	void reset();
+
+	/**
+	 * Finalized HIGH_LATENCY2 from last values, MAVLink 2 framed.
+	 * Timestamp is FCU boot time of last GLOBAL_POSITION_INT.
+	 * @param sysid  source system, the FCU one, so GCS sees report of the vehicle
+	 */
+	mavlink::mavlink_message_t make(uint8_t sysid, uint8_t compid, uint8_t seq);
+
+	//! Current report fields, for tests
+	mavlink::common::msg::HIGH_LATENCY2 get_report();
+
+private:
+	using HL2 = mavlink::common::msg::HIGH_LATENCY2;
+
+	//! HIGH_LATENCY2 fields we fill, message class itself is not trivially copyable
+	struct Values {
+		decltype(HL2::timestamp) timestamp;
+		decltype(HL2::latitude) latitude;
+		decltype(HL2::longitude) longitude;
+		decltype(HL2::custom_mode) custom_mode;
+		decltype(HL2::altitude) altitude;
+		decltype(HL2::target_distance) target_distance;
+		decltype(HL2::wp_num) wp_num;
+		decltype(HL2::failure_flags) failure_flags;
+		decltype(HL2::type) type;
+		decltype(HL2::autopilot) autopilot;
+		decltype(HL2::heading) heading;
+		decltype(HL2::target_heading) target_heading;
+		decltype(HL2::throttle) throttle;
+		decltype(HL2::airspeed) airspeed;
+		decltype(HL2::groundspeed) groundspeed;
+		decltype(HL2::windspeed) windspeed;
+		decltype(HL2::wind_heading) wind_heading;
+		decltype(HL2::eph) eph;
+		decltype(HL2::epv) epv;
+		decltype(HL2::climb_rate) climb_rate;
+		decltype(HL2::battery) battery;
+		bool heartbeat;
+	};
+
+	static Values initial_values();
+
+	std::atomic<uint8_t> target_system;
+	std::atomic<uint8_t> target_component;
+	std::atomic<bool> reset_pending;
+	Values last;			//!< Rx thread copy, published to snapshot
+	SeqLock<Values> snapshot;
+};
+}	// namespace mavros
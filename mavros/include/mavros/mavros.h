@@ -18,11 +18,22 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
 #include <rclcpp/rclcpp.hpp>
 #include <pluginlib/class_loader.hpp>
 #include <mavconn/interface.h>
+#include <mavconn/router.h>
+#include <mavconn/tx_shaper.h>
+#include <mavros_msgs/msg/handler_stats.hpp>
+#include <mavros_msgs/msg/link_stats.hpp>
 #include <mavros/mavros_plugin.h>
 #include <mavros/mavlink_diag.h>
+#include <mavros/high_latency.h>
+#include <mavros/message_pool.h>
+#include <mavros/plugin_dispatch.h>
+#include <mavros/protocol_negotiator.h>
 #include <mavros/utils.h>
 
 namespace mavros {
@@ -47,35 +58,157 @@ private:
 	// fcu_link stored in mav_uas
 	mavconn::MAVConnInterface::Ptr gcs_link;
 	bool gcs_quiet_mode;
+	bool gcs_routing;
+	//! FCU <-> GCS forwarding by target address
+	mavconn::Router router;
+	mavconn::Router::LinkId fcu_route, gcs_route;
+	//! FCU -> GCS rate caps and bandwidth budget
+	mavconn::TxShaper gcs_shaper;
+	mavconn::TxShaper::SendFn gcs_forward;
 	rclcpp::Clock::SharedPtr clock;
-	rclcpp::Time last_message_received_from_gcs;
+	std::atomic<int64_t> last_gcs_rx_ns;	//!< rx stamp of last GCS batch
 	rclcpp::Duration conn_timeout;
 
 	rclcpp::Publisher<mavros_msgs::msg::Mavlink>::SharedPtr mavlink_pub;
+	//! mavlink/from messages, reused when there are no intra-process subscribers
+	MessagePool<mavros_msgs::msg::Mavlink> mavlink_pool;
+	//! msgids and rates published to mavlink/from
+	mavconn::RxFilter mavlink_pub_filter;
 	rclcpp::Subscription<mavros_msgs::msg::Mavlink>::SharedPtr mavlink_sub;
+	rclcpp::Publisher<mavros_msgs::msg::LinkStats>::SharedPtr link_stats_pub;
+	rclcpp::TimerBase::SharedPtr link_stats_timer;
+	rclcpp::Publisher<mavros_msgs::msg::HandlerStats>::SharedPtr handler_stats_pub;
+	rclcpp::TimerBase::SharedPtr handler_stats_timer;
+	OnSetParametersCallbackHandle::SharedPtr rx_filter_param_cb;
+	OnSetParametersCallbackHandle::SharedPtr gcs_shaper_param_cb;
 
 	MavlinkDiag fcu_link_diag;
 	MavlinkDiag gcs_link_diag;
 
+	//! "auto" fcu_protocol and gcs_protocol, nullptr - fixed version
+	std::unique_ptr<ProtocolNegotiator> fcu_negotiator;
+	std::unique_ptr<ProtocolNegotiator> gcs_negotiator;
+	rclcpp::TimerBase::SharedPtr protocol_timer;
+	uint8_t probe_seq;
+
+	//! HIGH_LATENCY2 instead of forwarded streams on slow GCS link, nullptr - off
+	std::unique_ptr<HighLatencyMode> gcs_high_latency;
+	HighLatencyEncoder high_latency_encoder;
+	HighLatencyMode::clock::duration high_latency_interval;
+	HighLatencyMode::clock::time_point high_latency_next;
+	rclcpp::TimerBase::SharedPtr high_latency_timer;
+	uint8_t high_latency_seq;
+
+	//! with MAVROS_STATIC_PLUGINS only for plugins of other packages
 	pluginlib::ClassLoader<plugin::PluginBase> plugin_loader;
-	std::vector<plugin::PluginBase::Ptr> loaded_plugins;
 
-	//! FCU link -> router -> plugin handler
-	std::unordered_map<mavlink::msgid_t, plugin::PluginBase::Subscriptions> plugin_subscriptions;
+	//! Plugins serving one UAS
+	struct PluginSet {
+		UAS *uas;
+		//! runs handlers of subscriptions
+		PluginDispatcher *dispatcher;
+		//! FCU link -> router -> plugin handler
+		std::unordered_map<mavlink::msgid_t, plugin::PluginBase::Subscriptions> subscriptions;
+		std::vector<plugin::PluginBase::Ptr> loaded;
+	};
+
+	PluginDispatcher plugin_dispatcher;
+	PluginSet main_plugins;
+	int dispatch_queue_size;
+	std::vector<std::string> dispatch_fast_path;
+	//! initialize plugins on first message, except plugin_eager patterns
+	bool plugin_lazy;
+	std::vector<std::string> plugin_eager;
+	//! mlockall and dispatch worker settings applied
+	bool thread_sched_ok;
+	//! UAS::tf2_batcher window [s], 0 - do not batch
+	double tf_batch_window;
+
+	//! loaded plugins waiting for initialize_plugins()
+	struct PluginStartup {
+		std::string name;
+		UAS *uas;
+		plugin::PluginBase::Ptr plugin;
+		double load_ms;
+		double init_ms;
+	};
+	std::vector<PluginStartup> plugin_startup;
 
 	//! UAS object passed to all plugins
 	UAS mav_uas;
 
+	/**
+	 * Multi-vehicle mode: extra vehicle on shared FCU link.
+	 *
+	 * Own node in <ns>/uas<sysid>, UAS and plugin set,
+	 * gets only frames of its sysid, so plugins never parse other vehicles traffic.
+	 */
+	struct Vehicle {
+		rclcpp::Node::SharedPtr node;
+		std::unique_ptr<UAS> uas;
+		std::unique_ptr<PluginDispatcher> dispatcher;
+		PluginSet plugins;
+	};
+	std::vector<std::unique_ptr<Vehicle>> vehicles;
+	//! sysid -> dispatcher of its vehicle, nullptr - main plugin set
+	std::array<PluginDispatcher *, 256> vehicle_dispatcher;
+	//! spins vehicle nodes, main node is spun by spin() or component container
+	std::unique_ptr<rclcpp::executors::MultiThreadedExecutor> vehicle_executor;
+	std::thread vehicle_spinner;
+
 	//! fcu link -> ros
-	void mavlink_pub_cb(const mavlink::mavlink_message_t *mmsg, const mavconn::Framing framing);
+	void mavlink_pub_cb(const mavlink::mavlink_message_t *mmsgs, const mavconn::Framing *framings, size_t count);
 	//! ros -> fcu link
 	void mavlink_sub_cb(const mavros_msgs::msg::Mavlink::UniquePtr rmsg);
 
-	//! message router
-	void plugin_route_cb(const mavlink::mavlink_message_t *mmsg, const mavconn::Framing framing);
+	//! publish link counters of fcu and gcs links
+	void link_stats_cb();
+	void publish_link_stats(const std::string &name, const mavconn::MAVConnInterface::Ptr &link);
+
+	//! handler profile of main and vehicle dispatchers
+	std::vector<PluginDispatcher::ProfileStat> collect_profile();
+	void handler_stats_cb();
+	void handler_profile_diag(diagnostic_updater::DiagnosticStatusWrapper &stat);
+	//! effective IO and dispatch thread scheduling
+	void threads_diag(diagnostic_updater::DiagnosticStatusWrapper &stat);
 
-	//! load plugin
-	void add_plugin(std::string &pl_name, std::vector<std::string> &blacklist, std::vector<std::string> &whitelist);
+	//! declare <pfx>* filter parameters and apply them to @a filter
+	void declare_rx_filter(const std::string &pfx, mavconn::RxFilter &filter);
+	//! apply <pfx>* to @a filter, @a changed overrides current values
+	bool apply_rx_filter(const std::string &pfx, mavconn::RxFilter &filter,
+			const std::vector<rclcpp::Parameter> &changed, std::string &reason);
+	rcl_interfaces::msg::SetParametersResult rx_filter_param_changed(const std::vector<rclcpp::Parameter> &parameters);
+
+	//! apply gcs_shaper/* parameters, @a changed overrides current values
+	bool apply_gcs_shaper(const std::vector<rclcpp::Parameter> &changed, std::string &reason);
+	rcl_interfaces::msg::SetParametersResult gcs_shaper_param_changed(const std::vector<rclcpp::Parameter> &parameters);
+
+	//! message router
+	void plugin_route_cb(const mavlink::mavlink_message_t *mmsg, const mavconn::Framing framing, uint64_t stamp_ns);
+
+	//! names of loadable plugins, pluginlib manifests or static PluginRegistry
+	std::vector<std::string> get_plugin_names();
+	plugin::PluginBase::Ptr create_plugin(const std::string &pl_name);
+	//! load plugin into @a set and register its routes, eager plugins are queued to plugin_startup
+	void add_plugin(PluginSet &set, std::string &pl_name, std::vector<std::string> &blacklist, std::vector<std::string> &whitelist);
+	//! create vehicles of multi-vehicle mode, with plugins of main set config
+	void add_vehicles(const std::vector<int64_t> &sysids, int tgt_component_id,
+			std::vector<std::string> &blacklist, std::vector<std::string> &whitelist);
+	//! start vehicle dispatchers by @a nthreads each and spin vehicle nodes
+	void start_vehicles(size_t nthreads);
+	//! initialize plugin_startup by @a nthreads and log startup cost of each
+	void initialize_plugins(size_t nthreads);
+
+	//! set fixed @a protocol of @a link, or create @a negotiator for "auto"
+	void setup_link_protocol(const char *name, const std::string &protocol, mavconn::MAVConnInterface *link,
+			std::unique_ptr<ProtocolNegotiator> &negotiator, bool probe);
+	//! follow framing of received frames while negotiating
+	void negotiate_rx(const char *name, mavconn::MAVConnInterface *link, ProtocolNegotiator &negotiator,
+			const mavlink::mavlink_message_t *msgs, size_t count);
+	//! capabilities and probes of FCU link
+	void protocol_cb();
+	//! GCS link conditions and HIGH_LATENCY2 reports
+	void high_latency_cb();
 
 	//! start mavlink app on USB
 	void startup_px4_usb_quirk();
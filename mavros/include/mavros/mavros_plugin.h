@@ -18,11 +18,14 @@
 #pragma once
 
 #include <tuple>
+#include <type_traits>
 #include <vector>
 #include <functional>
 #include <diagnostic_updater/diagnostic_updater.hpp>
 #include <mavconn/interface.h>
 #include <mavros/mavros_uas.h>
+#include <mavros/message_pool.h>
+#include <mavros/plugin_dispatch.h>
 #include <rclcpp/node.hpp>
 
 namespace mavros {
@@ -41,8 +44,8 @@ private:
 	PluginBase(const PluginBase&) = delete;
 
 public:
-	//! generic message handler callback
-	using HandlerCb = mavconn::MAVConnInterface::ReceivedCb;
+	//! generic message handler: function pointer and bound object
+	using HandlerCb = MessageHandler;
 	//! Tuple: MSG ID, MSG NAME, message type into hash_code, message handler callback
 	using HandlerInfo = std::tuple<mavlink::msgid_t, const char*, size_t, HandlerCb>;
 	//! Subscriptions vector
@@ -87,37 +90,145 @@ protected:
 	 */
 	template<class _C>
 	HandlerInfo make_handler(const mavlink::msgid_t id, void (_C::*fn)(const mavlink::mavlink_message_t *msg, const mavconn::Framing framing)) {
-		auto bfn = std::bind(fn, static_cast<_C*>(this), std::placeholders::_1, std::placeholders::_2);
+		using Bound = std::pair<_C*, decltype(fn)>;
 		const auto type_hash_ = typeid(mavlink::mavlink_message_t).hash_code();
 
-		return HandlerInfo{ id, nullptr, type_hash_, bfn };
+		HandlerCb cb {
+			[](const void *bound, const mavlink::mavlink_message_t *msg, const mavconn::Framing framing, const void *decoded) {
+				auto b = static_cast<const Bound *>(bound);
+				(b->first->*b->second)(msg, framing);
+			},
+			std::make_shared<const Bound>(static_cast<_C*>(this), fn),
+			nullptr
+		};
+
+		return HandlerInfo{ id, nullptr, type_hash_, cb };
 	}
 
 	/**
 	 * Make subscription to message with automatic decoding.
 	 *
+	 * Object is shared with other plugins subscribed to same message,
+	 * their handlers may run at the same time on dispatch workers.
+	 *
+	 * @param[in] fn  pointer to member function (handler)
+	 */
+	template<class _C, class _T>
+	HandlerInfo make_handler(void (_C::*fn)(const mavlink::mavlink_message_t*, const _T&)) {
+		using Bound = std::pair<_C*, decltype(fn)>;
+		const auto id = _T::MSG_ID;
+		const auto name = _T::NAME;
+		const auto type_hash_ = typeid(_T).hash_code();
+
+		HandlerCb cb {
+			[](const void *bound, const mavlink::mavlink_message_t *msg, const mavconn::Framing framing, const void *decoded) {
+				if (framing != mavconn::Framing::ok)
+					return;
+
+				auto b = static_cast<const Bound *>(bound);
+				if (decoded) {
+					(b->first->*b->second)(msg, *static_cast<const _T *>(decoded));
+					return;
+				}
+
+				mavlink::MsgMap map(msg);
+				_T obj;
+				obj.deserialize(map);
+
+				(b->first->*b->second)(msg, obj);
+			},
+			std::make_shared<const Bound>(static_cast<_C*>(this), fn),
+			MessageDecoder::get<_T>()
+		};
+
+		return HandlerInfo{ id, name, type_hash_, cb };
+	}
+
+	/**
+	 * Make subscription to message with automatic decoding, handler may modify it.
+	 *
+	 * Handler gets own copy of shared object.
+	 *
 	 * @param[in] fn  pointer to member function (handler)
 	 */
 	template<class _C, class _T>
 	HandlerInfo make_handler(void (_C::*fn)(const mavlink::mavlink_message_t*, _T&)) {
-		auto bfn = std::bind(fn, static_cast<_C*>(this), std::placeholders::_1, std::placeholders::_2);
+		static_assert(!std::is_const<_T>::value, "const handlers use shared object");
+
+		using Bound = std::pair<_C*, decltype(fn)>;
 		const auto id = _T::MSG_ID;
 		const auto name = _T::NAME;
 		const auto type_hash_ = typeid(_T).hash_code();
 
-		return HandlerInfo{
-			id, name, type_hash_,
-			[bfn](const mavlink::mavlink_message_t *msg, const mavconn::Framing framing) {
+		HandlerCb cb {
+			[](const void *bound, const mavlink::mavlink_message_t *msg, const mavconn::Framing framing, const void *decoded) {
 				if (framing != mavconn::Framing::ok)
 					return;
 
+				auto b = static_cast<const Bound *>(bound);
+				if (decoded) {
+					_T obj = *static_cast<const _T *>(decoded);
+					(b->first->*b->second)(msg, obj);
+					return;
+				}
+
 				mavlink::MsgMap map(msg);
 				_T obj;
 				obj.deserialize(map);
 
-				bfn(msg, obj);
-			}
+				(b->first->*b->second)(msg, obj);
+			},
+			std::make_shared<const Bound>(static_cast<_C*>(this), fn),
+			MessageDecoder::get<_T>()
 		};
+
+		return HandlerInfo{ id, name, type_hash_, cb };
+	}
+
+	/**
+	 * Watch subscriber count of @a pub.
+	 *
+	 * Check result before building message, so handler skips allocation
+	 * and conversions nobody would receive.
+	 */
+	inline SubscriberCount watch_subscribers(rclcpp::PublisherBase::SharedPtr pub) {
+		return m_uas->subscriber_watcher.watch(std::move(pub));
+	}
+
+	/**
+	 * Timer on UAS wheel, not armed.
+	 *
+	 * Cheaper than wall timer for timeouts restarted on every message,
+	 * callback runs in wheel thread, not in executor.
+	 */
+	inline TimerWheel::Ptr create_timer(TimerWheel::Callback cb) {
+		return m_uas->timer_wheel.create(std::move(cb));
+	}
+
+	/**
+	 * Tell which messages topic of @a pub is made of.
+	 *
+	 * With sys/stream_manager enabled they are requested at rate of
+	 * fastest subscriber, and stopped when topic has none.
+	 *
+	 * @param default_rate  [Hz] for subscribers without QoS deadline
+	 */
+	inline void watch_stream(const rclcpp::PublisherBase::SharedPtr &pub,
+			const std::vector<mavlink::msgid_t> &msgids, double default_rate) {
+		m_uas->stream_manager.add_demand(pub->get_topic_name(),
+				std::vector<uint32_t>(msgids.begin(), msgids.end()), default_rate);
+	}
+
+	/**
+	 * Options for transient_local publishers.
+	 *
+	 * Intra-process comms supports only volatile durability,
+	 * so latched topics always go through middleware, even in composed container.
+	 */
+	static inline rclcpp::PublisherOptions latched_publisher_options() {
+		rclcpp::PublisherOptions options;
+		options.use_intra_process_comm = rclcpp::IntraProcessSetting::Disable;
+		return options;
 	}
 
 	/**
@@ -19,19 +19,31 @@
 
 #include <array>
 #include <mutex>
+#include <string>
 #include <atomic>
-#include <tf2_ros/transform_listener.h>
 #include <tf2_ros/transform_broadcaster.h>
 #include <tf2_ros/static_transform_broadcaster.h>
 #include <diagnostic_updater/diagnostic_updater.hpp>
 #include <mavconn/interface.h>
 #include <mavros/utils.h>
 #include <mavros/frame_tf.h>
+#include <mavros/geofence_index.h>
+#include <mavros/geoid_model.h>
+#include <mavros/seqlock.h>
+#include <mavros/stream_manager.h>
+#include <mavros/subscriber_count.h>
+#include <mavros/timer_wheel.h>
+#include <mavros/timesync_estimator.h>
+#include <mavros/transform_batcher.h>
+#include <mavros/transform_dispatcher.h>
 
 #include <GeographicLib/Geoid.hpp>
 
 #include <sensor_msgs/msg/imu.hpp>
 #include <sensor_msgs/msg/nav_sat_fix.hpp>
+#include <geometry_msgs/msg/point.hpp>
+#include <geometry_msgs/msg/quaternion.hpp>
+#include <geometry_msgs/msg/vector3.hpp>
 
 namespace mavros {
 /**
@@ -75,6 +87,47 @@ public:
 	using MAV_STATE = mavlink::common::MAV_STATE;
 	using timesync_mode = utils::timesync_mode;
 
+	/* -*- shared state snapshots, read without lock -*- */
+
+	//! Attitude in one frame pair, from IMU plugin
+	struct Attitude {
+		bool valid;	//!< false - identity orientation, zero rate
+		geometry_msgs::msg::Quaternion orientation;
+		geometry_msgs::msg::Vector3 angular_velocity;
+	};
+
+	//! Last GPS RAW fix
+	struct GpsState {
+		bool valid;
+		double latitude;	//!< deg
+		double longitude;	//!< deg
+		double altitude;	//!< m above ellipsoid
+		std::array<double, 9> position_covariance;
+		uint8_t position_covariance_type;
+		int8_t status;		//!< sensor_msgs::msg::NavSatStatus
+		uint16_t service;
+		float eph;
+		float epv;
+		int fix_type;
+		int satellites_visible;
+	};
+
+	//! Home position, from home_position plugin
+	struct Home {
+		bool valid;
+		double latitude;	//!< deg
+		double longitude;	//!< deg
+		double altitude;	//!< m above ellipsoid
+		geometry_msgs::msg::Point position;	//!< local [ENU]
+		geometry_msgs::msg::Quaternion orientation;
+	};
+
+	struct Capabilities {
+		bool known;
+		uint64_t capabilities;
+		uint64_t uid;		//!< AUTOPILOT_VERSION.uid, 0 - unknown
+	};
+
 	UAS(rclcpp::Node *node);
 	~UAS();
 
@@ -90,6 +143,21 @@ public:
 	 */
 	diagnostic_updater::Updater diag_updater;
 
+	/**
+	 * @brief Subscriber counts of plugin topics, see PluginBase::watch_subscribers()
+	 */
+	SubscriberWatcher subscriber_watcher;
+
+	/**
+	 * @brief Stream demand of plugin topics, see PluginBase::watch_stream(), driven by sys_status
+	 */
+	StreamManager stream_manager;
+
+	/**
+	 * @brief Timeouts and periodic tasks of all plugins, see PluginBase::create_timer()
+	 */
+	TimerWheel timer_wheel;
+
 	/**
 	 * @brief Return connection status
 	 */
@@ -111,6 +179,8 @@ public:
 
 	/**
 	 * @brief Add connection change handler callback
+	 *
+	 * Called at once if already connected.
 	 */
 	void add_connection_change_handler(ConnectionCb cb);
 
@@ -192,6 +262,16 @@ public:
 	 */
 	sensor_msgs::msg::Imu::SharedPtr get_attitude_imu_ned();
 
+	//! Attitude snapshot [ENU]
+	inline Attitude get_attitude_enu() {
+		return attitude_enu.load();
+	}
+
+	//! Attitude snapshot [NED]
+	inline Attitude get_attitude_ned() {
+		return attitude_ned.load();
+	}
+
 	/**
 	 * @brief Get Attitude orientation quaternion
 	 * @return orientation quaternion [ENU]
@@ -230,14 +310,42 @@ public:
 	//! Retunrs last GPS RAW message
 	sensor_msgs::msg::NavSatFix::SharedPtr get_gps_fix();
 
+	//! GPS RAW snapshot
+	inline GpsState get_gps() {
+		return gps_state.load();
+	}
+
+	/* -*- home position -*- */
+
+	//! Also caches geoid tile around home, see geoid/tile_radius param
+	void update_home(const Home &home_);
+
+	inline Home get_home() {
+		return home.load();
+	}
+
+	/* -*- geofence -*- */
+
+	//! Set by geofence plugin, nullptr - no fence
+	inline void set_geofence(GeofenceIndex::Ptr fence) {
+		std::atomic_store(&geofence, std::move(fence));
+	}
+
+	//! Index used by setpoint plugins, nullptr if fence is not loaded
+	inline GeofenceIndex::Ptr get_geofence() {
+		return std::atomic_load(&geofence);
+	}
+
 	/* -*- GograpticLib utils -*- */
 
 	/**
 	 * @brief Geoid dataset used to convert between AMSL and WGS-84
 	 *
-	 * That class loads egm96_5 dataset to RAM, it is about 24 MiB.
+	 * geoid/backend param selects the model: "mmap" maps egm96_5 file
+	 * and reads it on demand, "memory" loads it to RAM, it is about 24 MiB.
+	 * Lookups go through CachedGeoid, so consecutive samples of vehicle are cheap.
 	 */
-	std::shared_ptr<GeographicLib::Geoid> egm96_5;
+	GeoidModel::Ptr egm96_5;
 
 	/**
 	 * @brief Conversion from height above geoid (AMSL)
@@ -268,9 +376,12 @@ public:
 	/* -*- transform -*- */
 
 	tf2_ros::Buffer tf2_buffer;
-	tf2_ros::TransformListener tf2_listener;
+	//! fills tf2_buffer, delivers transforms to plugins
+	TransformDispatcher tf2_dispatcher;
 	tf2_ros::TransformBroadcaster tf2_broadcaster;
 	tf2_ros::StaticTransformBroadcaster tf2_static_broadcaster;
+	//! publishes transforms of plugin handlers as one /tf message per window
+	TransformBatcher tf2_batcher;
 
 	/**
 	 * @brief Publishes static transform.
@@ -284,11 +395,23 @@ public:
 	/* -*- time sync -*- */
 
 	inline void set_time_offset(uint64_t offset_ns) {
-		time_offset = offset_ns;
+		time_model.store(TimeSyncModel { int64_t(offset_ns), 0.0, 0 });
 	}
 
+	//! @return offset at last fit
 	inline uint64_t get_time_offset(void) {
-		return time_offset;
+		return time_model.load().offset_ns;
+	}
+
+	/**
+	 * @brief Set offset and skew used by synchronise_stamp()
+	 */
+	inline void set_time_model(const TimeSyncModel &model) {
+		time_model.store(model);
+	}
+
+	inline TimeSyncModel get_time_model(void) {
+		return time_model.load();
 	}
 
 	inline void set_timesync_mode(timesync_mode mode) {
@@ -299,16 +422,37 @@ public:
 		return tsync_mode;
 	}
 
+	/**
+	 * @brief Set receive time of message passed to plugin handlers
+	 *
+	 * Kept per thread, so only handlers called by router see it. 0 - not set.
+	 *
+	 * @param[in] stamp_ns  CLOCK_REALTIME [ns], from mavconn get_rx_stamp()
+	 */
+	static inline void set_rx_stamp(uint64_t stamp_ns) {
+		rx_stamp_ns = stamp_ns;
+	}
+
+	static inline uint64_t get_rx_stamp(void) {
+		return rx_stamp_ns;
+	}
+
 	/* -*- autopilot version -*- */
 	uint64_t get_capabilities();
-	void update_capabilities(bool known, uint64_t caps = 0);
+	void update_capabilities(bool known, uint64_t caps = 0, uint64_t uid = 0);
+
+	//! FCU hardware UID, 0 if AUTOPILOT_VERSION not received
+	inline uint64_t get_fcu_uid() {
+		return fcu_caps.load().uid;
+	}
 
 	/**
 	 * @brief Compute FCU message time from time_boot_ms or time_usec field
 	 *
-	 * Uses time_offset for calculation
+	 * Uses time model (offset and skew) for calculation, lock free
 	 *
-	 * @return FCU time if it is known else current wall time.
+	 * @return FCU time if it is known, else receive time of message
+	 *         being handled or current wall time.
 	 */
 	rclcpp::Time synchronise_stamp(uint32_t time_boot_ms);
 	rclcpp::Time synchronise_stamp(uint64_t time_usec);
@@ -379,6 +523,8 @@ public:
 	 * - APM:Copter
 	 * - PX4
 	 *
+	 * Last result is cached, string is rebuilt only when modes or FCU type change.
+	 *
 	 * @param[in] base_mode    base mode
 	 * @param[in] custom_mode  custom mode data
 	 */
@@ -389,11 +535,11 @@ public:
 	 *
 	 * Complimentary to @a str_mode_v10()
 	 *
-	 * @param[in]  cmode_str   string representation of mode
+	 * @param[in]  cmode_str   string representation of mode, case insensitive
 	 * @param[out] custom_mode decoded value
 	 * @return true if success
 	 */
-	bool cmode_from_str(std::string cmode_str, uint32_t &custom_mode);
+	bool cmode_from_str(const std::string &cmode_str, uint32_t &custom_mode);
 
 private:
 	std::recursive_mutex mutex;
@@ -412,16 +558,34 @@ private:
 	sensor_msgs::msg::Imu::SharedPtr imu_enu_data;
 	sensor_msgs::msg::Imu::SharedPtr imu_ned_data;
 
+	SeqLock<Attitude> attitude_enu;
+	SeqLock<Attitude> attitude_ned;
+
 	sensor_msgs::msg::NavSatFix::SharedPtr gps_fix;
-	float gps_eph;
-	float gps_epv;
-	int gps_fix_type;
-	int gps_satellites_visible;
+	SeqLock<GpsState> gps_state;
+	SeqLock<Home> home;
+	double geoid_tile_radius;	//!< [deg], 0 - no tile
+	GeofenceIndex::Ptr geofence;
 
-	std::atomic<uint64_t> time_offset;
+	SeqLock<TimeSyncModel> time_model;
 	timesync_mode tsync_mode;
+	static thread_local uint64_t rx_stamp_ns;
+
+	SeqLock<Capabilities> fcu_caps;
+
+	//! last str_mode_v10() result
+	struct ModeString {
+		bool valid;
+		uint8_t type;
+		uint8_t autopilot;
+		uint8_t base_mode;
+		uint32_t custom_mode;
+		std::string str;
+	};
+
+	std::mutex mode_str_mutex;
+	ModeString mode_str;
 
-	std::atomic<bool> fcu_caps_known;
-	std::atomic<uint64_t> fcu_capabilities;
+	static Attitude make_attitude(const sensor_msgs::msg::Imu &imu);
 };
 }	// namespace mavros
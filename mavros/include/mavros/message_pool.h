@@ -0,0 +1,131 @@
+/**
+ * @brief Reusable ROS message objects
+ * @file message_pool.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mavros {
+/**
+ * @brief Pool of outgoing messages of one type, published by unique_ptr.
+ *
+ * When publisher has intra-process subscribers, message is moved to them,
+ * so in-process consumer receives it without copy.
+ * Otherwise it is serialized by reference and object returns to the pool,
+ * so steady stream of one topic does no heap allocation per message.
+ *
+ * acquire() and publish() may be called from any thread.
+ */
+template<class _T>
+class MessagePool {
+public:
+	using Ptr = std::unique_ptr<_T>;
+
+	//! Objects kept for reuse, extra released ones are freed
+	static constexpr size_t DEFAULT_CAPACITY = 4;
+
+	explicit MessagePool(size_t capacity_ = DEFAULT_CAPACITY) :
+		capacity(capacity_)
+	{ }
+
+	/**
+	 * Get default-initialized message.
+	 */
+	Ptr acquire() {
+		Ptr msg;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!free.empty()) {
+				msg = std::move(free.back());
+				free.pop_back();
+			}
+		}
+
+		if (!msg)
+			return Ptr(new _T());
+
+		// reused object may keep fields of previous message
+		*msg = _T();
+		return msg;
+	}
+
+	/**
+	 * Get message with fields of previous use.
+	 *
+	 * For messages overwritten completely by caller: vector fields
+	 * keep their capacity, so refilling them does not allocate.
+	 */
+	Ptr acquire_reused() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!free.empty()) {
+				Ptr msg = std::move(free.back());
+				free.pop_back();
+				return msg;
+			}
+		}
+
+		return Ptr(new _T());
+	}
+
+	/**
+	 * Publish @a msg by @a pub (rclcpp::Publisher<_T> or compatible).
+	 */
+	template<class _Pub>
+	void publish(_Pub &pub, Ptr msg) {
+		if (pub.get_intra_process_subscription_count() > 0) {
+			pub.publish(std::move(msg));
+			return;
+		}
+
+		pub.publish(*msg);
+		release(std::move(msg));
+	}
+
+	/**
+	 * Publish @a msg if @a wanted (e.g. topic has subscribers), otherwise return it to the pool.
+	 */
+	template<class _Pub>
+	void publish_if(bool wanted, _Pub &pub, Ptr msg) {
+		if (wanted)
+			publish(pub, std::move(msg));
+		else
+			release(std::move(msg));
+	}
+
+	//! Return message which was not published
+	void release(Ptr msg) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (free.size() < capacity)
+			free.emplace_back(std::move(msg));
+	}
+
+	size_t size() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return free.size();
+	}
+
+private:
+	size_t capacity;
+	std::mutex mutex;
+	std::vector<Ptr> free;
+};
+
+template<class _T>
+constexpr size_t MessagePool<_T>::DEFAULT_CAPACITY;
+}	// namespace mavros
@@ -0,0 +1,61 @@
+/**
+ * @brief Mission id reported by FCU
+ * @file mission_id.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace mavros {
+/**
+ * @brief Last mission opaque_id reported by FCU.
+ *
+ * FCU reports the id in MISSION_COUNT, MISSION_ACK of an upload
+ * and periodically in MISSION_CURRENT.mission_id. Local copy of the mission
+ * may be trusted only while a recent report names its id,
+ * other GCS may change the mission at any time.
+ *
+ * Not thread safe.
+ */
+class MissionIdTracker {
+public:
+	using clock = std::chrono::steady_clock;
+
+	//! Report is stale after that, few MISSION_CURRENT periods
+	static constexpr std::chrono::seconds MAX_AGE { 5 };
+
+	explicit MissionIdTracker(clock::duration max_age = MAX_AGE);
+
+	//! FCU reported @a opaque_id, 0 - FCU does not support ids
+	void report(uint32_t opaque_id, clock::time_point now);
+
+	//! Forget report, FCU lost
+	void reset();
+
+	//! FCU has mission @a opaque_id, reported not longer than max_age ago
+	bool confirms(uint32_t opaque_id, clock::time_point now) const;
+
+	//! Last reported id, 0 if none
+	uint32_t last_id() const {
+		return opaque_id;
+	}
+
+private:
+	clock::duration max_age;
+	uint32_t opaque_id;
+	clock::time_point stamp;
+};
+}	// namespace mavros
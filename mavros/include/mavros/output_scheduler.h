@@ -0,0 +1,96 @@
+/**
+ * @brief Rate limited, change driven output
+ * @file output_scheduler.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace mavros {
+/**
+ * @brief Decides when latest value of high rate input is sent.
+ *
+ * Value is sent at most once per period, latest one wins. Change from last
+ * sent value not below change threshold is sent right away. Last value is
+ * resent at keep-alive period when input stops.
+ *
+ * update() is called for each new value, tick() from timer, true result
+ * means latest value should be sent now.
+ *
+ * Not thread safe.
+ */
+class OutputScheduler {
+public:
+	using clock = std::chrono::steady_clock;
+
+	struct Options {
+		clock::duration period;		//!< min interval, 0 - send each value
+		clock::duration keepalive;	//!< 0 - disabled
+		double change_threshold;	//!< 0 - disabled
+
+		Options() :
+			period(0),
+			keepalive(0),
+			change_threshold(0.0)
+		{ }
+	};
+
+	struct Stats {
+		uint64_t received;
+		uint64_t sent;
+		uint64_t immediate;	//!< by change threshold
+		uint64_t keepalive;
+	};
+
+	explicit OutputScheduler(const Options &opts = Options());
+
+	void set_options(const Options &opts);
+	Options get_options() const {
+		return opts;
+	}
+
+	//! Periods from rates [Hz], 0 - disabled
+	static Options from_rates(double rate, double keepalive_rate, double change_threshold);
+
+	/**
+	 * New value arrived
+	 * @param change  distance from last sent value
+	 */
+	bool update(double change, clock::time_point now = clock::now());
+
+	//! Timer tick, sends delayed value or keep-alive
+	bool tick(clock::time_point now = clock::now());
+
+	//! Forget last sent value, e.g. on reconnect
+	void reset();
+
+	//! Suitable timer period, 0 if timer is not needed
+	clock::duration timer_period() const;
+
+	Stats get_stats() const {
+		return stats;
+	}
+
+private:
+	Options opts;
+	bool have_sent;
+	bool pending;		//!< latest value not sent
+	clock::time_point last_sent;
+	Stats stats;
+
+	void sent(clock::time_point now);
+};
+}	// namespace mavros
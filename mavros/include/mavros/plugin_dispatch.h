@@ -0,0 +1,321 @@
+/**
+ * @brief Plugin message dispatcher
+ * @file plugin_dispatch.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+#include <mavconn/interface.h>
+#include <mavconn/thread_sched.h>
+#include <mavros/handler_profile.h>
+
+namespace mavros {
+/**
+ * @brief Type-erased decoder of one message type.
+ *
+ * Lets dispatcher decode frame once for all typed handlers of that msgid.
+ */
+struct MessageDecoder {
+	size_t type_hash;
+	size_t size;
+	void (*decode)(const mavlink::mavlink_message_t *msg, void *storage);	//!< construct object in @a storage
+	void (*destroy)(void *storage);
+
+	template<class _T>
+	static const MessageDecoder *get() {
+		static const MessageDecoder decoder {
+			typeid(_T).hash_code(),
+			sizeof(_T),
+			[](const mavlink::mavlink_message_t *msg, void *storage) {
+				mavlink::MsgMap map(msg);
+				auto obj = new (storage) _T();
+				obj->deserialize(map);
+			},
+			[](void *storage) {
+				static_cast<_T *>(storage)->~_T();
+			}
+		};
+
+		return &decoder;
+	}
+};
+
+/**
+ * @brief Compact message handler: plain function and object it is bound to.
+ *
+ * Called by one indirect call, @a obj keeps bound state alive.
+ *
+ * Typed handlers set @a decoder and get already decoded object in @a decoded,
+ * shared by all handlers of the frame, so it must not be modified.
+ * When @a decoded is nullptr handler decodes frame itself.
+ */
+struct MessageHandler {
+	using Fn = void (*)(const void *obj, const mavlink::mavlink_message_t *msg, const mavconn::Framing framing, const void *decoded);
+
+	Fn fn;
+	std::shared_ptr<const void> obj;
+	const MessageDecoder *decoder;	//!< nullptr for raw handlers
+
+	inline void operator()(const mavlink::mavlink_message_t *msg, const mavconn::Framing framing, const void *decoded = nullptr) const {
+		fn(obj.get(), msg, framing, decoded);
+	}
+
+	//! Wrap generic callback, costs extra std::function call
+	static MessageHandler from_function(mavconn::MAVConnInterface::ReceivedCb cb);
+};
+
+/**
+ * @brief Runs plugin handlers out of FCU link IO thread.
+ *
+ * Each plugin has bounded lock-free queue, IO thread only copies frame into it.
+ * Worker threads take whole plugin queues, so handlers of one plugin
+ * are called in receive order and never concurrently,
+ * while slow plugin does not delay others and link reads.
+ *
+ * Plugins of fast-path group are called inline by IO thread, like before.
+ *
+ * Handlers are looked up by flat table built by start():
+ * msgids below 65536 by two-level page index, rare bigger ones by binary search.
+ *
+ * When several typed handlers subscribe to same msgid, frame is decoded once
+ * and the object is shared by all of them, queued frames hold it by refcount.
+ *
+ * Plugin may be added with activation callback, called once before its first frame
+ * by thread which runs its handlers.
+ *
+ * With profiling enabled handler time is measured per plugin and msgid,
+ * by tick counter around calls of that plugin handlers.
+ * Costs two counter reads per frame, disabled it is one flag check.
+ */
+class PluginDispatcher
+{
+public:
+	using Handler = MessageHandler;
+	//! Sets receive time for handlers called by worker, see UAS::set_rx_stamp()
+	using StampCb = void (*)(uint64_t stamp_ns);
+	//! Deferred plugin initialization
+	using ActivateCb = std::function<void ()>;
+
+	static constexpr size_t DEFAULT_QUEUE_SIZE = 256;
+	//! Frames handled before worker moves to another plugin
+	static constexpr size_t WORKER_BATCH = 32;
+	//! Page of dispatch table
+	static constexpr size_t PAGE_SIZE = 256;
+	static constexpr size_t DIRECT_PAGES = 256;	//!< msgids below 65536 are looked up directly
+
+	struct Stat {
+		std::string name;
+		bool fast_path;
+		bool active;
+		uint64_t handled;
+		uint64_t dropped;	//!< queue overflow
+		size_t queue_high_water;
+	};
+
+	//! Handler time of one plugin for one msgid
+	struct ProfileStat {
+		std::string name;
+		mavlink::msgid_t msgid;
+		bool fast_path;		//!< called by IO thread
+		uint64_t calls;
+		uint64_t total_ns;
+		uint64_t max_ns;
+		uint64_t p50_ns;
+		uint64_t p99_ns;
+	};
+
+	explicit PluginDispatcher(StampCb stamp_cb = nullptr);
+	~PluginDispatcher();
+
+	/**
+	 * Add plugin, should be done before start().
+	 * @param activate  called before first frame, nullptr - plugin is active
+	 * @return plugin index for add_handler()
+	 */
+	size_t add_plugin(const std::string &name, bool fast_path, size_t queue_size = DEFAULT_QUEUE_SIZE,
+			ActivateCb activate = nullptr);
+	void add_handler(size_t plugin, mavlink::msgid_t msgid, Handler handler);
+
+	/**
+	 * Build dispatch table and start @a nthreads workers.
+	 * 0 - all plugins are called inline.
+	 */
+	void start(size_t nthreads);
+	//! Stop workers, queued frames are dropped
+	void stop();
+
+	/**
+	 * Set scheduling policy and CPU affinity of started workers.
+	 * @return 0 or errno of first failed worker
+	 */
+	int set_thread_sched(const mavconn::utils::ThreadSched &sched);
+	//! Effective settings of each worker
+	std::vector<mavconn::utils::ThreadSched> get_thread_sched();
+
+	/**
+	 * Call inline handlers and queue frame for others.
+	 * Link Rx callback only, never called concurrently.
+	 */
+	void dispatch(const mavlink::mavlink_message_t *msg, mavconn::Framing framing, uint64_t stamp_ns);
+
+	std::vector<Stat> get_stats();
+
+	//! Enable handler timing, may be changed at any time
+	void set_profiling(bool enable);
+	//! Profile of handlers called at least once, in msgid order
+	std::vector<ProfileStat> get_profile();
+
+private:
+	using Handlers = std::vector<Handler>;
+
+	//! Decoded message shared by queued frames, object follows the header
+	struct alignas(16) Decoded {
+		std::atomic<uint32_t> refs;
+		const MessageDecoder *decoder;
+
+		inline void *storage() {
+			return this + 1;
+		}
+	};
+
+	struct Frame {
+		mavlink::mavlink_message_t msg;
+		mavconn::Framing framing;
+		uint64_t stamp_ns;
+		const Handler *handlers;
+		size_t nhandlers;
+		Decoded *decoded;
+		HandlerProfile *profile;
+	};
+
+	//! Plugin queue, single producer (IO thread), single consumer (one worker at a time)
+	struct Lane {
+		std::string name;
+		bool fast_path;
+		std::unordered_map<mavlink::msgid_t, Handlers> handlers;
+		ActivateCb activate;
+		std::atomic<bool> active;	//!< activate called, lane consumer only writes it
+
+		std::vector<Frame> ring;
+		size_t mask;
+		std::atomic<size_t> head;	//!< written by producer
+		std::atomic<size_t> tail;	//!< written by consumer
+		std::atomic<bool> scheduled;	//!< in ready queue or taken by worker
+
+		std::atomic<uint64_t> handled;
+		std::atomic<uint64_t> dropped;
+		std::atomic<size_t> high_water;
+	};
+
+	//! Handlers of one lane for one msgid
+	struct Target {
+		Lane *lane;
+		size_t lane_idx;
+		const Handler *handlers;	//!< points into Lane::handlers, fixed after start()
+		size_t nhandlers;
+		bool typed;			//!< has handler using Route::decoder
+		mavlink::msgid_t msgid;
+		HandlerProfile *profile;	//!< written only by thread running the lane
+	};
+
+	//! Range in targets
+	struct Route {
+		uint32_t begin;
+		uint32_t end;
+		const MessageDecoder *decoder;	//!< set if frame is shared by two or more typed handlers
+		bool queued_typed;		//!< some typed target is not fast-path
+	};
+
+	StampCb stamp_cb;
+	std::vector<std::unique_ptr<Lane>> lanes;
+
+	bool compiled;
+	std::vector<Target> targets;
+	std::vector<Route> routes;		//!< 0 - empty route
+	std::array<uint16_t, DIRECT_PAGES> page_of;	//!< msgid >> 8 -> page, 0 - no handlers
+	std::vector<std::array<uint32_t, PAGE_SIZE>> pages;	//!< msgid & 0xff -> index in routes
+	std::vector<std::pair<mavlink::msgid_t, uint32_t>> high_routes;	//!< sorted, msgids >= 65536
+
+	size_t decoded_size;			//!< biggest shared object
+	std::vector<std::max_align_t> scratch;	//!< IO thread, decoded object for inline-only calls
+	std::mutex decoded_mutex;
+	std::vector<Decoded *> decoded_free;
+
+	std::atomic<bool> profiling;
+	TickClock tick_clock;
+	std::vector<std::unique_ptr<HandlerProfile>> profiles;	//!< one per target
+
+	std::atomic<bool> running;
+	std::vector<std::thread> workers;
+	std::mutex workers_mutex;	//!< stop() vs. sched calls
+	std::mutex ready_mutex;
+	std::condition_variable ready_cond;
+	std::deque<size_t> ready;
+
+	inline const Route &find_route(mavlink::msgid_t msgid) const {
+		if (msgid < DIRECT_PAGES * PAGE_SIZE)
+			return routes[pages[page_of[msgid >> 8]][msgid & 0xff]];
+
+		return find_high_route(msgid);
+	}
+
+	const Route &find_high_route(mavlink::msgid_t msgid) const;
+	void compile();
+	void share_decoded(Route &route);
+	void push(const Target &t, const mavlink::mavlink_message_t *msg, mavconn::Framing framing, uint64_t stamp_ns, Decoded *decoded);
+	Decoded *alloc_decoded(const MessageDecoder *decoder);
+	void release_decoded(Decoded *decoded);
+	void schedule(size_t idx);
+
+	inline void ensure_active(Lane &lane) {
+		if (!lane.active.load(std::memory_order_acquire))
+			activate_lane(lane);
+	}
+
+	void activate_lane(Lane &lane);
+
+	//! call @a n handlers, timed if profiling
+	inline void call_handlers(HandlerProfile *profile, const Handler *handlers, size_t n,
+			const mavlink::mavlink_message_t *msg, mavconn::Framing framing, const void *decoded) {
+		if (!profiling.load(std::memory_order_relaxed)) {
+			for (size_t i = 0; i < n; i++)
+				handlers[i](msg, framing, decoded);
+			return;
+		}
+
+		auto t0 = TickClock::now();
+		for (size_t i = 0; i < n; i++)
+			handlers[i](msg, framing, decoded);
+
+		profile->record(TickClock::now() - t0);
+	}
+
+	void run_lane(size_t idx);
+	void do_work();
+};
+}	// namespace mavros
@@ -0,0 +1,76 @@
+/**
+ * @brief Compile-time plugin registry
+ * @file plugin_registry.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup plugin
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <mavros/mavros_plugin.h>
+
+namespace mavros {
+namespace plugin {
+
+/**
+ * @brief Plugins linked into libmavros.
+ *
+ * With MAVROS_STATIC_PLUGINS build option plugins register here
+ * by static initializers instead of pluginlib manifest,
+ * so node creates them without dlopen() and XML parsing.
+ * Plugins of other packages are still loaded by pluginlib.
+ */
+class PluginRegistry
+{
+public:
+	using Factory = PluginBase::Ptr (*)();
+
+	//! Adds plugin at static initialization
+	struct Registrar {
+		Registrar(const char *name, Factory factory) {
+			add(name, factory);
+		}
+	};
+
+	static void add(const char *name, Factory factory);
+
+	//! Registered names, sorted
+	static std::vector<std::string> get_names();
+
+	static bool has(const std::string &name);
+
+	/**
+	 * @return new plugin instance
+	 * @throws std::out_of_range if @a name is not registered
+	 */
+	static PluginBase::Ptr create(const std::string &name);
+};
+
+}	// namespace plugin
+}	// namespace mavros
+
+/**
+ * Export plugin class under mavros_plugins.xml @a name,
+ * to pluginlib or to PluginRegistry for static build.
+ */
+#ifdef MAVROS_STATIC_PLUGINS
+#define MAVROS_PLUGIN_EXPORT(name, class_)						\
+	static ::mavros::plugin::PluginRegistry::Registrar mavros_plugin_registrar_ ## name(	\
+		#name, []() -> ::mavros::plugin::PluginBase::Ptr { return std::make_shared<class_>(); });
+#else
+#include <pluginlib/class_list_macros.hpp>
+#define MAVROS_PLUGIN_EXPORT(name, class_)						\
+	PLUGINLIB_EXPORT_CLASS(class_, ::mavros::plugin::PluginBase)
+#endif
@@ -0,0 +1,111 @@
+/**
+ * @brief MAVLink protocol version negotiation
+ * @file protocol_negotiator.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <mavconn/interface.h>
+
+namespace mavros {
+/**
+ * @brief Protocol version of one link in "auto" mode.
+ *
+ * Link sends MAVLink 1 until first HEARTBEAT of the peer, then follows its framing.
+ * If the peer talks MAVLink 1, it is probed with MAV_CMD_REQUEST_PROTOCOL_VERSION
+ * in MAVLink 2 framing, like mavlink protocol negotiation spec says.
+ * Any MAVLink 2 frame from the peer or MAVLINK2 capability switches link to MAVLink 2,
+ * it is kept until reset(). Without answer after all probes link stays on MAVLink 1.
+ *
+ * frame_received() is cheap when negotiation is done, it may be called for each frame.
+ */
+class ProtocolNegotiator {
+public:
+	using clock = std::chrono::steady_clock;
+
+	enum class State : uint8_t {
+		WAIT_HEARTBEAT,	//!< MAVLink 1 until peer is heard
+		PROBE,		//!< peer sent MAVLink 1, probing
+		V1,		//!< peer did not answer probes
+		V2,
+	};
+
+	/**
+	 * @param probe          send probes, false - only follow framing of peer
+	 * @param probe_interval time between probes
+	 * @param probe_count    probes until peer is considered MAVLink 1 only
+	 */
+	explicit ProtocolNegotiator(bool probe = true,
+			clock::duration probe_interval = std::chrono::seconds(1), size_t probe_count = 3);
+
+	/**
+	 * Frame of the peer.
+	 * @return true if link protocol should be changed to get_protocol()
+	 */
+	inline bool frame_received(uint8_t magic, uint32_t msgid, clock::time_point now) {
+		auto st = state.load(std::memory_order_relaxed);
+		if (st == State::V2 || (st != State::WAIT_HEARTBEAT && magic != MAVLINK_STX))
+			return false;
+
+		return update(magic, msgid, now);
+	}
+
+	/**
+	 * Peer reported MAV_PROTOCOL_CAPABILITY_MAVLINK2 in AUTOPILOT_VERSION.
+	 * @return true if link protocol should be changed
+	 */
+	bool mavlink2_supported();
+
+	/**
+	 * Check if probe should be sent now, counts it as sent.
+	 */
+	bool probe_due(clock::time_point now);
+
+	//! Peer lost, start over on next HEARTBEAT
+	void reset();
+
+	inline State get_state() const {
+		return state.load(std::memory_order_relaxed);
+	}
+
+	inline mavconn::Protocol get_protocol() const {
+		return (get_state() == State::V2) ? mavconn::Protocol::V20 : mavconn::Protocol::V10;
+	}
+
+	/**
+	 * MAVLink 2 framed COMMAND_LONG MAV_CMD_REQUEST_PROTOCOL_VERSION,
+	 * sent as raw frame, so protocol of link does not matter.
+	 */
+	static mavlink::mavlink_message_t make_probe(uint8_t sysid, uint8_t compid,
+			uint8_t target_system, uint8_t target_component, uint8_t seq);
+
+	static const char *to_string(State st);
+
+private:
+	std::mutex mutex;
+	std::atomic<State> state;
+
+	const bool probe;
+	const clock::duration probe_interval;
+	const size_t probe_count;
+	size_t probes_sent;
+	clock::time_point next_probe;
+
+	bool update(uint8_t magic, uint32_t msgid, clock::time_point now);
+};
+}	// namespace mavros
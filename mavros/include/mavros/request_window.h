@@ -0,0 +1,156 @@
+/**
+ * @brief Windowed requests of indexed items
+ * @file request_window.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace mavros {
+/**
+ * @brief Request timeout from observed round trip time (RFC 6298 estimator)
+ *
+ * Not thread safe.
+ */
+class RttEstimator {
+public:
+	using clock = std::chrono::steady_clock;
+
+	//! Timeout would not go below that, reply may be queued behind streams
+	static constexpr std::chrono::milliseconds MIN_TIMEOUT { 50 };
+	//! Timeout would not go above that
+	static constexpr std::chrono::milliseconds MAX_TIMEOUT { 5000 };
+
+	//! @param initial_timeout   timeout until first round trip measured
+	explicit RttEstimator(clock::duration initial_timeout);
+
+	void sample(clock::duration rtt);
+
+	//! Current timeout
+	clock::duration timeout() const;
+
+	//! Timeout for @a tries send, exponential backoff for resends
+	clock::duration timeout(size_t tries) const;
+
+	//! Smoothed RTT, 0 if not measured
+	clock::duration srtt() const {
+		return std::chrono::nanoseconds(int64_t(srtt_ns));
+	}
+
+private:
+	clock::duration initial_timeout;
+	bool have_rtt;
+	double srtt_ns;
+	double rttvar_ns;
+};
+
+/**
+ * @brief Tracks item indices which have arrived and keeps
+ * a window of requests for the missing ones in flight.
+ *
+ * Used for PARAM_REQUEST_READ of missing parameters and for MISSION_REQUEST prefetch,
+ * FTP upload tracks written chunks with it.
+ * Replies to resent requests are not sampled (Karn's rule).
+ *
+ * Not thread safe.
+ */
+class RequestWindow {
+public:
+	using clock = RttEstimator::clock;
+	using SendFn = std::function<void(size_t index)>;
+
+	/**
+	 * @param window_size       requests in flight
+	 * @param retries           resends of one index until it is lost
+	 * @param initial_timeout   timeout until first round trip measured
+	 */
+	RequestWindow(size_t window_size, size_t retries, clock::duration initial_timeout);
+
+	//! Expect @a count indices, all missing, drops requests in flight
+	void reset(size_t count);
+
+	/**
+	 * @brief Mark index as arrived
+	 * @return false if it is out of range or already arrived
+	 */
+	bool received(size_t index, clock::time_point now);
+
+	/**
+	 * @brief Resend timed out requests and fill the window
+	 *
+	 * @param send  called for each request to send
+	 * @return number of indices given up in that call
+	 */
+	size_t poll(clock::time_point now, const SendFn &send);
+
+	//! Expected indices
+	size_t size() const {
+		return arrived.size();
+	}
+
+	//! Not arrived yet, including lost
+	size_t missing() const {
+		return missing_count;
+	}
+
+	//! Given up after all retries
+	size_t lost() const {
+		return lost_count;
+	}
+
+	size_t in_flight() const {
+		return requests.size();
+	}
+
+	//! Every index arrived or lost
+	bool done() const {
+		return missing_count == lost_count;
+	}
+
+	bool is_received(size_t index) const {
+		return index < arrived.size() && arrived[index];
+	}
+
+	//! Current request timeout
+	clock::duration timeout() const {
+		return rtt.timeout();
+	}
+
+	const RttEstimator &rtt_estimator() const {
+		return rtt;
+	}
+
+private:
+	struct Request {
+		size_t index;
+		size_t tries;			//!< sends made
+		clock::time_point sent;
+		clock::time_point deadline;
+	};
+
+	size_t window_size;
+	size_t retries;
+	RttEstimator rtt;
+
+	std::vector<bool> arrived;		//!< bitmap by index
+	size_t missing_count;
+	size_t lost_count;
+	size_t cursor;				//!< indices below were requested at least once
+	std::vector<Request> requests;	//!< in flight
+};
+}	// namespace mavros
@@ -0,0 +1,145 @@
+/**
+ * @brief RTCM stream framing and paced GPS_RTCM_DATA output
+ * @file rtcm_injector.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace mavros {
+/**
+ * @brief Packs RTCM data into GPS_RTCM_DATA fragments and paces them
+ * by link bandwidth budget.
+ *
+ * Byte streams (TCP, NTRIP) are split at RTCM3 frame boundaries, frames with
+ * bad CRC are dropped. Whole messages (ROS topic) are passed as is.
+ *
+ * Data is packed into units of up to 4 fragments, units come from a fixed pool.
+ * Data arriving after @a epoch_gap of silence starts new epoch, then not sent
+ * units of older epochs are dropped, except ones with station description
+ * messages (1005-1008, 1033, 1230).
+ *
+ * Thread safe, output order is kept when poll() is called from several threads.
+ */
+class RtcmInjector {
+public:
+	using clock = std::chrono::steady_clock;
+
+	//! GPS_RTCM_DATA data field
+	static constexpr size_t FRAGMENT_LEN = 180;
+	//! 2 bit fragment id
+	static constexpr size_t MAX_FRAGMENTS = 4;
+	static constexpr size_t UNIT_LEN = FRAGMENT_LEN * MAX_FRAGMENTS;
+	//! MAVLink v2 framing and flags/len fields, per fragment on the wire
+	static constexpr size_t FRAGMENT_OVERHEAD = 14;
+	//! RTCM3 preamble, header and CRC
+	static constexpr size_t RTCM3_OVERHEAD = 6;
+	static constexpr size_t RTCM3_MAX_LEN = 1023 + RTCM3_OVERHEAD;
+
+	//! GPS_RTCM_DATA fields
+	struct Fragment {
+		uint8_t flags;
+		uint8_t len;
+		const uint8_t *data;
+	};
+
+	using SendFn = std::function<void(const Fragment &)>;
+
+	struct Options {
+		size_t bandwidth;		//!< [bytes/s] on the wire, 0 - not limited
+		size_t pool_size;		//!< units
+		clock::duration epoch_gap;
+
+		Options() :
+			bandwidth(0),
+			pool_size(64),
+			epoch_gap(std::chrono::milliseconds(200))
+		{ }
+	};
+
+	struct Stats {
+		uint64_t frames;		//!< RTCM3 frames parsed
+		uint64_t crc_errors;
+		uint64_t skipped_bytes;		//!< not in valid frame
+		uint64_t fragments;		//!< sent
+		uint64_t bytes;			//!< sent data bytes
+		uint64_t stale_units;		//!< dropped by newer epoch
+		uint64_t overflow_units;	//!< dropped, pool empty
+	};
+
+	explicit RtcmInjector(const Options &opts = Options());
+
+	//! Append bytes of RTCM3 stream, partial frames are kept for next call
+	void push_stream(const uint8_t *data, size_t len, clock::time_point now = clock::now());
+
+	//! Append message as is
+	void push_message(const uint8_t *data, size_t len, clock::time_point now = clock::now());
+
+	/**
+	 * Send queued units which fit into bandwidth budget.
+	 * @return fragments sent
+	 */
+	size_t poll(SendFn send, clock::time_point now = clock::now());
+
+	//! Units waiting for poll()
+	size_t queued() const;
+
+	Stats get_stats() const;
+
+	//! CRC-24Q of RTCM3 frame
+	static uint32_t crc24q(const uint8_t *data, size_t len);
+
+private:
+	struct Unit {
+		std::array<uint8_t, UNIT_LEN> data;
+		size_t len;
+		uint64_t epoch;
+		bool keep;		//!< not dropped as stale
+	};
+
+	Options opts;
+
+	mutable std::mutex mutex;
+	std::vector<Unit> pool;
+	std::vector<size_t> free_units;
+	std::deque<size_t> queue;	//!< unit indices, oldest first
+	bool back_open;			//!< more data may be packed to queue.back()
+
+	uint64_t epoch;
+	bool have_data;
+	clock::time_point last_data;
+
+	std::vector<uint8_t> stream_buf;
+	size_t stream_head;		//!< parsed bytes in stream_buf
+
+	std::mutex poll_mutex;		//!< keeps output order
+	double tokens;			//!< [bytes]
+	clock::time_point last_refill;
+	uint8_t seq;			//!< 5 bit sequence id
+
+	Stats stats;
+
+	void update_epoch(clock::time_point now);
+	void append(const uint8_t *data, size_t len, bool keep);
+	size_t take_unit();
+	static bool is_station_message(const uint8_t *frame, size_t len);
+};
+}	// namespace mavros
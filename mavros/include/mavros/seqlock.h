@@ -0,0 +1,108 @@
+/**
+ * @brief Sequence lock for small shared state
+ * @file seqlock.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+namespace mavros {
+/**
+ * @brief Versioned snapshot of trivially copyable value.
+ *
+ * Readers never block writer and take no lock:
+ * they copy the value and retry if a store happened meanwhile.
+ * Stores are serialized by the sequence word, so writers may race too.
+ *
+ * Value is kept in atomic words, so racing copy is not a data race.
+ */
+template<class _T>
+class SeqLock {
+	static_assert(std::is_trivially_copyable<_T>::value, "SeqLock value must be trivially copyable");
+
+public:
+	explicit SeqLock(const _T &value = _T()) :
+		seq(0)
+	{
+		store_words(value);
+	}
+
+	void store(const _T &value) {
+		// odd sequence - store in progress
+		auto s = seq.load(std::memory_order_relaxed);
+		while ((s & 1) || !seq.compare_exchange_weak(s, s + 1, std::memory_order_acquire)) {
+			if (s & 1) {
+				std::this_thread::yield();
+				s = seq.load(std::memory_order_relaxed);
+			}
+		}
+
+		std::atomic_thread_fence(std::memory_order_release);
+		store_words(value);
+		seq.store(s + 2, std::memory_order_release);
+	}
+
+	_T load() const {
+		std::array<uint64_t, WORDS> buf;
+		uint64_t s1, s2;
+
+		do {
+			s1 = seq.load(std::memory_order_acquire);
+			if (s1 & 1) {
+				std::this_thread::yield();
+				s2 = s1 + 1;
+				continue;
+			}
+
+			for (size_t i = 0; i < WORDS; i++)
+				buf[i] = words[i].load(std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			s2 = seq.load(std::memory_order_relaxed);
+		} while (s1 != s2);
+
+		_T value;
+		std::memcpy(&value, buf.data(), sizeof(_T));
+		return value;
+	}
+
+	//! Number of stores done
+	uint64_t version() const {
+		return seq.load(std::memory_order_acquire) / 2;
+	}
+
+private:
+	static constexpr size_t WORDS = (sizeof(_T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+	std::atomic<uint64_t> seq;
+	std::array<std::atomic<uint64_t>, WORDS> words;
+
+	void store_words(const _T &value) {
+		std::array<uint64_t, WORDS> buf {};
+		std::memcpy(buf.data(), &value, sizeof(_T));
+
+		for (size_t i = 0; i < WORDS; i++)
+			words[i].store(buf[i], std::memory_order_relaxed);
+	}
+};
+
+template<class _T>
+constexpr size_t SeqLock<_T>::WORDS;
+}	// namespace mavros
@@ -0,0 +1,52 @@
+/**
+ * @brief Geofence check of position setpoints
+ * @file setpoint_geofence.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <Eigen/Core>
+#include <mavros/geofence_index.h>
+
+namespace mavros {
+/**
+ * @brief Check horizontal setpoint position against fence
+ *
+ * @param fence  fence of UAS, nullptr if there is none
+ * @param enu    local ENU position [m], moved into fence when action is clamp
+ * @return false if setpoint should be dropped
+ */
+bool setpoint_geofence(const GeofenceIndex *fence, Eigen::Vector2d &enu);
+
+/**
+ * @brief Check SET_POSITION_TARGET_LOCAL_NED position in MAV_FRAME_LOCAL_NED
+ *
+ * Position is checked only if x and y are not ignored by @a type_mask.
+ *
+ * @param ned  local NED position [m], x and y are changed by clamp
+ * @return false if setpoint should be dropped
+ */
+bool setpoint_geofence_local_ned(const GeofenceIndex *fence, uint16_t type_mask, Eigen::Vector3d &ned);
+
+/**
+ * @brief Check SET_POSITION_TARGET_GLOBAL_INT position
+ *
+ * Position is projected to local plane of fence origin,
+ * clamped position is converted back to 1e7 deg.
+ *
+ * @return false if setpoint should be dropped
+ */
+bool setpoint_geofence_global_int(const GeofenceIndex *fence, uint16_t type_mask, int32_t &lat_int, int32_t &lon_int);
+}	// namespace mavros
@@ -17,17 +17,164 @@
 #pragma once
 
 #include <functional>
+#include <mutex>
+#include <string>
 #include <mavros/utils.h>
 #include <mavros/mavros_plugin.h>
+#include <mavros/setpoint_geofence.h>
+#include <mavros/setpoint_streamer.h>
 
 #include <geometry_msgs/msg/transform_stamped.hpp>
 
-#include "tf2_ros/message_filter.h"
 #include <message_filters/subscriber.h>
 
 
 namespace mavros {
 namespace plugin {
+//! Brake hold: zero velocity and yaw rate, position and acceleration ignored
+template <class Msg>
+static inline bool setpoint_brake(Msg &sp)
+{
+	sp.type_mask = (1 << 10) | (7 << 6) | (7 << 0);
+	sp.vx = sp.vy = sp.vz = 0.0;
+	sp.yaw_rate = 0.0;
+	return true;
+}
+
+//! No safe attitude to hold, stream stops and FCU failsafe takes over
+static inline bool setpoint_brake(mavlink::common::msg::SET_ATTITUDE_TARGET &sp)
+{
+	return false;
+}
+
+/**
+ * @brief Latest setpoint of one type, resent at fixed rate by SetpointStreamer
+ *
+ * When stream is started, set_*() only store setpoint,
+ * it is sent at next tick, at most one period later.
+ * On stale setpoint stream does hold:
+ * - brake: zero velocity (stops for attitude target)
+ * - last: keep sending last setpoint
+ * - stop: send nothing, FCU offboard failsafe takes over
+ */
+template <class Msg>
+class SetpointStream {
+public:
+	~SetpointStream() {
+		// before setpoint storage is destroyed
+		streamer.stop();
+	}
+
+	/**
+	 * @brief Start resend thread
+	 *
+	 * @param name           diagnostic task name
+	 * @param rate           [Hz], 0 - disabled, setpoint is sent at once
+	 * @param stale_timeout  hold when no new setpoint for [sec]
+	 * @param hold_mode      brake, last or stop
+	 */
+	void start(mavros::UAS *uas_, const std::string &name, double rate, double stale_timeout,
+			const std::string &hold_mode)
+	{
+		if (rate <= 0.0)
+			return;
+
+		if (hold_mode == "last")
+			hold = [](Msg &sp) { return true; };
+		else if (hold_mode == "stop")
+			hold = [](Msg &sp) { return false; };
+		else {
+			if (hold_mode != "brake")
+				RCUTILS_LOG_WARN_NAMED("setpoint", "SP: %s: unknown hold mode %s, using brake", name.c_str(), hold_mode.c_str());
+
+			hold = [](Msg &sp) { return setpoint_brake(sp); };
+		}
+
+		uas = uas_;
+		stream_name = name;
+		UAS_DIAG(uas).add(name, this, &SetpointStream::diag_run);
+
+		using namespace std::chrono;
+		streamer.start(duration_cast<SetpointStreamer::clock::duration>(duration<double>(1.0 / rate)),
+				duration_cast<SetpointStreamer::clock::duration>(duration<double>(stale_timeout)),
+				[this](bool stale) { tick(stale); });
+	}
+
+	/**
+	 * @brief Store new setpoint
+	 * @return false if stream is off and setpoint should be sent now
+	 */
+	bool update(const Msg &sp)
+	{
+		if (!streamer.is_running())
+			return false;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			last = sp;
+		}
+
+		streamer.update();
+		return true;
+	}
+
+	SetpointStreamer::Stats get_stats() const {
+		return streamer.get_stats();
+	}
+
+private:
+	mavros::UAS *uas = nullptr;
+	std::string stream_name;
+	std::function<bool (Msg &sp)> hold;
+	std::atomic<bool> is_stale { false };
+
+	std::mutex mutex;
+	Msg last;
+
+	SetpointStreamer streamer;
+
+	void tick(bool stale)
+	{
+		Msg sp;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			sp = last;
+		}
+
+		if (stale && !is_stale)
+			RCUTILS_LOG_WARN_NAMED("setpoint", "SP: %s: setpoint is stale, hold", stream_name.c_str());
+		is_stale = stale;
+
+		if (stale && !hold(sp))
+			return;
+
+		UAS_FCU(uas)->send_message_ignore_drop(sp);
+	}
+
+	void diag_run(diagnostic_updater::DiagnosticStatusWrapper &stat)
+	{
+		auto st = streamer.get_stats();
+		auto ms = [](SetpointStreamer::clock::duration d) {
+			return std::chrono::duration<double, std::milli>(d).count();
+		};
+
+		if (st.ticks == 0)
+			stat.summary(1, "No setpoint");
+		else if (is_stale)
+			stat.summary(1, "Stale setpoint, hold");
+		else
+			stat.summary(0, "Normal");
+
+		stat.addf("Period (ms)", "%.1f", ms(streamer.get_period()));
+		stat.addf("Sent", "%llu", (unsigned long long)st.ticks);
+		stat.addf("Stale", "%llu", (unsigned long long)st.stale_ticks);
+		stat.addf("Deadline misses", "%llu", (unsigned long long)st.deadline_misses);
+		stat.addf("Skipped periods", "%llu", (unsigned long long)st.skipped);
+		stat.addf("Jitter mean (ms)", "%.3f", ms(st.jitter_mean));
+		stat.addf("Jitter max (ms)", "%.3f", ms(st.jitter_max));
+	}
+};
+
 /**
  * @brief This mixin adds set_position_target_local_ned()
  */
@@ -45,6 +192,14 @@ public:
 		mavros::UAS *m_uas_ = static_cast<D *>(this)->m_uas;
 		mavlink::common::msg::SET_POSITION_TARGET_LOCAL_NED sp;
 
+		// fence is in local ENU plane, other frames are relative to vehicle
+		if (coordinate_frame == utils::enum_value(mavlink::common::MAV_FRAME::LOCAL_NED) &&
+				!setpoint_geofence_local_ned(m_uas_->get_geofence().get(), type_mask, p)) {
+			RCUTILS_LOG_WARN_THROTTLE_NAMED(RCUTILS_STEADY_TIME, 1000, "setpoint",
+					"SP: local setpoint %.1f %.1f is out of geofence, dropped", p.x(), p.y());
+			return;
+		}
+
 		m_uas_->msg_set_target(sp);
 
 		// [[[cog:
@@ -70,8 +225,12 @@ public:
 		sp.afz = af.z();
 		// [[[end]]] (checksum: 6a9b9dacbcf85c5d428d754c20afe110)
 
-		UAS_FCU(m_uas_)->send_message_ignore_drop(sp);
+		if (!local_ned_stream.update(sp))
+			UAS_FCU(m_uas_)->send_message_ignore_drop(sp);
 	}
+
+	//! Resends last target when started
+	SetpointStream<mavlink::common::msg::SET_POSITION_TARGET_LOCAL_NED> local_ned_stream;
 };
 
 /**
@@ -91,6 +250,12 @@ public:
 		mavros::UAS *m_uas_ = static_cast<D *>(this)->m_uas;
 		mavlink::common::msg::SET_POSITION_TARGET_GLOBAL_INT sp;
 
+		if (!setpoint_geofence_global_int(m_uas_->get_geofence().get(), type_mask, lat_int, lon_int)) {
+			RCUTILS_LOG_WARN_THROTTLE_NAMED(RCUTILS_STEADY_TIME, 1000, "setpoint",
+					"SP: global setpoint %.7f %.7f is out of geofence, dropped", lat_int / 1e7, lon_int / 1e7);
+			return;
+		}
+
 		m_uas_->msg_set_target(sp);
 
 		// [[[cog:
@@ -116,8 +281,12 @@ public:
 		sp.afz = af.z();
 		// [[[end]]] (checksum: 30c9629ad309d488df1f63b683dac6a4)
 
-		UAS_FCU(m_uas_)->send_message_ignore_drop(sp);
+		if (!global_int_stream.update(sp))
+			UAS_FCU(m_uas_)->send_message_ignore_drop(sp);
 	}
+
+	//! Resends last target when started
+	SetpointStream<mavlink::common::msg::SET_POSITION_TARGET_GLOBAL_INT> global_int_stream;
 };
 
 /**
@@ -153,97 +322,80 @@ public:
 		sp.body_yaw_rate = body_rate.z();
 		// [[[end]]] (checksum: aa941484927bb7a7d39a2c31d08fcfc1)
 
-		UAS_FCU(m_uas_)->send_message_ignore_drop(sp);
+		if (!attitude_stream.update(sp))
+			UAS_FCU(m_uas_)->send_message_ignore_drop(sp);
 	}
+
+	//! Resends last target when started
+	SetpointStream<mavlink::common::msg::SET_ATTITUDE_TARGET> attitude_stream;
 };
 
 /**
- * @brief This mixin adds TF2 listener thread to plugin
+ * @brief This mixin adds TF2 listener to plugin
  *
  * It requires tf_frame_id, tf_child_frame_id strings
- * tf_rate double and uas object pointer
+ * tf_rate double and uas object pointer.
+ * Transforms are delivered by shared UAS::tf2_dispatcher thread.
  */
 template <class D>
 class TF2ListenerMixin {
 public:
-	std::thread tf_thread;
-	std::string tf_thd_name;
+	TransformDispatcher::Subscription tf_sub;
 
 	/**
 	 * @brief start tf listener
 	 *
-	 * @param _thd_name  listener thread name
+	 * @param _name      listener name, for log messages
 	 * @param cbp        plugin callback function
 	 */
-	void tf2_start(const char *_thd_name, void (D::*cbp)(const geometry_msgs::msg::TransformStamped &) )
+	void tf2_start(const char *_name, void (D::*cbp)(const geometry_msgs::msg::TransformStamped &) )
 	{
-		tf_thd_name = _thd_name;
-		auto tf_transform_cb = std::bind(cbp, static_cast<D *>(this), std::placeholders::_1);
-
-		tf_thread = std::thread([this, tf_transform_cb]() {
-			mavconn::utils::set_this_thread_name("%s", tf_thd_name.c_str());
-
-			mavros::UAS *m_uas_ = static_cast<D *>(this)->m_uas;
-			std::string &_frame_id = static_cast<D *>(this)->tf_frame_id;
-			std::string &_child_frame_id = static_cast<D *>(this)->tf_child_frame_id;
-
-			rclcpp::Rate rate(static_cast<D *>(this)->tf_rate);
-			while (rclcpp::ok()) {
-				// Wait up to 3s for transform
-				if (m_uas_->tf2_buffer.canTransform(_frame_id, _child_frame_id, rclcpp::Time(0), rclcpp::Duration(3.0))) {
-					try {
-						auto transform = m_uas_->tf2_buffer.lookupTransform(
-								_frame_id, _child_frame_id, rclcpp::Time(0), rclcpp::Duration(3.0));
-						tf_transform_cb(transform);
-					}
-					catch (tf2::LookupException &ex) {
-						RCUTILS_LOG_ERROR_NAMED("tf2_buffer", "%s: %s", tf_thd_name.c_str(), ex.what());
-					}
-				}
-				rate.sleep();
-			}
-		});
+		D *plugin = static_cast<D *>(this);
+
+		tf_sub = plugin->m_uas->tf2_dispatcher.subscribe(_name,
+				plugin->tf_frame_id, plugin->tf_child_frame_id, plugin->tf_rate,
+				std::bind(cbp, plugin, std::placeholders::_1));
 	}
 
 	/**
 	 * @brief start tf listener syncronized with another topic
 	 *
-	 * @param _thd_name  listener thread name
+	 * Each topic message is passed with last received transform.
+	 *
+	 * @param _name      listener name, for log messages
 	 * @param cbp        plugin callback function
 	 */
 	template <class T>
-	void tf2_start(const char *_thd_name, message_filters::Subscriber<T> &topic_sub, void (D::*cbp)(const geometry_msgs::msg::TransformStamped &, const typename T::ConstPtr &))
+	void tf2_start(const char *_name, message_filters::Subscriber<T> &topic_sub, void (D::*cbp)(const geometry_msgs::msg::TransformStamped &, const typename T::ConstPtr &))
 	{
-		tf_thd_name = _thd_name;
-
-		tf_thread = std::thread([this, cbp, &topic_sub]() {
-			mavconn::utils::set_this_thread_name("%s", tf_thd_name.c_str());
-
-			mavros::UAS *m_uas_ = static_cast<D *>(this)->m_uas;
-			rclcpp::Node::SharedPtr &_sp_nh = static_cast<D *>(this)->sp_nh;
-			std::string &_frame_id = static_cast<D *>(this)->tf_frame_id;
-			std::string &_child_frame_id = static_cast<D *>(this)->tf_child_frame_id;
-
-			tf2_ros::MessageFilter<T> tf2_filter(topic_sub, m_uas_->tf2_buffer, _frame_id, 10, _sp_nh);
-
-			rclcpp::Rate rate(static_cast<D *>(this)->tf_rate);
-			while (rclcpp::ok()) {
-				// Wait up to 3s for transform
-				if (m_uas_->tf2_buffer.canTransform(_frame_id, _child_frame_id, rclcpp::Time(0), rclcpp::Duration(3.0))) {
-					try {
-						auto transform = m_uas_->tf2_buffer.lookupTransform(
-								_frame_id, _child_frame_id, rclcpp::Time(0), rclcpp::Duration(3.0));
-
-						tf2_filter.registerCallback(std::bind(cbp, static_cast<D *>(this), transform, _1));
-					}
-					catch (tf2::LookupException &ex) {
-						RCUTILS_LOG_ERROR_NAMED("tf2_buffer", "%s: %s", tf_thd_name.c_str(), ex.what());
-					}
+		D *plugin = static_cast<D *>(this);
+
+		tf_sub = plugin->m_uas->tf2_dispatcher.subscribe(_name,
+				plugin->tf_frame_id, plugin->tf_child_frame_id, plugin->tf_rate,
+				[this](const geometry_msgs::msg::TransformStamped &transform) {
+					std::lock_guard<std::mutex> lock(tf_mutex);
+					tf_last = transform;
+					tf_valid = true;
+				});
+
+		topic_sub.registerCallback([this, cbp](const typename T::ConstPtr &msg) {
+				geometry_msgs::msg::TransformStamped transform;
+				{
+					std::lock_guard<std::mutex> lock(tf_mutex);
+					if (!tf_valid)
+						return;
+
+					transform = tf_last;
 				}
-				rate.sleep();
-			}
-		});
+
+				(static_cast<D *>(this)->*cbp)(transform, msg);
+			});
 	}
+
+private:
+	std::mutex tf_mutex;
+	geometry_msgs::msg::TransformStamped tf_last;
+	bool tf_valid = false;
 };
 }	// namespace plugin
 }	// namespace mavros
@@ -0,0 +1,101 @@
+/**
+ * @brief Fixed rate setpoint resend thread
+ * @file setpoint_streamer.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace mavros {
+/**
+ * @brief Calls tick function at fixed rate from own thread.
+ *
+ * Wakeups are scheduled by absolute deadlines, so executor jitter of
+ * setpoint callbacks does not reach FCU. Wakeup lateness is collected
+ * as jitter statistics, tick later than half period is a deadline miss,
+ * slots missed completely are skipped, not sent in burst.
+ *
+ * Ticks start after first update(). Setpoint is stale when there was no
+ * update() within stale timeout.
+ */
+class SetpointStreamer {
+public:
+	using clock = std::chrono::steady_clock;
+	//! Called from streamer thread each period
+	using TickFn = std::function<void(bool stale)>;
+
+	struct Stats {
+		uint64_t ticks;
+		uint64_t stale_ticks;
+		uint64_t deadline_misses;
+		uint64_t skipped;		//!< periods without tick
+		clock::duration jitter_mean;	//!< wakeup lateness
+		clock::duration jitter_max;
+	};
+
+	SetpointStreamer();
+	~SetpointStreamer();
+
+	SetpointStreamer(const SetpointStreamer &) = delete;
+	SetpointStreamer &operator=(const SetpointStreamer &) = delete;
+
+	/**
+	 * @brief Start thread, stats are reset
+	 *
+	 * @param period         tick period
+	 * @param stale_timeout  setpoint older than that is stale
+	 * @param tick           called each period
+	 */
+	void start(clock::duration period, clock::duration stale_timeout, TickFn tick);
+	void stop();
+
+	bool is_running() const {
+		return running;
+	}
+
+	//! New setpoint arrived
+	void update(clock::time_point now = clock::now());
+
+	Stats get_stats() const;
+
+	clock::duration get_period() const {
+		return period;
+	}
+
+private:
+	mutable std::mutex mutex;
+	std::condition_variable cond;		//!< wakes thread on stop()
+	std::atomic<bool> running;
+	bool have_setpoint;
+	clock::time_point last_update;
+
+	clock::duration period;
+	clock::duration stale_timeout;
+	TickFn tick_fn;
+
+	Stats stats;
+	double jitter_sum_ns;
+
+	std::thread thread;
+
+	void run();
+};
+}	// namespace mavros
@@ -0,0 +1,128 @@
+/**
+ * @brief STATUSTEXT chunk reassembly and repeat suppression
+ * @file statustext_assembler.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace mavros {
+/**
+ * @brief Joins STATUSTEXT chunks into whole texts and holds back repeats.
+ *
+ * Chunked texts (id != 0) are collected in a small fixed pool of buffers
+ * keyed by sender and id. Text is complete on chunk shorter than
+ * CHUNK_LEN, incomplete one is emitted on timeout, on eviction or when
+ * chunk sequence starts again; missing chunks become "...".
+ *
+ * Text repeated with same severity within @a repeat_window is counted,
+ * not emitted. Count is reported with next emission of that text,
+ * or by flush() once the window passed.
+ *
+ * Buffers are reused, so steady state does not allocate.
+ * Not thread safe.
+ */
+class StatusTextAssembler {
+public:
+	using clock = std::chrono::steady_clock;
+
+	static constexpr size_t CHUNK_LEN = 50;		//!< STATUSTEXT::text size
+	static constexpr size_t MAX_CHUNKS = 16;	//!< longer text is cut
+	static constexpr size_t POOL_SIZE = 4;		//!< texts assembled at once
+	static constexpr size_t RECENT_SIZE = 8;	//!< texts checked for repeats
+
+	struct Options {
+		clock::duration chunk_timeout;	//!< incomplete text is emitted after
+		clock::duration repeat_window;	//!< 0 - no suppression
+
+		Options() :
+			chunk_timeout(std::chrono::seconds(1)),
+			repeat_window(std::chrono::seconds(10))
+		{ }
+	};
+
+	struct Text {
+		uint8_t severity;
+		const std::string &text;
+		size_t repeated;	//!< suppressed copies since last emission
+		bool incomplete;	//!< chunks lost or cut
+	};
+
+	struct Stats {
+		size_t texts;		//!< emitted
+		size_t chunked;		//!< of them assembled from chunks
+		size_t incomplete;
+		size_t suppressed;	//!< repeats held back
+	};
+
+	using EmitFn = std::function<void (const Text &)>;
+
+	explicit StatusTextAssembler(const Options &opts = Options());
+
+	void set_options(const Options &opts);
+
+	/**
+	 * Feed received STATUSTEXT
+	 *
+	 * @param sender  sysid << 8 | compid
+	 * @param text    CHUNK_LEN field, null terminated if shorter
+	 * @param emit    called for texts ready to be logged and published
+	 */
+	void push(uint16_t sender, uint16_t id, uint8_t chunk_seq, uint8_t severity,
+			const char *text, clock::time_point now, const EmitFn &emit);
+
+	//! Emit timed out texts and pending repeat counts
+	void flush(clock::time_point now, const EmitFn &emit);
+
+	inline Stats get_stats() const {
+		return stats;
+	}
+
+private:
+	struct Chunks {
+		bool used;
+		uint16_t sender;
+		uint16_t id;
+		uint8_t severity;
+		uint8_t next_seq;
+		bool incomplete;
+		clock::time_point started;
+		std::string text;
+	};
+
+	struct Recent {
+		bool used;
+		uint8_t severity;
+		uint64_t hash;
+		size_t suppressed;
+		clock::time_point emitted;
+		std::string text;
+	};
+
+	Options opts;
+	Stats stats;
+	std::array<Chunks, POOL_SIZE> pool;
+	std::array<Recent, RECENT_SIZE> recent;
+	std::string single;	//!< buffer of not chunked text
+
+	void finish(Chunks &c, clock::time_point now, const EmitFn &emit);
+	void emit_text(uint8_t severity, const std::string &text, bool incomplete,
+			clock::time_point now, const EmitFn &emit);
+};
+}	// namespace mavros
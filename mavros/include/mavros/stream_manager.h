@@ -0,0 +1,123 @@
+/**
+ * @brief MESSAGE_INTERVAL from topic demand
+ * @file stream_manager.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace mavros {
+/**
+ * @brief Chooses MESSAGE_INTERVAL of FCU streams from topic demand.
+ *
+ * Demand is a topic and MAVLink messages it is made of, its rate is set
+ * from subscribers, 0 - nobody listens. Message is requested at highest
+ * rate of its demands. Faster rate is requested right away, slower one
+ * (or stop) only after it held for @a hold, so subscriber restart does not
+ * flap the stream. Requests are repeated each @a resend, as they are not
+ * acknowledged.
+ *
+ * Messages set by hand are left alone.
+ *
+ * Thread safe.
+ */
+class StreamManager {
+public:
+	using clock = std::chrono::steady_clock;
+	using DemandId = size_t;
+
+	//! MAV_CMD_SET_MESSAGE_INTERVAL param2 values
+	static constexpr float INTERVAL_DEFAULT = 0.0f;
+	static constexpr float INTERVAL_STOP = -1.0f;
+
+	struct Options {
+		clock::duration hold;	//!< slower rate wait
+		clock::duration resend;	//!< 0 - changes only
+		bool stop_unused;	//!< unused stream is stopped, else set to FCU default
+
+		Options() :
+			hold(std::chrono::seconds(5)),
+			resend(std::chrono::seconds(30)),
+			stop_unused(true)
+		{ }
+	};
+
+	struct Request {
+		uint32_t msgid;
+		float interval_us;
+	};
+
+	struct Demand {
+		std::string topic;
+		std::vector<uint32_t> msgids;
+		double default_rate;	//!< [Hz] for subscriber without rate hint
+		double rate;		//!< [Hz] current, 0 - no subscribers
+	};
+
+	explicit StreamManager(const Options &opts = Options());
+
+	void set_options(const Options &opts);
+
+	/**
+	 * Add topic demand, rate is 0 until set_rate()
+	 *
+	 * @param default_rate  [Hz] rate for subscribers which do not tell theirs
+	 */
+	DemandId add_demand(const std::string &topic, const std::vector<uint32_t> &msgids, double default_rate);
+
+	//! @param rate  [Hz] highest rate of subscribers, 0 - none
+	void set_rate(DemandId id, double rate);
+
+	//! Message interval set by hand, manager does not request it anymore
+	void set_manual(uint32_t msgid);
+
+	//! Requests to send now
+	std::vector<Request> update(clock::time_point now = clock::now());
+
+	//! Forget requested intervals, e.g. FCU reconnected. Next update() requests all.
+	void reset();
+
+	std::vector<Demand> get_demands();
+
+	//! Last requested interval of each managed message
+	std::vector<Request> get_requested();
+
+private:
+	struct Stream {
+		bool requested;		//!< interval known to FCU
+		float interval_us;	//!< last requested
+		bool lowering;
+		clock::time_point lower_since;
+		clock::time_point last_sent;
+	};
+
+	std::mutex mutex;
+	Options opts;
+	std::vector<Demand> demands;
+	std::map<uint32_t, Stream> streams;
+	std::unordered_set<uint32_t> manual;
+	clock::time_point started;
+	bool have_started;
+
+	//! @return true if @a a asks for messages more often than @a b
+	static bool is_faster(float a, float b);
+};
+}	// namespace mavros
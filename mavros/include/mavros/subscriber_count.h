@@ -0,0 +1,84 @@
+/**
+ * @brief Cached topic subscriber counts
+ * @file subscriber_count.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <rclcpp/rclcpp.hpp>
+
+namespace mavros {
+/**
+ * @brief Subscriber count of one publisher, cheap to check per message.
+ *
+ * Default constructed (not watched) count is always true,
+ * so code without watch publishes as before.
+ */
+class SubscriberCount {
+public:
+	SubscriberCount() = default;
+	explicit SubscriberCount(std::shared_ptr<const std::atomic<size_t>> count_) :
+		count(std::move(count_))
+	{ }
+
+	inline size_t get() const {
+		return count ? count->load(std::memory_order_relaxed) : 1;
+	}
+
+	inline explicit operator bool() const {
+		return get() > 0;
+	}
+
+private:
+	std::shared_ptr<const std::atomic<size_t>> count;
+};
+
+/**
+ * @brief Keeps subscriber counts of watched publishers.
+ *
+ * Counts are refreshed by background thread on node graph change events,
+ * so handlers never query middleware per message.
+ */
+class SubscriberWatcher {
+public:
+	//! Graph event wait, also stop latency
+	static constexpr auto POLL_PERIOD = std::chrono::milliseconds(100);
+
+	explicit SubscriberWatcher(rclcpp::Node *node);
+	~SubscriberWatcher();
+
+	SubscriberCount watch(rclcpp::PublisherBase::SharedPtr pub);
+
+private:
+	struct Entry {
+		std::weak_ptr<rclcpp::PublisherBase> pub;
+		std::shared_ptr<std::atomic<size_t>> count;
+	};
+
+	rclcpp::Node *node;
+	std::mutex mutex;
+	std::vector<Entry> entries;
+
+	std::atomic<bool> running;
+	std::thread thread;
+
+	void refresh();
+	void run(rclcpp::Event::SharedPtr event);
+};
+}	// namespace mavros
@@ -0,0 +1,127 @@
+/**
+ * @brief Hierarchical timer wheel
+ * @file timer_wheel.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+
+namespace mavros {
+/**
+ * @brief One thread running one-shot and periodic deadlines of all plugins.
+ *
+ * Four levels of 64 slots with 1 ms tick, so start, restart and cancel
+ * are O(1) list operations, however many timers are armed.
+ * Level 0 covers 64 ms, level 3 about 4.6 hours, longer delays are
+ * re-inserted when they reach the top.
+ * Thread sleeps until the nearest slot which has timers.
+ *
+ * Callbacks are called by wheel thread without lock, one at a time,
+ * so they should be short. Callback may start or cancel any timer.
+ */
+class TimerWheel {
+	struct Core;
+
+public:
+	using clock = std::chrono::steady_clock;
+	using Callback = std::function<void ()>;
+
+	static constexpr auto TICK = std::chrono::milliseconds(1);
+	static constexpr size_t SLOT_BITS = 6;
+	static constexpr size_t SLOTS = 1 << SLOT_BITS;
+	static constexpr size_t LEVELS = 4;
+
+	/**
+	 * @brief Timer handle. Created not armed.
+	 *
+	 * May outlive the wheel. Destruction cancels it and waits for
+	 * callback running in wheel thread, so it should not be destroyed
+	 * by its own callback.
+	 * After cancel() callback is not started, one in progress completes.
+	 */
+	class Timer {
+	public:
+		~Timer();
+
+		/**
+		 * Arm timer, re-arm if already armed.
+		 *
+		 * @param delay   first call after @a delay
+		 * @param period  then each @a period, zero - one-shot
+		 */
+		void start(clock::duration delay, clock::duration period = clock::duration::zero());
+
+		//! Periodic timer, first call after one @a period
+		inline void start_periodic(clock::duration period) {
+			start(period, period);
+		}
+
+		//! Start again with last delay and period
+		void restart();
+
+		void cancel();
+		bool is_armed();
+
+	private:
+		friend class TimerWheel;
+		friend struct Core;
+
+		Timer(std::shared_ptr<Core> core, Callback cb);
+
+		Timer *prev;			//!< slot list, valid if armed
+		Timer *next;
+		uint8_t level;
+		uint8_t slot;
+		std::shared_ptr<Core> core;
+		Callback cb;
+		uint64_t expires;		//!< tick
+		uint64_t delay_ticks;
+		uint64_t period_ticks;		//!< 0 - one-shot
+		bool armed;
+	};
+
+	using Ptr = std::shared_ptr<Timer>;
+
+	TimerWheel();
+	~TimerWheel();
+
+	//! New timer, not armed
+	Ptr create(Callback cb);
+
+	//! Timer created and started periodic
+	inline Ptr create_periodic(clock::duration period, Callback cb) {
+		auto t = create(std::move(cb));
+		t->start_periodic(period);
+		return t;
+	}
+
+	//! Armed timers count
+	size_t size();
+
+	/**
+	 * Stop wheel thread.
+	 * Callbacks are not called anymore, timers may still be started and cancelled.
+	 */
+	void stop();
+
+private:
+	std::shared_ptr<Core> core;
+	std::thread thread;
+};
+}	// namespace mavros
@@ -0,0 +1,105 @@
+/**
+ * @brief Clock offset and skew estimator
+ * @file timesync_estimator.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace mavros {
+/**
+ * @brief Linear clock model: local = remote + offset + skew * (remote - epoch)
+ *
+ * Trivially copyable, shared through SeqLock.
+ */
+struct TimeSyncModel {
+	int64_t offset_ns;	//!< local - remote at epoch, 0 - unknown
+	double skew;		//!< offset drift [ns/ns]
+	uint64_t epoch_ns;	//!< remote time of last fit
+
+	//! Local time of remote stamp
+	inline uint64_t to_local(uint64_t remote_ns) const {
+		double drift = skew * (int64_t(remote_ns) - int64_t(epoch_ns));
+		return remote_ns + offset_ns + int64_t(drift);
+	}
+
+	//! Remote time of local stamp, inverse of to_local()
+	inline uint64_t to_remote(uint64_t local_ns) const {
+		double since_epoch = (int64_t(local_ns) - offset_ns - int64_t(epoch_ns)) / (1.0 + skew);
+		return epoch_ns + int64_t(since_epoch);
+	}
+};
+
+/**
+ * @brief Fits offset and skew by weighted least squares over a sliding window.
+ *
+ * Each TIMESYNC round trip gives one sample. It is placed at the round trip
+ * midpoint and weighted by 1/RTT^2, so slow round trips have little effect.
+ * They are not dropped.
+ *
+ * Not thread safe.
+ */
+class TimeSyncEstimator {
+public:
+	//! RTT floor for weight [ns]
+	static constexpr int64_t MIN_RTT_NS = 100000;
+	//! Samples must span at least this to estimate skew [ns]
+	static constexpr int64_t MIN_SKEW_SPAN_NS = 1000000000;
+
+	explicit TimeSyncEstimator(size_t window_size);
+
+	/**
+	 * @brief Add round trip
+	 *
+	 * @param local_tx_ns   local time of request
+	 * @param remote_ns     remote time of request receipt
+	 * @param local_rx_ns   local time of reply receipt
+	 */
+	void add(uint64_t local_tx_ns, uint64_t remote_ns, uint64_t local_rx_ns);
+
+	//! Drop all samples
+	void reset();
+
+	//! Samples in window
+	size_t size() const {
+		return count;
+	}
+
+	//! Last fit, offset is 0 if there are no samples
+	TimeSyncModel model() const {
+		return last_model;
+	}
+
+	/**
+	 * @brief Offset of sample from current fit [ns]
+	 */
+	int64_t residual(uint64_t local_tx_ns, uint64_t remote_ns, uint64_t local_rx_ns) const;
+
+private:
+	struct Sample {
+		uint64_t remote_ns;
+		int64_t offset_ns;
+		double weight;
+	};
+
+	std::vector<Sample> window;
+	size_t head;		//!< next slot to write
+	size_t count;
+	TimeSyncModel last_model;
+
+	void fit();
+};
+}	// namespace mavros
@@ -0,0 +1,80 @@
+/**
+ * @brief Batched TF broadcaster
+ * @file transform_batcher.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <rclcpp/rclcpp.hpp>
+#include <tf2_msgs/msg/tf_message.hpp>
+#include <geometry_msgs/msg/transform_stamped.hpp>
+
+namespace mavros {
+/**
+ * @brief Collects transforms sent during short window and publishes them as one /tf message.
+ *
+ * Transforms are keyed by child frame (it has single parent in TF tree),
+ * so newer transform replaces queued one.
+ * Each child frame may be rate limited, its last transform is sent when period ends.
+ */
+class TransformBatcher {
+public:
+	using steady_clock = std::chrono::steady_clock;
+
+	static constexpr auto DEFAULT_WINDOW = std::chrono::milliseconds(10);
+
+	explicit TransformBatcher(rclcpp::Node *node);
+	~TransformBatcher();
+
+	//! Collect time, 0 - publish each transform at once
+	void set_window(steady_clock::duration window);
+
+	//! Max publish rate of @a child_frame_id transform [Hz], 0 - no limit
+	void set_rate_limit(const std::string &child_frame_id, double rate);
+
+	//! Queue transform, may be called from any thread
+	void send(const geometry_msgs::msg::TransformStamped &transform);
+
+private:
+	struct Child {
+		steady_clock::duration period;
+		steady_clock::time_point next;	//!< earliest publish time
+		bool pending;
+		geometry_msgs::msg::TransformStamped transform;
+	};
+
+	rclcpp::Publisher<tf2_msgs::msg::TFMessage>::SharedPtr tf_pub;
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	steady_clock::duration window;
+	std::unordered_map<std::string, Child> children;
+	steady_clock::time_point deadline;	//!< end of current window, max - no queued transforms
+	bool running;
+	std::thread thread;
+
+	/**
+	 * Move due transforms to @a msg.
+	 * @return next publish time of rate limited transforms
+	 */
+	steady_clock::time_point collect(steady_clock::time_point now, tf2_msgs::msg::TFMessage &msg);
+	void run();
+};
+}	// namespace mavros
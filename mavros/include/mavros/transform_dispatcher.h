@@ -0,0 +1,100 @@
+/**
+ * @brief Shared TF listener for plugins
+ * @file transform_dispatcher.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <rclcpp/rclcpp.hpp>
+#include <tf2_ros/buffer.h>
+#include <tf2_msgs/msg/tf_message.hpp>
+#include <geometry_msgs/msg/transform_stamped.hpp>
+
+namespace mavros {
+/**
+ * @brief Fills TF buffer and delivers transforms wanted by plugins.
+ *
+ * Replaces tf2_ros::TransformListener: /tf and /tf_static are put into @a buffer,
+ * then one thread looks up subscribed (frame_id, child_frame_id) pairs.
+ * Lookups happen only after TF update, and callback is called
+ * only for newer transform, at most @a rate times per second.
+ */
+class TransformDispatcher {
+public:
+	using TransformCb = std::function<void (const geometry_msgs::msg::TransformStamped &)>;
+
+	struct Request {
+		std::string name;	//!< for log messages
+		std::string frame_id;
+		std::string child_frame_id;
+		std::chrono::steady_clock::duration period;
+		TransformCb cb;
+
+		std::chrono::steady_clock::time_point next;	//!< rate limit
+		int64_t last_stamp_ns;	//!< of delivered transform, -1 - none
+		bool pending;		//!< buffer changed since last lookup
+	};
+
+	//! Subscription handle, drop it to unsubscribe
+	using Subscription = std::shared_ptr<Request>;
+
+	TransformDispatcher(rclcpp::Node *node, tf2_ros::Buffer &buffer);
+	~TransformDispatcher();
+
+	/**
+	 * Subscribe to transform @a frame_id -> @a child_frame_id.
+	 *
+	 * @param rate  max callback rate [Hz], 0 - no limit
+	 * @param cb    called by dispatcher thread
+	 */
+	Subscription subscribe(const std::string &name, const std::string &frame_id, const std::string &child_frame_id,
+			double rate, TransformCb cb);
+
+	/**
+	 * Incremented on each /tf_static message.
+	 * Transforms cached by plugins are invalid when it changes.
+	 */
+	inline uint64_t get_static_generation() const {
+		return static_generation.load(std::memory_order_acquire);
+	}
+
+private:
+	rclcpp::Node *node;
+	tf2_ros::Buffer &buffer;
+	rclcpp::Subscription<tf2_msgs::msg::TFMessage>::SharedPtr tf_sub;
+	rclcpp::Subscription<tf2_msgs::msg::TFMessage>::SharedPtr tf_static_sub;
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::vector<std::weak_ptr<Request>> requests;
+	bool changed;	//!< buffer updated since last pass
+	bool running;
+	std::thread thread;
+	std::atomic<uint64_t> static_generation;
+
+	void tf_cb(const tf2_msgs::msg::TFMessage::SharedPtr msg, bool is_static);
+	void run();
+	//! @return time of next rate-limited lookup
+	std::chrono::steady_clock::time_point deliver(bool changed_);
+};
+}	// namespace mavros
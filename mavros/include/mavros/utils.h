@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <cstdlib>
+#include <string>
 #include <Eigen/Geometry>
 #include <mavconn/thread_utils.h>
 #include <mavros_msgs/mavlink_convert.h>
@@ -46,6 +48,7 @@ enum class timesync_mode {
 	MAVLINK,	//!< Via TIMESYNC message
 	ONBOARD,
 	PASSTHROUGH,
+	MAVLINK_RX,	//!< Via TIMESYNC message, receive stamps, offset and skew fit
 };
 
 /**
@@ -118,5 +121,18 @@ mavlink::common::MAV_TYPE mav_type_from_str(const std::string &mav_type);
  */
 mavlink::common::LANDING_TARGET_TYPE landing_target_type_from_str(const std::string &landing_target_type);
 
+/**
+ * @brief Directory for on-disk FCU caches: $ROS_HOME/mavros or ~/.ros/mavros
+ */
+inline std::string default_cache_dir()
+{
+	const char *ros_home = std::getenv("ROS_HOME");
+	if (ros_home && *ros_home)
+		return std::string(ros_home) + "/mavros";
+
+	const char *home = std::getenv("HOME");
+	return std::string(home ? home : ".") + "/.ros/mavros";
+}
+
 }	// namespace utils
 }	// namespace mavros
@@ -12,74 +12,139 @@
  */
 
 #include <rclcpp/rclcpp.hpp>
+#include <rclcpp_components/register_node_macro.hpp>
 
 #include <mavros/utils.h>
 #include <mavros/mavlink_diag.h>
 #include <mavconn/interface.h>
 
-using namespace mavros;
-using namespace mavconn;
+namespace mavros {
+using mavconn::MAVConnInterface;
 
-rclcpp::Logger logger = rclcpp::get_logger("gcs_bridge");
-rclcpp::Publisher<mavros_msgs::msg::Mavlink>::SharedPtr mavlink_pub;
-rclcpp::Subscription<mavros_msgs::msg::Mavlink>::SharedPtr mavlink_sub;
-rclcpp::Clock::SharedPtr my_clock;
-MAVConnInterface::Ptr gcs_link;
-
-
-void mavlink_pub_cb(const mavlink::mavlink_message_t *mmsg, const mavconn::Framing framing)
-{
-	mavros_msgs::msg::Mavlink rmsg;
-
-	rmsg.header.stamp = my_clock->now();
-	mavros_msgs::mavlink::convert(*mmsg, rmsg, mavros::utils::enum_value(framing));
-	mavlink_pub->publish(rmsg);
-}
-
-void mavlink_sub_cb(const mavros_msgs::msg::Mavlink::UniquePtr rmsg)
+/**
+ * @brief GCS bridge node
+ *
+ * Loadable component, so may be composed with mavros into one process.
+ *
+ * By default frames are passed to mavros by ~/to and ~/from topics.
+ * With mavros_url set bridge forwards frames between two links instead,
+ * e.g. local:// when composed with mavros or shm:// on the same host,
+ * mavros gcs_url should be the same URL. Frames stay mavlink_message_t,
+ * no per frame ROS message conversion.
+ */
+class GcsBridge : public rclcpp::Node
 {
-	mavlink::mavlink_message_t mmsg;
-
-	if (mavros_msgs::mavlink::convert(*rmsg, mmsg))
-		gcs_link->send_message(&mmsg);	// !!! queue exception -> fall of gcs_bridge. intentional.
-	else
-		RCLCPP_ERROR(logger, "Packet drop: convert error.");
-}
+public:
+	explicit GcsBridge(const rclcpp::NodeOptions &options = rclcpp::NodeOptions()) :
+		rclcpp::Node("gcs_bridge", options),
+		updater(this, 0.5),
+		gcs_link_diag("GCS bridge"),
+		mavros_link_diag("mavros link")
+	{
+		auto gcs_url = declare_parameter<std::string>("gcs_url", "udp://@");
+		auto mavros_url = declare_parameter<std::string>("mavros_url", "");
+
+		try {
+			gcs_link = MAVConnInterface::open_url(gcs_url);
+			gcs_link_diag.set_mavconn(gcs_link);
+			gcs_link_diag.set_connection_status(true);
+		}
+		catch (mavconn::DeviceError &ex) {
+			RCLCPP_FATAL(get_logger(), "GCS: %s", ex.what());
+			throw;
+		}
+
+		// setup updater
+		updater.setHardwareID(gcs_url);
+		updater.add(gcs_link_diag);
+
+		if (mavros_url != "") {
+			RCLCPP_INFO_STREAM(get_logger(), "GCS: direct link to mavros: " << mavros_url);
+
+			try {
+				mavros_link = MAVConnInterface::open_url(mavros_url);
+				mavros_link_diag.set_mavconn(mavros_link);
+				mavros_link_diag.set_connection_status(true);
+			}
+			catch (mavconn::DeviceError &ex) {
+				RCLCPP_FATAL(get_logger(), "GCS: mavros link: %s", ex.what());
+				throw;
+			}
+
+			gcs_link->message_received_batch_cb = std::bind(&GcsBridge::forward_cb, mavros_link.get(),
+					std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+			mavros_link->message_received_batch_cb = std::bind(&GcsBridge::forward_cb, gcs_link.get(),
+					std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+
+			updater.add(mavros_link_diag);
+			return;
+		}
+
+		mavlink_pub = create_publisher<mavros_msgs::msg::Mavlink>("~/to", 10);
+		gcs_link->message_received_batch_cb = std::bind(&GcsBridge::mavlink_pub_cb, this,
+				std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+
+		// prefer UDPROS, but allow TCPROS too
+		mavlink_sub = create_subscription<mavros_msgs::msg::Mavlink>("~/from", 10,
+				std::bind(&GcsBridge::mavlink_sub_cb, this, std::placeholders::_1));
+	}
 
-int main(int argc, char *argv[])
-{
-	rclcpp::init(argc, argv);
-	rclcpp::Node::SharedPtr mavlink_nh = rclcpp::Node::make_shared("gcs_bridge");
-	my_clock = mavlink_nh->get_clock();
-	diagnostic_updater::Updater updater(mavlink_nh, 0.5);
-	mavros::MavlinkDiag gcs_link_diag("GCS bridge");
-
-	std::string gcs_url;
-	gcs_url = mavlink_nh->declare_parameter<std::string>("gcs_url", "udp://@");
-
-	try {
-		gcs_link = MAVConnInterface::open_url(gcs_url);
-		gcs_link_diag.set_mavconn(gcs_link);
-		gcs_link_diag.set_connection_status(true);
+	~GcsBridge() {
+		// link callbacks use publisher and each other
+		if (mavros_link)
+			mavros_link->close();
+		if (gcs_link)
+			gcs_link->close();
 	}
-	catch (mavconn::DeviceError &ex) {
-		RCLCPP_FATAL(logger, "GCS: %s", ex.what());
-		return 1;
+
+private:
+	diagnostic_updater::Updater updater;
+	MavlinkDiag gcs_link_diag;
+	MavlinkDiag mavros_link_diag;
+	MAVConnInterface::Ptr gcs_link;
+	MAVConnInterface::Ptr mavros_link;
+
+	rclcpp::Publisher<mavros_msgs::msg::Mavlink>::SharedPtr mavlink_pub;
+	rclcpp::Subscription<mavros_msgs::msg::Mavlink>::SharedPtr mavlink_sub;
+	//! converted batch, kept by link IO thread for reuse
+	std::vector<mavros_msgs::msg::Mavlink> pub_batch;
+
+	//! link -> link, without conversion
+	static void forward_cb(MAVConnInterface *to, const mavlink::mavlink_message_t *mmsgs,
+			const mavconn::Framing *framings, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+			to->send_message_ignore_drop(&mmsgs[i]);
 	}
 
-	mavlink_pub = mavlink_nh->create_publisher<mavros_msgs::msg::Mavlink>("~/to", 10);
-	gcs_link->message_received_cb = mavlink_pub_cb;
+	void mavlink_pub_cb(const mavlink::mavlink_message_t *mmsgs, const mavconn::Framing *framings, size_t count)
+	{
+		auto stamp = now();
+		mavros_msgs::mavlink::convert(mmsgs, framings, count, pub_batch);
+
+		// intra-process subscribers take ownership, so they get a copy
+		bool intra = mavlink_pub->get_intra_process_subscription_count() > 0;
+		for (size_t i = 0; i < count; i++) {
+			auto &rmsg = pub_batch[i];
+			rmsg.header.stamp = stamp;
+
+			if (intra)
+				mavlink_pub->publish(std::make_unique<mavros_msgs::msg::Mavlink>(rmsg));
+			else
+				mavlink_pub->publish(rmsg);
+		}
+	}
 
-	// prefer UDPROS, but allow TCPROS too
-	mavlink_sub = mavlink_nh->create_subscription<mavros_msgs::msg::Mavlink>("~/from", 10, mavlink_sub_cb); //,
-		// ros::TransportHints()
-		// 	.unreliable().maxDatagramSize(1024)
-		// 	.reliable());
+	void mavlink_sub_cb(const mavros_msgs::msg::Mavlink::UniquePtr rmsg)
+	{
+		mavlink::mavlink_message_t mmsg;
 
-	// setup updater
-	updater.setHardwareID(gcs_url);
-	updater.add(gcs_link_diag);
+		if (mavros_msgs::mavlink::convert(*rmsg, mmsg))
+			gcs_link->send_message(&mmsg);	// !!! queue exception -> fall of gcs_bridge. intentional.
+		else
+			RCLCPP_ERROR(get_logger(), "Packet drop: convert error.");
+	}
+};
+}	// namespace mavros
 
-	rclcpp::spin(mavlink_nh);
-	return 0;
-}
+RCLCPP_COMPONENTS_REGISTER_NODE(mavros::GcsBridge)
@@ -14,8 +14,9 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <algorithm>
 #include <array>
-#include <unordered_map>
+#include <utility>
 #include <mavros/utils.h>
 #include <rclcpp/logging.hpp>
 
@@ -63,7 +64,7 @@ static rclcpp::Logger logger = rclcpp::get_logger("uas");
 //     array = ename_array_name(name, suffix)
 //     cog.outl(f"""\
 // //! {name} values
-// static const std::array<const std::string, {len(enum)}> {array}{{{{""")
+// static constexpr std::array<const char *, {len(enum)}> {array}{{{{""")
 //
 // def to_string_outl(ename, funcname='to_string', suffix=None):
 //     array = ename_array_name(ename, suffix)
@@ -107,7 +108,7 @@ static rclcpp::Logger logger = rclcpp::get_logger("uas");
 // to_string_outl(ename)
 // ]]]
 //! MAV_AUTOPILOT values
-static const std::array<const std::string, 20> mav_autopilot_strings{{
+static constexpr std::array<const char *, 20> mav_autopilot_strings{{
 /*  0 */ "Generic autopilot",             // Generic autopilot, full support for everything
 /*  1 */ "Reserved for future use",       // Reserved for future use.
 /*  2 */ "SLUGS autopilot",               // SLUGS autopilot, http://slugsuav.soe.ucsc.edu
@@ -138,7 +139,7 @@ std::string to_string(MAV_AUTOPILOT e)
 
 	return mav_autopilot_strings[idx];
 }
-// [[[end]]] (checksum: 4b5a1e0cd8f9d21b956818e7efa3bc2e)
+// [[[end]]] (checksum: 1d17047653c57c083269b10aa6972258)
 
 // [[[cog:
 // ename = 'MAV_TYPE'
@@ -155,7 +156,7 @@ std::string to_string(MAV_AUTOPILOT e)
 // to_string_outl(ename)
 // ]]]
 //! MAV_TYPE values
-static const std::array<const std::string, 33> mav_type_strings{{
+static constexpr std::array<const char *, 33> mav_type_strings{{
 /*  0 */ "Generic micro air vehicle",     // Generic micro air vehicle.
 /*  1 */ "Fixed wing aircraft",           // Fixed wing aircraft.
 /*  2 */ "Quadrotor",                     // Quadrotor
@@ -199,14 +200,14 @@ std::string to_string(MAV_TYPE e)
 
 	return mav_type_strings[idx];
 }
-// [[[end]]] (checksum: b441cfd88ee1a6fc8c8bc8f4e6df5825)
+// [[[end]]] (checksum: c9916964bff55638db27ffc035eeb7af)
 
 // [[[cog:
 // ename = 'MAV_TYPE'
 // enum_name_is_value_outl(ename, funcname='to_name', suffix='_names')
 // ]]]
 //! MAV_TYPE values
-static const std::array<const std::string, 33> mav_type_names{{
+static constexpr std::array<const char *, 33> mav_type_names{{
 /*  0 */ "GENERIC",                       // Generic micro air vehicle.
 /*  1 */ "FIXED_WING",                    // Fixed wing aircraft.
 /*  2 */ "QUADROTOR",                     // Quadrotor
@@ -250,7 +251,7 @@ std::string to_name(MAV_TYPE e)
 
 	return mav_type_names[idx];
 }
-// [[[end]]] (checksum: 6accf424d6136b55b15efbb86bb0c5cd)
+// [[[end]]] (checksum: ce3c2b2d219cdf0786fdf911e52d4451)
 
 // [[[cog:
 // ename = 'MAV_STATE'
@@ -267,7 +268,7 @@ std::string to_name(MAV_TYPE e)
 // to_string_outl(ename)
 // ]]]
 //! MAV_STATE values
-static const std::array<const std::string, 9> mav_state_strings{{
+static constexpr std::array<const char *, 9> mav_state_strings{{
 /*  0 */ "Uninit",                        // Uninitialized system, state is unknown.
 /*  1 */ "Boot",                          // System is booting up.
 /*  2 */ "Calibrating",                   // System is calibrating and not flight-ready.
@@ -287,11 +288,11 @@ std::string to_string(MAV_STATE e)
 
 	return mav_state_strings[idx];
 }
-// [[[end]]] (checksum: 8af1e6916d0229c193aab7d3dc2c97e9)
+// [[[end]]] (checksum: 44d0d45d8fc876f4f5f39358ebd44d28)
 
 // [[[cog:
 // ename = "timesync_mode"
-// ent = [ "NONE", "MAVLINK", "ONBOARD", "PASSTHROUGH", ]
+// ent = [ "NONE", "MAVLINK", "ONBOARD", "PASSTHROUGH", "MAVLINK_RX", ]
 //
 // array_outl(ename, ent)
 // for k, e in enumerate(ent):
@@ -302,11 +303,12 @@ std::string to_string(MAV_STATE e)
 // to_string_outl(ename)
 // ]]]
 //! timesync_mode values
-static const std::array<const std::string, 4> timesync_mode_strings{{
+static constexpr std::array<const char *, 5> timesync_mode_strings{{
 /*  0 */ "NONE",
 /*  1 */ "MAVLINK",
 /*  2 */ "ONBOARD",
 /*  3 */ "PASSTHROUGH",
+/*  4 */ "MAVLINK_RX",
 }};
 
 std::string to_string(timesync_mode e)
@@ -317,7 +319,7 @@ std::string to_string(timesync_mode e)
 
 	return timesync_mode_strings[idx];
 }
-// [[[end]]] (checksum: 2796eaa4f9361c2d7ca87f63e0401d4d)
+// [[[end]]] (checksum: b7ccaba0b49b1b9b45cb27becbcf3b45)
 
 timesync_mode timesync_mode_from_str(const std::string &mode)
 {
@@ -337,7 +339,7 @@ timesync_mode timesync_mode_from_str(const std::string &mode)
 // enum_name_is_value_outl(ename)
 // ]]]
 //! ADSB_ALTITUDE_TYPE values
-static const std::array<const std::string, 2> adsb_altitude_type_strings{{
+static constexpr std::array<const char *, 2> adsb_altitude_type_strings{{
 /*  0 */ "PRESSURE_QNH",                  // Altitude reported from a Baro source using QNH reference
 /*  1 */ "GEOMETRIC",                     // Altitude reported from a GNSS source
 }};
@@ -350,14 +352,14 @@ std::string to_string(ADSB_ALTITUDE_TYPE e)
 
 	return adsb_altitude_type_strings[idx];
 }
-// [[[end]]] (checksum: dc127bf29aefa513471d13c5a0e1e6ec)
+// [[[end]]] (checksum: 9eb6307c9dab2627007d6fd856feed83)
 
 // [[[cog:
 // ename = 'ADSB_EMITTER_TYPE'
 // enum_name_is_value_outl(ename)
 // ]]]
 //! ADSB_EMITTER_TYPE values
-static const std::array<const std::string, 20> adsb_emitter_type_strings{{
+static constexpr std::array<const char *, 20> adsb_emitter_type_strings{{
 /*  0 */ "NO_INFO",
 /*  1 */ "LIGHT",
 /*  2 */ "SMALL",
@@ -388,14 +390,14 @@ std::string to_string(ADSB_EMITTER_TYPE e)
 
 	return adsb_emitter_type_strings[idx];
 }
-// [[[end]]] (checksum: 713e0304603321e421131d8552d0f8e0)
+// [[[end]]] (checksum: 6acc9d979c5da8f9dd3facca2a09ca55)
 
 // [[[cog:
 // ename = 'MAV_ESTIMATOR_TYPE'
 // enum_name_is_value_outl(ename)
 // ]]]
 //! MAV_ESTIMATOR_TYPE values
-static const std::array<const std::string, 5> mav_estimator_type_strings{{
+static constexpr std::array<const char *, 5> mav_estimator_type_strings{{
 /*  1 */ "NAIVE",                         // This is a naive estimator without any real covariance feedback.
 /*  2 */ "VISION",                        // Computer vision based estimate. Might be up to scale.
 /*  3 */ "VIO",                           // Visual-inertial estimate.
@@ -411,14 +413,14 @@ std::string to_string(MAV_ESTIMATOR_TYPE e)
 
 	return mav_estimator_type_strings[idx];
 }
-// [[[end]]] (checksum: 47674f004bf6c515fdf999987b99e806)
+// [[[end]]] (checksum: faefe2c7bf87fe9836c228922bcb7a18)
 
 // [[[cog:
 // ename = 'GPS_FIX_TYPE'
 // enum_name_is_value_outl(ename)
 // ]]]
 //! GPS_FIX_TYPE values
-static const std::array<const std::string, 9> gps_fix_type_strings{{
+static constexpr std::array<const char *, 9> gps_fix_type_strings{{
 /*  0 */ "NO_GPS",                        // No GPS connected
 /*  1 */ "NO_FIX",                        // No position information, GPS is connected
 /*  2 */ "2D_FIX",                        // 2D position
@@ -438,7 +440,7 @@ std::string to_string(GPS_FIX_TYPE e)
 
 	return gps_fix_type_strings[idx];
 }
-// [[[end]]] (checksum: 7569b73b2d68ed1412bf0c36afeb131c)
+// [[[end]]] (checksum: 8b71c14b3cb2324ed4893acb146b61b2)
 
 // [[[cog:
 // ename = 'MAV_MISSION_RESULT'
@@ -455,7 +457,7 @@ std::string to_string(GPS_FIX_TYPE e)
 // to_string_outl(ename)
 // ]]]
 //! MAV_MISSION_RESULT values
-static const std::array<const std::string, 16> mav_mission_result_strings{{
+static constexpr std::array<const char *, 16> mav_mission_result_strings{{
 /*  0 */ "mission accepted OK",           // mission accepted OK
 /*  1 */ "Generic error / not accepting mission commands at all right now.", // Generic error / not accepting mission commands at all right now.
 /*  2 */ "Coordinate frame is not supported.", // Coordinate frame is not supported.
@@ -482,14 +484,14 @@ std::string to_string(MAV_MISSION_RESULT e)
 
 	return mav_mission_result_strings[idx];
 }
-// [[[end]]] (checksum: d42db24957df1950d06edbf9480dde46)
+// [[[end]]] (checksum: 8d2d6ad69c28d832fa40a5ead1f8e765)
 
 // [[[cog:
 // ename = 'MAV_FRAME'
 // enum_name_is_value_outl(ename)
 // ]]]
 //! MAV_FRAME values
-static const std::array<const std::string, 20> mav_frame_strings{{
+static constexpr std::array<const char *, 20> mav_frame_strings{{
 /*  0 */ "GLOBAL",                        // Global (WGS84) coordinate frame + MSL altitude. First value / x: latitude, second value / y: longitude, third value / z: positive altitude over mean sea level (MSL).
 /*  1 */ "LOCAL_NED",                     // Local coordinate frame, Z-down (x: north, y: east, z: down).
 /*  2 */ "MISSION",                       // NOT a coordinate frame, indicates a mission command.
@@ -520,14 +522,14 @@ std::string to_string(MAV_FRAME e)
 
 	return mav_frame_strings[idx];
 }
-// [[[end]]] (checksum: a075e35372e9be53a3a0ce79e45236c1)
+// [[[end]]] (checksum: f47122e051a0f3157bb7176d0a0e6c91)
 
 // [[[cog:
 // ename = 'MAV_COMPONENT'
 // suffix = 'MAV_COMP_ID'
 // enum = get_enum(ename)
 //
-// cog.outl(f"static const std::unordered_map<size_t, const std::string> {suffix.lower()}_strings{{{{")
+// cog.outl(f"static constexpr std::array<std::pair<size_t, const char *>, {len(enum)}> {suffix.lower()}_strings{{{{")
 // for k, e in enum:
 //     name_short =  e.name[len(suffix) + 1:]
 //     sp = make_whitespace(30, name_short)
@@ -538,7 +540,7 @@ std::string to_string(MAV_FRAME e)
 //
 // cog.outl("}};")
 // ]]]
-static const std::unordered_map<size_t, const std::string> mav_comp_id_strings{{
+static constexpr std::array<std::pair<size_t, const char *>, 41> mav_comp_id_strings{{
 {   0, "ALL" },                           // Used to broadcast messages to all components of the receiving system. Components should attempt to process messages with this component ID and forward to components on any other interfaces.
 {   1, "AUTOPILOT1" },                    // System flight controller component ("autopilot"). Only one autopilot is expected in a particular system.
 { 100, "CAMERA" },                        // Camera #1.
@@ -581,14 +583,16 @@ static const std::unordered_map<size_t, const std::string> mav_comp_id_strings{{
 { 241, "UART_BRIDGE" },                   // Component to bridge to UART (i.e. from UDP).
 { 250, "SYSTEM_CONTROL" },                // Component for handling system messages (e.g. to ARM, takeoff, etc.).
 }};
-// [[[end]]] (checksum: 794ea890a87beb831d74eb2920000ea9)
+// [[[end]]] (checksum: 02176901b56dd53162ce79acaf73e67e)
 
 std::string to_string(MAV_COMPONENT e)
 {
 	size_t idx = enum_value(e);
-	auto it = mav_comp_id_strings.find(idx);
+	// table is sorted by id
+	auto it = std::lower_bound(mav_comp_id_strings.begin(), mav_comp_id_strings.end(), idx,
+			[](const std::pair<size_t, const char *> &a, size_t b) { return a.first < b; });
 
-	if (it == mav_comp_id_strings.end())
+	if (it == mav_comp_id_strings.end() || it->first != idx)
 		return std::to_string(idx);
 
 	return it->second;
@@ -624,7 +628,7 @@ MAV_TYPE mav_type_from_str(const std::string &mav_type)
 // enum_name_is_value_outl(ename)
 // ]]]
 //! MAV_DISTANCE_SENSOR values
-static const std::array<const std::string, 5> mav_distance_sensor_strings{{
+static constexpr std::array<const char *, 5> mav_distance_sensor_strings{{
 /*  0 */ "LASER",                         // Laser rangefinder, e.g. LightWare SF02/F or PulsedLight units
 /*  1 */ "ULTRASOUND",                    // Ultrasound rangefinder, e.g. MaxBotix units
 /*  2 */ "INFRARED",                      // Infrared rangefinder, e.g. Sharp units
@@ -640,14 +644,14 @@ std::string to_string(MAV_DISTANCE_SENSOR e)
 
 	return mav_distance_sensor_strings[idx];
 }
-// [[[end]]] (checksum: 3f792ad01cdb3f2315a8907f578ab5b3)
+// [[[end]]] (checksum: 0b4c6f21aa767d498b5995b038758631)
 
 // [[[cog:
 // ename = 'LANDING_TARGET_TYPE'
 // enum_name_is_value_outl(ename)
 // ]]]
 //! LANDING_TARGET_TYPE values
-static const std::array<const std::string, 4> landing_target_type_strings{{
+static constexpr std::array<const char *, 4> landing_target_type_strings{{
 /*  0 */ "LIGHT_BEACON",                  // Landing target signaled by light beacon (ex: IR-LOCK)
 /*  1 */ "RADIO_BEACON",                  // Landing target signaled by radio beacon (ex: ILS, NDB)
 /*  2 */ "VISION_FIDUCIAL",               // Landing target represented by a fiducial marker (ex: ARTag)
@@ -662,7 +666,7 @@ std::string to_string(LANDING_TARGET_TYPE e)
 
 	return landing_target_type_strings[idx];
 }
-// [[[end]]] (checksum: a42789c10cbebd5bc253abca2a07289b)
+// [[[end]]] (checksum: 5ca0afbd392661a69306c864d6faf49e)
 
 LANDING_TARGET_TYPE landing_target_type_from_str(const std::string &landing_target_type)
 {
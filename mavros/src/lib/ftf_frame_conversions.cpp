@@ -118,7 +118,7 @@ Covariance3d transform_static_frame(const Covariance3d &cov, const StaticTF tran
 
 	case StaticTF::AIRCRAFT_TO_BASELINK:
 	case StaticTF::BASELINK_TO_AIRCRAFT:
-		cov_out = cov_in * AIRCRAFT_BASELINK_Q;
+		cov_out = AIRCRAFT_BASELINK_R * cov_in * AIRCRAFT_BASELINK_R.transpose();
 		return cov_out_;
 	}
 	return {};
@@ -279,6 +279,131 @@ Covariance9d transform_frame(const Covariance9d &cov, const Eigen::Quaterniond &
 	return cov_out_;
 }
 
+/* -*- batch transforms -*- */
+
+/**
+ * @brief Static rotation as axis permutation with signs: out[i] = sign[i] * in[index[i]]
+ */
+struct SignedPermutation {
+	int index[3];
+	double sign[3];
+};
+
+static constexpr SignedPermutation NED_ENU_SP {{1, 0, 2}, {1.0, 1.0, -1.0}};
+static constexpr SignedPermutation AIRCRAFT_BASELINK_SP {{0, 1, 2}, {1.0, -1.0, -1.0}};
+
+static constexpr const SignedPermutation &static_permutation(const StaticTF transform)
+{
+	return (transform == StaticTF::NED_TO_ENU || transform == StaticTF::ENU_TO_NED) ?
+	       NED_ENU_SP : AIRCRAFT_BASELINK_SP;
+}
+
+//! Covariance of N-D state made of 3-D blocks, each rotated by P
+template<int N, class Batch>
+static Batch permute_covariance(const Batch &cov, const SignedPermutation &P)
+{
+	Batch out(cov.rows(), N * N);
+
+	for (int i = 0; i < N; i++) {
+		int pi = (i / 3) * 3 + P.index[i % 3];
+		for (int j = 0; j < N; j++) {
+			int pj = (j / 3) * 3 + P.index[j % 3];
+			double sign = P.sign[i % 3] * P.sign[j % 3];
+
+			out.col(i * N + j) = sign * cov.col(pi * N + pj);
+		}
+	}
+
+	return out;
+}
+
+//! R * cov * R^T for block-diagonal R made of 3x3 @a R
+template<int N, class Batch>
+static Batch rotate_covariance(const Batch &cov, const Eigen::Matrix3d &R)
+{
+	Batch tmp(cov.rows(), N * N), out(cov.rows(), N * N);
+
+	// tmp = cov * R^T
+	for (int i = 0; i < N; i++) {
+		for (int j = 0; j < N; j++) {
+			int b = (j / 3) * 3, r = j % 3;
+			tmp.col(i * N + j) = R(r, 0) * cov.col(i * N + b) +
+			                     R(r, 1) * cov.col(i * N + b + 1) +
+			                     R(r, 2) * cov.col(i * N + b + 2);
+		}
+	}
+
+	// out = R * tmp
+	for (int i = 0; i < N; i++) {
+		int b = (i / 3) * 3, r = i % 3;
+		for (int j = 0; j < N; j++) {
+			out.col(i * N + j) = R(r, 0) * tmp.col(b * N + j) +
+			                     R(r, 1) * tmp.col((b + 1) * N + j) +
+			                     R(r, 2) * tmp.col((b + 2) * N + j);
+		}
+	}
+
+	return out;
+}
+
+Vector3dBatch transform_static_frame(const Vector3dBatch &vecs, const StaticTF transform)
+{
+	Vector3dBatch out(vecs.rows(), 3);
+	transform_static_frame(vecs, out, transform);
+	return out;
+}
+
+void transform_static_frame(const Vector3dBatch &vecs, Vector3dBatch &out, const StaticTF transform)
+{
+	auto &P = static_permutation(transform);
+
+	// no-op when size is the same
+	out.resize(vecs.rows(), 3);
+	for (int i = 0; i < 3; i++)
+		out.col(i) = P.sign[i] * vecs.col(P.index[i]);
+}
+
+Covariance3dBatch transform_static_frame(const Covariance3dBatch &cov, const StaticTF transform)
+{
+	return permute_covariance<3>(cov, static_permutation(transform));
+}
+
+Covariance6dBatch transform_static_frame(const Covariance6dBatch &cov, const StaticTF transform)
+{
+	return permute_covariance<6>(cov, static_permutation(transform));
+}
+
+Covariance9dBatch transform_static_frame(const Covariance9dBatch &cov, const StaticTF transform)
+{
+	return permute_covariance<9>(cov, static_permutation(transform));
+}
+
+Vector3dBatch transform_frame(const Vector3dBatch &vecs, const Eigen::Quaterniond &q)
+{
+	Eigen::Matrix3d R = q.normalized().toRotationMatrix();
+	Vector3dBatch out(vecs.rows(), 3);
+
+	for (int i = 0; i < 3; i++)
+		out.col(i) = R(i, 0) * vecs.col(0) + R(i, 1) * vecs.col(1) + R(i, 2) * vecs.col(2);
+
+	return out;
+}
+
+Covariance3dBatch transform_frame(const Covariance3dBatch &cov, const Eigen::Quaterniond &q)
+{
+	return rotate_covariance<3>(cov, q.normalized().toRotationMatrix());
+}
+
+Covariance6dBatch transform_frame(const Covariance6dBatch &cov, const Eigen::Quaterniond &q)
+{
+	return rotate_covariance<6>(cov, q.normalized().toRotationMatrix());
+}
+
+Covariance9dBatch transform_frame(const Covariance9dBatch &cov, const Eigen::Quaterniond &q)
+{
+	return rotate_covariance<9>(cov, q.normalized().toRotationMatrix());
+}
+
 }	// namespace detail
 }	// namespace ftf
 }	// namespace mavros
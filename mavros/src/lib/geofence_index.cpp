@@ -0,0 +1,343 @@
+/**
+ * @brief Geofence zones with fast point containment
+ * @file geofence_index.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <mavros/geofence_index.h>
+
+using namespace mavros;
+using Eigen::Vector2d;
+
+constexpr size_t GeofenceIndex::MAX_GRID;
+
+//! WGS-84 semi-major axis [m] and first eccentricity squared
+static constexpr double WGS84_A = 6378137.0;
+static constexpr double WGS84_E2 = 6.69437999014e-3;
+
+//! Reference point of cell, off center so it does not fall on round coordinates of edges
+static constexpr double REF_FX = 0.5123;
+static constexpr double REF_FY = 0.4871;
+
+static inline double orient(const Vector2d &a, const Vector2d &b, const Vector2d &c)
+{
+	return (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+}
+
+/**
+ * Segment r-p crosses edge a-b.
+ * Zero orientation is taken as negative in both tests, so a vertex
+ * lying on r-p is counted by exactly one of its edges or by none.
+ */
+static inline bool crosses(const Vector2d &r, const Vector2d &p, const Vector2d &a, const Vector2d &b)
+{
+	return ((orient(a, b, r) > 0) != (orient(a, b, p) > 0)) &&
+	       ((orient(r, p, a) > 0) != (orient(r, p, b) > 0));
+}
+
+static Vector2d nearest_on_segment(const Vector2d &a, const Vector2d &b, const Vector2d &p)
+{
+	Vector2d ab = b - a;
+	double len2 = ab.squaredNorm();
+	if (len2 <= 0.0)
+		return a;
+
+	double t = std::min(std::max((p - a).dot(ab) / len2, 0.0), 1.0);
+	return a + t * ab;
+}
+
+GeofenceIndex::Zone GeofenceIndex::polygon(bool inclusion, std::vector<Vector2d> vertices)
+{
+	// closed ring is stored without repeated first vertex
+	if (vertices.size() > 1 && vertices.front() == vertices.back())
+		vertices.pop_back();
+
+	return Zone{inclusion, std::move(vertices), Vector2d::Zero(), 0.0};
+}
+
+GeofenceIndex::Zone GeofenceIndex::circle(bool inclusion, const Vector2d &center, double radius)
+{
+	return Zone{inclusion, {}, center, radius};
+}
+
+GeofenceIndex::GeofenceIndex(std::vector<Zone> zones_, const Options &opts_, const Origin &origin_) :
+	opts(opts_),
+	origin(origin_),
+	zones(std::move(zones_)),
+	grids(zones.size()),
+	have_inclusion(false)
+{
+	for (size_t i = 0; i < zones.size(); i++) {
+		auto &z = zones[i];
+		have_inclusion |= z.inclusion;
+
+		if (z.vertices.empty()) {
+			if (!(z.radius > 0.0))
+				throw std::invalid_argument("geofence: circle radius must be positive");
+		}
+		else if (z.vertices.size() < 3)
+			throw std::invalid_argument("geofence: polygon needs at least 3 vertices");
+		else
+			build_grid(z, grids[i]);
+	}
+}
+
+Vector2d GeofenceIndex::cell_ref(const Grid &g, size_t cx, size_t cy) const
+{
+	return Vector2d(g.min.x() + (cx + REF_FX) * g.cell.x(),
+			g.min.y() + (cy + REF_FY) * g.cell.y());
+}
+
+void GeofenceIndex::build_grid(const Zone &zone, Grid &g)
+{
+	auto &v = zone.vertices;
+	const size_t n = v.size();
+
+	g.min = g.max = v[0];
+	for (auto &p : v) {
+		g.min = g.min.cwiseMin(p);
+		g.max = g.max.cwiseMax(p);
+	}
+
+	// about four cells per edge, square cells
+	Vector2d extent = (g.max - g.min).cwiseMax(Vector2d::Constant(1e-6));
+	double target = std::min<double>(4 * n, MAX_GRID * MAX_GRID);
+	double side = std::sqrt(extent.x() * extent.y() / target);
+	g.nx = std::min<size_t>(std::max<size_t>(std::ceil(extent.x() / side), 1), MAX_GRID);
+	g.ny = std::min<size_t>(std::max<size_t>(std::ceil(extent.y() / side), 1), MAX_GRID);
+	g.cell = Vector2d(extent.x() / g.nx, extent.y() / g.ny);
+	g.inv_cell = g.cell.cwiseInverse();
+
+	const size_t ncells = g.nx * g.ny;
+	// query point may be off its cell by rounding, so cells are tested a bit bigger
+	const Vector2d eps = extent * 1e-9;
+
+	auto for_cells = [&](size_t e, const std::function<void(size_t)> &fn) {
+				 auto &a = v[e];
+				 auto &b = v[(e + 1) % n];
+				 Vector2d lo = a.cwiseMin(b) - g.min, hi = a.cwiseMax(b) - g.min;
+				 size_t x0 = std::min<size_t>(std::max(lo.x() * g.inv_cell.x() - 1e-6, 0.0), g.nx - 1);
+				 size_t x1 = std::min<size_t>(std::max(hi.x() * g.inv_cell.x() + 1e-6, 0.0), g.nx - 1);
+				 size_t y0 = std::min<size_t>(std::max(lo.y() * g.inv_cell.y() - 1e-6, 0.0), g.ny - 1);
+				 size_t y1 = std::min<size_t>(std::max(hi.y() * g.inv_cell.y() + 1e-6, 0.0), g.ny - 1);
+
+				 for (size_t cy = y0; cy <= y1; cy++) {
+					 for (size_t cx = x0; cx <= x1; cx++) {
+						 Vector2d c0 = g.min + Vector2d(cx * g.cell.x(), cy * g.cell.y()) - eps;
+						 Vector2d c1 = c0 + g.cell + 2 * eps;
+
+						 // edge line leaves all corners on one side: no intersection
+						 double s0 = orient(a, b, c0), s1 = orient(a, b, Vector2d(c1.x(), c0.y())),
+							s2 = orient(a, b, c1), s3 = orient(a, b, Vector2d(c0.x(), c1.y()));
+						 if ((s0 > 0 && s1 > 0 && s2 > 0 && s3 > 0) || (s0 < 0 && s1 < 0 && s2 < 0 && s3 < 0))
+							 continue;
+
+						 fn(cy * g.nx + cx);
+					 }
+				 }
+			 };
+
+	// counting pass, then fill
+	g.cell_start.assign(ncells + 1, 0);
+	for (size_t e = 0; e < n; e++)
+		for_cells(e, [&](size_t c) { g.cell_start[c + 1]++; });
+
+	for (size_t c = 0; c < ncells; c++)
+		g.cell_start[c + 1] += g.cell_start[c];
+
+	std::vector<uint32_t> fill(g.cell_start.begin(), g.cell_start.end() - 1);
+	g.edge_ids.resize(g.cell_start.back());
+	for (size_t e = 0; e < n; e++)
+		for_cells(e, [&](size_t c) { g.edge_ids[fill[c]++] = e; });
+
+	// reference points by full crossing test
+	g.ref_inside.resize(ncells);
+	for (size_t cy = 0; cy < g.ny; cy++) {
+		for (size_t cx = 0; cx < g.nx; cx++) {
+			Vector2d r = cell_ref(g, cx, cy);
+			bool inside = false;
+			for (size_t i = 0, j = n - 1; i < n; j = i++) {
+				if (((v[i].y() > r.y()) != (v[j].y() > r.y())) &&
+						(r.x() < (v[j].x() - v[i].x()) * (r.y() - v[i].y()) / (v[j].y() - v[i].y()) + v[i].x()))
+					inside = !inside;
+			}
+
+			g.ref_inside[cy * g.nx + cx] = inside;
+		}
+	}
+}
+
+bool GeofenceIndex::zone_contains(size_t idx, const Vector2d &p) const
+{
+	auto &z = zones[idx];
+	if (z.vertices.empty())
+		return (p - z.center).squaredNorm() <= z.radius * z.radius;
+
+	auto &g = grids[idx];
+	if (p.x() < g.min.x() || p.y() < g.min.y() || p.x() > g.max.x() || p.y() > g.max.y())
+		return false;
+
+	size_t cx = std::min<size_t>((p.x() - g.min.x()) * g.inv_cell.x(), g.nx - 1);
+	size_t cy = std::min<size_t>((p.y() - g.min.y()) * g.inv_cell.y(), g.ny - 1);
+	size_t c = cy * g.nx + cx;
+
+	// parity of crossings on the way from reference point, which stays in the cell
+	Vector2d r = cell_ref(g, cx, cy);
+	bool inside = g.ref_inside[c];
+	const size_t n = z.vertices.size();
+	for (size_t k = g.cell_start[c]; k < g.cell_start[c + 1]; k++) {
+		size_t e = g.edge_ids[k];
+		if (crosses(r, p, z.vertices[e], z.vertices[(e + 1) % n]))
+			inside = !inside;
+	}
+
+	return inside;
+}
+
+int GeofenceIndex::check(const Vector2d &p) const
+{
+	int first_inclusion = -1;
+	bool in_inclusion = false;
+
+	for (size_t i = 0; i < zones.size(); i++) {
+		bool inside = zone_contains(i, p);
+
+		if (!zones[i].inclusion) {
+			if (inside)
+				return i;
+			continue;
+		}
+
+		if (first_inclusion < 0)
+			first_inclusion = i;
+
+		if (inside)
+			in_inclusion = true;
+		else if (!opts.any_inclusion)
+			return i;
+	}
+
+	if (have_inclusion && !in_inclusion)
+		return first_inclusion;
+
+	return -1;
+}
+
+Vector2d GeofenceIndex::nearest_allowed(size_t idx, const Vector2d &p) const
+{
+	auto &z = zones[idx];
+
+	if (z.vertices.empty()) {
+		Vector2d d = p - z.center;
+		double len = d.norm();
+		Vector2d dir = (len > 1e-9) ? Vector2d(d / len) : Vector2d::UnitX();
+		double r = (z.inclusion) ? std::max(z.radius - opts.margin, 0.0) : z.radius + opts.margin;
+		return z.center + dir * r;
+	}
+
+	const size_t n = z.vertices.size();
+	double best = std::numeric_limits<double>::infinity();
+	Vector2d q = p;
+	size_t best_edge = 0;
+	double area2 = 0.0;
+
+	for (size_t i = 0; i < n; i++) {
+		auto &a = z.vertices[i];
+		auto &b = z.vertices[(i + 1) % n];
+		area2 += a.x() * b.y() - b.x() * a.y();
+
+		Vector2d c = nearest_on_segment(a, b, p);
+		double d = (c - p).squaredNorm();
+		if (d < best) {
+			best = d;
+			q = c;
+			best_edge = i;
+		}
+	}
+
+	// crossing boundary goes on from p to q, point on boundary uses edge normal
+	Vector2d dir = q - p;
+	if (dir.norm() < 1e-9) {
+		Vector2d e = z.vertices[(best_edge + 1) % n] - z.vertices[best_edge];
+		Vector2d inward = (area2 > 0) ? Vector2d(-e.y(), e.x()) : Vector2d(e.y(), -e.x());
+		dir = (z.inclusion) ? inward : Vector2d(-inward);
+	}
+
+	return q + dir.normalized() * opts.margin;
+}
+
+bool GeofenceIndex::clamp(Vector2d &p) const
+{
+	Vector2d q = p;
+
+	// moving out of one zone may enter other one, few steps are enough for sane fences
+	for (int step = 0; step < 4; step++) {
+		int idx = check(q);
+		if (idx < 0) {
+			p = q;
+			return true;
+		}
+
+		if (zones[idx].inclusion && opts.any_inclusion) {
+			// nearest of all keep-in zones
+			double best = std::numeric_limits<double>::infinity();
+			Vector2d next = q;
+			for (size_t i = 0; i < zones.size(); i++) {
+				if (!zones[i].inclusion)
+					continue;
+
+				Vector2d c = nearest_allowed(i, q);
+				double d = (c - q).squaredNorm();
+				if (d < best) {
+					best = d;
+					next = c;
+				}
+			}
+
+			q = next;
+		}
+		else
+			q = nearest_allowed(idx, q);
+	}
+
+	return false;
+}
+
+Vector2d GeofenceIndex::to_local(const Origin &origin, double latitude, double longitude)
+{
+	double phi = origin.latitude * M_PI / 180.0;
+	double s = std::sin(phi);
+	double w = 1.0 - WGS84_E2 * s * s;
+	double N = WGS84_A / std::sqrt(w);		// prime vertical radius
+	double M = WGS84_A * (1.0 - WGS84_E2) / (w * std::sqrt(w));	// meridian radius
+
+	double dlat = (latitude - origin.latitude) * M_PI / 180.0;
+	double dlon = std::remainder(longitude - origin.longitude, 360.0) * M_PI / 180.0;
+
+	return origin.local + Vector2d(dlon * N * std::cos(phi), dlat * M);
+}
+
+void GeofenceIndex::to_global(const Origin &origin, const Vector2d &p, double &latitude, double &longitude)
+{
+	double phi = origin.latitude * M_PI / 180.0;
+	double s = std::sin(phi);
+	double w = 1.0 - WGS84_E2 * s * s;
+	double N = WGS84_A / std::sqrt(w);
+	double M = WGS84_A * (1.0 - WGS84_E2) / (w * std::sqrt(w));
+
+	Vector2d d = p - origin.local;
+	latitude = origin.latitude + d.y() / M * 180.0 / M_PI;
+	longitude = std::remainder(origin.longitude + d.x() / (N * std::cos(phi)) * 180.0 / M_PI, 360.0);
+}
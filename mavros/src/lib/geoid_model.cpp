@@ -0,0 +1,261 @@
+/**
+ * @brief Geoid height models
+ * @file geoid_model.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <mavros/geoid_model.h>
+
+#include <GeographicLib/Geoid.hpp>
+
+using namespace mavros;
+
+namespace {
+/**
+ * GeographicLib::Geoid with whole dataset in RAM
+ */
+class GeographicLibGeoid : public GeoidModel {
+public:
+	GeographicLibGeoid(const std::string &name, const std::string &path) :
+		// cubic interpolation, thread safe
+		geoid(name, path, true, true)
+	{ }
+
+	double operator()(double lat, double lon) const override {
+		return geoid(lat, lon);
+	}
+
+private:
+	GeographicLib::Geoid geoid;
+};
+}	// namespace
+
+GeoidModel::Ptr GeoidModel::open(const std::string &backend, const std::string &name, const std::string &path)
+{
+	if (backend == "memory")
+		return std::make_shared<GeographicLibGeoid>(name, path);
+
+	if (backend == "mmap") {
+		auto dir = path.empty() ? GeographicLib::Geoid::DefaultGeoidPath() : path;
+		return std::make_shared<MappedGeoid>(dir + "/" + name + ".pgm");
+	}
+
+	throw std::invalid_argument("unknown geoid backend: " + backend);
+}
+
+MappedGeoid::MappedGeoid(const std::string &filename) :
+	map(nullptr),
+	map_size(0),
+	data(nullptr),
+	width(0),
+	height(0),
+	offset(NAN),
+	scale(NAN),
+	lonres(0),
+	latres(0)
+{
+	int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw std::runtime_error("geoid: " + filename + ": " + std::strerror(errno));
+
+	struct stat st;
+	void *m = MAP_FAILED;
+	if (::fstat(fd, &st) == 0 && st.st_size > 0)
+		m = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+	int err = errno;
+	::close(fd);
+	if (m == MAP_FAILED)
+		throw std::runtime_error("geoid: " + filename + ": mmap: " + std::strerror(err));
+
+	map = static_cast<const uint8_t *>(m);
+	map_size = st.st_size;
+
+	// PGM header: P5, comments with Offset and Scale, width height, maxval
+	size_t pos = 0;
+	auto getline = [&]() {
+		auto begin = pos;
+		while (pos < map_size && map[pos] != '\n')
+			pos++;
+
+		std::string line(reinterpret_cast<const char *>(map + begin), pos - begin);
+		if (pos < map_size)
+			pos++;
+		return line;
+	};
+
+	std::string error;
+	std::string line = getline();
+	if (line != "P5")
+		error = "not a PGM file";
+
+	while (error.empty() && pos < map_size) {
+		line = getline();
+		if (line.empty() || line[0] != '#')
+			break;
+
+		std::istringstream is(line.substr(1));
+		std::string key;
+		is >> key;
+		if (key == "Offset")
+			is >> offset;
+		else if (key == "Scale")
+			is >> scale;
+	}
+
+	if (error.empty()) {
+		int maxval = 0;
+		std::istringstream(line) >> width >> height;
+		std::istringstream(getline()) >> maxval;
+
+		data = map + pos;
+		if (width <= 0 || height < 2 || maxval != 65535)
+			error = "bad PGM header";
+		else if (!std::isfinite(offset) || !std::isfinite(scale))
+			error = "no Offset or Scale";
+		else if (map_size - pos < size_t(width) * height * 2)
+			error = "file truncated";
+	}
+
+	if (!error.empty()) {
+		::munmap(const_cast<uint8_t *>(map), map_size);
+		throw std::runtime_error("geoid: " + filename + ": " + error);
+	}
+
+	lonres = width / 360.0;
+	latres = (height - 1) / 180.0;
+}
+
+MappedGeoid::~MappedGeoid()
+{
+	::munmap(const_cast<uint8_t *>(map), map_size);
+}
+
+void MappedGeoid::cell(double lat, double lon, int &ix, int &iy, double &fx, double &fy) const
+{
+	// grid starts at north pole, lon 0, and goes east and south
+	lon = std::fmod(lon, 360.0);
+	if (lon < 0)
+		lon += 360.0;
+
+	fx = lon * lonres;
+	fy = (90.0 - lat) * latres;
+
+	ix = int(std::floor(fx));
+	fx -= ix;
+	if (ix >= width)
+		ix -= width;
+
+	iy = std::min(std::max(int(std::floor(fy)), 0), height - 2);
+	fy = std::min(std::max(fy - iy, 0.0), 1.0);
+}
+
+double MappedGeoid::operator()(double lat, double lon) const
+{
+	int ix, iy;
+	double fx, fy;
+	cell(lat, lon, ix, iy, fx, fy);
+
+	double v00, v01, v10, v11;
+	auto t = std::atomic_load(&tile);
+
+	int dx = t ? ix - t->ix0 : 0;
+	if (dx < 0)
+		dx += width;
+
+	if (t && dx + 1 < t->nx && iy >= t->iy0 && iy + 1 - t->iy0 < t->ny) {
+		auto p = &t->raw[size_t(iy - t->iy0) * t->nx + dx];
+		v00 = p[0];
+		v01 = p[1];
+		v10 = p[t->nx];
+		v11 = p[t->nx + 1];
+	}
+	else {
+		int ix1 = (ix + 1 < width) ? ix + 1 : 0;
+		v00 = rawval(ix, iy);
+		v01 = rawval(ix1, iy);
+		v10 = rawval(ix, iy + 1);
+		v11 = rawval(ix1, iy + 1);
+	}
+
+	double a = (1 - fx) * v00 + fx * v01;
+	double b = (1 - fx) * v10 + fx * v11;
+	return offset + scale * ((1 - fy) * a + fy * b);
+}
+
+void MappedGeoid::cache_tile(double lat, double lon, double radius)
+{
+	int ix, iy;
+	double fx, fy;
+	cell(lat, lon, ix, iy, fx, fy);
+
+	int rx = int(std::ceil(std::max(radius, 0.0) * lonres)) + 1;
+	int ry = int(std::ceil(std::max(radius, 0.0) * latres)) + 1;
+
+	auto t = std::make_shared<Tile>();
+	t->iy0 = std::max(iy - ry, 0);
+	t->ny = std::min(iy + 1 + ry, height - 1) - t->iy0 + 1;
+	t->nx = std::min(2 * rx + 2, width);
+	t->ix0 = ((ix - rx) % width + width) % width;
+
+	t->raw.resize(size_t(t->nx) * t->ny);
+	for (int y = 0; y < t->ny; y++)
+		for (int x = 0; x < t->nx; x++)
+			t->raw[size_t(y) * t->nx + x] = rawval((t->ix0 + x) % width, t->iy0 + y);
+
+	std::atomic_store(&tile, std::shared_ptr<const Tile>(std::move(t)));
+}
+
+CachedGeoid::CachedGeoid(GeoidModel::Ptr model_, double cell_size_) :
+	model(std::move(model_)),
+	cell_size(cell_size_),
+	cell(Cell {})
+{ }
+
+double CachedGeoid::operator()(double lat, double lon) const
+{
+	lon = std::fmod(lon, 360.0);
+	if (lon < 0)
+		lon += 360.0;
+
+	double fx = lon / cell_size;
+	double fy = lat / cell_size;
+	int ix = int(std::floor(fx));
+	int iy = int(std::floor(fy));
+	fx -= ix;
+	fy -= iy;
+
+	auto c = cell.load();
+	if (!c.valid || c.ix != ix || c.iy != iy) {
+		double lat0 = iy * cell_size, lon0 = ix * cell_size;
+		double lat1 = std::min(lat0 + cell_size, 90.0), lon1 = lon0 + cell_size;
+
+		c = Cell {
+			true, ix, iy,
+			(*model)(lat0, lon0), (*model)(lat0, lon1),
+			(*model)(lat1, lon0), (*model)(lat1, lon1)
+		};
+		cell.store(c);
+	}
+
+	double a = (1 - fx) * c.h00 + fx * c.h01;
+	double b = (1 - fx) * c.h10 + fx * c.h11;
+	return (1 - fy) * a + fy * b;
+}
@@ -0,0 +1,97 @@
+/**
+ * @brief Handler execution time profile
+ * @file handler_profile.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <mavros/handler_profile.h>
+
+using namespace mavros;
+
+constexpr size_t HandlerProfile::SUB_BITS;
+constexpr size_t HandlerProfile::SUB;
+constexpr size_t HandlerProfile::MAX_MSB;
+constexpr size_t HandlerProfile::NBUCKETS;
+
+TickClock::TickClock() :
+	ref_ticks(now()),
+	ref_time(steady_clock::now())
+{ }
+
+double TickClock::ns_per_tick() const
+{
+	auto ticks = now() - ref_ticks;
+	std::chrono::duration<double, std::nano> elapsed = steady_clock::now() - ref_time;
+
+	// too short to tell tick length
+	if (ticks == 0 || elapsed.count() < 1e6)
+		return 1.0;
+
+	return elapsed.count() / ticks;
+}
+
+HandlerProfile::HandlerProfile() :
+	calls(0),
+	total(0),
+	max(0)
+{
+	for (auto &b : hist)
+		b.store(0, std::memory_order_relaxed);
+}
+
+uint64_t HandlerProfile::bucket_lower(size_t idx)
+{
+	if (idx < SUB)
+		return idx;
+
+	size_t msb = idx / SUB + SUB_BITS - 1;
+	return uint64_t(SUB + idx % SUB) << (msb - SUB_BITS);
+}
+
+HandlerProfile::Snapshot HandlerProfile::snapshot() const
+{
+	constexpr auto rlx = std::memory_order_relaxed;
+	Snapshot s;
+
+	s.calls = calls.load(rlx);
+	s.total = total.load(rlx);
+	s.max = max.load(rlx);
+	for (size_t i = 0; i < NBUCKETS; i++)
+		s.hist[i] = hist[i].load(rlx);
+
+	return s;
+}
+
+uint64_t HandlerProfile::Snapshot::percentile(double q) const
+{
+	// counters are read one by one, so sum of histogram may differ from calls
+	uint64_t count = 0;
+	for (auto b : hist)
+		count += b;
+
+	if (count == 0)
+		return 0;
+
+	uint64_t rank = uint64_t(q * count);
+	uint64_t seen = 0;
+	for (size_t i = 0; i < NBUCKETS; i++) {
+		seen += hist[i];
+		if (seen > rank) {
+			if (i + 1 == NBUCKETS)
+				return max;
+
+			// max is an upper bound for top bucket
+			return std::min<uint64_t>(bucket_lower(i + 1) - 1, max);
+		}
+	}
+
+	return max;
+}
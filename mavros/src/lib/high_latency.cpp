@@ -0,0 +1,365 @@
+/**
+ * @brief HIGH_LATENCY2 telemetry for low bandwidth GCS links
+ * @file high_latency.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mavros/high_latency.h>
+#include <mavros/utils.h>
+
+using namespace mavros;
+using mavlink::mavlink_message_t;
+using utils::enum_value;
+
+namespace msg = mavlink::common::msg;
+
+constexpr unsigned HighLatencyMode::MAX_BACKOFF;
+
+const std::vector<mavlink::msgid_t> HighLatencyMode::DEFAULT_PASS {
+	msg::COMMAND_ACK::MSG_ID,
+	// mission micro-protocol, both directions of transfer
+	msg::MISSION_COUNT::MSG_ID,
+	msg::MISSION_REQUEST::MSG_ID,
+	msg::MISSION_REQUEST_INT::MSG_ID,
+	msg::MISSION_ITEM::MSG_ID,
+	msg::MISSION_ITEM_INT::MSG_ID,
+	msg::MISSION_ACK::MSG_ID,
+};
+
+HighLatencyMode::HighLatencyMode(const Options &opts_) :
+	opts(opts_),
+	pass_sorted(opts_.pass_msgids),
+	active(opts_.mode == Mode::ON),
+	have_drops(false),
+	last_drops(0),
+	retrying(false),
+	backoff(1),
+	since{}
+{
+	std::sort(pass_sorted.begin(), pass_sorted.end());
+}
+
+bool HighLatencyMode::pass(mavlink::msgid_t msgid) const
+{
+	return msgid == msg::HIGH_LATENCY2::MSG_ID ||
+		std::binary_search(pass_sorted.begin(), pass_sorted.end(), msgid);
+}
+
+bool HighLatencyMode::set_active(bool value, clock::time_point now)
+{
+	if (active.load(std::memory_order_relaxed) == value)
+		return false;
+
+	active.store(value, std::memory_order_relaxed);
+	since = now;
+	return true;
+}
+
+bool HighLatencyMode::update(clock::time_point now, uint64_t tx_drops, float rtt_ms)
+{
+	bool drops = have_drops && tx_drops > last_drops;
+	have_drops = true;
+	last_drops = tx_drops;
+
+	if (opts.mode != Mode::AUTO)
+		return set_active(opts.mode == Mode::ON, now);
+
+	bool measured = rtt_ms > 0.0f;
+
+	if (!is_active()) {
+		if (drops || (measured && rtt_ms > opts.rtt_threshold_ms)) {
+			// link did not hold normal streams, wait longer next time
+			if (retrying)
+				backoff = std::min(backoff * 2, MAX_BACKOFF);
+
+			retrying = false;
+			return set_active(true, now);
+		}
+
+		if (retrying && now - since >= opts.hold) {
+			retrying = false;
+			backoff = 1;
+		}
+
+		return false;
+	}
+
+	if (now - since < opts.hold * backoff)
+		return false;
+
+	if (measured && rtt_ms >= opts.rtt_threshold_ms / 2)
+		return false;
+
+	retrying = true;
+	return set_active(false, now);
+}
+
+bool HighLatencyMode::parse_mode(const std::string &str, Mode &mode)
+{
+	if (str == "off")
+		mode = Mode::OFF;
+	else if (str == "on")
+		mode = Mode::ON;
+	else if (str == "auto")
+		mode = Mode::AUTO;
+	else
+		return false;
+
+	return true;
+}
+
+const char *HighLatencyMode::to_string(Mode mode)
+{
+	switch (mode) {
+	case Mode::OFF:		return "off";
+	case Mode::ON:		return "on";
+	case Mode::AUTO:	return "auto";
+	}
+
+	return "unknown";
+}
+
+/* -*- encoder -*- */
+
+template<typename T, typename V>
+static inline T clamp_to(V value)
+{
+	return static_cast<T>(std::min<V>(std::max<V>(value, std::numeric_limits<T>::min()),
+				std::numeric_limits<T>::max()));
+}
+
+//! degrees to HIGH_LATENCY2 heading, deg/2
+static inline uint8_t heading_hl(float deg)
+{
+	deg = std::fmod(deg, 360.0f);
+	if (deg < 0.0f)
+		deg += 360.0f;
+
+	return clamp_to<uint8_t>(std::lround(deg / 2));
+}
+
+//! SYS_STATUS sensor -> HL_FAILURE_FLAG bit
+static const struct {
+	mavlink::common::MAV_SYS_STATUS_SENSOR sensor;
+	uint16_t flag;
+} failure_map[] = {
+	{ mavlink::common::MAV_SYS_STATUS_SENSOR::GPS, 1 },
+	{ mavlink::common::MAV_SYS_STATUS_SENSOR::DIFFERENTIAL_PRESSURE, 2 },
+	{ mavlink::common::MAV_SYS_STATUS_SENSOR::ABSOLUTE_PRESSURE, 4 },
+	{ mavlink::common::MAV_SYS_STATUS_SENSOR::SENSOR_3D_ACCEL, 8 },
+	{ mavlink::common::MAV_SYS_STATUS_SENSOR::SENSOR_3D_GYRO, 16 },
+	{ mavlink::common::MAV_SYS_STATUS_SENSOR::SENSOR_3D_MAG, 32 },
+	{ mavlink::common::MAV_SYS_STATUS_SENSOR::TERRAIN, 64 },
+	{ mavlink::common::MAV_SYS_STATUS_SENSOR::BATTERY, 128 },
+	{ mavlink::common::MAV_SYS_STATUS_SENSOR::RC_RECEIVER, 256 },
+	{ mavlink::common::MAV_SYS_STATUS_SENSOR::GEOFENCE, 2048 },
+	{ mavlink::common::MAV_SYS_STATUS_SENSOR::AHRS, 4096 },
+};
+
+HighLatencyEncoder::Values HighLatencyEncoder::initial_values()
+{
+	Values v {};
+	v.battery = -1;
+	return v;
+}
+
+HighLatencyEncoder::HighLatencyEncoder() :
+	target_system(1),
+	target_component(1),
+	reset_pending(false),
+	last(initial_values()),
+	snapshot(initial_values())
+{ }
+
+void HighLatencyEncoder::set_target(uint8_t sysid, uint8_t compid)
+{
+	target_system.store(sysid, std::memory_order_relaxed);
+	target_component.store(compid, std::memory_order_relaxed);
+}
+
+void HighLatencyEncoder::update(const mavlink_message_t &mmsg)
+{
+	switch (mmsg.msgid) {
+	case msg::HEARTBEAT::MSG_ID:
+	case msg::GLOBAL_POSITION_INT::MSG_ID:
+	case msg::VFR_HUD::MSG_ID:
+	case msg::SYS_STATUS::MSG_ID:
+	case msg::GPS_RAW_INT::MSG_ID:
+	case msg::MISSION_CURRENT::MSG_ID:
+	case msg::NAV_CONTROLLER_OUTPUT::MSG_ID:
+	case msg::WIND_COV::MSG_ID:
+		break;
+	default:
+		return;
+	}
+
+	if (mmsg.sysid != target_system.load(std::memory_order_relaxed) ||
+			mmsg.compid != target_component.load(std::memory_order_relaxed))
+		return;
+
+	if (reset_pending.exchange(false, std::memory_order_acquire))
+		last = initial_values();
+
+	mavlink::MsgMap map(&mmsg);
+	auto &report = last;
+
+	switch (mmsg.msgid) {
+	case msg::HEARTBEAT::MSG_ID: {
+		msg::HEARTBEAT hb;
+		hb.deserialize(map);
+		report.type = hb.type;
+		report.autopilot = hb.autopilot;
+		report.custom_mode = hb.custom_mode;
+		report.heartbeat = true;
+		break;
+	}
+	case msg::GLOBAL_POSITION_INT::MSG_ID: {
+		msg::GLOBAL_POSITION_INT gp;
+		gp.deserialize(map);
+		report.timestamp = gp.time_boot_ms;
+		report.latitude = gp.lat;
+		report.longitude = gp.lon;
+		report.altitude = clamp_to<int16_t>(gp.alt / 1000);
+		break;
+	}
+	case msg::VFR_HUD::MSG_ID: {
+		msg::VFR_HUD hud;
+		hud.deserialize(map);
+		report.heading = heading_hl(hud.heading);
+		report.airspeed = clamp_to<uint8_t>(std::lround(hud.airspeed * 5));
+		report.groundspeed = clamp_to<uint8_t>(std::lround(hud.groundspeed * 5));
+		report.throttle = clamp_to<uint8_t>(hud.throttle);
+		report.climb_rate = clamp_to<int8_t>(std::lround(hud.climb * 10));
+		break;
+	}
+	case msg::SYS_STATUS::MSG_ID: {
+		msg::SYS_STATUS st;
+		st.deserialize(map);
+		report.battery = st.battery_remaining;
+
+		uint32_t failed = st.onboard_control_sensors_present & st.onboard_control_sensors_enabled
+			& ~st.onboard_control_sensors_health;
+		report.failure_flags = 0;
+		for (auto &f : failure_map) {
+			if (failed & enum_value(f.sensor))
+				report.failure_flags |= f.flag;
+		}
+		break;
+	}
+	case msg::GPS_RAW_INT::MSG_ID: {
+		msg::GPS_RAW_INT gps;
+		gps.deserialize(map);
+		// accuracy extension, mm -> dm; it is not sent by MAVLink 1 FCU
+		if (gps.h_acc > 0)
+			report.eph = clamp_to<uint8_t>(gps.h_acc / 100);
+		if (gps.v_acc > 0)
+			report.epv = clamp_to<uint8_t>(gps.v_acc / 100);
+		break;
+	}
+	case msg::MISSION_CURRENT::MSG_ID: {
+		msg::MISSION_CURRENT mc;
+		mc.deserialize(map);
+		report.wp_num = mc.seq;
+		break;
+	}
+	case msg::NAV_CONTROLLER_OUTPUT::MSG_ID: {
+		msg::NAV_CONTROLLER_OUTPUT nav;
+		nav.deserialize(map);
+		report.target_heading = heading_hl(nav.target_bearing);
+		report.target_distance = nav.wp_dist / 10;	// m -> dam
+		break;
+	}
+	case msg::WIND_COV::MSG_ID: {
+		msg::WIND_COV wind;
+		wind.deserialize(map);
+		if (std::isnan(wind.wind_x) || std::isnan(wind.wind_y))
+			break;
+
+		// NED, direction the air moves to
+		report.windspeed = clamp_to<uint8_t>(std::lround(std::hypot(wind.wind_x, wind.wind_y) * 5));
+		report.wind_heading = heading_hl(std::atan2(wind.wind_y, wind.wind_x) * 180.0f / M_PI);
+		break;
+	}
+	}
+
+	snapshot.store(last);
+}
+
+bool HighLatencyEncoder::ready()
+{
+	return snapshot.load().heartbeat;
+}
+
+void HighLatencyEncoder::reset()
+{
+	// Rx thread copy is cleared by update(), it is not touched here
+	reset_pending.store(true, std::memory_order_release);
+	snapshot.store(initial_values());
+}
+
+mavlink::common::msg::HIGH_LATENCY2 HighLatencyEncoder::get_report()
+{
+	auto v = snapshot.load();
+	HL2 hl {};
+
+	// [[[cog:
+	// for f in ('timestamp', 'latitude', 'longitude', 'custom_mode', 'altitude',
+	//         'target_distance', 'wp_num', 'failure_flags', 'type', 'autopilot',
+	//         'heading', 'target_heading', 'throttle', 'airspeed', 'groundspeed',
+	//         'windspeed', 'wind_heading', 'eph', 'epv', 'climb_rate', 'battery'):
+	//     cog.outl("hl.%s = v.%s;" % (f, f))
+	// ]]]
+	hl.timestamp = v.timestamp;
+	hl.latitude = v.latitude;
+	hl.longitude = v.longitude;
+	hl.custom_mode = v.custom_mode;
+	hl.altitude = v.altitude;
+	hl.target_distance = v.target_distance;
+	hl.wp_num = v.wp_num;
+	hl.failure_flags = v.failure_flags;
+	hl.type = v.type;
+	hl.autopilot = v.autopilot;
+	hl.heading = v.heading;
+	hl.target_heading = v.target_heading;
+	hl.throttle = v.throttle;
+	hl.airspeed = v.airspeed;
+	hl.groundspeed = v.groundspeed;
+	hl.windspeed = v.windspeed;
+	hl.wind_heading = v.wind_heading;
+	hl.eph = v.eph;
+	hl.epv = v.epv;
+	hl.climb_rate = v.climb_rate;
+	hl.battery = v.battery;
+	// [[[end]]] (checksum: d9914efc10e676791f3fafc6a0f56500)
+
+	return hl;
+}
+
+mavlink_message_t HighLatencyEncoder::make(uint8_t sysid, uint8_t compid, uint8_t seq)
+{
+	auto hl = get_report();
+
+	mavlink_message_t mmsg;
+	mavlink::MsgMap map(mmsg);
+	auto mi = hl.get_message_info();
+
+	// HIGH_LATENCY2 is MAVLink 2 only
+	mavlink::mavlink_status_t status {};
+	status.current_tx_seq = seq;
+
+	hl.serialize(map);
+	mavlink::mavlink_finalize_message_buffer(&mmsg, sysid, compid, &status,
+			mi.min_length, mi.length, mi.crc_extra);
+
+	return mmsg;
+}
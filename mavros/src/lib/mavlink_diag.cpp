@@ -11,7 +11,12 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <algorithm>
+#include <sstream>
 #include <mavros/mavlink_diag.h>
+#include <mavconn/bond.h>
+#include <mavconn/serial.h>
+#include <mavconn/udp.h>
 
 using namespace mavros;
 
@@ -39,6 +44,67 @@ void MavlinkDiag::run(diagnostic_updater::DiagnosticStatusWrapper &stat)
 		stat.addf("Rx speed:", "%f", iostat.rx_speed);
 		stat.addf("Tx speed:", "%f", iostat.tx_speed);
 
+		auto lstat = link->get_link_stats();
+		stat.add("Rx CRC errors:", lstat.crc_errors);
+		stat.add("Rx signature errors:", lstat.signature_errors);
+		stat.add("Rx lost packets:", lstat.seq_lost);
+		stat.add("Rx filtered:", lstat.rx_filtered);
+		stat.add("Tx drops:", lstat.tx_drops);
+		stat.add("Tx queue high water:", lstat.tx_queue_high_water);
+
+		// streams which use most of the link
+		std::sort(lstat.messages.begin(), lstat.messages.end(),
+			[](const mavconn::LinkStats::MsgStat &a, const mavconn::LinkStats::MsgStat &b) {
+				return a.rx_bytes + a.tx_bytes > b.rx_bytes + b.tx_bytes;
+			});
+
+		std::ostringstream top;
+		for (size_t i = 0; i < lstat.messages.size() && i < 5; i++) {
+			auto &m = lstat.messages[i];
+			top << (i > 0 ? ", " : "") << m.msgid << ": " << m.rx_bytes + m.tx_bytes << " B";
+		}
+		stat.add("Top messages (id: bytes):", top.str());
+
+		// udp-s:// peers
+		auto udp = std::dynamic_pointer_cast<mavconn::MAVConnUDP>(link);
+		if (udp && udp->is_server()) {
+			auto peers = udp->get_peers();
+			stat.add("Peers:", peers.size());
+			for (auto &p : peers)
+				stat.addf("Peer " + p.address + ":", "rx %llu / %llu B, tx %llu / %llu B, idle %.1f s",
+					(unsigned long long) p.rx_packets, (unsigned long long) p.rx_bytes,
+					(unsigned long long) p.tx_packets, (unsigned long long) p.tx_bytes, p.idle);
+		}
+
+		// active probing
+		auto probe = link->get_link_probe();
+		if (probe) {
+			auto ps = probe->get_stats();
+			stat.addf("Probe RTT avg/min (ms):", "%.1f / %.1f", ps.rtt_ms, ps.rtt_min_ms);
+			stat.addf("Probe jitter (ms):", "%.1f", ps.jitter_ms);
+			stat.addf("Probe loss:", "%.1f %% (%llu of %llu)", ps.loss * 100.0f,
+					(unsigned long long) ps.lost, (unsigned long long) ps.sent);
+		}
+
+		// redundant links
+		auto bond = std::dynamic_pointer_cast<mavconn::MAVConnBond>(link);
+		if (bond) {
+			for (auto &m : bond->get_members())
+				stat.addf("Link " + m.url + ":", "%s%s, rx %llu, dups %llu, tx %llu, lag %.1f ms, rtt %.1f ms, reopens %llu",
+					!m.open ? "closed" : m.healthy ? "healthy" : "silent", m.active ? " (active)" : "",
+					(unsigned long long) m.rx_frames, (unsigned long long) m.rx_dups,
+					(unsigned long long) m.tx_frames, m.lag_ms, m.rtt_ms, (unsigned long long) m.reopens);
+		}
+
+		// read latency of serial link
+		auto serial = std::dynamic_pointer_cast<mavconn::MAVConnSerial>(link);
+		if (serial) {
+			auto rs = serial->get_read_stat();
+			stat.add("Reads:", rs.reads);
+			stat.addf("Bytes per read:", "%.1f", rs.bytes_per_read);
+			stat.addf("Read interval avg/max (ms):", "%.2f / %.2f", rs.gap_avg_ms, rs.gap_max_ms);
+		}
+
 		if (mav_status.packet_rx_drop_count > last_drop_count)
 			stat.summaryf(1, "%d packeges dropped since last report",
 				mav_status.packet_rx_drop_count - last_drop_count);
@@ -12,9 +12,16 @@
  */
 
 #include <rclcpp/rclcpp.hpp>
+#include <rclcpp_components/register_node_macro.hpp>
 #include <mavros/mavros.h>
+#include <mavros/plugin_registry.h>
 #include <mavros/utils.h>
+#include <mavconn/thread_utils.h>
 #include <fnmatch.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
 
 // MAVLINK_VERSION string
 #include <mavlink/config.h>
@@ -36,26 +43,44 @@ MavRos::MavRos(const rclcpp::NodeOptions& node_options) :
 	fcu_link_diag("FCU connection"),
 	gcs_link_diag("GCS bridge"),
 	plugin_loader("mavros", "mavros::plugin::PluginBase"),
-	last_message_received_from_gcs(0),
+	last_gcs_rx_ns(0),
 	conn_timeout(0, 0),
-	plugin_subscriptions{},
-	mav_uas(this)
+	probe_seq(0),
+	high_latency_seq(0),
+	plugin_dispatcher(&UAS::set_rx_stamp),
+	main_plugins{&mav_uas, &plugin_dispatcher, {}, {}},
+	thread_sched_ok(true),
+	mav_uas(this),
+	vehicle_dispatcher{}
 {
 	std::string fcu_url, gcs_url;
-	std::string fcu_protocol;
+	std::string fcu_protocol, gcs_protocol;
 	int system_id, component_id;
 	int tgt_system_id, tgt_component_id;
 	bool px4_usb_quirk;
 	double conn_timeout_d;
+	double link_stats_rate;
+	bool dispatch_profile;
+	std::string dispatch_sched, dispatch_cpus;
+	bool lock_memory;
+	double handler_stats_rate;
 	std::vector<std::string> plugin_blacklist{}, plugin_whitelist{};
+	int dispatch_threads;
+	int init_threads;
+	std::vector<int64_t> vehicle_sysids;
+	int vehicle_threads;
 	MAVConnInterface::Ptr fcu_link;
 
 	fcu_url = declare_parameter<std::string>("fcu_url", "serial:///dev/ttyACM0");
 	gcs_url = declare_parameter<std::string>("gcs_url", "udp://@");
 	gcs_quiet_mode = declare_parameter<bool>("gcs_quiet_mode", false);
+	gcs_routing = declare_parameter<bool>("gcs_routing", true);
 	conn_timeout_d = declare_parameter<double>("conn/timeout", 30.0);
+	link_stats_rate = declare_parameter<double>("conn/link_stats_rate", 1.0);
 
+	// v1.0, v2.0 or auto: follow framing of the peer, probe FCU for MAVLink 2
 	fcu_protocol = declare_parameter<std::string>("fcu_protocol", "v2.0");
+	gcs_protocol = declare_parameter<std::string>("gcs_protocol", "v2.0");
 	system_id = declare_parameter<int>("system_id", 1);
 	component_id = declare_parameter<int>("component_id", mavconn::MAV_COMP_ID_UDP_BRIDGE);
 	tgt_system_id = declare_parameter<int>("target_system_id", 1);
@@ -63,9 +88,61 @@ MavRos::MavRos(const rclcpp::NodeOptions& node_options) :
 	px4_usb_quirk = declare_parameter<bool>("startup_px4_usb_quirk", false);
 	plugin_blacklist = declare_parameter<std::vector<std::string>>("plugin_blacklist", {});
 	plugin_whitelist = declare_parameter<std::vector<std::string>>("plugin_whitelist", {});
+	// opt-in worker threads, 0 - handlers run one at a time on IO thread, like before;
+	// plugins sharing state through UAS are not audited for parallel handlers
+	dispatch_threads = declare_parameter<int>("plugin_dispatch/threads", 0);
+	dispatch_queue_size = declare_parameter<int>("plugin_dispatch/queue_size", PluginDispatcher::DEFAULT_QUEUE_SIZE);
+	dispatch_fast_path = declare_parameter<std::vector<std::string>>("plugin_dispatch/fast_path", {});
+	// worker threads policy "fifo:prio", "rr:prio" or "other", CPU list "2,3" or "2-3"
+	dispatch_sched = declare_parameter<std::string>("plugin_dispatch/sched", "");
+	dispatch_cpus = declare_parameter<std::string>("plugin_dispatch/cpus", "");
+	// link IO threads are set by sched= and cpus= URL query
+	lock_memory = declare_parameter<bool>("mlockall", false);
+	// handler timing, diagnostics and handler_stats topic
+	dispatch_profile = declare_parameter<bool>("plugin_dispatch/profile", false);
+	handler_stats_rate = declare_parameter<double>("plugin_dispatch/profile_rate", 1.0);
+	// plugins should not depend on each other in initialize() with more than 1
+	init_threads = declare_parameter<int>("plugin_init_threads", 1);
+	plugin_lazy = declare_parameter<bool>("plugin_lazy/enable", false);
+	// plugins serving ROS topics and services, or sending by own timers
+	plugin_eager = declare_parameter<std::vector<std::string>>("plugin_lazy/eager", {
+				"sys_*", "command", "param", "waypoint", "ftp", "hil", "home_position", "global_position",
+				"rc_io", "setpoint_*", "actuator_control", "manual_control", "safety_area",
+			});
+	// multi-vehicle mode, other sysids on same link get own plugin sets
+	vehicle_sysids = declare_parameter<std::vector<int64_t>>("vehicles/sysids", {});
+	vehicle_threads = declare_parameter<int>("vehicles/dispatch_threads", 1);
+	tf_batch_window = declare_parameter<double>("tf/batch_window",
+			std::chrono::duration<double>(TransformBatcher::DEFAULT_WINDOW).count());
+	declare_parameter<bool>("gcs_shaper/enable", false);
+	declare_parameter<double>("gcs_shaper/bandwidth", 0.0);
+	declare_parameter<std::vector<int64_t>>("gcs_shaper/rate_msgids", {
+				mavlink::common::msg::HIGHRES_IMU::MSG_ID,
+				mavlink::common::msg::ODOMETRY::MSG_ID,
+			});
+	declare_parameter<std::vector<double>>("gcs_shaper/rate_hz", {2.0, 2.0});
+	declare_parameter<std::vector<int64_t>>("gcs_shaper/priority_msgids",
+			std::vector<int64_t>(mavconn::TxShaper::DEFAULT_PRIORITY.begin(), mavconn::TxShaper::DEFAULT_PRIORITY.end()));
+	// off, on or auto: on Tx drops or probed RTT above threshold
+	auto high_latency_mode = declare_parameter<std::string>("gcs_high_latency/mode", "off");
+	auto high_latency_interval_d = declare_parameter<double>("gcs_high_latency/interval", 5.0);
+	auto high_latency_rtt = declare_parameter<double>("gcs_high_latency/rtt_threshold", 1.0);
+	auto high_latency_hold = declare_parameter<double>("gcs_high_latency/hold", 30.0);
+	// FCU -> GCS messages still forwarded, commands come from GCS and are not filtered
+	auto high_latency_msgids = declare_parameter<std::vector<int64_t>>("gcs_high_latency/pass_msgids",
+			std::vector<int64_t>(HighLatencyMode::DEFAULT_PASS.begin(), HighLatencyMode::DEFAULT_PASS.end()));
 
 	conn_timeout = rclcpp::Duration(conn_timeout_d);
 
+	// before link buffers and plugins are allocated, so page faults do not hit IO threads
+	if (lock_memory) {
+		int ret = mavconn::utils::lock_process_memory();
+		if (ret != 0) {
+			thread_sched_ok = false;
+			RCLCPP_WARN(logger, "mlockall: %s", strerror(ret));
+		}
+	}
+
 	// Now we use FCU URL as a hardware Id
 	UAS_DIAG(&mav_uas).setHardwareID(fcu_url);
 
@@ -85,19 +162,7 @@ MavRos::MavRos(const rclcpp::NodeOptions& node_options) :
 		return;
 	}
 
-	if (fcu_protocol == "v1.0") {
-		fcu_link->set_protocol_version(mavconn::Protocol::V10);
-	}
-	else if (fcu_protocol == "v2.0") {
-		fcu_link->set_protocol_version(mavconn::Protocol::V20);
-	}
-	//else if (fcu_protocol == "auto") {	// XXX TODO
-	//	fcu_link->set_protocol_version(mavconn::Protocol::V20);
-	//}
-	else {
-		RCLCPP_WARN(logger, "Unknown FCU protocol: \"%s\", should be: \"v1.0\" or \"v2.0\". Used default v1.0.", fcu_protocol.c_str());
-		fcu_link->set_protocol_version(mavconn::Protocol::V10);
-	}
+	setup_link_protocol("FCU", fcu_protocol, fcu_link.get(), fcu_negotiator, true);
 
 	if (gcs_url != "") {
 		RCLCPP_INFO_STREAM(logger, "GCS URL: " << gcs_url);
@@ -113,6 +178,9 @@ MavRos::MavRos(const rclcpp::NodeOptions& node_options) :
 			rclcpp::shutdown();
 			return;
 		}
+
+		// GCS switches to MAVLink 2 when it sees forwarded FCU frames, so it is not probed
+		setup_link_protocol("GCS", gcs_protocol, gcs_link.get(), gcs_negotiator, false);
 	}
 	else
 		RCLCPP_INFO(logger, "GCS bridge disabled");
@@ -125,38 +193,206 @@ MavRos::MavRos(const rclcpp::NodeOptions& node_options) :
 		// 	.unreliable().maxDatagramSize(1024)
 		// 	.reliable());
 
+	// link counters, 0 rate disables topic
+	if (link_stats_rate > 0.0) {
+		link_stats_pub = create_publisher<mavros_msgs::msg::LinkStats>("link_stats", 10);
+		link_stats_timer = create_wall_timer(
+			std::chrono::duration<double>(1.0 / link_stats_rate),
+			std::bind(&MavRos::link_stats_cb, this));
+	}
+
+	// receive filters, may be changed at run time
+	declare_rx_filter("rx_filter/fcu/", *fcu_link->get_rx_filter());
+	if (gcs_link)
+		declare_rx_filter("rx_filter/gcs/", *gcs_link->get_rx_filter());
+	// same lists for mavlink/from topic, frames are still handled by plugins
+	declare_rx_filter("mavlink_from/", mavlink_pub_filter);
+	rx_filter_param_cb = add_on_set_parameters_callback(
+			std::bind(&MavRos::rx_filter_param_changed, this, std::placeholders::_1));
+
+	// GCS forwarding shaper, may be changed at run time
+	if (gcs_link) {
+		std::string reason;
+		if (!apply_gcs_shaper({}, reason))
+			RCLCPP_ERROR(logger, "GCS shaper: %s", reason.c_str());
+
+		gcs_shaper_param_cb = add_on_set_parameters_callback(
+				std::bind(&MavRos::gcs_shaper_param_changed, this, std::placeholders::_1));
+	}
+
 	// setup UAS and diag
 	mav_uas.set_tgt(tgt_system_id, tgt_component_id);
 	UAS_FCU(&mav_uas) = fcu_link;
+	mav_uas.tf2_batcher.set_window(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double>(tf_batch_window)));
 
 	mav_uas.add_connection_change_handler(std::bind(&MavlinkDiag::set_connection_status, &fcu_link_diag, std::placeholders::_1));
 	mav_uas.add_connection_change_handler(std::bind(&MavRos::log_connect_change, this, std::placeholders::_1));
 
+	if (fcu_negotiator) {
+		mav_uas.add_connection_change_handler([this, fcu_link](bool connected) {
+			if (connected)
+				return;
+
+			// FCU may come back with other firmware
+			fcu_negotiator->reset();
+			fcu_link->set_protocol_version(fcu_negotiator->get_protocol());
+		});
+
+		protocol_timer = create_wall_timer(std::chrono::milliseconds(250), std::bind(&MavRos::protocol_cb, this));
+	}
+
 	// prepare plugin lists
 	// issue #257 2: assume that all plugins blacklisted
 	if (plugin_blacklist.empty() and !plugin_whitelist.empty())
 		plugin_blacklist.emplace_back("*");
 
-	for (auto &name : plugin_loader.getDeclaredClasses())
-		add_plugin(name, plugin_blacklist, plugin_whitelist);
+	for (auto &name : get_plugin_names())
+		add_plugin(main_plugins, name, plugin_blacklist, plugin_whitelist);
+
+	// routes are registered above in class order, only initialize() runs in parallel
+	initialize_plugins(std::max(init_threads, 1));
+
+	// after main plugins declared their parameters, vehicles copy them
+	if (!vehicle_sysids.empty()) {
+		add_vehicles(vehicle_sysids, tgt_component_id, plugin_blacklist, plugin_whitelist);
+		initialize_plugins(std::max(init_threads, 1));
+	}
+
+	// router links are fixed before traffic starts
+	if (gcs_link) {
+		fcu_route = router.add_link(fcu_link);
+		gcs_route = router.add_link(gcs_link);
+	}
+
+	// with workers handlers leave IO thread, except fast path ones
+	if (dispatch_threads > 0)
+		RCLCPP_INFO(logger, "Plugin dispatch: %d worker threads", dispatch_threads);
+	else
+		RCLCPP_INFO(logger, "Plugin dispatch: inline");
+	plugin_dispatcher.start(std::max(dispatch_threads, 0));
+	start_vehicles(std::max(vehicle_threads, 0));
+
+	if (!dispatch_sched.empty() || !dispatch_cpus.empty()) {
+		try {
+			auto sched = mavconn::utils::ThreadSched::parse(dispatch_sched, dispatch_cpus);
+			int ret = plugin_dispatcher.set_thread_sched(sched);
+			for (auto &v : vehicles) {
+				int vret = v->dispatcher->set_thread_sched(sched);
+				ret = (ret != 0) ? ret : vret;
+			}
+
+			if (ret != 0) {
+				thread_sched_ok = false;
+				RCLCPP_WARN(logger, "Plugin dispatch: workers %s: %s", sched.to_string().c_str(), strerror(ret));
+			}
+			else {
+				RCLCPP_INFO(logger, "Plugin dispatch: workers %s", sched.to_string().c_str());
+			}
+		}
+		catch (std::invalid_argument &ex) {
+			thread_sched_ok = false;
+			RCLCPP_ERROR(logger, "Plugin dispatch: sched/cpus: %s", ex.what());
+		}
+	}
+
+	UAS_DIAG(&mav_uas).add("Threads", this, &MavRos::threads_diag);
+
+	if (dispatch_profile) {
+		plugin_dispatcher.set_profiling(true);
+		for (auto &v : vehicles)
+			v->dispatcher->set_profiling(true);
+
+		UAS_DIAG(&mav_uas).add("Plugin handlers", this, &MavRos::handler_profile_diag);
+		if (handler_stats_rate > 0.0) {
+			handler_stats_pub = create_publisher<mavros_msgs::msg::HandlerStats>("handler_stats", 10);
+			handler_stats_timer = create_wall_timer(
+				std::chrono::duration<double>(1.0 / handler_stats_rate),
+				std::bind(&MavRos::handler_stats_cb, this));
+		}
+	}
+
+	// FCU -> GCS, after shaper
+	gcs_forward = [this](const mavlink_message_t *msg) {
+		if (gcs_routing)
+			router.route(fcu_route, msg);
+		else
+			gcs_link->send_message_ignore_drop(msg);
+	};
+
+	HighLatencyMode::Options hl_opts;
+	if (!HighLatencyMode::parse_mode(high_latency_mode, hl_opts.mode)) {
+		RCLCPP_WARN(logger, "Unknown gcs_high_latency/mode: \"%s\", should be: \"off\", \"on\" or \"auto\". Used off.",
+				high_latency_mode.c_str());
+	}
+
+	if (gcs_link && hl_opts.mode != HighLatencyMode::Mode::OFF) {
+		hl_opts.rtt_threshold_ms = high_latency_rtt * 1000.0;
+		hl_opts.hold = std::chrono::duration_cast<HighLatencyMode::clock::duration>(
+				std::chrono::duration<double>(high_latency_hold));
+		hl_opts.pass_msgids.assign(high_latency_msgids.begin(), high_latency_msgids.end());
+		gcs_high_latency = std::make_unique<HighLatencyMode>(hl_opts);
+
+		high_latency_interval = std::chrono::duration_cast<HighLatencyMode::clock::duration>(
+				std::chrono::duration<double>(high_latency_interval_d));
+		high_latency_encoder.set_target(tgt_system_id, tgt_component_id);
+
+		mav_uas.add_connection_change_handler([this](bool connected) {
+			if (!connected)
+				high_latency_encoder.reset();
+		});
+
+		RCLCPP_INFO(logger, "GCS: HIGH_LATENCY2 mode %s, report every %.1f s",
+				HighLatencyMode::to_string(hl_opts.mode), high_latency_interval_d);
+		high_latency_timer = create_wall_timer(
+				std::min<HighLatencyMode::clock::duration>(std::chrono::seconds(1), high_latency_interval),
+				std::bind(&MavRos::high_latency_cb, this));
+	}
 
 	// connect FCU link
+	fcu_link->message_received_batch_cb = [this, fcu = fcu_link.get()](const mavlink_message_t *msgs, const Framing *framings, size_t count) {
+		if (fcu_negotiator)
+			negotiate_rx("FCU", fcu, *fcu_negotiator, msgs, count);
+
+		mavlink_pub_cb(msgs, framings, count);
 
-	// XXX TODO: move workers to ROS Spinner, let mavconn threads to do only IO
-	fcu_link->message_received_cb = [this](const mavlink_message_t *msg, const Framing framing) {
-		mavlink_pub_cb(msg, framing);
-		plugin_route_cb(msg, framing);
+		// handlers stamp messages with receive time when FCU time is unknown
+		for (size_t i = 0; i < count; i++) {
+			UAS::set_rx_stamp(fcu->get_rx_stamp(i));
+			plugin_route_cb(&msgs[i], framings[i], fcu->get_rx_stamp(i));
+			if (gcs_high_latency)
+				high_latency_encoder.update(msgs[i]);
+		}
+		UAS::set_rx_stamp(0);
+
+		if (gcs_high_latency && gcs_high_latency->is_active()) {
+			// own reports replace streams
+			for (size_t i = 0; i < count; i++) {
+				if (gcs_high_latency->pass(msgs[i].msgid))
+					gcs_forward(&msgs[i]);
+			}
+			return;
+		}
 
 		if (gcs_link) {
-			if (this->gcs_quiet_mode && msg->msgid != mavlink::common::msg::HEARTBEAT::MSG_ID &&
-				(clock->now() - this->last_message_received_from_gcs > this->conn_timeout)) {
+			// rx stamp of batch instead of clock read
+			int64_t now_ns = fcu->get_rx_stamp(0);
+			bool quiet = this->gcs_quiet_mode &&
+				(now_ns - this->last_gcs_rx_ns.load(std::memory_order_relaxed) > this->conn_timeout.nanoseconds());
+
+			if (!quiet) {
+				gcs_shaper.shape(msgs, count, now_ns, gcs_forward);
 				return;
 			}
 
-			gcs_link->send_message_ignore_drop(msg);
+			for (size_t i = 0; i < count; i++) {
+				if (msgs[i].msgid == mavlink::common::msg::HEARTBEAT::MSG_ID)
+					gcs_forward(&msgs[i]);
+			}
 		}
 	};
 
+
 	fcu_link->port_closed_cb = []() {
 		RCLCPP_ERROR(logger, "FCU connection closed, mavros will be terminated.");
 		rclcpp::shutdown();
@@ -164,9 +400,17 @@ MavRos::MavRos(const rclcpp::NodeOptions& node_options) :
 
 	if (gcs_link) {
 		// setup GCS link bridge
-		gcs_link->message_received_cb = [this, fcu_link](const mavlink_message_t *msg, const Framing framing) {
-			this->last_message_received_from_gcs = this->clock->now();
-			fcu_link->send_message_ignore_drop(msg);
+		gcs_link->message_received_batch_cb = [this, fcu_link, gcs = gcs_link.get()](const mavlink_message_t *msgs, const Framing *framings, size_t count) {
+			this->last_gcs_rx_ns.store(gcs->get_rx_stamp(0), std::memory_order_relaxed);
+			if (gcs_negotiator)
+				negotiate_rx("GCS", gcs, *gcs_negotiator, msgs, count);
+
+			for (size_t i = 0; i < count; i++) {
+				if (gcs_routing)
+					router.route(gcs_route, &msgs[i]);
+				else
+					fcu_link->send_message_ignore_drop(&msgs[i]);
+			}
 		};
 
 		gcs_link_diag.set_connection_status(true);
@@ -188,9 +432,28 @@ MavRos::MavRos(const rclcpp::NodeOptions& node_options) :
 }
 
 MavRos::~MavRos() {
+	if (vehicle_executor) {
+		vehicle_executor->cancel();
+		if (vehicle_spinner.joinable())
+			vehicle_spinner.join();
+	}
+
 	auto fcu_link = UAS_FCU(&mav_uas);
 	if (fcu_link) {
 		fcu_link->port_closed_cb = nullptr;
+		// vehicle dispatchers are gone before main UAS closes the link
+		if (!vehicles.empty())
+			fcu_link->close();
+	}
+
+	for (auto &v : vehicles)
+		v->dispatcher->stop();
+
+	plugin_dispatcher.stop();
+	for (auto &st : plugin_dispatcher.get_stats()) {
+		if (st.dropped > 0)
+			RCLCPP_WARN(logger, "Plugin %s: %lu messages dropped by full queue (max depth %zu)",
+					st.name.c_str(), st.dropped, st.queue_high_water);
 	}
 }
 
@@ -206,16 +469,34 @@ void MavRos::spin()
 	RCLCPP_INFO(logger, "Stopping mavros...");
 }
 
-void MavRos::mavlink_pub_cb(const mavlink_message_t *mmsg, Framing framing)
+void MavRos::mavlink_pub_cb(const mavlink_message_t *mmsgs, const Framing *framings, size_t count)
 {
-	mavros_msgs::msg::Mavlink rmsg;
-
 	if  (mavlink_pub->get_subscription_count() == 0)
 		return;
 
-	rmsg.header.stamp = clock->now();
-	mavros_msgs::mavlink::convert(*mmsg, rmsg, enum_value(framing));
-	mavlink_pub->publish(rmsg);
+	auto fcu_link = UAS_FCU(&mav_uas);
+	bool loan = mavlink_pub->can_loan_messages();
+	for (size_t i = 0; i < count; i++) {
+		if (!mavlink_pub_filter.accept(mmsgs[i].msgid))
+			continue;
+
+		auto stamp = rclcpp::Time(int64_t(fcu_link->get_rx_stamp(i)));
+
+		// middleware owned buffer, or message moved to intra-process subscribers
+		if (loan) {
+			auto rmsg = mavlink_pub->borrow_loaned_message();
+			rmsg.get().header.stamp = stamp;
+			mavros_msgs::mavlink::convert(mmsgs[i], rmsg.get(), enum_value(framings[i]));
+			mavlink_pub->publish(std::move(rmsg));
+		}
+		else {
+			// convert overwrites all fields, so payload capacity is reused
+			auto rmsg = mavlink_pool.acquire_reused();
+			rmsg->header.stamp = stamp;
+			mavros_msgs::mavlink::convert(mmsgs[i], *rmsg, enum_value(framings[i]));
+			mavlink_pool.publish(*mavlink_pub, std::move(rmsg));
+		}
+	}
 }
 
 void MavRos::mavlink_sub_cb(const mavros_msgs::msg::Mavlink::UniquePtr rmsg)
@@ -228,14 +509,292 @@ void MavRos::mavlink_sub_cb(const mavros_msgs::msg::Mavlink::UniquePtr rmsg)
 		RCLCPP_ERROR(logger, "Drop mavlink packet: convert error.");
 }
 
-void MavRos::plugin_route_cb(const mavlink_message_t *mmsg, const Framing framing)
+void MavRos::link_stats_cb()
+{
+	auto fcu_link = UAS_FCU(&mav_uas);
+	if (fcu_link)
+		publish_link_stats("fcu", fcu_link);
+	if (gcs_link)
+		publish_link_stats("gcs", gcs_link);
+}
+
+void MavRos::publish_link_stats(const std::string &name, const MAVConnInterface::Ptr &link)
+{
+	if (link_stats_pub->get_subscription_count() == 0)
+		return;
+
+	auto st = link->get_link_stats();
+	mavros_msgs::msg::LinkStats rmsg;
+
+	rmsg.header.stamp = clock->now();
+	rmsg.link = name;
+	rmsg.rx_count = st.rx_count;
+	rmsg.rx_bytes = st.rx_bytes;
+	rmsg.tx_count = st.tx_count;
+	rmsg.tx_bytes = st.tx_bytes;
+	rmsg.crc_errors = st.crc_errors;
+	rmsg.signature_errors = st.signature_errors;
+	rmsg.seq_lost = st.seq_lost;
+	rmsg.rx_filtered = st.rx_filtered;
+	rmsg.tx_drops = st.tx_drops;
+	rmsg.tx_queue_high_water = st.tx_queue_high_water;
+
+	for (auto &m : st.messages) {
+		rmsg.msgid.push_back(m.msgid);
+		rmsg.msg_rx_count.push_back(m.rx_count);
+		rmsg.msg_rx_bytes.push_back(m.rx_bytes);
+		rmsg.msg_tx_count.push_back(m.tx_count);
+		rmsg.msg_tx_bytes.push_back(m.tx_bytes);
+	}
+
+	for (auto &p : st.peers) {
+		rmsg.peer_id.push_back(p.sysid << 8 | p.compid);
+		rmsg.peer_rx_count.push_back(p.rx_count);
+		rmsg.peer_seq_lost.push_back(p.seq_lost);
+	}
+
+	link_stats_pub->publish(rmsg);
+}
+
+std::vector<PluginDispatcher::ProfileStat> MavRos::collect_profile()
 {
-	auto it = plugin_subscriptions.find(mmsg->msgid);
-	if (it == plugin_subscriptions.end())
+	auto prof = plugin_dispatcher.get_profile();
+
+	for (auto &v : vehicles) {
+		std::string pfx = v->node->get_name();
+		for (auto &p : v->dispatcher->get_profile()) {
+			p.name = pfx + "/" + p.name;
+			prof.emplace_back(std::move(p));
+		}
+	}
+
+	return prof;
+}
+
+void MavRos::handler_stats_cb()
+{
+	if (handler_stats_pub->get_subscription_count() == 0)
 		return;
 
-	for (auto &info : it->second)
-		std::get<3>(info)(mmsg, framing);
+	mavros_msgs::msg::HandlerStats rmsg;
+	rmsg.header.stamp = clock->now();
+
+	for (auto &p : collect_profile()) {
+		rmsg.plugin.push_back(p.name);
+		rmsg.msgid.push_back(p.msgid);
+		rmsg.fast_path.push_back(p.fast_path);
+		rmsg.calls.push_back(p.calls);
+		rmsg.total_ns.push_back(p.total_ns);
+		rmsg.max_ns.push_back(p.max_ns);
+		rmsg.p50_ns.push_back(p.p50_ns);
+		rmsg.p99_ns.push_back(p.p99_ns);
+	}
+
+	handler_stats_pub->publish(rmsg);
+}
+
+void MavRos::handler_profile_diag(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+	auto prof = collect_profile();
+
+	// biggest CPU users first
+	std::sort(prof.begin(), prof.end(), [](const PluginDispatcher::ProfileStat &a, const PluginDispatcher::ProfileStat &b) {
+				return a.total_ns > b.total_ns;
+			});
+
+	uint64_t total_ns = 0;
+	for (auto &p : prof)
+		total_ns += p.total_ns;
+
+	stat.summary(0, "Normal");
+	stat.addf("Handlers called", "%zu", prof.size());
+	stat.addf("Total time", "%.1f ms", total_ns / 1e6);
+
+	for (size_t i = 0; i < std::min<size_t>(prof.size(), 10); i++) {
+		auto &p = prof[i];
+		stat.addf(utils::format("%s (%u)%s", p.name.c_str(), p.msgid, (p.fast_path) ? " IO" : ""),
+				"%lu calls, avg %.1f us, p99 %.1f us, max %.1f us",
+				p.calls, p.total_ns / 1e3 / p.calls, p.p99_ns / 1e3, p.max_ns / 1e3);
+	}
+}
+
+static std::string sched_list(const std::vector<mavconn::utils::ThreadSched> &threads)
+{
+	if (threads.empty())
+		return "none";
+
+	std::string ret;
+	for (auto &t : threads)
+		ret += ((ret.empty()) ? "" : "; ") + t.to_string();
+
+	return ret;
+}
+
+void MavRos::threads_diag(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+	if (thread_sched_ok)
+		stat.summary(0, "Normal");
+	else
+		stat.summary(1, "Settings not applied, see log");
+
+	stat.add("Memory locked", (mavconn::utils::is_process_memory_locked()) ? "Yes" : "No");
+
+	auto fcu_link = UAS_FCU(&mav_uas);
+	if (fcu_link)
+		stat.add("FCU IO threads", sched_list(fcu_link->get_io_sched()));
+	if (gcs_link)
+		stat.add("GCS IO threads", sched_list(gcs_link->get_io_sched()));
+
+	stat.add("Dispatch workers", sched_list(plugin_dispatcher.get_thread_sched()));
+	for (auto &v : vehicles)
+		stat.add(utils::format("Dispatch workers %s", v->node->get_name()), sched_list(v->dispatcher->get_thread_sched()));
+}
+
+void MavRos::declare_rx_filter(const std::string &pfx, mavconn::RxFilter &filter)
+{
+	// empty mode keeps filter from URL query
+	declare_parameter<std::string>(pfx + "mode", "");
+	declare_parameter<std::vector<int64_t>>(pfx + "msgids", {});
+	declare_parameter<std::vector<int64_t>>(pfx + "rate_msgids", {});
+	declare_parameter<std::vector<double>>(pfx + "rate_hz", {});
+
+	std::string reason;
+	if (!apply_rx_filter(pfx, filter, {}, reason))
+		RCLCPP_ERROR(logger, "RX filter: %s", reason.c_str());
+}
+
+bool MavRos::apply_rx_filter(const std::string &pfx, mavconn::RxFilter &filter,
+		const std::vector<rclcpp::Parameter> &changed, std::string &reason)
+{
+	auto param = [&](const std::string &key) {
+		for (auto &p : changed)
+			if (p.get_name() == pfx + key)
+				return p;
+
+		return get_parameter(pfx + key);
+	};
+
+	auto mode_str = param("mode").as_string();
+	auto msgids = param("msgids").as_integer_array();
+	auto rate_msgids = param("rate_msgids").as_integer_array();
+	auto rate_hz = param("rate_hz").as_double_array();
+
+	if (rate_msgids.size() != rate_hz.size()) {
+		reason = pfx + "rate_msgids and rate_hz should have same size";
+		return false;
+	}
+
+	mavconn::RxFilter::Mode mode;
+	if (mode_str == "none")
+		mode = mavconn::RxFilter::Mode::NONE;
+	else if (mode_str == "allow")
+		mode = mavconn::RxFilter::Mode::ALLOW;
+	else if (mode_str == "deny")
+		mode = mavconn::RxFilter::Mode::DENY;
+	else if (mode_str != "") {
+		reason = pfx + "mode should be: \"none\", \"allow\" or \"deny\"";
+		return false;
+	}
+
+	if (mode_str != "")
+		filter.set_mode(mode, std::vector<mavlink::msgid_t>(msgids.begin(), msgids.end()));
+
+	// declaration with defaults keeps caps from URL query
+	if (!rate_msgids.empty() || mode_str != "" || !changed.empty()) {
+		std::vector<mavconn::RxFilter::RateLimit> limits;
+		for (size_t i = 0; i < rate_msgids.size(); i++)
+			limits.push_back(mavconn::RxFilter::RateLimit { mavlink::msgid_t(rate_msgids[i]), float(rate_hz[i]) });
+
+		filter.set_rate_limits(limits);
+	}
+
+	RCLCPP_INFO(logger, "RX filter %s: mode %s, %zu ids, %zu rate caps", pfx.c_str(),
+			(mode_str != "") ? mode_str.c_str() : "from URL", msgids.size(), rate_msgids.size());
+	return true;
+}
+
+rcl_interfaces::msg::SetParametersResult MavRos::rx_filter_param_changed(const std::vector<rclcpp::Parameter> &parameters)
+{
+	rcl_interfaces::msg::SetParametersResult result;
+	result.successful = true;
+
+	bool fcu = false, gcs = false, from = false;
+	for (auto &p : parameters) {
+		fcu |= p.get_name().rfind("rx_filter/fcu/", 0) == 0;
+		gcs |= p.get_name().rfind("rx_filter/gcs/", 0) == 0;
+		from |= p.get_name().rfind("mavlink_from/", 0) == 0;
+	}
+
+	auto fcu_link = UAS_FCU(&mav_uas);
+	if (fcu && fcu_link)
+		result.successful = apply_rx_filter("rx_filter/fcu/", *fcu_link->get_rx_filter(), parameters, result.reason);
+	if (gcs && gcs_link && result.successful)
+		result.successful = apply_rx_filter("rx_filter/gcs/", *gcs_link->get_rx_filter(), parameters, result.reason);
+	if (from && result.successful)
+		result.successful = apply_rx_filter("mavlink_from/", mavlink_pub_filter, parameters, result.reason);
+
+	return result;
+}
+
+bool MavRos::apply_gcs_shaper(const std::vector<rclcpp::Parameter> &changed, std::string &reason)
+{
+	auto param = [&](const std::string &key) {
+		for (auto &p : changed)
+			if (p.get_name() == "gcs_shaper/" + key)
+				return p;
+
+		return get_parameter("gcs_shaper/" + key);
+	};
+
+	auto enable = param("enable").as_bool();
+	auto bandwidth = param("bandwidth").as_double();
+	auto rate_msgids = param("rate_msgids").as_integer_array();
+	auto rate_hz = param("rate_hz").as_double_array();
+	auto priority = param("priority_msgids").as_integer_array();
+
+	if (rate_msgids.size() != rate_hz.size()) {
+		reason = "gcs_shaper/rate_msgids and rate_hz should have same size";
+		return false;
+	}
+
+	if (!enable) {
+		gcs_shaper.configure(0, {});
+		return true;
+	}
+
+	std::vector<mavconn::TxShaper::RateLimit> limits;
+	for (size_t i = 0; i < rate_msgids.size(); i++)
+		limits.push_back(mavconn::TxShaper::RateLimit { mavlink::msgid_t(rate_msgids[i]), float(rate_hz[i]) });
+
+	gcs_shaper.configure(bandwidth, limits, std::vector<mavlink::msgid_t>(priority.begin(), priority.end()));
+
+	RCLCPP_INFO(logger, "GCS shaper: %.0f B/s, %zu rate caps, %zu priority ids",
+			bandwidth, limits.size(), priority.size());
+	return true;
+}
+
+rcl_interfaces::msg::SetParametersResult MavRos::gcs_shaper_param_changed(const std::vector<rclcpp::Parameter> &parameters)
+{
+	rcl_interfaces::msg::SetParametersResult result;
+	result.successful = true;
+
+	for (auto &p : parameters) {
+		if (p.get_name().rfind("gcs_shaper/", 0) == 0) {
+			result.successful = apply_gcs_shaper(parameters, result.reason);
+			break;
+		}
+	}
+
+	return result;
+}
+
+void MavRos::plugin_route_cb(const mavlink_message_t *mmsg, const Framing framing, uint64_t stamp_ns)
+{
+	auto disp = vehicle_dispatcher[mmsg->sysid];
+	if (disp != nullptr)
+		disp->dispatch(mmsg, framing, stamp_ns);
+	else
+		plugin_dispatcher.dispatch(mmsg, framing, stamp_ns);
 }
 
 static bool pattern_match(std::string &pattern, std::string &pl_name)
@@ -287,10 +846,45 @@ inline bool is_mavlink_message_t(const size_t rt)
 	return h == rt;
 }
 
+std::vector<std::string> MavRos::get_plugin_names()
+{
+	auto names = plugin_loader.getDeclaredClasses();
+
+#ifdef MAVROS_STATIC_PLUGINS
+	// built-in plugins are not in any manifest, others (e.g. mavros_extras) come from pluginlib
+	names.erase(std::remove_if(names.begin(), names.end(), [&](const std::string &name) {
+				return plugin::PluginRegistry::has(name) ||
+				       plugin_loader.getClassPackage(name) == "mavros";
+			}), names.end());
+
+	auto builtin = plugin::PluginRegistry::get_names();
+	names.insert(names.begin(), builtin.begin(), builtin.end());
+#elif defined(MAVROS_BUILT_PLUGINS)
+	// mavros_plugins.xml declares all plugins, skip ones not selected by MAVROS_PLUGINS
+	const std::string built = "," MAVROS_BUILT_PLUGINS ",";
+	names.erase(std::remove_if(names.begin(), names.end(), [&](const std::string &name) {
+				return plugin_loader.getClassPackage(name) == "mavros" &&
+				       built.find("," + name + ",") == std::string::npos;
+			}), names.end());
+#endif
+
+	return names;
+}
+
+PluginBase::Ptr MavRos::create_plugin(const std::string &pl_name)
+{
+#ifdef MAVROS_STATIC_PLUGINS
+	if (plugin::PluginRegistry::has(pl_name))
+		return plugin::PluginRegistry::create(pl_name);
+#endif
+
+	return plugin_loader.createSharedInstance(pl_name);
+}
+
 /**
  * @brief Loads plugin (if not blacklisted)
  */
-void MavRos::add_plugin(std::string &pl_name, std::vector<std::string> &blacklist, std::vector<std::string> &whitelist)
+void MavRos::add_plugin(PluginSet &set, std::string &pl_name, std::vector<std::string> &blacklist, std::vector<std::string> &whitelist)
 {
 	if (is_blacklisted(pl_name, blacklist, whitelist)) {
 		RCLCPP_INFO(logger, "Plugin %s blacklisted", pl_name.c_str());
@@ -298,11 +892,36 @@ void MavRos::add_plugin(std::string &pl_name, std::vector<std::string> &blacklis
 	}
 
 	try {
-		auto plugin = plugin_loader.createSharedInstance(pl_name);
+		auto load_start = std::chrono::steady_clock::now();
+		auto plugin = create_plugin(pl_name);
+		std::chrono::duration<double, std::milli> load_time = std::chrono::steady_clock::now() - load_start;
 
 		RCLCPP_INFO(logger, "Plugin %s loaded", pl_name.c_str());
 
-		for (auto &info : plugin->get_subscriptions()) {
+		bool fast_path = false;
+		for (auto &pattern : dispatch_fast_path)
+			fast_path |= pattern_match(pattern, pl_name);
+
+		auto subscriptions = plugin->get_subscriptions();
+
+		// lazy plugin is initialized by dispatcher before its first message
+		bool lazy = plugin_lazy && !subscriptions.empty();
+		for (auto &pattern : plugin_eager)
+			lazy &= !pattern_match(pattern, pl_name);
+
+		PluginDispatcher::ActivateCb activate;
+		if (lazy) {
+			activate = [plugin, pl_name, uas = set.uas]() {
+				plugin->initialize(*uas);
+				RCLCPP_INFO(logger, "Plugin %s initialized by first message", pl_name.c_str());
+			};
+		}
+
+		auto dispatch_idx = set.dispatcher->add_plugin(pl_name, fast_path, std::max(dispatch_queue_size, 1), activate);
+		if (fast_path)
+			RCLCPP_INFO(logger, "Plugin %s handlers called by IO thread", pl_name.c_str());
+
+		for (auto &info : subscriptions) {
 			auto msgid = std::get<0>(info);
 			auto msgname = std::get<1>(info);
 			auto type_hash_ = std::get<2>(info);
@@ -316,12 +935,13 @@ void MavRos::add_plugin(std::string &pl_name, std::vector<std::string> &blacklis
 
 			RCLCPP_DEBUG(logger, "Route %s to %s", log_msgname.c_str(), pl_name.c_str());
 
-			auto it = plugin_subscriptions.find(msgid);
-			if (it == plugin_subscriptions.end()) {
+			auto it = set.subscriptions.find(msgid);
+			if (it == set.subscriptions.end()) {
 				// new entry
 
 				RCLCPP_DEBUG(logger, "%s - new element", log_msgname.c_str());
-				plugin_subscriptions[msgid] = PluginBase::Subscriptions{{info}};
+				set.subscriptions[msgid] = PluginBase::Subscriptions{{info}};
+				set.dispatcher->add_handler(dispatch_idx, msgid, std::get<3>(info));
 			}
 			else {
 				// existing: check handler message type
@@ -342,21 +962,233 @@ void MavRos::add_plugin(std::string &pl_name, std::vector<std::string> &blacklis
 				if (append_allowed) {
 					RCLCPP_DEBUG(logger, "%s - emplace", log_msgname.c_str());
 					it->second.emplace_back(info);
+					set.dispatcher->add_handler(dispatch_idx, msgid, std::get<3>(info));
 				}
 				else
 					RCLCPP_ERROR(logger, "%s handler dropped because this ID are used for another message type", log_msgname.c_str());
 			}
 		}
 
-		plugin->initialize(mav_uas);
-		loaded_plugins.push_back(plugin);
+		set.loaded.push_back(plugin);
+		if (lazy) {
+			RCLCPP_INFO(logger, "Plugin %s waits for first message", pl_name.c_str());
+			return;
+		}
 
-		RCLCPP_INFO(logger, "Plugin %s initialized", pl_name.c_str());
-	} catch (pluginlib::PluginlibException &ex) {
+		plugin_startup.push_back(PluginStartup { pl_name, set.uas, plugin, load_time.count(), 0.0 });
+	} catch (std::exception &ex) {
 		RCLCPP_ERROR(logger, "Plugin %s load exception: %s", pl_name.c_str(), ex.what());
 	}
 }
 
+void MavRos::initialize_plugins(size_t nthreads)
+{
+	auto start = std::chrono::steady_clock::now();
+	std::atomic<size_t> next { 0 };
+
+	auto worker = [&]() {
+		while (true) {
+			size_t i = next++;
+			if (i >= plugin_startup.size())
+				break;
+
+			auto &ps = plugin_startup[i];
+			auto init_start = std::chrono::steady_clock::now();
+
+			try {
+				ps.plugin->initialize(*ps.uas);
+			} catch (std::exception &ex) {
+				RCLCPP_ERROR(logger, "Plugin %s initialize exception: %s", ps.name.c_str(), ex.what());
+			}
+
+			std::chrono::duration<double, std::milli> init_time = std::chrono::steady_clock::now() - init_start;
+			ps.init_ms = init_time.count();
+			RCLCPP_INFO(logger, "Plugin %s initialized", ps.name.c_str());
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < std::min(nthreads, plugin_startup.size()); i++)
+		threads.emplace_back(worker);
+
+	worker();
+	for (auto &t : threads)
+		t.join();
+
+	std::chrono::duration<double, std::milli> total = std::chrono::steady_clock::now() - start;
+
+	// slowest first
+	std::sort(plugin_startup.begin(), plugin_startup.end(), [](const PluginStartup &a, const PluginStartup &b) {
+				return a.load_ms + a.init_ms > b.load_ms + b.init_ms;
+			});
+
+	for (auto &ps : plugin_startup)
+		RCLCPP_INFO(logger, "Plugin %s startup: load %.1f ms, initialize %.1f ms",
+				ps.name.c_str(), ps.load_ms, ps.init_ms);
+
+	RCLCPP_INFO(logger, "%zu plugins initialized in %.1f ms by %zu threads",
+			plugin_startup.size(), total.count(), std::max<size_t>(std::min(nthreads, plugin_startup.size()), 1));
+
+	plugin_startup.clear();
+}
+
+void MavRos::add_vehicles(const std::vector<int64_t> &sysids, int tgt_component_id,
+		std::vector<std::string> &blacklist, std::vector<std::string> &whitelist)
+{
+	auto fcu_link = UAS_FCU(&mav_uas);
+
+	// vehicle plugins get config of main node, parameters of lazy plugins are not declared yet
+	auto names = list_parameters({}, rcl_interfaces::srv::ListParameters::Request::DEPTH_RECURSIVE).names;
+	auto options = rclcpp::NodeOptions()
+		.context(get_node_base_interface()->get_context())
+		.use_global_arguments(false)		// remaps are for main node
+		.use_intra_process_comms(get_node_options().use_intra_process_comms())
+		.parameter_overrides(get_parameters(names));
+
+	std::string ns = get_namespace();
+	if (ns.back() != '/')
+		ns += '/';
+
+	for (auto sysid : sysids) {
+		if (sysid < 1 || sysid > 255 || sysid == mav_uas.get_tgt_system() || vehicle_dispatcher[sysid] != nullptr) {
+			RCLCPP_ERROR(logger, "Vehicle %ld: bad or duplicate system id, skipped", long(sysid));
+			continue;
+		}
+
+		std::unique_ptr<Vehicle> v(new Vehicle);
+		v->node = std::make_shared<rclcpp::Node>("mavlink", ns + utils::format("uas%ld", long(sysid)), options);
+		v->uas.reset(new UAS(v->node.get()));
+		v->dispatcher.reset(new PluginDispatcher(&UAS::set_rx_stamp));
+		v->plugins = PluginSet { v->uas.get(), v->dispatcher.get(), {}, {} };
+
+		v->uas->set_tgt(sysid, tgt_component_id);
+		UAS_FCU(v->uas.get()) = fcu_link;
+		v->uas->tf2_batcher.set_window(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+					std::chrono::duration<double>(tf_batch_window)));
+		UAS_DIAG(v->uas.get()).setHardwareID(v->node->get_fully_qualified_name());
+		v->uas->add_connection_change_handler([sysid](bool connected) {
+					if (connected)
+						RCLCPP_INFO(logger, "CON: Vehicle %ld connected", long(sysid));
+					else
+						RCLCPP_WARN(logger, "CON: Vehicle %ld lost, HEARTBEAT timed out", long(sysid));
+				});
+
+		for (auto &name : get_plugin_names())
+			add_plugin(v->plugins, name, blacklist, whitelist);
+
+		RCLCPP_INFO(logger, "Vehicle %ld: %zu plugins in %s", long(sysid), v->plugins.loaded.size(),
+				v->node->get_namespace());
+
+		vehicle_dispatcher[sysid] = v->dispatcher.get();
+		vehicles.emplace_back(std::move(v));
+	}
+}
+
+void MavRos::start_vehicles(size_t nthreads)
+{
+	if (vehicles.empty())
+		return;
+
+	vehicle_executor.reset(new rclcpp::executors::MultiThreadedExecutor());
+	for (auto &v : vehicles) {
+		v->dispatcher->start(nthreads);
+		vehicle_executor->add_node(v->node);
+	}
+
+	vehicle_spinner = std::thread([this]() {
+				mavconn::utils::set_this_thread_name("mvvehicles");
+				vehicle_executor->spin();
+			});
+}
+
+void MavRos::setup_link_protocol(const char *name, const std::string &protocol, MAVConnInterface *link,
+		std::unique_ptr<ProtocolNegotiator> &negotiator, bool probe)
+{
+	if (protocol == "v2.0") {
+		link->set_protocol_version(mavconn::Protocol::V20);
+		return;
+	}
+	else if (protocol == "auto") {
+		negotiator = std::make_unique<ProtocolNegotiator>(probe);
+		link->set_protocol_version(negotiator->get_protocol());
+		return;
+	}
+	else if (protocol != "v1.0")
+		RCLCPP_WARN(logger, "Unknown %s protocol: \"%s\", should be: \"v1.0\", \"v2.0\" or \"auto\". Used default v1.0.",
+				name, protocol.c_str());
+
+	link->set_protocol_version(mavconn::Protocol::V10);
+}
+
+void MavRos::negotiate_rx(const char *name, MAVConnInterface *link, ProtocolNegotiator &negotiator,
+		const mavlink_message_t *msgs, size_t count)
+{
+	if (negotiator.get_state() == ProtocolNegotiator::State::V2)
+		return;
+
+	auto now = ProtocolNegotiator::clock::now();
+	for (size_t i = 0; i < count; i++) {
+		auto prev = negotiator.get_state();
+		if (negotiator.frame_received(msgs[i].magic, msgs[i].msgid, now)) {
+			link->set_protocol_version(negotiator.get_protocol());
+			RCLCPP_INFO(logger, "%s: peer talks MAVLink 2, switched to it", name);
+			return;
+		}
+
+		if (prev != negotiator.get_state())
+			RCLCPP_INFO(logger, "%s: peer talks MAVLink 1, %s", name,
+					ProtocolNegotiator::to_string(negotiator.get_state()));
+	}
+}
+
+void MavRos::protocol_cb()
+{
+	auto fcu_link = UAS_FCU(&mav_uas);
+	auto state = fcu_negotiator->get_state();
+	if (state == ProtocolNegotiator::State::V2 || state == ProtocolNegotiator::State::WAIT_HEARTBEAT)
+		return;
+
+	// AUTOPILOT_VERSION may come before probe answer
+	if ((mav_uas.get_capabilities() & enum_value(mavlink::common::MAV_PROTOCOL_CAPABILITY::MAVLINK2)) &&
+			fcu_negotiator->mavlink2_supported()) {
+		fcu_link->set_protocol_version(fcu_negotiator->get_protocol());
+		RCLCPP_INFO(logger, "FCU: MAVLINK2 capability, switched to MAVLink 2");
+		return;
+	}
+
+	if (fcu_negotiator->probe_due(ProtocolNegotiator::clock::now())) {
+		RCLCPP_DEBUG(logger, "FCU: probing MAVLink 2");
+		auto probe = ProtocolNegotiator::make_probe(fcu_link->get_system_id(), fcu_link->get_component_id(),
+				mav_uas.get_tgt_system(), mav_uas.get_tgt_component(), probe_seq++);
+		fcu_link->send_message_ignore_drop(&probe);
+	}
+	else if (fcu_negotiator->get_state() == ProtocolNegotiator::State::V1 && state == ProtocolNegotiator::State::PROBE)
+		RCLCPP_WARN(logger, "FCU: no answer to MAVLink 2 probe, staying on MAVLink 1");
+}
+
+void MavRos::high_latency_cb()
+{
+	auto now = HighLatencyMode::clock::now();
+	auto probe = gcs_link->get_link_probe();
+	float rtt_ms = probe ? probe->get_stats().rtt_ms : 0.0f;
+
+	if (gcs_high_latency->update(now, gcs_link->get_link_stats().tx_drops, rtt_ms)) {
+		if (gcs_high_latency->is_active())
+			RCLCPP_WARN(logger, "GCS: low bandwidth link (RTT %.0f ms), streams replaced by HIGH_LATENCY2", rtt_ms);
+		else
+			RCLCPP_INFO(logger, "GCS: link recovered, forwarding all streams");
+
+		high_latency_next = now;
+	}
+
+	if (!gcs_high_latency->is_active() || now < high_latency_next || !high_latency_encoder.ready())
+		return;
+
+	high_latency_next = now + high_latency_interval;
+	auto report = high_latency_encoder.make(mav_uas.get_tgt_system(), mav_uas.get_tgt_component(), high_latency_seq++);
+	gcs_forward(&report);
+}
+
 void MavRos::startup_px4_usb_quirk()
 {
        /* sample code from QGC */
@@ -379,3 +1211,5 @@ void MavRos::log_connect_change(bool connected)
 	else
 		RCLCPP_WARN(logger, "CON: Lost connection, HEARTBEAT timed out.");
 }
+
+RCLCPP_COMPONENTS_REGISTER_NODE(mavros::MavRos)
@@ -0,0 +1,41 @@
+/**
+ * @brief Mission id reported by FCU
+ * @file mission_id.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <mavros/mission_id.h>
+
+using namespace mavros;
+
+constexpr std::chrono::seconds MissionIdTracker::MAX_AGE;
+
+MissionIdTracker::MissionIdTracker(clock::duration max_age_) :
+	max_age(max_age_),
+	opaque_id(0),
+	stamp{}
+{ }
+
+void MissionIdTracker::report(uint32_t opaque_id_, clock::time_point now)
+{
+	opaque_id = opaque_id_;
+	stamp = now;
+}
+
+void MissionIdTracker::reset()
+{
+	opaque_id = 0;
+	stamp = {};
+}
+
+bool MissionIdTracker::confirms(uint32_t opaque_id_, clock::time_point now) const
+{
+	return opaque_id_ != 0 && opaque_id_ == opaque_id && now - stamp <= max_age;
+}
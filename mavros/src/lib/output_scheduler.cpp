@@ -0,0 +1,105 @@
+/**
+ * @brief Rate limited, change driven output
+ * @file output_scheduler.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <mavros/output_scheduler.h>
+
+using namespace mavros;
+
+OutputScheduler::OutputScheduler(const Options &opts_) :
+	opts(opts_),
+	have_sent(false),
+	pending(false),
+	stats {}
+{ }
+
+void OutputScheduler::set_options(const Options &opts_)
+{
+	opts = opts_;
+}
+
+OutputScheduler::Options OutputScheduler::from_rates(double rate, double keepalive_rate, double change_threshold)
+{
+	auto to_period = [](double r) -> clock::duration {
+				 if (r <= 0.0)
+					 return clock::duration::zero();
+
+				 return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / r));
+			 };
+
+	Options opts;
+	opts.period = to_period(rate);
+	opts.keepalive = to_period(keepalive_rate);
+	opts.change_threshold = std::max(change_threshold, 0.0);
+	return opts;
+}
+
+void OutputScheduler::sent(clock::time_point now)
+{
+	have_sent = true;
+	pending = false;
+	last_sent = now;
+	stats.sent++;
+}
+
+bool OutputScheduler::update(double change, clock::time_point now)
+{
+	stats.received++;
+	pending = true;
+
+	if (!have_sent || opts.period == clock::duration::zero() || now - last_sent >= opts.period) {
+		sent(now);
+		return true;
+	}
+
+	if (opts.change_threshold > 0.0 && change >= opts.change_threshold) {
+		stats.immediate++;
+		sent(now);
+		return true;
+	}
+
+	return false;
+}
+
+bool OutputScheduler::tick(clock::time_point now)
+{
+	if (!have_sent)
+		return false;
+
+	if (pending && now - last_sent >= opts.period) {
+		sent(now);
+		return true;
+	}
+
+	if (opts.keepalive > clock::duration::zero() && now - last_sent >= opts.keepalive) {
+		stats.keepalive++;
+		sent(now);
+		return true;
+	}
+
+	return false;
+}
+
+void OutputScheduler::reset()
+{
+	have_sent = false;
+	pending = false;
+}
+
+OutputScheduler::clock::duration OutputScheduler::timer_period() const
+{
+	if (opts.period > clock::duration::zero())
+		return opts.period;
+
+	return opts.keepalive;
+}
@@ -0,0 +1,468 @@
+/**
+ * @brief Plugin message dispatcher
+ * @file plugin_dispatch.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <mavconn/thread_utils.h>
+#include <mavros/plugin_dispatch.h>
+
+using namespace mavros;
+using mavconn::Framing;
+using mavlink::mavlink_message_t;
+using mavlink::msgid_t;
+
+static constexpr auto RLX = std::memory_order_relaxed;
+
+MessageHandler MessageHandler::from_function(mavconn::MAVConnInterface::ReceivedCb cb)
+{
+	using Cb = mavconn::MAVConnInterface::ReceivedCb;
+
+	return MessageHandler {
+		[](const void *obj, const mavlink_message_t *msg, const Framing framing, const void *decoded) {
+			(*static_cast<const Cb *>(obj))(msg, framing);
+		},
+		std::make_shared<const Cb>(std::move(cb)),
+		nullptr
+	};
+}
+
+PluginDispatcher::PluginDispatcher(StampCb stamp_cb_) :
+	stamp_cb(stamp_cb_),
+	compiled(false),
+	routes(1, Route { 0, 0, nullptr, false }),
+	page_of {},
+	pages(1),
+	decoded_size(0),
+	profiling(false),
+	running(false)
+{
+	// page 0 is empty, so lookup before start() finds nothing
+	pages[0].fill(0);
+}
+
+PluginDispatcher::~PluginDispatcher()
+{
+	stop();
+
+	// frames left in queues still hold decoded objects
+	for (auto &lane : lanes) {
+		for (auto tail = lane->tail.load(); tail != lane->head.load(); tail++) {
+			auto &f = lane->ring[tail & lane->mask];
+			if (f.decoded)
+				release_decoded(f.decoded);
+		}
+	}
+
+	for (auto d : decoded_free)
+		::operator delete(d);
+}
+
+size_t PluginDispatcher::add_plugin(const std::string &name, bool fast_path, size_t queue_size, ActivateCb activate)
+{
+	assert(!compiled);
+
+	// power of two, so index is a mask
+	size_t size = 1;
+	while (size < queue_size)
+		size <<= 1;
+
+	std::unique_ptr<Lane> lane(new Lane);
+	lane->name = name;
+	lane->fast_path = fast_path;
+	lane->activate = std::move(activate);
+	lane->active = !lane->activate;
+	lane->ring.resize(fast_path ? 0 : size);
+	lane->mask = size - 1;
+	lane->head = 0;
+	lane->tail = 0;
+	lane->scheduled = false;
+	lane->handled = 0;
+	lane->dropped = 0;
+	lane->high_water = 0;
+
+	lanes.emplace_back(std::move(lane));
+	return lanes.size() - 1;
+}
+
+void PluginDispatcher::add_handler(size_t plugin, msgid_t msgid, Handler handler)
+{
+	assert(!compiled);
+
+	lanes[plugin]->handlers[msgid].emplace_back(std::move(handler));
+}
+
+void PluginDispatcher::compile()
+{
+	// msgid -> targets in plugin load order
+	std::vector<std::pair<msgid_t, Target>> all;
+	for (size_t i = 0; i < lanes.size(); i++) {
+		auto &lane = *lanes[i];
+		for (auto &kv : lane.handlers)
+			all.emplace_back(kv.first, Target { &lane, i, kv.second.data(), kv.second.size(), false, kv.first, nullptr });
+	}
+
+	std::stable_sort(all.begin(), all.end(), [](const std::pair<msgid_t, Target> &a, const std::pair<msgid_t, Target> &b) {
+				return (a.first != b.first) ? a.first < b.first : a.second.lane_idx < b.second.lane_idx;
+			});
+
+	for (size_t i = 0; i < all.size(); ) {
+		auto msgid = all[i].first;
+		uint32_t begin = targets.size();
+		for (; i < all.size() && all[i].first == msgid; i++) {
+			profiles.emplace_back(new HandlerProfile);
+			targets.push_back(all[i].second);
+			targets.back().profile = profiles.back().get();
+		}
+
+		uint32_t route = routes.size();
+		routes.push_back(Route { begin, uint32_t(targets.size()), nullptr, false });
+		share_decoded(routes.back());
+
+		if (msgid >= DIRECT_PAGES * PAGE_SIZE) {
+			high_routes.emplace_back(msgid, route);
+			continue;
+		}
+
+		auto &page = page_of[msgid >> 8];
+		if (page == 0) {
+			page = pages.size();
+			pages.emplace_back();
+			pages.back().fill(0);
+		}
+
+		pages[page][msgid & 0xff] = route;
+	}
+
+	compiled = true;
+}
+
+void PluginDispatcher::share_decoded(Route &route)
+{
+	// single typed handler decodes itself, no need to pay for sharing
+	const MessageDecoder *decoder = nullptr;
+	size_t ntyped = 0;
+	for (auto t = route.begin; t < route.end; t++) {
+		auto &target = targets[t];
+		for (size_t i = 0; i < target.nhandlers; i++) {
+			auto d = target.handlers[i].decoder;
+			if (d == nullptr)
+				continue;
+
+			// mixed types on one msgid, each keeps decoding its own
+			if (decoder != nullptr && decoder->type_hash != d->type_hash)
+				return;
+
+			decoder = d;
+			ntyped++;
+		}
+	}
+
+	if (ntyped < 2)
+		return;
+
+	route.decoder = decoder;
+	for (auto t = route.begin; t < route.end; t++) {
+		auto &target = targets[t];
+		for (size_t i = 0; i < target.nhandlers; i++)
+			target.typed |= target.handlers[i].decoder != nullptr;
+
+		route.queued_typed |= target.typed && !target.lane->fast_path;
+	}
+
+	decoded_size = std::max(decoded_size, decoder->size);
+	scratch.resize((decoded_size + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t));
+}
+
+const PluginDispatcher::Route &PluginDispatcher::find_high_route(msgid_t msgid) const
+{
+	auto it = std::lower_bound(high_routes.begin(), high_routes.end(), msgid,
+			[](const std::pair<msgid_t, uint32_t> &e, msgid_t id) { return e.first < id; });
+
+	return (it != high_routes.end() && it->first == msgid) ? routes[it->second] : routes[0];
+}
+
+void PluginDispatcher::start(size_t nthreads)
+{
+	if (!compiled)
+		compile();
+
+	if (nthreads == 0 || running.exchange(true))
+		return;
+
+	std::lock_guard<std::mutex> lock(workers_mutex);
+	for (size_t i = 0; i < nthreads; i++) {
+		workers.emplace_back([this, i] () {
+					mavconn::utils::set_this_thread_name("mvdisp%zu", i);
+					do_work();
+				});
+	}
+}
+
+void PluginDispatcher::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(ready_mutex);
+		running = false;
+		ready_cond.notify_all();
+	}
+
+	std::lock_guard<std::mutex> lock(workers_mutex);
+	for (auto &w : workers)
+		w.join();
+
+	workers.clear();
+}
+
+int PluginDispatcher::set_thread_sched(const mavconn::utils::ThreadSched &sched)
+{
+	std::lock_guard<std::mutex> lock(workers_mutex);
+
+	int first_err = 0;
+	for (auto &w : workers) {
+		int ret = mavconn::utils::set_thread_sched(w.native_handle(), sched);
+		if (ret != 0 && first_err == 0)
+			first_err = ret;
+	}
+
+	return first_err;
+}
+
+std::vector<mavconn::utils::ThreadSched> PluginDispatcher::get_thread_sched()
+{
+	std::lock_guard<std::mutex> lock(workers_mutex);
+	std::vector<mavconn::utils::ThreadSched> ret;
+
+	for (auto &w : workers)
+		ret.push_back(mavconn::utils::get_thread_sched(w.native_handle()));
+
+	return ret;
+}
+
+void PluginDispatcher::dispatch(const mavlink_message_t *msg, Framing framing, uint64_t stamp_ns)
+{
+	auto &route = find_route(msg->msgid);
+	if (route.begin == route.end)
+		return;
+
+	bool queued = running.load(RLX);
+
+	// decode once for all typed handlers
+	Decoded *shared = nullptr;
+	void *decoded = nullptr;
+	if (route.decoder != nullptr && framing == Framing::ok) {
+		if (queued && route.queued_typed) {
+			shared = alloc_decoded(route.decoder);
+			decoded = shared->storage();
+		}
+		else {
+			decoded = scratch.data();
+		}
+
+		route.decoder->decode(msg, decoded);
+	}
+
+	for (auto t = &targets[route.begin], end = &targets[route.end]; t != end; t++) {
+		if (t->lane->fast_path || !queued) {
+			ensure_active(*t->lane);
+			call_handlers(t->profile, t->handlers, t->nhandlers, msg, framing, decoded);
+
+			t->lane->handled.fetch_add(1, RLX);
+			continue;
+		}
+
+		push(*t, msg, framing, stamp_ns, t->typed ? shared : nullptr);
+	}
+
+	if (shared != nullptr)
+		release_decoded(shared);
+	else if (decoded != nullptr)
+		route.decoder->destroy(decoded);
+}
+
+PluginDispatcher::Decoded *PluginDispatcher::alloc_decoded(const MessageDecoder *decoder)
+{
+	Decoded *d = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(decoded_mutex);
+		if (!decoded_free.empty()) {
+			d = decoded_free.back();
+			decoded_free.pop_back();
+		}
+	}
+
+	if (d == nullptr)
+		d = static_cast<Decoded *>(::operator new(sizeof(Decoded) + decoded_size));
+
+	// one reference for dispatch() itself
+	d->refs.store(1, RLX);
+	d->decoder = decoder;
+	return d;
+}
+
+void PluginDispatcher::release_decoded(Decoded *d)
+{
+	if (d->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+
+	d->decoder->destroy(d->storage());
+
+	std::lock_guard<std::mutex> lock(decoded_mutex);
+	decoded_free.push_back(d);
+}
+
+void PluginDispatcher::push(const Target &t, const mavlink_message_t *msg, Framing framing, uint64_t stamp_ns, Decoded *decoded)
+{
+	auto &lane = *t.lane;
+	auto head = lane.head.load(RLX);
+	auto tail = lane.tail.load(std::memory_order_acquire);
+
+	if (head - tail >= lane.ring.size()) {
+		lane.dropped.fetch_add(1, RLX);
+		return;
+	}
+
+	if (decoded != nullptr)
+		decoded->refs.fetch_add(1, RLX);
+
+	auto &f = lane.ring[head & lane.mask];
+	f.msg = *msg;
+	f.framing = framing;
+	f.stamp_ns = stamp_ns;
+	f.handlers = t.handlers;
+	f.nhandlers = t.nhandlers;
+	f.decoded = decoded;
+	f.profile = t.profile;
+
+	// seq_cst pairs with worker clearing scheduled flag, so wakeup is never lost
+	lane.head.store(head + 1, std::memory_order_seq_cst);
+
+	auto depth = head + 1 - tail;
+	if (depth > lane.high_water.load(RLX))
+		lane.high_water.store(depth, RLX);
+
+	if (!lane.scheduled.exchange(true))
+		schedule(t.lane_idx);
+}
+
+void PluginDispatcher::activate_lane(Lane &lane)
+{
+	lane.activate();
+	lane.active.store(true, std::memory_order_release);
+}
+
+void PluginDispatcher::schedule(size_t idx)
+{
+	std::lock_guard<std::mutex> lock(ready_mutex);
+	ready.push_back(idx);
+	ready_cond.notify_one();
+}
+
+void PluginDispatcher::run_lane(size_t idx)
+{
+	auto &lane = *lanes[idx];
+
+	ensure_active(lane);
+	for (size_t n = 0; n < WORKER_BATCH; n++) {
+		auto tail = lane.tail.load(RLX);
+		if (tail == lane.head.load(std::memory_order_acquire))
+			break;
+
+		auto &f = lane.ring[tail & lane.mask];
+		if (stamp_cb)
+			stamp_cb(f.stamp_ns);
+
+		auto decoded = f.decoded;
+		call_handlers(f.profile, f.handlers, f.nhandlers, &f.msg, f.framing, decoded ? decoded->storage() : nullptr);
+
+		if (decoded)
+			release_decoded(decoded);
+
+		lane.handled.fetch_add(1, RLX);
+		lane.tail.store(tail + 1, std::memory_order_release);
+	}
+
+	if (stamp_cb)
+		stamp_cb(0);
+
+	// give lane back, take it again if producer pushed meanwhile
+	lane.scheduled.store(false);
+	if (lane.head.load() != lane.tail.load(RLX) && !lane.scheduled.exchange(true))
+		schedule(idx);
+}
+
+void PluginDispatcher::do_work()
+{
+	while (true) {
+		size_t idx;
+		{
+			std::unique_lock<std::mutex> lock(ready_mutex);
+			ready_cond.wait(lock, [this] () { return !running || !ready.empty(); });
+			if (!running)
+				return;
+
+			idx = ready.front();
+			ready.pop_front();
+		}
+
+		run_lane(idx);
+	}
+}
+
+std::vector<PluginDispatcher::Stat> PluginDispatcher::get_stats()
+{
+	std::vector<Stat> ret;
+
+	for (auto &lane : lanes) {
+		ret.push_back(Stat {
+				lane->name,
+				lane->fast_path,
+				lane->active.load(RLX),
+				lane->handled.load(RLX),
+				lane->dropped.load(RLX),
+				lane->high_water.load(RLX),
+			});
+	}
+
+	return ret;
+}
+
+void PluginDispatcher::set_profiling(bool enable)
+{
+	profiling.store(enable, RLX);
+}
+
+std::vector<PluginDispatcher::ProfileStat> PluginDispatcher::get_profile()
+{
+	std::vector<ProfileStat> ret;
+	double ns = tick_clock.ns_per_tick();
+
+	// targets are fixed after start()
+	for (auto &t : targets) {
+		auto s = t.profile->snapshot();
+		if (s.calls == 0)
+			continue;
+
+		ret.push_back(ProfileStat {
+				t.lane->name,
+				t.msgid,
+				t.lane->fast_path,
+				s.calls,
+				uint64_t(s.total * ns),
+				uint64_t(s.max * ns),
+				uint64_t(s.percentile(0.5) * ns),
+				uint64_t(s.percentile(0.99) * ns),
+			});
+	}
+
+	return ret;
+}
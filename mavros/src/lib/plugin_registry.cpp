@@ -0,0 +1,53 @@
+/**
+ * @brief Compile-time plugin registry
+ * @file plugin_registry.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <map>
+#include <stdexcept>
+#include <mavros/plugin_registry.h>
+
+using namespace mavros::plugin;
+
+//! Function static, so registrars of other translation units find it constructed
+static std::map<std::string, PluginRegistry::Factory> &registry()
+{
+	static std::map<std::string, PluginRegistry::Factory> factories;
+	return factories;
+}
+
+void PluginRegistry::add(const char *name, Factory factory)
+{
+	registry()[name] = factory;
+}
+
+std::vector<std::string> PluginRegistry::get_names()
+{
+	std::vector<std::string> names;
+	for (auto &kv : registry())
+		names.push_back(kv.first);
+
+	return names;
+}
+
+bool PluginRegistry::has(const std::string &name)
+{
+	return registry().count(name) != 0;
+}
+
+PluginBase::Ptr PluginRegistry::create(const std::string &name)
+{
+	auto it = registry().find(name);
+	if (it == registry().end())
+		throw std::out_of_range("plugin " + name + " is not built in");
+
+	return it->second();
+}
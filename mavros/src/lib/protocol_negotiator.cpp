@@ -0,0 +1,123 @@
+/**
+ * @brief MAVLink protocol version negotiation
+ * @file protocol_negotiator.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <mavros/protocol_negotiator.h>
+#include <mavros/utils.h>
+
+using namespace mavros;
+using mavlink::mavlink_message_t;
+
+ProtocolNegotiator::ProtocolNegotiator(bool probe_, clock::duration probe_interval_, size_t probe_count_) :
+	state(State::WAIT_HEARTBEAT),
+	probe(probe_),
+	probe_interval(probe_interval_),
+	probe_count(probe_count_),
+	probes_sent(0),
+	next_probe{}
+{ }
+
+bool ProtocolNegotiator::update(uint8_t magic, uint32_t msgid, clock::time_point now)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto st = state.load(std::memory_order_relaxed);
+
+	if (magic == MAVLINK_STX) {
+		if (st == State::V2)
+			return false;
+
+		// link is on MAVLink 1 in all other states
+		state = State::V2;
+		return true;
+	}
+
+	if (st != State::WAIT_HEARTBEAT || msgid != mavlink::common::msg::HEARTBEAT::MSG_ID)
+		return false;
+
+	// peer talks MAVLink 1, link is already on it
+	state = (probe && probe_count > 0) ? State::PROBE : State::V1;
+	probes_sent = 0;
+	next_probe = now;
+	return false;
+}
+
+bool ProtocolNegotiator::mavlink2_supported()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (state == State::V2)
+		return false;
+
+	state = State::V2;
+	return true;
+}
+
+bool ProtocolNegotiator::probe_due(clock::time_point now)
+{
+	if (get_state() != State::PROBE)
+		return false;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (state != State::PROBE || now < next_probe)
+		return false;
+
+	if (probes_sent >= probe_count) {
+		state = State::V1;
+		return false;
+	}
+
+	probes_sent++;
+	next_probe = now + probe_interval;
+	return true;
+}
+
+void ProtocolNegotiator::reset()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	state = State::WAIT_HEARTBEAT;
+	probes_sent = 0;
+}
+
+mavlink_message_t ProtocolNegotiator::make_probe(uint8_t sysid, uint8_t compid,
+		uint8_t target_system, uint8_t target_component, uint8_t seq)
+{
+	mavlink::common::msg::COMMAND_LONG cmd {};
+	cmd.target_system = target_system;
+	cmd.target_component = target_component;
+	cmd.command = utils::enum_value(mavlink::common::MAV_CMD::REQUEST_PROTOCOL_VERSION);
+	cmd.param1 = 1.0;
+
+	mavlink_message_t msg;
+	mavlink::MsgMap map(msg);
+	auto mi = cmd.get_message_info();
+
+	// no MAVLINK_STATUS_FLAG_OUT_MAVLINK1, so MAVLink 2 framing
+	mavlink::mavlink_status_t status {};
+	status.current_tx_seq = seq;
+
+	cmd.serialize(map);
+	mavlink::mavlink_finalize_message_buffer(&msg, sysid, compid, &status,
+			mi.min_length, mi.length, mi.crc_extra);
+
+	return msg;
+}
+
+const char *ProtocolNegotiator::to_string(State st)
+{
+	switch (st) {
+	case State::WAIT_HEARTBEAT:	return "waiting for HEARTBEAT";
+	case State::PROBE:		return "probing MAVLink 2";
+	case State::V1:			return "MAVLink 1";
+	case State::V2:			return "MAVLink 2";
+	}
+
+	return "unknown";
+}
@@ -0,0 +1,138 @@
+/**
+ * @brief Windowed requests of indexed items
+ * @file request_window.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <mavros/request_window.h>
+
+using namespace mavros;
+
+constexpr std::chrono::milliseconds RttEstimator::MIN_TIMEOUT;
+constexpr std::chrono::milliseconds RttEstimator::MAX_TIMEOUT;
+
+RttEstimator::RttEstimator(clock::duration initial_timeout_) :
+	initial_timeout(initial_timeout_),
+	have_rtt(false),
+	srtt_ns(0.0),
+	rttvar_ns(0.0)
+{ }
+
+void RttEstimator::sample(clock::duration rtt)
+{
+	double r = std::chrono::duration_cast<std::chrono::nanoseconds>(rtt).count();
+
+	if (!have_rtt) {
+		srtt_ns = r;
+		rttvar_ns = r / 2.0;
+		have_rtt = true;
+	}
+	else {
+		rttvar_ns = 0.75 * rttvar_ns + 0.25 * std::abs(srtt_ns - r);
+		srtt_ns = 0.875 * srtt_ns + 0.125 * r;
+	}
+}
+
+RttEstimator::clock::duration RttEstimator::timeout() const
+{
+	clock::duration rto = initial_timeout;
+	if (have_rtt)
+		rto = std::chrono::nanoseconds(int64_t(srtt_ns + 4.0 * rttvar_ns));
+
+	return std::min<clock::duration>(std::max<clock::duration>(rto, MIN_TIMEOUT), MAX_TIMEOUT);
+}
+
+RttEstimator::clock::duration RttEstimator::timeout(size_t tries) const
+{
+	auto rto = timeout() * (1 << std::min<size_t>(std::max<size_t>(tries, 1) - 1, 4));
+	return std::min<clock::duration>(rto, MAX_TIMEOUT);
+}
+
+RequestWindow::RequestWindow(size_t window_size_, size_t retries_, clock::duration initial_timeout) :
+	window_size(std::max<size_t>(window_size_, 1)),
+	retries(retries_),
+	rtt(initial_timeout),
+	missing_count(0),
+	lost_count(0),
+	cursor(0)
+{ }
+
+void RequestWindow::reset(size_t count)
+{
+	arrived.assign(count, false);
+	missing_count = count;
+	lost_count = 0;
+	cursor = 0;
+	requests.clear();
+	// RTT estimate kept, link is the same
+}
+
+bool RequestWindow::received(size_t index, clock::time_point now)
+{
+	if (index >= arrived.size() || arrived[index])
+		return false;
+
+	arrived[index] = true;
+	missing_count--;
+
+	auto it = std::find_if(requests.begin(), requests.end(),
+			[index](const Request &r) { return r.index == index; });
+	if (it != requests.end()) {
+		// Karn's rule: reply to resent request is ambiguous
+		if (it->tries == 1)
+			rtt.sample(now - it->sent);
+
+		requests.erase(it);
+	}
+	else if (index < cursor) {
+		// late reply to a request already given up
+		lost_count--;
+	}
+
+	return true;
+}
+
+size_t RequestWindow::poll(clock::time_point now, const SendFn &send)
+{
+	size_t newly_lost = 0;
+
+	for (auto it = requests.begin(); it != requests.end(); ) {
+		if (now < it->deadline) {
+			++it;
+			continue;
+		}
+
+		if (it->tries > retries) {
+			lost_count++;
+			newly_lost++;
+			it = requests.erase(it);
+			continue;
+		}
+
+		it->tries++;
+		it->sent = now;
+		it->deadline = now + rtt.timeout(it->tries);
+		send(it->index);
+		++it;
+	}
+
+	while (requests.size() < window_size && cursor < arrived.size()) {
+		auto index = cursor++;
+		if (arrived[index])
+			continue;
+
+		requests.push_back(Request { index, 1, now, now + rtt.timeout(1) });
+		send(index);
+	}
+
+	return newly_lost;
+}
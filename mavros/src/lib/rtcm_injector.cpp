@@ -0,0 +1,315 @@
+/**
+ * @brief RTCM stream framing and paced GPS_RTCM_DATA output
+ * @file rtcm_injector.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <mavros/rtcm_injector.h>
+
+using namespace mavros;
+
+constexpr size_t RtcmInjector::FRAGMENT_LEN;
+constexpr size_t RtcmInjector::MAX_FRAGMENTS;
+constexpr size_t RtcmInjector::UNIT_LEN;
+constexpr size_t RtcmInjector::FRAGMENT_OVERHEAD;
+constexpr size_t RtcmInjector::RTCM3_OVERHEAD;
+constexpr size_t RtcmInjector::RTCM3_MAX_LEN;
+
+static constexpr uint8_t RTCM3_PREAMBLE = 0xD3;
+
+//! Fragments of unit, zero length one terminates fragmented unit of whole fragments
+static size_t fragment_count(size_t len)
+{
+	if (len <= RtcmInjector::FRAGMENT_LEN)
+		return 1;
+
+	size_t n = (len + RtcmInjector::FRAGMENT_LEN - 1) / RtcmInjector::FRAGMENT_LEN;
+	if (len % RtcmInjector::FRAGMENT_LEN == 0 && n < RtcmInjector::MAX_FRAGMENTS)
+		n++;
+
+	return n;
+}
+
+static size_t wire_cost(size_t len)
+{
+	return len + fragment_count(len) * RtcmInjector::FRAGMENT_OVERHEAD;
+}
+
+RtcmInjector::RtcmInjector(const Options &opts_) :
+	opts(opts_),
+	pool(std::max<size_t>(opts_.pool_size, 1)),
+	back_open(false),
+	epoch(0),
+	have_data(false),
+	stream_head(0),
+	tokens(0.0),
+	seq(0),
+	stats {}
+{
+	free_units.reserve(pool.size());
+	for (size_t i = pool.size(); i > 0; i--)
+		free_units.push_back(i - 1);
+
+	stream_buf.reserve(2 * RTCM3_MAX_LEN);
+}
+
+uint32_t RtcmInjector::crc24q(const uint8_t *data, size_t len)
+{
+	uint32_t crc = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		crc ^= uint32_t(data[i]) << 16;
+		for (int b = 0; b < 8; b++) {
+			crc <<= 1;
+			if (crc & 0x1000000)
+				crc ^= 0x1864CFB;
+		}
+	}
+
+	return crc & 0xFFFFFF;
+}
+
+bool RtcmInjector::is_station_message(const uint8_t *frame, size_t len)
+{
+	if (len < 5 + 3)
+		return false;
+
+	uint16_t type = (uint16_t(frame[3]) << 4) | (frame[4] >> 4);
+	switch (type) {
+	case 1005:	// antenna reference point
+	case 1006:
+	case 1007:	// antenna descriptor
+	case 1008:
+	case 1033:	// receiver and antenna descriptor
+	case 1230:	// GLONASS code-phase biases
+		return true;
+	default:
+		return false;
+	}
+}
+
+void RtcmInjector::update_epoch(clock::time_point now)
+{
+	if (have_data && now - last_data > opts.epoch_gap) {
+		epoch++;
+		back_open = false;
+
+		// older epoch not sent yet, drop it
+		for (auto it = queue.begin(); it != queue.end(); ) {
+			if (!pool[*it].keep && pool[*it].epoch < epoch) {
+				free_units.push_back(*it);
+				it = queue.erase(it);
+				stats.stale_units++;
+			}
+			else
+				++it;
+		}
+	}
+
+	have_data = true;
+	last_data = now;
+}
+
+size_t RtcmInjector::take_unit()
+{
+	if (!free_units.empty()) {
+		auto idx = free_units.back();
+		free_units.pop_back();
+		return idx;
+	}
+
+	// pool empty, oldest is dropped
+	auto idx = queue.front();
+	queue.pop_front();
+	stats.overflow_units++;
+	if (queue.empty())
+		back_open = false;
+
+	return idx;
+}
+
+void RtcmInjector::append(const uint8_t *data, size_t len, bool keep)
+{
+	if (len == 0)
+		return;
+
+	// frame fits to last unit of same epoch
+	if (back_open && !queue.empty()) {
+		auto &u = pool[queue.back()];
+		if (u.len + len <= UNIT_LEN) {
+			std::memcpy(u.data.data() + u.len, data, len);
+			u.len += len;
+			u.keep |= keep;
+			return;
+		}
+	}
+
+	while (len > 0) {
+		auto idx = take_unit();
+		auto &u = pool[idx];
+		size_t n = std::min(len, UNIT_LEN);
+
+		std::memcpy(u.data.data(), data, n);
+		u.len = n;
+		u.epoch = epoch;
+		u.keep = keep;
+		queue.push_back(idx);
+
+		data += n;
+		len -= n;
+	}
+
+	back_open = true;
+}
+
+void RtcmInjector::push_stream(const uint8_t *data, size_t len, clock::time_point now)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	update_epoch(now);
+
+	stream_buf.insert(stream_buf.end(), data, data + len);
+
+	while (stream_head < stream_buf.size()) {
+		auto begin = stream_buf.data() + stream_head;
+		size_t avail = stream_buf.size() - stream_head;
+
+		auto preamble = static_cast<const uint8_t *>(std::memchr(begin, RTCM3_PREAMBLE, avail));
+		if (preamble == nullptr) {
+			stats.skipped_bytes += avail;
+			stream_head = stream_buf.size();
+			break;
+		}
+		else if (preamble != begin) {
+			stats.skipped_bytes += preamble - begin;
+			stream_head += preamble - begin;
+			continue;
+		}
+
+		if (avail < 3)
+			break;
+
+		// 6 reserved bits are zero
+		if (begin[1] & 0xFC) {
+			stats.skipped_bytes++;
+			stream_head++;
+			continue;
+		}
+
+		size_t frame_len = ((size_t(begin[1] & 0x03) << 8) | begin[2]) + RTCM3_OVERHEAD;
+		if (avail < frame_len)
+			break;
+
+		uint32_t crc = (uint32_t(begin[frame_len - 3]) << 16) | (uint32_t(begin[frame_len - 2]) << 8) | begin[frame_len - 1];
+		if (crc24q(begin, frame_len - 3) != crc) {
+			stats.crc_errors++;
+			stats.skipped_bytes++;
+			stream_head++;
+			continue;
+		}
+
+		stats.frames++;
+		append(begin, frame_len, is_station_message(begin, frame_len));
+		stream_head += frame_len;
+	}
+
+	// keep only partial frame
+	stream_buf.erase(stream_buf.begin(), stream_buf.begin() + stream_head);
+	stream_head = 0;
+}
+
+void RtcmInjector::push_message(const uint8_t *data, size_t len, clock::time_point now)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	update_epoch(now);
+	append(data, len, false);
+}
+
+size_t RtcmInjector::poll(SendFn send, clock::time_point now)
+{
+	std::lock_guard<std::mutex> poll_lock(poll_mutex);
+	size_t sent = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (opts.bandwidth > 0) {
+			// burst allows at least one unit
+			double burst = std::max<double>(opts.bandwidth / 10.0, wire_cost(UNIT_LEN));
+			double dt = std::chrono::duration<double>(now - last_refill).count();
+
+			if (last_refill == clock::time_point())
+				tokens = burst;
+			else if (dt > 0.0)
+				tokens = std::min(burst, tokens + opts.bandwidth * dt);
+
+			last_refill = now;
+		}
+	}
+
+	while (true) {
+		size_t idx;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (queue.empty())
+				break;
+
+			idx = queue.front();
+			double cost = wire_cost(pool[idx].len);
+			if (opts.bandwidth > 0 && tokens < cost)
+				break;
+
+			tokens -= cost;
+			queue.pop_front();
+			if (queue.empty())
+				back_open = false;
+		}
+
+		// unit is neither queued nor free, so it is not touched by push
+		auto &u = pool[idx];
+		size_t n = fragment_count(u.len);
+		uint8_t seq_u5 = uint8_t(seq & 0x1F) << 3;
+		seq++;
+
+		if (n == 1) {
+			send(Fragment { seq_u5, uint8_t(u.len), u.data.data() });
+		}
+		else {
+			for (size_t i = 0; i < n; i++) {
+				size_t off = std::min(i * FRAGMENT_LEN, u.len);
+				size_t len = std::min(FRAGMENT_LEN, u.len - off);
+
+				// LSB set - fragmented, next 2 bits - fragment id, next 5 bits - sequence id
+				uint8_t flags = 1 | uint8_t(i << 1) | seq_u5;
+				send(Fragment { flags, uint8_t(len), u.data.data() + off });
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.fragments += n;
+		stats.bytes += u.len;
+		free_units.push_back(idx);
+		sent += n;
+	}
+
+	return sent;
+}
+
+size_t RtcmInjector::queued() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return queue.size();
+}
+
+RtcmInjector::Stats RtcmInjector::get_stats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
@@ -0,0 +1,66 @@
+/**
+ * @brief Geofence check of position setpoints
+ * @file setpoint_geofence.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <cmath>
+#include <mavros/setpoint_geofence.h>
+
+namespace mavros {
+//! POSITION_TARGET_TYPEMASK X_IGNORE | Y_IGNORE
+static constexpr uint16_t XY_IGNORE = 3;
+
+bool setpoint_geofence(const GeofenceIndex *fence, Eigen::Vector2d &enu)
+{
+	if (!fence || fence->get_options().action == GeofenceIndex::Action::NONE || fence->contains(enu))
+		return true;
+
+	return fence->get_options().action == GeofenceIndex::Action::CLAMP && fence->clamp(enu);
+}
+
+bool setpoint_geofence_local_ned(const GeofenceIndex *fence, uint16_t type_mask, Eigen::Vector3d &ned)
+{
+	if (!fence || (type_mask & XY_IGNORE))
+		return true;
+
+	Eigen::Vector2d enu(ned.y(), ned.x());
+	if (!setpoint_geofence(fence, enu))
+		return false;
+
+	ned.x() = enu.y();
+	ned.y() = enu.x();
+	return true;
+}
+
+bool setpoint_geofence_global_int(const GeofenceIndex *fence, uint16_t type_mask, int32_t &lat_int, int32_t &lon_int)
+{
+	if (!fence || (type_mask & XY_IGNORE))
+		return true;
+
+	auto &origin = fence->get_origin();
+	Eigen::Vector2d enu = GeofenceIndex::to_local(origin, lat_int / 1e7, lon_int / 1e7);
+	Eigen::Vector2d orig = enu;
+	if (!setpoint_geofence(fence, enu))
+		return false;
+
+	if (enu != orig) {
+		double lat, lon;
+		GeofenceIndex::to_global(origin, enu, lat, lon);
+		lat_int = std::lround(lat * 1e7);
+		lon_int = std::lround(lon * 1e7);
+	}
+
+	return true;
+}
+}	// namespace mavros
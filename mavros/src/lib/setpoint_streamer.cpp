@@ -0,0 +1,117 @@
+/**
+ * @brief Fixed rate setpoint resend thread
+ * @file setpoint_streamer.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <mavconn/thread_utils.h>
+#include <mavros/setpoint_streamer.h>
+
+using namespace mavros;
+
+SetpointStreamer::SetpointStreamer() :
+	running(false),
+	have_setpoint(false),
+	period(0),
+	stale_timeout(0),
+	stats {},
+	jitter_sum_ns(0.0)
+{ }
+
+SetpointStreamer::~SetpointStreamer()
+{
+	stop();
+}
+
+void SetpointStreamer::start(clock::duration period_, clock::duration stale_timeout_, TickFn tick)
+{
+	stop();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	period = std::max<clock::duration>(period_, std::chrono::milliseconds(1));
+	stale_timeout = stale_timeout_;
+	tick_fn = std::move(tick);
+	have_setpoint = false;
+	stats = Stats {};
+	jitter_sum_ns = 0.0;
+
+	running = true;
+	thread = std::thread(&SetpointStreamer::run, this);
+}
+
+void SetpointStreamer::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!running)
+			return;
+
+		running = false;
+	}
+
+	cond.notify_all();
+	thread.join();
+}
+
+void SetpointStreamer::update(clock::time_point now)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	have_setpoint = true;
+	last_update = now;
+}
+
+SetpointStreamer::Stats SetpointStreamer::get_stats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto ret = stats;
+	if (stats.ticks > 0)
+		ret.jitter_mean = std::chrono::nanoseconds(int64_t(jitter_sum_ns / stats.ticks));
+
+	return ret;
+}
+
+void SetpointStreamer::run()
+{
+	mavconn::utils::set_this_thread_name("mvsetpoint");
+
+	std::unique_lock<std::mutex> lock(mutex);
+	auto deadline = clock::now() + period;
+
+	while (running) {
+		cond.wait_until(lock, deadline, [this] { return !running; });
+		if (!running)
+			break;
+
+		auto now = clock::now();
+		auto lateness = now - deadline;
+
+		// absolute schedule, missed slots are skipped
+		auto missed = lateness / period;
+		stats.skipped += missed;
+		deadline += period * (missed + 1);
+
+		if (!have_setpoint)
+			continue;
+
+		bool stale = now - last_update > stale_timeout;
+
+		stats.ticks++;
+		stats.stale_ticks += stale;
+		stats.deadline_misses += lateness > period / 2;
+		stats.jitter_max = std::max(stats.jitter_max, lateness);
+		jitter_sum_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(lateness).count();
+
+		// tick may take time, update() and get_stats() are not blocked by it
+		lock.unlock();
+		tick_fn(stale);
+		lock.lock();
+	}
+}
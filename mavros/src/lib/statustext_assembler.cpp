@@ -0,0 +1,204 @@
+/**
+ * @brief STATUSTEXT chunk reassembly and repeat suppression
+ * @file statustext_assembler.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <mavros/statustext_assembler.h>
+
+using namespace mavros;
+
+constexpr size_t StatusTextAssembler::CHUNK_LEN;
+constexpr size_t StatusTextAssembler::MAX_CHUNKS;
+constexpr size_t StatusTextAssembler::POOL_SIZE;
+constexpr size_t StatusTextAssembler::RECENT_SIZE;
+
+static const char MISSING[] = "...";
+
+//! FNV-1a
+static uint64_t text_hash(const std::string &text)
+{
+	uint64_t h = 14695981039346656037ULL;
+	for (auto c : text) {
+		h ^= uint8_t(c);
+		h *= 1099511628211ULL;
+	}
+
+	return h;
+}
+
+StatusTextAssembler::StatusTextAssembler(const Options &opts_) :
+	opts(opts_),
+	stats{},
+	pool{},
+	recent{}
+{
+	for (auto &c : pool)
+		c.text.reserve(CHUNK_LEN * MAX_CHUNKS + sizeof(MISSING));
+
+	single.reserve(CHUNK_LEN);
+}
+
+void StatusTextAssembler::set_options(const Options &opts_)
+{
+	opts = opts_;
+}
+
+void StatusTextAssembler::push(uint16_t sender, uint16_t id, uint8_t chunk_seq, uint8_t severity,
+		const char *text, clock::time_point now, const EmitFn &emit)
+{
+	size_t len = strnlen(text, CHUNK_LEN);
+
+	if (id == 0) {
+		single.assign(text, len);
+		emit_text(severity, single, false, now, emit);
+		return;
+	}
+
+	auto it = std::find_if(pool.begin(), pool.end(), [&](const Chunks &c) {
+				return c.used && c.sender == sender && c.id == id;
+			});
+
+	// sequence started again: previous text lost its tail
+	if (it != pool.end() && chunk_seq < it->next_seq) {
+		it->incomplete = true;
+		finish(*it, now, emit);
+		it = pool.end();
+	}
+
+	if (it == pool.end()) {
+		it = std::find_if(pool.begin(), pool.end(), [](const Chunks &c) { return !c.used; });
+		if (it == pool.end()) {
+			it = std::min_element(pool.begin(), pool.end(), [](const Chunks &a, const Chunks &b) {
+						return a.started < b.started;
+					});
+			it->incomplete = true;
+			finish(*it, now, emit);
+		}
+
+		it->used = true;
+		it->sender = sender;
+		it->id = id;
+		it->severity = severity;
+		it->next_seq = 0;
+		it->incomplete = false;
+		it->started = now;
+		it->text.clear();
+	}
+
+	// tail of text already cut
+	if (chunk_seq >= MAX_CHUNKS) {
+		if (it->text.empty()) {
+			it->used = false;
+			return;
+		}
+
+		it->incomplete = true;
+		finish(*it, now, emit);
+		return;
+	}
+
+	if (chunk_seq != it->next_seq) {
+		it->incomplete = true;
+		it->text.append(MISSING);
+	}
+
+	it->text.append(text, len);
+	it->next_seq = chunk_seq + 1;
+
+	if (len < CHUNK_LEN || it->next_seq == MAX_CHUNKS) {
+		it->incomplete |= len == CHUNK_LEN;
+		finish(*it, now, emit);
+	}
+}
+
+void StatusTextAssembler::flush(clock::time_point now, const EmitFn &emit)
+{
+	for (auto &c : pool) {
+		// text of exactly N * CHUNK_LEN has no short chunk, so tail loss is not told apart
+		if (c.used && now - c.started >= opts.chunk_timeout)
+			finish(c, now, emit);
+	}
+
+	for (auto &r : recent) {
+		if (!r.used || r.suppressed == 0 || now - r.emitted < opts.repeat_window)
+			continue;
+
+		Text t{r.severity, r.text, r.suppressed, false};
+		r.suppressed = 0;
+		r.emitted = now;
+		stats.texts++;
+		emit(t);
+	}
+}
+
+void StatusTextAssembler::finish(Chunks &c, clock::time_point now, const EmitFn &emit)
+{
+	c.used = false;
+	stats.chunked++;
+	emit_text(c.severity, c.text, c.incomplete, now, emit);
+}
+
+void StatusTextAssembler::emit_text(uint8_t severity, const std::string &text, bool incomplete,
+		clock::time_point now, const EmitFn &emit)
+{
+	if (incomplete)
+		stats.incomplete++;
+
+	if (opts.repeat_window <= clock::duration::zero()) {
+		stats.texts++;
+		emit(Text{severity, text, 0, incomplete});
+		return;
+	}
+
+	auto hash = text_hash(text);
+	auto it = std::find_if(recent.begin(), recent.end(), [&](const Recent &r) {
+				return r.used && r.hash == hash && r.severity == severity && r.text == text;
+			});
+
+	if (it != recent.end()) {
+		if (now - it->emitted < opts.repeat_window) {
+			it->suppressed++;
+			stats.suppressed++;
+			return;
+		}
+
+		size_t repeated = it->suppressed;
+		it->suppressed = 0;
+		it->emitted = now;
+		stats.texts++;
+		emit(Text{severity, it->text, repeated, incomplete});
+		return;
+	}
+
+	// least recently emitted place is taken, its pending count goes out first
+	it = std::min_element(recent.begin(), recent.end(), [](const Recent &a, const Recent &b) {
+				if (a.used != b.used)
+					return !a.used;
+
+				return a.emitted < b.emitted;
+			});
+
+	if (it->used && it->suppressed > 0) {
+		stats.texts++;
+		emit(Text{it->severity, it->text, it->suppressed, false});
+	}
+
+	it->used = true;
+	it->severity = severity;
+	it->hash = hash;
+	it->suppressed = 0;
+	it->emitted = now;
+	it->text.assign(text);
+	stats.texts++;
+	emit(Text{severity, it->text, 0, incomplete});
+}
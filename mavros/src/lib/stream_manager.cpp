@@ -0,0 +1,156 @@
+/**
+ * @brief MESSAGE_INTERVAL from topic demand
+ * @file stream_manager.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <mavros/stream_manager.h>
+
+using namespace mavros;
+
+constexpr float StreamManager::INTERVAL_DEFAULT;
+constexpr float StreamManager::INTERVAL_STOP;
+
+StreamManager::StreamManager(const Options &opts_) :
+	opts(opts_),
+	have_started(false)
+{ }
+
+void StreamManager::set_options(const Options &opts_)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	opts = opts_;
+}
+
+StreamManager::DemandId StreamManager::add_demand(const std::string &topic, const std::vector<uint32_t> &msgids, double default_rate)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	demands.push_back(Demand { topic, msgids, default_rate, 0.0 });
+	for (auto msgid : msgids)
+		streams.emplace(msgid, Stream {});
+
+	return demands.size() - 1;
+}
+
+void StreamManager::set_rate(DemandId id, double rate)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (id < demands.size())
+		demands[id].rate = std::max(rate, 0.0);
+}
+
+void StreamManager::set_manual(uint32_t msgid)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	manual.insert(msgid);
+}
+
+bool StreamManager::is_faster(float a, float b)
+{
+	// > 0 - interval, 0 and -1 - not requested rate
+	if (a <= 0.0f)
+		return false;
+
+	return b <= 0.0f || a < b;
+}
+
+std::vector<StreamManager::Request> StreamManager::update(clock::time_point now)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::vector<Request> out;
+
+	// subscribers are not discovered yet right after start
+	if (!have_started) {
+		have_started = true;
+		started = now;
+	}
+
+	std::map<uint32_t, double> rates;
+	for (auto &d : demands) {
+		for (auto msgid : d.msgids) {
+			auto &r = rates[msgid];
+			r = std::max(r, d.rate);
+		}
+	}
+
+	float unused = (opts.stop_unused) ? INTERVAL_STOP : INTERVAL_DEFAULT;
+	for (auto &kv : streams) {
+		auto msgid = kv.first;
+		auto &st = kv.second;
+
+		if (manual.count(msgid))
+			continue;
+
+		double rate = rates[msgid];
+		float target = (rate > 0.0) ? float(1e6 / rate) : unused;
+
+		bool send = false;
+		if (st.requested && target == st.interval_us) {
+			st.lowering = false;
+		}
+		else if (is_faster(target, (st.requested) ? st.interval_us : unused)) {
+			send = true;
+		}
+		else {
+			// slower, unsubscribed, or first request of unused stream
+			auto since = (st.requested) ? now : started;
+			if (!st.lowering) {
+				st.lowering = true;
+				st.lower_since = since;
+			}
+
+			send = now - st.lower_since >= opts.hold;
+		}
+
+		if (send) {
+			st.requested = true;
+			st.interval_us = target;
+			st.lowering = false;
+		}
+		else if (!(st.requested && opts.resend > clock::duration::zero() && now - st.last_sent >= opts.resend))
+			continue;
+
+		st.last_sent = now;
+		out.push_back(Request { msgid, st.interval_us });
+	}
+
+	return out;
+}
+
+void StreamManager::reset()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (auto &kv : streams)
+		kv.second = Stream {};
+
+	have_started = false;
+}
+
+std::vector<StreamManager::Demand> StreamManager::get_demands()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return demands;
+}
+
+std::vector<StreamManager::Request> StreamManager::get_requested()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::vector<Request> out;
+
+	for (auto &kv : streams) {
+		if (kv.second.requested && !manual.count(kv.first))
+			out.push_back(Request { kv.first, kv.second.interval_us });
+	}
+
+	return out;
+}
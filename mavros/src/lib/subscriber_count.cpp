@@ -0,0 +1,79 @@
+/**
+ * @brief Cached topic subscriber counts
+ * @file subscriber_count.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <mavconn/thread_utils.h>
+#include <mavros/subscriber_count.h>
+
+using namespace mavros;
+
+constexpr std::chrono::milliseconds SubscriberWatcher::POLL_PERIOD;
+
+SubscriberWatcher::SubscriberWatcher(rclcpp::Node *node_) :
+	node(node_),
+	running(false)
+{ }
+
+SubscriberWatcher::~SubscriberWatcher()
+{
+	running = false;
+	if (thread.joinable())
+		thread.join();
+}
+
+SubscriberCount SubscriberWatcher::watch(rclcpp::PublisherBase::SharedPtr pub)
+{
+	auto count = std::make_shared<std::atomic<size_t>>(pub->get_subscription_count());
+
+	std::lock_guard<std::mutex> lock(mutex);
+	entries.push_back(Entry { pub, count });
+
+	// first watch starts the thread, publisher may be created by ROS thread
+	if (!running.exchange(true))
+		thread = std::thread(&SubscriberWatcher::run, this, node->get_graph_event());
+
+	return SubscriberCount(count);
+}
+
+void SubscriberWatcher::refresh()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto end = std::remove_if(entries.begin(), entries.end(), [](const Entry &e) {
+			auto pub = e.pub.lock();
+			if (!pub)
+				return true;
+
+			e.count->store(pub->get_subscription_count(), std::memory_order_relaxed);
+			return false;
+		});
+	entries.erase(end, entries.end());
+}
+
+void SubscriberWatcher::run(rclcpp::Event::SharedPtr event)
+{
+	mavconn::utils::set_this_thread_name("mvsubcnt");
+
+	while (running && rclcpp::ok()) {
+		try {
+			node->wait_for_graph_change(event, POLL_PERIOD);
+		}
+		catch (rclcpp::exceptions::RCLError &ex) {
+			// context shut down
+			break;
+		}
+
+		if (event->check_and_clear())
+			refresh();
+	}
+}
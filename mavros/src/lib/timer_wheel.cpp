@@ -0,0 +1,354 @@
+/**
+ * @brief Hierarchical timer wheel
+ * @file timer_wheel.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include <mavconn/thread_utils.h>
+#include <mavros/timer_wheel.h>
+
+using namespace mavros;
+
+constexpr std::chrono::milliseconds TimerWheel::TICK;
+constexpr size_t TimerWheel::SLOT_BITS;
+constexpr size_t TimerWheel::SLOTS;
+constexpr size_t TimerWheel::LEVELS;
+
+static constexpr uint64_t NO_TICK = UINT64_MAX;
+//! longest delay which fits into the wheel
+static constexpr uint64_t MAX_DELTA = (uint64_t(1) << (TimerWheel::SLOT_BITS * TimerWheel::LEVELS)) - 1;
+
+//! State shared by wheel, its thread and timers
+struct TimerWheel::Core {
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::condition_variable cb_done;
+	bool running;
+	std::thread::id thread_id;
+
+	clock::time_point epoch;
+	uint64_t now_tick;		//!< last processed tick
+	uint64_t wake_tick;		//!< thread sleeps until, NO_TICK - until notified
+	size_t armed_count;
+	std::array<std::array<Timer *, SLOTS>, LEVELS> slots;
+	std::array<uint64_t, LEVELS> occupied;	//!< bit per non-empty slot
+	std::vector<Timer *> expired;		//!< to be called, nulled when cancelled
+	Timer *current;				//!< callback in progress
+
+	Core() :
+		running(true),
+		epoch(clock::now()),
+		now_tick(0),
+		wake_tick(NO_TICK),
+		armed_count(0),
+		slots {},
+		occupied {},
+		current(nullptr)
+	{ }
+
+	static inline uint64_t ticks_ceil(clock::duration d) {
+		auto t = (d + TICK - clock::duration(1)) / TICK;
+		return std::max<int64_t>(t, 1);
+	}
+
+	inline uint64_t current_tick() const {
+		return (clock::now() - epoch) / TICK;
+	}
+
+	inline clock::time_point time_of(uint64_t tick) const {
+		return epoch + tick * TICK;
+	}
+
+	void place(Timer *t)
+	{
+		if (t->expires <= now_tick)
+			t->expires = now_tick + 1;
+
+		// too far: parked at the top, placed again when it gets there
+		uint64_t delta = std::min(t->expires - now_tick, MAX_DELTA);
+		uint64_t at = now_tick + delta;
+
+		size_t level = 0;
+		while (delta >= (uint64_t(SLOTS) << (SLOT_BITS * level)))
+			level++;
+
+		size_t slot = (at >> (SLOT_BITS * level)) & (SLOTS - 1);
+		auto &head = slots[level][slot];
+
+		t->level = level;
+		t->slot = slot;
+		t->prev = nullptr;
+		t->next = head;
+		if (head)
+			head->prev = t;
+
+		head = t;
+		occupied[level] |= uint64_t(1) << slot;
+	}
+
+	void unlink(Timer *t)
+	{
+		auto &head = slots[t->level][t->slot];
+
+		if (t->prev)
+			t->prev->next = t->next;
+		else
+			head = t->next;
+
+		if (t->next)
+			t->next->prev = t->prev;
+
+		if (head == nullptr)
+			occupied[t->level] &= ~(uint64_t(1) << t->slot);
+
+		t->prev = t->next = nullptr;
+	}
+
+	void arm(Timer *t)
+	{
+		if (t->armed)
+			unlink(t);
+		else
+			armed_count++;
+
+		// idle wheel is not advanced by thread, catch up so timer is placed by real time
+		auto now = current_tick();
+		if (armed_count == 1)
+			now_tick = std::max(now_tick, now);
+
+		// current tick is partly gone, so count from next one: late by < TICK, never early
+		t->armed = true;
+		t->expires = now + 1 + t->delay_ticks;
+		place(t);
+
+		// thread sleeps past new deadline
+		if (t->expires < wake_tick)
+			cond.notify_one();
+	}
+
+	void disarm(Timer *t)
+	{
+		std::replace(expired.begin(), expired.end(), t, static_cast<Timer *>(nullptr));
+		if (!t->armed)
+			return;
+
+		unlink(t);
+		t->armed = false;
+		armed_count--;
+	}
+
+	//! take timers of slot, fill expired on level 0
+	void run_slot(size_t level, size_t slot)
+	{
+		auto t = slots[level][slot];
+		slots[level][slot] = nullptr;
+		occupied[level] &= ~(uint64_t(1) << slot);
+
+		while (t) {
+			auto next = t->next;
+			t->prev = t->next = nullptr;
+
+			if (level > 0 || t->expires > now_tick) {
+				place(t);
+			}
+			else {
+				expired.push_back(t);
+
+				if (t->period_ticks > 0) {
+					// late calls are skipped, not piled up
+					t->expires += t->period_ticks;
+					place(t);
+				}
+				else {
+					t->armed = false;
+					armed_count--;
+				}
+			}
+
+			t = next;
+		}
+	}
+
+	uint64_t next_tick() const
+	{
+		uint64_t ret = NO_TICK;
+
+		for (size_t level = 0; level < LEVELS; level++) {
+			if (!occupied[level])
+				continue;
+
+			// slots are looked from next to current one, which is the last
+			size_t shift = SLOT_BITS * level;
+			size_t cur = (now_tick >> shift) & (SLOTS - 1);
+			size_t rot = (cur + 1) & (SLOTS - 1);
+			uint64_t bits = occupied[level];
+			uint64_t rotated = (rot == 0) ? bits : (bits >> rot) | (bits << (SLOTS - rot));
+			uint64_t distance = __builtin_ctzll(rotated) + 1;
+
+			// level 0 slot expires, higher one is cascaded at start of its range
+			uint64_t tick = (level == 0) ?
+					now_tick + distance :
+					((now_tick >> shift) + distance) << shift;
+
+			ret = std::min(ret, tick);
+		}
+
+		return ret;
+	}
+
+	void advance(uint64_t to)
+	{
+		for (auto tick = next_tick(); tick <= to; tick = next_tick()) {
+			now_tick = tick;
+
+			for (size_t level = LEVELS - 1; level > 0; level--) {
+				if (now_tick & ((uint64_t(1) << (SLOT_BITS * level)) - 1))
+					continue;
+
+				run_slot(level, (now_tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+			}
+
+			run_slot(0, now_tick & (SLOTS - 1));
+		}
+
+		now_tick = std::max(now_tick, to);
+	}
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		thread_id = std::this_thread::get_id();
+
+		while (running) {
+			wake_tick = next_tick();
+			if (wake_tick == NO_TICK) {
+				cond.wait(lock);
+				continue;
+			}
+
+			auto now = current_tick();
+			if (now < wake_tick) {
+				cond.wait_until(lock, time_of(wake_tick));
+				continue;
+			}
+
+			wake_tick = NO_TICK;
+			advance(now);
+
+			// timer may be cancelled or destroyed by previous callback
+			for (size_t i = 0; i < expired.size() && running; i++) {
+				current = expired[i];
+				if (!current)
+					continue;
+
+				lock.unlock();
+				current->cb();
+				lock.lock();
+
+				current = nullptr;
+				cb_done.notify_all();
+			}
+
+			expired.clear();
+		}
+	}
+};
+
+TimerWheel::Timer::Timer(std::shared_ptr<Core> core_, Callback cb_) :
+	prev(nullptr),
+	next(nullptr),
+	level(0),
+	slot(0),
+	core(std::move(core_)),
+	cb(std::move(cb_)),
+	expires(0),
+	delay_ticks(1),
+	period_ticks(0),
+	armed(false)
+{ }
+
+TimerWheel::Timer::~Timer()
+{
+	std::unique_lock<std::mutex> lock(core->mutex);
+	core->disarm(this);
+
+	// owner of callback data is usually destroyed next
+	if (std::this_thread::get_id() != core->thread_id)
+		core->cb_done.wait(lock, [this]() { return core->current != this; });
+}
+
+void TimerWheel::Timer::start(clock::duration delay, clock::duration period)
+{
+	std::lock_guard<std::mutex> lock(core->mutex);
+
+	delay_ticks = Core::ticks_ceil(delay);
+	period_ticks = (period > clock::duration::zero()) ? Core::ticks_ceil(period) : 0;
+	core->arm(this);
+}
+
+void TimerWheel::Timer::restart()
+{
+	std::lock_guard<std::mutex> lock(core->mutex);
+	core->arm(this);
+}
+
+void TimerWheel::Timer::cancel()
+{
+	std::lock_guard<std::mutex> lock(core->mutex);
+	core->disarm(this);
+}
+
+bool TimerWheel::Timer::is_armed()
+{
+	std::lock_guard<std::mutex> lock(core->mutex);
+	return armed;
+}
+
+TimerWheel::TimerWheel() :
+	core(std::make_shared<Core>())
+{
+	thread = std::thread([c = core]() {
+				mavconn::utils::set_this_thread_name("mvtimers");
+				c->run();
+			});
+}
+
+TimerWheel::~TimerWheel()
+{
+	stop();
+}
+
+TimerWheel::Ptr TimerWheel::create(Callback cb)
+{
+	return Ptr(new Timer(core, std::move(cb)));
+}
+
+size_t TimerWheel::size()
+{
+	std::lock_guard<std::mutex> lock(core->mutex);
+	return core->armed_count;
+}
+
+void TimerWheel::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(core->mutex);
+		core->running = false;
+		core->cond.notify_all();
+	}
+
+	if (thread.joinable())
+		thread.join();
+}
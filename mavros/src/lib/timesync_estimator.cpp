@@ -0,0 +1,107 @@
+/**
+ * @brief Clock offset and skew estimator
+ * @file timesync_estimator.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <mavros/timesync_estimator.h>
+
+using namespace mavros;
+
+constexpr int64_t TimeSyncEstimator::MIN_RTT_NS;
+constexpr int64_t TimeSyncEstimator::MIN_SKEW_SPAN_NS;
+
+TimeSyncEstimator::TimeSyncEstimator(size_t window_size) :
+	window(std::max<size_t>(window_size, 2)),
+	head(0),
+	count(0),
+	last_model(TimeSyncModel { 0, 0.0, 0 })
+{ }
+
+void TimeSyncEstimator::reset()
+{
+	head = 0;
+	count = 0;
+	last_model = TimeSyncModel { 0, 0.0, 0 };
+}
+
+static inline int64_t midpoint_offset(uint64_t local_tx_ns, uint64_t remote_ns, uint64_t local_rx_ns)
+{
+	// assume symmetric path delay
+	uint64_t local_mid_ns = local_tx_ns + (local_rx_ns - local_tx_ns) / 2;
+	return int64_t(local_mid_ns - remote_ns);
+}
+
+void TimeSyncEstimator::add(uint64_t local_tx_ns, uint64_t remote_ns, uint64_t local_rx_ns)
+{
+	double rtt = std::max<int64_t>(int64_t(local_rx_ns - local_tx_ns), MIN_RTT_NS);
+
+	window[head] = Sample {
+		remote_ns,
+		midpoint_offset(local_tx_ns, remote_ns, local_rx_ns),
+		1.0 / (rtt * rtt)
+	};
+
+	head = (head + 1) % window.size();
+	count = std::min(count + 1, window.size());
+
+	fit();
+}
+
+int64_t TimeSyncEstimator::residual(uint64_t local_tx_ns, uint64_t remote_ns, uint64_t local_rx_ns) const
+{
+	auto offset = midpoint_offset(local_tx_ns, remote_ns, local_rx_ns);
+	return offset - int64_t(last_model.to_local(remote_ns) - remote_ns);
+}
+
+void TimeSyncEstimator::fit()
+{
+	// newest sample is the reference, so sums stay small
+	auto &ref = window[(head + window.size() - 1) % window.size()];
+
+	double sw = 0, sx = 0, sy = 0;
+	uint64_t min_remote = ref.remote_ns;
+	for (size_t i = 0; i < count; i++) {
+		auto &s = window[i];
+		double x = int64_t(s.remote_ns - ref.remote_ns);
+		double y = s.offset_ns - ref.offset_ns;
+
+		sw += s.weight;
+		sx += s.weight * x;
+		sy += s.weight * y;
+		min_remote = std::min(min_remote, s.remote_ns);
+	}
+
+	double mx = sx / sw, my = sy / sw;
+	double sxx = 0, sxy = 0;
+	for (size_t i = 0; i < count; i++) {
+		auto &s = window[i];
+		double dx = int64_t(s.remote_ns - ref.remote_ns) - mx;
+		double dy = (s.offset_ns - ref.offset_ns) - my;
+
+		sxx += s.weight * dx * dx;
+		sxy += s.weight * dx * dy;
+	}
+
+	// short span gives noisy skew, use weighted mean offset then
+	double skew = 0.0;
+	if (int64_t(ref.remote_ns - min_remote) >= MIN_SKEW_SPAN_NS && sxx > 0)
+		skew = sxy / sxx;
+
+	// evaluate fit at newest sample: x = 0
+	double offset = my - skew * mx;
+
+	last_model = TimeSyncModel {
+		ref.offset_ns + int64_t(offset),
+		skew,
+		ref.remote_ns
+	};
+}
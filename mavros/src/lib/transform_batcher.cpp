@@ -0,0 +1,141 @@
+/**
+ * @brief Batched TF broadcaster
+ * @file transform_batcher.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <mavconn/thread_utils.h>
+#include <mavros/transform_batcher.h>
+
+using namespace mavros;
+using steady_clock = TransformBatcher::steady_clock;
+
+constexpr std::chrono::milliseconds TransformBatcher::DEFAULT_WINDOW;
+
+TransformBatcher::TransformBatcher(rclcpp::Node *node) :
+	window(DEFAULT_WINDOW),
+	deadline(steady_clock::time_point::max()),
+	running(false)
+{
+	tf_pub = node->create_publisher<tf2_msgs::msg::TFMessage>("/tf", rclcpp::QoS(100));
+}
+
+TransformBatcher::~TransformBatcher()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+		cond.notify_all();
+	}
+
+	if (thread.joinable())
+		thread.join();
+}
+
+void TransformBatcher::set_window(steady_clock::duration window_)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	window = std::max(window_, steady_clock::duration::zero());
+}
+
+void TransformBatcher::set_rate_limit(const std::string &child_frame_id, double rate)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto &child = children[child_frame_id];
+	child.period = (rate > 0.0) ?
+			std::chrono::duration_cast<steady_clock::duration>(std::chrono::duration<double>(1.0 / rate)) :
+			steady_clock::duration::zero();
+}
+
+void TransformBatcher::send(const geometry_msgs::msg::TransformStamped &transform)
+{
+	tf2_msgs::msg::TFMessage msg;
+	auto now = steady_clock::now();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = children.find(transform.child_frame_id);
+		if (it == children.end())
+			it = children.emplace(transform.child_frame_id, Child {}).first;
+
+		it->second.transform = transform;
+		it->second.pending = true;
+
+		if (window == steady_clock::duration::zero() && it->second.period == steady_clock::duration::zero()) {
+			// no batching, same as tf2_ros::TransformBroadcaster
+			it->second.pending = false;
+			msg.transforms.push_back(transform);
+		}
+		else if (now + window < deadline) {
+			// first transform opens the window
+			deadline = now + window;
+			if (!running) {
+				running = true;
+				thread = std::thread(&TransformBatcher::run, this);
+			}
+			else {
+				cond.notify_one();
+			}
+		}
+	}
+
+	if (!msg.transforms.empty())
+		tf_pub->publish(msg);
+}
+
+steady_clock::time_point TransformBatcher::collect(steady_clock::time_point now, tf2_msgs::msg::TFMessage &msg)
+{
+	auto next = steady_clock::time_point::max();
+	for (auto &kv : children) {
+		auto &child = kv.second;
+		if (!child.pending)
+			continue;
+
+		if (now < child.next) {
+			next = std::min(next, child.next);
+			continue;
+		}
+
+		msg.transforms.push_back(child.transform);
+		child.pending = false;
+		child.next = now + child.period;
+	}
+
+	return next;
+}
+
+void TransformBatcher::run()
+{
+	mavconn::utils::set_this_thread_name("mvtfbatch");
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (running) {
+		if (deadline == steady_clock::time_point::max())
+			cond.wait(lock);
+		else
+			cond.wait_until(lock, deadline);
+
+		auto now = steady_clock::now();
+		if (!running || now < deadline)
+			continue;
+
+		tf2_msgs::msg::TFMessage msg;
+		// rate limited transforms keep the window open
+		deadline = collect(now, msg);
+
+		if (msg.transforms.empty())
+			continue;
+
+		lock.unlock();
+		tf_pub->publish(msg);
+		lock.lock();
+	}
+}
@@ -0,0 +1,177 @@
+/**
+ * @brief Shared TF listener for plugins
+ * @file transform_dispatcher.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <mavconn/thread_utils.h>
+#include <mavros/transform_dispatcher.h>
+
+using namespace mavros;
+using steady_clock = std::chrono::steady_clock;
+
+TransformDispatcher::TransformDispatcher(rclcpp::Node *node_, tf2_ros::Buffer &buffer_) :
+	node(node_),
+	buffer(buffer_),
+	changed(false),
+	running(false),
+	static_generation(0)
+{
+	tf_sub = node->create_subscription<tf2_msgs::msg::TFMessage>("/tf", rclcpp::QoS(100),
+			std::bind(&TransformDispatcher::tf_cb, this, std::placeholders::_1, false));
+	tf_static_sub = node->create_subscription<tf2_msgs::msg::TFMessage>("/tf_static", rclcpp::QoS(100).transient_local(),
+			std::bind(&TransformDispatcher::tf_cb, this, std::placeholders::_1, true));
+}
+
+TransformDispatcher::~TransformDispatcher()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+		cond.notify_all();
+	}
+
+	if (thread.joinable())
+		thread.join();
+}
+
+TransformDispatcher::Subscription TransformDispatcher::subscribe(const std::string &name,
+		const std::string &frame_id, const std::string &child_frame_id,
+		double rate, TransformCb cb)
+{
+	auto req = std::make_shared<Request>();
+	req->name = name;
+	req->frame_id = frame_id;
+	req->child_frame_id = child_frame_id;
+	req->period = (rate > 0.0) ?
+			std::chrono::duration_cast<steady_clock::duration>(std::chrono::duration<double>(1.0 / rate)) :
+			steady_clock::duration::zero();
+	req->cb = std::move(cb);
+	req->next = steady_clock::time_point::min();
+	req->last_stamp_ns = -1;
+	// transform may be already in buffer
+	req->pending = true;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	requests.emplace_back(req);
+	changed = true;
+
+	// first subscription starts the thread
+	if (!running) {
+		running = true;
+		thread = std::thread(&TransformDispatcher::run, this);
+	}
+	else {
+		cond.notify_one();
+	}
+
+	return req;
+}
+
+void TransformDispatcher::tf_cb(const tf2_msgs::msg::TFMessage::SharedPtr msg, bool is_static)
+{
+	for (auto &transform : msg->transforms) {
+		try {
+			buffer.setTransform(transform, "mavros", is_static);
+		}
+		catch (tf2::TransformException &ex) {
+			RCUTILS_LOG_ERROR_NAMED("tf2_buffer", "%s", ex.what());
+		}
+	}
+
+	// after buffer update, so reader sees new transforms
+	if (is_static)
+		static_generation.fetch_add(1, std::memory_order_release);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	changed = true;
+	if (running)
+		cond.notify_one();
+}
+
+void TransformDispatcher::run()
+{
+	mavconn::utils::set_this_thread_name("mvtf");
+
+	auto next = steady_clock::time_point::max();
+	std::unique_lock<std::mutex> lock(mutex);
+	while (running) {
+		auto ready = [this] () { return changed || !running; };
+		if (next == steady_clock::time_point::max())
+			cond.wait(lock, ready);
+		else
+			cond.wait_until(lock, next, ready);
+
+		if (!running)
+			break;
+
+		bool changed_ = changed;
+		changed = false;
+
+		lock.unlock();
+		next = deliver(changed_);
+		lock.lock();
+	}
+}
+
+steady_clock::time_point TransformDispatcher::deliver(bool changed_)
+{
+	std::vector<Subscription> active;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto end = std::remove_if(requests.begin(), requests.end(), [&active](const std::weak_ptr<Request> &wr) {
+				auto req = wr.lock();
+				if (!req)
+					return true;
+
+				active.emplace_back(std::move(req));
+				return false;
+			});
+		requests.erase(end, requests.end());
+	}
+
+	// request fields are touched by this thread only
+	auto now = steady_clock::now();
+	auto next = steady_clock::time_point::max();
+	for (auto &req : active) {
+		req->pending |= changed_;
+		if (!req->pending)
+			continue;
+
+		if (now < req->next) {
+			next = std::min(next, req->next);
+			continue;
+		}
+
+		req->pending = false;
+
+		geometry_msgs::msg::TransformStamped transform;
+		try {
+			transform = buffer.lookupTransform(req->frame_id, req->child_frame_id, tf2::TimePointZero);
+		}
+		catch (tf2::TransformException &ex) {
+			// frames are not connected yet, retry on next update
+			RCUTILS_LOG_DEBUG_NAMED("tf2_buffer", "%s: %s", req->name.c_str(), ex.what());
+			continue;
+		}
+
+		// update of some other frame
+		auto stamp_ns = rclcpp::Time(transform.header.stamp).nanoseconds();
+		if (stamp_ns == req->last_stamp_ns)
+			continue;
+
+		req->last_stamp_ns = stamp_ns;
+		req->next = now + req->period;
+		req->cb(transform);
+	}
+
+	return next;
+}
@@ -11,6 +11,7 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <algorithm>
 #include <array>
 #include <unordered_map>
 #include <stdexcept>
@@ -23,34 +24,67 @@
 using namespace mavros;
 using utils::enum_value;
 
+//! Identity orientation, zero rate
+static UAS::Attitude no_attitude()
+{
+	UAS::Attitude att {};
+	att.valid = false;
+	att.orientation.w = 1.0;
+	att.orientation.x = att.orientation.y = att.orientation.z = 0.0;
+	att.angular_velocity.x = att.angular_velocity.y = att.angular_velocity.z = 0.0;
+	return att;
+}
+
+//! Unknown fix, like GPS_RAW before first message
+static UAS::GpsState no_gps()
+{
+	UAS::GpsState gps {};
+	gps.valid = false;
+	gps.eph = NAN;
+	gps.epv = NAN;
+	return gps;
+}
+
 UAS::UAS(rclcpp::Node *node) :
 	mavros_node(node),
 	diag_updater(node, 0.5),
+	subscriber_watcher(node),
 	clock(node->get_clock()),
 	tf2_buffer(node->get_clock()),
+	tf2_dispatcher(node, tf2_buffer),
 	tf2_broadcaster(node),
 	tf2_static_broadcaster(node),
-	tf2_listener(tf2_buffer, true),
+	tf2_batcher(node),
 	type(enum_value(MAV_TYPE::GENERIC)),
 	autopilot(enum_value(MAV_AUTOPILOT::GENERIC)),
 	base_mode(0),
 	target_system(1),
 	target_component(1),
 	connected(false),
-	gps_eph(NAN),
-	gps_epv(NAN),
-	gps_fix_type(0),
-	gps_satellites_visible(0),
-	time_offset(0),
+	attitude_enu(no_attitude()),
+	attitude_ned(no_attitude()),
+	gps_state(no_gps()),
+	home(Home {}),
+	time_model(TimeSyncModel { 0, 0.0, 0 }),
 	tsync_mode(UAS::timesync_mode::NONE),
-	fcu_caps_known(false),
-	fcu_capabilities(0)
+	fcu_caps(Capabilities { false, 0, 0 }),
+	mode_str(ModeString {})
 {
+	// "memory" - whole dataset in RAM, cubic interpolation, like before,
+	// "mmap" - opt-in, dataset is read on demand and shared with other processes,
+	// bilinear interpolation, so heights differ from "memory" by up to decimetres
+	auto geoid_backend = node->declare_parameter<std::string>("geoid/backend", "memory");
+	geoid_tile_radius = node->declare_parameter<double>("geoid/tile_radius", 1.0);
+
 	try {
 		// Using smallest dataset with 5' grid,
-		// From default location,
-		// Use cubic interpolation, Thread safe
-		egm96_5 = std::make_shared<GeographicLib::Geoid>("egm96-5", "", true, true);
+		// From default location
+		egm96_5 = GeoidModel::open(geoid_backend, "egm96-5");
+
+		// reuse grid cell around vehicle, results are not changed.
+		// Cubic model is not cached, bilinear cell would change its results.
+		if (geoid_backend == "mmap")
+			egm96_5 = std::make_shared<CachedGeoid>(egm96_5, 5.0 / 60.0);
 	}
 	catch (const std::exception &e) {
 		// catch exception and shutdown node
@@ -84,16 +118,29 @@ void UAS::update_connection_status(bool conn_)
 	if (conn_ != connected) {
 		connected = conn_;
 
+		// lazy plugins may add handlers meanwhile
+		std::vector<ConnectionCb> cbs;
+		{
+			lock_guard lock(mutex);
+			cbs = connection_cb_vec;
+		}
+
 		// call all change cb's
-		for (auto &cb : connection_cb_vec)
+		for (auto &cb : cbs)
 			cb(conn_);
 	}
 }
 
 void UAS::add_connection_change_handler(UAS::ConnectionCb cb)
 {
-	lock_guard lock(mutex);
-	connection_cb_vec.push_back(cb);
+	{
+		lock_guard lock(mutex);
+		connection_cb_vec.push_back(cb);
+	}
+
+	// handler added after connect, e.g. by lazy plugin
+	if (connected)
+		cb(true);
 }
 
 /* -*- autopilot version -*- */
@@ -106,32 +153,42 @@ static uint64_t get_default_caps(UAS::MAV_AUTOPILOT ap_type)
 
 uint64_t UAS::get_capabilities()
 {
-	if (fcu_caps_known) {
-		uint64_t caps = fcu_capabilities;
-		return caps;
-	}
-	else {
+	auto caps = fcu_caps.load();
+	if (caps.known)
+		return caps.capabilities;
+	else
 		return get_default_caps(get_autopilot());
-	}
 }
 
-void UAS::update_capabilities(bool known, uint64_t caps)
+void UAS::update_capabilities(bool known, uint64_t caps, uint64_t uid)
 {
-	fcu_caps_known = known;
-	fcu_capabilities = caps;
+	fcu_caps.store(Capabilities { known, caps, uid });
 }
 
 
 /* -*- IMU data -*- */
 
+UAS::Attitude UAS::make_attitude(const sensor_msgs::msg::Imu &imu)
+{
+	Attitude att;
+	att.valid = true;
+	att.orientation = imu.orientation;
+	att.angular_velocity = imu.angular_velocity;
+	return att;
+}
+
 void UAS::update_attitude_imu_enu(sensor_msgs::msg::Imu::SharedPtr &imu)
 {
+	attitude_enu.store(make_attitude(*imu));
+
 	lock_guard lock(mutex);
 	imu_enu_data = imu;
 }
 
 void UAS::update_attitude_imu_ned(sensor_msgs::msg::Imu::SharedPtr &imu)
 {
+	attitude_ned.store(make_attitude(*imu));
+
 	lock_guard lock(mutex);
 	imu_ned_data = imu;
 }
@@ -150,54 +207,22 @@ sensor_msgs::msg::Imu::SharedPtr UAS::get_attitude_imu_ned()
 
 geometry_msgs::msg::Quaternion UAS::get_attitude_orientation_enu()
 {
-	lock_guard lock(mutex);
-	if (imu_enu_data)
-		return imu_enu_data->orientation;
-	else {
-		// fallback - return identity
-		geometry_msgs::msg::Quaternion q;
-		q.w = 1.0; q.x = q.y = q.z = 0.0;
-		return q;
-	}
+	return attitude_enu.load().orientation;
 }
 
 geometry_msgs::msg::Quaternion UAS::get_attitude_orientation_ned()
 {
-	lock_guard lock(mutex);
-	if (imu_ned_data)
-		return imu_ned_data->orientation;
-	else {
-		// fallback - return identity
-		geometry_msgs::msg::Quaternion q;
-		q.w = 1.0; q.x = q.y = q.z = 0.0;
-		return q;
-	}
+	return attitude_ned.load().orientation;
 }
 
 geometry_msgs::msg::Vector3 UAS::get_attitude_angular_velocity_enu()
 {
-	lock_guard lock(mutex);
-	if (imu_enu_data)
-		return imu_enu_data->angular_velocity;
-	else {
-		// fallback
-		geometry_msgs::msg::Vector3 v;
-		v.x = v.y = v.z = 0.0;
-		return v;
-	}
+	return attitude_enu.load().angular_velocity;
 }
 
 geometry_msgs::msg::Vector3 UAS::get_attitude_angular_velocity_ned()
 {
-	lock_guard lock(mutex);
-	if (imu_ned_data)
-		return imu_ned_data->angular_velocity;
-	else {
-		// fallback
-		geometry_msgs::msg::Vector3 v;
-		v.x = v.y = v.z = 0.0;
-		return v;
-	}
+	return attitude_ned.load().angular_velocity;
 }
 
 
@@ -207,24 +232,34 @@ void UAS::update_gps_fix_epts(sensor_msgs::msg::NavSatFix::SharedPtr &fix,
 	float eph, float epv,
 	int fix_type, int satellites_visible)
 {
-	lock_guard lock(mutex);
+	GpsState gps;
+	gps.valid = true;
+	gps.latitude = fix->latitude;
+	gps.longitude = fix->longitude;
+	gps.altitude = fix->altitude;
+	std::copy(fix->position_covariance.begin(), fix->position_covariance.end(), gps.position_covariance.begin());
+	gps.position_covariance_type = fix->position_covariance_type;
+	gps.status = fix->status.status;
+	gps.service = fix->status.service;
+	gps.eph = eph;
+	gps.epv = epv;
+	gps.fix_type = fix_type;
+	gps.satellites_visible = satellites_visible;
+	gps_state.store(gps);
 
+	lock_guard lock(mutex);
 	gps_fix = fix;
-	gps_eph = eph;
-	gps_epv = epv;
-	gps_fix_type = fix_type;
-	gps_satellites_visible = satellites_visible;
 }
 
 //! Returns EPH, EPV, Fix type and satellites visible
 void UAS::get_gps_epts(float &eph, float &epv, int &fix_type, int &satellites_visible)
 {
-	lock_guard lock(mutex);
+	auto gps = gps_state.load();
 
-	eph = gps_eph;
-	epv = gps_epv;
-	fix_type = gps_fix_type;
-	satellites_visible = gps_satellites_visible;
+	eph = gps.eph;
+	epv = gps.epv;
+	fix_type = gps.fix_type;
+	satellites_visible = gps.satellites_visible;
 }
 
 //! Retunrs last GPS RAW message
@@ -234,6 +269,20 @@ sensor_msgs::msg::NavSatFix::SharedPtr UAS::get_gps_fix()
 	return gps_fix;
 }
 
+/* -*- home position -*- */
+
+void UAS::update_home(const Home &home_)
+{
+	// single writer, home_position plugin
+	auto prev = home.load();
+	home.store(home_);
+
+	// cache geoid around home, so lookups of local flight do not touch dataset
+	bool moved = !prev.valid || prev.latitude != home_.latitude || prev.longitude != home_.longitude;
+	if (egm96_5 && home_.valid && moved && geoid_tile_radius > 0.0)
+		egm96_5->cache_tile(home_.latitude, home_.longitude, geoid_tile_radius);
+}
+
 /* -*- transform -*- */
 
 //! Publishes static transform
@@ -12,8 +12,9 @@
  */
 
 #include <array>
-#include <unordered_map>
-#include <stdexcept>
+#include <cstdlib>
+#include <sstream>
+#include <strings.h>
 #include <mavros/mavros_uas.h>
 #include <mavros/px4_custom_mode.h>
 
@@ -23,13 +24,30 @@ using mavros::utils::enum_value;
 
 /* -*- mode stringify functions -*- */
 
-typedef std::unordered_map<uint32_t, const std::string> cmode_map;
+struct cmode_entry {
+	uint32_t mode;
+	const char *name;
+};
+
+//! constexpr table view, tables are small, so lookups are linear
+struct cmode_map {
+	const cmode_entry *first;
+	const cmode_entry *last;
+
+	template<size_t N>
+	constexpr cmode_map(const cmode_entry (&table)[N]) :
+		first(table), last(table + N)
+	{ }
+
+	const cmode_entry *begin() const { return first; }
+	const cmode_entry *end() const { return last; }
+};
 
 /** APM:Plane custom mode -> string
  *
  * ArduPlane/defines.h
  */
-static const cmode_map arduplane_cmode_map{{
+static constexpr cmode_entry arduplane_cmode_map[] = {
 	{ 0, "MANUAL" },
 	{ 1, "CIRCLE" },
 	{ 2, "STABILIZE" },
@@ -50,13 +68,13 @@ static const cmode_map arduplane_cmode_map{{
 	{ 19, "QLOITER" },
 	{ 20, "QLAND" },
 	{ 21, "QRTL" }
-}};
+};
 
 /** APM:Copter custom mode -> string
  *
  * ArduCopter/defines.h
  */
-static const cmode_map arducopter_cmode_map{{
+static constexpr cmode_entry arducopter_cmode_map[] = {
 	{ 0, "STABILIZE" },
 	{ 1, "ACRO" },
 	{ 2, "ALT_HOLD" },
@@ -77,13 +95,13 @@ static const cmode_map arducopter_cmode_map{{
 	{ 18, "THROW" },
 	{ 19, "AVOID_ADSB" },
 	{ 20, "GUIDED_NOGPS" }
-}};
+};
 
 /** APM:Rover custom mode -> string
  *
  * APMrover2/defines.h
  */
-static const cmode_map apmrover2_cmode_map{{
+static constexpr cmode_entry apmrover2_cmode_map[] = {
 	{ 0, "MANUAL" },
 	{ 2, "LEARNING" },
 	{ 3, "STEERING" },
@@ -92,7 +110,7 @@ static const cmode_map apmrover2_cmode_map{{
 	{ 11, "RTL" },
 	{ 15, "GUIDED" },
 	{ 16, "INITIALISING" }
-}};
+};
 
 /** ArduSub custom mode -> string
  *
@@ -100,7 +118,7 @@ static const cmode_map apmrover2_cmode_map{{
  *
  * ArduSub/defines.h
  */
-static const cmode_map ardusub_cmode_map{{
+static constexpr cmode_entry ardusub_cmode_map[] = {
 	{ 0, "STABILIZE" },
 	{ 1, "ACRO" },
 	{ 2, "ALT_HOLD" },
@@ -119,10 +137,10 @@ static const cmode_map ardusub_cmode_map{{
 	{ 17, "BRAKE" },	// n/a
 	{ 18, "THROW" },
 	{ 19, "MANUAL" }
-}};
+};
 
 //! PX4 custom mode -> string
-static const cmode_map px4_cmode_map{{
+static constexpr cmode_entry px4_cmode_map[] = {
 	{ px4::define_mode(px4::custom_mode::MAIN_MODE_MANUAL),           "MANUAL" },
 	{ px4::define_mode(px4::custom_mode::MAIN_MODE_ACRO),             "ACRO" },
 	{ px4::define_mode(px4::custom_mode::MAIN_MODE_ALTCTL),           "ALTCTL" },
@@ -139,7 +157,7 @@ static const cmode_map px4_cmode_map{{
 	{ px4::define_mode_auto(px4::custom_mode::SUB_MODE_AUTO_TAKEOFF), "AUTO.TAKEOFF" },
 	{ px4::define_mode_auto(px4::custom_mode::SUB_MODE_AUTO_FOLLOW_TARGET), "AUTO.FOLLOW_TARGET" },
 	{ px4::define_mode_auto(px4::custom_mode::SUB_MODE_AUTO_PRECLAND), "AUTO.PRECLAND" },
-}};
+};
 
 static inline std::string str_base_mode(int base_mode) {
 	return utils::format("MODE(0x%2X)", base_mode);
@@ -151,11 +169,12 @@ static std::string str_custom_mode(uint32_t custom_mode) {
 
 static std::string str_mode_cmap(const cmode_map &cmap, uint32_t custom_mode)
 {
-	auto it = cmap.find(custom_mode);
-	if (it != cmap.end())
-		return it->second;
-	else
-		return str_custom_mode(custom_mode);
+	for (auto &mode : cmap) {
+		if (mode.mode == custom_mode)
+			return mode.name;
+	}
+
+	return str_custom_mode(custom_mode);
 }
 
 static inline std::string str_mode_px4(uint32_t custom_mode_int)
@@ -182,64 +201,82 @@ static inline bool is_apm_copter(UAS::MAV_TYPE type)
 	       type == UAS::MAV_TYPE::COAXIAL;
 }
 
-std::string UAS::str_mode_v10(uint8_t base_mode, uint32_t custom_mode)
+static std::string str_mode_v10_impl(UAS::MAV_TYPE type, UAS::MAV_AUTOPILOT ap, uint8_t base_mode, uint32_t custom_mode)
 {
-	if (!(base_mode & enum_value(MAV_MODE_FLAG::CUSTOM_MODE_ENABLED)))
+	if (!(base_mode & enum_value(UAS::MAV_MODE_FLAG::CUSTOM_MODE_ENABLED)))
 		return str_base_mode(base_mode);
 
-	auto type = get_type();
-	auto ap = get_autopilot();
-	if (MAV_AUTOPILOT::ARDUPILOTMEGA == ap) {
+	if (UAS::MAV_AUTOPILOT::ARDUPILOTMEGA == ap) {
 		if (is_apm_copter(type))
 			return str_mode_cmap(arducopter_cmode_map, custom_mode);
-		else if (type == MAV_TYPE::FIXED_WING)
+		else if (type == UAS::MAV_TYPE::FIXED_WING)
 			return str_mode_cmap(arduplane_cmode_map, custom_mode);
-		else if (type == MAV_TYPE::GROUND_ROVER)
+		else if (type == UAS::MAV_TYPE::GROUND_ROVER)
 			return str_mode_cmap(apmrover2_cmode_map, custom_mode);
-		else if (type == MAV_TYPE::SURFACE_BOAT)
+		else if (type == UAS::MAV_TYPE::SURFACE_BOAT)
 			return str_mode_cmap(apmrover2_cmode_map, custom_mode);		// NOTE: #1051 for now (19.06.2018) boat is same as rover
-		else if (type == MAV_TYPE::SUBMARINE)
+		else if (type == UAS::MAV_TYPE::SUBMARINE)
 			return str_mode_cmap(ardusub_cmode_map, custom_mode);
 		else {
 			RCUTILS_LOG_WARN_THROTTLE_NAMED(RCUTILS_STEADY_TIME, 30, "uas", "MODE: Unknown APM based FCU! Type: %d", enum_value(type));
 			return str_custom_mode(custom_mode);
 		}
 	}
-	else if (MAV_AUTOPILOT::PX4 == ap)
+	else if (UAS::MAV_AUTOPILOT::PX4 == ap)
 		return str_mode_px4(custom_mode);
 	else
 		/* TODO: other autopilot */
 		return str_custom_mode(custom_mode);
 }
 
+std::string UAS::str_mode_v10(uint8_t base_mode, uint32_t custom_mode)
+{
+	auto type = get_type();
+	auto ap = get_autopilot();
+
+	// HEARTBEAT repeats same mode, so string is only made on change
+	std::lock_guard<std::mutex> lock(mode_str_mutex);
+	auto &c = mode_str;
+	if (!c.valid || c.base_mode != base_mode || c.custom_mode != custom_mode ||
+			c.type != enum_value(type) || c.autopilot != enum_value(ap)) {
+		c.valid = true;
+		c.type = enum_value(type);
+		c.autopilot = enum_value(ap);
+		c.base_mode = base_mode;
+		c.custom_mode = custom_mode;
+		c.str = str_mode_v10_impl(type, ap, base_mode, custom_mode);
+	}
+
+	return c.str;
+}
+
 /* XXX TODO
  * Add a fallback CMODE(dec) decoder for unknown FCU's
  */
 
-static bool cmode_find_cmap(const cmode_map &cmap, std::string &cmode_str, uint32_t &cmode)
+static bool cmode_find_cmap(const cmode_map &cmap, const std::string &cmode_str, uint32_t &cmode)
 {
-	// 1. try find by name
+	// 1. try find by name, case insensitive
 	for (auto &mode : cmap) {
-		if (mode.second == cmode_str) {
-			cmode = mode.first;
+		if (::strcasecmp(mode.name, cmode_str.c_str()) == 0) {
+			cmode = mode.mode;
 			return true;
 		}
 	}
 
 	// 2. try convert integer
 	//! @todo parse CMODE(dec)
-	try {
-		cmode = std::stoi(cmode_str, 0, 0);
+	char *end = nullptr;
+	auto val = std::strtoul(cmode_str.c_str(), &end, 0);
+	if (!cmode_str.empty() && end != cmode_str.c_str()) {
+		cmode = val;
 		return true;
 	}
-	catch (std::invalid_argument &ex) {
-		// failed
-	}
 
 	// Debugging output.
 	std::ostringstream os;
 	for (auto &mode : cmap)
-		os << " " << mode.second;
+		os << " " << mode.name;
 
 	RCUTILS_LOG_ERROR_NAMED("uas", "MODE: Unknown mode: %s", cmode_str.c_str());
 	RCUTILS_LOG_INFO_NAMED("uas", "MODE: Known modes are:%s", os.str().c_str());
@@ -247,11 +284,8 @@ static bool cmode_find_cmap(const cmode_map &cmap, std::string &cmode_str, uint3
 	return false;
 }
 
-bool UAS::cmode_from_str(std::string cmode_str, uint32_t &custom_mode)
+bool UAS::cmode_from_str(const std::string &cmode_str, uint32_t &custom_mode)
 {
-	// upper case
-	std::transform(cmode_str.begin(), cmode_str.end(), cmode_str.begin(), std::ref(toupper));
-
 	auto type = get_type();
 	auto ap = get_autopilot();
 	if (MAV_AUTOPILOT::ARDUPILOTMEGA == ap) {
@@ -23,6 +23,8 @@ using namespace mavros;
 
 /* -*- time syncronise functions -*- */
 
+thread_local uint64_t UAS::rx_stamp_ns = 0;
+
 static inline rclcpp::Time ros_time_from_ns(const uint64_t stamp_ns) {
 	return rclcpp::Time(
 		stamp_ns / 1000000000UL,		// t_sec
@@ -30,24 +32,28 @@ static inline rclcpp::Time ros_time_from_ns(const uint64_t stamp_ns) {
 }
 
 rclcpp::Time UAS::synchronise_stamp(uint32_t time_boot_ms) {
-	// copy offset from atomic var
-	uint64_t offset_ns = time_offset;
+	// snapshot of model, no lock
+	auto model = time_model.load();
 
-	if (offset_ns > 0 || tsync_mode == timesync_mode::PASSTHROUGH) {
-		uint64_t stamp_ns = static_cast<uint64_t>(time_boot_ms) * 1000000UL + offset_ns;
+	if (model.offset_ns != 0 || tsync_mode == timesync_mode::PASSTHROUGH) {
+		uint64_t stamp_ns = model.to_local(static_cast<uint64_t>(time_boot_ms) * 1000000UL);
 		return ros_time_from_ns(stamp_ns);
 	}
+	else if (rx_stamp_ns > 0)
+		return ros_time_from_ns(rx_stamp_ns);
 	else
 		return clock->now();
 }
 
 rclcpp::Time UAS::synchronise_stamp(uint64_t time_usec) {
-	uint64_t offset_ns = time_offset;
+	auto model = time_model.load();
 
-	if (offset_ns > 0 || tsync_mode == timesync_mode::PASSTHROUGH) {
-		uint64_t stamp_ns = time_usec * 1000UL + offset_ns;
+	if (model.offset_ns != 0 || tsync_mode == timesync_mode::PASSTHROUGH) {
+		uint64_t stamp_ns = model.to_local(time_usec * 1000UL);
 		return ros_time_from_ns(stamp_ns);
 	}
+	else if (rx_stamp_ns > 0)
+		return ros_time_from_ns(rx_stamp_ns);
 	else
 		return clock->now();
 }
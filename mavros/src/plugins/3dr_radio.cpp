@@ -18,17 +18,23 @@
 
 #include <mavros_msgs/msg/radio_status.hpp>
 
+#include <algorithm>
+
 namespace mavros {
 namespace std_plugins {
 /**
  * @brief 3DR Radio plugin.
+ *
+ * With tdr_radio/flow_control radio status is fed to FCU link Tx flow control,
+ * so low priority streams are throttled before radio buffer overflows.
  */
 class TDRRadioPlugin : public plugin::PluginBase {
 public:
 	TDRRadioPlugin() : PluginBase(),
 		has_radio_status(false),
 		diag_added(false),
-		low_rssi(0)
+		low_rssi(0),
+		flow_control(false)
 	{ }
 
 	void initialize(UAS &uas_)
@@ -39,6 +45,17 @@ public:
 
 		low_rssi = nh->declare_parameter<int>("tdr_radio/low_rssi", 40);
 
+		// flow control params
+		flow_control = nh->declare_parameter<bool>("tdr_radio/flow_control", false);
+		mavconn::TxFlowControl::Options flow_opts;
+		flow_opts.txbuf_low = clamp_percent(nh->declare_parameter<int>("tdr_radio/txbuf_low", flow_opts.txbuf_low));
+		flow_opts.txbuf_high = clamp_percent(nh->declare_parameter<int>("tdr_radio/txbuf_high", flow_opts.txbuf_high));
+		flow_opts.min_share = nh->declare_parameter<double>("tdr_radio/min_share", flow_opts.min_share);
+		// share does not grow while low_rssi is reported
+		flow_opts.rssi_low = std::min(std::max(low_rssi, 0), 255);
+		if (flow_control)
+			UAS_FCU(m_uas)->set_tx_flow_control(true, flow_opts);
+
 		status_pub = nh->create_publisher<mavros_msgs::msg::RadioStatus>("radio_status", 10);
 
 		enable_connection_cb();
@@ -58,6 +75,7 @@ private:
 	bool has_radio_status;
 	bool diag_added;
 	int low_rssi;
+	bool flow_control;
 
 	rclcpp::Publisher<mavros_msgs::msg::RadioStatus>::SharedPtr status_pub;
 
@@ -66,13 +84,13 @@ private:
 
 	/* -*- message handlers -*- */
 
-	void handle_radio_status(const mavlink::mavlink_message_t *msg, mavlink::common::msg::RADIO_STATUS &rst)
+	void handle_radio_status(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::RADIO_STATUS &rst)
 	{
 		has_radio_status = true;
 		handle_message(msg, rst);
 	}
 
-	void handle_radio(const mavlink::mavlink_message_t *msg, mavlink::ardupilotmega::msg::RADIO &rst)
+	void handle_radio(const mavlink::mavlink_message_t *msg, const mavlink::ardupilotmega::msg::RADIO &rst)
 	{
 		if (has_radio_status)
 			return;
@@ -82,7 +100,7 @@ private:
 	}
 
 	template<typename msgT>
-	void handle_message(const mavlink::mavlink_message_t *mmsg, msgT &rst)
+	void handle_message(const mavlink::mavlink_message_t *mmsg, const msgT &rst)
 	{
 		if (mmsg->sysid != '3' || mmsg->compid != 'D')
 			RCUTILS_LOG_WARN_THROTTLE_NAMED(,30, "radio", "RADIO_STATUS not from 3DR modem?");
@@ -105,6 +123,9 @@ private:
 		msg->rssi_dbm = (rst.rssi / 1.9) - 127;
 		msg->remrssi_dbm = (rst.remrssi / 1.9) - 127;
 
+		if (flow_control)
+			UAS_FCU(m_uas)->tx_flow_feedback(rst.txbuf, rst.rssi, rst.remrssi);
+
 		// add diag at first event
 		if (!diag_added) {
 			UAS_DIAG(m_uas).add("3DR Radio", this, &TDRRadioPlugin::diag_run);
@@ -121,6 +142,11 @@ private:
 	}
 
 
+	static uint8_t clamp_percent(int v)
+	{
+		return std::min(std::max(v, 0), 100);
+	}
+
 	void diag_run(diagnostic_updater::DiagnosticStatusWrapper &stat)
 	{
 		std::lock_guard<std::mutex> lock(diag_mutex);
@@ -145,6 +171,12 @@ private:
 		stat.addf("Remote noice level", "%u", last_status->remnoise);
 		stat.addf("Rx errors", "%u", last_status->rxerrors);
 		stat.addf("Fixed", "%u", last_status->fixed);
+
+		if (flow_control) {
+			auto fst = UAS_FCU(m_uas)->get_tx_flow_stat();
+			stat.addf("Tx share (%)", "%.0f", fst.share * 100.0f);
+			stat.addf("Tx throttled", "%llu", (unsigned long long) fst.throttled);
+		}
 	}
 
 	void connection_cb(bool connected) override
@@ -157,5 +189,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::TDRRadioPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(3dr_radio, mavros::std_plugins::TDRRadioPlugin)
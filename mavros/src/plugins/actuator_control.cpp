@@ -55,7 +55,7 @@ private:
 
 	/* -*- rx handlers -*- */
 
-	void handle_actuator_control_target(const mavlink::mavlink_message_t *msg, mavlink::common::msg::ACTUATOR_CONTROL_TARGET &actuator_control_target)
+	void handle_actuator_control_target(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::ACTUATOR_CONTROL_TARGET &actuator_control_target)
 	{
 		auto actuator_control_target_msg = std::make_shared<mavros_msgs::msg::ActuatorControl>();
 		actuator_control_target_msg->header.stamp = m_uas->synchronise_stamp(actuator_control_target.time_usec);
@@ -86,5 +86,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::ActuatorControlPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(actuator_control, mavros::std_plugins::ActuatorControlPlugin)
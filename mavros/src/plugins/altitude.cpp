@@ -56,7 +56,7 @@ private:
 
 	rclcpp::Publisher<mavros_msgs::msg::Altitude>::SharedPtr altitude_pub;
 
-	void handle_altitude(const mavlink::mavlink_message_t *msg, mavlink::common::msg::ALTITUDE &altitude)
+	void handle_altitude(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::ALTITUDE &altitude)
 	{
 		auto ros_msg = std::make_shared<mavros_msgs::msg::Altitude>();
 		ros_msg->header = m_uas->synchronized_header(frame_id, altitude.time_usec);
@@ -74,5 +74,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::AltitudePlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(altitude, mavros::std_plugins::AltitudePlugin)
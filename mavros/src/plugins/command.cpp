@@ -16,8 +16,12 @@
 
 #include <chrono>
 #include <condition_variable>
+#include <memory>
+#include <unordered_map>
 #include <mavros/mavros_plugin.h>
 
+#include <mavros_msgs/msg/command_async.hpp>
+#include <mavros_msgs/msg/command_status.hpp>
 #include <mavros_msgs/srv/command_long.hpp>
 #include <mavros_msgs/srv/command_int.hpp>
 #include <mavros_msgs/srv/command_bool.hpp>
@@ -32,18 +36,37 @@ using utils::enum_value;
 using lock_guard = std::lock_guard<std::mutex>;
 using unique_lock = std::unique_lock<std::mutex>;
 
+/**
+ * @brief COMMAND_LONG waiting for COMMAND_ACK
+ *
+ * Guarded by CommandPlugin::mutex.
+ */
 class CommandTransaction {
 public:
-	std::mutex cond_mutex;
+	using clock = std::chrono::steady_clock;
+
 	std::condition_variable ack;
-	uint16_t expected_command;
+	mavlink::common::msg::COMMAND_LONG cmd;	//!< resent on timeout
+	bool is_async;		//!< status published, nobody waits
+	uint32_t async_id;
+	bool is_done;
+	bool is_in_progress;	//!< FCU reported IN_PROGRESS, not resent
 	uint8_t result;
+	uint8_t progress;
+	size_t tries;		//!< sends made
+	clock::time_point deadline;
 
-	explicit CommandTransaction(uint16_t command) :
+	explicit CommandTransaction(const mavlink::common::msg::COMMAND_LONG &cmd_) :
 		ack(),
-		expected_command(command),
+		cmd(cmd_),
+		is_async(false),
+		async_id(0),
+		is_done(false),
+		is_in_progress(false),
 		// Default result if wait ack timeout
-		result(enum_value(mavlink::common::MAV_RESULT::FAILED))
+		result(enum_value(mavlink::common::MAV_RESULT::FAILED)),
+		progress(0),
+		tries(0)
 	{ }
 };
 
@@ -56,7 +79,8 @@ class CommandPlugin : public plugin::PluginBase {
 public:
 	CommandPlugin() : PluginBase(),
 		use_comp_id_system_control(false),
-		command_ack_timeout_dt(0)
+		command_ack_timeout_dt(0),
+		command_retries(0)
 	{ }
 
 	void initialize(UAS &uas_)
@@ -69,6 +93,8 @@ public:
 
 		command_ack_timeout = cmd_nh->declare_parameter<double>("cmd/command_ack_timeout", ACK_TIMEOUT_DEFAULT);
 		use_comp_id_system_control = cmd_nh->declare_parameter<bool>("cmd/use_comp_id_system_control", false);
+		// resends split command_ack_timeout, so worst case wait stays the same
+		command_retries = std::max<int>(cmd_nh->declare_parameter<int>("cmd/command_retries", RETRIES_DEFAULT), 0);
 
 		command_ack_timeout_dt = std::chrono::duration<double>(command_ack_timeout);
 
@@ -88,6 +114,12 @@ public:
 			std::bind(&CommandPlugin::trigger_control_cb, this, std::placeholders::_1, std::placeholders::_2));
 		trigger_interval_srv = cmd_nh->create_service<mavros_msgs::srv::CommandTriggerInterval>("trigger_interval",
 			std::bind(&CommandPlugin::trigger_interval_cb, this, std::placeholders::_1, std::placeholders::_2));
+
+		command_async_sub = cmd_nh->create_subscription<mavros_msgs::msg::CommandAsync>("command_async", 10,
+			std::bind(&CommandPlugin::command_async_cb, this, std::placeholders::_1));
+		command_status_pub = cmd_nh->create_publisher<mavros_msgs::msg::CommandStatus>("command_status", 10);
+
+		timeout_timer = cmd_nh->create_wall_timer(TIMEOUT_CHECK_DT, std::bind(&CommandPlugin::timeout_cb, this));
 	}
 
 	Subscriptions get_subscriptions()
@@ -98,7 +130,9 @@ public:
 	}
 
 private:
-	using L_CommandTransaction = std::list<CommandTransaction>;
+	using CommandTransactionPtr = std::shared_ptr<CommandTransaction>;
+	//! by transaction_key()
+	using M_CommandTransaction = std::unordered_map<uint32_t, CommandTransactionPtr>;
 
 	std::mutex mutex;
 
@@ -111,42 +145,175 @@ private:
 	rclcpp::Service<mavros_msgs::srv::CommandTOL>::SharedPtr land_srv;
 	rclcpp::Service<mavros_msgs::srv::CommandTriggerControl>::SharedPtr trigger_control_srv;
 	rclcpp::Service<mavros_msgs::srv::CommandTriggerInterval>::SharedPtr trigger_interval_srv;
+	rclcpp::Subscription<mavros_msgs::msg::CommandAsync>::SharedPtr command_async_sub;
+	rclcpp::Publisher<mavros_msgs::msg::CommandStatus>::SharedPtr command_status_pub;
+	rclcpp::TimerBase::SharedPtr timeout_timer;
 
 	bool use_comp_id_system_control;
 
-	L_CommandTransaction ack_waiting_list;
+	M_CommandTransaction ack_waiting_map;
 	static constexpr double ACK_TIMEOUT_DEFAULT = 5.0;
+	//! no resends, commands like arming are not idempotent with FCUs ignoring confirmation
+	static constexpr int RETRIES_DEFAULT = 0;
+	//! MAV_RESULT_IN_PROGRESS, not in all dialects yet
+	static constexpr uint8_t RESULT_IN_PROGRESS = 5;
+	static constexpr std::chrono::milliseconds TIMEOUT_CHECK_DT { 50 };
 	std::chrono::duration<double> command_ack_timeout_dt;
+	int command_retries;
+
+	/**
+	 * @brief Key of transaction: command and target system
+	 *
+	 * Component is not used: ACK may come from autopilot for command
+	 * sent to COMP_ID_SYSTEM_CONTROL.
+	 */
+	static inline uint32_t transaction_key(uint16_t command, uint8_t target_system) {
+		return (uint32_t(target_system) << 16) | command;
+	}
+
+	//! Timeout of one try, command_ack_timeout is split between retries
+	CommandTransaction::clock::duration try_timeout() const {
+		return std::chrono::duration_cast<CommandTransaction::clock::duration>(
+				command_ack_timeout_dt / (command_retries + 1));
+	}
 
 	/* -*- message handlers -*- */
 
-	void handle_command_ack(const mavlink::mavlink_message_t *msg, mavlink::common::msg::COMMAND_ACK &ack)
+	void handle_command_ack(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::COMMAND_ACK &ack)
 	{
 		lock_guard lock(mutex);
 
-		// XXX(vooon): place here source ids check
+		auto it = ack_waiting_map.find(transaction_key(ack.command, msg->sysid));
+		if (it == ack_waiting_map.end()) {
+			RCUTILS_LOG_WARN_NAMED("cmd", "CMD: Unexpected command %u, result %u",
+				ack.command, ack.result);
+			return;
+		}
 
-		for (auto &tr : ack_waiting_list) {
-			if (tr.expected_command == ack.command) {
-				tr.result = ack.result;
-				tr.ack.notify_all();
-				return;
-			}
+		auto tr = it->second;
+		tr->result = ack.result;
+
+		if (ack.result == RESULT_IN_PROGRESS) {
+			// long running command, FCU sends final ACK later; wait without resends
+			tr->is_in_progress = true;
+			tr->progress = ack.progress;
+			tr->deadline = CommandTransaction::clock::now() +
+				std::chrono::duration_cast<CommandTransaction::clock::duration>(command_ack_timeout_dt);
+			publish_status(*tr, mavros_msgs::msg::CommandStatus::STATE_IN_PROGRESS);
+			return;
 		}
 
-		RCUTILS_LOG_WARN_NAMED("cmd", "CMD: Unexpected command %u, result %u",
-			ack.command, ack.result);
+		finish_transaction(it, mavros_msgs::msg::CommandStatus::STATE_DONE);
 	}
 
 	/* -*- mid-level functions -*- */
 
-	bool wait_ack_for(CommandTransaction &tr) {
-		unique_lock lock(tr.cond_mutex);
-		if (tr.ack.wait_for(lock, command_ack_timeout_dt) == std::cv_status::timeout) {
-			RCUTILS_LOG_WARN_NAMED("cmd", "CMD: Command %u -- wait ack timeout", tr.expected_command);
-			return false;
-		} else {
-			return true;
+	/**
+	 * @brief Send command and register transaction waiting for ACK
+	 *
+	 * @param async_id  CommandAsync id, status is published only for async commands
+	 * @return nullptr if same command to same target is in flight
+	 */
+	CommandTransactionPtr start_transaction(const mavlink::common::msg::COMMAND_LONG &cmd,
+		bool is_async = false, uint32_t async_id = 0)
+	{
+		auto key = transaction_key(cmd.command, cmd.target_system);
+		if (ack_waiting_map.count(key)) {
+			RCUTILS_LOG_WARN_THROTTLE_NAMED(,10, "cmd", "CMD: Command %u already in progress", cmd.command);
+			return nullptr;
+		}
+
+		auto tr = std::make_shared<CommandTransaction>(cmd);
+		tr->is_async = is_async;
+		tr->async_id = async_id;
+		ack_waiting_map.emplace(key, tr);
+		send_try(*tr);
+		return tr;
+	}
+
+	void send_try(CommandTransaction &tr)
+	{
+		// confirmation is incremented on each resend
+		if (tr.tries > 0)
+			tr.cmd.confirmation++;
+
+		tr.tries++;
+		tr.deadline = CommandTransaction::clock::now() + try_timeout();
+
+		UAS_FCU(m_uas)->send_message_ignore_drop(tr.cmd);
+	}
+
+	void finish_transaction(M_CommandTransaction::iterator it, uint8_t state)
+	{
+		auto tr = it->second;
+		ack_waiting_map.erase(it);
+
+		tr->is_done = true;
+		tr->ack.notify_all();
+		publish_status(*tr, state);
+	}
+
+	void publish_status(CommandTransaction &tr, uint8_t state)
+	{
+		if (!tr.is_async)
+			return;
+
+		auto st = std::make_unique<mavros_msgs::msg::CommandStatus>();
+		st->header.stamp = cmd_nh->now();
+		st->id = tr.async_id;
+		st->command = tr.cmd.command;
+		st->state = state;
+		st->result = tr.result;
+		st->progress = tr.progress;
+		st->tries = tr.tries;
+
+		command_status_pub->publish(std::move(st));
+	}
+
+	/**
+	 * @brief Resend or fail timed out transactions, caller holds mutex
+	 */
+	void check_timeouts()
+	{
+		auto now = CommandTransaction::clock::now();
+
+		for (auto it = ack_waiting_map.begin(); it != ack_waiting_map.end(); ) {
+			auto &tr = *it->second;
+			auto next = std::next(it);
+
+			if (now < tr.deadline) {
+				// not yet
+			}
+			else if (!tr.is_in_progress && tr.tries <= size_t(command_retries)) {
+				RCUTILS_LOG_DEBUG_NAMED("cmd", "CMD: Command %u -- resend %zu", tr.cmd.command, tr.tries);
+				send_try(tr);
+			}
+			else {
+				RCUTILS_LOG_WARN_NAMED("cmd", "CMD: Command %u -- wait ack timeout", tr.cmd.command);
+				tr.result = enum_value(mavlink::common::MAV_RESULT::FAILED);
+				finish_transaction(it, mavros_msgs::msg::CommandStatus::STATE_TIMEOUT);
+			}
+
+			it = next;
+		}
+	}
+
+	void timeout_cb()
+	{
+		lock_guard lock(mutex);
+		check_timeouts();
+	}
+
+	/**
+	 * @brief Wait for transaction end
+	 *
+	 * Timeouts are checked here as well, timer may share executor with that call.
+	 */
+	void wait_ack_for(unique_lock &lock, CommandTransaction &tr)
+	{
+		while (!tr.is_done) {
+			tr.ack.wait_until(lock, tr.deadline);
+			check_timeouts();
 		}
 	}
 
@@ -167,49 +334,42 @@ private:
 
 		unique_lock lock(mutex);
 
-		L_CommandTransaction::iterator ack_it;
-
-		/* check transactions */
-		for (const auto &tr : ack_waiting_list) {
-			if (tr.expected_command == command) {
-				RCUTILS_LOG_WARN_THROTTLE_NAMED(,10, "cmd", "CMD: Command %u already in progress", command);
-				return false;
-			}
-		}
-
-		/**
-		 * @note APM & PX4 master always send COMMAND_ACK. Old PX4 never.
-		 * Don't expect any ACK in broadcast mode.
-		 */
-		bool is_ack_required = (confirmation != 0 || m_uas->is_ardupilotmega() || m_uas->is_px4()) && !broadcast;
-		if (is_ack_required)
-			ack_it = ack_waiting_list.emplace(ack_waiting_list.end(), command);
-
-		command_long(broadcast,
+		auto cmd = make_command_long(broadcast,
 			command, confirmation,
 			param1, param2,
 			param3, param4,
 			param5, param6,
 			param7);
 
-		if (is_ack_required) {
-			lock.unlock();
-			bool is_not_timeout = wait_ack_for(*ack_it);
-			lock.lock();
-
-			success = is_not_timeout && ack_it->result == enum_value(MAV_RESULT::ACCEPTED);
-			result = ack_it->result;
+		if (!is_ack_required(broadcast, confirmation)) {
+			UAS_FCU(m_uas)->send_message_ignore_drop(cmd);
 
-			ack_waiting_list.erase(ack_it);
-		}
-		else {
 			success = true;
 			result = enum_value(MAV_RESULT::ACCEPTED);
+			return true;
 		}
 
+		auto tr = start_transaction(cmd);
+		if (!tr)
+			return false;
+
+		wait_ack_for(lock, *tr);
+
+		// timeout leaves FAILED
+		success = tr->result == enum_value(MAV_RESULT::ACCEPTED);
+		result = tr->result;
 		return true;
 	}
 
+	/**
+	 * @note APM & PX4 master always send COMMAND_ACK. Old PX4 never.
+	 * Don't expect any ACK in broadcast mode.
+	 */
+	bool is_ack_required(bool broadcast, uint8_t confirmation)
+	{
+		return (confirmation != 0 || m_uas->is_ardupilotmega() || m_uas->is_px4()) && !broadcast;
+	}
+
 	/**
 	 * Common function for COMMAND_INT service callbacks.
 	 */
@@ -251,7 +411,7 @@ private:
 		cmd.target_component = tgt_comp_id;
 	}
 
-	void command_long(bool broadcast,
+	mavlink::common::msg::COMMAND_LONG make_command_long(bool broadcast,
 		uint16_t command, uint8_t confirmation,
 		float param1, float param2,
 		float param3, float param4,
@@ -273,7 +433,7 @@ private:
 		cmd.param6 = param6;
 		cmd.param7 = param7;
 
-		UAS_FCU(m_uas)->send_message_ignore_drop(cmd);
+		return cmd;
 	}
 
 	void command_int(bool broadcast,
@@ -316,6 +476,41 @@ private:
 			res->success, res->result);
 	}
 
+	/**
+	 * Non-blocking COMMAND_LONG, result published to command_status
+	 */
+	void command_async_cb(const mavros_msgs::msg::CommandAsync::SharedPtr req)
+	{
+		lock_guard lock(mutex);
+
+		auto cmd = make_command_long(req->broadcast,
+			req->command, req->confirmation,
+			req->param1, req->param2,
+			req->param3, req->param4,
+			req->param5, req->param6,
+			req->param7);
+
+		if (is_ack_required(req->broadcast, req->confirmation) &&
+				start_transaction(cmd, true, req->id))
+			return;
+
+		// status of command not waiting for ACK
+		CommandTransaction tr(cmd);
+		tr.is_async = true;
+		tr.async_id = req->id;
+
+		if (is_ack_required(req->broadcast, req->confirmation)) {
+			publish_status(tr, mavros_msgs::msg::CommandStatus::STATE_BUSY);
+			return;
+		}
+
+		UAS_FCU(m_uas)->send_message_ignore_drop(cmd);
+
+		tr.tries = 1;
+		tr.result = enum_value(mavlink::common::MAV_RESULT::ACCEPTED);
+		publish_status(tr, mavros_msgs::msg::CommandStatus::STATE_DONE);
+	}
+
 	void command_int_cb(const mavros_msgs::srv::CommandInt::Request::SharedPtr req,
 		mavros_msgs::srv::CommandInt::Response::SharedPtr res)
 	{
@@ -404,10 +599,13 @@ private:
 };
 
 constexpr double CommandPlugin::ACK_TIMEOUT_DEFAULT;
+constexpr int CommandPlugin::RETRIES_DEFAULT;
+constexpr uint8_t CommandPlugin::RESULT_IN_PROGRESS;
+constexpr std::chrono::milliseconds CommandPlugin::TIMEOUT_CHECK_DT;
 
 }	// namespace std_plugins
 }	// namespace mavros
 
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::CommandPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(command, mavros::std_plugins::CommandPlugin)
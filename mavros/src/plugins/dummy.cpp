@@ -63,15 +63,15 @@ public:
 private:
 	rclcpp::Node* nh;
 
-	void handle_heartbeat(const mavlink::mavlink_message_t *msg, mavlink::common::msg::HEARTBEAT &hb) {
+	void handle_heartbeat(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::HEARTBEAT &hb) {
 		RCUTILS_LOG_INFO_NAMED("dummy", "Dummy::handle_heartbeat: %s", hb.to_yaml().c_str());
 	}
 
-	void handle_sys_status(const mavlink::mavlink_message_t *msg, mavlink::common::msg::SYS_STATUS &st) {
+	void handle_sys_status(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::SYS_STATUS &st) {
 		RCUTILS_LOG_INFO_NAMED("dummy", "Dummy::handle_sys_status: %s", st.to_yaml().c_str());
 	}
 
-	void handle_statustext(const mavlink::mavlink_message_t *msg, mavlink::common::msg::STATUSTEXT &st) {
+	void handle_statustext(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::STATUSTEXT &st) {
 		RCUTILS_LOG_INFO_NAMED("dummy", "Dummy::handle_statustext: %s", st.to_yaml().c_str());
 	}
 
@@ -83,5 +83,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::DummyPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(dummy, mavros::std_plugins::DummyPlugin)
@@ -17,19 +17,26 @@
 #include <chrono>
 #include <cerrno>
 #include <condition_variable>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <mavros/mavros_plugin.h>
+#include <mavros/request_window.h>
 
 #include <std_srvs/srv/empty.hpp>
 #include <mavros_msgs/msg/file_entry.hpp>
+#include <mavros_msgs/msg/file_progress.hpp>
 #include <mavros_msgs/srv/file_list.hpp>
 #include <mavros_msgs/srv/file_open.hpp>
 #include <mavros_msgs/srv/file_close.hpp>
+#include <mavros_msgs/srv/file_download.hpp>
 #include <mavros_msgs/srv/file_read.hpp>
 #include <mavros_msgs/srv/file_write.hpp>
 #include <mavros_msgs/srv/file_remove.hpp>
 #include <mavros_msgs/srv/file_make_dir.hpp>
 #include <mavros_msgs/srv/file_remove_dir.hpp>
 #include <mavros_msgs/srv/file_truncate.hpp>
+#include <mavros_msgs/srv/file_upload.hpp>
 #include <mavros_msgs/srv/file_rename.hpp>
 #include <mavros_msgs/srv/file_checksum.hpp>
 
@@ -58,7 +65,8 @@ public:
 		uint8_t		opcode;		///< Command opcode
 		uint8_t		size;		///< Size of data
 		uint8_t		req_opcode;	///< Request opcode returned in kRspAck, kRspNak message
-		uint8_t		padding[2];	///< 32 bit aligment padding
+		uint8_t		burst_complete;	///< Last message of kCmdBurstReadFile burst
+		uint8_t		padding;	///< 32 bit aligment padding
 		uint32_t	offset;		///< Offsets for List and Read commands
 		uint8_t		data[];		///< command data, varies by Opcode
 	};
@@ -209,10 +217,20 @@ public:
 		list_offset(0),
 		read_offset(0),
 		write_offset(0),
+		write_size(0),
+		write_fd(-1),
+		write_window(WRITE_WINDOW, WRITE_RETRIES, std::chrono::milliseconds(CHUNK_TIMEOUT_MS)),
 		open_size(0),
 		read_size(0),
 		read_buffer {},
-		checksum_crc32(0)
+		checksum_crc32(0),
+		dl_fd(-1),
+		dl_size(0),
+		dl_received(0),
+		dl_high(0),
+		dl_first_missing(0),
+		dl_burst_supported(true),
+		dl_progress_reported(0)
 	{ }
 
 	void initialize(UAS &uas_)
@@ -221,6 +239,12 @@ public:
 
 		ftp_nh = uas_.mavros_node->create_sub_node("ftp");
 
+		// kCmdWriteFile in flight on write and upload, 1 - stop-and-wait
+		int write_window_size;
+		ftp_nh->get_parameter_or("ftp/write_window", write_window_size, int(WRITE_WINDOW));
+		write_window = RequestWindow(std::max(write_window_size, 1), WRITE_RETRIES,
+				std::chrono::milliseconds(CHUNK_TIMEOUT_MS));
+
 		// since C++ generator do not produce field length defs make check explicit.
 		FTPRequest r;
 		if (!(r.payload.size() - sizeof(FTPRequest::PayloadHeader) == r.DATA_MAXSZ)) {
@@ -251,6 +275,12 @@ public:
 			std::bind(&FTPPlugin::rename_cb, this, std::placeholders::_1, std::placeholders::_2));
 		checksum_srv = ftp_nh->create_service<mavros_msgs::srv::FileChecksum>("checksum", 
 			std::bind(&FTPPlugin::checksum_cb, this, std::placeholders::_1, std::placeholders::_2));
+		download_srv = ftp_nh->create_service<mavros_msgs::srv::FileDownload>("download", 
+			std::bind(&FTPPlugin::download_cb, this, std::placeholders::_1, std::placeholders::_2));
+		upload_srv = ftp_nh->create_service<mavros_msgs::srv::FileUpload>("upload", 
+			std::bind(&FTPPlugin::upload_cb, this, std::placeholders::_1, std::placeholders::_2));
+
+		progress_pub = ftp_nh->create_publisher<mavros_msgs::msg::FileProgress>("progress", 10);
 	}
 
 	Subscriptions get_subscriptions()
@@ -275,6 +305,9 @@ private:
 	rclcpp::Service<mavros_msgs::srv::FileTruncate>::SharedPtr truncate_srv;
 	rclcpp::Service<std_srvs::srv::Empty>::SharedPtr reset_srv;
 	rclcpp::Service<mavros_msgs::srv::FileChecksum>::SharedPtr checksum_srv;
+	rclcpp::Service<mavros_msgs::srv::FileDownload>::SharedPtr download_srv;
+	rclcpp::Service<mavros_msgs::srv::FileUpload>::SharedPtr upload_srv;
+	rclcpp::Publisher<mavros_msgs::msg::FileProgress>::SharedPtr progress_pub;
 
 	//! This type used in servicies to store 'data' fileds.
 	typedef std::vector<uint8_t> V_FileData;
@@ -286,7 +319,8 @@ private:
 		OPEN,
 		READ,
 		WRITE,
-		CHECKSUM
+		CHECKSUM,
+		DOWNLOAD
 	};
 
 	OP op_state;
@@ -313,20 +347,46 @@ private:
 	uint32_t read_offset;
 	V_FileData read_buffer;
 
-	// FTP:Write
+	// FTP:Write, chunk i is DATA_MAXSZ bytes at write_offset + i * DATA_MAXSZ,
+	// several chunks are in flight and acked by offset
+	std::mutex write_mutex;
 	uint32_t write_offset;
-	V_FileData write_buffer;
-	V_FileData::iterator write_it;
+	size_t write_size;
+	V_FileData write_buffer;	//!< source if write_fd < 0
+	int write_fd;			//!< source file, not owned
+	RequestWindow write_window;	//!< acked chunks and chunks in flight
 
 	// FTP:CalcCRC32
 	uint32_t checksum_crc32;
 
+	// FTP:Download, chunks may come out of order, they are written to dl_fd at once
+	std::mutex dl_mutex;
+	int dl_fd;
+	std::string dl_path;
+	size_t dl_size;
+	std::vector<bool> dl_chunks;	//!< received chunks bitmap, chunk is DATA_MAXSZ bytes
+	size_t dl_received;		//!< chunks received
+	size_t dl_high;			//!< chunks below were requested at least once
+	size_t dl_first_missing;	//!< no gaps below
+	bool dl_burst_supported;
+	size_t dl_progress_reported;	//!< bytes
+	std::chrono::steady_clock::time_point dl_last_activity;
+
 	// Timeouts,
 	// computed as x4 time that needed for transmission of
 	// one message at 57600 baud rate
 	static constexpr int LIST_TIMEOUT_MS = 5000;
 	static constexpr int OPEN_TIMEOUT_MS = 200;
 	static constexpr int CHUNK_TIMEOUT_MS = 200;
+	//! Download re-requests missing data after that long without chunks
+	static constexpr int DOWNLOAD_STALL_MS = 500;
+	static constexpr int DOWNLOAD_RETRIES = 5;
+	//! Write chunks in flight by default
+	static constexpr int WRITE_WINDOW = 8;
+	//! Resends of one write chunk
+	static constexpr int WRITE_RETRIES = 3;
+	//! Write resend check period
+	static constexpr int WRITE_TICK_MS = 20;
 
 	//! Maximum difference between allocated space and used
 	static constexpr size_t MAX_RESERVE_DIFF = 0x10000;
@@ -348,14 +408,24 @@ private:
 
 		const uint16_t incoming_seqnr = req.header()->seqNumber;
 		const uint16_t expected_seqnr = last_send_seqnr + 1;
-		if (incoming_seqnr != expected_seqnr) {
+		if (op_state == OP::WRITE) {
+			// several writes in flight, ACKs are matched by offset
+		}
+		else if (int16_t(incoming_seqnr - expected_seqnr) < 0) {
+			// late reply: resent by FCU, left from write window or burst
+			RCLCPP_DEBUG(logger, "FTP: stale seqnr: %u < %u", incoming_seqnr, expected_seqnr);
+			return;
+		}
+		else if (incoming_seqnr != expected_seqnr && op_state != OP::DOWNLOAD) {
+			// burst replies have own seq numbers, lost ones leave a gap
 			RCLCPP_WARN(logger, "FTP: Lost sync! seqnr: %u != %u",
 					incoming_seqnr, expected_seqnr);
 			go_idle(true, EILSEQ);
 			return;
 		}
 
-		last_send_seqnr = incoming_seqnr;
+		if (int16_t(incoming_seqnr - last_send_seqnr) > 0)
+			last_send_seqnr = incoming_seqnr;
 
 		// logic from QGCUASFileManager.cc
 		if (req.header()->opcode == FTPRequest::kRspAck)
@@ -378,6 +448,7 @@ private:
 		case OP::READ:		handle_ack_read(req);		break;
 		case OP::WRITE:		handle_ack_write(req);		break;
 		case OP::CHECKSUM:	handle_ack_checksum(req);	break;
+		case OP::DOWNLOAD:	handle_ack_download(req);	break;
 		default:
 			RCLCPP_ERROR(logger, "FTP: wrong op_state");
 			go_idle(true, EBADRQC);
@@ -388,10 +459,25 @@ private:
 	{
 		auto hdr = req.header();
 		auto error_code = static_cast<FTPRequest::ErrorCode>(req.data()[0]);
-		auto prev_op = op_state;
 
 		ROS_ASSERT(hdr->size == 1 || (error_code == FTPRequest::kErrFailErrno && hdr->size == 2));
 
+		// wait_download() must not see IDLE before download is continued or failed
+		std::lock_guard<std::mutex> lock(dl_mutex);
+
+		if (op_state == OP::DOWNLOAD && (error_code == FTPRequest::kErrEOF ||
+				(error_code == FTPRequest::kErrUnknownCommand && hdr->req_opcode == FTPRequest::kCmdBurstReadFile))) {
+			/* burst reached end of file, or burst not supported: request the rest */
+			if (error_code == FTPRequest::kErrUnknownCommand) {
+				RCLCPP_INFO(logger, "FTP: Download: burst read not supported, using kCmdReadFile");
+				dl_burst_supported = false;
+			}
+
+			download_next();
+			return;
+		}
+
+		auto prev_op = op_state;
 		op_state = OP::IDLE;
 		if (error_code == FTPRequest::kErrFailErrno)
 			r_errno = req.data()[1];
@@ -530,18 +616,42 @@ private:
 			read_file_end();
 	}
 
+	void handle_ack_download(FTPRequest &req)
+	{
+		std::lock_guard<std::mutex> lock(dl_mutex);
+		auto hdr = req.header();
+
+		if (hdr->session != active_session) {
+			RCUTILS_LOG_ERROR_NAMED("ftp", "FTP:Download unexpected session");
+			go_idle(true, EBADSLT);
+			return;
+		}
+
+		if (hdr->size > 0 && !download_store(hdr->offset, req.data(), hdr->size))
+			return;
+
+		if (dl_received == dl_chunks.size())
+			download_end();
+		else if (hdr->req_opcode == FTPRequest::kCmdReadFile || hdr->burst_complete)
+			download_next();
+	}
+
 	void handle_ack_write(FTPRequest &req)
 	{
+		std::lock_guard<std::mutex> lock(write_mutex);
 		auto hdr = req.header();
 
-		RCUTILS_LOG_DEBUG_NAMED("ftp", "FTP:m: ACK Write SZ(%u)", hdr->size);
+		RCUTILS_LOG_DEBUG_NAMED("ftp", "FTP:m: ACK Write SZ(%u) OFF(%u)", hdr->size, hdr->offset);
 		if (hdr->session != active_session) {
 			RCUTILS_LOG_ERROR_NAMED("ftp", "FTP:Write unexpected session");
 			go_idle(true, EBADSLT);
 			return;
 		}
 
-		if (hdr->offset != write_offset) {
+		const size_t rel_offset = hdr->offset - write_offset;
+		const size_t idx = rel_offset / FTPRequest::DATA_MAXSZ;
+		if (hdr->offset < write_offset || rel_offset % FTPRequest::DATA_MAXSZ != 0 ||
+				idx >= write_window.size()) {
 			RCUTILS_LOG_ERROR_NAMED("ftp", "FTP:Write different offset");
 			go_idle(true, EBADE);
 			return;
@@ -550,22 +660,17 @@ private:
 		ROS_ASSERT(hdr->size == sizeof(uint32_t));
 		const size_t bytes_written = *req.data_u32();
 
-		// check that reported size not out of range
-		const size_t bytes_left_before_advance = std::distance(write_it, write_buffer.end());
-		ROS_ASSERT_MSG(bytes_written <= bytes_left_before_advance, "Bad write size");
-		ROS_ASSERT(bytes_written != 0);
-
-		// move iterator to written size
-		std::advance(write_it, bytes_written);
-
-		const size_t bytes_to_copy = write_bytes_to_copy();
-		if (bytes_to_copy > 0) {
-			// More data to write
-			write_offset += bytes_written;
-			send_write_command(bytes_to_copy);
+		// chunks are not split, short write is an error
+		if (bytes_written != write_chunk_size(idx)) {
+			RCUTILS_LOG_ERROR_NAMED("ftp", "FTP:Write %zu of %zu bytes at offset %u",
+					bytes_written, write_chunk_size(idx), hdr->offset);
+			go_idle(true, EIO);
+			return;
 		}
-		else
-			write_file_end();
+
+		// ACK of resent chunk may come twice
+		write_window.received(idx, RequestWindow::clock::now());
+		write_poll();
 	}
 
 	void handle_ack_checksum(FTPRequest &req)
@@ -656,15 +761,48 @@ private:
 		req.send(m_uas, last_send_seqnr);
 	}
 
-	void send_write_command(const size_t bytes_to_copy)
+	void send_burst_read_command(uint32_t offset)
 	{
-		// write chunk from write_buffer [write_it..bytes_to_copy]
-		RCLCPP_DEBUG_STREAM(logger, "FTP:m: kCmdWriteFile: " << active_session << " off: " << write_offset << " sz: " << bytes_to_copy);
+		RCLCPP_DEBUG_STREAM(logger, "FTP:m: kCmdBurstReadFile: " << active_session << " off: " << offset);
+		FTPRequest req(FTPRequest::kCmdBurstReadFile, active_session);
+		req.header()->offset = offset;
+		req.header()->size = 0;
+		req.send(m_uas, last_send_seqnr);
+	}
+
+	void send_read_command(uint32_t offset)
+	{
+		RCLCPP_DEBUG_STREAM(logger, "FTP:m: kCmdReadFile: " << active_session << " off: " << offset);
+		FTPRequest req(FTPRequest::kCmdReadFile, active_session);
+		req.header()->offset = offset;
+		req.header()->size = 0;
+		req.send(m_uas, last_send_seqnr);
+	}
+
+	//! Send chunk @a idx from write_buffer or write_fd, false on local read error
+	bool send_write_command(size_t idx)
+	{
+		const size_t rel_offset = idx * FTPRequest::DATA_MAXSZ;
+		const size_t bytes_to_copy = write_chunk_size(idx);
+
+		RCLCPP_DEBUG_STREAM(logger, "FTP:m: kCmdWriteFile: " << active_session << " off: " << write_offset + rel_offset << " sz: " << bytes_to_copy);
 		FTPRequest req(FTPRequest::kCmdWriteFile, active_session);
-		req.header()->offset = write_offset;
+		req.header()->offset = write_offset + rel_offset;
 		req.header()->size = bytes_to_copy;
-		std::copy(write_it, write_it + bytes_to_copy, req.data());
-		req.send(m_uas, last_send_seqnr);
+
+		if (write_fd < 0) {
+			auto it = write_buffer.begin() + rel_offset;
+			std::copy(it, it + bytes_to_copy, req.data());
+		}
+		else if (::pread(write_fd, req.data(), bytes_to_copy, rel_offset) != ssize_t(bytes_to_copy)) {
+			RCUTILS_LOG_ERROR_NAMED("ftp", "FTP:Write local read failed: %s", strerror(errno));
+			go_idle(true, errno ? errno : EIO);
+			return false;
+		}
+
+		// every chunk in flight needs own seqnr, else FCU takes it for resent request
+		req.send(m_uas, last_send_seqnr++);
+		return true;
 	}
 
 	void send_remove_command(std::string &path) {
@@ -825,6 +963,25 @@ private:
 	}
 
 	bool write_file(std::string &path, size_t off, V_FileData &data)
+	{
+		std::lock_guard<std::mutex> lock(write_mutex);
+
+		write_buffer = std::move(data);
+		write_fd = -1;
+		return start_write(path, off, write_buffer.size());
+	}
+
+	//! Write @a size bytes of local @a fd to opened @a path
+	bool upload_file(std::string &path, int fd, size_t size)
+	{
+		std::lock_guard<std::mutex> lock(write_mutex);
+
+		write_buffer.clear();
+		write_fd = fd;
+		return start_write(path, 0, size);
+	}
+
+	bool start_write(std::string &path, size_t off, size_t size)
 	{
 		auto it = session_file_map.find(path);
 		if (it == session_file_map.end()) {
@@ -836,11 +993,56 @@ private:
 		op_state = OP::WRITE;
 		active_session = it->second;
 		write_offset = off;
-		write_buffer = std::move(data);
-		write_it = write_buffer.begin();
+		write_size = size;
 
-		send_write_command(write_bytes_to_copy());
-		
+		// empty write is one zero size chunk
+		write_window.reset(std::max<size_t>((size + FTPRequest::DATA_MAXSZ - 1) / FTPRequest::DATA_MAXSZ, 1));
+		write_poll();
+		return true;
+	}
+
+	/**
+	 * @brief Resend timed out chunks and fill write window, caller holds write_mutex
+	 */
+	void write_poll()
+	{
+		if (op_state != OP::WRITE)
+			return;
+
+		auto lost = write_window.poll(RequestWindow::clock::now(),
+				[this](size_t idx) {
+					if (op_state == OP::WRITE)
+						send_write_command(idx);
+				});
+
+		if (op_state != OP::WRITE)
+			return;
+
+		if (lost > 0) {
+			RCUTILS_LOG_ERROR_NAMED("ftp", "FTP:Write chunk not acked after %d retries", WRITE_RETRIES);
+			go_idle(true, ETIMEDOUT);
+		}
+		else if (write_window.done())
+			write_file_end();
+	}
+
+	/**
+	 * @brief Wait for write, resends are done from service thread
+	 */
+	bool wait_write()
+	{
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(cond_mutex);
+				cond.wait_for(lock, std::chrono::milliseconds(WRITE_TICK_MS));
+			}
+
+			std::lock_guard<std::mutex> lock(write_mutex);
+			if (op_state != OP::WRITE)
+				return !is_error;
+
+			write_poll();
+		}
 	}
 
 	void remove_file(std::string &path) {
@@ -874,12 +1076,159 @@ private:
 		send_calc_file_crc32_command(path);
 	}
 
+	/* -*- download -*- */
+
+	/**
+	 * @brief Start download of opened @a path to already opened @a fd
+	 */
+	void download_file(const std::string &path, uint32_t session, size_t size, int fd)
+	{
+		std::lock_guard<std::mutex> lock(dl_mutex);
+
+		op_state = OP::DOWNLOAD;
+		active_session = session;
+		dl_fd = fd;
+		dl_path = path;
+		dl_size = size;
+		dl_chunks.assign((size + FTPRequest::DATA_MAXSZ - 1) / FTPRequest::DATA_MAXSZ, false);
+		dl_received = 0;
+		dl_high = 0;
+		dl_first_missing = 0;
+		dl_burst_supported = true;
+		dl_progress_reported = 0;
+
+		if (dl_chunks.empty())
+			download_end();
+		else
+			download_next();
+	}
+
+	//! Write chunk to file, false on error
+	bool download_store(uint32_t offset, const uint8_t *data, size_t size)
+	{
+		size_t idx = offset / FTPRequest::DATA_MAXSZ;
+		if (offset % FTPRequest::DATA_MAXSZ != 0 || idx >= dl_chunks.size()) {
+			RCUTILS_LOG_WARN_NAMED("ftp", "FTP:Download unexpected offset %u", offset);
+			return true;
+		}
+
+		dl_last_activity = std::chrono::steady_clock::now();
+		if (dl_chunks[idx])
+			return true;
+
+		size = std::min(size, dl_size - offset);
+		if (::pwrite(dl_fd, data, size, offset) != ssize_t(size)) {
+			RCUTILS_LOG_ERROR_NAMED("ftp", "FTP:Download write failed: %s", strerror(errno));
+			go_idle(true, errno);
+			return false;
+		}
+
+		dl_chunks[idx] = true;
+		dl_received++;
+		dl_high = std::max(dl_high, idx + 1);
+
+		publish_download_progress();
+		return true;
+	}
+
+	/**
+	 * @brief Request what is missing: gaps one by one, then burst from the highest chunk
+	 */
+	void download_next()
+	{
+		dl_last_activity = std::chrono::steady_clock::now();
+
+		while (dl_first_missing < dl_high && dl_chunks[dl_first_missing])
+			dl_first_missing++;
+
+		if (dl_first_missing < dl_high) {
+			send_read_command(dl_first_missing * FTPRequest::DATA_MAXSZ);
+		}
+		else if (dl_high < dl_chunks.size()) {
+			if (dl_burst_supported)
+				send_burst_read_command(dl_high * FTPRequest::DATA_MAXSZ);
+			else
+				send_read_command(dl_high * FTPRequest::DATA_MAXSZ);
+		}
+		else
+			download_end();
+	}
+
+	void download_end()
+	{
+		RCUTILS_LOG_DEBUG_NAMED("ftp", "FTP:Download done");
+		publish_download_progress();
+		go_idle(false);
+	}
+
+	void publish_download_progress()
+	{
+		size_t transferred = std::min(dl_received * FTPRequest::DATA_MAXSZ, dl_size);
+		if (transferred < dl_size && transferred < dl_progress_reported + std::max<size_t>(dl_size / 100, 1))
+			return;
+
+		dl_progress_reported = transferred;
+
+		auto fp = std::make_unique<mavros_msgs::msg::FileProgress>();
+		fp->header.stamp = ftp_nh->get_clock()->now();
+		fp->file_path = dl_path;
+		fp->size = dl_size;
+		fp->transferred = transferred;
+
+		progress_pub->publish(std::move(fp));
+	}
+
+	/**
+	 * @brief Wait for download, re-request missing data when chunks stop coming
+	 */
+	bool wait_download()
+	{
+		int retries = DOWNLOAD_RETRIES;
+		size_t last_received = 0;
+
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(cond_mutex);
+				cond.wait_for(lock, std::chrono::milliseconds(DOWNLOAD_STALL_MS));
+			}
+
+			std::lock_guard<std::mutex> lock(dl_mutex);
+			if (op_state != OP::DOWNLOAD) {
+				// only complete file is success, whatever stopped the download
+				if (!is_error && dl_received != dl_chunks.size()) {
+					r_errno = EIO;
+					return false;
+				}
+
+				return !is_error;
+			}
+
+			if (dl_received != last_received) {
+				last_received = dl_received;
+				retries = DOWNLOAD_RETRIES;
+			}
+
+			if (std::chrono::steady_clock::now() - dl_last_activity < std::chrono::milliseconds(DOWNLOAD_STALL_MS))
+				continue;
+
+			if (retries-- == 0) {
+				op_state = OP::IDLE;
+				r_errno = ETIMEDOUT;
+				return false;
+			}
+
+			RCUTILS_LOG_WARN_NAMED("ftp", "FTP:Download stalled at %zu of %zu chunks, retries left %d",
+					dl_received, dl_chunks.size(), retries);
+			download_next();
+		}
+	}
+
 	static constexpr int compute_rw_timeout(size_t len) {
 		return CHUNK_TIMEOUT_MS * (len / FTPRequest::DATA_MAXSZ + 1);
 	}
 
-	size_t write_bytes_to_copy() {
-		return std::min<size_t>(std::distance(write_it, write_buffer.end()),
+	size_t write_chunk_size(size_t idx) {
+		return std::min<size_t>(write_size - idx * FTPRequest::DATA_MAXSZ,
 				FTPRequest::DATA_MAXSZ);
 	}
 
@@ -984,10 +1333,9 @@ private:
 	{
 		SERVICE_IDLE_CHECK();
 
-		const size_t data_size = req->data.size();
 		res->success = write_file(req->file_path, req->offset, req->data);
 		if (res->success) {
-			res->success = wait_completion(compute_rw_timeout(data_size));
+			res->success = wait_write();
 		}
 		write_buffer.clear();
 		res->r_errno = r_errno;
@@ -1072,6 +1420,93 @@ private:
 		
 	}
 
+	void download_cb(const mavros_msgs::srv::FileDownload::Request::SharedPtr req,
+			mavros_msgs::srv::FileDownload::Response::SharedPtr res)
+	{
+		SERVICE_IDLE_CHECK();
+
+		res->success = false;
+		res->size = 0;
+
+		if (session_file_map.count(req->file_path)) {
+			RCUTILS_LOG_ERROR_NAMED("ftp", "FTP: File %s: already opened",
+					req->file_path.c_str());
+			res->r_errno = EBUSY;
+			return;
+		}
+
+		int fd = ::open(req->local_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd < 0) {
+			RCUTILS_LOG_ERROR_NAMED("ftp", "FTP:Download %s: %s", req->local_path.c_str(), strerror(errno));
+			res->r_errno = errno;
+			return;
+		}
+
+		open_file(req->file_path, mavros_msgs::srv::FileOpen_Request::MODE_READ);
+		if (wait_completion(OPEN_TIMEOUT_MS)) {
+			download_file(req->file_path, session_file_map[req->file_path], open_size, fd);
+			res->success = wait_download();
+			res->size = open_size;
+			res->r_errno = r_errno;
+
+			// session is closed even if download failed
+			if (close_file(req->file_path))
+				wait_completion(OPEN_TIMEOUT_MS);
+		}
+		else
+			res->r_errno = r_errno;
+
+		if (::close(fd) != 0 && res->success) {
+			res->success = false;
+			res->r_errno = errno;
+		}
+	}
+
+	void upload_cb(const mavros_msgs::srv::FileUpload::Request::SharedPtr req,
+			mavros_msgs::srv::FileUpload::Response::SharedPtr res)
+	{
+		SERVICE_IDLE_CHECK();
+
+		res->success = false;
+		res->size = 0;
+
+		if (session_file_map.count(req->file_path)) {
+			RCUTILS_LOG_ERROR_NAMED("ftp", "FTP: File %s: already opened",
+					req->file_path.c_str());
+			res->r_errno = EBUSY;
+			return;
+		}
+
+		int fd = ::open(req->local_path.c_str(), O_RDONLY | O_CLOEXEC);
+		struct stat st;
+		if (fd < 0 || ::fstat(fd, &st) != 0) {
+			RCUTILS_LOG_ERROR_NAMED("ftp", "FTP:Upload %s: %s", req->local_path.c_str(), strerror(errno));
+			res->r_errno = errno;
+			if (fd >= 0)
+				::close(fd);
+			return;
+		}
+
+		open_file(req->file_path, mavros_msgs::srv::FileOpen_Request::MODE_CREATE);
+		if (wait_completion(OPEN_TIMEOUT_MS)) {
+			res->success = upload_file(req->file_path, fd, st.st_size) && wait_write();
+			res->size = res->success ? st.st_size : 0;
+			res->r_errno = r_errno;
+
+			// session is closed even if upload failed
+			if (close_file(req->file_path))
+				wait_completion(OPEN_TIMEOUT_MS);
+		}
+		else
+			res->r_errno = r_errno;
+
+		{
+			std::lock_guard<std::mutex> lock(write_mutex);
+			write_fd = -1;
+		}
+		::close(fd);
+	}
+
 #undef SERVICE_IDLE_CHECK
 
 	/**
@@ -1084,8 +1519,14 @@ private:
 		send_reset();
 	}
 };
+
+constexpr int FTPPlugin::CHUNK_TIMEOUT_MS;
+constexpr int FTPPlugin::DOWNLOAD_STALL_MS;
+constexpr int FTPPlugin::WRITE_WINDOW;
+constexpr int FTPPlugin::WRITE_RETRIES;
+constexpr int FTPPlugin::WRITE_TICK_MS;
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::FTPPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(ftp, mavros::std_plugins::FTPPlugin)
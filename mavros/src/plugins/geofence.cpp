@@ -0,0 +1,537 @@
+/**
+ * @brief Geofence plugin
+ * @file geofence.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup plugin
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <mavros/mavros_plugin.h>
+#include <mavros/geofence_index.h>
+
+#include <mavros_msgs/srv/waypoint_clear.hpp>
+#include <mavros_msgs/srv/waypoint_push.hpp>
+
+using std::chrono_literals::operator""ms;
+
+namespace mavros {
+namespace std_plugins {
+using utils::enum_value;
+using mavlink::common::MAV_CMD;
+using mavlink::common::MAV_MISSION_TYPE;
+using MRES = mavlink::common::MAV_MISSION_RESULT;
+
+/**
+ * @brief Geofence plugin
+ *
+ * Uploads polygon and circle fence by mission protocol (MAV_MISSION_TYPE_FENCE)
+ * and keeps GeofenceIndex of accepted fence in UAS, setpoint plugins check their
+ * position setpoints against it.
+ *
+ * Fence items are mavros_msgs/Waypoint with MAV_CMD_NAV_FENCE_* commands:
+ * polygon vertex has vertex count in param1, circle has radius [m] in param1,
+ * x_lat / y_long are coordinates of vertex or center.
+ */
+class GeofencePlugin : public plugin::PluginBase {
+public:
+	GeofencePlugin() : PluginBase(),
+		logger(rclcpp::get_logger("mavros.geofence")),
+		gf_state(GF::IDLE),
+		gf_count(0),
+		gf_cur_id(0),
+		gf_retries(RETRIES_COUNT),
+		is_timedout(false),
+		tx_as_int(false),
+		origin_valid(false)
+	{ }
+
+	void initialize(UAS &uas_)
+	{
+		PluginBase::initialize(uas_);
+
+		gf_nh = uas_.mavros_node->create_sub_node("geofence");
+
+		std::string action, inclusion;
+		// what to do with position setpoint out of fence: none, reject or clamp
+		gf_nh->get_parameter_or<std::string>("geofence/setpoint_action", action, "reject");
+		// keep-in zones: all - setpoint must be inside of all of them, any - inside of one
+		gf_nh->get_parameter_or<std::string>("geofence/inclusion", inclusion, "all");
+		// clamped setpoint distance from fence [m]
+		gf_nh->get_parameter_or("geofence/margin", fence_opts.margin, 0.5);
+
+		if (action == "none")
+			fence_opts.action = GeofenceIndex::Action::NONE;
+		else if (action == "clamp")
+			fence_opts.action = GeofenceIndex::Action::CLAMP;
+		else {
+			if (action != "reject")
+				RCLCPP_WARN(logger, "GF: unknown setpoint_action %s, using reject", action.c_str());
+			fence_opts.action = GeofenceIndex::Action::REJECT;
+		}
+
+		if (inclusion != "all" && inclusion != "any")
+			RCLCPP_WARN(logger, "GF: unknown inclusion %s, using all", inclusion.c_str());
+		fence_opts.any_inclusion = inclusion == "any";
+
+		push_srv = gf_nh->create_service<mavros_msgs::srv::WaypointPush>("push",
+			std::bind(&GeofencePlugin::push_cb, this, std::placeholders::_1, std::placeholders::_2));
+		clear_srv = gf_nh->create_service<mavros_msgs::srv::WaypointClear>("clear",
+			std::bind(&GeofencePlugin::clear_cb, this, std::placeholders::_1, std::placeholders::_2));
+
+		gf_timer = create_timer(std::bind(&GeofencePlugin::timeout_cb, this));
+		origin_timer = create_timer(std::bind(&GeofencePlugin::origin_cb, this));
+		origin_timer->start_periodic(ORIGIN_CHECK_MS);
+	}
+
+	Subscriptions get_subscriptions() {
+		return {
+			       make_handler(&GeofencePlugin::handle_mission_request),
+			       make_handler(&GeofencePlugin::handle_mission_request_int),
+			       make_handler(&GeofencePlugin::handle_mission_ack),
+		};
+	}
+
+private:
+	using unique_lock = std::unique_lock<std::recursive_mutex>;
+	using lock_guard = std::lock_guard<std::recursive_mutex>;
+
+	std::recursive_mutex mutex;
+	rclcpp::Node::SharedPtr gf_nh;
+	rclcpp::Logger logger;
+
+	rclcpp::Service<mavros_msgs::srv::WaypointPush>::SharedPtr push_srv;
+	rclcpp::Service<mavros_msgs::srv::WaypointClear>::SharedPtr clear_srv;
+
+	enum class GF {
+		IDLE,
+		TXLIST,
+		TXWP,
+		CLEAR,
+	};
+	GF gf_state;
+
+	std::vector<mavros_msgs::msg::Waypoint> fence_items;	//!< accepted by FCU
+	std::vector<mavros_msgs::msg::Waypoint> send_items;
+	size_t gf_count;
+	size_t gf_cur_id;
+	size_t gf_retries;
+	bool is_timedout;
+	bool tx_as_int;			//!< FCU requested MISSION_ITEM_INT
+	std::mutex send_cond_mutex;
+	std::condition_variable list_sending;
+
+	GeofenceIndex::Options fence_opts;
+	GeofenceIndex::Origin origin;	//!< of index in UAS
+	bool origin_valid;
+
+	TimerWheel::Ptr gf_timer;
+	TimerWheel::Ptr origin_timer;	//!< rebuilds index when home changes
+
+	static constexpr std::chrono::milliseconds LIST_TIMEOUT_MS = 30000ms;
+	static constexpr std::chrono::milliseconds GF_TIMEOUT_MS = 1000ms;
+	static constexpr std::chrono::milliseconds ORIGIN_CHECK_MS = 1000ms;
+	static constexpr int RETRIES_COUNT = 3;
+
+	static bool is_fence(uint8_t mission_type)
+	{
+		return mission_type == enum_value(MAV_MISSION_TYPE::FENCE);
+	}
+
+	/* -*- rx handlers -*- */
+
+	void handle_mission_request(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::MISSION_REQUEST &mreq)
+	{
+		if (is_fence(mreq.mission_type))
+			answer_request(mreq.seq, false);
+	}
+
+	void handle_mission_request_int(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::MISSION_REQUEST_INT &mreq)
+	{
+		if (is_fence(mreq.mission_type))
+			answer_request(mreq.seq, true);
+	}
+
+	void answer_request(uint16_t seq, bool as_int)
+	{
+		lock_guard lock(mutex);
+
+		if (!((gf_state == GF::TXLIST && seq == 0) || gf_state == GF::TXWP)) {
+			RCLCPP_DEBUG(logger, "GF: rejecting request, wrong state %d", enum_value(gf_state));
+			return;
+		}
+
+		if (seq >= gf_count) {
+			RCLCPP_ERROR(logger, "GF: FCU require seq out of range");
+			return;
+		}
+
+		RCLCPP_DEBUG(logger, "GF: FCU requested item %d", seq);
+		gf_state = GF::TXWP;
+		gf_cur_id = seq;
+		tx_as_int = as_int;
+		restart_timeout_timer();
+		send_item(gf_cur_id, tx_as_int);
+	}
+
+	void handle_mission_ack(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::MISSION_ACK &mack)
+	{
+		if (!is_fence(mack.mission_type))
+			return;
+
+		unique_lock lock(mutex);
+
+		auto ack_type = static_cast<MRES>(mack.type);
+
+		if ((gf_state == GF::TXLIST || gf_state == GF::TXWP) &&
+				(gf_cur_id + 1 == gf_count || gf_count == 0) && ack_type == MRES::ACCEPTED) {
+			go_idle();
+			fence_items = std::move(send_items);
+			send_items.clear();
+			update_index();
+
+			lock.unlock();
+			list_sending.notify_all();
+			RCLCPP_INFO(logger, "GF: fence sent, %zu items", fence_items.size());
+		}
+		else if (gf_state == GF::TXWP && ack_type == MRES::INVALID_SEQUENCE) {
+			// request of next item will come
+			RCLCPP_DEBUG(logger, "GF: Received INVALID_SEQUENCE ack");
+		}
+		else if (gf_state == GF::TXLIST || gf_state == GF::TXWP || gf_state == GF::CLEAR) {
+			bool cleared = gf_state == GF::CLEAR && ack_type == MRES::ACCEPTED;
+			go_idle();
+			if (cleared) {
+				fence_items.clear();
+				update_index();
+				RCLCPP_INFO(logger, "GF: fence cleared");
+			}
+			else {
+				is_timedout = true;
+				RCLCPP_ERROR_STREAM(logger, "GF: operation failed: " << utils::to_string(ack_type));
+			}
+
+			lock.unlock();
+			list_sending.notify_all();
+		}
+		else
+			RCLCPP_DEBUG(logger, "GF: not planned ACK, type: %d", mack.type);
+	}
+
+	/* -*- fence index -*- */
+
+	/**
+	 * @brief Convert fence items to zones
+	 * @return false if items do not make fence
+	 */
+	static bool make_zones(const std::vector<mavros_msgs::msg::Waypoint> &items, const GeofenceIndex::Origin &origin,
+			std::vector<GeofenceIndex::Zone> &zones, std::string &error)
+	{
+		zones.clear();
+
+		for (size_t i = 0; i < items.size(); ) {
+			auto &it = items[i];
+			Eigen::Vector2d p = GeofenceIndex::to_local(origin, it.x_lat, it.y_long);
+
+			switch (it.command) {
+			case enum_value(MAV_CMD::NAV_FENCE_POLYGON_VERTEX_INCLUSION):
+			case enum_value(MAV_CMD::NAV_FENCE_POLYGON_VERTEX_EXCLUSION): {
+				size_t n = std::lround(it.param1);
+				if (n < 3 || i + n > items.size()) {
+					error = utils::format("item %zu: bad vertex count %zu", i, n);
+					return false;
+				}
+
+				std::vector<Eigen::Vector2d> vertices;
+				for (size_t j = i; j < i + n; j++) {
+					if (items[j].command != it.command || std::lround(items[j].param1) != long(n)) {
+						error = utils::format("item %zu: polygon of %zu vertices is broken", j, n);
+						return false;
+					}
+
+					vertices.push_back(GeofenceIndex::to_local(origin, items[j].x_lat, items[j].y_long));
+				}
+
+				zones.push_back(GeofenceIndex::polygon(
+						it.command == enum_value(MAV_CMD::NAV_FENCE_POLYGON_VERTEX_INCLUSION), vertices));
+				i += n;
+				break;
+			}
+
+			case enum_value(MAV_CMD::NAV_FENCE_CIRCLE_INCLUSION):
+			case enum_value(MAV_CMD::NAV_FENCE_CIRCLE_EXCLUSION):
+				if (!(it.param1 > 0.0)) {
+					error = utils::format("item %zu: bad circle radius", i);
+					return false;
+				}
+
+				zones.push_back(GeofenceIndex::circle(
+						it.command == enum_value(MAV_CMD::NAV_FENCE_CIRCLE_INCLUSION), p, it.param1));
+				i++;
+				break;
+
+			case enum_value(MAV_CMD::NAV_FENCE_RETURN_POINT):
+				// used by FCU only
+				i++;
+				break;
+
+			default:
+				error = utils::format("item %zu: command %d is not fence item", i, it.command);
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	 * @brief Replace index in UAS by one of fence_items
+	 *
+	 * Setpoints are local to EKF origin, so fence plane is tied to home position,
+	 * index is not made until home is known.
+	 */
+	void update_index()
+	{
+		auto home = m_uas->get_home();
+		if (fence_items.empty() || !home.valid) {
+			origin_valid = false;
+			m_uas->set_geofence(nullptr);
+			return;
+		}
+
+		origin = {home.latitude, home.longitude, Eigen::Vector2d(home.position.x, home.position.y)};
+		origin_valid = true;
+
+		std::vector<GeofenceIndex::Zone> zones;
+		std::string error;
+		if (!make_zones(fence_items, origin, zones, error)) {
+			RCLCPP_ERROR(logger, "GF: %s", error.c_str());
+			m_uas->set_geofence(nullptr);
+			return;
+		}
+
+		RCLCPP_DEBUG(logger, "GF: index of %zu zones at %f %f", zones.size(), origin.latitude, origin.longitude);
+		m_uas->set_geofence(std::make_shared<const GeofenceIndex>(std::move(zones), fence_opts, origin));
+	}
+
+	void origin_cb()
+	{
+		lock_guard lock(mutex);
+		if (fence_items.empty())
+			return;
+
+		auto home = m_uas->get_home();
+		if (home.valid == origin_valid && (!home.valid || (
+				home.latitude == origin.latitude && home.longitude == origin.longitude &&
+				home.position.x == origin.local.x() && home.position.y == origin.local.y())))
+			return;
+
+		RCLCPP_INFO(logger, "GF: home changed, updating fence index");
+		update_index();
+	}
+
+	/* -*- mid-level helpers -*- */
+
+	void timeout_cb()
+	{
+		unique_lock lock(mutex);
+		if (gf_retries > 0) {
+			gf_retries--;
+			RCLCPP_WARN(logger, "GF: timeout, retries left %zu", gf_retries);
+
+			switch (gf_state) {
+			case GF::TXLIST:
+				mission_count(gf_count);
+				break;
+			case GF::TXWP:
+				send_item(gf_cur_id, tx_as_int);
+				break;
+			case GF::CLEAR:
+				mission_clear_all();
+				break;
+			case GF::IDLE:
+				break;
+			}
+		}
+		else {
+			RCLCPP_ERROR(logger, "GF: timed out.");
+			go_idle();
+			is_timedout = true;
+			lock.unlock();
+			list_sending.notify_all();
+		}
+	}
+
+	void restart_timeout_timer()
+	{
+		gf_retries = RETRIES_COUNT;
+		is_timedout = false;
+		gf_timer->start_periodic(GF_TIMEOUT_MS);
+	}
+
+	void go_idle()
+	{
+		gf_state = GF::IDLE;
+		gf_timer->cancel();
+	}
+
+	bool wait_push_all()
+	{
+		std::unique_lock<std::mutex> lock(send_cond_mutex);
+
+		return list_sending.wait_for(lock, LIST_TIMEOUT_MS)
+		       == std::cv_status::no_timeout
+		       && !is_timedout;
+	}
+
+	/* -*- low-level send functions -*- */
+
+	void send_item(size_t seq, bool as_int)
+	{
+		auto &wp = send_items[seq];
+
+		if (as_int) {
+			mavlink::common::msg::MISSION_ITEM_INT mit {};
+			m_uas->msg_set_target(mit);
+			mit.seq = seq;
+			mit.frame = wp.frame;
+			mit.command = wp.command;
+			mit.autocontinue = wp.autocontinue;
+			mit.param1 = wp.param1;
+			mit.param2 = wp.param2;
+			mit.param3 = wp.param3;
+			mit.param4 = wp.param4;
+			mit.x = std::lround(wp.x_lat * 1e7);
+			mit.y = std::lround(wp.y_long * 1e7);
+			mit.z = wp.z_alt;
+			mit.mission_type = enum_value(MAV_MISSION_TYPE::FENCE);
+
+			UAS_FCU(m_uas)->send_message_ignore_drop(mit);
+			return;
+		}
+
+		mavlink::common::msg::MISSION_ITEM mit {};
+		m_uas->msg_set_target(mit);
+		mit.seq = seq;
+		mit.frame = wp.frame;
+		mit.command = wp.command;
+		mit.autocontinue = wp.autocontinue;
+		mit.param1 = wp.param1;
+		mit.param2 = wp.param2;
+		mit.param3 = wp.param3;
+		mit.param4 = wp.param4;
+		mit.x = wp.x_lat;
+		mit.y = wp.y_long;
+		mit.z = wp.z_alt;
+		mit.mission_type = enum_value(MAV_MISSION_TYPE::FENCE);
+
+		UAS_FCU(m_uas)->send_message_ignore_drop(mit);
+	}
+
+	void mission_count(uint16_t cnt)
+	{
+		RCLCPP_DEBUG(logger, "GF:m: count %u", cnt);
+
+		mavlink::common::msg::MISSION_COUNT mcnt {};
+		m_uas->msg_set_target(mcnt);
+		mcnt.count = cnt;
+		mcnt.mission_type = enum_value(MAV_MISSION_TYPE::FENCE);
+
+		UAS_FCU(m_uas)->send_message_ignore_drop(mcnt);
+	}
+
+	void mission_clear_all()
+	{
+		RCLCPP_DEBUG(logger, "GF:m: clear all");
+
+		mavlink::common::msg::MISSION_CLEAR_ALL mclr {};
+		m_uas->msg_set_target(mclr);
+		mclr.mission_type = enum_value(MAV_MISSION_TYPE::FENCE);
+
+		UAS_FCU(m_uas)->send_message_ignore_drop(mclr);
+	}
+
+	/* -*- ROS callbacks -*- */
+
+	bool push_cb(mavros_msgs::srv::WaypointPush::Request::SharedPtr req,
+		mavros_msgs::srv::WaypointPush::Response::SharedPtr res)
+	{
+		unique_lock lock(mutex);
+
+		if (gf_state != GF::IDLE)
+			// Wrong initial state, other operation in progress?
+			return false;
+
+		// check before upload, FCU gets only fence mavros can enforce too
+		std::vector<GeofenceIndex::Zone> zones;
+		std::string error;
+		GeofenceIndex::Origin check_origin{0.0, 0.0, Eigen::Vector2d::Zero()};
+		if (!req->waypoints.empty()) {
+			check_origin.latitude = req->waypoints.front().x_lat;
+			check_origin.longitude = req->waypoints.front().y_long;
+		}
+
+		if (req->start_index != 0 || !make_zones(req->waypoints, check_origin, zones, error)) {
+			RCLCPP_WARN(logger, "GF: fence rejected: %s", req->start_index ? "partial push is not supported" : error.c_str());
+			res->success = false;
+			res->wp_transfered = 0;
+			return true;
+		}
+
+		gf_state = GF::TXLIST;
+		send_items = req->waypoints;
+		gf_count = send_items.size();
+		gf_cur_id = 0;
+		restart_timeout_timer();
+
+		lock.unlock();
+		mission_count(gf_count);
+		res->success = wait_push_all();
+		lock.lock();
+
+		res->wp_transfered = res->success ? gf_count : gf_cur_id;
+		go_idle();	// prevents from blocking after timeout
+		return true;
+	}
+
+	bool clear_cb(mavros_msgs::srv::WaypointClear::Request::SharedPtr req,
+		mavros_msgs::srv::WaypointClear::Response::SharedPtr res)
+	{
+		unique_lock lock(mutex);
+
+		if (gf_state != GF::IDLE)
+			return false;
+
+		gf_state = GF::CLEAR;
+		restart_timeout_timer();
+
+		lock.unlock();
+		mission_clear_all();
+		res->success = wait_push_all();
+
+		lock.lock();
+		go_idle();
+		return true;
+	}
+};
+
+constexpr std::chrono::milliseconds GeofencePlugin::LIST_TIMEOUT_MS;
+constexpr std::chrono::milliseconds GeofencePlugin::GF_TIMEOUT_MS;
+constexpr std::chrono::milliseconds GeofencePlugin::ORIGIN_CHECK_MS;
+constexpr int GeofencePlugin::RETRIES_COUNT;
+
+}	// namespace std_plugins
+}	// namespace mavros
+
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(geofence, mavros::std_plugins::GeofencePlugin)
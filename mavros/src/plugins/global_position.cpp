@@ -69,6 +69,12 @@ public:
 		tf_frame_id = gp_nh->declare_parameter<std::string>("global_position/tf/frame_id", "map");
 		tf_global_frame_id = gp_nh->declare_parameter<std::string>("global_position/tf/global_frame_id", "earth");	// The global_origin should be represented as "earth" coordinate frame (ECEF) (REP 105)
 		tf_child_frame_id = gp_nh->declare_parameter<std::string>("global_position/tf/child_frame_id", "base_link");
+		// 0 - send each update
+		auto tf_rate_limit = gp_nh->declare_parameter("global_position/tf/rate_limit", 0.0);
+		if (tf_send) {
+			m_uas->tf2_batcher.set_rate_limit(tf_child_frame_id, tf_rate_limit);
+			m_uas->tf2_batcher.set_rate_limit(tf_frame_id, tf_rate_limit);
+		}
 
 		UAS_DIAG(m_uas).add("GPS", this, &GlobalPositionPlugin::gps_diag_run);
 
@@ -96,6 +102,25 @@ public:
 
 		// offset from local position to the global origin ("earth")
 		gp_global_offset_pub = gp_nh->create_publisher<geometry_msgs::msg::PoseStamped>("gp_lp_offset", 10);
+
+		raw_fix_subs = watch_subscribers(raw_fix_pub);
+		raw_vel_subs = watch_subscribers(raw_vel_pub);
+		raw_sat_subs = watch_subscribers(raw_sat_pub);
+		gp_fix_subs = watch_subscribers(gp_fix_pub);
+		gp_odom_subs = watch_subscribers(gp_odom_pub);
+		gp_rel_alt_subs = watch_subscribers(gp_rel_alt_pub);
+		gp_hdg_subs = watch_subscribers(gp_hdg_pub);
+		gp_global_origin_subs = watch_subscribers(gp_global_origin_pub);
+		gp_global_offset_subs = watch_subscribers(gp_global_offset_pub);
+
+		// GPS_RAW_INT is not managed: UAS keeps the fix for other plugins
+		if (!tf_send) {
+			const std::vector<mavlink::msgid_t> gpos{mavlink::common::msg::GLOBAL_POSITION_INT::MSG_ID};
+			watch_stream(gp_fix_pub, gpos, 10.0);
+			watch_stream(gp_odom_pub, gpos, 10.0);
+			watch_stream(gp_rel_alt_pub, gpos, 10.0);
+			watch_stream(gp_hdg_pub, gpos, 10.0);
+		}
 	}
 
 	Subscriptions get_subscriptions()
@@ -122,6 +147,23 @@ private:
 	rclcpp::Publisher<geographic_msgs::msg::GeoPointStamped>::SharedPtr gp_global_origin_pub;
 	rclcpp::Publisher<geometry_msgs::msg::PoseStamped>::SharedPtr gp_global_offset_pub;
 
+	SubscriberCount raw_fix_subs;
+	SubscriberCount raw_vel_subs;
+	SubscriberCount raw_sat_subs;
+	SubscriberCount gp_odom_subs;
+	SubscriberCount gp_fix_subs;
+	SubscriberCount gp_hdg_subs;
+	SubscriberCount gp_rel_alt_subs;
+	SubscriberCount gp_global_origin_subs;
+	SubscriberCount gp_global_offset_subs;
+
+	MessagePool<geometry_msgs::msg::TwistStamped> raw_vel_pool;
+	MessagePool<std_msgs::msg::UInt32> raw_sat_pool;
+	MessagePool<nav_msgs::msg::Odometry> gp_odom_pool;
+	MessagePool<sensor_msgs::msg::NavSatFix> gp_fix_pool;
+	MessagePool<std_msgs::msg::Float64> float_pool;
+	MessagePool<geometry_msgs::msg::PoseStamped> gp_global_offset_pool;
+
 	rclcpp::Subscription<geographic_msgs::msg::GeoPointStamped>::SharedPtr gp_set_global_origin_sub;
 	rclcpp::Subscription<mavros_msgs::msg::HomePosition>::SharedPtr hp_sub;
 
@@ -143,23 +185,23 @@ private:
 	Eigen::Vector3d local_ecef {0, 0, 0};	//!< local ECEF coordinates on map frame [m]
 
 	template<typename MsgT>
-	inline void fill_lla(MsgT &msg, sensor_msgs::msg::NavSatFix::SharedPtr fix)
+	inline void fill_lla(const MsgT &msg, sensor_msgs::msg::NavSatFix &fix)
 	{
-		fix->latitude = msg.lat / 1E7;		// deg
-		fix->longitude = msg.lon / 1E7;		// deg
-		fix->altitude = msg.alt / 1E3 + m_uas->geoid_to_ellipsoid_height(fix);	// in meters
+		fix.latitude = msg.lat / 1E7;		// deg
+		fix.longitude = msg.lon / 1E7;		// deg
+		fix.altitude = msg.alt / 1E3 + m_uas->geoid_to_ellipsoid_height(&fix);	// in meters
 	}
 
-	inline void fill_unknown_cov(sensor_msgs::msg::NavSatFix::SharedPtr fix)
+	inline void fill_unknown_cov(sensor_msgs::msg::NavSatFix &fix)
 	{
-		fix->position_covariance.fill(0.0);
-		fix->position_covariance[0] = -1.0;
-		fix->position_covariance_type = sensor_msgs::msg::NavSatFix::COVARIANCE_TYPE_UNKNOWN;
+		fix.position_covariance.fill(0.0);
+		fix.position_covariance[0] = -1.0;
+		fix.position_covariance_type = sensor_msgs::msg::NavSatFix::COVARIANCE_TYPE_UNKNOWN;
 	}
 
 	/* -*- message handlers -*- */
 
-	void handle_gps_raw_int(const mavlink::mavlink_message_t *msg, mavlink::common::msg::GPS_RAW_INT &raw_gps)
+	void handle_gps_raw_int(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::GPS_RAW_INT &raw_gps)
 	{
 		auto fix = std::make_shared<sensor_msgs::msg::NavSatFix>();
 
@@ -173,7 +215,7 @@ private:
 			fix->status.status = sensor_msgs::msg::NavSatStatus::STATUS_NO_FIX;
 		}
 
-		fill_lla(raw_gps, fix);
+		fill_lla(raw_gps, *fix);
 
 		float eph = (raw_gps.eph != UINT16_MAX) ? raw_gps.eph / 1E2F : NAN;
 		float epv = (raw_gps.epv != UINT16_MAX) ? raw_gps.epv / 1E2F : NAN;
@@ -192,19 +234,20 @@ private:
 			fix->position_covariance_type = sensor_msgs::msg::NavSatFix::COVARIANCE_TYPE_APPROXIMATED;
 		}
 		else {
-			fill_unknown_cov(fix);
+			fill_unknown_cov(*fix);
 		}
 
 		// store & publish
 		m_uas->update_gps_fix_epts(fix, eph, epv, raw_gps.fix_type, raw_gps.satellites_visible);
-		raw_fix_pub->publish(*fix);
+		if (raw_fix_subs)
+			raw_fix_pub->publish(*fix);
 
-		if (raw_gps.vel != UINT16_MAX &&
+		if (raw_vel_subs && raw_gps.vel != UINT16_MAX &&
 					raw_gps.cog != UINT16_MAX) {
 			double speed = raw_gps.vel / 1E2;				// m/s
 			double course = angles::from_degrees(raw_gps.cog / 1E2);	// rad
 
-			auto vel = std::make_shared<geometry_msgs::msg::TwistStamped>();
+			auto vel = raw_vel_pool.acquire();
 
 			vel->header.stamp = fix->header.stamp;
 			vel->header.frame_id = frame_id;
@@ -213,17 +256,24 @@ private:
 			vel->twist.linear.x = speed * std::sin(course);
 			vel->twist.linear.y = speed * std::cos(course);
 
-			raw_vel_pub->publish(*vel);
+			raw_vel_pool.publish(*raw_vel_pub, std::move(vel));
 		}
 
 		// publish satellite count
-		auto sat_cnt = std::make_shared<std_msgs::msg::UInt32>();
+		if (!raw_sat_subs)
+			return;
+
+		auto sat_cnt = raw_sat_pool.acquire();
 		sat_cnt->data = raw_gps.satellites_visible;
-		raw_sat_pub->publish(*sat_cnt);
+		raw_sat_pool.publish(*raw_sat_pub, std::move(sat_cnt));
 	}
 
-	void handle_gps_global_origin(const mavlink::mavlink_message_t *msg, mavlink::common::msg::GPS_GLOBAL_ORIGIN &glob_orig)
+	void handle_gps_global_origin(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::GPS_GLOBAL_ORIGIN &glob_orig)
 	{
+		// geoid and ECEF conversion only for the topic
+		if (!gp_global_origin_subs)
+			return;
+
 		auto g_origin = std::make_shared<geographic_msgs::msg::GeoPointStamped>();
 		// auto header = m_uas->synchronized_header(frame_id, glob_orig.time_boot_ms);	#TODO: requires Mavlink msg update
 
@@ -254,19 +304,19 @@ private:
 
 	/** @todo Handler for GLOBAL_POSITION_INT_COV */
 
-	void handle_global_position_int(const mavlink::mavlink_message_t *msg, mavlink::common::msg::GLOBAL_POSITION_INT &gpos)
+	void handle_global_position_int(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::GLOBAL_POSITION_INT &gpos)
 	{
-		auto odom = std::make_shared<nav_msgs::msg::Odometry>();
-		auto fix = std::make_shared<sensor_msgs::msg::NavSatFix>();
-		auto relative_alt = std::make_shared<std_msgs::msg::Float64>();
-		auto compass_heading = std::make_shared<std_msgs::msg::Float64>();
+		auto odom = gp_odom_pool.acquire();
+		auto fix = gp_fix_pool.acquire();
+		auto relative_alt = float_pool.acquire();
+		auto compass_heading = float_pool.acquire();
 
 		auto header = m_uas->synchronized_header(child_frame_id, gpos.time_boot_ms);
 
 		// Global position fix
 		fix->header = header;
 
-		fill_lla(gpos, fix);
+		fill_lla(gpos, *fix);
 
 		// fill GPS status fields using GPS_RAW data
 		auto raw_fix = m_uas->get_gps_fix();
@@ -282,7 +332,7 @@ private:
 			fix->status.status = sensor_msgs::msg::NavSatStatus::STATUS_NO_FIX;
 
 			// we don't know covariance
-			fill_unknown_cov(fix);
+			fill_unknown_cov(*fix);
 		}
 
 		relative_alt->data = gpos.relative_alt / 1E3;	// in meters
@@ -377,12 +427,6 @@ private:
 								rot_cov,
 									rot_cov;
 
-		// publish
-		gp_fix_pub->publish(*fix);
-		gp_odom_pub->publish(*odom);
-		gp_rel_alt_pub->publish(*relative_alt);
-		gp_hdg_pub->publish(*compass_heading);
-
 		// TF
 		if (tf_send) {
 			geometry_msgs::msg::TransformStamped transform;
@@ -399,13 +443,22 @@ private:
 			transform.transform.translation.y = odom->pose.pose.position.y;
 			transform.transform.translation.z = odom->pose.pose.position.z;
 
-			m_uas->tf2_broadcaster.sendTransform(transform);
+			m_uas->tf2_batcher.send(transform);
 		}
+
+		// publish, after TF, as it gives the objects away
+		gp_fix_pool.publish_if(bool(gp_fix_subs), *gp_fix_pub, std::move(fix));
+		gp_odom_pool.publish_if(bool(gp_odom_subs), *gp_odom_pub, std::move(odom));
+		float_pool.publish_if(bool(gp_rel_alt_subs), *gp_rel_alt_pub, std::move(relative_alt));
+		float_pool.publish_if(bool(gp_hdg_subs), *gp_hdg_pub, std::move(compass_heading));
 	}
 
-	void handle_lpned_system_global_offset(const mavlink::mavlink_message_t *msg, mavlink::common::msg::LOCAL_POSITION_NED_SYSTEM_GLOBAL_OFFSET &offset)
+	void handle_lpned_system_global_offset(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::LOCAL_POSITION_NED_SYSTEM_GLOBAL_OFFSET &offset)
 	{
-		auto global_offset = std::make_shared<geometry_msgs::msg::PoseStamped>();
+		if (!gp_global_offset_subs && !tf_send)
+			return;
+
+		auto global_offset = gp_global_offset_pool.acquire();
 		global_offset->header = m_uas->synchronized_header(tf_global_frame_id, offset.time_boot_ms);
 
 		auto enu_position = ftf::transform_frame_ned_enu(Eigen::Vector3d(offset.x, offset.y, offset.z));
@@ -416,8 +469,6 @@ private:
 		tf2::convert(enu_position, global_offset->pose.position);
 		tf2::convert(enu_baselink_orientation, global_offset->pose.orientation);
 
-		gp_global_offset_pub->publish(*global_offset);
-
 		// TF
 		if (tf_send) {
 			geometry_msgs::msg::TransformStamped transform;
@@ -434,8 +485,10 @@ private:
 			transform.transform.translation.y = global_offset->pose.position.y;
 			transform.transform.translation.z = global_offset->pose.position.z;
 
-			m_uas->tf2_broadcaster.sendTransform(transform);
+			m_uas->tf2_batcher.send(transform);
 		}
+
+		gp_global_offset_pool.publish_if(bool(gp_global_offset_subs), *gp_global_offset_pub, std::move(global_offset));
 	}
 
 	/* -*- diagnostics -*- */
@@ -514,5 +567,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::GlobalPositionPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(global_position, mavros::std_plugins::GlobalPositionPlugin)
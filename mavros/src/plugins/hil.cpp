@@ -26,6 +26,11 @@
 #include <mavros_msgs/msg/optical_flow_rad.hpp>
 #include <mavros_msgs/msg/rc_in.hpp>
 
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+
 namespace mavros {
 namespace std_plugins {
 //! Tesla to Gauss coeff
@@ -35,12 +40,23 @@ static constexpr double PASCAL_TO_MILLIBAR = 1.0e-2;
 
 /**
  * @brief Hil plugin
+ *
+ * In lockstep mode frames are collected per simulation step, HIL_SENSOR (~imu_ned)
+ * closes the step. Step is sent as bundle with HIL_SENSOR last, next step waits
+ * for HIL_ACTUATOR_CONTROLS of previous one or lockstep timeout.
+ * Steps arriving meanwhile are queued, so none is dropped until queue is full.
  */
 class HilPlugin : public plugin::PluginBase {
 public:
 	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-	HilPlugin() : PluginBase()
+	HilPlugin() : PluginBase(),
+		lockstep(false),
+		lockstep_timeout(0.1),
+		lockstep_queue(10),
+		waiting(false),
+		last_step_usec(0),
+		stats {}
 	{ }
 
 	void initialize(UAS &uas_)
@@ -48,6 +64,17 @@ public:
 		PluginBase::initialize(uas_);
 		hil_nh = uas_.mavros_node->create_sub_node("hil");
 
+		// lockstep params
+		lockstep = hil_nh->declare_parameter<bool>("hil/lockstep", false);
+		lockstep_timeout = hil_nh->declare_parameter<double>("hil/lockstep_timeout", 0.1);
+		lockstep_queue = std::max<int>(hil_nh->declare_parameter<int>("hil/lockstep_queue", 10), 1);
+
+		if (lockstep) {
+			stats.since = clock::now();
+			lockstep_timer = hil_nh->create_wall_timer(LOCKSTEP_CHECK_DT, std::bind(&HilPlugin::lockstep_timeout_cb, this));
+			UAS_DIAG(m_uas).add("HIL lockstep", this, &HilPlugin::diag_run);
+		}
+
 		hil_state_quaternion_sub = hil_nh->create_subscription<mavros_msgs::msg::HilStateQuaternion>("state", 10, std::bind(&HilPlugin::state_quat_cb, this, std::placeholders::_1));
 		hil_gps_sub = hil_nh->create_subscription<mavros_msgs::msg::HilGPS>("gps", 10, std::bind(&HilPlugin::gps_cb, this, std::placeholders::_1));
 		hil_sensor_sub = hil_nh->create_subscription<mavros_msgs::msg::HilSensor>("imu_ned", 10, std::bind(&HilPlugin::sensor_cb, this, std::placeholders::_1));
@@ -67,7 +94,30 @@ public:
 	}
 
 private:
+	using clock = std::chrono::steady_clock;
+	using FramePtr = std::unique_ptr<mavlink::Message>;
+
+	//! frames of one simulation step, latest one of each type
+	struct Step {
+		uint64_t time_usec;
+		std::vector<FramePtr> frames;
+	};
+
+	struct StepStats {
+		uint64_t steps;
+		uint64_t timeouts;
+		uint64_t dropped;		//!< queue overflow
+		size_t queue_max;
+		double wait_sum;		//!< [sec] step sent to actuator controls
+		double wait_max;
+		uint64_t sim_usec;		//!< simulated time advance
+		clock::time_point since;
+	};
+
+	static constexpr std::chrono::milliseconds LOCKSTEP_CHECK_DT { 5 };
+
 	rclcpp::Node::SharedPtr hil_nh;
+	rclcpp::TimerBase::SharedPtr lockstep_timer;
 
 	rclcpp::Publisher<mavros_msgs::msg::HilControls>::SharedPtr hil_controls_pub;
 	rclcpp::Publisher<mavros_msgs::msg::HilActuatorControls>::SharedPtr hil_actuator_controls_pub;
@@ -80,9 +130,141 @@ private:
 
 	Eigen::Quaterniond enu_orientation;
 
+	bool lockstep;
+	double lockstep_timeout;
+	size_t lockstep_queue;
+
+	std::mutex step_mutex;
+	Step pending;			//!< step being collected
+	std::deque<Step> steps;		//!< closed, waiting for release
+	bool waiting;			//!< step sent, no actuator controls yet
+	clock::time_point step_sent;
+	uint64_t last_step_usec;
+	StepStats stats;
+
+	/* -*- lockstep -*- */
+
+	/**
+	 * @brief Send frame, or add it to current step in lockstep mode
+	 * @param end_of_step  frame closes the step
+	 */
+	template<typename _T>
+	void send_frame(const _T &frame, uint64_t time_usec, bool end_of_step = false)
+	{
+		if (!lockstep) {
+			UAS_FCU(m_uas)->send_message_ignore_drop(frame);
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(step_mutex);
+		auto it = std::find_if(pending.frames.begin(), pending.frames.end(), [](const FramePtr &f) {
+					return f->get_message_info().id == _T::MSG_ID;
+				});
+		if (it != pending.frames.end())
+			*it = std::make_unique<_T>(frame);
+		else
+			pending.frames.emplace_back(std::make_unique<_T>(frame));
+
+		if (!end_of_step)
+			return;
+
+		pending.time_usec = time_usec;
+		steps.emplace_back(std::move(pending));
+		pending = Step {};
+
+		if (steps.size() > lockstep_queue) {
+			steps.pop_front();
+			stats.dropped++;
+		}
+
+		stats.queue_max = std::max(stats.queue_max, steps.size());
+		release_step(clock::now());
+	}
+
+	//! Send next queued step if previous one is done, step_mutex should be locked
+	void release_step(clock::time_point now)
+	{
+		if (waiting || steps.empty())
+			return;
+
+		auto &step = steps.front();
+		for (auto &f : step.frames)
+			UAS_FCU(m_uas)->send_message_ignore_drop(*f);
+
+		if (last_step_usec != 0 && step.time_usec > last_step_usec)
+			stats.sim_usec += step.time_usec - last_step_usec;
+
+		last_step_usec = step.time_usec;
+		steps.pop_front();
+		waiting = true;
+		step_sent = now;
+		stats.steps++;
+	}
+
+	void step_done(clock::time_point now)
+	{
+		std::lock_guard<std::mutex> lock(step_mutex);
+		if (!waiting)
+			return;
+
+		double dt = std::chrono::duration<double>(now - step_sent).count();
+		stats.wait_sum += dt;
+		stats.wait_max = std::max(stats.wait_max, dt);
+
+		waiting = false;
+		release_step(now);
+	}
+
+	void lockstep_timeout_cb()
+	{
+		auto now = clock::now();
+		std::lock_guard<std::mutex> lock(step_mutex);
+
+		if (waiting && now - step_sent > std::chrono::duration<double>(lockstep_timeout)) {
+			RCUTILS_LOG_WARN_THROTTLE_NAMED(,10, "hil", "HIL: no actuator controls for step, released by timeout");
+			stats.timeouts++;
+			waiting = false;
+			release_step(now);
+		}
+	}
+
+	void diag_run(diagnostic_updater::DiagnosticStatusWrapper &stat)
+	{
+		auto now = clock::now();
+		StepStats st;
+		size_t queued;
+		{
+			std::lock_guard<std::mutex> lock(step_mutex);
+			st = stats;
+			queued = steps.size();
+			stats = StepStats {};
+			stats.since = now;
+		}
+
+		if (st.steps == 0)
+			stat.summary(1, "No steps");
+		else if (st.timeouts > 0 || st.dropped > 0)
+			stat.summary(1, "Steps lost or timed out");
+		else
+			stat.summary(0, "Normal");
+
+		double wall = (st.since != clock::time_point()) ? std::chrono::duration<double>(now - st.since).count() : 0.0;
+		double done = st.steps - st.timeouts;
+
+		stat.addf("Steps", "%llu", (unsigned long long) st.steps);
+		stat.addf("Timeouts", "%llu", (unsigned long long) st.timeouts);
+		stat.addf("Dropped", "%llu", (unsigned long long) st.dropped);
+		stat.addf("Queued", "%zu", queued);
+		stat.addf("Queue max", "%zu", st.queue_max);
+		stat.addf("Step wait mean (ms)", "%.2f", (done > 0) ? st.wait_sum / done * 1e3 : 0.0);
+		stat.addf("Step wait max (ms)", "%.2f", st.wait_max * 1e3);
+		stat.addf("Step rate (Hz)", "%.1f", (wall > 0) ? st.steps / wall : 0.0);
+		stat.addf("Real time factor", "%.2f", (wall > 0) ? st.sim_usec * 1e-6 / wall : 0.0);
+	}
+
 	/* -*- rx handlers -*- */
 
-	void handle_hil_controls(const mavlink::mavlink_message_t *msg, mavlink::common::msg::HIL_CONTROLS &hil_controls) {
+	void handle_hil_controls(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::HIL_CONTROLS &hil_controls) {
 		auto hil_controls_msg = std::make_shared<mavros_msgs::msg::HilControls>();
 
 		hil_controls_msg->header.stamp = m_uas->synchronise_stamp(hil_controls.time_usec);
@@ -107,7 +289,7 @@ private:
 		hil_controls_pub->publish(*hil_controls_msg);
 	}
 
-	void handle_hil_actuator_controls(const mavlink::mavlink_message_t *msg, mavlink::common::msg::HIL_ACTUATOR_CONTROLS &hil_actuator_controls) {
+	void handle_hil_actuator_controls(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::HIL_ACTUATOR_CONTROLS &hil_actuator_controls) {
 		auto hil_actuator_controls_msg = std::make_shared<mavros_msgs::msg::HilActuatorControls>();
 
 		hil_actuator_controls_msg->header.stamp = m_uas->synchronise_stamp(hil_actuator_controls.time_usec);
@@ -117,6 +299,9 @@ private:
 		hil_actuator_controls_msg->flags = hil_actuator_controls.flags;
 
 		hil_actuator_controls_pub->publish(*hil_actuator_controls_msg);
+
+		if (lockstep)
+			step_done(clock::now());
 	}
 
 	/* -*- callbacks / low level send -*- */
@@ -170,7 +355,7 @@ private:
 		state_quat.zacc = lin_acc.z();
 		// [[[end]]] (checksum: a29598b834ac1ec32ede01595aa5b3ac)
 
-		UAS_FCU(m_uas)->send_message_ignore_drop(state_quat);
+		send_frame(state_quat, state_quat.time_usec);
 	}
 
 	/**
@@ -203,7 +388,7 @@ private:
 		// [[[end]]] (checksum: a283bcc78f496cead2e9f893200d825d)
 		gps.satellites_visible = req->satellites_visible;
 
-		UAS_FCU(m_uas)->send_message_ignore_drop(gps);
+		send_frame(gps, gps.time_usec);
 	}
 
 	/**
@@ -249,7 +434,7 @@ private:
 		sensor.fields_updated = req->fields_updated;
 		// [[[end]]] (checksum: 316bef821ad6fc33d9726a1c8e8c5404)
 
-		UAS_FCU(m_uas)->send_message_ignore_drop(sensor);
+		send_frame(sensor, sensor.time_usec, true);
 	}
 
 	/**
@@ -292,7 +477,7 @@ private:
 		// [[[end]]] (checksum: acbfae28f4f3bb8ca135423efaaa479e)
 		of.temperature = req->temperature * 100.0f;	// in centi-degrees celsius
 
-		UAS_FCU(m_uas)->send_message_ignore_drop(of);
+		send_frame(of, of.time_usec);
 	}
 
 	/**
@@ -328,11 +513,13 @@ private:
 		rcin.chan12_raw	= channels[11];
 		// [[[end]]] (checksum: 8d6860789d596dc39e81b351c3a50fcd)
 
-		UAS_FCU(m_uas)->send_message_ignore_drop(rcin);
+		send_frame(rcin, rcin.time_usec);
 	}
 };
+
+constexpr std::chrono::milliseconds HilPlugin::LOCKSTEP_CHECK_DT;
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::HilPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(hil, mavros::std_plugins::HilPlugin)
@@ -97,7 +97,7 @@ private:
 		return ret;
 	}
 
-	void handle_home_position(const mavlink::mavlink_message_t *msg, mavlink::common::msg::HOME_POSITION &home_position)
+	void handle_home_position(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::HOME_POSITION &home_position)
 	{
 		poll_timer->cancel();
 
@@ -115,6 +115,15 @@ private:
 		tf2::convert(pos, hp->position);
 		tf2::toMsg(hp_approach_enu, hp->approach);
 
+		UAS::Home home;
+		home.valid = true;
+		home.latitude = hp->geo.latitude;
+		home.longitude = hp->geo.longitude;
+		home.altitude = hp->geo.altitude;
+		home.position = hp->position;
+		home.orientation = hp->orientation;
+		m_uas->update_home(home);
+
 		RCUTILS_LOG_DEBUG_NAMED("home_position", "HP: Home lat %f, long %f, alt %f", hp->geo.latitude, hp->geo.longitude, hp->geo.altitude);
 		hp_pub->publish(*hp);
 	}
@@ -182,5 +191,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::HomePositionPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(home_position, mavros::std_plugins::HomePositionPlugin)
@@ -14,6 +14,7 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <algorithm>
 #include <cmath>
 #include <mavros/mavros_plugin.h>
 #include <tf2_eigen/tf2_eigen.h>
@@ -23,6 +24,7 @@
 #include <sensor_msgs/msg/temperature.hpp>
 #include <sensor_msgs/msg/fluid_pressure.hpp>
 #include <geometry_msgs/msg/vector3.hpp>
+#include <mavros_msgs/msg/imu_batch.hpp>
 
 namespace mavros {
 namespace std_plugins {
@@ -53,6 +55,8 @@ public:
 		has_scaled_imu(false),
 		has_att_quat(false),
 		received_linear_accel(false),
+		batch_size(0),
+		batch_period(0.0),
 		linear_accel_vec_flu(Eigen::Vector3d::Zero()),
 		linear_accel_vec_frd(Eigen::Vector3d::Zero())
 	{ }
@@ -83,6 +87,10 @@ public:
 		setup_covariance(magnetic_cov, mag_stdev);
 		setup_covariance(unk_orientation_cov, 0.0);
 
+		// data_raw_batch: 0 - disabled, publish after that samples or batch_period [sec], whatever first
+		batch_size = std::max<int>(imu_nh->declare_parameter<int>("imu/batch_size", 0), 0);
+		batch_period = imu_nh->declare_parameter<double>("imu/batch_period", 0.0);
+
 		imu_pub = imu_nh->create_publisher<sensor_msgs::msg::Imu>("data", 10);
 		magn_pub = imu_nh->create_publisher<sensor_msgs::msg::MagneticField>("mag", 10);
 		temp_imu_pub = imu_nh->create_publisher<sensor_msgs::msg::Temperature>("temperature_imu", 10);
@@ -90,6 +98,31 @@ public:
 		static_press_pub = imu_nh->create_publisher<sensor_msgs::msg::FluidPressure>("static_pressure", 10);
 		diff_press_pub = imu_nh->create_publisher<sensor_msgs::msg::FluidPressure>("diff_pressure", 10);
 		imu_raw_pub = imu_nh->create_publisher<sensor_msgs::msg::Imu>("data_raw", 10);
+		if (batch_size > 0) {
+			imu_batch_pub = imu_nh->create_publisher<mavros_msgs::msg::ImuBatch>("data_raw_batch", 10);
+			imu_batch_subs = watch_subscribers(imu_batch_pub);
+			reset_batch();
+		}
+
+		imu_subs = watch_subscribers(imu_pub);
+		imu_raw_subs = watch_subscribers(imu_raw_pub);
+		magn_subs = watch_subscribers(magn_pub);
+		temp_imu_subs = watch_subscribers(temp_imu_pub);
+		temp_baro_subs = watch_subscribers(temp_baro_pub);
+		static_press_subs = watch_subscribers(static_press_pub);
+		diff_press_subs = watch_subscribers(diff_press_pub);
+
+		// attitude is not managed: UAS keeps it for other plugins
+		using namespace mavlink::common::msg;
+		const std::vector<mavlink::msgid_t> raw_imu_msgs{HIGHRES_IMU::MSG_ID, RAW_IMU::MSG_ID, SCALED_IMU::MSG_ID};
+		watch_stream(imu_raw_pub, raw_imu_msgs, 50.0);
+		if (imu_batch_pub)
+			watch_stream(imu_batch_pub, raw_imu_msgs, 50.0);
+		watch_stream(magn_pub, raw_imu_msgs, 10.0);
+		watch_stream(temp_imu_pub, {HIGHRES_IMU::MSG_ID}, 1.0);
+		watch_stream(temp_baro_pub, {SCALED_PRESSURE::MSG_ID}, 1.0);
+		watch_stream(static_press_pub, {HIGHRES_IMU::MSG_ID, SCALED_PRESSURE::MSG_ID}, 10.0);
+		watch_stream(diff_press_pub, {HIGHRES_IMU::MSG_ID, SCALED_PRESSURE::MSG_ID}, 10.0);
 
 		// Reset has_* flags on connection change
 		enable_connection_cb();
@@ -117,6 +150,21 @@ private:
 	rclcpp::Publisher<sensor_msgs::msg::Temperature>::SharedPtr temp_baro_pub;
 	rclcpp::Publisher<sensor_msgs::msg::FluidPressure>::SharedPtr static_press_pub;
 	rclcpp::Publisher<sensor_msgs::msg::FluidPressure>::SharedPtr diff_press_pub;
+	rclcpp::Publisher<mavros_msgs::msg::ImuBatch>::SharedPtr imu_batch_pub;
+
+	SubscriberCount imu_subs;
+	SubscriberCount imu_raw_subs;
+	SubscriberCount magn_subs;
+	SubscriberCount temp_imu_subs;
+	SubscriberCount temp_baro_subs;
+	SubscriberCount static_press_subs;
+	SubscriberCount diff_press_subs;
+	SubscriberCount imu_batch_subs;
+
+	MessagePool<sensor_msgs::msg::Imu> imu_raw_pool;
+	MessagePool<sensor_msgs::msg::MagneticField> magn_pool;
+	MessagePool<sensor_msgs::msg::Temperature> temp_pool;
+	MessagePool<sensor_msgs::msg::FluidPressure> press_pool;
 
 	bool has_hr_imu;
 	bool has_raw_imu;
@@ -131,6 +179,11 @@ private:
 	ftf::Covariance3d unk_orientation_cov;
 	ftf::Covariance3d magnetic_cov;
 
+	size_t batch_size;
+	double batch_period;
+	//! Arrays are cleared after publish, capacity is kept
+	mavros_msgs::msg::ImuBatch batch_msg;
+
 	/* -*- helpers -*- */
 
 	/**
@@ -217,7 +270,8 @@ private:
 		 *  @snippet src/plugins/imu.cpp pub_enu
 		 */
 		// [pub_enu]
-		imu_pub->publish(*imu_enu_msg);
+		if (imu_subs)
+			imu_pub->publish(*imu_enu_msg);
 		// [pub_enu]
 	}
 
@@ -231,7 +285,18 @@ private:
 	void publish_imu_data_raw(std_msgs::msg::Header &header, Eigen::Vector3d &gyro_flu,
 				Eigen::Vector3d &accel_flu, Eigen::Vector3d &accel_frd)
 	{
-		auto imu_msg = std::make_shared<sensor_msgs::msg::Imu>();
+		// Save readings, used by data topic too
+		linear_accel_vec_flu = accel_flu;
+		linear_accel_vec_frd = accel_frd;
+		received_linear_accel = true;
+
+		if (batch_size > 0 && imu_batch_subs)
+			batch_imu_data_raw(header, gyro_flu, accel_flu);
+
+		if (!imu_raw_subs)
+			return;
+
+		auto imu_msg = imu_raw_pool.acquire();
 
 		// Fill message header
 		imu_msg->header = header;
@@ -239,17 +304,55 @@ private:
 		tf2::toMsg(gyro_flu, imu_msg->angular_velocity);
 		tf2::toMsg(accel_flu, imu_msg->linear_acceleration);
 
-		// Save readings
-		linear_accel_vec_flu = accel_flu;
-		linear_accel_vec_frd = accel_frd;
-		received_linear_accel = true;
-
 		imu_msg->orientation_covariance = unk_orientation_cov;
 		imu_msg->angular_velocity_covariance = angular_velocity_cov;
 		imu_msg->linear_acceleration_covariance = linear_acceleration_cov;
 
 		// Publish message [ENU frame]
-		imu_raw_pub->publish(*imu_msg);
+		imu_raw_pool.publish(*imu_raw_pub, std::move(imu_msg));
+	}
+
+	//! Drop collected samples, storage is kept
+	void reset_batch()
+	{
+		batch_msg.stamp.clear();
+		batch_msg.angular_velocity.clear();
+		batch_msg.linear_acceleration.clear();
+
+		batch_msg.stamp.reserve(batch_size);
+		batch_msg.angular_velocity.reserve(batch_size);
+		batch_msg.linear_acceleration.reserve(batch_size);
+	}
+
+	/**
+	 * @brief Append sample to data_raw batch, publish it when full or spans batch_period
+	 * @param header      Message frame_id and timestamp
+	 * @param gyro_flu    Angular velocity in the base_link Forward-Left-Up frame
+	 * @param accel_flu   Linear acceleration in the base_link Forward-Left-Up frame
+	 */
+	void batch_imu_data_raw(const std_msgs::msg::Header &header, const Eigen::Vector3d &gyro_flu,
+				const Eigen::Vector3d &accel_flu)
+	{
+		// FCU reboot or time sync reset, do not join samples of different sessions
+		if (!batch_msg.stamp.empty() && rclcpp::Time(header.stamp) < rclcpp::Time(batch_msg.stamp.back()))
+			reset_batch();
+
+		batch_msg.stamp.push_back(header.stamp);
+		batch_msg.angular_velocity.emplace_back();
+		batch_msg.linear_acceleration.emplace_back();
+		tf2::toMsg(gyro_flu, batch_msg.angular_velocity.back());
+		tf2::toMsg(accel_flu, batch_msg.linear_acceleration.back());
+
+		auto span = rclcpp::Time(header.stamp) - rclcpp::Time(batch_msg.stamp.front());
+		if (batch_msg.stamp.size() < batch_size && (batch_period <= 0.0 || span.seconds() < batch_period))
+			return;
+
+		batch_msg.header = header;
+		batch_msg.angular_velocity_covariance = angular_velocity_cov;
+		batch_msg.linear_acceleration_covariance = linear_acceleration_cov;
+
+		imu_batch_pub->publish(batch_msg);
+		reset_batch();
 	}
 
 	/**
@@ -259,7 +362,7 @@ private:
 	 */
 	void publish_mag(std_msgs::msg::Header &header, Eigen::Vector3d &mag_field)
 	{
-		auto magn_msg = std::make_shared<sensor_msgs::msg::MagneticField>();
+		auto magn_msg = magn_pool.acquire();
 
 		// Fill message header
 		magn_msg->header = header;
@@ -268,7 +371,7 @@ private:
 		magn_msg->magnetic_field_covariance = magnetic_cov;
 
 		// Publish message [ENU frame]
-		magn_pub->publish(*magn_msg);
+		magn_pool.publish(*magn_pub, std::move(magn_msg));
 	}
 
 	/* -*- message handlers -*- */
@@ -279,7 +382,7 @@ private:
 	 * @param msg	Received Mavlink msg
 	 * @param att	ATTITUDE msg
 	 */
-	void handle_attitude(const mavlink::mavlink_message_t *msg, mavlink::common::msg::ATTITUDE &att)
+	void handle_attitude(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::ATTITUDE &att)
 	{
 		if (has_att_quat)
 			return;
@@ -324,7 +427,7 @@ private:
 	 * @param msg		Received Mavlink msg
 	 * @param att_q		ATTITUDE_QUATERNION msg
 	 */
-	void handle_attitude_quaternion(const mavlink::mavlink_message_t *msg, mavlink::common::msg::ATTITUDE_QUATERNION &att_q)
+	void handle_attitude_quaternion(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::ATTITUDE_QUATERNION &att_q)
 	{
 		RCUTILS_LOG_INFO_EXPRESSION_NAMED(!has_att_quat, "imu", "IMU: Attitude quaternion IMU detected!");
 		has_att_quat = true;
@@ -366,7 +469,7 @@ private:
 	 * @param msg		Received Mavlink msg
 	 * @param imu_hr	HIGHRES_IMU msg
 	 */
-	void handle_highres_imu(const mavlink::mavlink_message_t *msg, mavlink::common::msg::HIGHRES_IMU &imu_hr)
+	void handle_highres_imu(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::HIGHRES_IMU &imu_hr)
 	{
 		RCUTILS_LOG_INFO_EXPRESSION_NAMED(!has_hr_imu, "imu", "IMU: High resolution IMU detected!");
 		has_hr_imu = true;
@@ -394,7 +497,7 @@ private:
 		 *  @snippet src/plugins/imu.cpp mag_available
 		 */
 		// [mag_available]
-		if (imu_hr.fields_updated & (7 << 6)) {
+		if ((imu_hr.fields_updated & (7 << 6)) && magn_subs) {
 			auto mag_field = ftf::transform_frame_aircraft_baselink<Eigen::Vector3d>(
 						Eigen::Vector3d(imu_hr.xmag, imu_hr.ymag, imu_hr.zmag) * GAUSS_TO_TESLA);
 
@@ -406,13 +509,13 @@ private:
 		 *  @snippet src/plugins/imu.cpp static_pressure_available
 		 */
 		// [static_pressure_available]
-		if (imu_hr.fields_updated & (1 << 9)) {
-			auto static_pressure_msg = std::make_shared<sensor_msgs::msg::FluidPressure>();
+		if ((imu_hr.fields_updated & (1 << 9)) && static_press_subs) {
+			auto static_pressure_msg = press_pool.acquire();
 
 			static_pressure_msg->header = header;
 			static_pressure_msg->fluid_pressure = imu_hr.abs_pressure;
 
-			static_press_pub->publish(*static_pressure_msg);
+			press_pool.publish(*static_press_pub, std::move(static_pressure_msg));
 		}
 		// [static_pressure_available]
 
@@ -420,13 +523,13 @@ private:
 		 *  @snippet src/plugins/imu.cpp differential_pressure_available
 		 */
 		// [differential_pressure_available]
-		if (imu_hr.fields_updated & (1 << 10)) {
-			auto differential_pressure_msg = std::make_shared<sensor_msgs::msg::FluidPressure>();
+		if ((imu_hr.fields_updated & (1 << 10)) && diff_press_subs) {
+			auto differential_pressure_msg = press_pool.acquire();
 
 			differential_pressure_msg->header = header;
 			differential_pressure_msg->fluid_pressure = imu_hr.diff_pressure;
 
-			diff_press_pub->publish(*differential_pressure_msg);
+			press_pool.publish(*diff_press_pub, std::move(differential_pressure_msg));
 		}
 		// [differential_pressure_available]
 
@@ -434,13 +537,13 @@ private:
 		 *  @snippet src/plugins/imu.cpp temperature_available
 		 */
 		// [temperature_available]
-		if (imu_hr.fields_updated & (1 << 12)) {
-			auto temp_msg = std::make_shared<sensor_msgs::msg::Temperature>();
+		if ((imu_hr.fields_updated & (1 << 12)) && temp_imu_subs) {
+			auto temp_msg = temp_pool.acquire();
 
 			temp_msg->header = header;
 			temp_msg->temperature = imu_hr.temperature;
 
-			temp_imu_pub->publish(*temp_msg);
+			temp_pool.publish(*temp_imu_pub, std::move(temp_msg));
 		}
 		// [temperature_available]
 	}
@@ -451,7 +554,7 @@ private:
 	 * @param msg		Received Mavlink msg
 	 * @param imu_raw	RAW_IMU msg
 	 */
-	void handle_raw_imu(const mavlink::mavlink_message_t *msg, mavlink::common::msg::RAW_IMU &imu_raw)
+	void handle_raw_imu(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::RAW_IMU &imu_raw)
 	{
 		RCUTILS_LOG_INFO_EXPRESSION_NAMED(!has_raw_imu, "imu", "IMU: Raw IMU message used.");
 		has_raw_imu = true;
@@ -459,7 +562,6 @@ private:
 		if (has_hr_imu || has_scaled_imu)
 			return;
 
-		auto imu_msg = std::make_shared<sensor_msgs::msg::Imu>();
 		auto header = m_uas->synchronized_header(frame_id, imu_raw.time_usec);
 
 		/** @note APM send SCALED_IMU data as RAW_IMU
@@ -486,6 +588,9 @@ private:
 			linear_accel_vec_frd.setZero();
 		}
 
+		if (!magn_subs)
+			return;
+
 		/** Magnetic field data:
 		 *  @snippet src/plugins/imu.cpp mag_field
 		 */
@@ -503,7 +608,7 @@ private:
 	 * @param msg		Received Mavlink msg
 	 * @param imu_raw	SCALED_IMU msg
 	 */
-	void handle_scaled_imu(const mavlink::mavlink_message_t *msg, mavlink::common::msg::SCALED_IMU &imu_raw)
+	void handle_scaled_imu(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::SCALED_IMU &imu_raw)
 	{
 		if (has_hr_imu)
 			return;
@@ -511,7 +616,6 @@ private:
 		RCUTILS_LOG_INFO_EXPRESSION_NAMED(!has_scaled_imu, "imu", "IMU: Scaled IMU message used.");
 		has_scaled_imu = true;
 
-		auto imu_msg = std::make_shared<sensor_msgs::msg::Imu>();
 		auto header = m_uas->synchronized_header(frame_id, imu_raw.time_boot_ms);
 
 		auto gyro_flu = ftf::transform_frame_aircraft_baselink<Eigen::Vector3d>(
@@ -521,6 +625,9 @@ private:
 
 		publish_imu_data_raw(header, gyro_flu, accel_flu, accel_frd);
 
+		if (!magn_subs)
+			return;
+
 		/** Magnetic field data:
 		 *  @snippet src/plugins/imu.cpp mag_field
 		 */
@@ -536,27 +643,33 @@ private:
 	 * @param msg		Received Mavlink msg
 	 * @param press		SCALED_PRESSURE msg
 	 */
-	void handle_scaled_pressure(const mavlink::mavlink_message_t *msg, mavlink::common::msg::SCALED_PRESSURE &press)
+	void handle_scaled_pressure(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::SCALED_PRESSURE &press)
 	{
 		if (has_hr_imu)
 			return;
 
 		auto header = m_uas->synchronized_header(frame_id, press.time_boot_ms);
 
-		auto temp_msg = std::make_shared<sensor_msgs::msg::Temperature>();
-		temp_msg->header = header;
-		temp_msg->temperature = press.temperature / 100.0;
-		temp_baro_pub->publish(*temp_msg);
+		if (temp_baro_subs) {
+			auto temp_msg = temp_pool.acquire();
+			temp_msg->header = header;
+			temp_msg->temperature = press.temperature / 100.0;
+			temp_pool.publish(*temp_baro_pub, std::move(temp_msg));
+		}
 
-		auto static_pressure_msg = std::make_shared<sensor_msgs::msg::FluidPressure>();
-		static_pressure_msg->header = header;
-		static_pressure_msg->fluid_pressure = press.press_abs * 100.0;
-		static_press_pub->publish(*static_pressure_msg);
+		if (static_press_subs) {
+			auto static_pressure_msg = press_pool.acquire();
+			static_pressure_msg->header = header;
+			static_pressure_msg->fluid_pressure = press.press_abs * 100.0;
+			press_pool.publish(*static_press_pub, std::move(static_pressure_msg));
+		}
 
-		auto differential_pressure_msg = std::make_shared<sensor_msgs::msg::FluidPressure>();
-		differential_pressure_msg->header = header;
-		differential_pressure_msg->fluid_pressure = press.press_diff * 100.0;
-		diff_press_pub->publish(*differential_pressure_msg);
+		if (diff_press_subs) {
+			auto differential_pressure_msg = press_pool.acquire();
+			differential_pressure_msg->header = header;
+			differential_pressure_msg->fluid_pressure = press.press_diff * 100.0;
+			press_pool.publish(*diff_press_pub, std::move(differential_pressure_msg));
+		}
 	}
 
 	// Checks for connection and overrides variable values
@@ -570,5 +683,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::IMUPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(imu, mavros::std_plugins::IMUPlugin)
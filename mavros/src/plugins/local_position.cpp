@@ -56,6 +56,10 @@ public:
 		tf_send = lp_nh->declare_parameter("local_position/tf/send", false);
 		tf_frame_id = lp_nh->declare_parameter<std::string>("local_position/tf/frame_id", "map");
 		tf_child_frame_id = lp_nh->declare_parameter<std::string>("local_position/tf/child_frame_id", "base_link");
+		// 0 - send each update
+		auto tf_rate_limit = lp_nh->declare_parameter("local_position/tf/rate_limit", 0.0);
+		if (tf_send)
+			m_uas->tf2_batcher.set_rate_limit(tf_child_frame_id, tf_rate_limit);
 
 		local_position = lp_nh->create_publisher<geometry_msgs::msg::PoseStamped>("pose", 10);
 		local_position_cov = lp_nh->create_publisher<geometry_msgs::msg::PoseWithCovarianceStamped>("pose_cov", 10);
@@ -64,6 +68,28 @@ public:
 		local_velocity_cov = lp_nh->create_publisher<geometry_msgs::msg::TwistWithCovarianceStamped>("velocity_body_cov", 10);
 		local_accel = lp_nh->create_publisher<geometry_msgs::msg::AccelWithCovarianceStamped>("accel", 10);
 		local_odom = lp_nh->create_publisher<nav_msgs::msg::Odometry>("odom",10);
+
+		local_position_subs = watch_subscribers(local_position);
+		local_position_cov_subs = watch_subscribers(local_position_cov);
+		local_velocity_local_subs = watch_subscribers(local_velocity_local);
+		local_velocity_body_subs = watch_subscribers(local_velocity_body);
+		local_velocity_cov_subs = watch_subscribers(local_velocity_cov);
+		local_accel_subs = watch_subscribers(local_accel);
+		local_odom_subs = watch_subscribers(local_odom);
+
+		// tf is sent from every message, FCU rate is left to the user
+		if (!tf_send) {
+			using namespace mavlink::common::msg;
+			const std::vector<mavlink::msgid_t> lpned{LOCAL_POSITION_NED::MSG_ID};
+			const std::vector<mavlink::msgid_t> lpned_cov{LOCAL_POSITION_NED_COV::MSG_ID};
+			watch_stream(local_position, lpned, 30.0);
+			watch_stream(local_velocity_local, lpned, 30.0);
+			watch_stream(local_velocity_body, lpned, 30.0);
+			watch_stream(local_odom, {LOCAL_POSITION_NED::MSG_ID, LOCAL_POSITION_NED_COV::MSG_ID}, 30.0);
+			watch_stream(local_position_cov, lpned_cov, 30.0);
+			watch_stream(local_velocity_cov, lpned_cov, 30.0);
+			watch_stream(local_accel, lpned_cov, 30.0);
+		}
 	}
 
 	Subscriptions get_subscriptions() {
@@ -84,6 +110,21 @@ private:
 	rclcpp::Publisher<geometry_msgs::msg::AccelWithCovarianceStamped>::SharedPtr local_accel;
 	rclcpp::Publisher<nav_msgs::msg::Odometry>::SharedPtr local_odom;
 
+	SubscriberCount local_position_subs;
+	SubscriberCount local_position_cov_subs;
+	SubscriberCount local_velocity_local_subs;
+	SubscriberCount local_velocity_body_subs;
+	SubscriberCount local_velocity_cov_subs;
+	SubscriberCount local_accel_subs;
+	SubscriberCount local_odom_subs;
+
+	MessagePool<nav_msgs::msg::Odometry> odom_pool;
+	MessagePool<geometry_msgs::msg::PoseStamped> pose_pool;
+	MessagePool<geometry_msgs::msg::PoseWithCovarianceStamped> pose_cov_pool;
+	MessagePool<geometry_msgs::msg::TwistStamped> twist_pool;
+	MessagePool<geometry_msgs::msg::TwistWithCovarianceStamped> twist_cov_pool;
+	MessagePool<geometry_msgs::msg::AccelWithCovarianceStamped> accel_pool;
+
 	std::string frame_id;		//!< frame for Pose
 	std::string tf_frame_id;	//!< origin for TF
 	std::string tf_child_frame_id;	//!< frame for TF
@@ -91,25 +132,28 @@ private:
 	bool has_local_position_ned;
 	bool has_local_position_ned_cov;
 
-	void publish_tf(std::shared_ptr<nav_msgs::msg::Odometry> &odom)
+	void publish_tf(const nav_msgs::msg::Odometry &odom)
 	{
 		if (tf_send) {
 			geometry_msgs::msg::TransformStamped transform;
-			transform.header.stamp = odom->header.stamp;
+			transform.header.stamp = odom.header.stamp;
 			transform.header.frame_id = tf_frame_id;
 			transform.child_frame_id = tf_child_frame_id;
-			transform.transform.translation.x = odom->pose.pose.position.x;
-			transform.transform.translation.y = odom->pose.pose.position.y;
-			transform.transform.translation.z = odom->pose.pose.position.z;
-			transform.transform.rotation = odom->pose.pose.orientation;
-			m_uas->tf2_broadcaster.sendTransform(transform);
+			transform.transform.translation.x = odom.pose.pose.position.x;
+			transform.transform.translation.y = odom.pose.pose.position.y;
+			transform.transform.translation.z = odom.pose.pose.position.z;
+			transform.transform.rotation = odom.pose.pose.orientation;
+			m_uas->tf2_batcher.send(transform);
 		}
 	}
 
-	void handle_local_position_ned(const mavlink::mavlink_message_t *msg, mavlink::common::msg::LOCAL_POSITION_NED &pos_ned)
+	void handle_local_position_ned(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::LOCAL_POSITION_NED &pos_ned)
 	{
 		has_local_position_ned = true;
 
+		if (!tf_send && !local_odom_subs && !local_position_subs && !local_velocity_body_subs && !local_velocity_local_subs)
+			return;
+
 		//--------------- Transform FCU position and Velocity Data ---------------//
 		auto enu_position = ftf::transform_frame_ned_enu(Eigen::Vector3d(pos_ned.x, pos_ned.y, pos_ned.z));
 		auto enu_velocity = ftf::transform_frame_ned_enu(Eigen::Vector3d(pos_ned.vx, pos_ned.vy, pos_ned.vz));
@@ -122,7 +166,7 @@ private:
 		tf2::fromMsg(enu_orientation_msg, enu_orientation);
 		auto baselink_linear = ftf::transform_frame_enu_baselink(enu_velocity, enu_orientation.inverse());
 
-		auto odom = std::make_shared<nav_msgs::msg::Odometry>();
+		auto odom = odom_pool.acquire();
 		odom->header = m_uas->synchronized_header(frame_id, pos_ned.time_boot_ms);
 		odom->child_frame_id = tf_child_frame_id;
 
@@ -131,43 +175,51 @@ private:
 		tf2::toMsg(baselink_linear, odom->twist.twist.linear);
 		odom->twist.twist.angular = baselink_angular_msg;
 
-		// publish odom if we don't have LOCAL_POSITION_NED_COV
-		if (!has_local_position_ned_cov) {
-			local_odom->publish(*odom);
-		}
-
 		// publish pose always
-		auto pose = std::make_shared<geometry_msgs::msg::PoseStamped>();
-		pose->header = odom->header;
-		pose->pose = odom->pose.pose;
-		local_position->publish(*pose);
+		if (local_position_subs) {
+			auto pose = pose_pool.acquire();
+			pose->header = odom->header;
+			pose->pose = odom->pose.pose;
+			pose_pool.publish(*local_position, std::move(pose));
+		}
 
 		// publish velocity always
 		// velocity in the body frame
-		auto twist_body = std::make_shared<geometry_msgs::msg::TwistStamped>();
-		twist_body->header.stamp = odom->header.stamp;
-		twist_body->header.frame_id = tf_child_frame_id;
-		twist_body->twist.linear = odom->twist.twist.linear;
-		twist_body->twist.angular = baselink_angular_msg;
-		local_velocity_body->publish(*twist_body);
+		if (local_velocity_body_subs) {
+			auto twist_body = twist_pool.acquire();
+			twist_body->header.stamp = odom->header.stamp;
+			twist_body->header.frame_id = tf_child_frame_id;
+			twist_body->twist.linear = odom->twist.twist.linear;
+			twist_body->twist.angular = baselink_angular_msg;
+			twist_pool.publish(*local_velocity_body, std::move(twist_body));
+		}
 
 		// velocity in the local frame
-		auto twist_local = std::make_shared<geometry_msgs::msg::TwistStamped>();
-		twist_local->header.stamp = twist_body->header.stamp;
-		twist_local->header.frame_id = tf_child_frame_id;
-		tf2::toMsg(enu_velocity, twist_local->twist.linear);
-		tf2::toMsg(ftf::transform_frame_baselink_enu(ftf::to_eigen(baselink_angular_msg), enu_orientation),
-						twist_body->twist.angular);
-		local_velocity_local->publish(*twist_local);
+		if (local_velocity_local_subs) {
+			auto twist_local = twist_pool.acquire();
+			twist_local->header.stamp = odom->header.stamp;
+			twist_local->header.frame_id = tf_child_frame_id;
+			tf2::toMsg(enu_velocity, twist_local->twist.linear);
+			tf2::toMsg(ftf::transform_frame_baselink_enu(ftf::to_eigen(baselink_angular_msg), enu_orientation),
+							twist_local->twist.angular);
+			twist_pool.publish(*local_velocity_local, std::move(twist_local));
+		}
 
 		// publish tf
-		publish_tf(odom);
+		publish_tf(*odom);
+
+		// publish odom if we don't have LOCAL_POSITION_NED_COV, last, as it gives the object away
+		odom_pool.publish_if(!has_local_position_ned_cov && local_odom_subs, *local_odom, std::move(odom));
 	}
 
-	void handle_local_position_ned_cov(const mavlink::mavlink_message_t *msg, mavlink::common::msg::LOCAL_POSITION_NED_COV &pos_ned)
+	void handle_local_position_ned_cov(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::LOCAL_POSITION_NED_COV &pos_ned)
 	{
 		has_local_position_ned_cov = true;
 
+		bool want_ned = !has_local_position_ned && (tf_send || local_position_subs || local_velocity_body_subs);
+		if (!want_ned && !local_odom_subs && !local_position_cov_subs && !local_velocity_cov_subs && !local_accel_subs)
+			return;
+
 		auto enu_position = ftf::transform_frame_ned_enu(Eigen::Vector3d(pos_ned.x, pos_ned.y, pos_ned.z));
 		auto enu_velocity = ftf::transform_frame_ned_enu(Eigen::Vector3d(pos_ned.vx, pos_ned.vy, pos_ned.vz));
 
@@ -177,7 +229,7 @@ private:
 		tf2::fromMsg(enu_orientation_msg, enu_orientation);
 		auto baselink_linear = ftf::transform_frame_enu_baselink(enu_velocity, enu_orientation.inverse());
 
-		auto odom = std::make_shared<nav_msgs::msg::Odometry>();
+		auto odom = odom_pool.acquire();
 		odom->header = m_uas->synchronized_header(frame_id, pos_ned.time_usec);
 		odom->child_frame_id = tf_child_frame_id;
 
@@ -195,55 +247,65 @@ private:
 		odom->twist.covariance[14] = pos_ned.covariance[35];	// vz
 		// TODO: orientation + angular velocity covariances from ATTITUDE_QUATERION_COV
 
-		// publish odom always
-		local_odom->publish(*odom);
-
 		// publish pose_cov always
-		auto pose_cov = std::make_shared<geometry_msgs::msg::PoseWithCovarianceStamped>();
-		pose_cov->header = odom->header;
-		pose_cov->pose = odom->pose;
-		local_position_cov->publish(*pose_cov);
+		if (local_position_cov_subs) {
+			auto pose_cov = pose_cov_pool.acquire();
+			pose_cov->header = odom->header;
+			pose_cov->pose = odom->pose;
+			pose_cov_pool.publish(*local_position_cov, std::move(pose_cov));
+		}
 
 		// publish velocity_cov always
-		auto twist_cov = std::make_shared<geometry_msgs::msg::TwistWithCovarianceStamped>();
-		twist_cov->header.stamp = odom->header.stamp;
-		twist_cov->header.frame_id = odom->child_frame_id;
-		twist_cov->twist = odom->twist;
-		local_velocity_cov->publish(*twist_cov);
+		if (local_velocity_cov_subs) {
+			auto twist_cov = twist_cov_pool.acquire();
+			twist_cov->header.stamp = odom->header.stamp;
+			twist_cov->header.frame_id = odom->child_frame_id;
+			twist_cov->twist = odom->twist;
+			twist_cov_pool.publish(*local_velocity_cov, std::move(twist_cov));
+		}
 
 		// publish pose, velocity, tf if we don't have LOCAL_POSITION_NED
 		if (!has_local_position_ned) {
-			auto pose = std::make_shared<geometry_msgs::msg::PoseStamped>();
-			pose->header = odom->header;
-			pose->pose = odom->pose.pose;
-			local_position->publish(*pose);
-
-			auto twist = std::make_shared<geometry_msgs::msg::TwistStamped>();
-			twist->header.stamp = odom->header.stamp;
-			twist->header.frame_id = odom->child_frame_id;
-			twist->twist = odom->twist.twist;
-			local_velocity_body->publish(*twist);
+			if (local_position_subs) {
+				auto pose = pose_pool.acquire();
+				pose->header = odom->header;
+				pose->pose = odom->pose.pose;
+				pose_pool.publish(*local_position, std::move(pose));
+			}
+
+			if (local_velocity_body_subs) {
+				auto twist = twist_pool.acquire();
+				twist->header.stamp = odom->header.stamp;
+				twist->header.frame_id = odom->child_frame_id;
+				twist->twist = odom->twist.twist;
+				twist_pool.publish(*local_velocity_body, std::move(twist));
+			}
 
 			// publish tf
-			publish_tf(odom);
+			publish_tf(*odom);
 		}
 
 		// publish accelerations
-		auto accel = std::make_shared<geometry_msgs::msg::AccelWithCovarianceStamped>();
-		accel->header = odom->header;
+		if (local_accel_subs) {
+			auto accel = accel_pool.acquire();
+			accel->header = odom->header;
 
-		auto enu_accel = ftf::transform_frame_ned_enu(Eigen::Vector3d(pos_ned.ax, pos_ned.ay, pos_ned.az));
-		tf2::toMsg(enu_accel, accel->accel.accel.linear);
+			auto enu_accel = ftf::transform_frame_ned_enu(Eigen::Vector3d(pos_ned.ax, pos_ned.ay, pos_ned.az));
+			tf2::toMsg(enu_accel, accel->accel.accel.linear);
 
-		accel->accel.covariance[0] = pos_ned.covariance[39];	// ax
-		accel->accel.covariance[7] = pos_ned.covariance[42];	// ay
-		accel->accel.covariance[14] = pos_ned.covariance[44];	// az
+			accel->accel.covariance[0] = pos_ned.covariance[39];	// ax
+			accel->accel.covariance[7] = pos_ned.covariance[42];	// ay
+			accel->accel.covariance[14] = pos_ned.covariance[44];	// az
+
+			accel_pool.publish(*local_accel, std::move(accel));
+		}
 
-		local_accel->publish(*accel);
+		// publish odom always, last, as it gives the object away
+		odom_pool.publish_if(bool(local_odom_subs), *local_odom, std::move(odom));
 	}
 };
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::LocalPositionPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(local_position, mavros::std_plugins::LocalPositionPlugin)
@@ -15,17 +15,27 @@
  */
 
 #include <mavros/mavros_plugin.h>
+#include <mavros/output_scheduler.h>
 
 #include <mavros_msgs/msg/manual_control.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
 namespace mavros {
 namespace std_plugins {
 /**
  * @brief Manual Control plugin
+ *
+ * MANUAL_CONTROL is sent at most at send/rate, axis change of send/change_threshold
+ * (-1000..1000 scale) or button change is sent right away.
  */
 class ManualControlPlugin : public plugin::PluginBase {
 public:
-	ManualControlPlugin() : PluginBase()
+	ManualControlPlugin() : PluginBase(),
+		last_control {},
+		sent_control {}
 	{ }
 
 	void initialize(UAS &uas_)
@@ -33,6 +43,16 @@ public:
 		PluginBase::initialize(uas_);
 		manual_control_nh = uas_.mavros_node->create_sub_node("manual_control");
 
+		// send: 0 - send each message, no keep-alive
+		auto send_rate = manual_control_nh->declare_parameter<double>("manual_control/send/rate", 0.0);
+		auto send_keepalive = manual_control_nh->declare_parameter<double>("manual_control/send/keepalive", 0.0);
+		auto send_threshold = manual_control_nh->declare_parameter<double>("manual_control/send/change_threshold", 0.0);
+		send_sched.set_options(OutputScheduler::from_rates(send_rate, send_keepalive, send_threshold));
+
+		auto timer_period = send_sched.timer_period();
+		if (timer_period > OutputScheduler::clock::duration::zero())
+			send_timer = manual_control_nh->create_wall_timer(timer_period, std::bind(&ManualControlPlugin::send_timer_cb, this));
+
 		control_pub = manual_control_nh->create_publisher<mavros_msgs::msg::ManualControl>("control", 10);
 		send_sub = manual_control_nh->create_subscription<mavros_msgs::msg::ManualControl>("send", 1, std::bind(&ManualControlPlugin::send_cb, this, std::placeholders::_1));
 	}
@@ -48,10 +68,16 @@ private:
 
 	rclcpp::Publisher<mavros_msgs::msg::ManualControl>::SharedPtr control_pub;
 	rclcpp::Subscription<mavros_msgs::msg::ManualControl>::SharedPtr send_sub;
+	rclcpp::TimerBase::SharedPtr send_timer;
+
+	std::mutex send_mutex;
+	OutputScheduler send_sched;
+	mavlink::common::msg::MANUAL_CONTROL last_control;
+	mavlink::common::msg::MANUAL_CONTROL sent_control;
 
 	/* -*- rx handlers -*- */
 
-	void handle_manual_control(const mavlink::mavlink_message_t *msg, mavlink::common::msg::MANUAL_CONTROL &manual_control)
+	void handle_manual_control(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::MANUAL_CONTROL &manual_control)
 	{
 		auto manual_control_msg = std::make_shared<mavros_msgs::msg::ManualControl>();
 
@@ -78,11 +104,37 @@ private:
 		msg.r = req->r;
 		msg.buttons = req->buttons;
 
-		UAS_FCU(m_uas)->send_message_ignore_drop(msg);
+		std::lock_guard<std::mutex> lock(send_mutex);
+
+		double change = std::max({
+				std::abs(msg.x - sent_control.x),
+				std::abs(msg.y - sent_control.y),
+				std::abs(msg.z - sent_control.z),
+				std::abs(msg.r - sent_control.r)});
+		if (msg.buttons != sent_control.buttons)
+			change = INFINITY;
+
+		last_control = msg;
+		if (send_sched.update(change))
+			send_control();
+	}
+
+	void send_timer_cb()
+	{
+		std::lock_guard<std::mutex> lock(send_mutex);
+		if (send_sched.tick())
+			send_control();
+	}
+
+	//! send_mutex should be locked
+	void send_control()
+	{
+		sent_control = last_control;
+		UAS_FCU(m_uas)->send_message_ignore_drop(last_control);
 	}
 };
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::ManualControlPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(manual_control, mavros::std_plugins::ManualControlPlugin)
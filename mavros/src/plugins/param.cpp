@@ -14,11 +14,23 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <algorithm>
+#include <cerrno>
 #include <chrono>
 #include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <sys/stat.h>
 #include <mavros/mavros_plugin.h>
+#include <mavros/request_window.h>
 
 #include <mavros_msgs/srv/param_set.hpp>
+#include <mavros_msgs/srv/param_set_batch.hpp>
+#include <mavros_msgs/srv/param_snapshot.hpp>
 #include <mavros_msgs/srv/param_get.hpp>
 #include <mavros_msgs/srv/param_pull.hpp>
 #include <mavros_msgs/srv/param_push.hpp>
@@ -58,8 +70,9 @@ public:
 	ParameterValue param_value;
 	uint16_t param_index;
 	uint16_t param_count;
+	uint64_t version;		//!< table version of last change
 
-	void set_value(mavlink::common::msg::PARAM_VALUE &pmsg)
+	void set_value(const mavlink::common::msg::PARAM_VALUE &pmsg)
 	{
 		mavlink::mavlink_param_union_t uv;
 		uv.param_float = pmsg.param_value;
@@ -125,7 +138,7 @@ public:
 	/**
 	 * Variation of set_value with quirks for ArduPilotMega
 	 */
-	void set_value_apm_quirk(mavlink::common::msg::PARAM_VALUE &pmsg)
+	void set_value_apm_quirk(const mavlink::common::msg::PARAM_VALUE &pmsg)
 	{
 		int32_t int_tmp;
 		float float_tmp;
@@ -335,20 +348,135 @@ public:
  */
 class ParamSetOpt {
 public:
-	ParamSetOpt(Parameter &_p, size_t _rem) :
+	ParamSetOpt(Parameter &_p, size_t _rem, bool _batched = false) :
 		param(_p),
 		retries_remaining(_rem),
-		is_timedout(false)
+		is_timedout(false),
+		is_acked(false),
+		is_batched(_batched)
 	{ }
 
 	Parameter param;
 	size_t retries_remaining;
 	bool is_timedout;
+	bool is_acked;
+	bool is_batched;				//!< resent by batch loop, not timeout_cb
+	std::chrono::steady_clock::time_point deadline;	//!< batch only
 	std::mutex cond_mutex;
 	std::condition_variable ack;
 };
 
 
+/**
+ * @brief On-disk copy of FCU parameter table
+ *
+ * One file per FCU UID. It is valid while FCU reports the same _HASH_CHECK (PX4).
+ */
+class ParamCache {
+public:
+	using ParameterMap = std::unordered_map<std::string, Parameter>;
+
+	static std::string file_name(const std::string &dir, uint64_t uid)
+	{
+		return utils::format("%s/%016llx.param", dir.c_str(), (unsigned long long)uid);
+	}
+
+	/**
+	 * @brief Read cache
+	 * @return false if file is missing or broken
+	 */
+	static bool load(const std::string &fname, int64_t &hash, ParameterMap &params)
+	{
+		std::ifstream f(fname);
+		std::string line;
+
+		if (!std::getline(f, line) || line != HEADER)
+			return false;
+
+		if (!std::getline(f, line) || !(std::istringstream(line) >> hash))
+			return false;
+
+		params.clear();
+		while (std::getline(f, line)) {
+			std::istringstream is(line);
+			Parameter p{};
+			char type;
+
+			if (!(is >> p.param_id >> p.param_index >> p.param_count >> type))
+				return false;
+
+			if (type == 'b') {
+				int v;
+				if (!(is >> v))
+					return false;
+				p.param_value = rclcpp::ParameterValue(v != 0);
+			}
+			else if (type == 'i') {
+				int v;
+				if (!(is >> v))
+					return false;
+				p.param_value = rclcpp::ParameterValue(v);
+			}
+			else if (type == 'f') {
+				double v;
+				if (!(is >> v))
+					return false;
+				p.param_value = rclcpp::ParameterValue(v);
+			}
+			else
+				return false;
+
+			params[p.param_id] = p;
+		}
+
+		return !params.empty();
+	}
+
+	/**
+	 * @brief Write cache, replaces old file at once
+	 */
+	static bool save(const std::string &dir, const std::string &fname, int64_t hash, const ParameterMap &params)
+	{
+		if (::mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+			return false;
+
+		auto tmp = fname + ".tmp";
+		{
+			std::ofstream f(tmp);
+			f << HEADER << "\n" << hash << "\n";
+			f << std::setprecision(9);
+
+			for (auto &kv : params) {
+				auto &p = kv.second;
+				f << p.param_id << " " << p.param_index << " " << p.param_count << " ";
+
+				switch (p.param_value.get_type()) {
+				case rclcpp::ParameterType::PARAMETER_BOOL:
+					f << "b " << int(p.param_value.get<bool>());
+					break;
+				case rclcpp::ParameterType::PARAMETER_INTEGER:
+					f << "i " << p.param_value.get<int>();
+					break;
+				default:
+					f << "f " << p.param_value.get<double>();
+				}
+				f << "\n";
+			}
+
+			if (!f.flush())
+				return false;
+		}
+
+		return std::rename(tmp.c_str(), fname.c_str()) == 0;
+	}
+
+private:
+	static constexpr const char *HEADER = "# mavros param cache v1";
+};
+
+constexpr const char *ParamCache::HEADER;
+
+
 /**
  * @brief Parameter manipulation plugin
  */
@@ -359,11 +487,18 @@ public:
 		param_count(-1),
 		param_state(PR::IDLE),
 		is_timedout(false),
+		cache_save_pending(false),
+		cache_hash(0),
+		table_version(0),
+		table_epoch(0),
+		set_window(SET_WINDOW),
+		rosparam_mirrored(false),
+		rosparam_interval(std::chrono::milliseconds(MIRROR_INTERVAL_MS)),
 		RETRIES_COUNT(_RETRIES_COUNT),
 		param_rx_retries(RETRIES_COUNT),
-		BOOTUP_TIME_DT(BOOTUP_TIME_MS / 1000.0),
 		LIST_TIMEOUT_DT(LIST_TIMEOUT_MS / 1000.0),
-		PARAM_TIMEOUT_DT(PARAM_TIMEOUT_MS / 1000.0)
+		PARAM_TIMEOUT_DT(PARAM_TIMEOUT_MS / 1000.0),
+		fetcher(FETCH_WINDOW, RETRIES_COUNT, std::chrono::milliseconds(PARAM_TIMEOUT_MS))
 	{ }
 
 	void initialize(UAS &uas_)
@@ -374,14 +509,35 @@ public:
 		pull_srv = param_nh->create_service<mavros_msgs::srv::ParamPull>("pull", std::bind(&ParamPlugin::pull_cb, this, std::placeholders::_1, std::placeholders::_2));
 		push_srv = param_nh->create_service<mavros_msgs::srv::ParamPush>("push", std::bind(&ParamPlugin::push_cb, this, std::placeholders::_1, std::placeholders::_2));
 		set_srv = param_nh->create_service<mavros_msgs::srv::ParamSet>("set", std::bind(&ParamPlugin::set_cb, this, std::placeholders::_1, std::placeholders::_2));
+		set_batch_srv = param_nh->create_service<mavros_msgs::srv::ParamSetBatch>("set_batch", std::bind(&ParamPlugin::set_batch_cb, this, std::placeholders::_1, std::placeholders::_2));
+		snapshot_srv = param_nh->create_service<mavros_msgs::srv::ParamSnapshot>("snapshot", std::bind(&ParamPlugin::snapshot_cb, this, std::placeholders::_1, std::placeholders::_2));
 		get_srv = param_nh->create_service<mavros_msgs::srv::ParamGet>("get", std::bind(&ParamPlugin::get_cb, this, std::placeholders::_1, std::placeholders::_2));
 
 		param_value_pub = param_nh->create_publisher<mavros_msgs::msg::Param>("param_value", 100);
 
-		shedule_timer = param_nh->create_wall_timer(BOOTUP_TIME_DT, std::bind(&ParamPlugin::shedule_cb, this));
-		shedule_timer->cancel();
-		timeout_timer = param_nh->create_wall_timer(PARAM_TIMEOUT_DT, std::bind(&ParamPlugin::timeout_cb, this));
-		timeout_timer->cancel();
+		// parameter table cache, empty - disabled
+		uas_.mavros_node->get_parameter_or<std::string>("param_cache/dir", cache_dir, utils::default_cache_dir());
+
+		// PARAM_REQUEST_READ in flight while fetching missing params
+		int fetch_window;
+		uas_.mavros_node->get_parameter_or("param_fetch/window", fetch_window, int(FETCH_WINDOW));
+		fetcher = RequestWindow(std::max(fetch_window, 1), RETRIES_COUNT, std::chrono::milliseconds(PARAM_TIMEOUT_MS));
+
+		// PARAM_SET in flight for ~param/set_batch
+		uas_.mavros_node->get_parameter_or("param_set/window", set_window, int(SET_WINDOW));
+		set_window = std::max(set_window, 1);
+
+		// min period of ROS parameter updates following FCU changes [s]
+		double mirror_interval;
+		uas_.mavros_node->get_parameter_or("param_mirror/interval", mirror_interval, MIRROR_INTERVAL_MS / 1000.0);
+		rosparam_interval = std::chrono::duration_cast<TimerWheel::clock::duration>(
+				std::chrono::duration<double>(std::max(mirror_interval, 0.0)));
+
+		shedule_timer = create_timer(std::bind(&ParamPlugin::shedule_cb, this));
+		timeout_timer = create_timer(std::bind(&ParamPlugin::timeout_cb, this));
+		fetch_timer = create_timer(std::bind(&ParamPlugin::fetch_cb, this));
+		rosparam_timer = create_timer(std::bind(&ParamPlugin::rosparam_flush, this));
+		cache_timer = create_timer(std::bind(&ParamPlugin::cache_flush, this));
 		enable_connection_cb();
 	}
 
@@ -403,29 +559,40 @@ private:
 	rclcpp::Service<mavros_msgs::srv::ParamPull>::SharedPtr pull_srv;
 	rclcpp::Service<mavros_msgs::srv::ParamPush>::SharedPtr push_srv;
 	rclcpp::Service<mavros_msgs::srv::ParamSet>::SharedPtr set_srv;
+	rclcpp::Service<mavros_msgs::srv::ParamSetBatch>::SharedPtr set_batch_srv;
+	rclcpp::Service<mavros_msgs::srv::ParamSnapshot>::SharedPtr snapshot_srv;
 	rclcpp::Service<mavros_msgs::srv::ParamGet>::SharedPtr get_srv;
 
 	rclcpp::Publisher<mavros_msgs::msg::Param>::SharedPtr param_value_pub;
 
-	rclcpp::TimerBase::SharedPtr shedule_timer;			//!< for startup shedule fetch
-	rclcpp::TimerBase::SharedPtr timeout_timer;			//!< for timeout resend
+	TimerWheel::Ptr shedule_timer;			//!< for startup shedule fetch
+	TimerWheel::Ptr timeout_timer;			//!< for timeout resend
+	TimerWheel::Ptr fetch_timer;			//!< for missing params window
+	TimerWheel::Ptr rosparam_timer;			//!< commits staged ROS params
+	TimerWheel::Ptr cache_timer;			//!< writes staged cache file
 
 	static constexpr int BOOTUP_TIME_MS = 10000;	//!< APM boot time
 	static constexpr int PARAM_TIMEOUT_MS = 1000;	//!< Param wait time
 	static constexpr int LIST_TIMEOUT_MS = 30000;	//!< Receive all time
 	static constexpr int _RETRIES_COUNT = 3;
+	static constexpr int FETCH_TICK_MS = 20;	//!< Missing params window check period
+	static constexpr int FETCH_WINDOW = 8;		//!< Default requests in flight
+	static constexpr int SET_WINDOW = 8;		//!< Default batch sets in flight
+	static constexpr int MIRROR_INTERVAL_MS = 500;	//!< Default min period of ROS param commits
 
-	const std::chrono::duration<double> BOOTUP_TIME_DT;
 	const std::chrono::duration<double> LIST_TIMEOUT_DT;
 	const std::chrono::duration<double> PARAM_TIMEOUT_DT;
 	const int RETRIES_COUNT;
 
 	std::unordered_map<std::string, Parameter> parameters;
-	std::list<uint16_t> parameters_missing_idx;
+	RequestWindow fetcher;		//!< arrived indices and missing requests
 	std::unordered_map<std::string, std::shared_ptr<ParamSetOpt>> set_parameters;
+	std::condition_variable_any batch_ack;	//!< any batched set acked
+	int set_window;
 	ssize_t param_count;
 	enum class PR {
 		IDLE,
+		RXHASH,		//!< validating cache
 		RXLIST,
 		RXPARAM,
 		RXPARAM_TIMEDOUT,
@@ -438,29 +605,67 @@ private:
 	std::mutex list_cond_mutex;
 	std::condition_variable list_receiving;
 
+	std::string cache_dir;
+	bool cache_save_pending;		//!< save on next _HASH_CHECK
+	int64_t cache_hash;			//!< hash of loaded cache
+	ParamCache::ParameterMap cached_parameters;	//!< loaded, waiting for hash
+
+	//! Table copy waiting for cache_flush(), file is written out of message handler
+	struct CacheWrite {
+		std::string fname;
+		int64_t hash;
+		ParamCache::ParameterMap params;
+	};
+	std::mutex cache_write_mutex;
+	std::unique_ptr<CacheWrite> cache_write;	//!< guarded by cache_write_mutex
+
+	uint64_t table_version;		//!< bumped on each parameter change
+	uint64_t table_epoch;		//!< version of last table clear, older deltas are invalid
+
+	//! ROS params follow FCU table after first ~param/pull
+	bool rosparam_mirrored;
+	TimerWheel::clock::duration rosparam_interval;
+	std::mutex rosparam_mutex;
+	std::unordered_map<std::string, rclcpp::ParameterValue> rosparam_staged;	//!< guarded by rosparam_mutex
+
+	static constexpr const char *HASH_CHECK_ID = "_HASH_CHECK";
+
 	/* -*- message handlers -*- */
 
-	void handle_param_value(const mavlink::mavlink_message_t *msg, mavlink::common::msg::PARAM_VALUE &pmsg)
+	void handle_param_value(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::PARAM_VALUE &pmsg)
 	{
 		lock_guard lock(mutex);
 
 		auto param_id = mavlink::to_string(pmsg.param_id);
 
+		if (param_state == PR::RXHASH) {
+			if (param_id == HASH_CHECK_ID)
+				check_cache_hash(pmsg);
+			return;
+		}
+
 		// search
 		auto param_it = parameters.find(param_id);
 		if (param_it != parameters.end()) {
 			// parameter exists
 			auto &p = param_it->second;
+			auto old_value = p.param_value;
 
 			if (m_uas->is_ardupilotmega())
 				p.set_value_apm_quirk(pmsg);
 			else
 				p.set_value(pmsg);
 
+			if (p.param_value != old_value)
+				p.version = ++table_version;
+
 			// check that ack required
 			auto set_it = set_parameters.find(param_id);
 			if (set_it != set_parameters.end()) {
+				set_it->second->is_acked = true;
 				set_it->second->ack.notify_all();
+				if (set_it->second->is_batched)
+					batch_ack.notify_all();
 			}
 
 			param_value_pub->publish(p.to_msg());
@@ -471,6 +676,14 @@ private:
 					 p.param_count != pmsg.param_count),
 					"PR: Param " << p.to_string() << " different index: " << pmsg.param_index << "/" << pmsg.param_count);
 			RCLCPP_DEBUG_STREAM(logger, "PR: Update param " << p.to_string());
+
+			// FCU table changed, refresh hash and rewrite cache
+			if (param_state == PR::IDLE || param_state == PR::TXPARAM) {
+				if (param_id != HASH_CHECK_ID && !cache_save_pending && !cache_dir.empty() && m_uas->is_px4()) {
+					cache_save_pending = true;
+					param_request_read(HASH_CHECK_ID);
+				}
+			}
 		}
 		else {
 			// insert new element
@@ -484,6 +697,7 @@ private:
 			else
 				p.set_value(pmsg);
 
+			p.version = ++table_version;
 			parameters[param_id] = p;
 
 			param_value_pub->publish(p.to_msg());
@@ -491,6 +705,14 @@ private:
 			RCLCPP_DEBUG_STREAM(logger, "PR: New param " << p.to_string());
 		}
 
+		if (param_id == HASH_CHECK_ID && cache_save_pending && m_uas->is_px4())
+			save_cache();
+
+		// list pull commits whole table when it is done
+		if (rosparam_mirrored && rosparam_stage(parameters[param_id])
+				&& (param_state == PR::IDLE || param_state == PR::TXPARAM))
+			rosparam_schedule();
+
 		if (param_state == PR::RXLIST || param_state == PR::RXPARAM || param_state == PR::RXPARAM_TIMEDOUT) {
 
 			// we received first param. setup list timeout
@@ -498,51 +720,28 @@ private:
 				param_count = pmsg.param_count;
 				param_state = PR::RXPARAM;
 
-				parameters_missing_idx.clear();
 				if (param_count != UINT16_MAX) {
 					RCLCPP_DEBUG(logger, "PR: waiting %zu parameters", param_count);
 					// declare that all parameters are missing
-					for (uint16_t idx = 0; idx < param_count; idx++)
-						parameters_missing_idx.push_back(idx);
+					fetcher.reset(param_count);
 				}
-				else
+				else {
 					RCLCPP_WARN(logger, "PR: FCU does not know index for first element! "
 							"Param list may be truncated.");
+					fetcher.reset(0);
+				}
 			}
 
-			// trying to avoid endless rerequest loop
-			// Issue #276
-			bool it_is_first_requested = parameters_missing_idx.front() == pmsg.param_index;
-
-			// remove idx for that message
-			parameters_missing_idx.remove(pmsg.param_index);
-
-			// in receiving mode we use param_rx_retries for LIST and PARAM
-			if (it_is_first_requested) {
-				RCLCPP_DEBUG(logger, "PR: got a value of a requested param idx=%u, "
-						"resetting retries count", pmsg.param_index);
-				param_rx_retries = RETRIES_COUNT;
-			} else if (param_state == PR::RXPARAM_TIMEDOUT) {
-				RCLCPP_INFO(logger, "PR: got an unsolicited param value idx=%u, "
-						"not resetting retries count %zu", pmsg.param_index, param_rx_retries);
-			}
+			if (!fetcher.received(pmsg.param_index, RequestWindow::clock::now()))
+				RCLCPP_DEBUG(logger, "PR: duplicate or unindexed param value idx=%u", pmsg.param_index);
 
 			restart_timeout_timer();
 
 			/* index starting from 0, receivig done */
-			if (parameters_missing_idx.empty()) {
-				ssize_t missed = param_count - parameters.size();
-				RCLCPP_INFO_EXPRESSION(logger, missed == 0, "param", "PR: parameters list received");
-				RCLCPP_WARN_EXPRESSION(logger, missed > 0, "param",
-						"PR: parameters list received, but %zd parametars are missed",
-						missed);
-				go_idle();
-				list_receiving.notify_all();
-			} else if (param_state == PR::RXPARAM_TIMEDOUT) {
-				uint16_t first_miss_idx = parameters_missing_idx.front();
-				RCLCPP_DEBUG(logger, "PR: requesting next timed out parameter idx=%u", first_miss_idx);
-				param_request_read("", first_miss_idx);
-			}
+			if (fetcher.missing() == 0)
+				finish_list_pull();
+			else if (param_state == PR::RXPARAM_TIMEDOUT)
+				fetch_missing();
 		}
 	}
 
@@ -607,7 +806,7 @@ private:
 
 	void shedule_pull()
 	{
-		shedule_timer->reset();
+		shedule_timer->start(std::chrono::milliseconds(BOOTUP_TIME_MS));
 	}
 
 	void shedule_cb()
@@ -620,65 +819,247 @@ private:
 		}
 
 		RCLCPP_DEBUG(logger, "PR: start sheduled pull");
+		if (load_cache())
+			return;
+
+		start_list_pull();
+	}
+
+	void start_list_pull()
+	{
 		param_state = PR::RXLIST;
 		param_rx_retries = RETRIES_COUNT;
-		parameters.clear();
+		clear_parameters();
+		cache_save_pending = false;
 
 		restart_timeout_timer();
 		param_request_list();
 	}
 
+	/* -*- parameter cache -*- */
+
+	std::string cache_file_name()
+	{
+		auto uid = m_uas->get_fcu_uid();
+		if (cache_dir.empty() || uid == 0 || !m_uas->is_px4())
+			return "";
+
+		return ParamCache::file_name(cache_dir, uid);
+	}
+
+	/**
+	 * @brief Load cache and request _HASH_CHECK to validate it
+	 * @return false if there is no usable cache, full pull needed
+	 */
+	bool load_cache()
+	{
+		auto fname = cache_file_name();
+		if (fname.empty() || !ParamCache::load(fname, cache_hash, cached_parameters))
+			return false;
+
+		RCLCPP_DEBUG(logger, "PR: loaded %zu cached params, checking hash", cached_parameters.size());
+		param_state = PR::RXHASH;
+		param_rx_retries = RETRIES_COUNT;
+		clear_parameters();
+
+		restart_timeout_timer();
+		param_request_read(HASH_CHECK_ID);
+		return true;
+	}
+
+	void check_cache_hash(const mavlink::common::msg::PARAM_VALUE &pmsg)
+	{
+		Parameter hash{};
+		hash.set_value(pmsg);
+
+		if (hash.to_integer() != cache_hash) {
+			RCLCPP_INFO(logger, "PR: parameter cache is outdated, full pull");
+			cached_parameters.clear();
+			start_list_pull();
+			return;
+		}
+
+		RCLCPP_INFO(logger, "PR: %zu parameters loaded from cache", cached_parameters.size());
+		clear_parameters();
+		parameters = std::move(cached_parameters);
+		cached_parameters.clear();
+		for (auto &p : parameters)
+			p.second.version = ++table_version;
+		param_count = parameters.size();
+
+		for (auto &p : parameters)
+			param_value_pub->publish(p.second.to_msg());
+
+		if (rosparam_mirrored) {
+			for (auto &p : parameters)
+				rosparam_stage(p.second);
+			rosparam_schedule();
+		}
+
+		go_idle();
+		list_receiving.notify_all();
+	}
+
+	void save_cache()
+	{
+		cache_save_pending = false;
+
+		auto fname = cache_file_name();
+		auto it = parameters.find(HASH_CHECK_ID);
+		if (fname.empty() || it == parameters.end())
+			return;
+
+		auto cw = std::make_unique<CacheWrite>();
+		cw->fname = fname;
+		cw->hash = it->second.to_integer();
+		cw->params = parameters;
+		{
+			std::lock_guard<std::mutex> lock(cache_write_mutex);
+			cache_write = std::move(cw);
+		}
+
+		// newer table replaces one not written yet
+		if (!cache_timer->is_armed())
+			cache_timer->start(TimerWheel::clock::duration::zero());
+	}
+
+	/**
+	 * @brief Write staged table copy to cache file
+	 *
+	 * Runs on timer wheel thread, so handle_param_value() on IO thread
+	 * does not wait for disk. Should be called without plugin mutex.
+	 */
+	void cache_flush()
+	{
+		std::unique_ptr<CacheWrite> cw;
+		{
+			std::lock_guard<std::mutex> lock(cache_write_mutex);
+			cw = std::move(cache_write);
+		}
+
+		if (!cw)
+			return;
+
+		if (ParamCache::save(cache_dir, cw->fname, cw->hash, cw->params))
+			RCLCPP_DEBUG(logger, "PR: parameter cache saved: %s", cw->fname.c_str());
+		else
+			RCLCPP_WARN(logger, "PR: failed to write parameter cache: %s", cw->fname.c_str());
+	}
+
+	void finish_list_pull()
+	{
+		ssize_t missed = param_count - parameters.size();
+		RCLCPP_INFO_EXPRESSION(logger, missed == 0, "param", "PR: parameters list received");
+		RCLCPP_WARN_EXPRESSION(logger, missed > 0, "param",
+				"PR: parameters list received, but %zd parametars are missed",
+				missed);
+
+		// PX4 sends hash after list, save when it comes
+		if (missed == 0 && !cache_dir.empty() && m_uas->is_px4()) {
+			cache_save_pending = true;
+			if (parameters.count(HASH_CHECK_ID))
+				save_cache();
+		}
+
+		if (rosparam_mirrored)
+			rosparam_schedule();
+
+		go_idle();
+		list_receiving.notify_all();
+	}
+
+	/**
+	 * @brief Keep missing params window full, finish when nothing left to wait
+	 */
+	void fetch_missing()
+	{
+		auto lost = fetcher.poll(RequestWindow::clock::now(),
+				[this](uint16_t idx) { param_request_read("", idx); });
+
+		if (lost > 0)
+			RCLCPP_ERROR(logger, "PR: %zu params completely missing, %zu still requested",
+					lost, fetcher.in_flight());
+
+		if (fetcher.done())
+			finish_list_pull();
+	}
+
+	void fetch_cb()
+	{
+		lock_guard lock(mutex);
+		if (param_state == PR::RXPARAM_TIMEDOUT)
+			fetch_missing();
+		else
+			fetch_timer->cancel();
+	}
+
 	void timeout_cb()
 	{
 		lock_guard lock(mutex);
-		if (param_state == PR::RXLIST && param_rx_retries > 0) {
+		if (param_state == PR::RXHASH) {
+			if (param_rx_retries > 0) {
+				param_rx_retries--;
+				restart_timeout_timer();
+				param_request_read(HASH_CHECK_ID);
+			}
+			else {
+				RCLCPP_WARN(logger, "PR: no _HASH_CHECK reply, full pull");
+				cached_parameters.clear();
+				start_list_pull();
+			}
+		}
+		else if (param_state == PR::RXLIST && param_rx_retries > 0) {
 			param_rx_retries--;
 			RCLCPP_WARN(logger, "PR: request list timeout, retries left %zu", param_rx_retries);
 
 			restart_timeout_timer();
 			param_request_list();
 		}
-		else if (param_state == PR::RXPARAM || param_state == PR::RXPARAM_TIMEDOUT) {
-			if (parameters_missing_idx.empty()) {
+		else if (param_state == PR::RXPARAM) {
+			// list stream stalled
+			if (fetcher.done()) {
 				RCLCPP_WARN(logger, "PR: missing list is clear, but we in RXPARAM state, "
 						"maybe last rerequest fails. Params missed: %zd",
 						param_count - parameters.size());
-				go_idle();
-				list_receiving.notify_all();
+				finish_list_pull();
 				return;
 			}
 
-			param_state = PR::RXPARAM_TIMEDOUT;
-			uint16_t first_miss_idx = parameters_missing_idx.front();
-			if (param_rx_retries > 0) {
+			// most of the list is lost, stream it again
+			if (fetcher.missing() * 2 > fetcher.size() && param_rx_retries > 0) {
 				param_rx_retries--;
-				RCLCPP_WARN(logger, "PR: request param #%u timeout, retries left %zu, and %zu params still missing",
-						first_miss_idx, param_rx_retries, parameters_missing_idx.size());
+				RCLCPP_WARN(logger, "PR: %zu of %zu params missing, request list again, retries left %zu",
+						fetcher.missing(), fetcher.size(), param_rx_retries);
 				restart_timeout_timer();
-				param_request_read("", first_miss_idx);
+				param_request_list();
+				return;
 			}
-			else {
-				RCLCPP_ERROR(logger, "PR: request param #%u completely missing.", first_miss_idx);
-				parameters_missing_idx.pop_front();
-				restart_timeout_timer();
-				if (!parameters_missing_idx.empty()) {
-					param_rx_retries = RETRIES_COUNT;
-					first_miss_idx = parameters_missing_idx.front();
 
-					RCLCPP_WARN(logger, "PR: %zu params still missing, trying to request next: #%u",
-							parameters_missing_idx.size(), first_miss_idx);
-					param_request_read("", first_miss_idx);
-				}
-			}
+			RCLCPP_WARN(logger, "PR: %zu params missing, requesting them",
+					fetcher.missing());
+			param_state = PR::RXPARAM_TIMEDOUT;
+			restart_timeout_timer();
+			fetch_timer->start_periodic(std::chrono::milliseconds(FETCH_TICK_MS));
+			fetch_missing();
+		}
+		else if (param_state == PR::RXPARAM_TIMEDOUT) {
+			// window is driven by fetch_timer, just keep watching
+			restart_timeout_timer();
+			fetch_missing();
 		}
 		else if (param_state == PR::TXPARAM) {
-			auto it = set_parameters.begin();
-			if (it == set_parameters.end()) {
+			if (set_parameters.empty()) {
 				RCLCPP_DEBUG(logger, "PR: send list empty, but state TXPARAM");
 				go_idle();
 				return;
 			}
 
+			// batched sets have own deadlines
+			auto it = std::find_if(set_parameters.begin(), set_parameters.end(),
+					[](const decltype(set_parameters)::value_type &kv) { return !kv.second->is_batched; });
+			if (it == set_parameters.end())
+				return;
+
 			if (it->second->retries_remaining > 0) {
 				it->second->retries_remaining--;
 				RCLCPP_WARN(logger, "PR: Resend param set for %s, retries left %zu",
@@ -699,16 +1080,23 @@ private:
 		}
 	}
 
+	void clear_parameters()
+	{
+		parameters.clear();
+		table_epoch = ++table_version;
+	}
+
 	void restart_timeout_timer()
 	{
 		is_timedout = false;
-		timeout_timer->reset();
+		timeout_timer->start_periodic(std::chrono::milliseconds(PARAM_TIMEOUT_MS));
 	}
 
 	void go_idle()
 	{
 		param_state = PR::IDLE;
 		timeout_timer->cancel();
+		fetch_timer->cancel();
 	}
 
 	bool wait_fetch_all()
@@ -748,23 +1136,161 @@ private:
 		// free opt data
 		set_parameters.erase(param.param_id);
 
-		go_idle();
+		if (set_parameters.empty())
+			go_idle();
 		return is_not_timeout;
 	}
 
-	//! Set ROS param only if name is good
-	bool rosparam_set_allowed(const Parameter &p)
+	/**
+	 * @brief Send PARAM_SETs keeping set_window of them unacked
+	 *
+	 * Each in flight set is resent on its own PARAM_TIMEOUT, up to RETRIES_COUNT times.
+	 *
+	 * @param[in,out] params  values to send, updated to FCU values
+	 * @return per param success
+	 */
+	std::vector<bool> send_param_set_batch(std::vector<Parameter> &params)
 	{
-		if (m_uas->is_px4() && p.param_id == "_HASH_CHECK") {
-			auto v = p.param_value;	// const XmlRpcValue can't cast
-			RCLCPP_INFO(logger, "PR: PX4 parameter _HASH_CHECK ignored: 0x%8x", v.get<int32_t>());
-			return false;
+		using steady_clock = std::chrono::steady_clock;
+		const auto timeout = std::chrono::duration_cast<steady_clock::duration>(PARAM_TIMEOUT_DT);
+
+		unique_lock lock(mutex);
+
+		std::vector<bool> results(params.size(), false);
+		std::vector<std::pair<size_t, std::shared_ptr<ParamSetOpt>>> in_flight;
+		size_t next = 0;
+
+		param_state = PR::TXPARAM;
+
+		while (true) {
+			auto now = steady_clock::now();
+
+			for (auto it = in_flight.begin(); it != in_flight.end(); ) {
+				auto &opt = it->second;
+				bool finished = false;
+
+				if (opt->is_acked) {
+					results[it->first] = true;
+					finished = true;
+				}
+				else if (now >= opt->deadline) {
+					if (opt->retries_remaining > 0) {
+						opt->retries_remaining--;
+						RCLCPP_WARN(logger, "PR: Resend param set for %s, retries left %zu",
+								opt->param.param_id.c_str(), opt->retries_remaining);
+						opt->deadline = now + timeout;
+						param_set(opt->param);
+					}
+					else {
+						RCLCPP_ERROR(logger, "PR: Param set for %s timed out.",
+								opt->param.param_id.c_str());
+						finished = true;
+					}
+				}
+
+				if (finished) {
+					set_parameters.erase(opt->param.param_id);
+					it = in_flight.erase(it);
+				}
+				else
+					++it;
+			}
+
+			while (next < params.size() && in_flight.size() < size_t(set_window)) {
+				auto &param = params[next];
+
+				// same id twice in one batch: wait for the first one
+				if (set_parameters.count(param.param_id))
+					break;
+
+				auto opt = std::make_shared<ParamSetOpt>(param, RETRIES_COUNT, true);
+				opt->deadline = now + timeout;
+				set_parameters[param.param_id] = opt;
+				in_flight.emplace_back(next++, opt);
+				param_set(param);
+			}
+
+			if (next >= params.size() && in_flight.empty())
+				break;
+
+			auto wake = now + timeout;
+			for (auto &f : in_flight)
+				wake = std::min(wake, f.second->deadline);
+
+			batch_ack.wait_until(lock, wake);
+		}
+
+		for (size_t i = 0; i < params.size(); i++) {
+			auto param_it = parameters.find(params[i].param_id);
+			if (param_it != parameters.end())
+				params[i] = param_it->second;
 		}
 
-		param_nh->set_parameter(rclcpp::Parameter(p.param_id, p.param_value));
+		if (set_parameters.empty())
+			go_idle();
+		return results;
+	}
+
+	//! rclcpp value according to ParamValue description
+	static rclcpp::ParameterValue to_parameter_value(const mavros_msgs::msg::ParamValue &value)
+	{
+		if (value.integer != 0)
+			return rclcpp::ParameterValue(static_cast<int>(value.integer));
+		else if (value.real != 0.0)
+			return rclcpp::ParameterValue(value.real);
+		else
+			return rclcpp::ParameterValue(0);
+	}
+
+	/**
+	 * @brief Queue ROS param update, committed by rosparam_flush()
+	 * @return false if param is not mirrored
+	 */
+	bool rosparam_stage(const Parameter &p)
+	{
+		if (m_uas->is_px4() && p.param_id == HASH_CHECK_ID)
+			return false;
+
+		std::lock_guard<std::mutex> lock(rosparam_mutex);
+		rosparam_staged[p.param_id] = p.param_value;
 		return true;
 	}
 
+	//! Commit staged params after rosparam_interval, later changes join the same commit
+	void rosparam_schedule()
+	{
+		if (!rosparam_timer->is_armed())
+			rosparam_timer->start(rosparam_interval);
+	}
+
+	/**
+	 * @brief Commit staged params by one set_parameters_atomically()
+	 *
+	 * So whole table gives one /parameter_events message and one
+	 * parameter callback call, not one per parameter.
+	 * Should be called without plugin mutex.
+	 */
+	void rosparam_flush()
+	{
+		std::vector<rclcpp::Parameter> batch;
+		{
+			std::lock_guard<std::mutex> lock(rosparam_mutex);
+			batch.reserve(rosparam_staged.size());
+			for (auto &kv : rosparam_staged)
+				batch.emplace_back(kv.first, kv.second);
+			rosparam_staged.clear();
+		}
+
+		if (batch.empty())
+			return;
+
+		auto result = param_nh->set_parameters_atomically(batch);
+		if (!result.successful)
+			RCLCPP_WARN(logger, "PR: %zu ROS params not set: %s", batch.size(), result.reason.c_str());
+		else
+			RCLCPP_DEBUG(logger, "PR: %zu ROS params set", batch.size());
+	}
+
 	/* -*- ROS callbacks -*- */
 
 	/**
@@ -783,18 +1309,14 @@ private:
 			else
 				RCLCPP_INFO(logger, "PR: start force pull");
 
-			param_state = PR::RXLIST;
-			param_rx_retries = RETRIES_COUNT;
-			parameters.clear();
-
 			shedule_timer->cancel();
-			restart_timeout_timer();
-			param_request_list();
+			start_list_pull();
 
 			lock.unlock();
 			res->success = wait_fetch_all();
 		}
-		else if (param_state == PR::RXLIST || param_state == PR::RXPARAM || param_state == PR::RXPARAM_TIMEDOUT) {
+		else if (param_state == PR::RXHASH || param_state == PR::RXLIST ||
+				param_state == PR::RXPARAM || param_state == PR::RXPARAM_TIMEDOUT) {
 			lock.unlock();
 			res->success = wait_fetch_all();
 		}
@@ -806,11 +1328,12 @@ private:
 		lock.lock();
 		res->param_received = parameters.size();
 
-		for (auto &p : parameters) {
-			lock.unlock();
-			rosparam_set_allowed(p.second);
-			lock.lock();
-		}
+		for (auto &p : parameters)
+			rosparam_stage(p.second);
+
+		rosparam_mirrored = true;
+		lock.unlock();
+		rosparam_flush();
 
 		return true;
 	}
@@ -826,34 +1349,32 @@ private:
 		if (!param_nh->get_parameters("", param_dict))
 			return true;
 
-		int tx_count = 0;
-		for (auto &param : param_dict) {
-			if (Parameter::check_exclude_param_id(param.first)) {
-				RCLCPP_DEBUG_STREAM(logger, "PR: Exclude param: " << param.first);
-				continue;
-			}
-
-			unique_lock lock(mutex);
-			auto param_it = parameters.find(param.first);
-			if (param_it != parameters.end()) {
-				// copy current state of Parameter
-				auto to_send = param_it->second;
-
-				// Update XmlRpcValue
-				to_send.param_value = param.second.get_parameter_value();
+		std::vector<Parameter> to_send;
+		{
+			lock_guard lock(mutex);
+			for (auto &param : param_dict) {
+				if (Parameter::check_exclude_param_id(param.first)) {
+					RCLCPP_DEBUG_STREAM(logger, "PR: Exclude param: " << param.first);
+					continue;
+				}
 
-				lock.unlock();
-				bool set_res = send_param_set_and_wait(to_send);
-				lock.lock();
+				auto param_it = parameters.find(param.first);
+				if (param_it != parameters.end()) {
+					// copy current state of Parameter
+					to_send.push_back(param_it->second);
 
-				if (set_res)
-					tx_count++;
-			}
-			else {
-				RCLCPP_WARN_STREAM(logger, "PR: Unknown rosparam: " << param.first);
+					// Update XmlRpcValue
+					to_send.back().param_value = param.second.get_parameter_value();
+				}
+				else {
+					RCLCPP_WARN_STREAM(logger, "PR: Unknown rosparam: " << param.first);
+				}
 			}
 		}
 
+		auto results = send_param_set_batch(to_send);
+		int tx_count = std::count(results.begin(), results.end(), true);
+
 		res->success = true;
 		res->param_transfered = tx_count;
 
@@ -869,7 +1390,8 @@ private:
 	{
 		unique_lock lock(mutex);
 
-		if (param_state == PR::RXLIST || param_state == PR::RXPARAM || param_state == PR::RXPARAM_TIMEDOUT) {
+		if (param_state == PR::RXHASH || param_state == PR::RXLIST ||
+				param_state == PR::RXPARAM || param_state == PR::RXPARAM_TIMEDOUT) {
 			RCLCPP_ERROR(logger, "PR: receiving not complete");
 			return false;
 		}
@@ -877,14 +1399,7 @@ private:
 		auto param_it = parameters.find(req->param_id);
 		if (param_it != parameters.end()) {
 			auto to_send = param_it->second;
-
-			// according to ParamValue description
-			if (req->value.integer != 0)
-				to_send.param_value = rclcpp::ParameterValue(static_cast<int>(req->value.integer));
-			else if (req->value.real != 0.0)
-				to_send.param_value = rclcpp::ParameterValue(req->value.real);
-			else
-				to_send.param_value = rclcpp::ParameterValue(0);
+			to_send.param_value = to_parameter_value(req->value);
 
 			lock.unlock();
 			res->success = send_param_set_and_wait(to_send);
@@ -893,8 +1408,9 @@ private:
 			res->value.integer = param_it->second.to_integer();
 			res->value.real = param_it->second.to_real();
 
+			rosparam_stage(param_it->second);
 			lock.unlock();
-			rosparam_set_allowed(param_it->second);
+			rosparam_flush();
 		}
 		else {
 			RCLCPP_ERROR_STREAM(logger, "PR: Unknown parameter to set: " << req->param_id);
@@ -904,6 +1420,106 @@ private:
 		return true;
 	}
 
+	/**
+	 * @brief sets many parameter values, pipelined
+	 * @service ~param/set_batch
+	 */
+	bool set_batch_cb(const mavros_msgs::srv::ParamSetBatch::Request::SharedPtr req,
+			mavros_msgs::srv::ParamSetBatch::Response::SharedPtr res)
+	{
+		unique_lock lock(mutex);
+
+		if (param_state == PR::RXHASH || param_state == PR::RXLIST ||
+				param_state == PR::RXPARAM || param_state == PR::RXPARAM_TIMEDOUT) {
+			RCLCPP_ERROR(logger, "PR: receiving not complete");
+			return false;
+		}
+
+		if (req->param_id.size() != req->value.size()) {
+			RCLCPP_ERROR(logger, "PR: set batch: %zu ids, but %zu values",
+					req->param_id.size(), req->value.size());
+			return false;
+		}
+
+		auto n = req->param_id.size();
+		res->param_success.assign(n, false);
+		res->value.resize(n);
+
+		// unknown ids fail without sending
+		std::vector<Parameter> to_send;
+		std::vector<size_t> to_send_idx;
+		for (size_t i = 0; i < n; i++) {
+			auto param_it = parameters.find(req->param_id[i]);
+			if (param_it == parameters.end()) {
+				RCLCPP_ERROR_STREAM(logger, "PR: Unknown parameter to set: " << req->param_id[i]);
+				continue;
+			}
+
+			to_send.push_back(param_it->second);
+			to_send.back().param_value = to_parameter_value(req->value[i]);
+			to_send_idx.push_back(i);
+		}
+
+		lock.unlock();
+		auto results = send_param_set_batch(to_send);
+
+		res->success = to_send.size() == n;
+		for (size_t j = 0; j < to_send.size(); j++) {
+			auto i = to_send_idx[j];
+			res->param_success[i] = results[j];
+			res->value[i].integer = to_send[j].to_integer();
+			res->value[i].real = to_send[j].to_real();
+			res->success = res->success && results[j];
+
+			if (results[j])
+				rosparam_stage(to_send[j]);
+		}
+
+		rosparam_flush();
+		return true;
+	}
+
+	/**
+	 * @brief copy of whole parameter table, or of changes since version
+	 * @service ~param/snapshot
+	 */
+	bool snapshot_cb(const mavros_msgs::srv::ParamSnapshot::Request::SharedPtr req,
+			mavros_msgs::srv::ParamSnapshot::Response::SharedPtr res)
+	{
+		lock_guard lock(mutex);
+
+		res->success = true;
+		res->version = table_version;
+		res->full = req->since_version < table_epoch;
+		res->synced = param_state != PR::RXHASH && param_state != PR::RXLIST &&
+				param_state != PR::RXPARAM && param_state != PR::RXPARAM_TIMEDOUT &&
+				param_count >= 0 && size_t(param_count) == parameters.size();
+		res->param_count = param_count >= 0 ? param_count : parameters.size();
+
+		auto n = parameters.size();
+		res->param_id.reserve(n);
+		res->param_type.reserve(n);
+		res->value.reserve(n);
+		res->param_index.reserve(n);
+
+		for (auto &kv : parameters) {
+			auto &p = kv.second;
+			if (!res->full && p.version <= req->since_version)
+				continue;
+
+			mavros_msgs::msg::ParamValue value;
+			value.integer = p.to_integer();
+			value.real = p.to_real();
+
+			res->param_id.push_back(p.param_id);
+			res->param_type.push_back(p.param_value.get_type());
+			res->value.push_back(value);
+			res->param_index.push_back(p.param_index);
+		}
+
+		return true;
+	}
+
 	/**
 	 * @brief get parameter
 	 * @service ~param/get
@@ -931,5 +1547,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::ParamPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(param, mavros::std_plugins::ParamPlugin)
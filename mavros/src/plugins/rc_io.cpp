@@ -15,22 +15,31 @@
  */
 
 #include <mavros/mavros_plugin.h>
+#include <mavros/output_scheduler.h>
 
 #include <mavros_msgs/msg/rc_in.hpp>
 #include <mavros_msgs/msg/rc_out.hpp>
 #include <mavros_msgs/msg/override_rc_in.hpp>
 
+#include <cmath>
+
 namespace mavros {
 namespace std_plugins {
 /**
  * @brief RC IO plugin
+ *
+ * RC override is sent by OutputScheduler: latest value at rc/override/rate,
+ * channel change of rc/override/change_threshold or more right away,
+ * and keep-alive resend of last value.
  */
 class RCIOPlugin : public plugin::PluginBase {
 public:
 	RCIOPlugin() : PluginBase(),
 		raw_rc_in(0),
 		raw_rc_out(0),
-		has_rc_channels_msg(false)
+		has_rc_channels_msg(false),
+		last_override {},
+		sent_channels {}
 	{ }
 
 	void initialize(UAS &uas_)
@@ -38,6 +47,20 @@ public:
 		PluginBase::initialize(uas_);
 		rc_nh = uas_.mavros_node->create_sub_node("rc");
 
+		// rc/in: 0 - publish each RC_CHANNELS
+		auto in_rate = rc_nh->declare_parameter<double>("rc/in/rate", 0.0);
+		rc_in_sched.set_options(OutputScheduler::from_rates(in_rate, 0.0, 0.0));
+
+		// rc/override: 0 - send each message, no keep-alive
+		auto override_rate = rc_nh->declare_parameter<double>("rc/override/rate", 0.0);
+		auto override_keepalive = rc_nh->declare_parameter<double>("rc/override/keepalive", 0.0);
+		auto override_threshold = rc_nh->declare_parameter<double>("rc/override/change_threshold", 0.0);
+		override_sched.set_options(OutputScheduler::from_rates(override_rate, override_keepalive, override_threshold));
+
+		auto timer_period = override_sched.timer_period();
+		if (timer_period > OutputScheduler::clock::duration::zero())
+			override_timer = rc_nh->create_wall_timer(timer_period, std::bind(&RCIOPlugin::override_timer_cb, this));
+
 		rc_in_pub = rc_nh->create_publisher<mavros_msgs::msg::RCIn>("in", 10);
 		rc_out_pub = rc_nh->create_publisher<mavros_msgs::msg::RCOut>("out", 10);
 		override_sub = rc_nh->create_subscription<mavros_msgs::msg::OverrideRCIn>("override", 10, std::bind(&RCIOPlugin::override_cb, this, std::placeholders::_1));
@@ -65,10 +88,18 @@ private:
 	rclcpp::Publisher<mavros_msgs::msg::RCIn>::SharedPtr rc_in_pub;
 	rclcpp::Publisher<mavros_msgs::msg::RCOut>::SharedPtr rc_out_pub;
 	rclcpp::Subscription<mavros_msgs::msg::OverrideRCIn>::SharedPtr override_sub;
+	rclcpp::TimerBase::SharedPtr override_timer;
+
+	OutputScheduler rc_in_sched;		//!< under mutex
+
+	std::mutex override_mutex;
+	OutputScheduler override_sched;
+	mavlink::common::msg::RC_CHANNELS_OVERRIDE last_override;
+	std::array<uint16_t, 8> sent_channels;	//!< last sent override
 
 	/* -*- rx handlers -*- */
 
-	void handle_rc_channels_raw(const mavlink::mavlink_message_t *msg, mavlink::common::msg::RC_CHANNELS_RAW &port)
+	void handle_rc_channels_raw(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::RC_CHANNELS_RAW &port)
 	{
 		/* if we receive RC_CHANNELS, drop RC_CHANNELS_RAW */
 		if (has_rc_channels_msg)
@@ -101,10 +132,11 @@ private:
 		rcin_msg->rssi = port.rssi;
 		rcin_msg->channels = raw_rc_in;
 
-		rc_in_pub->publish(*rcin_msg);
+		if (rc_in_sched.update(0.0))
+			rc_in_pub->publish(*rcin_msg);
 	}
 
-	void handle_rc_channels(const mavlink::mavlink_message_t *msg, mavlink::common::msg::RC_CHANNELS &channels)
+	void handle_rc_channels(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::RC_CHANNELS &channels)
 	{
 		constexpr size_t MAX_CHANCNT = 18;
 		lock_guard lock(mutex);
@@ -112,18 +144,19 @@ private:
 		RCUTILS_LOG_INFO_EXPRESSION_NAMED(!has_rc_channels_msg, "rc", "RC_CHANNELS message detected!");
 		has_rc_channels_msg = true;
 
-		if (channels.chancount > MAX_CHANCNT) {
+		size_t chancount = channels.chancount;
+		if (chancount > MAX_CHANCNT) {
 			RCUTILS_LOG_WARN_THROTTLE_NAMED(,60, "rc",
-						"FCU receives %u RC channels, but RC_CHANNELS can store %zu",
-						channels.chancount, MAX_CHANCNT);
+						"FCU receives %zu RC channels, but RC_CHANNELS can store %zu",
+						chancount, MAX_CHANCNT);
 
-			channels.chancount = MAX_CHANCNT;
+			chancount = MAX_CHANCNT;
 		}
 
-		raw_rc_in.resize(channels.chancount);
+		raw_rc_in.resize(chancount);
 
 		// switch works as start point selector.
-		switch (channels.chancount) {
+		switch (chancount) {
 		// [[[cog:
 		// for i in range(18, 0, -1):
 		//     cog.outl("case %2d: raw_rc_in[%2d] = channels.chan%d_raw;" % (i, i - 1, i))
@@ -156,10 +189,11 @@ private:
 		rcin_msg->rssi = channels.rssi;
 		rcin_msg->channels = raw_rc_in;
 
-		rc_in_pub->publish(*rcin_msg);
+		if (rc_in_sched.update(0.0))
+			rc_in_pub->publish(*rcin_msg);
 	}
 
-	void handle_servo_output_raw(const mavlink::mavlink_message_t *msg, mavlink::common::msg::SERVO_OUTPUT_RAW &port)
+	void handle_servo_output_raw(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::SERVO_OUTPUT_RAW &port)
 	{
 		lock_guard lock(mutex);
 
@@ -249,11 +283,47 @@ private:
 		ovr.chan8_raw = req->channels[7];
 		// [[[end]]] (checksum: bd27f3e85f5ab614ce1332ae3f4c6ebd)
 
-		UAS_FCU(m_uas)->send_message_ignore_drop(ovr);
+		lock_guard lock(override_mutex);
+
+		// largest channel change from last sent, release and no change values also count
+		double change = 0.0;
+		for (size_t i = 0; i < sent_channels.size(); i++)
+			change = std::max(change, std::abs(double(req->channels[i]) - sent_channels[i]));
+
+		last_override = ovr;
+		if (override_sched.update(change))
+			send_override();
+	}
+
+	void override_timer_cb()
+	{
+		lock_guard lock(override_mutex);
+		if (override_sched.tick())
+			send_override();
+	}
+
+	//! override_mutex should be locked
+	void send_override()
+	{
+		// [[[cog:
+		// for i in range(1, 9):
+		//     cog.outl("sent_channels[%d] = last_override.chan%d_raw;" % (i - 1, i))
+		// ]]]
+		sent_channels[0] = last_override.chan1_raw;
+		sent_channels[1] = last_override.chan2_raw;
+		sent_channels[2] = last_override.chan3_raw;
+		sent_channels[3] = last_override.chan4_raw;
+		sent_channels[4] = last_override.chan5_raw;
+		sent_channels[5] = last_override.chan6_raw;
+		sent_channels[6] = last_override.chan7_raw;
+		sent_channels[7] = last_override.chan8_raw;
+		// [[[end]]] (checksum: 966d7ac22cded596bf0a420dbe8235b4)
+
+		UAS_FCU(m_uas)->send_message_ignore_drop(last_override);
 	}
 };
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::RCIOPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(rc_io, mavros::std_plugins::RCIOPlugin)
@@ -86,7 +86,7 @@ private:
 	rclcpp::Publisher<>::SharedPtr safetyarea_pub;
 
 	/* -*- rx handlers -*- */
-	void handle_safety_allowed_area(const mavlink::mavlink_message_t *msg, mavlink::common::msg::SAFETY_ALLOWED_AREA &saa)
+	void handle_safety_allowed_area(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::SAFETY_ALLOWED_AREA &saa)
 	{
 		auto saa_msg = std::make_shared<geometry_msgs::msg::PolygonStamped>();
 
@@ -174,5 +174,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::SafetyAreaPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(safety_area, mavros::std_plugins::SafetyAreaPlugin)
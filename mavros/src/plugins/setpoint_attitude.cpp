@@ -64,6 +64,14 @@ public:
 		sp_nh.param<std::string>("tf/child_frame_id", tf_child_frame_id, "target_attitude");
 		sp_nh.param("tf/rate_limit", tf_rate, 50.0);
 
+		// stream params
+		double stream_rate, stream_timeout;
+		std::string stream_hold;
+		sp_nh.param("stream/rate", stream_rate, 0.0);
+		sp_nh.param("stream/timeout", stream_timeout, 0.5);
+		sp_nh.param<std::string>("stream/hold", stream_hold, "brake");
+		attitude_stream.start(m_uas, "Setpoint attitude", stream_rate, stream_timeout, stream_hold);
+
 		// thrust msg subscriber to sync
 		th_sub.subscribe(sp_nh, "thrust", 1);
 
@@ -218,5 +226,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::SetpointAttitudePlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(setpoint_attitude, mavros::std_plugins::SetpointAttitudePlugin)
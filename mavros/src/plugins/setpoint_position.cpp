@@ -81,6 +81,15 @@ public:
 		} else {
 			mav_frame = utils::mav_frame_from_str(mav_frame_str);
 		}
+
+		// stream params
+		double stream_rate, stream_timeout;
+		std::string stream_hold;
+		sp_nh.param("stream/rate", stream_rate, 0.0);
+		sp_nh.param("stream/timeout", stream_timeout, 0.5);
+		sp_nh.param<std::string>("stream/hold", stream_hold, "brake");
+		local_ned_stream.start(m_uas, "Setpoint position local", stream_rate, stream_timeout, stream_hold);
+		global_int_stream.start(m_uas, "Setpoint position global", stream_rate, stream_timeout, stream_hold);
 	}
 
 	Subscriptions get_subscriptions()
@@ -294,5 +303,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::SetpointPositionPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(setpoint_position, mavros::std_plugins::SetpointPositionPlugin)
@@ -16,6 +16,7 @@
 
 #include <mavros/mavros_plugin.h>
 #include <mavros/setpoint_mixin.h>
+#include <tf2_eigen/tf2_eigen.h>
 
 #include <mavros_msgs/msg/attitude_target.hpp>
 #include <mavros_msgs/msg/position_target.hpp>
@@ -35,21 +36,37 @@ class SetpointRawPlugin : public plugin::PluginBase,
 	private plugin::SetAttitudeTargetMixin<SetpointRawPlugin> {
 public:
 	SetpointRawPlugin() : PluginBase(),
-		sp_nh("~setpoint_raw")
+		has_thrust_scaling(false),
+		thrust_scaling(1.0)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
 
-		bool tf_listen;
+		sp_nh = uas_.mavros_node->create_sub_node("setpoint_raw");
 
-		local_sub = sp_nh->create_subscription("local", 10, std::bind(&SetpointRawPlugin, this, std::placeholders::_1));
-		global_sub = sp_nh->create_subscription("global", 10, std::bind(&SetpointRawPlugin, this, std::placeholders::_1));
-		attitude_sub = sp_nh->create_subscription("attitude", 10, std::bind(&SetpointRawPlugin, this, std::placeholders::_1));
+		// no default: thrust of attitude target is ignored until scaling is set
+		sp_nh->declare_parameter("setpoint_raw/thrust_scaling", rclcpp::ParameterValue());
+		has_thrust_scaling = sp_nh->get_parameter("setpoint_raw/thrust_scaling", thrust_scaling);
+
+		local_sub = sp_nh->create_subscription<mavros_msgs::msg::PositionTarget>("local", 10,
+			std::bind(&SetpointRawPlugin::local_cb, this, std::placeholders::_1));
+		global_sub = sp_nh->create_subscription<mavros_msgs::msg::GlobalPositionTarget>("global", 10,
+			std::bind(&SetpointRawPlugin::global_cb, this, std::placeholders::_1));
+		attitude_sub = sp_nh->create_subscription<mavros_msgs::msg::AttitudeTarget>("attitude", 10,
+			std::bind(&SetpointRawPlugin::attitude_cb, this, std::placeholders::_1));
 		target_local_pub = sp_nh->create_publisher<mavros_msgs::msg::PositionTarget>("target_local", 10);
 		target_global_pub = sp_nh->create_publisher<mavros_msgs::msg::GlobalPositionTarget>("target_global", 10);
 		target_attitude_pub = sp_nh->create_publisher<mavros_msgs::msg::AttitudeTarget>("target_attitude", 10);
+
+		// stream params
+		auto stream_rate = sp_nh->declare_parameter("setpoint_raw/stream/rate", 0.0);
+		auto stream_timeout = sp_nh->declare_parameter("setpoint_raw/stream/timeout", 0.5);
+		auto stream_hold = sp_nh->declare_parameter<std::string>("setpoint_raw/stream/hold", "brake");
+		local_ned_stream.start(m_uas, "Setpoint raw local", stream_rate, stream_timeout, stream_hold);
+		global_int_stream.start(m_uas, "Setpoint raw global", stream_rate, stream_timeout, stream_hold);
+		attitude_stream.start(m_uas, "Setpoint raw attitude", stream_rate, stream_timeout, stream_hold);
 	}
 
 	Subscriptions get_subscriptions()
@@ -62,16 +79,23 @@ public:
 	}
 
 private:
-	friend class SetPositionTargetLocalNEDMixin;
-	friend class SetPositionTargetGlobalIntMixin;
-	friend class SetAttitudeTargetMixin;
+	friend class plugin::SetPositionTargetLocalNEDMixin<SetpointRawPlugin>;
+	friend class plugin::SetPositionTargetGlobalIntMixin<SetpointRawPlugin>;
+	friend class plugin::SetAttitudeTargetMixin<SetpointRawPlugin>;
 	rclcpp::Node::SharedPtr sp_nh;
 
-	rclcpp::Subscription<>::SharedPtr local_sub, global_sub, attitude_sub;
-	rclcpp::Publisher<>::SharedPtr target_local_pub, target_global_pub, target_attitude_pub;
+	rclcpp::Subscription<mavros_msgs::msg::PositionTarget>::SharedPtr local_sub;
+	rclcpp::Subscription<mavros_msgs::msg::GlobalPositionTarget>::SharedPtr global_sub;
+	rclcpp::Subscription<mavros_msgs::msg::AttitudeTarget>::SharedPtr attitude_sub;
+	rclcpp::Publisher<mavros_msgs::msg::PositionTarget>::SharedPtr target_local_pub;
+	rclcpp::Publisher<mavros_msgs::msg::GlobalPositionTarget>::SharedPtr target_global_pub;
+	rclcpp::Publisher<mavros_msgs::msg::AttitudeTarget>::SharedPtr target_attitude_pub;
+
+	bool has_thrust_scaling;
+	double thrust_scaling;
 
 	/* -*- message handlers -*- */
-	void handle_position_target_local_ned(const mavlink::mavlink_message_t *msg, mavlink::common::msg::POSITION_TARGET_LOCAL_NED &tgt)
+	void handle_position_target_local_ned(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::POSITION_TARGET_LOCAL_NED &tgt)
 	{
 		// Transform desired position,velocities,and accels from ENU to NED frame
 		auto position = ftf::transform_frame_ned_enu(Eigen::Vector3d(tgt.x, tgt.y, tgt.z));
@@ -85,21 +109,21 @@ private:
 		auto ang_vel_enu = ftf::transform_frame_ned_enu(ang_vel_ned);
 		float yaw_rate = ang_vel_enu.z();
 
-		auto target = std::make_shared<mavros_msgs::msg::PositionTarget>();
+		mavros_msgs::msg::PositionTarget target{};
 
-		target->header.stamp = m_uas->synchronise_stamp(tgt.time_boot_ms);
-		target->coordinate_frame = tgt.coordinate_frame;
-		target->type_mask = tgt.type_mask;
-		tf2::convert(position, target->position);
-		tf2::convert(velocity, target->velocity);
-		tf2::convert(af, target->acceleration_or_force);
-		target->yaw = yaw;
-		target->yaw_rate = yaw_rate;
+		target.header.stamp = m_uas->synchronise_stamp(tgt.time_boot_ms);
+		target.coordinate_frame = tgt.coordinate_frame;
+		target.type_mask = tgt.type_mask;
+		tf2::convert(position, target.position);
+		tf2::toMsg(velocity, target.velocity);
+		tf2::toMsg(af, target.acceleration_or_force);
+		target.yaw = yaw;
+		target.yaw_rate = yaw_rate;
 
-		target_local_pub.publish(target);
+		target_local_pub->publish(target);
 	}
 
-	void handle_position_target_global_int(const mavlink::mavlink_message_t *msg, mavlink::common::msg::POSITION_TARGET_GLOBAL_INT &tgt)
+	void handle_position_target_global_int(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::POSITION_TARGET_GLOBAL_INT &tgt)
 	{
 		// Transform desired velocities from ENU to NED frame
 		auto velocity = ftf::transform_frame_ned_enu(Eigen::Vector3d(tgt.vx, tgt.vy, tgt.vz));
@@ -112,23 +136,23 @@ private:
 		auto ang_vel_enu = ftf::transform_frame_ned_enu(ang_vel_ned);
 		float yaw_rate = ang_vel_enu.z();
 
-		auto target = std::make_shared<mavros_msgs::msg::GlobalPositionTarget>();
+		mavros_msgs::msg::GlobalPositionTarget target{};
 
-		target->header.stamp = m_uas->synchronise_stamp(tgt.time_boot_ms);
-		target->coordinate_frame = tgt.coordinate_frame;
-		target->type_mask = tgt.type_mask;
-		target->latitude = tgt.lat_int / 1e7;
-		target->longitude = tgt.lon_int / 1e7;
-		target->altitude = tgt.alt;
-		tf2::convert(velocity, target->velocity);
-		tf2::convert(af, target->acceleration_or_force);
-		target->yaw = yaw;
-		target->yaw_rate = yaw_rate;
+		target.header.stamp = m_uas->synchronise_stamp(tgt.time_boot_ms);
+		target.coordinate_frame = tgt.coordinate_frame;
+		target.type_mask = tgt.type_mask;
+		target.latitude = tgt.lat_int / 1e7;
+		target.longitude = tgt.lon_int / 1e7;
+		target.altitude = tgt.alt;
+		tf2::toMsg(velocity, target.velocity);
+		tf2::toMsg(af, target.acceleration_or_force);
+		target.yaw = yaw;
+		target.yaw_rate = yaw_rate;
 
-		target_global_pub.publish(target);
+		target_global_pub->publish(target);
 	}
 
-	void handle_attitude_target(const mavlink::mavlink_message_t *msg, mavlink::common::msg::ATTITUDE_TARGET &tgt)
+	void handle_attitude_target(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::ATTITUDE_TARGET &tgt)
 	{
 		// Transform orientation from baselink -> ENU
 		// to aircraft -> NED
@@ -138,15 +162,15 @@ private:
 
 		auto body_rate = ftf::transform_frame_baselink_aircraft(Eigen::Vector3d(tgt.body_roll_rate, tgt.body_pitch_rate, tgt.body_yaw_rate));
 
-		auto target = std::make_shared<mavros_msgs::msg::AttitudeTarget>();
+		mavros_msgs::msg::AttitudeTarget target{};
 
-		target->header.stamp = m_uas->synchronise_stamp(tgt.time_boot_ms);
-		target->type_mask = tgt.type_mask;
-		tf2::convert(orientation, target->orientation);
-		tf2::convert(body_rate, target->body_rate);
-		target->thrust = tgt.thrust;
+		target.header.stamp = m_uas->synchronise_stamp(tgt.time_boot_ms);
+		target.type_mask = tgt.type_mask;
+		target.orientation = tf2::toMsg(orientation);
+		tf2::toMsg(body_rate, target.body_rate);
+		target.thrust = tgt.thrust;
 
-		target_attitude_pub.publish(target);
+		target_attitude_pub->publish(target);
 	}
 
 	/* -*- callbacks -*- */
@@ -157,8 +181,8 @@ private:
 		float yaw, yaw_rate;
 
 		tf2::convert(req->position, position);
-		tf2::convert(req->velocity, velocity);
-		tf2::convert(req->acceleration_or_force, af);
+		tf2::fromMsg(req->velocity, velocity);
+		tf2::fromMsg(req->acceleration_or_force, af);
 
 		// Transform frame ENU->NED
 		position = ftf::transform_frame_enu_ned(position);
@@ -173,7 +197,7 @@ private:
 		yaw_rate = ang_vel_ned.z();
 
 		set_position_target_local_ned(
-					req->header.stamp.toNSec() / 1000000,
+					rclcpp::Time(req->header.stamp).nanoseconds() / 1000000,
 					req->coordinate_frame,
 					req->type_mask,
 					position,
@@ -187,8 +211,8 @@ private:
 		Eigen::Vector3d velocity, af;
 		float yaw, yaw_rate;
 
-		tf2::convert(req->velocity, velocity);
-		tf2::convert(req->acceleration_or_force, af);
+		tf2::fromMsg(req->velocity, velocity);
+		tf2::fromMsg(req->acceleration_or_force, af);
 
 		// Transform frame ENU->NED
 		velocity = ftf::transform_frame_enu_ned(velocity);
@@ -202,7 +226,7 @@ private:
 		yaw_rate = ang_vel_ned.z();
 
 		set_position_target_global_int(
-					req->header.stamp.toNSec() / 1000000,
+					rclcpp::Time(req->header.stamp).nanoseconds() / 1000000,
 					req->coordinate_frame,
 					req->type_mask,
 					req->latitude * 1e7,
@@ -215,7 +239,6 @@ private:
 
 	void attitude_cb(const mavros_msgs::msg::AttitudeTarget::SharedPtr req)
 	{
-		double thrust_scaling;
 		Eigen::Quaterniond desired_orientation;
 		Eigen::Vector3d baselink_angular_rate;
 		Eigen::Vector3d body_rate;
@@ -223,17 +246,17 @@ private:
 
 		// Set Thrust scaling in px4_config.yaml, setpoint_raw block.
 		// ignore thrust is false by default, unless no thrust scalling is set or thrust is zero
-		auto ignore_thrust = req->thrust != 0.0 && !sp_nh.getParam("thrust_scaling", thrust_scaling);
+		auto ignore_thrust = req->thrust != 0.0 && !has_thrust_scaling;
 
 		if (ignore_thrust) {
 			// I believe it's safer without sending zero thrust, but actually ignoring the actuation.
-			ROS_FATAL_THROTTLE_NAMED(5, "setpoint_raw", "Recieved thrust, but ignore_thrust is true: "
+			RCUTILS_LOG_FATAL_THROTTLE_NAMED(RCUTILS_STEADY_TIME, 5000, "setpoint_raw", "Recieved thrust, but ignore_thrust is true: "
 				"the most likely cause of this is a failure to specify the thrust_scaling parameters "
 				"on px4/apm_config.yaml. Actuation will be ignored.");
 			return;
 		} else {
 			if (thrust_scaling == 0.0) {
-				RCUTILS_LOG_WARN_THROTTLE_NAMED(,5, "setpoint_raw", "thrust_scaling parameter is set to zero.");
+				RCUTILS_LOG_WARN_THROTTLE_NAMED(RCUTILS_STEADY_TIME, 5000, "setpoint_raw", "thrust_scaling parameter is set to zero.");
 			}
 			thrust = std::min(1.0, std::max(0.0, req->thrust * thrust_scaling));
 		}
@@ -250,7 +273,7 @@ private:
 			ftf::to_eigen(req->body_rate));
 
 		set_attitude_target(
-					req->header.stamp.toNSec() / 1000000,
+					rclcpp::Time(req->header.stamp).nanoseconds() / 1000000,
 					req->type_mask,
 					ned_desired_orientation,
 					body_rate,
@@ -261,5 +284,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::SetpointRawPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(setpoint_raw, mavros::std_plugins::SetpointRawPlugin)
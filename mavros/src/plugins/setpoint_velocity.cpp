@@ -17,11 +17,12 @@
 
 #include <mavros/mavros_plugin.h>
 #include <mavros/setpoint_mixin.h>
+#include <tf2_eigen/tf2_eigen.h>
 
 #include <geometry_msgs/msg/twist_stamped.hpp>
 #include <geometry_msgs/msg/twist.hpp>
 
-#include <mavros_msgs/msg/set_mav_frame.hpp>
+#include <mavros_msgs/srv/set_mav_frame.hpp>
 
 namespace mavros {
 namespace std_plugins {
@@ -35,25 +36,32 @@ class SetpointVelocityPlugin : public plugin::PluginBase,
 	private plugin::SetPositionTargetLocalNEDMixin<SetpointVelocityPlugin> {
 public:
 	SetpointVelocityPlugin() : PluginBase(),
-		sp_nh("~setpoint_velocity")
+		mav_frame(MAV_FRAME::LOCAL_NED)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
 
-		//cmd_vel usually is the topic used for velocity control in many controllers / planners
-		vel_sub = sp_nh->create_subscription("cmd_vel", 10, std::bind(&SetpointVelocityPlugin, this, std::placeholders::_1));
-		vel_unstamped_sub = sp_nh->create_subscription("cmd_vel_unstamped", 10, std::bind(&SetpointVelocityPlugin, this, std::placeholders::_1));
-		mav_frame_srv = sp_nh->create_service("mav_frame", std::bind(&SetpointVelocityPlugin, this, std::placeholders::_1));
+		sp_nh = uas_.mavros_node->create_sub_node("setpoint_velocity");
 
 		// mav_frame
-		std::string mav_frame_str;
-		if (!sp_nh.getParam("mav_frame", mav_frame_str)) {
-			mav_frame = MAV_FRAME::LOCAL_NED;
-		} else {
-			mav_frame = utils::mav_frame_from_str(mav_frame_str);
-		}
+		auto mav_frame_str = sp_nh->declare_parameter<std::string>("setpoint_velocity/mav_frame", "LOCAL_NED");
+		mav_frame = utils::mav_frame_from_str(mav_frame_str);
+
+		//cmd_vel usually is the topic used for velocity control in many controllers / planners
+		vel_sub = sp_nh->create_subscription<geometry_msgs::msg::TwistStamped>("cmd_vel", 10,
+			std::bind(&SetpointVelocityPlugin::vel_cb, this, std::placeholders::_1));
+		vel_unstamped_sub = sp_nh->create_subscription<geometry_msgs::msg::Twist>("cmd_vel_unstamped", 10,
+			std::bind(&SetpointVelocityPlugin::vel_unstamped_cb, this, std::placeholders::_1));
+		mav_frame_srv = sp_nh->create_service<mavros_msgs::srv::SetMavFrame>("mav_frame",
+			std::bind(&SetpointVelocityPlugin::set_mav_frame_cb, this, std::placeholders::_1, std::placeholders::_2));
+
+		// stream params
+		auto stream_rate = sp_nh->declare_parameter("setpoint_velocity/stream/rate", 0.0);
+		auto stream_timeout = sp_nh->declare_parameter("setpoint_velocity/stream/timeout", 0.5);
+		auto stream_hold = sp_nh->declare_parameter<std::string>("setpoint_velocity/stream/hold", "brake");
+		local_ned_stream.start(m_uas, "Setpoint velocity", stream_rate, stream_timeout, stream_hold);
 	}
 
 	Subscriptions get_subscriptions()
@@ -62,12 +70,12 @@ public:
 	}
 
 private:
-	friend class SetPositionTargetLocalNEDMixin;
+	friend class plugin::SetPositionTargetLocalNEDMixin<SetpointVelocityPlugin>;
 	rclcpp::Node::SharedPtr sp_nh;
 
-	rclcpp::Subscription<>::SharedPtr vel_sub;
-	rclcpp::Subscription<>::SharedPtr vel_unstamped_sub;
-	rclcpp::Service<>::SharedPtr mav_frame_srv;
+	rclcpp::Subscription<geometry_msgs::msg::TwistStamped>::SharedPtr vel_sub;
+	rclcpp::Subscription<geometry_msgs::msg::Twist>::SharedPtr vel_unstamped_sub;
+	rclcpp::Service<mavros_msgs::srv::SetMavFrame>::SharedPtr mav_frame_srv;
 
 	MAV_FRAME mav_frame;
 
@@ -101,7 +109,7 @@ private:
 			}
 		} ();
 
-		set_position_target_local_ned(stamp.toNSec() / 1000000,
+		set_position_target_local_ned(stamp.nanoseconds() / 1000000,
 					utils::enum_value(mav_frame),
 					ignore_all_except_v_xyz_yr,
 					Eigen::Vector3d::Zero(),
@@ -115,7 +123,7 @@ private:
 	void vel_cb(const geometry_msgs::msg::TwistStamped::SharedPtr req) {
 		Eigen::Vector3d vel_enu;
 
-		tf2::convert(req->twist.linear, vel_enu);
+		tf2::fromMsg(req->twist.linear, vel_enu);
 		send_setpoint_velocity(req->header.stamp, vel_enu,
 					req->twist.angular.z);
 	}
@@ -123,22 +131,22 @@ private:
 	void vel_unstamped_cb(const geometry_msgs::msg::Twist::SharedPtr req) {
 		Eigen::Vector3d vel_enu;
 
-		tf2::convert(req->linear, vel_enu);
-		send_setpoint_velocity(rclcpp::Time::now(), vel_enu,
+		tf2::fromMsg(req->linear, vel_enu);
+		send_setpoint_velocity(sp_nh->now(), vel_enu,
 					req->angular.z);
 	}
 
-	bool set_mav_frame_cb(mavros_msgs::msg::SetMavFrame::Request::SharedPtr req, mavros_msgs::msg::SetMavFrame::Response::SharedPtr res)
+	void set_mav_frame_cb(const mavros_msgs::srv::SetMavFrame::Request::SharedPtr req,
+			mavros_msgs::srv::SetMavFrame::Response::SharedPtr res)
 	{
-		mav_frame = static_cast<MAV_FRAME>(req.mav_frame);
+		mav_frame = static_cast<MAV_FRAME>(req->mav_frame);
 		const std::string mav_frame_str = utils::to_string(mav_frame);
-		sp_nh.setParam("mav_frame", mav_frame_str);
-		res.success = true;
-		return true;
+		sp_nh->set_parameter(rclcpp::Parameter("setpoint_velocity/mav_frame", mav_frame_str));
+		res->success = true;
 	}
 };
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::SetpointVelocityPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(setpoint_velocity, mavros::std_plugins::SetpointVelocityPlugin)
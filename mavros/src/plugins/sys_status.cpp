@@ -15,6 +15,9 @@
  */
 
 #include <mavros/mavros_plugin.h>
+#include <mavros/diagnostic_cache.h>
+#include <mavros/seqlock.h>
+#include <mavros/statustext_assembler.h>
 
 #include <mavros_msgs/msg/state.hpp>
 #include <mavros_msgs/msg/extended_state.hpp>
@@ -53,15 +56,14 @@ public:
 	HeartbeatStatus(const std::string &name, size_t win_size) :
 		diagnostic_updater::DiagnosticTask(name),
 		clock_(),
+		count_(0),
 		times_(win_size),
 		seq_nums_(win_size),
 		window_size_(win_size),
 		min_freq_(0.2),
 		max_freq_(100),
 		tolerance_(0.1),
-		autopilot(MAV_AUTOPILOT::GENERIC),
-		type(MAV_TYPE::GENERIC),
-		system_status(MAV_STATE::UNINIT)
+		info(Info { MAV_TYPE::GENERIC, MAV_AUTOPILOT::GENERIC, MAV_STATE::UNINIT, {} })
 	{
 		clear();
 	}
@@ -74,22 +76,23 @@ public:
 
 		for (size_t i = 0; i < window_size_; i++) {
 			times_[i] = curtime;
-			seq_nums_[i] = count_;
+			seq_nums_[i] = 0;
 		}
 
 		hist_indx_ = 0;
 	}
 
 	void tick(uint8_t type_, uint8_t autopilot_,
-			std::string &mode_, uint8_t system_status_)
+			const std::string &mode_, uint8_t system_status_)
 	{
-		std::lock_guard<std::mutex> lock(mutex);
-		count_++;
-
-		type = static_cast<MAV_TYPE>(type_);
-		autopilot = static_cast<MAV_AUTOPILOT>(autopilot_);
-		mode = mode_;
-		system_status = static_cast<MAV_STATE>(system_status_);
+		Info i {};
+		i.type = static_cast<MAV_TYPE>(type_);
+		i.autopilot = static_cast<MAV_AUTOPILOT>(autopilot_);
+		i.system_status = static_cast<MAV_STATE>(system_status_);
+		mode_.copy(i.mode.data(), i.mode.size() - 1);
+
+		info.store(i);
+		count_.fetch_add(1, std::memory_order_relaxed);
 	}
 
 	void run(diagnostic_updater::DiagnosticStatusWrapper &stat)
@@ -118,30 +121,44 @@ public:
 			stat.summary(0, "Normal");
 		}
 
-		stat.addf("Heartbeats since startup", "%d", count_);
+		stat.addf("Heartbeats since startup", "%d", curseq);
 		stat.addf("Frequency (Hz)", "%f", freq);
-		stat.add("Vehicle type", utils::to_string(type));
-		stat.add("Autopilot type", utils::to_string(autopilot));
-		stat.add("Mode", mode);
-		stat.add("System status", utils::to_string(system_status));
+
+		info_cache.add(stat, info.load(), [](diagnostic_updater::DiagnosticStatusWrapper &stat, const Info &i) {
+			stat.add("Vehicle type", utils::to_string(i.type));
+			stat.add("Autopilot type", utils::to_string(i.autopilot));
+			stat.add("Mode", i.mode.data());
+			stat.add("System status", utils::to_string(i.system_status));
+		});
 	}
 
 private:
+	//! Last HEARTBEAT data, mode is zero terminated
+	struct Info {
+		MAV_TYPE type;
+		MAV_AUTOPILOT autopilot;
+		MAV_STATE system_status;
+		std::array<char, 32> mode;
+
+		bool operator==(const Info &other) const {
+			return type == other.type && autopilot == other.autopilot &&
+			       system_status == other.system_status && mode == other.mode;
+		}
+	};
+
 	rclcpp::Clock clock_;
-	int count_;
+	std::atomic<int> count_;
 	std::vector<rclcpp::Time> times_;
 	std::vector<int> seq_nums_;
 	int hist_indx_;
-	std::mutex mutex;
+	std::mutex mutex;	//!< guards window, taken by clear() and run() only
 	const size_t window_size_;
 	const double min_freq_;
 	const double max_freq_;
 	const double tolerance_;
 
-	MAV_AUTOPILOT autopilot;
-	MAV_TYPE type;
-	std::string mode;
-	MAV_STATE system_status;
+	SeqLock<Info> info;
+	DiagnosticCache<Info> info_cache;
 };
 
 
@@ -153,123 +170,162 @@ class SystemStatusDiag : public diagnostic_updater::DiagnosticTask
 public:
 	SystemStatusDiag(const std::string &name) :
 		diagnostic_updater::DiagnosticTask(name),
-		last_st {}
+		last_status(Status {})
 	{ }
 
-	void set(mavlink::common::msg::SYS_STATUS &st)
+	void set(const mavlink::common::msg::SYS_STATUS &st)
 	{
-		std::lock_guard<std::mutex> lock(mutex);
-		last_st = st;
+		Status s {};
+		s.sensors.onboard_control_sensors_present = st.onboard_control_sensors_present;
+		s.sensors.onboard_control_sensors_enabled = st.onboard_control_sensors_enabled;
+		s.sensors.onboard_control_sensors_health = st.onboard_control_sensors_health;
+		s.load = st.load;
+		s.drop_rate_comm = st.drop_rate_comm;
+		s.errors_comm = st.errors_comm;
+		s.errors_count1 = st.errors_count1;
+		s.errors_count2 = st.errors_count2;
+		s.errors_count3 = st.errors_count3;
+		s.errors_count4 = st.errors_count4;
+
+		last_status.store(s);
 	}
 
 	void run(diagnostic_updater::DiagnosticStatusWrapper &stat) {
-		std::lock_guard<std::mutex> lock(mutex);
-
-		if ((last_st.onboard_control_sensors_health & last_st.onboard_control_sensors_enabled)
-				!= last_st.onboard_control_sensors_enabled)
-			stat.summary(2, "Sensor health");
-		else
-			stat.summary(0, "Normal");
-
-		stat.addf("Sensor present", "0x%08X", last_st.onboard_control_sensors_present);
-		stat.addf("Sensor enabled", "0x%08X", last_st.onboard_control_sensors_enabled);
-		stat.addf("Sensor health", "0x%08X", last_st.onboard_control_sensors_health);
-
-		using STS = mavlink::common::MAV_SYS_STATUS_SENSOR;
-
-		// [[[cog:
-		// import pymavlink.dialects.v20.common as common
-		// ename = 'MAV_SYS_STATUS_SENSOR'
-		// ename_pfx2 = 'MAV_SYS_STATUS_'
-		//
-		// enum = sorted(common.enums[ename].items())
-		// enum.pop() # -> remove ENUM_END
-		//
-		// for k, e in enum:
-		//     desc = e.description.split(' ', 1)[1] if e.description.startswith('0x') else e.description
-		//     sts = e.name
-		//
-		//     if sts.startswith(ename + '_'):
-		//         sts = sts[len(ename) + 1:]
-		//     if sts.startswith(ename_pfx2):
-		//         sts = sts[len(ename_pfx2):]
-		//     if sts[0].isdigit():
-		//         sts = 'SENSOR_' + sts
-		//
-		//     cog.outl(f"""\
-		//     if (last_st.onboard_control_sensors_enabled & enum_value(STS::{sts}))
-		//     \tstat.add("{desc.strip()}", (last_st.onboard_control_sensors_health & enum_value(STS::{sts})) ? "Ok" : "Fail");""")
-		// ]]]
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::SENSOR_3D_GYRO))
-			stat.add("3D gyro", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_GYRO)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::SENSOR_3D_ACCEL))
-			stat.add("3D accelerometer", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_ACCEL)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::SENSOR_3D_MAG))
-			stat.add("3D magnetometer", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_MAG)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::ABSOLUTE_PRESSURE))
-			stat.add("absolute pressure", (last_st.onboard_control_sensors_health & enum_value(STS::ABSOLUTE_PRESSURE)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::DIFFERENTIAL_PRESSURE))
-			stat.add("differential pressure", (last_st.onboard_control_sensors_health & enum_value(STS::DIFFERENTIAL_PRESSURE)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::GPS))
-			stat.add("GPS", (last_st.onboard_control_sensors_health & enum_value(STS::GPS)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::OPTICAL_FLOW))
-			stat.add("optical flow", (last_st.onboard_control_sensors_health & enum_value(STS::OPTICAL_FLOW)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::VISION_POSITION))
-			stat.add("computer vision position", (last_st.onboard_control_sensors_health & enum_value(STS::VISION_POSITION)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::LASER_POSITION))
-			stat.add("laser based position", (last_st.onboard_control_sensors_health & enum_value(STS::LASER_POSITION)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::EXTERNAL_GROUND_TRUTH))
-			stat.add("external ground truth (Vicon or Leica)", (last_st.onboard_control_sensors_health & enum_value(STS::EXTERNAL_GROUND_TRUTH)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::ANGULAR_RATE_CONTROL))
-			stat.add("3D angular rate control", (last_st.onboard_control_sensors_health & enum_value(STS::ANGULAR_RATE_CONTROL)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::ATTITUDE_STABILIZATION))
-			stat.add("attitude stabilization", (last_st.onboard_control_sensors_health & enum_value(STS::ATTITUDE_STABILIZATION)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::YAW_POSITION))
-			stat.add("yaw position", (last_st.onboard_control_sensors_health & enum_value(STS::YAW_POSITION)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::Z_ALTITUDE_CONTROL))
-			stat.add("z/altitude control", (last_st.onboard_control_sensors_health & enum_value(STS::Z_ALTITUDE_CONTROL)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::XY_POSITION_CONTROL))
-			stat.add("x/y position control", (last_st.onboard_control_sensors_health & enum_value(STS::XY_POSITION_CONTROL)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::MOTOR_OUTPUTS))
-			stat.add("motor outputs / control", (last_st.onboard_control_sensors_health & enum_value(STS::MOTOR_OUTPUTS)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::RC_RECEIVER))
-			stat.add("rc receiver", (last_st.onboard_control_sensors_health & enum_value(STS::RC_RECEIVER)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::SENSOR_3D_GYRO2))
-			stat.add("2nd 3D gyro", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_GYRO2)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::SENSOR_3D_ACCEL2))
-			stat.add("2nd 3D accelerometer", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_ACCEL2)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::SENSOR_3D_MAG2))
-			stat.add("2nd 3D magnetometer", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_MAG2)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::GEOFENCE))
-			stat.add("geofence", (last_st.onboard_control_sensors_health & enum_value(STS::GEOFENCE)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::AHRS))
-			stat.add("AHRS subsystem health", (last_st.onboard_control_sensors_health & enum_value(STS::AHRS)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::TERRAIN))
-			stat.add("Terrain subsystem health", (last_st.onboard_control_sensors_health & enum_value(STS::TERRAIN)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::REVERSE_MOTOR))
-			stat.add("Motors are reversed", (last_st.onboard_control_sensors_health & enum_value(STS::REVERSE_MOTOR)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::LOGGING))
-			stat.add("Logging", (last_st.onboard_control_sensors_health & enum_value(STS::LOGGING)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::BATTERY))
-			stat.add("Battery", (last_st.onboard_control_sensors_health & enum_value(STS::BATTERY)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::PROXIMITY))
-			stat.add("Proximity", (last_st.onboard_control_sensors_health & enum_value(STS::PROXIMITY)) ? "Ok" : "Fail");
-		if (last_st.onboard_control_sensors_enabled & enum_value(STS::SATCOM))
-			stat.add("Satellite Communication", (last_st.onboard_control_sensors_health & enum_value(STS::SATCOM)) ? "Ok" : "Fail");
-		// [[[end]]] (checksum: 890cfdc6d3b776c38a59b39f80ec7351)
-
-		stat.addf("CPU Load (%)", "%.1f", last_st.load / 10.0);
-		stat.addf("Drop rate (%)", "%.1f", last_st.drop_rate_comm / 10.0);
-		stat.addf("Errors comm", "%d", last_st.errors_comm);
-		stat.addf("Errors count #1", "%d", last_st.errors_count1);
-		stat.addf("Errors count #2", "%d", last_st.errors_count2);
-		stat.addf("Errors count #3", "%d", last_st.errors_count3);
-		stat.addf("Errors count #4", "%d", last_st.errors_count4);
+		auto st = last_status.load();
+
+		// sensor bits change rarely, so their entries are reused
+		sensors_cache.add(stat, st.sensors, [](diagnostic_updater::DiagnosticStatusWrapper &stat, const Sensors &last_st) {
+			if ((last_st.onboard_control_sensors_health & last_st.onboard_control_sensors_enabled)
+					!= last_st.onboard_control_sensors_enabled)
+				stat.summary(2, "Sensor health");
+			else
+				stat.summary(0, "Normal");
+
+			stat.addf("Sensor present", "0x%08X", last_st.onboard_control_sensors_present);
+			stat.addf("Sensor enabled", "0x%08X", last_st.onboard_control_sensors_enabled);
+			stat.addf("Sensor health", "0x%08X", last_st.onboard_control_sensors_health);
+
+			using STS = mavlink::common::MAV_SYS_STATUS_SENSOR;
+
+			// [[[cog:
+			// import pymavlink.dialects.v20.common as common
+			// ename = 'MAV_SYS_STATUS_SENSOR'
+			// ename_pfx2 = 'MAV_SYS_STATUS_'
+			//
+			// enum = sorted(common.enums[ename].items())
+			// enum.pop() # -> remove ENUM_END
+			//
+			// for k, e in enum:
+			//     desc = e.description.split(' ', 1)[1] if e.description.startswith('0x') else e.description
+			//     sts = e.name
+			//
+			//     if sts.startswith(ename + '_'):
+			//         sts = sts[len(ename) + 1:]
+			//     if sts.startswith(ename_pfx2):
+			//         sts = sts[len(ename_pfx2):]
+			//     if sts[0].isdigit():
+			//         sts = 'SENSOR_' + sts
+			//
+			//     cog.outl(f"""\
+			//     if (last_st.onboard_control_sensors_enabled & enum_value(STS::{sts}))
+			//     \tstat.add("{desc.strip()}", (last_st.onboard_control_sensors_health & enum_value(STS::{sts})) ? "Ok" : "Fail");""")
+			// ]]]
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::SENSOR_3D_GYRO))
+				stat.add("3D gyro", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_GYRO)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::SENSOR_3D_ACCEL))
+				stat.add("3D accelerometer", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_ACCEL)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::SENSOR_3D_MAG))
+				stat.add("3D magnetometer", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_MAG)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::ABSOLUTE_PRESSURE))
+				stat.add("absolute pressure", (last_st.onboard_control_sensors_health & enum_value(STS::ABSOLUTE_PRESSURE)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::DIFFERENTIAL_PRESSURE))
+				stat.add("differential pressure", (last_st.onboard_control_sensors_health & enum_value(STS::DIFFERENTIAL_PRESSURE)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::GPS))
+				stat.add("GPS", (last_st.onboard_control_sensors_health & enum_value(STS::GPS)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::OPTICAL_FLOW))
+				stat.add("optical flow", (last_st.onboard_control_sensors_health & enum_value(STS::OPTICAL_FLOW)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::VISION_POSITION))
+				stat.add("computer vision position", (last_st.onboard_control_sensors_health & enum_value(STS::VISION_POSITION)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::LASER_POSITION))
+				stat.add("laser based position", (last_st.onboard_control_sensors_health & enum_value(STS::LASER_POSITION)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::EXTERNAL_GROUND_TRUTH))
+				stat.add("external ground truth (Vicon or Leica)", (last_st.onboard_control_sensors_health & enum_value(STS::EXTERNAL_GROUND_TRUTH)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::ANGULAR_RATE_CONTROL))
+				stat.add("3D angular rate control", (last_st.onboard_control_sensors_health & enum_value(STS::ANGULAR_RATE_CONTROL)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::ATTITUDE_STABILIZATION))
+				stat.add("attitude stabilization", (last_st.onboard_control_sensors_health & enum_value(STS::ATTITUDE_STABILIZATION)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::YAW_POSITION))
+				stat.add("yaw position", (last_st.onboard_control_sensors_health & enum_value(STS::YAW_POSITION)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::Z_ALTITUDE_CONTROL))
+				stat.add("z/altitude control", (last_st.onboard_control_sensors_health & enum_value(STS::Z_ALTITUDE_CONTROL)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::XY_POSITION_CONTROL))
+				stat.add("x/y position control", (last_st.onboard_control_sensors_health & enum_value(STS::XY_POSITION_CONTROL)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::MOTOR_OUTPUTS))
+				stat.add("motor outputs / control", (last_st.onboard_control_sensors_health & enum_value(STS::MOTOR_OUTPUTS)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::RC_RECEIVER))
+				stat.add("rc receiver", (last_st.onboard_control_sensors_health & enum_value(STS::RC_RECEIVER)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::SENSOR_3D_GYRO2))
+				stat.add("2nd 3D gyro", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_GYRO2)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::SENSOR_3D_ACCEL2))
+				stat.add("2nd 3D accelerometer", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_ACCEL2)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::SENSOR_3D_MAG2))
+				stat.add("2nd 3D magnetometer", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_MAG2)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::GEOFENCE))
+				stat.add("geofence", (last_st.onboard_control_sensors_health & enum_value(STS::GEOFENCE)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::AHRS))
+				stat.add("AHRS subsystem health", (last_st.onboard_control_sensors_health & enum_value(STS::AHRS)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::TERRAIN))
+				stat.add("Terrain subsystem health", (last_st.onboard_control_sensors_health & enum_value(STS::TERRAIN)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::REVERSE_MOTOR))
+				stat.add("Motors are reversed", (last_st.onboard_control_sensors_health & enum_value(STS::REVERSE_MOTOR)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::LOGGING))
+				stat.add("Logging", (last_st.onboard_control_sensors_health & enum_value(STS::LOGGING)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::BATTERY))
+				stat.add("Battery", (last_st.onboard_control_sensors_health & enum_value(STS::BATTERY)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::PROXIMITY))
+				stat.add("Proximity", (last_st.onboard_control_sensors_health & enum_value(STS::PROXIMITY)) ? "Ok" : "Fail");
+			if (last_st.onboard_control_sensors_enabled & enum_value(STS::SATCOM))
+				stat.add("Satellite Communication", (last_st.onboard_control_sensors_health & enum_value(STS::SATCOM)) ? "Ok" : "Fail");
+			// [[[end]]] (checksum: d02a028aa00e147046e9ab1b6fba1e05)
+		});
+
+		stat.addf("CPU Load (%)", "%.1f", st.load / 10.0);
+		stat.addf("Drop rate (%)", "%.1f", st.drop_rate_comm / 10.0);
+		stat.addf("Errors comm", "%d", st.errors_comm);
+		stat.addf("Errors count #1", "%d", st.errors_count1);
+		stat.addf("Errors count #2", "%d", st.errors_count2);
+		stat.addf("Errors count #3", "%d", st.errors_count3);
+		stat.addf("Errors count #4", "%d", st.errors_count4);
 	}
 
 private:
-	std::mutex mutex;
-	mavlink::common::msg::SYS_STATUS last_st;
+	//! SYS_STATUS sensor bitmasks, same field names as in message
+	struct Sensors {
+		uint32_t onboard_control_sensors_present;
+		uint32_t onboard_control_sensors_enabled;
+		uint32_t onboard_control_sensors_health;
+
+		bool operator==(const Sensors &other) const {
+			return onboard_control_sensors_present == other.onboard_control_sensors_present &&
+			       onboard_control_sensors_enabled == other.onboard_control_sensors_enabled &&
+			       onboard_control_sensors_health == other.onboard_control_sensors_health;
+		}
+	};
+
+	//! SYS_STATUS fields shown in diagnostics
+	struct Status {
+		Sensors sensors;
+		uint16_t load;
+		uint16_t drop_rate_comm;
+		uint16_t errors_comm;
+		uint16_t errors_count1;
+		uint16_t errors_count2;
+		uint16_t errors_count3;
+		uint16_t errors_count4;
+	};
+
+	SeqLock<Status> last_status;
+	DiagnosticCache<Sensors> sensors_cache;
 };
 
 
@@ -281,46 +337,43 @@ class BatteryStatusDiag : public diagnostic_updater::DiagnosticTask
 public:
 	BatteryStatusDiag(const std::string &name) :
 		diagnostic_updater::DiagnosticTask(name),
-		voltage(-1.0),
-		current(0.0),
-		remaining(0.0),
+		battery(Battery { -1.0, 0.0, 0.0 }),
 		min_voltage(6)
 	{ }
 
 	void set_min_voltage(float volt) {
-		std::lock_guard<std::mutex> lock(mutex);
 		min_voltage = volt;
 	}
 
 	void set(float volt, float curr, float rem) {
-		std::lock_guard<std::mutex> lock(mutex);
-		voltage = volt;
-		current = curr;
-		remaining = rem;
+		battery.store(Battery { volt, curr, rem });
 	}
 
 	void run(diagnostic_updater::DiagnosticStatusWrapper &stat)
 	{
-		std::lock_guard<std::mutex> lock(mutex);
+		auto b = battery.load();
 
-		if (voltage < 0)
+		if (b.voltage < 0)
 			stat.summary(2, "No data");
-		else if (voltage < min_voltage)
+		else if (b.voltage < min_voltage)
 			stat.summary(1, "Low voltage");
 		else
 			stat.summary(0, "Normal");
 
-		stat.addf("Voltage", "%.2f", voltage);
-		stat.addf("Current", "%.1f", current);
-		stat.addf("Remaining", "%.1f", remaining * 100);
+		stat.addf("Voltage", "%.2f", b.voltage);
+		stat.addf("Current", "%.1f", b.current);
+		stat.addf("Remaining", "%.1f", b.remaining * 100);
 	}
 
 private:
-	std::mutex mutex;
-	float voltage;
-	float current;
-	float remaining;
-	float min_voltage;
+	struct Battery {
+		float voltage;
+		float current;
+		float remaining;
+	};
+
+	SeqLock<Battery> battery;
+	std::atomic<float> min_voltage;
 };
 
 
@@ -346,9 +399,9 @@ public:
 		ssize_t freemem_ = freemem;
 		uint16_t brkval_ = brkval;
 
-		if (freemem < 0)
+		if (freemem_ < 0)
 			stat.summary(2, "No data");
-		else if (freemem < 200)
+		else if (freemem_ < 200)
 			stat.summary(1, "Low mem");
 		else
 			stat.summary(0, "Normal");
@@ -371,41 +424,41 @@ class HwStatus : public diagnostic_updater::DiagnosticTask
 public:
 	HwStatus(const std::string &name) :
 		diagnostic_updater::DiagnosticTask(name),
-		vcc(-1.0),
-		i2cerr(0),
+		hw(Hw { -1.0, 0 }),
 		i2cerr_last(0)
 	{ }
 
 	void set(uint16_t v, uint8_t e) {
-		std::lock_guard<std::mutex> lock(mutex);
-		vcc = v / 1000.0;
-		i2cerr = e;
+		hw.store(Hw { v / 1000.0f, e });
 	}
 
 	void run(diagnostic_updater::DiagnosticStatusWrapper &stat)
 	{
-		std::lock_guard<std::mutex> lock(mutex);
+		auto h = hw.load();
 
-		if (vcc < 0)
+		if (h.vcc < 0)
 			stat.summary(2, "No data");
-		else if (vcc < 4.5)
+		else if (h.vcc < 4.5)
 			stat.summary(1, "Low voltage");
-		else if (i2cerr != i2cerr_last) {
-			i2cerr_last = i2cerr;
+		else if (h.i2cerr != i2cerr_last) {
+			i2cerr_last = h.i2cerr;
 			stat.summary(1, "New I2C error");
 		}
 		else
 			stat.summary(0, "Normal");
 
-		stat.addf("Core voltage", "%f", vcc);
-		stat.addf("I2C errors", "%zu", i2cerr);
+		stat.addf("Core voltage", "%f", h.vcc);
+		stat.addf("I2C errors", "%zu", h.i2cerr);
 	}
 
 private:
-	std::mutex mutex;
-	float vcc;
-	size_t i2cerr;
-	size_t i2cerr_last;
+	struct Hw {
+		float vcc;
+		size_t i2cerr;
+	};
+
+	SeqLock<Hw> hw;
+	size_t i2cerr_last;	//!< used by run() only
 };
 
 
@@ -448,6 +501,30 @@ public:
 		nh->get_parameter_or("sys/min_voltage", min_voltage, 10.0);
 		nh->get_parameter_or("sys/disable_diag", disable_diag, false);
 
+		// stream manager: request MESSAGE_INTERVAL of watched streams by topic demand
+		bool stream_manager_enable;
+		double stream_hold_d, stream_resend_d;
+		StreamManager::Options stream_opts;
+
+		nh->get_parameter_or("sys/stream_manager", stream_manager_enable, false);
+		nh->get_parameter_or("sys/stream_manager_hold", stream_hold_d, 5.0);
+		nh->get_parameter_or("sys/stream_manager_resend", stream_resend_d, 30.0);
+		nh->get_parameter_or("sys/stream_manager_stop_unused", stream_opts.stop_unused, true);
+		stream_opts.hold = std::chrono::duration_cast<StreamManager::clock::duration>(
+				std::chrono::duration<double>(stream_hold_d));
+		stream_opts.resend = std::chrono::duration_cast<StreamManager::clock::duration>(
+				std::chrono::duration<double>(stream_resend_d));
+		m_uas->stream_manager.set_options(stream_opts);
+
+		// STATUSTEXT repeats within window are counted, not logged
+		double statustext_repeat_d;
+		StatusTextAssembler::Options statustext_opts;
+		nh->get_parameter_or("sys/statustext_repeat_window", statustext_repeat_d, 10.0);
+		statustext_opts.repeat_window = std::chrono::duration_cast<StatusTextAssembler::clock::duration>(
+				std::chrono::duration<double>(statustext_repeat_d));
+		statustext_assembler.set_options(statustext_opts);
+		statustext_emit = std::bind(&SystemStatusPlugin::emit_statustext, this, std::placeholders::_1);
+
 		// heartbeat rate parameter
 		if (nh->get_parameter("conn/heartbeat_rate", conn_heartbeat_d) && conn_heartbeat_d != 0.0) {
 			conn_heartbeat_period = std::chrono::duration<double>(1.0 / conn_heartbeat_d);
@@ -468,28 +545,38 @@ public:
 		}
 
 
-		// one-shot timeout timer
-		timeout_timer = nh->create_wall_timer(std::chrono::duration<double>(conn_timeout_d),
-				std::bind(&SystemStatusPlugin::timeout_cb, this));
-		timeout_timer->cancel();
-		//timeout_timer.start();
+		// one-shot timeout timer, restarted by HEARTBEAT
+		conn_timeout = std::chrono::duration_cast<TimerWheel::clock::duration>(
+				std::chrono::duration<double>(conn_timeout_d));
+		timeout_timer = create_timer(std::bind(&SystemStatusPlugin::timeout_cb, this));
 
 		if (conn_heartbeat_period.count() != 0.0) {
-			heartbeat_timer = nh->create_wall_timer(conn_heartbeat_period,
-					std::bind(&SystemStatusPlugin::heartbeat_cb, this));
-			//heartbeat_timer.start();
+			heartbeat_timer = create_timer(std::bind(&SystemStatusPlugin::heartbeat_cb, this));
+			heartbeat_timer->start_periodic(
+					std::chrono::duration_cast<TimerWheel::clock::duration>(conn_heartbeat_period));
 		}
 
-		// start version request timer
-		autopilot_version_timer = nh->create_wall_timer(std::chrono::seconds(1),
-				std::bind(&SystemStatusPlugin::autopilot_version_cb, this));
-		autopilot_version_timer->cancel();
+		// version request timer, started on connection
+		autopilot_version_timer = create_timer(std::bind(&SystemStatusPlugin::autopilot_version_cb, this));
+
+		// lost chunk tails and pending repeat counts
+		statustext_timer = m_uas->timer_wheel.create_periodic(std::chrono::milliseconds(500),
+				std::bind(&SystemStatusPlugin::statustext_flush_cb, this));
+
+		if (stream_manager_enable) {
+			stream_manager_timer = m_uas->timer_wheel.create_periodic(std::chrono::seconds(1),
+					std::bind(&SystemStatusPlugin::stream_manager_cb, this));
+		}
 
 		state_pub = nh->create_publisher<mavros_msgs::msg::State>("state", 
-			rclcpp::QoS(10).transient_local().reliable());
+			rclcpp::QoS(10).transient_local().reliable(), latched_publisher_options());
 		extended_state_pub = nh->create_publisher<mavros_msgs::msg::ExtendedState>("extended_state", 10);
 		batt_pub = nh->create_publisher<BatteryMsg>("battery", 10);
 		statustext_pub = nh->create_publisher<mavros_msgs::msg::StatusText>("statustext/recv", 10);
+		// state is latched for late subscribers, so it is always published
+		extended_state_subs = watch_subscribers(extended_state_pub);
+		batt_subs = watch_subscribers(batt_pub);
+		statustext_subs = watch_subscribers(statustext_pub);
 		statustext_sub = nh->create_subscription<mavros_msgs::msg::StatusText>("statustext/send", 10, 
 			std::bind(&SystemStatusPlugin::statustext_cb, this, std::placeholders::_1));
 		rate_srv = nh->create_service<mavros_msgs::srv::StreamRate>("set_stream_rate", 
@@ -529,14 +616,23 @@ private:
 	HwStatus hwst_diag;
 	SystemStatusDiag sys_diag;
 	BatteryStatusDiag batt_diag;
-	rclcpp::TimerBase::SharedPtr timeout_timer;
-	rclcpp::TimerBase::SharedPtr heartbeat_timer;
-	rclcpp::TimerBase::SharedPtr autopilot_version_timer;
+	TimerWheel::Ptr timeout_timer;
+	TimerWheel::Ptr heartbeat_timer;
+	TimerWheel::Ptr autopilot_version_timer;
+	TimerWheel::Ptr stream_manager_timer;
+	TimerWheel::clock::duration conn_timeout;
 
 	rclcpp::Publisher<mavros_msgs::msg::State>::SharedPtr state_pub;
 	rclcpp::Publisher<mavros_msgs::msg::ExtendedState>::SharedPtr extended_state_pub;
 	rclcpp::Publisher<BatteryMsg>::SharedPtr batt_pub;
 	rclcpp::Publisher<mavros_msgs::msg::StatusText>::SharedPtr statustext_pub;
+	SubscriberCount extended_state_subs;
+	SubscriberCount batt_subs;
+	SubscriberCount statustext_subs;
+	std::mutex statustext_mutex;
+	StatusTextAssembler statustext_assembler;
+	StatusTextAssembler::EmitFn statustext_emit;
+	TimerWheel::Ptr statustext_timer;	//!< after assembler, flushes it
 	rclcpp::Subscription<mavros_msgs::msg::StatusText>::SharedPtr statustext_sub;
 	rclcpp::Service<mavros_msgs::srv::StreamRate>::SharedPtr rate_srv;
 	rclcpp::Service<mavros_msgs::srv::SetMode>::SharedPtr mode_srv;
@@ -585,7 +681,7 @@ private:
 	 *
 	 * @param[in] severity  Levels defined in common.xml
 	 */
-	void process_statustext_normal(uint8_t severity, std::string &text)
+	void process_statustext_normal(uint8_t severity, const std::string &text)
 	{
 		using mavlink::common::MAV_SEVERITY;
 
@@ -635,7 +731,7 @@ private:
 		return utils::format("%016llx", b);
 	}
 
-	void process_autopilot_version_normal(mavlink::common::msg::AUTOPILOT_VERSION &apv, uint8_t sysid, uint8_t compid)
+	void process_autopilot_version_normal(const mavlink::common::msg::AUTOPILOT_VERSION &apv, uint8_t sysid, uint8_t compid)
 	{
 		char prefix[16];
 		std::snprintf(prefix, sizeof(prefix), "VER: %d.%d", sysid, compid);
@@ -658,7 +754,7 @@ private:
 		RCLCPP_INFO(logger, "%s: UID:                 %016llx", prefix, (long long int)apv.uid);
 	}
 
-	void process_autopilot_version_apm_quirk(mavlink::common::msg::AUTOPILOT_VERSION &apv, uint8_t sysid, uint8_t compid)
+	void process_autopilot_version_apm_quirk(const mavlink::common::msg::AUTOPILOT_VERSION &apv, uint8_t sysid, uint8_t compid)
 	{
 		char prefix[16];
 		std::snprintf(prefix, sizeof(prefix), "VER: %d.%d", sysid, compid);
@@ -697,7 +793,7 @@ private:
 
 	/* -*- message handlers -*- */
 
-	void handle_heartbeat(const mavlink::mavlink_message_t *msg, mavlink::common::msg::HEARTBEAT &hb)
+	void handle_heartbeat(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::HEARTBEAT &hb)
 	{
 		using mavlink::common::MAV_MODE_FLAG;
 
@@ -732,7 +828,7 @@ private:
 		// update context && setup connection timeout
 		m_uas->update_heartbeat(hb.type, hb.autopilot, hb.base_mode);
 		m_uas->update_connection_status(true);
-		timeout_timer->reset();
+		timeout_timer->start(conn_timeout);
 
 		// build state message after updating uas
 		auto state_msg = state_pub->borrow_loaned_message();
@@ -748,8 +844,11 @@ private:
 		hb_diag.tick(hb.type, hb.autopilot, vehicle_mode, hb.system_status);
 	}
 
-	void handle_extended_sys_state(const mavlink::mavlink_message_t *msg, mavlink::common::msg::EXTENDED_SYS_STATE &state)
+	void handle_extended_sys_state(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::EXTENDED_SYS_STATE &state)
 	{
+		if (!extended_state_subs)
+			return;
+
 		auto state_msg = extended_state_pub->borrow_loaned_message();
 		state_msg.get().header.stamp = clock->now();
 		state_msg.get().vtol_state = state.vtol_state;
@@ -758,7 +857,7 @@ private:
 		extended_state_pub->publish(std::move(state_msg));
 	}
 
-	void handle_sys_status(const mavlink::mavlink_message_t *msg, mavlink::common::msg::SYS_STATUS &stat)
+	void handle_sys_status(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::SYS_STATUS &stat)
 	{
 		float volt = stat.voltage_battery / 1000.0f;	// mV
 		float curr = stat.current_battery / 100.0f;	// 10 mA or -1
@@ -768,7 +867,7 @@ private:
 		sys_diag.set(stat);
 		batt_diag.set(volt, curr, rem);
 
-		if (has_battery_status)
+		if (has_battery_status || !batt_subs)
 			return;
 
 		auto batt_msg = batt_pub->borrow_loaned_message();
@@ -797,34 +896,53 @@ private:
 		batt_pub->publish(std::move(batt_msg));
 	}
 
-	void handle_statustext(const mavlink::mavlink_message_t *msg, mavlink::common::msg::STATUSTEXT &textm)
+	void handle_statustext(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::STATUSTEXT &textm)
 	{
-		auto text = mavlink::to_string(textm.text);
-		process_statustext_normal(textm.severity, text);
+		std::lock_guard<std::mutex> lock(statustext_mutex);
+
+		// MAVLink 1 frame has zero id: single chunk text
+		statustext_assembler.push((msg->sysid << 8) | msg->compid, textm.id, textm.chunk_seq,
+				textm.severity, textm.text.data(), StatusTextAssembler::clock::now(),
+				statustext_emit);
+	}
+
+	//! Log and publish assembled text
+	void emit_statustext(const StatusTextAssembler::Text &st)
+	{
+		if (st.repeated == 0) {
+			process_statustext_normal(st.severity, st.text);
+		}
+		else {
+			process_statustext_normal(st.severity,
+					st.text + " (repeated " + std::to_string(st.repeated) + " times)");
+		}
+
+		if (!statustext_subs)
+			return;
 
 		auto st_msg = statustext_pub->borrow_loaned_message();
 		st_msg.get().header.stamp = clock->now();
-		st_msg.get().severity = textm.severity;
-		st_msg.get().text = text;
+		st_msg.get().severity = st.severity;
+		st_msg.get().text = st.text;
 		statustext_pub->publish(std::move(st_msg));
 	}
 
-	void handle_meminfo(const mavlink::mavlink_message_t *msg, mavlink::ardupilotmega::msg::MEMINFO &mem)
+	void handle_meminfo(const mavlink::mavlink_message_t *msg, const mavlink::ardupilotmega::msg::MEMINFO &mem)
 	{
 		mem_diag.set(mem.freemem, mem.brkval);
 	}
 
-	void handle_hwstatus(const mavlink::mavlink_message_t *msg, mavlink::ardupilotmega::msg::HWSTATUS &hwst)
+	void handle_hwstatus(const mavlink::mavlink_message_t *msg, const mavlink::ardupilotmega::msg::HWSTATUS &hwst)
 	{
 		hwst_diag.set(hwst.Vcc, hwst.I2Cerr);
 	}
 
-	void handle_autopilot_version(const mavlink::mavlink_message_t *msg, mavlink::common::msg::AUTOPILOT_VERSION &apv)
+	void handle_autopilot_version(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::AUTOPILOT_VERSION &apv)
 	{
 		// we want to store only FCU caps
 		if (m_uas->is_my_target(msg->sysid, msg->compid)) {
 			autopilot_version_timer->cancel();
-			m_uas->update_capabilities(true, apv.capabilities);
+			m_uas->update_capabilities(true, apv.capabilities, apv.uid);
 		}
 
 		// but print all version responses
@@ -849,13 +967,15 @@ private:
 		it->second.uid = apv.uid;
 	}
 
-	void handle_battery_status(const mavlink::mavlink_message_t *msg, mavlink::common::msg::BATTERY_STATUS &bs)
+	void handle_battery_status(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::BATTERY_STATUS &bs)
 	{
 		// PX4.
 #ifdef HAVE_SENSOR_MSGS_BATTERYSTATE_MSG
 		using BT = mavlink::common::MAV_BATTERY_TYPE;
 
 		has_battery_status = true;
+		if (!batt_subs)
+			return;
 
 		auto batt_msg = batt_pub->borrow_loaned_message();
 		batt_msg.get().header.stamp = rclcpp::Time::now();
@@ -922,6 +1042,12 @@ private:
 
 	/* -*- timer callbacks -*- */
 
+	void statustext_flush_cb()
+	{
+		std::lock_guard<std::mutex> lock(statustext_mutex);
+		statustext_assembler.flush(StatusTextAssembler::clock::now(), statustext_emit);
+	}
+
 	void timeout_cb()
 	{
 		m_uas->update_connection_status(false);
@@ -992,10 +1118,14 @@ private:
 		// if connection changes, start delayed version request
 		version_retries = RETRIES_COUNT;
 		if (connected)
-			autopilot_version_timer->reset();
+			autopilot_version_timer->start_periodic(std::chrono::seconds(1));
 		else
 			autopilot_version_timer->cancel();
 
+		// FCU may have restarted with its default intervals
+		if (connected)
+			m_uas->stream_manager.reset();
+
 		// add/remove APM diag tasks
 		if (connected && disable_diag && m_uas->is_ardupilotmega()) {
 			UAS_DIAG(m_uas).add(mem_diag);
@@ -1015,6 +1145,54 @@ private:
 		}
 	}
 
+	/**
+	 * Rate asked by topic subscribers.
+	 *
+	 * Subscriber tells its rate by QoS deadline, else it gets the demand default rate.
+	 */
+	double stream_demand_rate(const StreamManager::Demand &demand)
+	{
+		double rate = 0.0;
+
+		for (auto &info : nh->get_subscriptions_info_by_topic(demand.topic)) {
+			auto deadline = info.qos_profile().get_rmw_qos_profile().deadline;
+			double period = deadline.sec + deadline.nsec * 1e-9;
+
+			// unset deadline is 0 or "infinite"
+			double sub_rate = (period > 0.0 && period < 1000.0) ? 1.0 / period : demand.default_rate;
+			rate = std::max(rate, sub_rate);
+		}
+
+		return rate;
+	}
+
+	void stream_manager_cb()
+	{
+		using mavlink::common::MAV_CMD;
+
+		if (!m_uas->is_connected())
+			return;
+
+		auto &sm = m_uas->stream_manager;
+		auto demands = sm.get_demands();
+		for (size_t i = 0; i < demands.size(); i++)
+			sm.set_rate(i, stream_demand_rate(demands[i]));
+
+		// sent directly: command plugin service round trip is not needed
+		// for fire-and-forget requests which are repeated anyway
+		for (auto &rq : sm.update()) {
+			mavlink::common::msg::COMMAND_LONG cmd {};
+
+			m_uas->msg_set_target(cmd);
+			cmd.command = enum_value(MAV_CMD::SET_MESSAGE_INTERVAL);
+			cmd.param1 = rq.msgid;
+			cmd.param2 = rq.interval_us;
+
+			RCLCPP_DEBUG(logger, "SM: msgid %u interval %.0f us", rq.msgid, rq.interval_us);
+			UAS_FCU(m_uas)->send_message_ignore_drop(cmd);
+		}
+	}
+
 	/* -*- subscription callbacks -*- */
 
 	void statustext_cb(const mavros_msgs::msg::StatusText::SharedPtr req) {
@@ -1142,6 +1320,9 @@ private:
             cmd->param1 = req->message_id;
             cmd->param2 = interval_us;
 
+            // user choice, stream manager must not override it
+            m_uas->stream_manager.set_manual(req->message_id);
+
             RCLCPP_DEBUG(logger, "SetMessageInterval: Request msgid %u at %f hz",
                     req->message_id, req->message_rate);
             res->success = client->wait_for_service(std::chrono::milliseconds(200));
@@ -1160,5 +1341,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::SystemStatusPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(sys_status, mavros::std_plugins::SystemStatusPlugin)
@@ -15,6 +15,7 @@
  */
 
 #include <mavros/mavros_plugin.h>
+#include <mavros/timesync_estimator.h>
 
 #include <sensor_msgs/msg/time_reference.hpp>
 #include <builtin_interfaces/msg/duration.hpp>
@@ -33,6 +34,7 @@ public:
 	TimeSyncStatus(const std::string &name, size_t win_size) :
 		diagnostic_updater::DiagnosticTask(name),
 		clock_(RCL_ROS_TIME),
+		count_(0),
 		window_size_(win_size),
 		min_freq_(0.01),
 		max_freq_(10),
@@ -58,7 +60,7 @@ public:
 		for (int i = 0; i < window_size_; i++)
 		{
 			times_[i] = curtime;
-			seq_nums_[i] = count_;
+			seq_nums_[i] = 0;
 		}
 
 		hist_indx_ = 0;
@@ -66,19 +68,16 @@ public:
 
 	void tick(int64_t rtt_ns, uint64_t remote_timestamp_ns, int64_t time_offset_ns)
 	{
-		std::lock_guard<std::mutex> lock(mutex);
-
-		count_++;
-		last_rtt = rtt_ns;
-		rtt_sum += rtt_ns;
-		last_remote_ts = remote_timestamp_ns;
-		offset = time_offset_ns;
+		last_rtt.store(rtt_ns, std::memory_order_relaxed);
+		rtt_sum.fetch_add(rtt_ns, std::memory_order_relaxed);
+		last_remote_ts.store(remote_timestamp_ns, std::memory_order_relaxed);
+		offset.store(time_offset_ns, std::memory_order_relaxed);
+		count_.fetch_add(1, std::memory_order_relaxed);
 	}
 
 	void set_timestamp(uint64_t remote_timestamp_ns)
 	{
-		std::lock_guard<std::mutex> lock(mutex);
-		last_remote_ts = remote_timestamp_ns;
+		last_remote_ts.store(remote_timestamp_ns, std::memory_order_relaxed);
 	}
 
 	void run(diagnostic_updater::DiagnosticStatusWrapper &stat)
@@ -107,29 +106,31 @@ public:
 			stat.summary(0, "Normal");
 		}
 
-		stat.addf("Timesyncs since startup", "%d", count_);
+		int64_t rtt_sum_ = rtt_sum;
+
+		stat.addf("Timesyncs since startup", "%d", curseq);
 		stat.addf("Frequency (Hz)", "%f", freq);
 		stat.addf("Last RTT (ms)", "%0.6f", last_rtt / 1e6);
-		stat.addf("Mean RTT (ms)", "%0.6f", (count_) ? rtt_sum / count_ / 1e6 : 0.0);
+		stat.addf("Mean RTT (ms)", "%0.6f", (curseq) ? rtt_sum_ / curseq / 1e6 : 0.0);
 		stat.addf("Last remote time (s)", "%0.9f", last_remote_ts / 1e9);
 		stat.addf("Estimated time offset (s)", "%0.9f", offset / 1e9);
 	}
 
 private:
 	rclcpp::Clock clock_;
-	int count_;
+	std::atomic<int> count_;
 	std::vector<rclcpp::Time> times_;
 	std::vector<int> seq_nums_;
 	int hist_indx_;
-	std::mutex mutex;
+	std::mutex mutex;	//!< guards window, taken by clear() and run() only
 	const size_t window_size_;
 	const double min_freq_;
 	const double max_freq_;
 	const double tolerance_;
-	int64_t last_rtt;
-	int64_t rtt_sum;
-	uint64_t last_remote_ts;
-	int64_t offset;
+	std::atomic<int64_t> last_rtt;
+	std::atomic<int64_t> rtt_sum;
+	std::atomic<uint64_t> last_remote_ts;
+	std::atomic<int64_t> offset;
 };
 
 
@@ -146,7 +147,9 @@ public:
 		filter_alpha(0),
 		filter_beta(0),
 		high_rtt_count(0),
-		high_deviation_count(0)
+		high_deviation_count(0),
+		timesync_window(128),
+		rx_estimator(timesync_window)
 	{ }
 
 	using TSM = UAS::timesync_mode;
@@ -215,6 +218,14 @@ public:
 		nh->get_parameter_or("time/max_consecutive_high_rtt", max_cons_high_rtt, 5);
 		nh->get_parameter_or("time/max_consecutive_high_deviation", max_cons_high_deviation, 5);
 
+		// Receive stamp timesync (MAVLINK_RX mode)
+		//
+		// Round trips are stamped by mavconn at receive, so handler dispatch delay
+		// is not in the estimate. Offset and skew are fitted over last timesync_window
+		// samples, weighted by 1/RTT^2, so max_rtt_sample is not used.
+		nh->get_parameter_or("time/timesync_window", timesync_window, 128);
+		rx_estimator = TimeSyncEstimator(timesync_window);
+
 		// Set timesync mode
 		auto ts_mode = utils::timesync_mode_from_str(ts_mode_str);
 		m_uas->set_timesync_mode(ts_mode);
@@ -226,7 +237,8 @@ public:
 
 		// timer for sending system time messages
 		if (conn_system_time.count() != 0.0) {
-			sys_time_timer = nh->create_wall_timer(conn_system_time,
+			sys_time_timer = m_uas->timer_wheel.create_periodic(
+						std::chrono::duration_cast<TimerWheel::clock::duration>(conn_system_time),
 						std::bind(&SystemTimePlugin::sys_time_cb, this));
 		}
 
@@ -236,7 +248,8 @@ public:
 			// enable timesync diag only if that feature enabled
 			UAS_DIAG(m_uas).add(dt_diag);
 
-			timesync_timer = nh->create_wall_timer(conn_timesync,
+			timesync_timer = m_uas->timer_wheel.create_periodic(
+						std::chrono::duration_cast<TimerWheel::clock::duration>(conn_timesync),
 						std::bind(&SystemTimePlugin::timesync_cb, this));
 		}
 	}
@@ -255,8 +268,8 @@ private:
 	rclcpp::Publisher<sensor_msgs::msg::TimeReference>::SharedPtr time_ref_pub;
 	rclcpp::Publisher<mavros_msgs::msg::TimesyncStatus>::SharedPtr timesync_status_pub;
 
-	rclcpp::TimerBase::SharedPtr sys_time_timer;
-	rclcpp::TimerBase::SharedPtr timesync_timer;
+	TimerWheel::Ptr sys_time_timer;
+	TimerWheel::Ptr timesync_timer;
 
 	TimeSyncStatus dt_diag;
 
@@ -286,7 +299,11 @@ private:
 	int high_rtt_count;
 	int high_deviation_count;
 
-	void handle_system_time(const mavlink::mavlink_message_t *msg, mavlink::common::msg::SYSTEM_TIME &mtime)
+	// MAVLINK_RX mode
+	int timesync_window;
+	TimeSyncEstimator rx_estimator;
+
+	void handle_system_time(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::SYSTEM_TIME &mtime)
 	{
 		// date -d @1234567890: Sat Feb 14 02:31:30 MSK 2009
 		const bool fcu_time_valid = mtime.time_unix_usec > 1234567890ULL * 1000000;
@@ -309,8 +326,13 @@ private:
 		}
 	}
 
-	void handle_timesync(const mavlink::mavlink_message_t *msg, mavlink::common::msg::TIMESYNC &tsync)
+	void handle_timesync(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::TIMESYNC &tsync)
 	{
+		if (m_uas->get_timesync_mode() == TSM::MAVLINK_RX) {
+			handle_timesync_rx(tsync);
+			return;
+		}
+
 		uint64_t now_ns = clock->now().nanoseconds();
 
 		if (tsync.tc1 == 0) {
@@ -324,6 +346,22 @@ private:
 		}
 	}
 
+	void handle_timesync_rx(const mavlink::common::msg::TIMESYNC &tsync)
+	{
+		// same clock as rx stamps
+		uint64_t rx_ns = UAS::get_rx_stamp();
+		if (rx_ns == 0)
+			rx_ns = mavconn::MAVConnInterface::rx_stamp_now();
+
+		if (tsync.tc1 == 0) {
+			send_timesync_msg(rx_ns, tsync.ts1);
+			return;
+		}
+		else if (tsync.tc1 > 0) {
+			add_timesync_rx_observation(tsync.ts1, tsync.tc1, rx_ns);
+		}
+	}
+
 	void sys_time_cb()
 	{
 		// For filesystem only
@@ -340,6 +378,8 @@ private:
 		auto ts_mode = m_uas->get_timesync_mode();
 		if (ts_mode == TSM::MAVLINK) {
 			send_timesync_msg(0, clock->now().nanoseconds());
+		} else if (ts_mode == TSM::MAVLINK_RX) {
+			send_timesync_msg(0, mavconn::MAVConnInterface::rx_stamp_now());
 		} else if (ts_mode == TSM::ONBOARD) {
 			// Calculate offset between CLOCK_REALTIME (ros::WallTime) and CLOCK_MONOTONIC
 			uint64_t realtime_now_ns = clock->now().nanoseconds();
@@ -441,6 +481,46 @@ private:
 		dt_diag.tick(rtt_ns, remote_time_ns, time_offset);
 	}
 
+	void add_timesync_rx_observation(uint64_t local_tx_ns, uint64_t remote_time_ns, uint64_t local_rx_ns)
+	{
+		uint64_t rtt_ns = local_rx_ns - local_tx_ns;
+		int64_t residual = rx_estimator.residual(local_tx_ns, remote_time_ns, local_rx_ns);
+
+		// midpoint may be off by half of RTT, that is not a time jump
+		uint64_t max_deviation = max_deviation_sample * 1000000ULL + rtt_ns / 2;
+
+		if (rx_estimator.size() > 0 && uint64_t(llabs(residual)) > max_deviation) {
+			high_deviation_count++;
+			if (high_deviation_count <= max_cons_high_deviation)
+				return;
+
+			RCUTILS_LOG_ERROR_NAMED("time", "TM : Time jump detected. Resetting time synchroniser.");
+			rx_estimator.reset();
+			dt_diag.clear();
+		}
+
+		high_deviation_count = 0;
+		rx_estimator.add(local_tx_ns, remote_time_ns, local_rx_ns);
+
+		auto model = rx_estimator.model();
+		m_uas->set_time_model(model);
+
+		int64_t offset_ns = local_tx_ns + rtt_ns / 2 - remote_time_ns;
+		int64_t estimated_ns = model.to_local(remote_time_ns) - remote_time_ns;
+
+		auto timesync_status = std::make_unique<mavros_msgs::msg::TimesyncStatus>();
+
+		timesync_status->header.stamp = clock->now();
+		timesync_status->remote_timestamp_ns = remote_time_ns;
+		timesync_status->observed_offset_ns = offset_ns;
+		timesync_status->estimated_offset_ns = estimated_ns;
+		timesync_status->round_trip_time_ms = float(rtt_ns / 1000000.0);
+
+		timesync_status_pub->publish(std::move(timesync_status));
+
+		dt_diag.tick(rtt_ns, remote_time_ns, estimated_ns);
+	}
+
 	void add_sample(int64_t offset_ns)
 	{
 		/* Online exponential smoothing filter. The derivative of the estimate is also
@@ -489,5 +569,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::SystemTimePlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(sys_time, mavros::std_plugins::SystemTimePlugin)
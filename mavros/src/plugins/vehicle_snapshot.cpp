@@ -0,0 +1,320 @@
+/**
+ * @brief Vehicle snapshot plugin
+ * @file vehicle_snapshot.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup plugin
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <mavros/mavros_plugin.h>
+#include <tf2_eigen/tf2_eigen.h>
+
+#include <mavros_msgs/msg/vehicle_snapshot.hpp>
+
+namespace mavros {
+namespace std_plugins {
+using mavros_msgs::msg::VehicleSnapshot;
+using utils::enum_value;
+
+/**
+ * @brief Vehicle snapshot plugin
+ *
+ * Publishes state of vehicle as one VehicleSnapshot message at fixed rate,
+ * for fleet uplink which would otherwise subscribe to a dozen topics.
+ * Handlers only store values, message is built by timer.
+ * Attitude, GPS and home are taken from UAS snapshots.
+ */
+class VehicleSnapshotPlugin : public plugin::PluginBase {
+public:
+	VehicleSnapshotPlugin() : PluginBase(),
+		changed(0),
+		ticks(0),
+		full_ticks(0)
+	{ }
+
+	void initialize(UAS &uas_)
+	{
+		PluginBase::initialize(uas_);
+
+		vs_nh = uas_.mavros_node->create_sub_node("vehicle_snapshot");
+
+		// publish rate [Hz]
+		auto rate = vs_nh->declare_parameter("vehicle_snapshot/rate", 1.0);
+		// all known groups are marked changed that often [s], 0 - only first snapshot
+		auto full_interval = vs_nh->declare_parameter("vehicle_snapshot/full_interval", 10.0);
+		frame_id = vs_nh->declare_parameter<std::string>("vehicle_snapshot/frame_id", "map");
+
+		if (rate <= 0.0) {
+			RCLCPP_WARN(rclcpp::get_logger("mavros.vehicle_snapshot"), "VS: rate %f is not positive, using 1 Hz", rate);
+			rate = 1.0;
+		}
+
+		full_ticks = std::max<size_t>(1, std::lround(full_interval * rate));
+		if (full_interval <= 0.0)
+			full_ticks = 0;
+
+		reset_values();
+
+		snapshot_pub = vs_nh->create_publisher<VehicleSnapshot>("snapshot", 10);
+		snapshot_subs = watch_subscribers(snapshot_pub);
+		watch_stream(snapshot_pub, {
+				mavlink::common::msg::SYS_STATUS::MSG_ID,
+				mavlink::common::msg::EXTENDED_SYS_STATE::MSG_ID,
+				mavlink::common::msg::VFR_HUD::MSG_ID,
+				mavlink::common::msg::ALTITUDE::MSG_ID,
+				mavlink::common::msg::GLOBAL_POSITION_INT::MSG_ID,
+				mavlink::common::msg::LOCAL_POSITION_NED::MSG_ID,
+			}, rate);
+
+		publish_timer = create_timer(std::bind(&VehicleSnapshotPlugin::publish_cb, this));
+		publish_timer->start_periodic(std::chrono::duration_cast<TimerWheel::clock::duration>(
+				std::chrono::duration<double>(1.0 / rate)));
+
+		enable_connection_cb();
+	}
+
+	Subscriptions get_subscriptions()
+	{
+		return {
+			       make_handler(&VehicleSnapshotPlugin::handle_heartbeat),
+			       make_handler(&VehicleSnapshotPlugin::handle_extended_sys_state),
+			       make_handler(&VehicleSnapshotPlugin::handle_sys_status),
+			       make_handler(&VehicleSnapshotPlugin::handle_vfr_hud),
+			       make_handler(&VehicleSnapshotPlugin::handle_altitude),
+			       make_handler(&VehicleSnapshotPlugin::handle_global_position_int),
+			       make_handler(&VehicleSnapshotPlugin::handle_local_position_ned),
+			       make_handler(&VehicleSnapshotPlugin::handle_wind_cov),
+		};
+	}
+
+private:
+	rclcpp::Node::SharedPtr vs_nh;
+	rclcpp::Publisher<VehicleSnapshot>::SharedPtr snapshot_pub;
+	SubscriberCount snapshot_subs;
+	TimerWheel::Ptr publish_timer;
+	std::string frame_id;
+
+	//! handlers run in Rx threads, timer in wheel thread
+	std::mutex mutex;
+	VehicleSnapshot values;		//!< last known, valid mask is kept here
+	uint32_t changed;		//!< groups changed since last publish
+	size_t ticks;			//!< publish_cb() calls since last full snapshot
+	size_t full_ticks;
+
+	static constexpr float NaN = std::numeric_limits<float>::quiet_NaN();
+
+	template<typename T>
+	static inline bool differs(const T &a, const T &b) {
+		return !(a == b);
+	}
+
+	// FCU reports unknown as NaN, it should not be a change on each message
+	static inline bool differs(float a, float b) {
+		return !(a == b || (std::isnan(a) && std::isnan(b)));
+	}
+
+	static inline bool differs(double a, double b) {
+		return !(a == b || (std::isnan(a) && std::isnan(b)));
+	}
+
+	//! Store field of @a group, mutex should be held
+	template<typename T>
+	inline void set(T &field, const T &value, uint32_t group) {
+		if (differs(field, value)) {
+			field = value;
+			changed |= group;
+		}
+
+		values.valid |= group;
+	}
+
+	void reset_values()
+	{
+		values = VehicleSnapshot();
+		values.voltage = values.current = values.percentage = NaN;
+		values.airspeed = values.groundspeed = values.throttle = values.climb = NaN;
+		values.altitude_amsl = values.altitude_local = values.altitude_relative = NaN;
+		values.altitude_terrain = values.bottom_clearance = NaN;
+		values.latitude = values.longitude = values.altitude = NaN;
+		values.relative_altitude = NaN;
+		values.home_latitude = values.home_longitude = values.home_altitude = NaN;
+		values.eph = values.epv = NaN;
+		values.orientation.w = 1.0;
+	}
+
+	/* -*- message handlers -*- */
+
+	void handle_heartbeat(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::HEARTBEAT &hb)
+	{
+		using mavlink::common::MAV_MODE_FLAG;
+
+		if (!m_uas->is_my_target(msg->sysid, msg->compid))
+			return;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		set(values.connected, true, VehicleSnapshot::STATE);
+		set(values.armed, bool(hb.base_mode & enum_value(MAV_MODE_FLAG::SAFETY_ARMED)), VehicleSnapshot::STATE);
+		set(values.guided, bool(hb.base_mode & enum_value(MAV_MODE_FLAG::GUIDED_ENABLED)), VehicleSnapshot::STATE);
+		set(values.manual_input, bool(hb.base_mode & enum_value(MAV_MODE_FLAG::MANUAL_INPUT_ENABLED)), VehicleSnapshot::STATE);
+		set(values.system_status, hb.system_status, VehicleSnapshot::STATE);
+		set(values.base_mode, hb.base_mode, VehicleSnapshot::STATE);
+		set(values.custom_mode, hb.custom_mode, VehicleSnapshot::STATE);
+	}
+
+	void handle_extended_sys_state(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::EXTENDED_SYS_STATE &state)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		set(values.vtol_state, state.vtol_state, VehicleSnapshot::EXTENDED_STATE);
+		set(values.landed_state, state.landed_state, VehicleSnapshot::EXTENDED_STATE);
+	}
+
+	void handle_sys_status(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::SYS_STATUS &stat)
+	{
+		// same conversions as sys_status plugin, unknown values are -1
+		float volt = stat.voltage_battery / 1000.0f;	// mV
+		float curr = stat.current_battery / 100.0f;	// 10 mA
+		float rem = stat.battery_remaining / 100.0f;	// %
+
+		std::lock_guard<std::mutex> lock(mutex);
+		set(values.voltage, (stat.voltage_battery != UINT16_MAX) ? volt : NaN, VehicleSnapshot::BATTERY);
+		set(values.current, (stat.current_battery != -1) ? curr : NaN, VehicleSnapshot::BATTERY);
+		set(values.percentage, (stat.battery_remaining != -1) ? rem : NaN, VehicleSnapshot::BATTERY);
+	}
+
+	void handle_vfr_hud(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::VFR_HUD &vfr_hud)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		set(values.airspeed, vfr_hud.airspeed, VehicleSnapshot::VFR_HUD);
+		set(values.groundspeed, vfr_hud.groundspeed, VehicleSnapshot::VFR_HUD);
+		set(values.heading, vfr_hud.heading, VehicleSnapshot::VFR_HUD);
+		set(values.throttle, vfr_hud.throttle / 100.0f, VehicleSnapshot::VFR_HUD);	// comes in 0..100 range
+		set(values.climb, vfr_hud.climb, VehicleSnapshot::VFR_HUD);
+	}
+
+	void handle_altitude(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::ALTITUDE &altitude)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		set(values.altitude_amsl, altitude.altitude_amsl, VehicleSnapshot::ALTITUDE);
+		set(values.altitude_local, altitude.altitude_local, VehicleSnapshot::ALTITUDE);
+		set(values.altitude_relative, altitude.altitude_relative, VehicleSnapshot::ALTITUDE);
+		set(values.altitude_terrain, altitude.altitude_terrain, VehicleSnapshot::ALTITUDE);
+		set(values.bottom_clearance, altitude.bottom_clearance, VehicleSnapshot::ALTITUDE);
+	}
+
+	void handle_global_position_int(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::GLOBAL_POSITION_INT &gpos)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		set(values.latitude, gpos.lat / 1E7, VehicleSnapshot::GLOBAL_POSITION);
+		set(values.longitude, gpos.lon / 1E7, VehicleSnapshot::GLOBAL_POSITION);
+		set(values.altitude, gpos.alt / 1E3, VehicleSnapshot::GLOBAL_POSITION);
+		set(values.relative_altitude, gpos.relative_alt / 1E3f, VehicleSnapshot::GLOBAL_POSITION);
+	}
+
+	void handle_local_position_ned(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::LOCAL_POSITION_NED &pos_ned)
+	{
+		auto enu_position = ftf::transform_frame_ned_enu(Eigen::Vector3d(pos_ned.x, pos_ned.y, pos_ned.z));
+		auto enu_velocity = ftf::transform_frame_ned_enu(Eigen::Vector3d(pos_ned.vx, pos_ned.vy, pos_ned.vz));
+
+		auto position = tf2::toMsg(enu_position);
+		geometry_msgs::msg::Vector3 velocity;
+		tf2::toMsg(enu_velocity, velocity);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		set(values.position, position, VehicleSnapshot::LOCAL_POSITION);
+		set(values.velocity, velocity, VehicleSnapshot::LOCAL_POSITION);
+	}
+
+	void handle_wind_cov(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::WIND_COV &wind)
+	{
+		geometry_msgs::msg::Vector3 wind_enu;
+		tf2::toMsg(ftf::transform_frame_ned_enu(Eigen::Vector3d(wind.wind_x, wind.wind_y, wind.wind_z)), wind_enu);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		set(values.wind, wind_enu, VehicleSnapshot::WIND);
+	}
+
+	/* -*- publish -*- */
+
+	//! Values kept by UAS for other plugins, mutex should be held
+	void update_from_uas()
+	{
+		set(values.connected, m_uas->is_connected(), VehicleSnapshot::STATE);
+
+		auto att = m_uas->get_attitude_enu();
+		if (att.valid)
+			set(values.orientation, att.orientation, VehicleSnapshot::ATTITUDE);
+
+		auto gps = m_uas->get_gps();
+		if (gps.valid) {
+			set(values.fix_type, uint8_t(gps.fix_type), VehicleSnapshot::GPS);
+			set(values.satellites_visible, uint8_t(gps.satellites_visible), VehicleSnapshot::GPS);
+			set(values.eph, gps.eph, VehicleSnapshot::GPS);
+			set(values.epv, gps.epv, VehicleSnapshot::GPS);
+		}
+
+		auto home = m_uas->get_home();
+		if (home.valid) {
+			set(values.home_latitude, home.latitude, VehicleSnapshot::HOME);
+			set(values.home_longitude, home.longitude, VehicleSnapshot::HOME);
+			set(values.home_altitude, home.altitude, VehicleSnapshot::HOME);
+		}
+	}
+
+	void publish_cb()
+	{
+		VehicleSnapshot snapshot;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			update_from_uas();
+
+			// late subscriber gets all groups with next full snapshot
+			if (full_ticks > 0 && ++ticks >= full_ticks) {
+				ticks = 0;
+				changed |= values.valid;
+			}
+
+			// changes add up until someone listens
+			if (!snapshot_subs || values.valid == 0)
+				return;
+
+			snapshot = values;
+			snapshot.changed = changed;
+			changed = 0;
+		}
+
+		snapshot.header.stamp = vs_nh->now();
+		snapshot.header.frame_id = frame_id;
+		snapshot_pub->publish(snapshot);
+	}
+
+	void connection_cb(bool connected) override
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (connected)
+			return;
+
+		// new FCU may differ in everything, send it all with next snapshot
+		reset_values();
+		changed = VehicleSnapshot::STATE;
+		values.valid = VehicleSnapshot::STATE;
+	}
+};
+
+constexpr float VehicleSnapshotPlugin::NaN;
+}	// namespace std_plugins
+}	// namespace mavros
+
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(vehicle_snapshot, mavros::std_plugins::VehicleSnapshotPlugin)
@@ -52,7 +52,7 @@ private:
 
 	rclcpp::Publisher<>::SharedPtr vfr_pub;
 
-	void handle_vfr_hud(const mavlink::mavlink_message_t *msg, mavlink::common::msg::VFR_HUD &vfr_hud)
+	void handle_vfr_hud(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::VFR_HUD &vfr_hud)
 	{
 		auto vmsg = std::make_shared<mavros_msgs::msg::VFR_HUD>();
 		vmsg->header.stamp = rclcpp::Time::now();
@@ -69,5 +69,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::VfrHudPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(vfr_hud, mavros::std_plugins::VfrHudPlugin)
@@ -14,11 +14,22 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <cerrno>
 #include <chrono>
+#include <cmath>
 #include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <sys/stat.h>
 #include <mavros/mavros_plugin.h>
+#include <mavros/mission_id.h>
+#include <mavros/request_window.h>
 
 #include <mavros_msgs/msg/waypoint_list.hpp>
+#include <mavros_msgs/msg/waypoint_progress.hpp>
 #include <mavros_msgs/srv/waypoint_set_current.hpp>
 #include <mavros_msgs/srv/waypoint_clear.hpp>
 #include <mavros_msgs/srv/waypoint_pull.hpp>
@@ -113,6 +124,77 @@ public:
 		return ret;
 	}
 
+	//! MISSION_ITEM_INT x/y: global frames in 1e-7 deg, others in 1e-4 m
+	static bool is_global_frame(uint8_t frame)
+	{
+		switch (frame) {
+		case enum_value(MAV_FRAME::GLOBAL):
+		case enum_value(MAV_FRAME::GLOBAL_RELATIVE_ALT):
+		case enum_value(MAV_FRAME::GLOBAL_INT):
+		case enum_value(MAV_FRAME::GLOBAL_RELATIVE_ALT_INT):
+		case enum_value(MAV_FRAME::GLOBAL_TERRAIN_ALT):
+		case enum_value(MAV_FRAME::GLOBAL_TERRAIN_ALT_INT):
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	mavlink::common::msg::MISSION_ITEM_INT to_mission_item_int() const
+	{
+		mavlink::common::msg::MISSION_ITEM_INT ret{};
+		double scale = is_global_frame(frame) ? 1e7 : 1e4;
+
+		ret.seq = seq;
+		ret.frame = frame;
+		ret.command = command;
+		ret.current = current;
+		ret.autocontinue = autocontinue;
+		ret.param1 = param1;
+		ret.param2 = param2;
+		ret.param3 = param3;
+		ret.param4 = param4;
+		ret.x = std::lround(x_lat * scale);
+		ret.y = std::lround(y_long * scale);
+		ret.z = z_alt;
+		ret.mission_type = mission_type;
+
+		return ret;
+	}
+
+	static WaypointItem from_mission_item_int(const mavlink::common::msg::MISSION_ITEM_INT &wpi)
+	{
+		WaypointItem ret{};
+		double scale = is_global_frame(wpi.frame) ? 1e7 : 1e4;
+
+		ret.seq = wpi.seq;
+		ret.frame = wpi.frame;
+		ret.command = wpi.command;
+		ret.current = wpi.current;
+		ret.autocontinue = wpi.autocontinue;
+		ret.param1 = wpi.param1;
+		ret.param2 = wpi.param2;
+		ret.param3 = wpi.param3;
+		ret.param4 = wpi.param4;
+		ret.x_lat = wpi.x / scale;
+		ret.y_long = wpi.y / scale;
+		ret.z_alt = wpi.z;
+		ret.x = ret.x_lat;
+		ret.y = ret.y_long;
+		ret.z = ret.z_alt;
+		ret.mission_type = wpi.mission_type;
+
+		return ret;
+	}
+
+	//! Same mission item, current flag is not compared
+	bool same_item(const WaypointItem &o) const
+	{
+		return frame == o.frame && command == o.command && autocontinue == o.autocontinue &&
+		       param1 == o.param1 && param2 == o.param2 && param3 == o.param3 && param4 == o.param4 &&
+		       x_lat == o.x_lat && y_long == o.y_long && z_alt == o.z_alt;
+	}
+
 	std::string to_string()
 	{
 		//return to_yaml();
@@ -127,6 +209,129 @@ public:
 };
 
 
+/**
+ * @brief Mission id reported by FCU in MISSION_COUNT and MISSION_ACK, 0 if unknown
+ *
+ * opaque_id extension field is missing in older MAVLink, then the cache is never used.
+ */
+template<class _T>
+static auto mission_opaque_id(const _T &m, int) -> decltype(uint32_t(m.opaque_id))
+{
+	return m.opaque_id;
+}
+
+template<class _T>
+static uint32_t mission_opaque_id(const _T &m, long)
+{
+	return 0;
+}
+
+/**
+ * @brief Account MISSION_CURRENT.mission_id, FCU sends it periodically
+ *
+ * Field is missing in older MAVLink, then only transfers report the id.
+ */
+template<class _T>
+static auto report_mission_current(MissionIdTracker &t, const _T &m, MissionIdTracker::clock::time_point now, int)
+	-> decltype(void(m.mission_id))
+{
+	t.report(m.mission_id, now);
+}
+
+template<class _T>
+static void report_mission_current(MissionIdTracker &t, const _T &m, MissionIdTracker::clock::time_point now, long)
+{ }
+
+
+/**
+ * @brief On-disk copy of FCU mission
+ *
+ * One file per FCU UID. It is valid while FCU reports the same mission opaque_id.
+ */
+class MissionCache {
+public:
+	static std::string file_name(const std::string &dir, uint64_t uid)
+	{
+		return utils::format("%s/%016llx.mission", dir.c_str(), (unsigned long long)uid);
+	}
+
+	/**
+	 * @brief Read cache
+	 * @return false if file is missing or broken
+	 */
+	static bool load(const std::string &fname, uint32_t &opaque_id, std::vector<WaypointItem> &items)
+	{
+		std::ifstream f(fname);
+		std::string line;
+
+		if (!std::getline(f, line) || line != HEADER)
+			return false;
+
+		if (!std::getline(f, line) || !(std::istringstream(line) >> opaque_id))
+			return false;
+
+		items.clear();
+		while (std::getline(f, line)) {
+			std::istringstream is(line);
+			WaypointItem wp{};
+			unsigned frame, current, autocontinue;
+
+			if (!(is >> wp.seq >> frame >> wp.command >> current >> autocontinue
+			      >> wp.param1 >> wp.param2 >> wp.param3 >> wp.param4
+			      >> wp.x_lat >> wp.y_long >> wp.z_alt))
+				return false;
+
+			if (wp.seq != items.size())
+				return false;
+
+			wp.frame = frame;
+			wp.current = current;
+			wp.autocontinue = autocontinue;
+			wp.x = wp.x_lat;
+			wp.y = wp.y_long;
+			wp.z = wp.z_alt;
+			wp.mission_type = enum_value(mavlink::common::MAV_MISSION_TYPE::MISSION);
+			items.push_back(wp);
+		}
+
+		return true;
+	}
+
+	/**
+	 * @brief Write cache, replaces old file at once
+	 */
+	static bool save(const std::string &dir, const std::string &fname, uint32_t opaque_id, const std::vector<WaypointItem> &items)
+	{
+		if (::mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+			return false;
+
+		auto tmp = fname + ".tmp";
+		{
+			std::ofstream f(tmp);
+			f << HEADER << "\n" << opaque_id << "\n";
+			f << std::setprecision(17);
+
+			for (auto &wp : items) {
+				f << wp.seq << " " << unsigned(wp.frame) << " " << wp.command << " "
+				  << unsigned(wp.current) << " " << unsigned(wp.autocontinue) << " "
+				  << wp.param1 << " " << wp.param2 << " " << wp.param3 << " " << wp.param4 << " "
+				  << wp.x_lat << " " << wp.y_long << " " << wp.z_alt << "\n";
+			}
+
+			if (!f)
+				return false;
+		}
+
+		return std::rename(tmp.c_str(), fname.c_str()) == 0;
+	}
+
+private:
+	static constexpr const char *HEADER = "# mavros mission cache v1";
+};
+
+constexpr const char *MissionCache::HEADER;
+
+
 /**
  * @brief Mission manupulation plugin
  */
@@ -141,8 +346,19 @@ public:
 		wp_cur_active(0),
 		wp_set_active(0),
 		is_timedout(false),
+		use_mission_int(false),
+		rx_window(1, RETRIES_COUNT, WP_TIMEOUT_MS),
+		tx_rtt(WP_TIMEOUT_MS),
+		tx_tries(0),
+		tx_as_int(false),
+		progress_reported(0),
+		wp_list_dirty(true),
+		rx_opaque_id(0),
+		cache_opaque_id(0),
+		cache_uid(0),
 		do_pull_after_gcs(false),
 		enable_partial_push(false),
+		pull_window(0),
 		reschedule_pull(false)
 	{ }
 
@@ -155,11 +371,16 @@ public:
 		wp_state = WP::IDLE;
 
 		wp_nh->get_parameter_or("mission/pull_after_gcs", do_pull_after_gcs, true);
+		// MISSION_REQUESTs in flight on pull, 0 - 8 for APM, 1 for others (they need sequential requests)
+		wp_nh->get_parameter_or("mission/pull_window", pull_window, 0);
+		// mission cache, empty - disabled
+		wp_nh->get_parameter_or<std::string>("mission/cache_dir", cache_dir, utils::default_cache_dir());
 
 		wp_list_pub = wp_nh->create_publisher<mavros_msgs::msg::WaypointList>("waypoints", 
-			rclcpp::QoS(2).reliable().transient_local());
+			rclcpp::QoS(2).reliable().transient_local(), latched_publisher_options());
 		wp_reached_pub = wp_nh->create_publisher<mavros_msgs::msg::WaypointReached>("reached", 
-			rclcpp::QoS(10).reliable().transient_local());
+			rclcpp::QoS(10).reliable().transient_local(), latched_publisher_options());
+		wp_progress_pub = wp_nh->create_publisher<mavros_msgs::msg::WaypointProgress>("progress", 10);
 		pull_srv = wp_nh->create_service<mavros_msgs::srv::WaypointPull>("pull", 
 			std::bind(&WaypointPlugin::pull_cb, this, std::placeholders::_1, std::placeholders::_2));
 		push_srv = wp_nh->create_service<mavros_msgs::srv::WaypointPush>("push", 
@@ -169,19 +390,19 @@ public:
 		set_cur_srv = wp_nh->create_service<mavros_msgs::srv::WaypointSetCurrent>("set_current", 
 			std::bind(&WaypointPlugin::set_cur_cb, this, std::placeholders::_1, std::placeholders::_2));
 
-		wp_timer = wp_nh->create_wall_timer(WP_TIMEOUT_MS, 
-			std::bind(&WaypointPlugin::timeout_cb, this));
-		wp_timer->cancel();
-		schedule_timer = wp_nh->create_wall_timer(BOOTUP_TIME_MS, 
-			std::bind(&WaypointPlugin::scheduled_pull_cb, this));
-		schedule_timer->cancel();
+		wp_timer = create_timer(std::bind(&WaypointPlugin::timeout_cb, this));
+		tick_timer = create_timer(std::bind(&WaypointPlugin::tick_cb, this));
+		schedule_timer = create_timer(std::bind(&WaypointPlugin::scheduled_pull_cb, this));
+		cache_timer = create_timer(std::bind(&WaypointPlugin::cache_flush, this));
 		enable_connection_cb();
 	}
 
 	Subscriptions get_subscriptions() {
 		return {
 			       make_handler(&WaypointPlugin::handle_mission_item),
+			       make_handler(&WaypointPlugin::handle_mission_item_int),
 			       make_handler(&WaypointPlugin::handle_mission_request),
+			       make_handler(&WaypointPlugin::handle_mission_request_int),
 			       make_handler(&WaypointPlugin::handle_mission_current),
 			       make_handler(&WaypointPlugin::handle_mission_count),
 			       make_handler(&WaypointPlugin::handle_mission_item_reached),
@@ -199,6 +420,7 @@ private:
 
 	rclcpp::Publisher<mavros_msgs::msg::WaypointList>::SharedPtr wp_list_pub;
 	rclcpp::Publisher<mavros_msgs::msg::WaypointReached>::SharedPtr wp_reached_pub;
+	rclcpp::Publisher<mavros_msgs::msg::WaypointProgress>::SharedPtr wp_progress_pub;
 	rclcpp::Service<mavros_msgs::srv::WaypointPull>::SharedPtr pull_srv;
 	rclcpp::Service<mavros_msgs::srv::WaypointPush>::SharedPtr push_srv;
 	rclcpp::Service<mavros_msgs::srv::WaypointClear>::SharedPtr clear_srv;
@@ -232,10 +454,41 @@ private:
 	std::condition_variable list_receiving;
 	std::condition_variable list_sending;
 
-	rclcpp::TimerBase::SharedPtr wp_timer;
-	rclcpp::TimerBase::SharedPtr schedule_timer;
+	bool use_mission_int;		//!< MISSION_REQUEST_INT for pull
+	RequestWindow rx_window;	//!< pull: received items and requests in flight
+	RttEstimator tx_rtt;		//!< push: MISSION_ITEM to next MISSION_REQUEST
+	RttEstimator::clock::time_point tx_sent;
+	RttEstimator::clock::time_point tx_deadline;
+	size_t tx_tries;
+	bool tx_as_int;			//!< FCU requested MISSION_ITEM_INT
+	size_t progress_reported;
+
+	mavros_msgs::msg::WaypointList wp_list;	//!< last published list
+	bool wp_list_dirty;		//!< waypoints changed, wp_list rebuild needed
+
+	std::string cache_dir;
+	uint32_t rx_opaque_id;		//!< from MISSION_COUNT of current pull
+	uint32_t cache_opaque_id;	//!< id of cached_mission, 0 - no cache
+	uint64_t cache_uid;		//!< FCU of cached_mission
+	std::vector<WaypointItem> cached_mission;
+	MissionIdTracker fcu_mission_id;	//!< what FCU has now, other GCS may change it
+
+	//! Mission copy waiting for cache_flush(), file is written out of message handler
+	struct CacheWrite {
+		std::string fname;
+		uint32_t opaque_id;
+		std::vector<WaypointItem> items;
+	};
+	std::mutex cache_write_mutex;
+	std::unique_ptr<CacheWrite> cache_write;	//!< guarded by cache_write_mutex
+
+	TimerWheel::Ptr wp_timer;
+	TimerWheel::Ptr tick_timer;	//!< item timeouts in RXWP, TXWP
+	TimerWheel::Ptr schedule_timer;	//!< one-shot
+	TimerWheel::Ptr cache_timer;	//!< writes staged cache file
 	bool do_pull_after_gcs;
 	bool enable_partial_push;
+	int pull_window;
 
 	bool reschedule_pull;
 
@@ -244,10 +497,17 @@ private:
 	static constexpr std::chrono::milliseconds LIST_TIMEOUT_MS = 30000ms;	//! Timeout for pull/push operations
 	static constexpr std::chrono::milliseconds WP_TIMEOUT_MS = 1000ms;
 	static constexpr std::chrono::milliseconds RESCHEDULE_MS = 5000ms;
+	static constexpr std::chrono::milliseconds TICK_MS = 20ms;		//! item timeout check period
 	static constexpr int RETRIES_COUNT = 3;
 
 	/* -*- rx handlers -*- */
 
+	//! Fence and rally transfers use the same messages, they are handled by other plugins
+	static bool is_mission(uint8_t mission_type)
+	{
+		return mission_type == enum_value(mavlink::common::MAV_MISSION_TYPE::MISSION);
+	}
+
 	/**
 	 * @brief handle MISSION_ITEM mavlink msg
 	 * handles and stores mission items when pulling waypoints
@@ -256,7 +516,8 @@ private:
 	 */
 	void handle_mission_item(const mavlink::mavlink_message_t *msg, WaypointItem &wpi)
 	{
-		unique_lock lock(mutex);
+		if (!is_mission(wpi.mission_type))
+			return;
 
 		// WaypointItem has wider fields for Lat/Long/Alt, set it
 		// [[[cog:
@@ -268,26 +529,49 @@ private:
 		wpi.z_alt = wpi.z;
 		// [[[end]]] (checksum: b8f95ce9c7c9dbd4eb493bf1227f273f)
 
+		receive_item(wpi);
+	}
+
+	/**
+	 * @brief handle MISSION_ITEM_INT mavlink msg
+	 * @param msg		Received Mavlink msg
+	 * @param wpi		MISSION_ITEM_INT from msg
+	 */
+	void handle_mission_item_int(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::MISSION_ITEM_INT &wpi)
+	{
+		if (!is_mission(wpi.mission_type))
+			return;
+
+		auto item = WaypointItem::from_mission_item_int(wpi);
+		receive_item(item);
+	}
+
+	//! Store pulled item, items may come out of order when prefetching
+	void receive_item(WaypointItem &wpi)
+	{
+		unique_lock lock(mutex);
+
 		/* receive item only in RX state */
 		if (wp_state == WP::RXWP) {
-			if (wpi.seq != wp_cur_id) {
-				RCLCPP_WARN(logger, "WP: Seq mismatch, dropping item (%d != %zu)",
-					wpi.seq, wp_cur_id);
+			if (!rx_window.received(wpi.seq, RttEstimator::clock::now())) {
+				RCLCPP_DEBUG(logger, "WP: dropping duplicate or out of range item #%d", wpi.seq);
 				return;
 			}
 
-			RCLCPP_INFO_STREAM(logger, "WP: item " << wpi.to_string());
+			RCLCPP_DEBUG_STREAM(logger, "WP: item " << wpi.to_string());
 
-			waypoints.push_back(wpi);
-			if (++wp_cur_id < wp_count) {
-				restart_timeout_timer();
-				mission_request(wp_cur_id);
-			}
-			else {
+			waypoints[wpi.seq] = wpi;
+			publish_progress(mavros_msgs::msg::WaypointProgress::DIRECTION_PULL,
+					wp_count, wp_count - rx_window.missing(), rx_window.rtt_estimator());
+
+			if (rx_window.missing() == 0) {
+				save_cache(rx_opaque_id);
 				request_mission_done();
 				lock.unlock();
 				publish_waypoints();
 			}
+			else
+				pull_poll();
 		}
 		else {
 			RCLCPP_DEBUG(logger, "WP: rejecting item, wrong state %d", enum_value(wp_state));
@@ -304,23 +588,61 @@ private:
 	 * @param msg		Received Mavlink msg
 	 * @param mreq		MISSION_REQUEST from msg
 	 */
-	void handle_mission_request(const mavlink::mavlink_message_t *msg, mavlink::common::msg::MISSION_REQUEST &mreq)
+	void handle_mission_request(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::MISSION_REQUEST &mreq)
+	{
+		if (is_mission(mreq.mission_type))
+			answer_request(mreq.seq, false);
+	}
+
+	/**
+	 * @brief handle MISSION_REQUEST_INT mavlink msg
+	 * Same as MISSION_REQUEST, but FCU wants MISSION_ITEM_INT
+	 * @param msg		Received Mavlink msg
+	 * @param mreq		MISSION_REQUEST_INT from msg
+	 */
+	void handle_mission_request_int(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::MISSION_REQUEST_INT &mreq)
+	{
+		if (is_mission(mreq.mission_type))
+			answer_request(mreq.seq, true);
+	}
+
+	void answer_request(uint16_t seq, bool as_int)
 	{
 		lock_guard lock(mutex);
 
-		if ((wp_state == WP::TXLIST && mreq.seq == 0) || (wp_state == WP::TXPARTIAL && mreq.seq == wp_start_id) || (wp_state == WP::TXWP)) {
-			if (mreq.seq != wp_cur_id && mreq.seq != wp_cur_id + 1) {
+		if ((wp_state == WP::TXLIST && seq == 0) || (wp_state == WP::TXPARTIAL && seq == wp_start_id) || (wp_state == WP::TXWP)) {
+			if (seq != wp_cur_id && seq != wp_cur_id + 1) {
 				RCLCPP_WARN(logger, "WP: Seq mismatch, dropping request (%d != %zu)",
-					mreq.seq, wp_cur_id);
+					seq, wp_cur_id);
 				return;
 			}
 
-			restart_timeout_timer();
-			if (mreq.seq < wp_end_id) {
-				RCLCPP_DEBUG(logger, "WP: FCU requested waypoint %d", mreq.seq);
+			auto now = RttEstimator::clock::now();
+
+			// request of next item acks previous one, resent items are not sampled
+			if (wp_state == WP::TXWP && seq == wp_cur_id + 1 && tx_tries == 1)
+				tx_rtt.sample(now - tx_sent);
+
+			if (seq < wp_end_id) {
+				RCLCPP_DEBUG(logger, "WP: FCU requested waypoint %d", seq);
+				if (wp_state != WP::TXWP) {
+					// item timeouts are tracked by tick_cb from now
+					wp_timer->cancel();
+					tick_timer->start_periodic(TICK_MS);
+					if (tx_rtt.srtt().count() == 0)
+						tx_rtt = RttEstimator(initial_item_timeout());
+				}
+
 				wp_state = WP::TXWP;
-				wp_cur_id = mreq.seq;
-				send_waypoint(wp_cur_id);
+				wp_cur_id = seq;
+				tx_as_int = as_int;
+				tx_sent = now;
+				tx_tries = 1;
+				tx_deadline = now + tx_rtt.timeout(tx_tries);
+				send_waypoint(wp_cur_id, tx_as_int);
+
+				publish_progress(mavros_msgs::msg::WaypointProgress::DIRECTION_PUSH,
+						wp_count, wp_cur_id - wp_start_id, tx_rtt);
 			}
 			else
 				RCLCPP_ERROR(logger, "WP: FCU require seq out of range");
@@ -335,10 +657,12 @@ private:
 	 * @param msg		Received Mavlink msg
 	 * @param mcur		MISSION_CURRENT from msg
 	 */
-	void handle_mission_current(const mavlink::mavlink_message_t *msg, mavlink::common::msg::MISSION_CURRENT &mcur)
+	void handle_mission_current(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::MISSION_CURRENT &mcur)
 	{
 		unique_lock lock(mutex);
 
+		report_mission_current(fcu_mission_id, mcur, MissionIdTracker::clock::now(), 0);
+
 		if (wp_state == WP::SET_CUR) {
 			/* MISSION_SET_CURRENT ACK */
 			RCLCPP_DEBUG(logger, "WP: set current #%d done", mcur.seq);
@@ -368,24 +692,53 @@ private:
 	 * @param msg		Received Mavlink msg
 	 * @param mcnt		MISSION_COUNT from msg
 	 */
-	void handle_mission_count(const mavlink::mavlink_message_t *msg, mavlink::common::msg::MISSION_COUNT &mcnt)
+	void handle_mission_count(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::MISSION_COUNT &mcnt)
 	{
+		if (!is_mission(mcnt.mission_type))
+			return;
+
 		unique_lock lock(mutex);
 
+		// also sent to other GCS, it names the mission FCU has
+		fcu_mission_id.report(mission_opaque_id(mcnt, 0), MissionIdTracker::clock::now());
+
 		if (wp_state == WP::RXLIST) {
 			/* FCU report of MISSION_REQUEST_LIST */
 			RCLCPP_DEBUG(logger, "WP: count %d", mcnt.count);
 
 			wp_count = mcnt.count;
 			wp_cur_id = 0;
+			rx_opaque_id = mission_opaque_id(mcnt, 0);
+
+			// FCU has the mission we know, skip items transfer
+			if (cache_loaded() && rx_opaque_id != 0 && rx_opaque_id == cache_opaque_id &&
+					cached_mission.size() == wp_count) {
+				RCLCPP_INFO(logger, "WP: mission id 0x%08x matches cache, %zu items", rx_opaque_id, wp_count);
+				waypoints = cached_mission;
+				set_current_waypoint(wp_cur_active);
+				wp_list_dirty = true;
+
+				request_mission_done();
+				lock.unlock();
+				publish_waypoints();
+				return;
+			}
 
-			waypoints.clear();
-			waypoints.reserve(wp_count);
+			// slots are filled as items arrive
+			waypoints.assign(wp_count, WaypointItem{});
+			wp_list_dirty = true;
 
 			if (wp_count > 0) {
 				wp_state = WP::RXWP;
-				restart_timeout_timer();
-				mission_request(wp_cur_id);
+				wp_timer->cancel();
+
+				auto timeout = (rx_window.rtt_estimator().srtt().count() == 0)
+					? initial_item_timeout() : rx_window.timeout();
+				rx_window = RequestWindow(get_pull_window(), RETRIES_COUNT, timeout);
+				rx_window.reset(wp_count);
+				progress_reported = 0;
+				tick_timer->start_periodic(TICK_MS);
+				pull_poll();
 			}
 			else {
 				request_mission_done();
@@ -409,7 +762,7 @@ private:
 	 * @param msg		Received Mavlink msg
 	 * @param mitr		MISSION_ITEM_REACHED from msg
 	 */
-	void handle_mission_item_reached(const mavlink::mavlink_message_t *msg, mavlink::common::msg::MISSION_ITEM_REACHED &mitr)
+	void handle_mission_item_reached(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::MISSION_ITEM_REACHED &mitr)
 	{
 		/* in QGC used as informational message */
 		RCLCPP_INFO(logger, "WP: reached #%d", mitr.seq);
@@ -428,18 +781,29 @@ private:
 	 * @param msg		Received Mavlink msg
 	 * @param mack		MISSION_ACK from msg
 	 */
-	void handle_mission_ack(const mavlink::mavlink_message_t *msg, mavlink::common::msg::MISSION_ACK &mack)
+	void handle_mission_ack(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::MISSION_ACK &mack)
 	{
+		if (!is_mission(mack.mission_type))
+			return;
+
 		unique_lock lock(mutex);
 
 		auto ack_type = static_cast<MRES>(mack.type);
 
+		// accepted upload or clear, ours or of other GCS
+		if (ack_type == MRES::ACCEPTED)
+			fcu_mission_id.report(mission_opaque_id(mack, 0), MissionIdTracker::clock::now());
+
 		if ((wp_state == WP::TXLIST || wp_state == WP::TXPARTIAL || wp_state == WP::TXWP)
 			&& (wp_cur_id == wp_end_id - 1)
 			&& (ack_type == MRES::ACCEPTED)) {
 			go_idle();
-			waypoints = send_waypoints;
+			waypoints = std::move(send_waypoints);
 			send_waypoints.clear();
+			wp_list_dirty = true;
+			save_cache(mission_opaque_id(mack, 0));
+			publish_progress(mavros_msgs::msg::WaypointProgress::DIRECTION_PUSH,
+					wp_count, wp_count, tx_rtt);
 
 			lock.unlock();
 			list_sending.notify_all();
@@ -470,6 +834,8 @@ private:
 			}
 			else {
 				waypoints.clear();
+				wp_list_dirty = true;
+				save_cache(mission_opaque_id(mack, 0));
 				lock.unlock();
 				publish_waypoints();
 				RCLCPP_INFO(logger, "WP: mission cleared");
@@ -499,7 +865,7 @@ private:
 				mission_request_list();
 				break;
 			case WP::RXWP:
-				mission_request(wp_cur_id);
+				// items are resent by tick_cb
 				break;
 			case WP::TXLIST:
 				mission_count(wp_count);
@@ -508,7 +874,7 @@ private:
 				mission_write_partial_list(wp_start_id, wp_end_id);
 				break;
 			case WP::TXWP:
-				send_waypoint(wp_cur_id);
+				send_waypoint(wp_cur_id, tx_as_int);
 				break;
 			case WP::CLEAR:
 				mission_clear_all();
@@ -534,6 +900,93 @@ private:
 		}
 	}
 
+	/**
+	 * @brief Per item timeouts of pull and push
+	 *
+	 * Item timeout follows measured round trip, so it is shorter than WP_TIMEOUT_MS on fast links.
+	 */
+	void tick_cb()
+	{
+		unique_lock lock(mutex);
+
+		if (wp_state == WP::RXWP) {
+			pull_poll();
+		}
+		else if (wp_state == WP::TXWP) {
+			auto now = RttEstimator::clock::now();
+			if (now < tx_deadline)
+				return;
+
+			if (tx_tries <= size_t(RETRIES_COUNT)) {
+				RCLCPP_WARN(logger, "WP: item #%zu timeout, retries left %zu",
+						wp_cur_id, RETRIES_COUNT + 1 - tx_tries);
+				tx_tries++;
+				tx_sent = now;
+				tx_deadline = now + tx_rtt.timeout(tx_tries);
+				send_waypoint(wp_cur_id, tx_as_int);
+			}
+			else {
+				RCLCPP_ERROR(logger, "WP: timed out.");
+				go_idle();
+				is_timedout = true;
+				lock.unlock();
+				list_sending.notify_all();
+			}
+		}
+		else
+			tick_timer->cancel();
+	}
+
+	//! Resend timed out requests, keep window full
+	void pull_poll()
+	{
+		auto lost = rx_window.poll(RttEstimator::clock::now(),
+				[this](uint16_t seq) { mission_request(seq); });
+
+		if (lost > 0) {
+			RCLCPP_ERROR(logger, "WP: timed out, %zu of %zu items missing", rx_window.missing(), wp_count);
+
+			// keep received head of mission only
+			size_t n = 0;
+			while (n < waypoints.size() && rx_window.is_received(n))
+				n++;
+			waypoints.resize(n);
+			wp_list_dirty = true;
+
+			go_idle();
+			is_timedout = true;
+			list_receiving.notify_all();
+		}
+	}
+
+	//! Pull window: APM answers MISSION_REQUEST in any order, PX4 wants sequential ones
+	size_t get_pull_window()
+	{
+		if (pull_window > 0)
+			return pull_window;
+
+		return m_uas->is_ardupilotmega() ? 8 : 1;
+	}
+
+	void publish_progress(uint8_t direction, size_t count, size_t transferred, const RttEstimator &rtt)
+	{
+		// about 1% steps
+		size_t step = std::max<size_t>(count / 100, 1);
+		if (transferred < count && transferred < progress_reported + step && transferred != 0)
+			return;
+
+		progress_reported = transferred;
+
+		auto wpp = std::make_unique<mavros_msgs::msg::WaypointProgress>();
+		wpp->header.stamp = wp_nh->get_clock()->now();
+		wpp->direction = direction;
+		wpp->count = count;
+		wpp->transferred = transferred;
+		wpp->rtt = std::chrono::duration<float>(rtt.srtt()).count();
+
+		wp_progress_pub->publish(std::move(wpp));
+	}
+
 	// Act on first heartbeat from FCU
 	void connection_cb(bool connected) override
 	{
@@ -550,12 +1003,16 @@ private:
 		}
 		else {
 			schedule_timer->cancel();
+			fcu_mission_id.reset();
 		}
 	}
 
 	//! @brief Callback for scheduled waypoint pull
 	void scheduled_pull_cb()
 	{
+		// before pull, so MISSION_COUNT is compared with cache in memory
+		load_cache();
+
 		lock_guard lock(mutex);
 		if (wp_state != WP::IDLE) {
 			/* try later */
@@ -567,6 +1024,7 @@ private:
 		RCLCPP_DEBUG(logger, "WP: start scheduled pull");
 		wp_state = WP::RXLIST;
 		wp_count = 0;
+		use_mission_int = mission_int_supported();
 		restart_timeout_timer();
 		mission_request_list();
 	}
@@ -587,6 +1045,156 @@ private:
 		reschedule_pull = false;
 		wp_state = WP::IDLE;
 		wp_timer->cancel();
+		tick_timer->cancel();
+	}
+
+	/* -*- mission cache -*- */
+
+	std::string cache_file_name()
+	{
+		auto uid = m_uas->get_fcu_uid();
+		if (cache_dir.empty() || uid == 0)
+			return "";
+
+		return MissionCache::file_name(cache_dir, uid);
+	}
+
+	//! Cache of current FCU is in memory
+	bool cache_loaded()
+	{
+		return cache_uid == m_uas->get_fcu_uid() && cache_opaque_id != 0;
+	}
+
+	/**
+	 * @brief Make sure cache of current FCU is loaded
+	 *
+	 * Reads file, so it is called by timer and service callbacks
+	 * without plugin mutex, message handlers only use cache_loaded().
+	 */
+	void load_cache()
+	{
+		{
+			lock_guard lock(mutex);
+			if (cache_loaded())
+				return;
+		}
+
+		auto uid = m_uas->get_fcu_uid();
+		auto fname = cache_file_name();
+		uint32_t opaque_id = 0;
+		std::vector<WaypointItem> items;
+		if (fname.empty() || !MissionCache::load(fname, opaque_id, items))
+			opaque_id = 0;
+
+		lock_guard lock(mutex);
+		// pull or push done meanwhile is newer than file
+		if (cache_loaded())
+			return;
+
+		cache_uid = uid;
+		cache_opaque_id = opaque_id;
+		cached_mission = std::move(items);
+		if (opaque_id == 0)
+			cached_mission.clear();
+	}
+
+	//! Remember waypoints as mission @a opaque_id, 0 - FCU does not report id
+	void save_cache(uint32_t opaque_id)
+	{
+		cache_uid = m_uas->get_fcu_uid();
+		cache_opaque_id = opaque_id;
+		cached_mission = waypoints;
+
+		auto fname = cache_file_name();
+		if (opaque_id == 0 || fname.empty())
+			return;
+
+		auto cw = std::make_unique<CacheWrite>();
+		cw->fname = fname;
+		cw->opaque_id = opaque_id;
+		cw->items = waypoints;
+		{
+			std::lock_guard<std::mutex> lock(cache_write_mutex);
+			cache_write = std::move(cw);
+		}
+
+		// newer mission replaces one not written yet
+		if (!cache_timer->is_armed())
+			cache_timer->start(TimerWheel::clock::duration::zero());
+	}
+
+	/**
+	 * @brief Write staged mission copy to cache file
+	 *
+	 * Runs on timer wheel thread, so mission handlers on IO thread
+	 * do not wait for disk. Should be called without plugin mutex.
+	 */
+	void cache_flush()
+	{
+		std::unique_ptr<CacheWrite> cw;
+		{
+			std::lock_guard<std::mutex> lock(cache_write_mutex);
+			cw = std::move(cache_write);
+		}
+
+		if (!cw)
+			return;
+
+		if (!MissionCache::save(cache_dir, cw->fname, cw->opaque_id, cw->items))
+			RCLCPP_WARN(logger, "WP: failed to write mission cache: %s", cw->fname.c_str());
+	}
+
+	//! FCU recently reported id of cached_mission, so it is what FCU has
+	bool cache_confirmed()
+	{
+		return cache_loaded() && fcu_mission_id.confirms(cache_opaque_id, MissionIdTracker::clock::now());
+	}
+
+	/**
+	 * @brief Find range of @a req which differs from cached mission
+	 * @return false if size differs or FCU did not confirm the cache, then full push is needed
+	 */
+	bool find_changed_range(const std::vector<mavros_msgs::msg::Waypoint> &req, size_t &start, size_t &end)
+	{
+		if (!cache_confirmed())
+			return false;
+
+		if (req.size() != cached_mission.size() || cached_mission.empty())
+			return false;
+
+		start = req.size();
+		end = 0;
+		for (size_t i = 0; i < req.size(); i++) {
+			auto wp = req[i];
+			if (!WaypointItem::from_msg(wp, i).same_item(cached_mission[i])) {
+				start = std::min(start, i);
+				end = i + 1;
+			}
+		}
+
+		if (start > end)
+			start = end = 0;
+
+		return true;
+	}
+
+	bool mission_int_supported()
+	{
+		return m_uas->get_capabilities() & enum_value(mavlink::common::MAV_PROTOCOL_CAPABILITY::MISSION_INT);
+	}
+
+	/**
+	 * Item timeout until its round trip is measured.
+	 * Follows probed RTT of FCU link if probe= is set in fcu_url, else WP_TIMEOUT_MS.
+	 */
+	RttEstimator::clock::duration initial_item_timeout()
+	{
+		auto link = UAS_FCU(m_uas);
+		auto probe = link ? link->get_link_probe() : nullptr;
+		if (!probe)
+			return WP_TIMEOUT_MS;
+
+		return probe->timeout(WP_TIMEOUT_MS, RttEstimator::MIN_TIMEOUT, RttEstimator::MAX_TIMEOUT);
 	}
 
 	void restart_timeout_timer(void)
@@ -598,21 +1206,23 @@ private:
 	void restart_timeout_timer_int(void)
 	{
 		is_timedout = false;
-		wp_timer->reset();
+		wp_timer->start_periodic(WP_TIMEOUT_MS);
 	}
 
 	void schedule_pull(std::chrono::milliseconds dt)
 	{
-		schedule_timer = wp_nh->create_wall_timer(dt, 
-			std::bind(&WaypointPlugin::scheduled_pull_cb, this));
+		schedule_timer->start(dt);
 	}
 
 	//! @brief send a single waypoint to FCU
-	void send_waypoint(size_t seq)
+	void send_waypoint(size_t seq, bool as_int)
 	{
 		if (seq < send_waypoints.size()) {
-			auto wpi = send_waypoints.at(seq);
-			mission_item(wpi);
+			auto &wpi = send_waypoints[seq];
+			if (as_int)
+				mission_item_int(wpi);
+			else
+				mission_item(wpi);
 
 			RCLCPP_DEBUG_STREAM(logger, "WP: send item " << wpi.to_string());
 		}
@@ -648,21 +1258,35 @@ private:
 	{
 		for (auto &it : waypoints)
 			it.current = (it.seq == seq) ? true : false;
+
+		if (!wp_list_dirty) {
+			for (size_t i = 0; i < wp_list.waypoints.size(); i++)
+				wp_list.waypoints[i].is_current = waypoints[i].current;
+		}
 	}
 
-	//! @brief publish the updated waypoint list after operation
+	/**
+	 * @brief publish the updated waypoint list after operation
+	 *
+	 * List message is rebuilt only when the mission changed, current item updates reuse it.
+	 */
 	void publish_waypoints()
 	{
-		auto wpl = std::make_unique<mavros_msgs::msg::WaypointList>();
 		unique_lock lock(mutex);
 
-		wpl->current_seq = wp_cur_active;
-		wpl->waypoints.clear();
-		wpl->waypoints.reserve(waypoints.size());
-		for (auto &it : waypoints) {
-			wpl->waypoints.push_back(it.to_msg());
+		if (wp_list_dirty) {
+			wp_list.waypoints.clear();
+			wp_list.waypoints.reserve(waypoints.size());
+			for (auto &it : waypoints) {
+				wp_list.waypoints.push_back(it.to_msg());
+			}
+
+			wp_list_dirty = false;
 		}
 
+		wp_list.current_seq = wp_cur_active;
+		auto wpl = std::make_unique<mavros_msgs::msg::WaypointList>(wp_list);
+
 		lock.unlock();
 		wp_list_pub->publish(std::move(wpl));
 	}
@@ -676,10 +1300,26 @@ private:
 		UAS_FCU(m_uas)->send_message_ignore_drop(wp);
 	}
 
+	void mission_item_int(const WaypointItem &wp)
+	{
+		auto wpi = wp.to_mission_item_int();
+		m_uas->msg_set_target(wpi);
+		UAS_FCU(m_uas)->send_message_ignore_drop(wpi);
+	}
+
 	void mission_request(uint16_t seq)
 	{
 		RCLCPP_DEBUG(logger, "WP:m: request #%u", seq);
 
+		if (use_mission_int) {
+			mavlink::common::msg::MISSION_REQUEST_INT mrq {};
+			m_uas->msg_set_target(mrq);
+			mrq.seq = seq;
+
+			UAS_FCU(m_uas)->send_message_ignore_drop(mrq);
+			return;
+		}
+
 		mavlink::common::msg::MISSION_REQUEST mrq {};
 		m_uas->msg_set_target(mrq);
 		mrq.seq = seq;
@@ -756,6 +1396,7 @@ private:
 	bool pull_cb(mavros_msgs::srv::WaypointPull::Request::SharedPtr req,
 		mavros_msgs::srv::WaypointPull::Response::SharedPtr res)
 	{
+		load_cache();
 		unique_lock lock(mutex);
 
 		if (wp_state != WP::IDLE)
@@ -764,6 +1405,7 @@ private:
 
 		wp_state = WP::RXLIST;
 		wp_count = 0;
+		use_mission_int = mission_int_supported();
 		restart_timeout_timer();
 
 		lock.unlock();
@@ -779,12 +1421,14 @@ private:
 	bool push_cb(mavros_msgs::srv::WaypointPush::Request::SharedPtr req,
 		mavros_msgs::srv::WaypointPush::Response::SharedPtr res)
 	{
+		load_cache();
 		unique_lock lock(mutex);
 
 		if (wp_state != WP::IDLE)
 			// Wrong initial state, other operation in progress?
 			return false;
 
+		size_t diff_start, diff_end;
 		if (req->start_index) {
 			// Partial Waypoint update
 
@@ -815,6 +1459,37 @@ private:
 			wp_start_id = req->start_index;
 			wp_end_id = req->start_index + wp_count;
 			wp_cur_id = req->start_index;
+			progress_reported = 0;
+			restart_timeout_timer();
+
+			lock.unlock();
+			mission_write_partial_list(wp_start_id, wp_end_id);
+			res->success = wait_push_all();
+			lock.lock();
+
+			res->wp_transfered = wp_cur_id - wp_start_id + 1;
+		}
+		else if (enable_partial_push && find_changed_range(req->waypoints, diff_start, diff_end)) {
+			// Full update, but only changed range is sent
+			if (diff_start == diff_end) {
+				RCLCPP_INFO(logger, "WP: mission unchanged, nothing to push");
+				res->success = true;
+				res->wp_transfered = 0;
+				return true;
+			}
+
+			RCLCPP_INFO(logger, "WP: pushing changed items %zu - %zu", diff_start, diff_end - 1);
+
+			wp_state = WP::TXPARTIAL;
+			send_waypoints = cached_mission;
+			for (size_t seq = diff_start; seq < diff_end; seq++)
+				send_waypoints[seq] = WaypointItem::from_msg(req->waypoints[seq], seq);
+
+			wp_count = diff_end - diff_start;
+			wp_start_id = diff_start;
+			wp_end_id = diff_end;
+			wp_cur_id = diff_start;
+			progress_reported = 0;
 			restart_timeout_timer();
 
 			lock.unlock();
@@ -836,8 +1511,10 @@ private:
 			}
 
 			wp_count = send_waypoints.size();
+			wp_start_id = 0;
 			wp_end_id = wp_count;
 			wp_cur_id = 0;
+			progress_reported = 0;
 			restart_timeout_timer();
 
 			lock.unlock();
@@ -898,10 +1575,11 @@ constexpr std::chrono::milliseconds WaypointPlugin::BOOTUP_TIME_MS;
 constexpr std::chrono::milliseconds WaypointPlugin::LIST_TIMEOUT_MS;
 constexpr std::chrono::milliseconds WaypointPlugin::WP_TIMEOUT_MS;
 constexpr std::chrono::milliseconds WaypointPlugin::RESCHEDULE_MS;
+constexpr std::chrono::milliseconds WaypointPlugin::TICK_MS;
 constexpr int WaypointPlugin::RETRIES_COUNT;
 
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::WaypointPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(waypoint, mavros::std_plugins::WaypointPlugin)
@@ -57,7 +57,7 @@ private:
 	/**
 	 * Handle APM specific wind estimation message
 	 */
-	void handle_apm_wind(const mavlink::mavlink_message_t *msg, mavlink::ardupilotmega::msg::WIND &wind)
+	void handle_apm_wind(const mavlink::mavlink_message_t *msg, const mavlink::ardupilotmega::msg::WIND &wind)
 	{
 		const double speed = wind.speed;
 		const double course = -angles::from_degrees(wind.direction);	// direction "from" -> direction "to"
@@ -80,7 +80,7 @@ private:
 	/**
 	 * Handle PX4 specific wind estimation message
 	 */
-	void handle_px4_wind(const mavlink::mavlink_message_t *msg, mavlink::common::msg::WIND_COV &wind)
+	void handle_px4_wind(const mavlink::mavlink_message_t *msg, const mavlink::common::msg::WIND_COV &wind)
 	{
 		auto twist_cov = std::make_shared<geometry_msgs::msg::TwistWithCovarianceStamped>();
 		twist_cov->header.stamp = m_uas->synchronise_stamp(wind.time_usec);
@@ -100,5 +100,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.hpp>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::WindEstimationPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(wind_estimation, mavros::std_plugins::WindEstimationPlugin)
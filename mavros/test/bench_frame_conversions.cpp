@@ -0,0 +1,191 @@
+/**
+ * Benchmark libmavros frame conversion, scalar vs batch,
+ * and scalar conversions used by most plugin handlers
+ *
+ * Not a test, not run by ctest:
+ *     libmavros-ftf-bench [--benchmark_filter=regex]
+ *
+ * Point cloud sized batches, e.g. OBSTACLE_DISTANCE or TRAJECTORY points.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+#include <mavros/frame_tf.h>
+
+using namespace mavros;
+
+static constexpr int POINTS = 256;
+
+static const auto Q = ftf::quaternion_from_rpy(0.1, -0.7, 2.3);
+
+static ftf::Vector3dBatch make_vectors()
+{
+	ftf::Vector3dBatch b(POINTS, 3);
+	b.setRandom();
+	return b;
+}
+
+static void BM_VectorStaticScalar(benchmark::State &state)
+{
+	auto batch = make_vectors();
+	std::vector<Eigen::Vector3d> in, out(POINTS);
+	for (int i = 0; i < POINTS; i++)
+		in.emplace_back(batch.row(i).transpose());
+
+	for (auto _ : state) {
+		for (int i = 0; i < POINTS; i++)
+			out[i] = ftf::transform_frame_ned_enu(in[i]);
+
+		benchmark::DoNotOptimize(out.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * POINTS);
+}
+BENCHMARK(BM_VectorStaticScalar);
+
+static void BM_VectorStaticBatch(benchmark::State &state)
+{
+	auto in = make_vectors();
+
+	for (auto _ : state) {
+		auto out = ftf::transform_frame_ned_enu(in);
+		benchmark::DoNotOptimize(out.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * POINTS);
+}
+BENCHMARK(BM_VectorStaticBatch);
+
+static void BM_VectorQuaternionScalar(benchmark::State &state)
+{
+	auto batch = make_vectors();
+	std::vector<Eigen::Vector3d> in, out(POINTS);
+	for (int i = 0; i < POINTS; i++)
+		in.emplace_back(batch.row(i).transpose());
+
+	for (auto _ : state) {
+		for (int i = 0; i < POINTS; i++)
+			out[i] = ftf::transform_frame_baselink_enu(in[i], Q);
+
+		benchmark::DoNotOptimize(out.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * POINTS);
+}
+BENCHMARK(BM_VectorQuaternionScalar);
+
+static void BM_VectorQuaternionBatch(benchmark::State &state)
+{
+	auto in = make_vectors();
+
+	for (auto _ : state) {
+		auto out = ftf::transform_frame_baselink_enu(in, Q);
+		benchmark::DoNotOptimize(out.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * POINTS);
+}
+BENCHMARK(BM_VectorQuaternionBatch);
+
+static void BM_Covariance6dQuaternionScalar(benchmark::State &state)
+{
+	std::vector<ftf::Covariance6d> in(POINTS), out(POINTS);
+	for (auto &c : in)
+		ftf::EigenMapCovariance6d(c.data()).setRandom();
+
+	for (auto _ : state) {
+		for (int i = 0; i < POINTS; i++)
+			out[i] = ftf::transform_frame_baselink_enu(in[i], Q);
+
+		benchmark::DoNotOptimize(out.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * POINTS);
+}
+BENCHMARK(BM_Covariance6dQuaternionScalar);
+
+static void BM_Covariance6dQuaternionBatch(benchmark::State &state)
+{
+	ftf::Covariance6dBatch in(POINTS, 36);
+	in.setRandom();
+
+	for (auto _ : state) {
+		auto out = ftf::transform_frame_baselink_enu(in, Q);
+		benchmark::DoNotOptimize(out.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * POINTS);
+}
+BENCHMARK(BM_Covariance6dQuaternionBatch);
+
+static void BM_Covariance9dStaticScalar(benchmark::State &state)
+{
+	std::vector<ftf::Covariance9d> in(POINTS), out(POINTS);
+	for (auto &c : in)
+		ftf::EigenMapCovariance9d(c.data()).setRandom();
+
+	for (auto _ : state) {
+		for (int i = 0; i < POINTS; i++)
+			out[i] = ftf::transform_frame_ned_enu(in[i]);
+
+		benchmark::DoNotOptimize(out.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * POINTS);
+}
+BENCHMARK(BM_Covariance9dStaticScalar);
+
+static void BM_Covariance9dQuaternionScalar(benchmark::State &state)
+{
+	std::vector<ftf::Covariance9d> in(POINTS), out(POINTS);
+	for (auto &c : in)
+		ftf::EigenMapCovariance9d(c.data()).setRandom();
+
+	for (auto _ : state) {
+		for (int i = 0; i < POINTS; i++)
+			out[i] = ftf::transform_frame_baselink_enu(in[i], Q);
+
+		benchmark::DoNotOptimize(out.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * POINTS);
+}
+BENCHMARK(BM_Covariance9dQuaternionScalar);
+
+static void BM_OrientationStatic(benchmark::State &state)
+{
+	std::vector<Eigen::Quaterniond> in, out(POINTS);
+	for (int i = 0; i < POINTS; i++)
+		in.push_back(Eigen::Quaterniond::UnitRandom());
+
+	for (auto _ : state) {
+		for (int i = 0; i < POINTS; i++)
+			out[i] = ftf::transform_orientation_aircraft_baselink(ftf::transform_orientation_ned_enu(in[i]));
+
+		benchmark::DoNotOptimize(out.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * POINTS);
+}
+BENCHMARK(BM_OrientationStatic);
+
+static void BM_QuaternionToRPY(benchmark::State &state)
+{
+	std::vector<Eigen::Quaterniond> in;
+	std::vector<Eigen::Vector3d> out(POINTS);
+	for (int i = 0; i < POINTS; i++)
+		in.push_back(Eigen::Quaterniond::UnitRandom());
+
+	for (auto _ : state) {
+		for (int i = 0; i < POINTS; i++)
+			out[i] = ftf::quaternion_to_rpy(in[i]);
+
+		benchmark::DoNotOptimize(out.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * POINTS);
+}
+BENCHMARK(BM_QuaternionToRPY);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,108 @@
+/**
+ * Benchmark libmavros message decoding and mavlink_convert
+ *
+ * Not a test, not run by ctest:
+ *     libmavros-decode-bench [--benchmark_filter=regex]
+ *
+ * Decode: MessageDecoder running for typed make_handler() subscriptions.
+ * Convert: mavlink_message_t <-> mavros_msgs/Mavlink, for ~/mavlink/from and ~/mavlink/to.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+#include <mavros/plugin_dispatch.h>
+#include <mavros_msgs/mavlink_convert.h>
+
+using namespace mavros;
+using mavlink::mavlink_message_t;
+using namespace mavlink::common::msg;
+
+template<class _T>
+static mavlink_message_t make_frame()
+{
+	_T obj {};
+	mavlink_message_t msg {};
+	mavlink::MsgMap map(msg);
+	obj.serialize(map);
+
+	auto mi = obj.get_message_info();
+	mavlink::mavlink_status_t status {};
+	mavlink::mavlink_finalize_message_buffer(&msg, 1, 1, &status, mi.min_length, mi.length, mi.crc_extra);
+	return msg;
+}
+
+template<class _T>
+static void BM_Decode(benchmark::State &state)
+{
+	auto msg = make_frame<_T>();
+	auto decoder = MessageDecoder::get<_T>();
+	std::vector<std::max_align_t> storage(decoder->size / sizeof(std::max_align_t) + 1);
+
+	for (auto _ : state) {
+		decoder->decode(&msg, storage.data());
+		benchmark::DoNotOptimize(storage.data());
+		decoder->destroy(storage.data());
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_Decode, HEARTBEAT);
+BENCHMARK_TEMPLATE(BM_Decode, ATTITUDE_QUATERNION);
+BENCHMARK_TEMPLATE(BM_Decode, HIGHRES_IMU);
+BENCHMARK_TEMPLATE(BM_Decode, LOCAL_POSITION_NED);
+BENCHMARK_TEMPLATE(BM_Decode, GLOBAL_POSITION_INT);
+BENCHMARK_TEMPLATE(BM_Decode, GPS_RAW_INT);
+BENCHMARK_TEMPLATE(BM_Decode, ODOMETRY);
+BENCHMARK_TEMPLATE(BM_Decode, STATUSTEXT);
+
+template<class _T>
+static void BM_ConvertToRos(benchmark::State &state)
+{
+	auto msg = make_frame<_T>();
+	mavros_msgs::msg::Mavlink rmsg;
+
+	for (auto _ : state) {
+		mavros_msgs::mavlink::convert(msg, rmsg);
+		benchmark::DoNotOptimize(rmsg.payload64.data());
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_ConvertToRos, HEARTBEAT);
+BENCHMARK_TEMPLATE(BM_ConvertToRos, ODOMETRY);
+
+//! Batch of received frames, as link Rx callback converts them
+static void BM_ConvertToRosBatch(benchmark::State &state)
+{
+	std::vector<mavlink_message_t> msgs(64, make_frame<HIGHRES_IMU>());
+	std::vector<uint8_t> framings(msgs.size(), mavros_msgs::msg::Mavlink::FRAMING_OK);
+	std::vector<mavros_msgs::msg::Mavlink> rmsgs;
+
+	for (auto _ : state) {
+		mavros_msgs::mavlink::convert(msgs.data(), framings.data(), msgs.size(), rmsgs);
+		benchmark::DoNotOptimize(rmsgs.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * msgs.size());
+}
+BENCHMARK(BM_ConvertToRosBatch);
+
+template<class _T>
+static void BM_ConvertFromRos(benchmark::State &state)
+{
+	mavros_msgs::msg::Mavlink rmsg;
+	mavros_msgs::mavlink::convert(make_frame<_T>(), rmsg);
+	mavlink_message_t msg;
+
+	for (auto _ : state) {
+		mavros_msgs::mavlink::convert(rmsg, msg);
+		benchmark::DoNotOptimize(&msg);
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_ConvertFromRos, HEARTBEAT);
+BENCHMARK_TEMPLATE(BM_ConvertFromRos, ODOMETRY);
+
+BENCHMARK_MAIN();
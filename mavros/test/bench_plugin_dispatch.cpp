@@ -0,0 +1,207 @@
+/**
+ * Benchmark libmavros plugin dispatcher
+ *
+ * Not a test, not run by ctest:
+ *     libmavros-dispatch-bench [--benchmark_filter=regex]
+ *
+ * Inline: 16 plugins, 4 handlers each, frames mix routed and unrouted ids.
+ * PX4: subscriptions of default PX4 plugin list, typed handlers,
+ *      frames in proportion of usual stream rates.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <vector>
+#include <mavros/plugin_dispatch.h>
+
+using namespace mavros;
+using mavconn::Framing;
+using mavlink::mavlink_message_t;
+using namespace mavlink::common::msg;
+
+struct Plugin {
+	uint64_t sum = 0;
+
+	void handle(const mavlink_message_t *msg, const Framing framing) {
+		sum += msg->seq;
+	}
+};
+
+//! Same binding as PluginBase::make_handler()
+static MessageHandler bind_handler(Plugin *p)
+{
+	return MessageHandler {
+		[](const void *obj, const mavlink_message_t *msg, const Framing framing, const void *decoded) {
+			const_cast<Plugin *>(static_cast<const Plugin *>(obj))->handle(msg, framing);
+		},
+		std::shared_ptr<const void>(p, [](const void *) {}),
+		nullptr
+	};
+}
+
+static void BM_DispatchInline(benchmark::State &state)
+{
+	PluginDispatcher disp;
+	std::vector<Plugin> plugins(16);
+	std::vector<mavlink_message_t> msgs;
+
+	for (size_t p = 0; p < plugins.size(); p++) {
+		auto idx = disp.add_plugin("plugin", false);
+		for (uint32_t id = p * 4; id < p * 4 + 4; id++)
+			disp.add_handler(idx, id * 3, bind_handler(&plugins[p]));
+	}
+	disp.start(0);
+
+	for (uint32_t i = 0; i < 256; i++) {
+		mavlink_message_t msg {};
+		msg.msgid = (i * 7) % 200;
+		msg.seq = i;
+		msgs.push_back(msg);
+	}
+
+	for (auto _ : state) {
+		for (auto &msg : msgs)
+			disp.dispatch(&msg, Framing::ok, 0);
+	}
+
+	state.SetItemsProcessed(state.iterations() * msgs.size());
+}
+BENCHMARK(BM_DispatchInline);
+
+struct TypedPlugin {
+	uint64_t count = 0;
+
+	template<class _T>
+	void handle(const mavlink_message_t *msg, const _T &obj) {
+		benchmark::DoNotOptimize(&obj);
+		count++;
+	}
+};
+
+//! Same binding as typed PluginBase::make_handler()
+template<class _T>
+static void add_typed(PluginDispatcher &disp, size_t idx, TypedPlugin *p)
+{
+	disp.add_handler(idx, _T::MSG_ID, MessageHandler {
+		[](const void *obj, const mavlink_message_t *msg, const Framing framing, const void *decoded) {
+			if (framing != Framing::ok)
+				return;
+
+			auto pl = const_cast<TypedPlugin *>(static_cast<const TypedPlugin *>(obj));
+			if (decoded) {
+				pl->handle(msg, *static_cast<const _T *>(decoded));
+				return;
+			}
+
+			mavlink::MsgMap map(msg);
+			_T o;
+			o.deserialize(map);
+			pl->handle(msg, o);
+		},
+		std::shared_ptr<const void>(p, [](const void *) {}),
+		MessageDecoder::get<_T>()
+	});
+}
+
+template<class _T>
+static void add_frames(std::vector<mavlink_message_t> &frames, size_t n)
+{
+	_T obj {};
+	mavlink_message_t msg {};
+	mavlink::MsgMap map(msg);
+	obj.serialize(map);
+	msg.sysid = 1;
+	msg.compid = 1;
+
+	frames.insert(frames.end(), n, msg);
+}
+
+//! Same routing as MavRos::plugin_route_cb(), one vehicle
+static void BM_DispatchPX4(benchmark::State &state)
+{
+	PluginDispatcher disp;
+	std::array<TypedPlugin, 12> pl;	// by plugin index
+	std::array<PluginDispatcher *, 256> vehicle_dispatcher {};
+
+	auto sys_status = disp.add_plugin("sys_status", false);
+	add_typed<HEARTBEAT>(disp, sys_status, &pl[sys_status]);
+	add_typed<SYS_STATUS>(disp, sys_status, &pl[sys_status]);
+	add_typed<STATUSTEXT>(disp, sys_status, &pl[sys_status]);
+	add_typed<EXTENDED_SYS_STATE>(disp, sys_status, &pl[sys_status]);
+	add_typed<BATTERY_STATUS>(disp, sys_status, &pl[sys_status]);
+	auto imu = disp.add_plugin("imu", false);
+	add_typed<ATTITUDE>(disp, imu, &pl[imu]);
+	add_typed<ATTITUDE_QUATERNION>(disp, imu, &pl[imu]);
+	add_typed<HIGHRES_IMU>(disp, imu, &pl[imu]);
+	add_typed<RAW_IMU>(disp, imu, &pl[imu]);
+	add_typed<SCALED_PRESSURE>(disp, imu, &pl[imu]);
+	auto local_position = disp.add_plugin("local_position", false);
+	add_typed<LOCAL_POSITION_NED>(disp, local_position, &pl[local_position]);
+	add_typed<LOCAL_POSITION_NED_COV>(disp, local_position, &pl[local_position]);
+	auto odom = disp.add_plugin("odom", false);
+	add_typed<ODOMETRY>(disp, odom, &pl[odom]);
+	auto global_position = disp.add_plugin("global_position", false);
+	add_typed<GLOBAL_POSITION_INT>(disp, global_position, &pl[global_position]);
+	add_typed<GPS_RAW_INT>(disp, global_position, &pl[global_position]);
+	add_typed<GPS_GLOBAL_ORIGIN>(disp, global_position, &pl[global_position]);
+	add_typed<LOCAL_POSITION_NED>(disp, global_position, &pl[global_position]);	// shared decode
+	auto altitude = disp.add_plugin("altitude", false);
+	add_typed<ALTITUDE>(disp, altitude, &pl[altitude]);
+	auto vfr_hud = disp.add_plugin("vfr_hud", false);
+	add_typed<VFR_HUD>(disp, vfr_hud, &pl[vfr_hud]);
+	auto sys_time = disp.add_plugin("sys_time", false);
+	add_typed<TIMESYNC>(disp, sys_time, &pl[sys_time]);
+	add_typed<SYSTEM_TIME>(disp, sys_time, &pl[sys_time]);
+	auto rc_io = disp.add_plugin("rc_io", false);
+	add_typed<RC_CHANNELS>(disp, rc_io, &pl[rc_io]);
+	add_typed<SERVO_OUTPUT_RAW>(disp, rc_io, &pl[rc_io]);
+	auto setpoint_raw = disp.add_plugin("setpoint_raw", false);
+	add_typed<POSITION_TARGET_LOCAL_NED>(disp, setpoint_raw, &pl[setpoint_raw]);
+	add_typed<ATTITUDE_TARGET>(disp, setpoint_raw, &pl[setpoint_raw]);
+	auto home_position = disp.add_plugin("home_position", false);
+	add_typed<HOME_POSITION>(disp, home_position, &pl[home_position]);
+	auto heartbeat = disp.add_plugin("heartbeat_watch", false);
+	add_typed<HEARTBEAT>(disp, heartbeat, &pl[heartbeat]);	// shared decode
+	disp.start(0);
+	vehicle_dispatcher[1] = &disp;
+
+	// one second of PX4 default onboard streams, sorted by rate
+	std::vector<mavlink_message_t> frames;
+	add_frames<HIGHRES_IMU>(frames, 50);
+	add_frames<ATTITUDE_QUATERNION>(frames, 50);
+	add_frames<LOCAL_POSITION_NED>(frames, 30);
+	add_frames<ODOMETRY>(frames, 30);
+	add_frames<ATTITUDE_TARGET>(frames, 10);
+	add_frames<POSITION_TARGET_LOCAL_NED>(frames, 10);
+	add_frames<ALTITUDE>(frames, 10);
+	add_frames<ESTIMATOR_STATUS>(frames, 5);	// not routed
+	add_frames<GLOBAL_POSITION_INT>(frames, 5);
+	add_frames<GPS_RAW_INT>(frames, 5);
+	add_frames<RC_CHANNELS>(frames, 5);
+	add_frames<SERVO_OUTPUT_RAW>(frames, 5);
+	add_frames<VFR_HUD>(frames, 4);
+	add_frames<BATTERY_STATUS>(frames, 1);
+	add_frames<EXTENDED_SYS_STATE>(frames, 1);
+	add_frames<HEARTBEAT>(frames, 1);
+	add_frames<SYS_STATUS>(frames, 1);
+	add_frames<SYSTEM_TIME>(frames, 1);
+
+	// interleave
+	std::vector<mavlink_message_t> msgs;
+	for (size_t k = 0; k < frames.size(); k++)
+		msgs.push_back(frames[(k * 101) % frames.size()]);
+
+	for (auto _ : state) {
+		for (auto &msg : msgs) {
+			auto d = vehicle_dispatcher[msg.sysid];
+			if (d != nullptr)
+				d->dispatch(&msg, Framing::ok, 0);
+		}
+	}
+
+	state.SetItemsProcessed(state.iterations() * msgs.size());
+}
+BENCHMARK(BM_DispatchPX4);
+
+BENCHMARK_MAIN();
@@ -133,6 +133,155 @@ TEST(FRAME_TF, quaternion_transforms__ned_to_ned_123)
 	EXPECT_QUATERNION(input_aircraft_ned_orient, output_aircraft_ned, epsilon);
 }
 
+/* -*- batch transforms, compared with scalar ones -*- */
+
+static const ftf::StaticTF static_tfs[] = {
+	ftf::StaticTF::NED_TO_ENU, ftf::StaticTF::ENU_TO_NED,
+	ftf::StaticTF::AIRCRAFT_TO_BASELINK, ftf::StaticTF::BASELINK_TO_AIRCRAFT
+};
+
+template<class Batch>
+static Batch make_batch(int rows)
+{
+	Batch b(rows, Batch::ColsAtCompileTime);
+	for (int r = 0; r < b.rows(); r++)
+		for (int c = 0; c < b.cols(); c++)
+			b(r, c) = r * 0.37 - c * 1.3 + (c % 7) * 0.11;
+
+	return b;
+}
+
+template<class Cov, class Batch>
+static void expect_covariance_row(const Cov &expected, const Batch &out, int row)
+{
+	for (size_t idx = 0; idx < expected.size(); idx++) {
+		SCOPED_TRACE(idx);
+		EXPECT_NEAR(expected[idx], out(row, idx), epsilon);
+	}
+}
+
+TEST(FRAME_TF, batch__vector3d)
+{
+	auto q = ftf::quaternion_from_rpy(0.1, -0.7, 2.3);
+	auto in = make_batch<ftf::Vector3dBatch>(11);
+
+	auto out_q = ftf::transform_frame_enu_baselink(in, q);
+	for (auto tf : static_tfs) {
+		auto out = ftf::detail::transform_static_frame(in, tf);
+
+		for (int r = 0; r < in.rows(); r++) {
+			Eigen::Vector3d v = in.row(r).transpose();
+			EXPECT_TRUE(out.row(r).transpose().isApprox(ftf::detail::transform_static_frame(v, tf), epsilon));
+			EXPECT_TRUE(out_q.row(r).transpose().isApprox(ftf::detail::transform_frame(v, q), epsilon));
+		}
+	}
+}
+
+TEST(FRAME_TF, batch__vector3d_preallocated)
+{
+	auto in = make_batch<ftf::Vector3dBatch>(7);
+	ftf::Vector3dBatch out(7, 3);
+	auto data = out.data();
+
+	ftf::transform_frame_enu_ned(in, out);
+	EXPECT_EQ(data, out.data());
+	EXPECT_TRUE(out.isApprox(ftf::transform_frame_enu_ned(in), epsilon));
+}
+
+TEST(FRAME_TF, batch__covariance6x6_9x9)
+{
+	auto q = ftf::quaternion_from_rpy(0.4, 1.1, -2.9);
+	auto in6 = make_batch<ftf::Covariance6dBatch>(5);
+	auto in9 = make_batch<ftf::Covariance9dBatch>(5);
+
+	auto out6_q = ftf::detail::transform_frame(in6, q);
+	auto out9_q = ftf::detail::transform_frame(in9, q);
+	for (auto tf : static_tfs) {
+		auto out6 = ftf::detail::transform_static_frame(in6, tf);
+		auto out9 = ftf::detail::transform_static_frame(in9, tf);
+
+		for (int r = 0; r < in6.rows(); r++) {
+			ftf::Covariance6d c6;
+			ftf::Covariance9d c9;
+			Eigen::Map<Eigen::RowVectorXd>(c6.data(), c6.size()) = in6.row(r);
+			Eigen::Map<Eigen::RowVectorXd>(c9.data(), c9.size()) = in9.row(r);
+
+			expect_covariance_row(ftf::detail::transform_static_frame(c6, tf), out6, r);
+			expect_covariance_row(ftf::detail::transform_static_frame(c9, tf), out9, r);
+			expect_covariance_row(ftf::detail::transform_frame(c6, q), out6_q, r);
+			expect_covariance_row(ftf::detail::transform_frame(c9, q), out9_q, r);
+		}
+	}
+}
+
+TEST(FRAME_TF, batch__covariance3x3)
+{
+	auto q = ftf::quaternion_from_rpy(-0.3, 0.2, 1.7);
+	Eigen::Matrix3d R = q.toRotationMatrix();
+	auto in = make_batch<ftf::Covariance3dBatch>(5);
+
+	auto out_q = ftf::detail::transform_frame(in, q);
+	auto out_ned = ftf::transform_frame_ned_enu(in);
+	for (int r = 0; r < in.rows(); r++) {
+		Eigen::Matrix<double, 3, 3, Eigen::RowMajor> c;
+		Eigen::Map<Eigen::RowVectorXd>(c.data(), 9) = in.row(r);
+
+		Eigen::Matrix<double, 3, 3, Eigen::RowMajor> expected = R * c * R.transpose();
+		Eigen::Matrix<double, 3, 3, Eigen::RowMajor> expected_ned;
+		expected_ned << c(1, 1), c(1, 0), -c(1, 2),
+		                c(0, 1), c(0, 0), -c(0, 2),
+		                -c(2, 1), -c(2, 0), c(2, 2);
+
+		for (int idx = 0; idx < 9; idx++) {
+			SCOPED_TRACE(idx);
+			EXPECT_NEAR(expected.data()[idx], out_q(r, idx), epsilon);
+			EXPECT_NEAR(expected_ned.data()[idx], out_ned(r, idx), epsilon);
+		}
+	}
+}
+
+template<ftf::StaticTF TF, class T>
+static void expect_swizzle_same_as_runtime(const T &in)
+{
+	auto out = ftf::detail::transform_static_frame<TF>(in);
+	auto expected = ftf::detail::transform_static_frame(in, TF);
+
+	for (size_t idx = 0; idx < size_t(in.size()); idx++) {
+		SCOPED_TRACE(idx);
+		EXPECT_NEAR(expected[idx], out[idx], epsilon);
+	}
+}
+
+TEST(FRAME_TF, static_swizzle__vector3d)
+{
+	Eigen::Vector3d in(1.0, 2.0, 3.0);
+
+	expect_swizzle_same_as_runtime<ftf::StaticTF::NED_TO_ENU>(in);
+	expect_swizzle_same_as_runtime<ftf::StaticTF::ENU_TO_NED>(in);
+	expect_swizzle_same_as_runtime<ftf::StaticTF::AIRCRAFT_TO_BASELINK>(in);
+	expect_swizzle_same_as_runtime<ftf::StaticTF::BASELINK_TO_AIRCRAFT>(in);
+}
+
+TEST(FRAME_TF, static_swizzle__covariance)
+{
+	ftf::Covariance3d c3;
+	ftf::Covariance6d c6;
+	ftf::Covariance9d c9;
+	for (size_t i = 0; i < c9.size(); i++) {
+		if (i < c3.size()) c3[i] = i + 1;
+		if (i < c6.size()) c6[i] = i + 1;
+		c9[i] = i + 1;
+	}
+
+	expect_swizzle_same_as_runtime<ftf::StaticTF::NED_TO_ENU>(c3);
+	expect_swizzle_same_as_runtime<ftf::StaticTF::NED_TO_ENU>(c6);
+	expect_swizzle_same_as_runtime<ftf::StaticTF::NED_TO_ENU>(c9);
+	expect_swizzle_same_as_runtime<ftf::StaticTF::ENU_TO_NED>(c6);
+	expect_swizzle_same_as_runtime<ftf::StaticTF::AIRCRAFT_TO_BASELINK>(c3);
+	expect_swizzle_same_as_runtime<ftf::StaticTF::AIRCRAFT_TO_BASELINK>(c6);
+	expect_swizzle_same_as_runtime<ftf::StaticTF::BASELINK_TO_AIRCRAFT>(c9);
+}
+
 #if 0
 // not implemented
 TEST(FRAME_TF, transform_static_frame__quaterniond_123)
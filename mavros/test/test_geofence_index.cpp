@@ -0,0 +1,182 @@
+/**
+ * Test libmavros geofence index
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <mavros/geofence_index.h>
+
+using mavros::GeofenceIndex;
+using Eigen::Vector2d;
+
+namespace {
+//! Reference crossing test on whole polygon
+bool brute_inside(const std::vector<Vector2d> &v, const Vector2d &p)
+{
+	bool inside = false;
+	for (size_t i = 0, j = v.size() - 1; i < v.size(); j = i++) {
+		if (((v[i].y() > p.y()) != (v[j].y() > p.y())) &&
+				(p.x() < (v[j].x() - v[i].x()) * (p.y() - v[i].y()) / (v[j].y() - v[i].y()) + v[i].x()))
+			inside = !inside;
+	}
+	return inside;
+}
+
+//! Concave "U" shape, 20 m wide
+std::vector<Vector2d> u_shape()
+{
+	return {{0, 0}, {20, 0}, {20, 20}, {15, 20}, {15, 5}, {5, 5}, {5, 20}, {0, 20}};
+}
+
+GeofenceIndex::Origin zero_origin()
+{
+	return {47.3977, 8.5456, Vector2d::Zero()};
+}
+}	// namespace
+
+TEST(GEOFENCE_INDEX, polygon)
+{
+	GeofenceIndex idx({GeofenceIndex::polygon(true, u_shape())}, {}, zero_origin());
+
+	EXPECT_TRUE(idx.contains({2, 2}));
+	EXPECT_TRUE(idx.contains({2, 18}));
+	EXPECT_TRUE(idx.contains({18, 18}));
+	EXPECT_FALSE(idx.contains({10, 10}));	// in the notch
+	EXPECT_FALSE(idx.contains({-1, 10}));
+	EXPECT_FALSE(idx.contains({10, 25}));
+	EXPECT_EQ(idx.check({10, 10}), 0);
+}
+
+TEST(GEOFENCE_INDEX, closed_ring)
+{
+	auto v = u_shape();
+	v.push_back(v.front());
+	auto z = GeofenceIndex::polygon(true, v);
+	EXPECT_EQ(z.vertices.size(), u_shape().size());
+
+	EXPECT_THROW(GeofenceIndex({GeofenceIndex::polygon(true, {{0, 0}, {1, 1}})}, {}, zero_origin()),
+		std::invalid_argument);
+	EXPECT_THROW(GeofenceIndex({GeofenceIndex::circle(true, {0, 0}, 0.0)}, {}, zero_origin()),
+		std::invalid_argument);
+}
+
+TEST(GEOFENCE_INDEX, exclusion)
+{
+	GeofenceIndex idx({
+			GeofenceIndex::polygon(true, {{-50, -50}, {50, -50}, {50, 50}, {-50, 50}}),
+			GeofenceIndex::circle(false, {10, 0}, 5),
+			GeofenceIndex::polygon(false, {{-20, -20}, {-10, -20}, {-10, -10}, {-20, -10}}),
+		}, {}, zero_origin());
+
+	EXPECT_TRUE(idx.contains({0, 0}));
+	EXPECT_EQ(idx.check({11, 1}), 1);
+	EXPECT_EQ(idx.check({-15, -15}), 2);
+	EXPECT_EQ(idx.check({60, 0}), 0);
+}
+
+TEST(GEOFENCE_INDEX, any_inclusion)
+{
+	std::vector<GeofenceIndex::Zone> zones{
+		GeofenceIndex::circle(true, {0, 0}, 10),
+		GeofenceIndex::circle(true, {30, 0}, 10),
+	};
+
+	GeofenceIndex all(zones, {}, zero_origin());
+	EXPECT_FALSE(all.contains({0, 0}));
+
+	GeofenceIndex::Options opts;
+	opts.any_inclusion = true;
+	GeofenceIndex any(zones, opts, zero_origin());
+	EXPECT_TRUE(any.contains({0, 0}));
+	EXPECT_TRUE(any.contains({30, 5}));
+	EXPECT_FALSE(any.contains({15, 0}));
+}
+
+TEST(GEOFENCE_INDEX, clamp)
+{
+	GeofenceIndex::Options opts;
+	opts.action = GeofenceIndex::Action::CLAMP;
+	opts.margin = 1.0;
+
+	GeofenceIndex idx({
+			GeofenceIndex::polygon(true, {{0, 0}, {100, 0}, {100, 100}, {0, 100}}),
+			GeofenceIndex::circle(false, {50, 50}, 10),
+		}, opts, zero_origin());
+
+	Vector2d p(120, 50);
+	ASSERT_TRUE(idx.clamp(p));
+	EXPECT_NEAR(p.x(), 99.0, 1e-6);
+	EXPECT_NEAR(p.y(), 50.0, 1e-6);
+
+	p = {52, 50};
+	ASSERT_TRUE(idx.clamp(p));
+	EXPECT_NEAR(p.x(), 61.0, 1e-6);
+	EXPECT_NEAR(p.y(), 50.0, 1e-6);
+
+	// allowed point is not moved
+	p = {20, 20};
+	ASSERT_TRUE(idx.clamp(p));
+	EXPECT_EQ(p, Vector2d(20, 20));
+
+	// concave notch
+	GeofenceIndex u({GeofenceIndex::polygon(true, u_shape())}, opts, zero_origin());
+	p = {9, 12};
+	ASSERT_TRUE(u.clamp(p));
+	EXPECT_TRUE(u.contains(p));
+	EXPECT_NEAR(p.x(), 4.0, 1e-6);
+}
+
+TEST(GEOFENCE_INDEX, grid_vs_brute)
+{
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<double> noise(0.5, 1.0);
+	std::uniform_real_distribution<double> coord(-120.0, 120.0);
+
+	// star-shaped polygon with many edges
+	std::vector<Vector2d> v;
+	const size_t n = 500;
+	for (size_t i = 0; i < n; i++) {
+		double a = 2 * M_PI * i / n;
+		double r = 100.0 * noise(gen);
+		v.emplace_back(r * std::cos(a), r * std::sin(a));
+	}
+
+	GeofenceIndex idx({GeofenceIndex::polygon(true, v)}, {}, zero_origin());
+
+	for (size_t i = 0; i < 100000; i++) {
+		Vector2d p(coord(gen), coord(gen));
+		ASSERT_EQ(idx.contains(p), brute_inside(v, p)) << "p: " << p.transpose();
+	}
+}
+
+TEST(GEOFENCE_INDEX, local_global)
+{
+	GeofenceIndex::Origin origin{47.3977, 8.5456, Vector2d(3, -4)};
+
+	EXPECT_EQ(GeofenceIndex::to_local(origin, origin.latitude, origin.longitude), origin.local);
+
+	// 0.001 deg of latitude is about 111 m
+	auto north = GeofenceIndex::to_local(origin, origin.latitude + 0.001, origin.longitude);
+	EXPECT_NEAR(north.x(), 3.0, 1e-9);
+	EXPECT_NEAR(north.y() + 4.0, 111.2, 0.1);
+
+	Vector2d p(250.0, -700.0);
+	double lat, lon;
+	GeofenceIndex::to_global(origin, p, lat, lon);
+	auto back = GeofenceIndex::to_local(origin, lat, lon);
+	EXPECT_NEAR(back.x(), p.x(), 1e-6);
+	EXPECT_NEAR(back.y(), p.y(), 1e-6);
+
+	// across antimeridian
+	GeofenceIndex::Origin am{0.0, 179.9999, Vector2d::Zero()};
+	auto east = GeofenceIndex::to_local(am, 0.0, -179.9999);
+	EXPECT_NEAR(east.x(), 22.26, 0.01);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,118 @@
+/**
+ * Test libmavros memory-mapped geoid
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <mavros/geoid_model.h>
+
+using namespace mavros;
+
+//! 1 deg grid, height = -100 + 0.01 * (ix + 7 * iy) [m]
+static std::string make_pgm(const char *name)
+{
+	std::string fn = std::string(testing::TempDir()) + name;
+	std::ofstream f(fn, std::ios::binary);
+
+	f << "P5\n"
+	  << "# Geoid file in PGM format for the GeographicLib::Geoid class\n"
+	  << "# Offset -100\n"
+	  << "# Scale 0.01\n"
+	  << "360 181\n"
+	  << "65535\n";
+
+	for (int iy = 0; iy < 181; iy++) {
+		for (int ix = 0; ix < 360; ix++) {
+			uint16_t v = ix + 7 * iy;
+			f.put(v >> 8);
+			f.put(v & 0xff);
+		}
+	}
+
+	return fn;
+}
+
+static double grid(double ix, double iy)
+{
+	return -100 + 0.01 * (ix + 7 * iy);
+}
+
+TEST(GEOID, mapped_interpolation)
+{
+	auto fn = make_pgm("geoid_interp.pgm");
+	MappedGeoid geoid(fn);
+
+	// nodes, row 0 is north pole
+	EXPECT_NEAR(geoid(90, 0), grid(0, 0), 1e-9);
+	EXPECT_NEAR(geoid(45, 10), grid(10, 45), 1e-9);
+	EXPECT_NEAR(geoid(-90, 20), grid(20, 180), 1e-9);
+	EXPECT_NEAR(geoid(10, -10), grid(350, 80), 1e-9);
+
+	// bilinear inside cell
+	EXPECT_NEAR(geoid(44.5, 10.5), grid(10.5, 45.5), 1e-9);
+
+	// across 360 deg, column 0 follows 359
+	EXPECT_NEAR(geoid(0, 359.5), (grid(359, 90) + grid(0, 90)) / 2, 1e-9);
+	EXPECT_NEAR(geoid(0, -0.5), geoid(0, 359.5), 1e-9);
+
+	std::remove(fn.c_str());
+}
+
+TEST(GEOID, tile_same_as_map)
+{
+	auto fn = make_pgm("geoid_tile.pgm");
+	MappedGeoid geoid(fn);
+
+	std::vector<std::pair<double, double>> points;
+	for (double lat = 43.0; lat < 53.0; lat += 0.37)
+		for (double lon = -3.0; lon < 3.0; lon += 0.41)
+			points.emplace_back(lat, lon);
+
+	std::vector<double> expected;
+	for (auto &p : points)
+		expected.push_back(geoid(p.first, p.second));
+
+	// tile wraps at 0 deg longitude, some points are outside of it
+	geoid.cache_tile(48.0, 0.0, 2.0);
+	for (size_t i = 0; i < points.size(); i++)
+		EXPECT_DOUBLE_EQ(geoid(points[i].first, points[i].second), expected[i]);
+
+	std::remove(fn.c_str());
+}
+
+TEST(GEOID, cached_same_as_map)
+{
+	auto fn = make_pgm("geoid_cache.pgm");
+	auto mapped = std::make_shared<MappedGeoid>(fn);
+	CachedGeoid cached(mapped, 1.0);
+
+	// track crossing several cells and 0 deg longitude
+	for (double t = 0; t < 1.0; t += 0.01) {
+		double lat = 47.3 + 2.5 * t, lon = -1.7 + 3.3 * t;
+		EXPECT_NEAR(cached(lat, lon), (*mapped)(lat, lon), 1e-9);
+	}
+
+	std::remove(fn.c_str());
+}
+
+TEST(GEOID, bad_file)
+{
+	EXPECT_THROW(MappedGeoid("/nonexistent/geoid.pgm"), std::runtime_error);
+
+	std::string fn = std::string(testing::TempDir()) + "geoid_bad.pgm";
+	{
+		std::ofstream f(fn, std::ios::binary);
+		f << "P5\n# Offset -100\n# Scale 0.01\n360 181\n65535\n" << "short";
+	}
+
+	EXPECT_THROW(MappedGeoid(fn.c_str()), std::runtime_error);
+	std::remove(fn.c_str());
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,72 @@
+/**
+ * Test libmavros handler profile
+ */
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <mavros/handler_profile.h>
+
+using namespace mavros;
+
+TEST(HANDLER_PROFILE, buckets_are_continuous)
+{
+	for (size_t i = 1; i < HandlerProfile::NBUCKETS; i++) {
+		auto lower = HandlerProfile::bucket_lower(i);
+		EXPECT_EQ(i, HandlerProfile::bucket(lower)) << "bucket " << i;
+		EXPECT_EQ(i - 1, HandlerProfile::bucket(lower - 1)) << "bucket " << i;
+	}
+
+	EXPECT_EQ(HandlerProfile::NBUCKETS - 1, HandlerProfile::bucket(UINT64_MAX));
+}
+
+TEST(HANDLER_PROFILE, counters)
+{
+	HandlerProfile prof;
+
+	for (uint64_t t : {100, 200, 300, 5000})
+		prof.record(t);
+
+	auto s = prof.snapshot();
+	EXPECT_EQ(4U, s.calls);
+	EXPECT_EQ(5600U, s.total);
+	EXPECT_EQ(5000U, s.max);
+}
+
+TEST(HANDLER_PROFILE, percentile)
+{
+	HandlerProfile prof;
+
+	EXPECT_EQ(0U, prof.snapshot().percentile(0.5));
+
+	for (int i = 0; i < 99; i++)
+		prof.record(1000);
+	prof.record(100000);
+
+	auto s = prof.snapshot();
+	auto p50 = s.percentile(0.5);
+	EXPECT_GE(p50, 1000U);
+	EXPECT_LE(p50, 1250U);
+
+	// single outlier, cut by max
+	EXPECT_EQ(100000U, s.percentile(0.999));
+}
+
+TEST(HANDLER_PROFILE, tick_clock)
+{
+	TickClock clock;
+
+	auto t0 = TickClock::now();
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	auto ticks = TickClock::now() - t0;
+
+	double ms = ticks * clock.ns_per_tick() / 1e6;
+	EXPECT_GT(ms, 15.0);
+	EXPECT_LT(ms, 200.0);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,219 @@
+/**
+ * Test libmavros HIGH_LATENCY2 mode and encoder
+ */
+
+#include <gtest/gtest.h>
+
+#include <mavros/high_latency.h>
+
+using mavros::HighLatencyMode;
+using mavros::HighLatencyEncoder;
+using Mode = HighLatencyMode::Mode;
+using mavlink::mavlink_message_t;
+using namespace std::chrono_literals;
+
+namespace msg = mavlink::common::msg;
+
+template<typename _T>
+static mavlink_message_t make_frame(_T &obj, uint8_t sysid = 1, uint8_t compid = 1)
+{
+	mavlink_message_t mmsg;
+	mavlink::MsgMap map(mmsg);
+	auto mi = obj.get_message_info();
+	mavlink::mavlink_status_t status {};
+
+	obj.serialize(map);
+	mavlink::mavlink_finalize_message_buffer(&mmsg, sysid, compid, &status,
+			mi.min_length, mi.length, mi.crc_extra);
+	return mmsg;
+}
+
+static HighLatencyMode::Options auto_options()
+{
+	HighLatencyMode::Options opts;
+	opts.mode = Mode::AUTO;
+	opts.rtt_threshold_ms = 1000.0f;
+	opts.hold = 10s;
+	return opts;
+}
+
+TEST(HIGH_LATENCY, fixed_modes)
+{
+	auto now = HighLatencyMode::clock::now();
+
+	HighLatencyMode off;
+	EXPECT_FALSE(off.is_active());
+	EXPECT_FALSE(off.update(now, 100, 5000.0f));
+	EXPECT_FALSE(off.update(now + 1s, 200, 5000.0f));
+
+	HighLatencyMode::Options opts;
+	opts.mode = Mode::ON;
+	HighLatencyMode on(opts);
+	EXPECT_TRUE(on.is_active());
+	EXPECT_FALSE(on.update(now, 0, 10.0f));
+	EXPECT_TRUE(on.is_active());
+
+	Mode mode;
+	EXPECT_TRUE(HighLatencyMode::parse_mode("auto", mode));
+	EXPECT_EQ(mode, Mode::AUTO);
+	EXPECT_FALSE(HighLatencyMode::parse_mode("sometimes", mode));
+}
+
+TEST(HIGH_LATENCY, auto_rtt)
+{
+	HighLatencyMode hl(auto_options());
+	auto now = HighLatencyMode::clock::now();
+
+	EXPECT_FALSE(hl.update(now, 0, 0.0f));
+	EXPECT_FALSE(hl.update(now + 1s, 0, 200.0f));
+
+	// satellite link
+	EXPECT_TRUE(hl.update(now + 2s, 0, 1500.0f));
+	EXPECT_TRUE(hl.is_active());
+
+	// hold, then hysteresis below half of threshold
+	EXPECT_FALSE(hl.update(now + 5s, 0, 100.0f));
+	EXPECT_FALSE(hl.update(now + 13s, 0, 700.0f));
+	EXPECT_TRUE(hl.update(now + 14s, 0, 300.0f));
+	EXPECT_FALSE(hl.is_active());
+}
+
+TEST(HIGH_LATENCY, auto_drops_backoff)
+{
+	HighLatencyMode hl(auto_options());
+	auto now = HighLatencyMode::clock::now();
+
+	// first sample is the baseline only
+	EXPECT_FALSE(hl.update(now, 50, 0.0f));
+	EXPECT_TRUE(hl.update(now + 1s, 51, 0.0f));
+
+	// no probe, retry after hold
+	EXPECT_FALSE(hl.update(now + 10s, 51, 0.0f));
+	EXPECT_TRUE(hl.update(now + 11s, 51, 0.0f));
+	EXPECT_FALSE(hl.is_active());
+
+	// retry failed, hold doubles
+	EXPECT_TRUE(hl.update(now + 12s, 60, 0.0f));
+	EXPECT_FALSE(hl.update(now + 31s, 60, 0.0f));
+	EXPECT_TRUE(hl.update(now + 32s, 60, 0.0f));
+
+	// retry held, next one starts with single hold
+	EXPECT_FALSE(hl.update(now + 43s, 60, 0.0f));
+	EXPECT_TRUE(hl.update(now + 44s, 61, 0.0f));
+	EXPECT_FALSE(hl.update(now + 53s, 61, 0.0f));
+	EXPECT_TRUE(hl.update(now + 54s, 61, 0.0f));
+}
+
+TEST(HIGH_LATENCY, mission_handshake)
+{
+	HighLatencyMode::Options opts;
+	opts.mode = Mode::ON;
+	HighLatencyMode hl(opts);
+	ASSERT_TRUE(hl.is_active());
+
+	// FCU side of mission download: REQUEST_LIST -> COUNT, REQUEST_INT -> ITEM_INT, ACK
+	for (auto msgid : {msg::MISSION_COUNT::MSG_ID, msg::MISSION_ITEM_INT::MSG_ID, msg::MISSION_ITEM::MSG_ID})
+		EXPECT_TRUE(hl.pass(msgid)) << msgid;
+
+	// FCU side of mission upload: COUNT -> REQUEST_INT, ITEM_INT -> ... -> ACK
+	for (auto msgid : {msg::MISSION_REQUEST_INT::MSG_ID, msg::MISSION_REQUEST::MSG_ID, msg::MISSION_ACK::MSG_ID})
+		EXPECT_TRUE(hl.pass(msgid)) << msgid;
+
+	EXPECT_TRUE(hl.pass(msg::COMMAND_ACK::MSG_ID));
+	EXPECT_TRUE(hl.pass(msg::HIGH_LATENCY2::MSG_ID));
+
+	// streams are replaced by reports
+	EXPECT_FALSE(hl.pass(msg::HEARTBEAT::MSG_ID));
+	EXPECT_FALSE(hl.pass(msg::ATTITUDE::MSG_ID));
+	EXPECT_FALSE(hl.pass(msg::GLOBAL_POSITION_INT::MSG_ID));
+
+	// user list replaces default one
+	opts.pass_msgids = {msg::STATUSTEXT::MSG_ID};
+	HighLatencyMode custom(opts);
+	EXPECT_TRUE(custom.pass(msg::STATUSTEXT::MSG_ID));
+	EXPECT_TRUE(custom.pass(msg::HIGH_LATENCY2::MSG_ID));
+	EXPECT_FALSE(custom.pass(msg::MISSION_ACK::MSG_ID));
+}
+
+TEST(HIGH_LATENCY, encoder)
+{
+	HighLatencyEncoder enc;
+	enc.set_target(1, 1);
+	EXPECT_FALSE(enc.ready());
+
+	msg::HEARTBEAT hb {};
+	hb.type = 2;		// MAV_TYPE_QUADROTOR
+	hb.autopilot = 12;	// MAV_AUTOPILOT_PX4
+	hb.custom_mode = 0x04030000;
+	auto hb_frame = make_frame(hb);
+	enc.update(hb_frame);
+	EXPECT_TRUE(enc.ready());
+
+	// other component does not change report
+	hb.type = 26;		// MAV_TYPE_GIMBAL
+	auto gimbal_frame = make_frame(hb, 1, 154);
+	enc.update(gimbal_frame);
+
+	msg::GLOBAL_POSITION_INT gp {};
+	gp.time_boot_ms = 123456;
+	gp.lat = 473977420;
+	gp.lon = 85455940;
+	gp.alt = 535500;
+	auto gp_frame = make_frame(gp);
+	enc.update(gp_frame);
+
+	msg::VFR_HUD hud {};
+	hud.heading = 271;
+	hud.airspeed = 12.3f;
+	hud.groundspeed = 100.0f;
+	hud.throttle = 40;
+	hud.climb = -1.25f;
+	auto hud_frame = make_frame(hud);
+	enc.update(hud_frame);
+
+	msg::SYS_STATUS st {};
+	st.battery_remaining = 77;
+	st.onboard_control_sensors_present = 0x20 | 0x01;	// GPS, gyro
+	st.onboard_control_sensors_enabled = 0x20 | 0x01;
+	st.onboard_control_sensors_health = 0x01;
+	auto st_frame = make_frame(st);
+	enc.update(st_frame);
+
+	auto hl = enc.get_report();
+	EXPECT_EQ(hl.type, 2);
+	EXPECT_EQ(hl.autopilot, 12);
+	EXPECT_EQ(hl.custom_mode, 0x04030000U);
+	EXPECT_EQ(hl.latitude, 473977420);
+	EXPECT_EQ(hl.longitude, 85455940);
+	EXPECT_EQ(hl.altitude, 535);
+	EXPECT_EQ(hl.heading, 136);
+	EXPECT_EQ(hl.airspeed, 62);
+	EXPECT_EQ(hl.groundspeed, 255);		// saturated
+	EXPECT_EQ(hl.throttle, 40);
+	EXPECT_EQ(hl.climb_rate, -13);
+	EXPECT_EQ(hl.battery, 77);
+	EXPECT_EQ(hl.failure_flags, 1);		// HL_FAILURE_FLAG_GPS
+
+	auto frame = enc.make(1, 1, 9);
+	EXPECT_EQ(frame.magic, MAVLINK_STX);
+	EXPECT_EQ(frame.msgid, msg::HIGH_LATENCY2::MSG_ID);
+	EXPECT_EQ(frame.sysid, 1);
+	EXPECT_EQ(frame.seq, 9);
+
+	msg::HIGH_LATENCY2 decoded;
+	mavlink::MsgMap map(frame);
+	decoded.deserialize(map);
+	EXPECT_EQ(decoded.timestamp, 123456U);
+	EXPECT_EQ(decoded.latitude, 473977420);
+	EXPECT_EQ(decoded.battery, 77);
+
+	enc.reset();
+	EXPECT_FALSE(enc.ready());
+	EXPECT_EQ(enc.get_report().battery, -1);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
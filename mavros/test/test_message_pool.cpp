@@ -0,0 +1,114 @@
+/**
+ * Test libmavros message pool
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <mavros/message_pool.h>
+
+using namespace mavros;
+
+struct Msg {
+	std::string frame_id;
+	int data = 0;
+};
+
+//! Records how message was published, like rclcpp::Publisher
+struct FakePublisher {
+	size_t intra_process_subs = 0;
+	std::vector<std::unique_ptr<Msg>> moved;
+	std::vector<Msg> copied;
+
+	size_t get_intra_process_subscription_count() const {
+		return intra_process_subs;
+	}
+
+	void publish(std::unique_ptr<Msg> msg) {
+		moved.emplace_back(std::move(msg));
+	}
+
+	void publish(const Msg &msg) {
+		copied.push_back(msg);
+	}
+};
+
+TEST(MESSAGE_POOL, reuse_without_intra_process)
+{
+	MessagePool<Msg> pool(2);
+	FakePublisher pub;
+
+	auto msg = pool.acquire();
+	auto ptr = msg.get();
+	msg->frame_id = "map";
+	msg->data = 42;
+	pool.publish(pub, std::move(msg));
+
+	ASSERT_EQ(pub.copied.size(), 1);
+	EXPECT_EQ(pub.copied[0].data, 42);
+	EXPECT_EQ(pool.size(), 1);
+
+	// same object, fields reset
+	msg = pool.acquire();
+	EXPECT_EQ(msg.get(), ptr);
+	EXPECT_EQ(msg->data, 0);
+	EXPECT_TRUE(msg->frame_id.empty());
+	EXPECT_EQ(pool.size(), 0);
+}
+
+TEST(MESSAGE_POOL, move_to_intra_process)
+{
+	MessagePool<Msg> pool;
+	FakePublisher pub;
+	pub.intra_process_subs = 1;
+
+	auto msg = pool.acquire();
+	auto ptr = msg.get();
+	pool.publish(pub, std::move(msg));
+
+	ASSERT_EQ(pub.moved.size(), 1);
+	EXPECT_EQ(pub.moved[0].get(), ptr);
+	EXPECT_TRUE(pub.copied.empty());
+	EXPECT_EQ(pool.size(), 0);
+}
+
+TEST(MESSAGE_POOL, capacity)
+{
+	MessagePool<Msg> pool(2);
+	FakePublisher pub;
+
+	std::vector<MessagePool<Msg>::Ptr> msgs;
+	for (int i = 0; i < 4; i++)
+		msgs.emplace_back(pool.acquire());
+
+	pool.publish_if(false, pub, std::move(msgs[0]));
+	EXPECT_TRUE(pub.copied.empty());
+	for (size_t i = 1; i < msgs.size(); i++)
+		pool.publish_if(true, pub, std::move(msgs[i]));
+
+	EXPECT_EQ(pub.copied.size(), 3);
+	EXPECT_EQ(pool.size(), 2);
+}
+
+TEST(MESSAGE_POOL, reused_keeps_capacity)
+{
+	MessagePool<Msg> pool;
+	FakePublisher pub;
+
+	auto msg = pool.acquire_reused();
+	msg->frame_id.assign(100, 'x');
+	auto data = msg->frame_id.data();
+	pool.publish(pub, std::move(msg));
+
+	// same buffer, previous content is kept
+	msg = pool.acquire_reused();
+	EXPECT_EQ(msg->frame_id.size(), 100);
+	msg->frame_id.assign(50, 'y');
+	EXPECT_EQ(msg->frame_id.data(), data);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,59 @@
+/**
+ * Test libmavros mission id tracker
+ */
+
+#include <gtest/gtest.h>
+
+#include <mavros/mission_id.h>
+
+using mavros::MissionIdTracker;
+using namespace std::chrono_literals;
+
+TEST(MISSION_ID, confirms_recent_report)
+{
+	MissionIdTracker t(5s);
+	auto now = MissionIdTracker::clock::now();
+
+	// nothing reported yet
+	EXPECT_FALSE(t.confirms(0x1234, now));
+
+	// MISSION_ACK of our upload
+	t.report(0x1234, now);
+	EXPECT_TRUE(t.confirms(0x1234, now + 1s));
+	EXPECT_TRUE(t.confirms(0x1234, now + 5s));
+	EXPECT_FALSE(t.confirms(0x1234, now + 6s));
+
+	// MISSION_CURRENT keeps it fresh
+	t.report(0x1234, now + 6s);
+	EXPECT_TRUE(t.confirms(0x1234, now + 10s));
+
+	t.reset();
+	EXPECT_FALSE(t.confirms(0x1234, now + 10s));
+	EXPECT_EQ(t.last_id(), 0U);
+}
+
+TEST(MISSION_ID, changed_behind_cache)
+{
+	MissionIdTracker t;
+	auto now = MissionIdTracker::clock::now();
+	const uint32_t cache_id = 0xa1;
+
+	t.report(cache_id, now);
+	ASSERT_TRUE(t.confirms(cache_id, now));
+
+	// other GCS uploaded a mission, FCU now reports its id
+	t.report(0xb2, now + 1s);
+	EXPECT_FALSE(t.confirms(cache_id, now + 1s));
+	EXPECT_TRUE(t.confirms(0xb2, now + 1s));
+
+	// FCU without id support never confirms a cache
+	t.report(0, now + 2s);
+	EXPECT_FALSE(t.confirms(0, now + 2s));
+	EXPECT_FALSE(t.confirms(cache_id, now + 2s));
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
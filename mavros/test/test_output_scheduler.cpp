@@ -0,0 +1,86 @@
+/**
+ * Test libmavros output scheduler
+ */
+
+#include <gtest/gtest.h>
+
+#include <mavros/output_scheduler.h>
+
+using namespace mavros;
+using namespace std::chrono;
+
+using clock_t_ = OutputScheduler::clock;
+
+TEST(OUTPUT_SCHEDULER, pass_through)
+{
+	OutputScheduler s;
+	auto t = clock_t_::time_point();
+
+	for (int i = 0; i < 10; i++)
+		EXPECT_TRUE(s.update(0.0, t + microseconds(i)));
+
+	EXPECT_FALSE(s.tick(t + seconds(10)));
+	EXPECT_EQ(10U, s.get_stats().sent);
+}
+
+TEST(OUTPUT_SCHEDULER, rate_limit_latest_wins)
+{
+	OutputScheduler s(OutputScheduler::from_rates(50.0, 0.0, 0.0));
+	auto t = clock_t_::time_point();
+
+	// 1 kHz input
+	size_t sent = 0;
+	for (int i = 0; i < 100; i++) {
+		auto now = t + milliseconds(i);
+		sent += s.update(1.0, now);
+		sent += s.tick(now);
+	}
+
+	EXPECT_EQ(5U, sent);
+	EXPECT_EQ(100U, s.get_stats().received);
+
+	// last value was delayed, tick sends it
+	EXPECT_TRUE(s.tick(t + milliseconds(120)));
+	EXPECT_FALSE(s.tick(t + milliseconds(200)));
+}
+
+TEST(OUTPUT_SCHEDULER, change_threshold)
+{
+	OutputScheduler s(OutputScheduler::from_rates(10.0, 0.0, 100.0));
+	auto t = clock_t_::time_point();
+
+	EXPECT_TRUE(s.update(0.0, t));
+	EXPECT_FALSE(s.update(50.0, t + milliseconds(10)));
+	EXPECT_TRUE(s.update(150.0, t + milliseconds(20)));
+	EXPECT_EQ(1U, s.get_stats().immediate);
+
+	// period counts from immediate send
+	EXPECT_FALSE(s.tick(t + milliseconds(110)));
+	EXPECT_FALSE(s.tick(t + milliseconds(120)));
+}
+
+TEST(OUTPUT_SCHEDULER, keepalive)
+{
+	OutputScheduler s(OutputScheduler::from_rates(0.0, 2.0, 0.0));
+	auto t = clock_t_::time_point();
+
+	// nothing to keep alive before first value
+	EXPECT_FALSE(s.tick(t));
+	EXPECT_EQ(milliseconds(500), s.timer_period());
+
+	EXPECT_TRUE(s.update(0.0, t));
+	EXPECT_FALSE(s.tick(t + milliseconds(400)));
+	EXPECT_TRUE(s.tick(t + milliseconds(500)));
+	EXPECT_FALSE(s.tick(t + milliseconds(900)));
+	EXPECT_TRUE(s.tick(t + milliseconds(1000)));
+	EXPECT_EQ(2U, s.get_stats().keepalive);
+
+	s.reset();
+	EXPECT_FALSE(s.tick(t + seconds(5)));
+}
+
+int main(int argc, char **argv)
+{
+	testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,314 @@
+/**
+ * Test libmavros plugin dispatcher
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <mavros/plugin_dispatch.h>
+
+using namespace mavros;
+using mavconn::Framing;
+using mavlink::mavlink_message_t;
+
+static mavlink_message_t make_msg(mavlink::msgid_t msgid, uint8_t seq)
+{
+	mavlink_message_t msg {};
+	msg.msgid = msgid;
+	msg.seq = seq;
+	return msg;
+}
+
+static bool wait_for(std::function<bool()> pred)
+{
+	for (int i = 0; i < 500 && !pred(); i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+	return pred();
+}
+
+TEST(PLUGIN_DISPATCH, order_and_threads)
+{
+	PluginDispatcher disp;
+	std::mutex mutex;
+	std::vector<uint8_t> slow_seqs, fast_seqs, queued_seqs;
+	std::thread::id io_thread = std::this_thread::get_id();
+	bool fast_inline = true, queued_off_io = true;
+
+	auto slow = disp.add_plugin("slow", false);
+	auto fast = disp.add_plugin("fast", true);
+	auto queued = disp.add_plugin("queued", false);
+
+	disp.add_handler(slow, 0, MessageHandler::from_function([&](const mavlink_message_t *msg, const Framing framing) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			std::lock_guard<std::mutex> lock(mutex);
+			slow_seqs.push_back(msg->seq);
+		}));
+	disp.add_handler(fast, 0, MessageHandler::from_function([&](const mavlink_message_t *msg, const Framing framing) {
+			fast_inline &= std::this_thread::get_id() == io_thread;
+			fast_seqs.push_back(msg->seq);
+		}));
+	disp.add_handler(queued, 0, MessageHandler::from_function([&](const mavlink_message_t *msg, const Framing framing) {
+			std::lock_guard<std::mutex> lock(mutex);
+			queued_off_io &= std::this_thread::get_id() != io_thread;
+			queued_seqs.push_back(msg->seq);
+		}));
+
+	disp.start(2);
+
+	for (int i = 0; i < 100; i++) {
+		auto msg = make_msg(0, i);
+		disp.dispatch(&msg, Framing::ok, 0);
+	}
+
+	// fast path already done, slow plugin did not delay other queue
+	EXPECT_EQ(fast_seqs.size(), 100);
+	EXPECT_TRUE(wait_for([&]() { std::lock_guard<std::mutex> lock(mutex); return queued_seqs.size() == 100; }));
+	EXPECT_TRUE(wait_for([&]() { std::lock_guard<std::mutex> lock(mutex); return slow_seqs.size() == 100; }));
+	disp.stop();
+
+	EXPECT_TRUE(fast_inline);
+	EXPECT_TRUE(queued_off_io);
+	for (size_t i = 0; i < 100; i++) {
+		EXPECT_EQ(slow_seqs[i], i);
+		EXPECT_EQ(queued_seqs[i], i);
+	}
+}
+
+TEST(PLUGIN_DISPATCH, overflow)
+{
+	PluginDispatcher disp;
+	std::mutex block;
+	size_t handled = 0;
+
+	auto p = disp.add_plugin("blocked", false, 8);
+	disp.add_handler(p, 0, MessageHandler::from_function([&](const mavlink_message_t *msg, const Framing framing) {
+			std::lock_guard<std::mutex> lock(block);
+			handled++;
+		}));
+
+	block.lock();
+	disp.start(1);
+
+	for (int i = 0; i < 20; i++) {
+		auto msg = make_msg(0, i);
+		disp.dispatch(&msg, Framing::ok, 0);
+	}
+
+	// other ids are not routed to plugin
+	auto other = make_msg(1, 0);
+	disp.dispatch(&other, Framing::ok, 0);
+
+	block.unlock();
+	auto stats = disp.get_stats();
+	ASSERT_EQ(stats.size(), 1);
+	EXPECT_EQ(stats[0].queue_high_water, 8);
+	EXPECT_EQ(stats[0].dropped, 12);
+
+	EXPECT_TRUE(wait_for([&]() { return disp.get_stats()[0].handled + disp.get_stats()[0].dropped == 20; }));
+	disp.stop();
+}
+
+TEST(PLUGIN_DISPATCH, inline_without_workers)
+{
+	PluginDispatcher disp;
+	size_t handled = 0;
+
+	auto p = disp.add_plugin("any", false);
+	disp.add_handler(p, 0, MessageHandler::from_function([&](const mavlink_message_t *msg, const Framing framing) { handled++; }));
+	disp.start(0);
+
+	auto msg = make_msg(0, 0);
+	disp.dispatch(&msg, Framing::ok, 0);
+	EXPECT_EQ(handled, 1);
+}
+
+TEST(PLUGIN_DISPATCH, table_lookup)
+{
+	PluginDispatcher disp;
+	std::vector<std::pair<size_t, mavlink::msgid_t>> calls;
+
+	auto a = disp.add_plugin("a", false);
+	auto b = disp.add_plugin("b", false);
+	for (mavlink::msgid_t id : {0u, 255u, 256u, 12900u, 65535u, 65536u, 70000u}) {
+		// added out of plugin order, called in plugin order
+		disp.add_handler(b, id, MessageHandler::from_function([&, id](const mavlink_message_t *msg, const Framing framing) { calls.emplace_back(1, id); }));
+		disp.add_handler(a, id, MessageHandler::from_function([&, id](const mavlink_message_t *msg, const Framing framing) { calls.emplace_back(0, id); }));
+	}
+	disp.start(0);
+
+	for (mavlink::msgid_t id : {0u, 1u, 255u, 256u, 257u, 12900u, 65535u, 65536u, 65537u, 70000u}) {
+		auto msg = make_msg(id, 0);
+		disp.dispatch(&msg, Framing::ok, 0);
+	}
+
+	std::vector<mavlink::msgid_t> routed {0, 255, 256, 12900, 65535, 65536, 70000};
+	ASSERT_EQ(calls.size(), routed.size() * 2);
+	for (size_t i = 0; i < routed.size(); i++) {
+		EXPECT_EQ(calls[i * 2], std::make_pair(size_t(0), routed[i]));
+		EXPECT_EQ(calls[i * 2 + 1], std::make_pair(size_t(1), routed[i]));
+	}
+}
+
+TEST(PLUGIN_DISPATCH, lazy_activation)
+{
+	for (size_t nthreads : {0, 1}) {
+		PluginDispatcher disp;
+		std::atomic<int> activated { 0 };
+		std::atomic<bool> handled_active { true };
+		std::atomic<size_t> handled { 0 };
+
+		auto p = disp.add_plugin("lazy", false, 8, [&]() { activated++; });
+		disp.add_handler(p, 5, MessageHandler::from_function([&](const mavlink_message_t *msg, const Framing framing) {
+				handled_active = handled_active && activated == 1;
+				handled++;
+			}));
+		disp.start(nthreads);
+
+		// not routed to plugin, it stays inactive
+		auto other = make_msg(1, 0);
+		disp.dispatch(&other, Framing::ok, 0);
+		EXPECT_FALSE(disp.get_stats()[0].active);
+		EXPECT_EQ(activated, 0);
+
+		for (int i = 0; i < 5; i++) {
+			auto msg = make_msg(5, i);
+			disp.dispatch(&msg, Framing::ok, 0);
+		}
+
+		EXPECT_TRUE(wait_for([&]() { return handled == 5; }));
+		disp.stop();
+
+		EXPECT_EQ(activated, 1);
+		EXPECT_TRUE(handled_active);
+		EXPECT_TRUE(disp.get_stats()[0].active);
+	}
+}
+
+using mavlink::common::msg::HEARTBEAT;
+
+static std::atomic<size_t> decode_count { 0 };
+
+//! Counts decodes, otherwise same as MessageDecoder::get<HEARTBEAT>()
+static const MessageDecoder counting_decoder {
+	typeid(HEARTBEAT).hash_code(),
+	sizeof(HEARTBEAT),
+	[](const mavlink_message_t *msg, void *storage) {
+		decode_count++;
+		MessageDecoder::get<HEARTBEAT>()->decode(msg, storage);
+	},
+	[](void *storage) {
+		MessageDecoder::get<HEARTBEAT>()->destroy(storage);
+	}
+};
+
+//! Same binding as typed PluginBase::make_handler()
+static MessageHandler typed_handler(std::function<void(const HEARTBEAT &)> *fn)
+{
+	return MessageHandler {
+		[](const void *obj, const mavlink_message_t *msg, const Framing framing, const void *decoded) {
+			auto &cb = *static_cast<const std::function<void(const HEARTBEAT &)> *>(obj);
+			if (decoded) {
+				cb(*static_cast<const HEARTBEAT *>(decoded));
+				return;
+			}
+
+			HEARTBEAT hb;
+			counting_decoder.decode(msg, &hb);
+			cb(hb);
+		},
+		std::shared_ptr<const void>(fn, [](const void *) {}),
+		&counting_decoder
+	};
+}
+
+TEST(PLUGIN_DISPATCH, decode_once)
+{
+	for (size_t nthreads : {0, 2}) {
+		PluginDispatcher disp;
+		std::mutex mutex;
+		std::vector<uint8_t> types;
+		std::function<void(const HEARTBEAT &)> cb = [&](const HEARTBEAT &hb) {
+			std::lock_guard<std::mutex> lock(mutex);
+			types.push_back(hb.type);
+		};
+
+		auto a = disp.add_plugin("a", false);
+		auto b = disp.add_plugin("b", true);
+		auto c = disp.add_plugin("c", false);
+		disp.add_handler(a, HEARTBEAT::MSG_ID, typed_handler(&cb));
+		disp.add_handler(b, HEARTBEAT::MSG_ID, typed_handler(&cb));
+		disp.add_handler(c, HEARTBEAT::MSG_ID, typed_handler(&cb));
+		disp.start(nthreads);
+
+		decode_count = 0;
+		for (int i = 0; i < 50; i++) {
+			HEARTBEAT hb {};
+			hb.type = i;
+			mavlink_message_t msg {};
+			mavlink::MsgMap map(msg);
+			hb.serialize(map);
+			disp.dispatch(&msg, Framing::ok, 0);
+		}
+
+		EXPECT_TRUE(wait_for([&]() { std::lock_guard<std::mutex> lock(mutex); return types.size() == 150; }));
+		disp.stop();
+
+		EXPECT_EQ(decode_count, 50);
+		std::vector<size_t> seen(50);
+		for (auto t : types)
+			seen[t]++;
+		for (auto n : seen)
+			EXPECT_EQ(n, 3);
+	}
+}
+
+TEST(PLUGIN_DISPATCH, profile)
+{
+	PluginDispatcher disp;
+
+	auto slow = disp.add_plugin("slow", false);
+	auto fast = disp.add_plugin("fast", true);
+	disp.add_handler(slow, 0, MessageHandler::from_function([&](const mavlink_message_t *msg, const Framing framing) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		}));
+	disp.add_handler(fast, 0, MessageHandler::from_function([&](const mavlink_message_t *msg, const Framing framing) { }));
+	disp.add_handler(fast, 1, MessageHandler::from_function([&](const mavlink_message_t *msg, const Framing framing) { }));
+	disp.start(1);
+
+	// off by default
+	auto msg = make_msg(0, 0);
+	disp.dispatch(&msg, Framing::ok, 0);
+	EXPECT_TRUE(wait_for([&]() { return disp.get_stats()[slow].handled == 1; }));
+	EXPECT_TRUE(disp.get_profile().empty());
+
+	disp.set_profiling(true);
+	for (uint8_t i = 0; i < 5; i++) {
+		msg = make_msg(0, i);
+		disp.dispatch(&msg, Framing::ok, 0);
+	}
+
+	EXPECT_TRUE(wait_for([&]() { return disp.get_stats()[slow].handled == 6; }));
+	disp.stop();
+
+	auto prof = disp.get_profile();
+	ASSERT_EQ(prof.size(), 2);
+	EXPECT_EQ(prof[0].name, "slow");
+	EXPECT_EQ(prof[0].msgid, 0);
+	EXPECT_FALSE(prof[0].fast_path);
+	EXPECT_EQ(prof[0].calls, 5);
+	EXPECT_GE(prof[0].max_ns, prof[0].p50_ns);
+	EXPECT_GT(prof[0].total_ns, 5 * 1000000);
+	EXPECT_EQ(prof[1].name, "fast");
+	EXPECT_TRUE(prof[1].fast_path);
+	EXPECT_EQ(prof[1].calls, 5);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
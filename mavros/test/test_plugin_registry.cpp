@@ -0,0 +1,45 @@
+/**
+ * Test libmavros static plugin registry
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#define MAVROS_STATIC_PLUGINS
+#include <mavros/plugin_registry.h>
+
+using namespace mavros::plugin;
+
+namespace {
+class TestPlugin : public PluginBase {
+public:
+	Subscriptions get_subscriptions() override {
+		return {};
+	}
+};
+}	// namespace
+
+MAVROS_PLUGIN_EXPORT(test_registry, TestPlugin)
+
+TEST(PLUGIN_REGISTRY, create)
+{
+	auto names = PluginRegistry::get_names();
+	EXPECT_NE(std::find(names.begin(), names.end(), "test_registry"), names.end());
+	EXPECT_TRUE(std::is_sorted(names.begin(), names.end()));
+
+	auto a = PluginRegistry::create("test_registry");
+	auto b = PluginRegistry::create("test_registry");
+	ASSERT_NE(a, nullptr);
+	EXPECT_NE(a, b);	// new instance each time
+	EXPECT_NE(dynamic_cast<TestPlugin *>(a.get()), nullptr);
+
+	EXPECT_TRUE(PluginRegistry::has("test_registry"));
+	EXPECT_FALSE(PluginRegistry::has("no_such_plugin"));
+	EXPECT_THROW(PluginRegistry::create("no_such_plugin"), std::out_of_range);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
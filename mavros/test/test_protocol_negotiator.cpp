@@ -0,0 +1,114 @@
+/**
+ * Test libmavros protocol negotiator
+ */
+
+#include <gtest/gtest.h>
+
+#include <mavros/protocol_negotiator.h>
+
+using mavros::ProtocolNegotiator;
+using State = ProtocolNegotiator::State;
+using mavconn::Protocol;
+using namespace std::chrono_literals;
+
+static constexpr uint32_t HEARTBEAT_ID = mavlink::common::msg::HEARTBEAT::MSG_ID;
+static constexpr uint32_t ATTITUDE_ID = mavlink::common::msg::ATTITUDE::MSG_ID;
+
+TEST(PROTOCOL_NEGOTIATOR, v2_heartbeat)
+{
+	ProtocolNegotiator neg;
+	auto now = ProtocolNegotiator::clock::now();
+
+	EXPECT_EQ(neg.get_protocol(), Protocol::V10);
+	EXPECT_TRUE(neg.frame_received(MAVLINK_STX, HEARTBEAT_ID, now));
+	EXPECT_EQ(neg.get_state(), State::V2);
+	EXPECT_EQ(neg.get_protocol(), Protocol::V20);
+
+	// already switched
+	EXPECT_FALSE(neg.frame_received(MAVLINK_STX, ATTITUDE_ID, now));
+	EXPECT_FALSE(neg.frame_received(MAVLINK_STX_MAVLINK1, HEARTBEAT_ID, now));
+	EXPECT_FALSE(neg.probe_due(now));
+}
+
+TEST(PROTOCOL_NEGOTIATOR, v1_probe)
+{
+	ProtocolNegotiator neg(true, 1s, 2);
+	auto now = ProtocolNegotiator::clock::now();
+
+	// only heartbeat starts negotiation
+	EXPECT_FALSE(neg.frame_received(MAVLINK_STX_MAVLINK1, ATTITUDE_ID, now));
+	EXPECT_EQ(neg.get_state(), State::WAIT_HEARTBEAT);
+
+	EXPECT_FALSE(neg.frame_received(MAVLINK_STX_MAVLINK1, HEARTBEAT_ID, now));
+	EXPECT_EQ(neg.get_state(), State::PROBE);
+	EXPECT_EQ(neg.get_protocol(), Protocol::V10);
+
+	EXPECT_TRUE(neg.probe_due(now));
+	EXPECT_FALSE(neg.probe_due(now + 500ms));
+	EXPECT_TRUE(neg.probe_due(now + 1s));
+
+	// answer in MAVLink 2 framing
+	EXPECT_TRUE(neg.frame_received(MAVLINK_STX, mavlink::common::msg::PROTOCOL_VERSION::MSG_ID, now + 1100ms));
+	EXPECT_EQ(neg.get_protocol(), Protocol::V20);
+	EXPECT_FALSE(neg.probe_due(now + 2s));
+}
+
+TEST(PROTOCOL_NEGOTIATOR, v1_only)
+{
+	ProtocolNegotiator neg(true, 1s, 2);
+	auto now = ProtocolNegotiator::clock::now();
+
+	neg.frame_received(MAVLINK_STX_MAVLINK1, HEARTBEAT_ID, now);
+	EXPECT_TRUE(neg.probe_due(now));
+	EXPECT_TRUE(neg.probe_due(now + 1s));
+	EXPECT_FALSE(neg.probe_due(now + 2s));
+	EXPECT_EQ(neg.get_state(), State::V1);
+	EXPECT_EQ(neg.get_protocol(), Protocol::V10);
+
+	// capability still switches
+	EXPECT_TRUE(neg.mavlink2_supported());
+	EXPECT_EQ(neg.get_protocol(), Protocol::V20);
+	EXPECT_FALSE(neg.mavlink2_supported());
+
+	neg.reset();
+	EXPECT_EQ(neg.get_state(), State::WAIT_HEARTBEAT);
+	EXPECT_EQ(neg.get_protocol(), Protocol::V10);
+}
+
+TEST(PROTOCOL_NEGOTIATOR, no_probe)
+{
+	ProtocolNegotiator neg(false);
+	auto now = ProtocolNegotiator::clock::now();
+
+	neg.frame_received(MAVLINK_STX_MAVLINK1, HEARTBEAT_ID, now);
+	EXPECT_EQ(neg.get_state(), State::V1);
+	EXPECT_FALSE(neg.probe_due(now));
+
+	// peer switched later
+	EXPECT_TRUE(neg.frame_received(MAVLINK_STX, HEARTBEAT_ID, now));
+	EXPECT_EQ(neg.get_protocol(), Protocol::V20);
+}
+
+TEST(PROTOCOL_NEGOTIATOR, make_probe)
+{
+	auto msg = ProtocolNegotiator::make_probe(1, 240, 1, 1, 7);
+
+	EXPECT_EQ(msg.magic, MAVLINK_STX);
+	EXPECT_EQ(msg.msgid, mavlink::common::msg::COMMAND_LONG::MSG_ID);
+	EXPECT_EQ(msg.sysid, 1);
+	EXPECT_EQ(msg.compid, 240);
+	EXPECT_EQ(msg.seq, 7);
+
+	mavlink::common::msg::COMMAND_LONG cmd;
+	mavlink::MsgMap map(msg);
+	cmd.deserialize(map);
+	EXPECT_EQ(cmd.command, 519);	// MAV_CMD_REQUEST_PROTOCOL_VERSION
+	EXPECT_EQ(cmd.target_system, 1);
+	EXPECT_EQ(cmd.target_component, 1);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,104 @@
+/**
+ * Test libmavros request window
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <mavros/request_window.h>
+
+using namespace mavros;
+using namespace std::chrono;
+
+using clock_t_ = RequestWindow::clock;
+
+TEST(REQUEST_WINDOW, window_limit_and_refill)
+{
+	RequestWindow w(4, 3, milliseconds(1000));
+	std::vector<uint16_t> sent;
+	auto send = [&sent](uint16_t idx) { sent.push_back(idx); };
+
+	auto t = clock_t_::time_point();
+	w.reset(10);
+	w.received(1, t);
+	w.received(2, t);
+
+	w.poll(t, send);
+	EXPECT_EQ((std::vector<uint16_t> {0, 3, 4, 5}), sent);
+	EXPECT_EQ(4U, w.in_flight());
+	EXPECT_EQ(8U, w.missing());
+
+	// one reply frees one slot
+	sent.clear();
+	t += milliseconds(100);
+	EXPECT_TRUE(w.received(3, t));
+	EXPECT_FALSE(w.received(3, t));
+	w.poll(t, send);
+	EXPECT_EQ((std::vector<uint16_t> {6}), sent);
+	EXPECT_TRUE(w.is_received(3));
+}
+
+TEST(REQUEST_WINDOW, adaptive_timeout)
+{
+	RequestWindow w(2, 3, milliseconds(1000));
+	std::vector<uint16_t> sent;
+	auto send = [&sent](uint16_t idx) { sent.push_back(idx); };
+
+	auto t = clock_t_::time_point();
+	w.reset(100);
+	EXPECT_EQ(milliseconds(1000), w.timeout());
+
+	for (uint16_t idx = 0; idx < 50; idx++) {
+		w.poll(t, send);
+		t += milliseconds(80);
+		w.received(idx, t);
+	}
+
+	// steady 80 ms RTT, variance is decaying
+	EXPECT_LT(w.timeout(), milliseconds(200));
+	EXPECT_GE(w.timeout(), milliseconds(80));
+}
+
+TEST(REQUEST_WINDOW, retry_then_lost)
+{
+	RequestWindow w(1, 2, milliseconds(100));
+	std::vector<uint16_t> sent;
+	auto send = [&sent](uint16_t idx) { sent.push_back(idx); };
+
+	auto t = clock_t_::time_point();
+	w.reset(2);
+
+	size_t lost = 0;
+	for (int i = 0; i < 100 && !w.done(); i++, t += milliseconds(50))
+		lost += w.poll(t, send);
+
+	EXPECT_TRUE(w.done());
+	EXPECT_EQ(2U, lost);
+	EXPECT_EQ(2U, w.lost());
+	EXPECT_EQ((std::vector<uint16_t> {0, 0, 0, 1, 1, 1}), sent);
+
+	// late reply is still accepted
+	EXPECT_TRUE(w.received(1, t));
+	EXPECT_EQ(1U, w.lost());
+	EXPECT_EQ(1U, w.missing());
+	EXPECT_TRUE(w.done());
+}
+
+TEST(RTT_ESTIMATOR, backoff_and_clamp)
+{
+	RttEstimator rtt(milliseconds(1000));
+	EXPECT_EQ(milliseconds(1000), rtt.timeout());
+	EXPECT_EQ(milliseconds(4000), rtt.timeout(3));
+	EXPECT_EQ(RttEstimator::MAX_TIMEOUT, rtt.timeout(10));
+
+	// fast link: one sample gives srtt + 4 * srtt / 2
+	rtt.sample(milliseconds(5));
+	EXPECT_EQ(milliseconds(5), rtt.srtt());
+	EXPECT_EQ(RttEstimator::MIN_TIMEOUT, rtt.timeout());
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,255 @@
+/**
+ * Test libmavros RTCM injector
+ */
+
+#include <gtest/gtest.h>
+
+#include <mavros/rtcm_injector.h>
+
+using namespace mavros;
+using namespace std::chrono;
+
+using clock_ = RtcmInjector::clock;
+
+//! RTCM3 frame of given type with payload_len bytes of payload
+static std::vector<uint8_t> make_frame(uint16_t type, size_t payload_len)
+{
+	std::vector<uint8_t> f(payload_len + RtcmInjector::RTCM3_OVERHEAD);
+
+	f[0] = 0xD3;
+	f[1] = (payload_len >> 8) & 0x03;
+	f[2] = payload_len & 0xFF;
+	f[3] = type >> 4;
+	f[4] = (type & 0x0F) << 4;
+	for (size_t i = 5; i < payload_len + 3; i++)
+		f[i] = i & 0xFF;
+
+	auto crc = RtcmInjector::crc24q(f.data(), payload_len + 3);
+	f[payload_len + 3] = crc >> 16;
+	f[payload_len + 4] = crc >> 8;
+	f[payload_len + 5] = crc;
+	return f;
+}
+
+struct Sink {
+	std::vector<RtcmInjector::Fragment> fragments;
+	std::vector<uint8_t> bytes;
+
+	RtcmInjector::SendFn fn() {
+		return [this](const RtcmInjector::Fragment &f) {
+			       fragments.push_back(f);
+			       bytes.insert(bytes.end(), f.data, f.data + f.len);
+		       };
+	}
+};
+
+TEST(RTCM_INJECTOR, crc24q)
+{
+	// "123456789" check value
+	const uint8_t data[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+	EXPECT_EQ(0xCDE703U, RtcmInjector::crc24q(data, sizeof(data)));
+}
+
+TEST(RTCM_INJECTOR, split_frame)
+{
+	RtcmInjector inj;
+	Sink sink;
+	auto f = make_frame(1077, 100);
+	auto now = clock_::now();
+
+	inj.push_stream(f.data(), 40, now);
+	EXPECT_EQ(0U, inj.queued());
+	inj.push_stream(f.data() + 40, f.size() - 40, now);
+	EXPECT_EQ(1U, inj.queued());
+
+	EXPECT_EQ(1U, inj.poll(sink.fn(), now));
+	EXPECT_EQ(f, sink.bytes);
+	EXPECT_EQ(0, sink.fragments[0].flags & 1);
+	EXPECT_EQ(1U, inj.get_stats().frames);
+}
+
+TEST(RTCM_INJECTOR, bad_crc_skipped)
+{
+	RtcmInjector inj;
+	Sink sink;
+	auto bad = make_frame(1077, 50);
+	auto good = make_frame(1087, 50);
+	bad[10] ^= 0xFF;
+
+	std::vector<uint8_t> stream = {0x00, 0x42};
+	stream.insert(stream.end(), bad.begin(), bad.end());
+	stream.insert(stream.end(), good.begin(), good.end());
+
+	auto now = clock_::now();
+	inj.push_stream(stream.data(), stream.size(), now);
+	inj.poll(sink.fn(), now);
+
+	EXPECT_EQ(good, sink.bytes);
+	auto st = inj.get_stats();
+	EXPECT_EQ(1U, st.frames);
+	EXPECT_EQ(1U, st.crc_errors);
+	EXPECT_EQ(2U + bad.size(), st.skipped_bytes);
+}
+
+TEST(RTCM_INJECTOR, pack_and_fragment)
+{
+	RtcmInjector inj;
+	Sink sink;
+	auto now = clock_::now();
+
+	// 3 small frames packed into one unit, 2 fragments
+	auto f1 = make_frame(1077, 94);
+	for (int i = 0; i < 3; i++)
+		inj.push_stream(f1.data(), f1.size(), now);
+	EXPECT_EQ(1U, inj.queued());
+
+	// big frame does not fit, goes to new unit
+	auto f2 = make_frame(1127, 600);
+	inj.push_stream(f2.data(), f2.size(), now);
+	EXPECT_EQ(2U, inj.queued());
+
+	EXPECT_EQ(2U + 4U, inj.poll(sink.fn(), now));
+	ASSERT_EQ(6U, sink.fragments.size());
+
+	// first unit: 300 bytes, seq 0
+	EXPECT_EQ(1 | (0 << 1), sink.fragments[0].flags);
+	EXPECT_EQ(180, sink.fragments[0].len);
+	EXPECT_EQ(1 | (1 << 1), sink.fragments[1].flags);
+	EXPECT_EQ(120, sink.fragments[1].len);
+
+	// second unit: 606 bytes, seq 1
+	for (int i = 0; i < 4; i++)
+		EXPECT_EQ(1 | (i << 1) | (1 << 3), sink.fragments[2 + i].flags);
+	EXPECT_EQ(66, sink.fragments[5].len);
+
+	std::vector<uint8_t> expected;
+	for (int i = 0; i < 3; i++)
+		expected.insert(expected.end(), f1.begin(), f1.end());
+	expected.insert(expected.end(), f2.begin(), f2.end());
+	EXPECT_EQ(expected, sink.bytes);
+}
+
+TEST(RTCM_INJECTOR, whole_fragments_terminated)
+{
+	RtcmInjector inj;
+	Sink sink;
+	std::vector<uint8_t> msg(360, 0x55);
+
+	inj.push_message(msg.data(), msg.size());
+	EXPECT_EQ(3U, inj.poll(sink.fn()));
+	EXPECT_EQ(0, sink.fragments[2].len);
+	EXPECT_EQ(msg, sink.bytes);
+}
+
+TEST(RTCM_INJECTOR, large_message_split)
+{
+	RtcmInjector inj;
+	Sink sink;
+	std::vector<uint8_t> msg(1000);
+	for (size_t i = 0; i < msg.size(); i++)
+		msg[i] = i & 0xFF;
+
+	inj.push_message(msg.data(), msg.size());
+	EXPECT_EQ(2U, inj.queued());
+	EXPECT_EQ(4U + 2U, inj.poll(sink.fn()));
+	EXPECT_EQ(msg, sink.bytes);
+}
+
+TEST(RTCM_INJECTOR, stale_epoch_dropped)
+{
+	RtcmInjector::Options opts;
+	opts.epoch_gap = milliseconds(200);
+	RtcmInjector inj(opts);
+	Sink sink;
+	auto t0 = clock_::now();
+
+	auto station = make_frame(1005, 19);
+	auto obs = make_frame(1077, 700);
+	inj.push_stream(station.data(), station.size(), t0);
+	inj.push_stream(obs.data(), obs.size(), t0 + milliseconds(10));
+	EXPECT_EQ(2U, inj.queued());
+
+	// next epoch, observations of previous one are obsolete
+	auto obs2 = make_frame(1087, 300);
+	inj.push_stream(obs2.data(), obs2.size(), t0 + milliseconds(1000));
+	EXPECT_EQ(2U, inj.queued());
+	EXPECT_EQ(1U, inj.get_stats().stale_units);
+
+	inj.poll(sink.fn(), t0 + milliseconds(1000));
+	std::vector<uint8_t> expected(station);
+	expected.insert(expected.end(), obs2.begin(), obs2.end());
+	EXPECT_EQ(expected, sink.bytes);
+}
+
+TEST(RTCM_INJECTOR, pool_overflow)
+{
+	RtcmInjector::Options opts;
+	opts.pool_size = 2;
+	RtcmInjector inj(opts);
+	Sink sink;
+	std::vector<uint8_t> msg(RtcmInjector::UNIT_LEN, 0x11);
+
+	for (int i = 0; i < 3; i++) {
+		msg[0] = i;
+		inj.push_message(msg.data(), msg.size());
+	}
+
+	EXPECT_EQ(2U, inj.queued());
+	EXPECT_EQ(1U, inj.get_stats().overflow_units);
+
+	inj.poll(sink.fn());
+	ASSERT_EQ(2 * RtcmInjector::UNIT_LEN, sink.bytes.size());
+	EXPECT_EQ(1, sink.bytes[0]);
+	EXPECT_EQ(2, sink.bytes[RtcmInjector::UNIT_LEN]);
+}
+
+TEST(RTCM_INJECTOR, bandwidth_pacing)
+{
+	RtcmInjector::Options opts;
+	opts.bandwidth = 8000;
+	RtcmInjector inj(opts);
+	Sink sink;
+	auto t0 = clock_::now();
+
+	// full units, 776 bytes on the wire each
+	std::vector<uint8_t> msg(RtcmInjector::UNIT_LEN, 0x22);
+	for (int i = 0; i < 4; i++)
+		inj.push_message(msg.data(), msg.size(), t0);
+
+	// burst is 100 ms of bandwidth
+	inj.poll(sink.fn(), t0);
+	EXPECT_EQ(4U, sink.fragments.size());
+
+	inj.poll(sink.fn(), t0 + milliseconds(50));
+	EXPECT_EQ(4U, sink.fragments.size());
+
+	inj.poll(sink.fn(), t0 + milliseconds(100));
+	EXPECT_EQ(8U, sink.fragments.size());
+
+	// idle time does not accumulate over burst
+	inj.poll(sink.fn(), t0 + milliseconds(1000));
+	EXPECT_EQ(12U, sink.fragments.size());
+	EXPECT_EQ(1U, inj.queued());
+}
+
+TEST(RTCM_INJECTOR, sequence_wraps)
+{
+	RtcmInjector inj;
+	Sink sink;
+	uint8_t b = 0;
+
+	for (int i = 0; i < 33; i++) {
+		inj.push_message(&b, 1);
+		inj.poll(sink.fn());
+	}
+
+	ASSERT_EQ(33U, sink.fragments.size());
+	EXPECT_EQ(31 << 3, sink.fragments[31].flags);
+	EXPECT_EQ(0, sink.fragments[32].flags);
+}
+
+int main(int argc, char **argv)
+{
+	testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,87 @@
+/**
+ * Test libmavros sequence lock
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <mavros/seqlock.h>
+
+using namespace mavros;
+
+//! Fields are always equal when copy is consistent
+struct State {
+	uint64_t a;
+	double b;
+	uint32_t c;
+	uint8_t d[13];
+};
+
+static State make_state(uint64_t n)
+{
+	State s {};
+	s.a = n;
+	s.b = n;
+	s.c = n;
+	for (auto &d : s.d)
+		d = n & 0xff;
+	return s;
+}
+
+TEST(SEQLOCK, store_load)
+{
+	SeqLock<State> lock(make_state(7));
+
+	EXPECT_EQ(lock.load().a, 7);
+	EXPECT_EQ(lock.version(), 0);
+
+	lock.store(make_state(42));
+	auto s = lock.load();
+	EXPECT_EQ(s.a, 42);
+	EXPECT_EQ(s.b, 42.0);
+	EXPECT_EQ(s.d[12], 42);
+	EXPECT_EQ(lock.version(), 1);
+}
+
+TEST(SEQLOCK, consistent_snapshot)
+{
+	SeqLock<State> lock(make_state(0));
+	std::atomic<bool> done { false };
+	std::atomic<size_t> torn { 0 };
+
+	std::vector<std::thread> readers;
+	for (int i = 0; i < 2; i++) {
+		readers.emplace_back([&]() {
+				while (!done) {
+					auto s = lock.load();
+					bool ok = s.b == s.a && s.c == uint32_t(s.a);
+					for (auto d : s.d)
+						ok &= d == (s.a & 0xff);
+					torn += !ok;
+				}
+			});
+	}
+
+	// two writers, stores are serialized
+	std::thread writer2([&]() {
+			for (uint64_t n = 1; n < 20000; n += 2)
+				lock.store(make_state(n));
+		});
+	for (uint64_t n = 2; n < 20000; n += 2)
+		lock.store(make_state(n));
+
+	writer2.join();
+	done = true;
+	for (auto &r : readers)
+		r.join();
+
+	EXPECT_EQ(torn, 0);
+	EXPECT_EQ(lock.version(), 19999);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,123 @@
+/**
+ * Test libmavros setpoint geofence check
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <mavros/setpoint_geofence.h>
+
+using mavros::GeofenceIndex;
+using Eigen::Vector2d;
+using Eigen::Vector3d;
+
+namespace {
+//! 20 m square keep-in zone with 5 m keep-out circle in the middle
+GeofenceIndex make_fence(GeofenceIndex::Action action)
+{
+	GeofenceIndex::Options opts;
+	opts.action = action;
+	opts.margin = 0.5;
+
+	return GeofenceIndex({
+			GeofenceIndex::polygon(true, {{-20, -20}, {20, -20}, {20, 20}, {-20, 20}}),
+			GeofenceIndex::circle(false, {10, 0}, 5),
+		}, opts, {47.3977, 8.5456, Vector2d::Zero()});
+}
+
+//! POSITION_TARGET_TYPEMASK X_IGNORE | Y_IGNORE
+constexpr uint16_t XY_IGNORE = 3;
+}	// namespace
+
+TEST(SETPOINT_GEOFENCE, no_fence)
+{
+	Vector2d enu(100, 100);
+	EXPECT_TRUE(mavros::setpoint_geofence(nullptr, enu));
+	EXPECT_EQ(enu, Vector2d(100, 100));
+}
+
+TEST(SETPOINT_GEOFENCE, action)
+{
+	auto none = make_fence(GeofenceIndex::Action::NONE);
+	auto reject = make_fence(GeofenceIndex::Action::REJECT);
+	auto clamp = make_fence(GeofenceIndex::Action::CLAMP);
+
+	Vector2d enu(30, 0);
+	EXPECT_TRUE(mavros::setpoint_geofence(&none, enu));
+	EXPECT_EQ(enu, Vector2d(30, 0));
+
+	EXPECT_FALSE(mavros::setpoint_geofence(&reject, enu));
+	EXPECT_EQ(enu, Vector2d(30, 0));
+
+	EXPECT_TRUE(mavros::setpoint_geofence(&clamp, enu));
+	EXPECT_NEAR(enu.x(), 19.5, 1e-6);
+	EXPECT_NEAR(enu.y(), 0.0, 1e-6);
+	EXPECT_TRUE(clamp.contains(enu));
+
+	// inside point is never changed
+	enu = {-5, 5};
+	EXPECT_TRUE(mavros::setpoint_geofence(&reject, enu));
+	EXPECT_TRUE(mavros::setpoint_geofence(&clamp, enu));
+	EXPECT_EQ(enu, Vector2d(-5, 5));
+}
+
+TEST(SETPOINT_GEOFENCE, local_ned)
+{
+	auto reject = make_fence(GeofenceIndex::Action::REJECT);
+	auto clamp = make_fence(GeofenceIndex::Action::CLAMP);
+
+	// NED x is north, ENU (10, 0) is in keep-out circle
+	Vector3d ned(0, 10, -3);
+	EXPECT_FALSE(mavros::setpoint_geofence_local_ned(&reject, 0, ned));
+	EXPECT_TRUE(mavros::setpoint_geofence_local_ned(&reject, XY_IGNORE, ned));
+	EXPECT_TRUE(mavros::setpoint_geofence_local_ned(nullptr, 0, ned));
+
+	ned = {0, 30, -3};
+	EXPECT_TRUE(mavros::setpoint_geofence_local_ned(&clamp, 0, ned));
+	EXPECT_NEAR(ned.x(), 0.0, 1e-6);
+	EXPECT_NEAR(ned.y(), 19.5, 1e-6);
+	EXPECT_EQ(ned.z(), -3);
+
+	ned = {10, 0, -3};
+	EXPECT_TRUE(mavros::setpoint_geofence_local_ned(&reject, 0, ned));
+	EXPECT_EQ(ned, Vector3d(10, 0, -3));
+}
+
+TEST(SETPOINT_GEOFENCE, global_int)
+{
+	auto reject = make_fence(GeofenceIndex::Action::REJECT);
+	auto clamp = make_fence(GeofenceIndex::Action::CLAMP);
+	auto &origin = reject.get_origin();
+
+	auto to_int = [&](const Vector2d &enu, int32_t &lat_int, int32_t &lon_int) {
+		double lat, lon;
+		GeofenceIndex::to_global(origin, enu, lat, lon);
+		lat_int = std::lround(lat * 1e7);
+		lon_int = std::lround(lon * 1e7);
+	};
+
+	int32_t lat_int, lon_int;
+	to_int({5, 5}, lat_int, lon_int);
+	const int32_t in_lat = lat_int, in_lon = lon_int;
+	EXPECT_TRUE(mavros::setpoint_geofence_global_int(&clamp, 0, lat_int, lon_int));
+	EXPECT_EQ(lat_int, in_lat);
+	EXPECT_EQ(lon_int, in_lon);
+
+	to_int({0, 30}, lat_int, lon_int);
+	const int32_t out_lat = lat_int, out_lon = lon_int;
+	EXPECT_FALSE(mavros::setpoint_geofence_global_int(&reject, 0, lat_int, lon_int));
+	EXPECT_EQ(lat_int, out_lat);
+	EXPECT_TRUE(mavros::setpoint_geofence_global_int(&reject, XY_IGNORE, lat_int, lon_int));
+
+	EXPECT_TRUE(mavros::setpoint_geofence_global_int(&clamp, 0, lat_int, lon_int));
+	EXPECT_EQ(lon_int, out_lon);
+	auto enu = GeofenceIndex::to_local(origin, lat_int / 1e7, lon_int / 1e7);
+	EXPECT_NEAR(enu.y(), 19.5, 0.02);
+	EXPECT_TRUE(clamp.contains(enu));
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,77 @@
+/**
+ * Test libmavros setpoint streamer
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <mavros/setpoint_streamer.h>
+
+using namespace mavros;
+using namespace std::chrono;
+
+TEST(SETPOINT_STREAMER, no_ticks_before_update)
+{
+	SetpointStreamer streamer;
+	std::atomic<size_t> ticks(0);
+
+	streamer.start(milliseconds(5), milliseconds(100), [&](bool stale) { ticks++; });
+	std::this_thread::sleep_for(milliseconds(50));
+	streamer.stop();
+
+	EXPECT_EQ(0U, ticks);
+	EXPECT_EQ(0U, streamer.get_stats().ticks);
+}
+
+TEST(SETPOINT_STREAMER, fixed_rate)
+{
+	SetpointStreamer streamer;
+	std::atomic<size_t> ticks(0), stale_ticks(0);
+
+	streamer.start(milliseconds(10), milliseconds(1000), [&](bool stale) {
+			ticks++;
+			stale_ticks += stale;
+		});
+
+	// one update, resent every period
+	streamer.update();
+	std::this_thread::sleep_for(milliseconds(205));
+	streamer.stop();
+
+	// loaded CI machine may skip some slots
+	auto st = streamer.get_stats();
+	EXPECT_EQ(ticks, st.ticks);
+	EXPECT_LE(st.ticks, 21U);
+	EXPECT_GE(st.ticks + st.skipped, 15U);
+	EXPECT_EQ(0U, stale_ticks);
+	EXPECT_LE(st.jitter_mean, st.jitter_max);
+	EXPECT_LT(st.jitter_mean, milliseconds(10));
+}
+
+TEST(SETPOINT_STREAMER, stale)
+{
+	SetpointStreamer streamer;
+	std::atomic<size_t> fresh_ticks(0), stale_ticks(0);
+
+	streamer.start(milliseconds(5), milliseconds(30), [&](bool stale) {
+			if (stale)
+				stale_ticks++;
+			else
+				fresh_ticks++;
+		});
+
+	streamer.update();
+	std::this_thread::sleep_for(milliseconds(100));
+	streamer.stop();
+
+	EXPECT_GT(fresh_ticks, 0U);
+	EXPECT_GT(stale_ticks, 0U);
+	EXPECT_EQ(stale_ticks, streamer.get_stats().stale_ticks);
+	EXPECT_FALSE(streamer.is_running());
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
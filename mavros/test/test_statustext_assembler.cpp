@@ -0,0 +1,182 @@
+/**
+ * Test libmavros STATUSTEXT assembler
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <mavros/statustext_assembler.h>
+
+using namespace mavros;
+using namespace std::chrono;
+
+using STA = StatusTextAssembler;
+
+struct Emitted {
+	uint8_t severity;
+	std::string text;
+	size_t repeated;
+	bool incomplete;
+};
+
+class StatusTextTest : public ::testing::Test {
+protected:
+	StatusTextTest() :
+		now(STA::clock::now())
+	{ }
+
+	STA::Options opts;
+	STA::clock::time_point now;
+	std::vector<Emitted> out;
+
+	STA::EmitFn emit() {
+		return [this](const STA::Text &t) {
+			       out.push_back({t.severity, t.text, t.repeated, t.incomplete});
+		};
+	}
+
+	//! STATUSTEXT field, not terminated if full
+	static std::array<char, STA::CHUNK_LEN> field(const std::string &s) {
+		std::array<char, STA::CHUNK_LEN> f {};
+		std::copy_n(s.begin(), std::min(s.size(), f.size()), f.begin());
+		return f;
+	}
+
+	void push(STA &sta, uint16_t id, uint8_t seq, const std::string &s, uint16_t sender = 0x0101) {
+		auto f = field(s);
+		sta.push(sender, id, seq, 6, f.data(), now, emit());
+	}
+};
+
+TEST_F(StatusTextTest, single)
+{
+	STA sta(opts);
+
+	push(sta, 0, 0, "Armed");
+	ASSERT_EQ(out.size(), 1);
+	EXPECT_EQ(out[0].text, "Armed");
+	EXPECT_EQ(out[0].severity, 6);
+	EXPECT_FALSE(out[0].incomplete);
+
+	// full field without terminator
+	push(sta, 0, 0, std::string(60, 'x'));
+	ASSERT_EQ(out.size(), 2);
+	EXPECT_EQ(out[1].text, std::string(50, 'x'));
+}
+
+TEST_F(StatusTextTest, chunks)
+{
+	STA sta(opts);
+	std::string a(50, 'a'), b(50, 'b');
+
+	push(sta, 7, 0, a);
+	push(sta, 9, 0, "other");	// interleaved text from other id
+	push(sta, 7, 1, b);
+	EXPECT_EQ(out.size(), 1);
+	push(sta, 7, 2, "end");
+
+	ASSERT_EQ(out.size(), 2);
+	EXPECT_EQ(out[0].text, "other");
+	EXPECT_EQ(out[1].text, a + b + "end");
+	EXPECT_FALSE(out[1].incomplete);
+	EXPECT_EQ(sta.get_stats().chunked, 2);
+}
+
+TEST_F(StatusTextTest, lost_chunks)
+{
+	STA sta(opts);
+	std::string a(50, 'a'), c(50, 'c');
+
+	// middle lost
+	push(sta, 3, 0, a);
+	push(sta, 3, 2, "tail");
+	ASSERT_EQ(out.size(), 1);
+	EXPECT_EQ(out[0].text, a + "...tail");
+	EXPECT_TRUE(out[0].incomplete);
+
+	// tail lost, id reused
+	push(sta, 4, 0, c);
+	push(sta, 4, 0, "new");
+	ASSERT_EQ(out.size(), 3);
+	EXPECT_EQ(out[1].text, c);
+	EXPECT_TRUE(out[1].incomplete);
+	EXPECT_EQ(out[2].text, "new");
+
+	// tail lost, timed out
+	push(sta, 5, 0, a);
+	sta.flush(now + milliseconds(500), emit());
+	EXPECT_EQ(out.size(), 3);
+	sta.flush(now + opts.chunk_timeout, emit());
+	ASSERT_EQ(out.size(), 4);
+	EXPECT_EQ(out[3].text, a);
+}
+
+TEST_F(StatusTextTest, pool_eviction)
+{
+	STA sta(opts);
+	std::string a(50, 'a');
+
+	for (uint16_t id = 1; id <= STA::POOL_SIZE + 1; id++) {
+		push(sta, id, 0, a + char('0' + id));
+		now += milliseconds(1);
+	}
+
+	// oldest is pushed out
+	ASSERT_EQ(out.size(), 1);
+	EXPECT_EQ(out[0].text, a);
+	EXPECT_TRUE(out[0].incomplete);
+}
+
+TEST_F(StatusTextTest, repeats)
+{
+	STA sta(opts);
+
+	// PreArm at 1 Hz
+	for (int i = 0; i < 10; i++) {
+		push(sta, 0, 0, "PreArm: Gyros not calibrated");
+		now += seconds(1);
+	}
+
+	ASSERT_EQ(out.size(), 1);
+	EXPECT_EQ(out[0].repeated, 0);
+	EXPECT_EQ(sta.get_stats().suppressed, 9);
+
+	// other text is not held back
+	push(sta, 0, 0, "Arming denied");
+	EXPECT_EQ(out.size(), 2);
+
+	// window passed, count goes with next copy
+	push(sta, 0, 0, "PreArm: Gyros not calibrated");
+	ASSERT_EQ(out.size(), 3);
+	EXPECT_EQ(out[2].repeated, 9);
+
+	// spam ended, count reported by flush
+	now += seconds(1);
+	push(sta, 0, 0, "PreArm: Gyros not calibrated");
+	sta.flush(now, emit());
+	EXPECT_EQ(out.size(), 3);
+	sta.flush(now + opts.repeat_window, emit());
+	ASSERT_EQ(out.size(), 4);
+	EXPECT_EQ(out[3].repeated, 1);
+	EXPECT_EQ(out[3].text, "PreArm: Gyros not calibrated");
+}
+
+TEST_F(StatusTextTest, repeats_disabled)
+{
+	opts.repeat_window = STA::clock::duration::zero();
+	STA sta(opts);
+
+	for (int i = 0; i < 3; i++)
+		push(sta, 0, 0, "same");
+
+	EXPECT_EQ(out.size(), 3);
+	EXPECT_EQ(sta.get_stats().suppressed, 0);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,137 @@
+/**
+ * Test libmavros stream manager
+ */
+
+#include <gtest/gtest.h>
+
+#include <mavros/stream_manager.h>
+
+using namespace mavros;
+using namespace std::chrono;
+
+using clock_t_ = StreamManager::clock;
+
+static StreamManager::Options no_resend()
+{
+	StreamManager::Options opts;
+	opts.hold = seconds(5);
+	opts.resend = clock_t_::duration::zero();
+	return opts;
+}
+
+TEST(STREAM_MANAGER, highest_rate_wins)
+{
+	StreamManager sm(no_resend());
+	auto t = clock_t_::time_point();
+
+	auto imu = sm.add_demand("/mavros/imu/data", {30, 31}, 50.0);
+	auto att = sm.add_demand("/mavros/attitude", {30}, 10.0);
+
+	sm.set_rate(imu, 50.0);
+	sm.set_rate(att, 10.0);
+
+	auto req = sm.update(t);
+	ASSERT_EQ(2U, req.size());
+	EXPECT_EQ(30U, req[0].msgid);
+	EXPECT_FLOAT_EQ(20000.0f, req[0].interval_us);
+	EXPECT_EQ(31U, req[1].msgid);
+	EXPECT_FLOAT_EQ(20000.0f, req[1].interval_us);
+
+	// nothing changed
+	EXPECT_TRUE(sm.update(t + seconds(1)).empty());
+}
+
+TEST(STREAM_MANAGER, faster_now_slower_after_hold)
+{
+	StreamManager sm(no_resend());
+	auto t = clock_t_::time_point();
+
+	auto id = sm.add_demand("/mavros/local_position/pose", {32}, 30.0);
+	sm.set_rate(id, 10.0);
+	ASSERT_EQ(1U, sm.update(t).size());
+
+	sm.set_rate(id, 30.0);
+	auto req = sm.update(t + seconds(1));
+	ASSERT_EQ(1U, req.size());
+	EXPECT_NEAR(33333.3f, req[0].interval_us, 1.0f);
+
+	// subscriber gone: stop only after hold
+	sm.set_rate(id, 0.0);
+	EXPECT_TRUE(sm.update(t + seconds(2)).empty());
+	EXPECT_TRUE(sm.update(t + seconds(6)).empty());
+
+	req = sm.update(t + seconds(7));
+	ASSERT_EQ(1U, req.size());
+	EXPECT_FLOAT_EQ(StreamManager::INTERVAL_STOP, req[0].interval_us);
+}
+
+TEST(STREAM_MANAGER, short_gap_does_not_flap)
+{
+	StreamManager sm(no_resend());
+	auto t = clock_t_::time_point();
+
+	auto id = sm.add_demand("/mavros/imu/data", {31}, 50.0);
+	sm.set_rate(id, 50.0);
+	ASSERT_EQ(1U, sm.update(t).size());
+
+	// subscriber restarted
+	sm.set_rate(id, 0.0);
+	EXPECT_TRUE(sm.update(t + seconds(1)).empty());
+	sm.set_rate(id, 50.0);
+	EXPECT_TRUE(sm.update(t + seconds(2)).empty());
+
+	// and gone again, hold starts over
+	sm.set_rate(id, 0.0);
+	EXPECT_TRUE(sm.update(t + seconds(3)).empty());
+	EXPECT_TRUE(sm.update(t + seconds(7)).empty());
+	EXPECT_EQ(1U, sm.update(t + seconds(8)).size());
+}
+
+TEST(STREAM_MANAGER, unused_at_start_waits_for_discovery)
+{
+	auto opts = no_resend();
+	opts.stop_unused = false;
+
+	StreamManager sm(opts);
+	auto t = clock_t_::time_point() + hours(1);
+
+	sm.add_demand("/mavros/global_position/global", {33}, 10.0);
+
+	EXPECT_TRUE(sm.update(t).empty());
+	EXPECT_TRUE(sm.update(t + seconds(4)).empty());
+
+	auto req = sm.update(t + seconds(5));
+	ASSERT_EQ(1U, req.size());
+	EXPECT_FLOAT_EQ(StreamManager::INTERVAL_DEFAULT, req[0].interval_us);
+}
+
+TEST(STREAM_MANAGER, manual_resend_reset)
+{
+	StreamManager::Options opts;
+	opts.resend = seconds(10);
+
+	StreamManager sm(opts);
+	auto t = clock_t_::time_point();
+
+	auto id = sm.add_demand("/mavros/imu/data", {30, 31}, 50.0);
+	sm.set_rate(id, 25.0);
+	sm.set_manual(30);
+
+	auto req = sm.update(t);
+	ASSERT_EQ(1U, req.size());
+	EXPECT_EQ(31U, req[0].msgid);
+
+	EXPECT_TRUE(sm.update(t + seconds(9)).empty());
+	EXPECT_EQ(1U, sm.update(t + seconds(10)).size());
+
+	sm.reset();
+	EXPECT_TRUE(sm.get_requested().empty());
+	EXPECT_EQ(1U, sm.update(t + seconds(11)).size());
+	EXPECT_EQ(1U, sm.get_requested().size());
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,183 @@
+/**
+ * Test libmavros timer wheel
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <mavros/timer_wheel.h>
+
+using namespace mavros;
+using namespace std::chrono;
+
+using wclock = TimerWheel::clock;
+
+static bool wait_for(std::function<bool()> pred, milliseconds timeout = milliseconds(2000))
+{
+	auto deadline = wclock::now() + timeout;
+	while (!pred() && wclock::now() < deadline)
+		std::this_thread::sleep_for(milliseconds(1));
+
+	return pred();
+}
+
+TEST(TIMER_WHEEL, oneshot)
+{
+	TimerWheel wheel;
+	std::atomic<int> calls { 0 };
+	std::atomic<int64_t> fired_ms { 0 };
+
+	auto start = wclock::now();
+	auto t = wheel.create([&]() {
+				fired_ms = duration_cast<milliseconds>(wclock::now() - start).count();
+				calls++;
+			});
+
+	EXPECT_FALSE(t->is_armed());
+	t->start(milliseconds(30));
+	EXPECT_TRUE(t->is_armed());
+	EXPECT_EQ(wheel.size(), 1);
+
+	ASSERT_TRUE(wait_for([&]() { return calls == 1; }));
+	EXPECT_GE(fired_ms, 30);
+	EXPECT_LT(fired_ms, 200);
+	EXPECT_FALSE(t->is_armed());
+	EXPECT_EQ(wheel.size(), 0);
+
+	std::this_thread::sleep_for(milliseconds(50));
+	EXPECT_EQ(calls, 1);
+}
+
+TEST(TIMER_WHEEL, restart_postpones)
+{
+	TimerWheel wheel;
+	std::atomic<int> calls { 0 };
+
+	// timeout kept alive, like connection timeout restarted by heartbeats
+	auto t = wheel.create([&]() { calls++; });
+	t->start(milliseconds(40));
+	for (int i = 0; i < 10; i++) {
+		std::this_thread::sleep_for(milliseconds(10));
+		t->restart();
+	}
+
+	EXPECT_EQ(calls, 0);
+	EXPECT_TRUE(wait_for([&]() { return calls == 1; }));
+}
+
+TEST(TIMER_WHEEL, cancel)
+{
+	TimerWheel wheel;
+	std::atomic<int> calls { 0 };
+
+	auto t = wheel.create([&]() { calls++; });
+	t->start(milliseconds(20));
+	t->cancel();
+	EXPECT_FALSE(t->is_armed());
+
+	// destroyed while armed
+	auto t2 = wheel.create([&]() { calls++; });
+	t2->start(milliseconds(20));
+	t2.reset();
+	EXPECT_EQ(wheel.size(), 0);
+
+	std::this_thread::sleep_for(milliseconds(60));
+	EXPECT_EQ(calls, 0);
+}
+
+TEST(TIMER_WHEEL, periodic)
+{
+	TimerWheel wheel;
+	std::atomic<int> calls { 0 };
+
+	auto t = wheel.create_periodic(milliseconds(10), [&]() { calls++; });
+
+	std::this_thread::sleep_for(milliseconds(205));
+	t->cancel();
+	int n = calls;
+	EXPECT_GE(n, 15);
+	EXPECT_LE(n, 21);
+
+	std::this_thread::sleep_for(milliseconds(30));
+	EXPECT_EQ(calls, n);
+}
+
+TEST(TIMER_WHEEL, order_across_levels)
+{
+	TimerWheel wheel;
+	std::mutex mutex;
+	std::vector<int> order;
+	std::vector<TimerWheel::Ptr> timers;
+
+	// level 0, 1 and 2 delays, started out of order
+	for (int ms : {300, 5, 70, 150, 1, 4100}) {
+		auto t = wheel.create([&, ms]() {
+					std::lock_guard<std::mutex> lock(mutex);
+					order.push_back(ms);
+				});
+		t->start(milliseconds(ms));
+		timers.push_back(t);
+	}
+
+	ASSERT_TRUE(wait_for([&]() { std::lock_guard<std::mutex> lock(mutex); return order.size() == 6; },
+			milliseconds(6000)));
+	EXPECT_EQ(order, std::vector<int>({1, 5, 70, 150, 300, 4100}));
+}
+
+TEST(TIMER_WHEEL, callback_restarts_itself)
+{
+	TimerWheel wheel;
+	std::atomic<int> calls { 0 };
+	TimerWheel::Ptr t;
+
+	t = wheel.create([&]() {
+				if (++calls < 3)
+					t->start(milliseconds(5));
+			});
+	t->start(milliseconds(5));
+
+	EXPECT_TRUE(wait_for([&]() { return calls == 3; }));
+	std::this_thread::sleep_for(milliseconds(30));
+	EXPECT_EQ(calls, 3);
+	EXPECT_FALSE(t->is_armed());
+}
+
+TEST(TIMER_WHEEL, destroy_waits_callback)
+{
+	TimerWheel wheel;
+	std::atomic<bool> entered { false };
+	std::atomic<bool> done { false };
+
+	auto t = wheel.create([&]() {
+				entered = true;
+				std::this_thread::sleep_for(milliseconds(50));
+				done = true;
+			});
+	t->start(milliseconds(1));
+
+	ASSERT_TRUE(wait_for([&]() { return bool(entered); }));
+	t.reset();
+	EXPECT_TRUE(done);
+}
+
+TEST(TIMER_WHEEL, timer_outlives_wheel)
+{
+	TimerWheel::Ptr t;
+	{
+		TimerWheel wheel;
+		t = wheel.create([]() { });
+		t->start(seconds(10));
+	}
+
+	t->cancel();
+	t->start(seconds(1));
+	t.reset();
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
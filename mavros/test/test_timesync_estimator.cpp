@@ -0,0 +1,105 @@
+/**
+ * Test libmavros timesync estimator
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <mavros/timesync_estimator.h>
+
+using namespace mavros;
+
+static constexpr uint64_t LOCAL_START = 1500000000000000000ULL;	// unix time
+static constexpr double SKEW = 20e-6;				// 20 ppm fast FCU clock
+
+//! remote clock: boot time, runs faster than local
+static uint64_t remote_time(uint64_t local_ns)
+{
+	return (local_ns - LOCAL_START) * (1.0 + SKEW) + 5000000000ULL;
+}
+
+//! local time at remote stamp, inverse of remote_time()
+static double true_local(uint64_t remote_ns)
+{
+	return LOCAL_START + (remote_ns - 5000000000.0) / (1.0 + SKEW);
+}
+
+TEST(TIMESYNC, offset_and_skew)
+{
+	TimeSyncEstimator est(256);
+	std::mt19937 gen(42);
+	std::uniform_int_distribution<int64_t> delay(1000000, 3000000);	// 1..3 ms each way
+
+	// 5 Hz, window spans 51 s
+	uint64_t t = LOCAL_START;
+	for (int i = 0; i < 600; i++, t += 200000000) {
+		auto up = delay(gen), down = delay(gen);
+		est.add(t, remote_time(t + up), t + up + down);
+	}
+
+	EXPECT_EQ(256U, est.size());
+
+	auto m = est.model();
+	EXPECT_NEAR(SKEW / (1.0 + SKEW), -m.skew, 1e-5);
+
+	// extrapolate 10 s ahead
+	uint64_t remote = remote_time(t + 10000000000ULL);
+	EXPECT_NEAR(true_local(remote), double(m.to_local(remote)), 1e6);
+}
+
+TEST(TIMESYNC, to_remote_inverse)
+{
+	TimeSyncEstimator est(64);
+
+	uint64_t t = LOCAL_START;
+	for (int i = 0; i < 64; i++, t += 100000000)
+		est.add(t, remote_time(t + 1000000), t + 2000000);
+
+	auto m = est.model();
+	uint64_t remote = remote_time(t + 3000000000ULL);
+	EXPECT_NEAR(double(remote), double(m.to_remote(m.to_local(remote))), 10);
+	EXPECT_NEAR(double(remote), double(m.to_remote(uint64_t(true_local(remote)))), 1e6);
+}
+
+TEST(TIMESYNC, slow_round_trip_has_low_weight)
+{
+	TimeSyncEstimator est(32);
+
+	uint64_t t = LOCAL_START;
+	for (int i = 0; i < 32; i++, t += 100000000)
+		est.add(t, remote_time(t + 1000000), t + 2000000);
+
+	auto before = est.model();
+
+	// asymmetric 300 ms round trip, midpoint is 149 ms off
+	est.add(t, remote_time(t + 1000000), t + 300000000);
+	auto after = est.model();
+
+	uint64_t remote = remote_time(t);
+	EXPECT_NEAR(double(before.to_local(remote)), double(after.to_local(remote)), 1e6);
+	EXPECT_GT(std::abs(est.residual(t, remote_time(t + 1000000), t + 300000000)), 100000000);
+}
+
+TEST(TIMESYNC, short_span_no_skew)
+{
+	TimeSyncEstimator est(8);
+
+	uint64_t t = LOCAL_START;
+	for (int i = 0; i < 4; i++, t += 10000000)
+		est.add(t, remote_time(t + 1000000), t + 2000000);
+
+	auto m = est.model();
+	EXPECT_EQ(0.0, m.skew);
+	EXPECT_NEAR(true_local(m.epoch_ns), double(m.to_local(m.epoch_ns)), 1e5);
+
+	est.reset();
+	EXPECT_EQ(0U, est.size());
+	EXPECT_EQ(0, est.model().offset_ns);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
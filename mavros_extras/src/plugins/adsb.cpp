@@ -14,9 +14,13 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
 #include <mavros/mavros_plugin.h>
 
 #include <mavros_msgs/msg/ADSBVehicle.hpp>
+#include <mavros_msgs/msg/ADSBVehicleArray.hpp>
 
 namespace mavros {
 namespace extra_plugins {
@@ -27,19 +31,42 @@ using mavlink::common::ADSB_ALTITUDE_TYPE;
  * @brief ADS-B Vehicle plugin
  *
  * Publish/subscribe Automatic dependent surveillance-broadcast data to/from a vehicle.
+ *
+ * Optionally keeps traffic table of latest report per ICAO address, indexed by
+ * lat/lon grid, and publishes aircraft near own position at fixed rate.
  */
 class ADSBPlugin : public plugin::PluginBase {
 public:
 	ADSBPlugin() : PluginBase(),
-		adsb_nh("~adsb")
+		adsb_nh("~adsb"),
+		traffic_enabled(false),
+		traffic_radius(10000.0),
+		traffic_alt_band(1000.0),
+		traffic_timeout(10.0),
+		cell_size(0.1)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
 
+		double traffic_rate;
+
+		// traffic table params
+		adsb_nh.param("traffic/rate", traffic_rate, 0.0);
+		adsb_nh.param("traffic/radius", traffic_radius, 10000.0);
+		adsb_nh.param("traffic/altitude_band", traffic_alt_band, 1000.0);
+		adsb_nh.param("traffic/timeout", traffic_timeout, 10.0);
+		adsb_nh.param("traffic/cell_size", cell_size, 0.1);
+		traffic_enabled = traffic_rate > 0.0 && cell_size > 0.0;
+
 		adsb_pub = adsb_nh.advertise<mavros_msgs::ADSBVehicle>("vehicle", 10);
 		adsb_sub = adsb_nh.subscribe("send", 10, &ADSBPlugin::adsb_cb, this);
+
+		if (traffic_enabled) {
+			traffic_pub = adsb_nh.advertise<mavros_msgs::ADSBVehicleArray>("traffic", 10);
+			traffic_timer = adsb_nh.createTimer(ros::Duration(1.0 / traffic_rate), &ADSBPlugin::traffic_cb, this);
+		}
 	}
 
 	Subscriptions get_subscriptions()
@@ -55,6 +82,157 @@ private:
 	ros::Publisher adsb_pub;
 	ros::Subscriber adsb_sub;
 
+	ros::Publisher traffic_pub;
+	ros::Timer traffic_timer;
+
+	bool traffic_enabled;
+	double traffic_radius;		//!< [m]
+	double traffic_alt_band;	//!< [m] +/- own altitude
+	double traffic_timeout;		//!< [sec] not reported aircraft are removed
+	double cell_size;		//!< grid cell [deg]
+
+	struct Aircraft {
+		mavros_msgs::ADSBVehicle vehicle;
+		uint64_t cell;
+		double distance;	//!< to own position, filled by query
+	};
+
+	std::mutex traffic_mutex;
+	std::unordered_map<uint32_t, Aircraft> traffic;			//!< by ICAO address
+	std::unordered_map<uint64_t, std::vector<uint32_t> > grid;	//!< ICAO addresses in cell
+
+	std::vector<const Aircraft *> nearby;	//!< query result, reused
+
+	//! Earth radius for distance approximation [m]
+	static constexpr double EARTH_RADIUS = 6378137.0;
+
+	static uint64_t cell_key(int64_t lat_idx, int64_t lon_idx)
+	{
+		return (uint64_t(lat_idx & 0xffffffff) << 32) | uint64_t(lon_idx & 0xffffffff);
+	}
+
+	inline int64_t cell_index(double deg)
+	{
+		return int64_t(std::floor(deg / cell_size));
+	}
+
+	void grid_remove(uint64_t cell, uint32_t icao)
+	{
+		auto it = grid.find(cell);
+		if (it == grid.end())
+			return;
+
+		auto &v = it->second;
+		auto pos = std::find(v.begin(), v.end(), icao);
+		if (pos != v.end()) {
+			*pos = v.back();
+			v.pop_back();
+		}
+
+		if (v.empty())
+			grid.erase(it);
+	}
+
+	//! Add or replace report, moves aircraft between cells
+	void traffic_update(const mavros_msgs::ADSBVehicle &vehicle)
+	{
+		auto cell = cell_key(cell_index(vehicle.latitude), cell_index(vehicle.longitude));
+
+		std::lock_guard<std::mutex> lock(traffic_mutex);
+		auto res = traffic.emplace(vehicle.ICAO_address, Aircraft{vehicle, cell, 0.0});
+		auto &ac = res.first->second;
+
+		if (!res.second) {
+			ac.vehicle = vehicle;
+			if (ac.cell == cell)
+				return;
+
+			grid_remove(ac.cell, vehicle.ICAO_address);
+			ac.cell = cell;
+		}
+
+		grid[cell].push_back(vehicle.ICAO_address);
+	}
+
+	//! Remove aircraft not reported within timeout
+	void traffic_expire(const ros::Time &now)
+	{
+		for (auto it = traffic.begin(); it != traffic.end(); ) {
+			if ((now - it->second.vehicle.header.stamp).toSec() > traffic_timeout) {
+				grid_remove(it->second.cell, it->first);
+				it = traffic.erase(it);
+			}
+			else
+				++it;
+		}
+	}
+
+	/**
+	 * Publish aircraft within radius and altitude band.
+	 *
+	 * Only grid cells overlapping radius are visited. Without own fix
+	 * all known aircraft are published.
+	 */
+	void traffic_cb(const ros::TimerEvent &event)
+	{
+		auto traffic_msg = boost::make_shared<mavros_msgs::ADSBVehicleArray>();
+		auto now = ros::Time::now();
+		auto fix = m_uas->get_gps_fix();
+		bool have_fix = fix && fix->status.status >= sensor_msgs::NavSatStatus::STATUS_FIX;
+
+		traffic_msg->header.stamp = now;
+
+		std::lock_guard<std::mutex> lock(traffic_mutex);
+		traffic_expire(now);
+		nearby.clear();
+
+		if (!have_fix) {
+			for (auto &kv : traffic)
+				nearby.push_back(&kv.second);
+		}
+		else {
+			const double own_alt = fix->altitude + m_uas->ellipsoid_to_geoid_height(fix);	// AMSL, as ADS-B
+			const double lat_rad = fix->latitude * M_PI / 180.0;
+			const double cos_lat = std::max(std::cos(lat_rad), 0.01);
+			const double dlat = traffic_radius / EARTH_RADIUS * 180.0 / M_PI;
+			const double dlon = dlat / cos_lat;
+
+			for (auto i = cell_index(fix->latitude - dlat); i <= cell_index(fix->latitude + dlat); i++) {
+				for (auto j = cell_index(fix->longitude - dlon); j <= cell_index(fix->longitude + dlon); j++) {
+					auto cell = grid.find(cell_key(i, j));
+					if (cell == grid.end())
+						continue;
+
+					for (auto icao : cell->second) {
+						auto &ac = traffic[icao];
+						auto &v = ac.vehicle;
+
+						if (std::abs(v.altitude - own_alt) > traffic_alt_band)
+							continue;
+
+						// equirectangular approximation, good enough within radius
+						double x = (v.longitude - fix->longitude) * M_PI / 180.0 * cos_lat;
+						double y = (v.latitude - fix->latitude) * M_PI / 180.0;
+						ac.distance = std::hypot(x, y) * EARTH_RADIUS;
+
+						if (ac.distance <= traffic_radius)
+							nearby.push_back(&ac);
+					}
+				}
+			}
+
+			std::sort(nearby.begin(), nearby.end(), [](const Aircraft *a, const Aircraft *b) {
+						return a->distance < b->distance;
+					});
+		}
+
+		traffic_msg->vehicles.reserve(nearby.size());
+		for (auto ac : nearby)
+			traffic_msg->vehicles.push_back(ac->vehicle);
+
+		traffic_pub.publish(traffic_msg);
+	}
+
 	void handle_adsb(const mavlink::mavlink_message_t *msg, mavlink::common::msg::ADSB_VEHICLE &adsb)
 	{
 		auto adsb_msg = boost::make_shared<mavros_msgs::ADSBVehicle>();
@@ -108,6 +286,9 @@ private:
 				<< " emitter: " << utils::to_string_enum<ADSB_EMITTER_TYPE>(adsb.emitter_type)
 				<< " flags: 0x" << std::hex << adsb.flags);
 
+		if (traffic_enabled)
+			traffic_update(*adsb_msg);
+
 		adsb_pub.publish(adsb_msg);
 	}
 
@@ -146,6 +327,8 @@ private:
 		UAS_FCU(m_uas)->send_message_ignore_drop(adsb);
 	}
 };
+
+constexpr double ADSBPlugin::EARTH_RADIUS;
 }	// namespace extra_plugins
 }	// namespace mavros
 
@@ -17,6 +17,13 @@
 #include <mavros/mavros_plugin.h>
 
 #include <mavros_msgs/msg/CamIMUStamp.hpp>
+#include <mavros_msgs/msg/CamIMUMatch.hpp>
+#include <std_msgs/msg/Header.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
 
 namespace mavros {
 namespace extra_plugins{
@@ -26,18 +33,43 @@ namespace extra_plugins{
  * This plugin publishes a timestamp for when a external camera system was
  * triggered by the FCU. Sequence ID from the message and the image sequence from
  * camera can be corellated to get the exact shutter trigger time.
+ *
+ * Recent triggers are kept in a ring buffer, ordered by sequence and FCU time,
+ * so image stamps can be matched to them by binary search: by ~cam_imu_sync/match
+ * service, or by publishing image headers to ~cam_imu_sync/image_header,
+ * matched triggers are then published on ~cam_imu_sync/image_stamp.
+ * Stamps are converted from FCU time with time model current at matching,
+ * not at trigger receipt, so later skew fit is used.
  */
 class CamIMUSyncPlugin : public plugin::PluginBase {
 public:
 	CamIMUSyncPlugin() : PluginBase(),
-		cam_imu_sync_nh("~cam_imu_sync")
+		cam_imu_sync_nh("~cam_imu_sync"),
+		buffer_size(100),
+		exposure_delay_ns(0),
+		max_offset_ns(0)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
 
+		int buffer_size_;
+		double exposure_delay, max_offset;
+
+		cam_imu_sync_nh.param("buffer_size", buffer_size_, 100);
+		// image stamp lag after trigger, e.g. half of exposure
+		cam_imu_sync_nh.param("exposure_delay", exposure_delay, 0.0);
+		cam_imu_sync_nh.param("max_offset", max_offset, 0.02);
+
+		buffer_size = std::max(buffer_size_, 1);
+		exposure_delay_ns = exposure_delay * 1e9;
+		max_offset_ns = max_offset * 1e9;
+
 		cam_imu_pub = cam_imu_sync_nh.advertise<mavros_msgs::CamIMUStamp>("cam_imu_stamp", 10);
+		image_stamp_pub = cam_imu_sync_nh.advertise<mavros_msgs::CamIMUStamp>("image_stamp", 10);
+		image_header_sub = cam_imu_sync_nh.subscribe("image_header", 10, &CamIMUSyncPlugin::image_header_cb, this);
+		match_srv = cam_imu_sync_nh.advertiseService("match", &CamIMUSyncPlugin::match_cb, this);
 	}
 
 	Subscriptions get_subscriptions()
@@ -51,6 +83,21 @@ private:
 	ros::NodeHandle cam_imu_sync_nh;
 
 	ros::Publisher cam_imu_pub;
+	ros::Publisher image_stamp_pub;
+	ros::Subscriber image_header_sub;
+	ros::ServiceServer match_srv;
+
+	struct Trigger {
+		uint32_t seq;
+		uint64_t fcu_ns;	//!< CAMERA_TRIGGER time_usec
+		int64_t local_ns;	//!< stamp at receipt, used if time model is unknown
+	};
+
+	std::mutex mutex;
+	std::deque<Trigger> triggers;	//!< ascending seq and time
+	size_t buffer_size;
+	int64_t exposure_delay_ns;
+	int64_t max_offset_ns;
 
 	void handle_cam_trig(const mavlink::mavlink_message_t *msg, mavlink::common::msg::CAMERA_TRIGGER &ctrig)
 	{
@@ -59,8 +106,122 @@ private:
 		sync_msg->frame_stamp = m_uas->synchronise_stamp(ctrig.time_usec);
 		sync_msg->frame_seq_id = ctrig.seq;
 
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			// FCU reboot or sequence reset, old triggers can't be ordered with new
+			if (!triggers.empty() && (ctrig.seq <= triggers.back().seq ||
+						ctrig.time_usec * 1000 <= triggers.back().fcu_ns))
+				triggers.clear();
+
+			triggers.push_back(Trigger {ctrig.seq, ctrig.time_usec * 1000, int64_t(sync_msg->frame_stamp.toNSec())});
+			if (triggers.size() > buffer_size)
+				triggers.pop_front();
+		}
+
 		cam_imu_pub.publish(sync_msg);
 	}
+
+	//! Time model is known, same condition as in UAS::synchronise_stamp()
+	bool model_known(const TimeSyncModel &model)
+	{
+		return model.offset_ns != 0 || m_uas->get_timesync_mode() == timesync_mode::PASSTHROUGH;
+	}
+
+	/**
+	 * @brief Find trigger nearest to image stamp. mutex should be locked
+	 * @return nullptr if buffer is empty
+	 */
+	const Trigger *find_by_stamp(int64_t image_ns, const TimeSyncModel &model)
+	{
+		if (triggers.empty())
+			return nullptr;
+
+		auto it = triggers.end();
+		int64_t trigger_ns = image_ns - exposure_delay_ns;
+
+		if (model_known(model)) {
+			uint64_t fcu_ns = model.to_remote(trigger_ns);
+			it = std::lower_bound(triggers.begin(), triggers.end(), fcu_ns,
+					[](const Trigger &t, uint64_t v) { return t.fcu_ns < v; });
+
+			if (it == triggers.end() || (it != triggers.begin() &&
+						fcu_ns - std::prev(it)->fcu_ns < it->fcu_ns - fcu_ns))
+				--it;
+		}
+		else {
+			it = std::lower_bound(triggers.begin(), triggers.end(), trigger_ns,
+					[](const Trigger &t, int64_t v) { return t.local_ns < v; });
+
+			if (it == triggers.end() || (it != triggers.begin() &&
+						trigger_ns - std::prev(it)->local_ns < it->local_ns - trigger_ns))
+				--it;
+		}
+
+		return &*it;
+	}
+
+	//! Find trigger by sequence. mutex should be locked
+	const Trigger *find_by_seq(uint32_t seq)
+	{
+		auto it = std::lower_bound(triggers.begin(), triggers.end(), seq,
+				[](const Trigger &t, uint32_t v) { return t.seq < v; });
+
+		if (it == triggers.end() || it->seq != seq)
+			return nullptr;
+
+		return &*it;
+	}
+
+	/**
+	 * @brief Match image to trigger
+	 * @param[in] image_ns  image stamp, used if by_seq is false
+	 * @param[out] out  trigger stamp and sequence
+	 * @param[out] offset  image - trigger stamp [s]
+	 */
+	bool match(int64_t image_ns, bool by_seq, uint32_t seq, mavros_msgs::CamIMUStamp &out, double &offset)
+	{
+		auto model = m_uas->get_time_model();
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto t = (by_seq) ? find_by_seq(seq) : find_by_stamp(image_ns, model);
+		if (t == nullptr)
+			return false;
+
+		int64_t trigger_ns = (model_known(model)) ? int64_t(model.to_local(t->fcu_ns)) : t->local_ns;
+		int64_t diff_ns = image_ns - exposure_delay_ns - trigger_ns;
+
+		if (!by_seq && max_offset_ns > 0 && std::abs(diff_ns) > max_offset_ns)
+			return false;
+
+		out.frame_stamp.fromNSec(trigger_ns);
+		out.frame_seq_id = t->seq;
+		offset = (image_ns - trigger_ns) / 1e9;
+		return true;
+	}
+
+	/* -*- callbacks -*- */
+
+	void image_header_cb(const std_msgs::Header::ConstPtr &req)
+	{
+		auto stamp_msg = boost::make_shared<mavros_msgs::CamIMUStamp>();
+		double offset;
+
+		if (!match(req->stamp.toNSec(), false, 0, *stamp_msg, offset)) {
+			ROS_DEBUG_THROTTLE_NAMED(1, "cam_imu_sync", "CAM_IMU: no trigger for image %u", req->seq);
+			return;
+		}
+
+		image_stamp_pub.publish(stamp_msg);
+	}
+
+	bool match_cb(mavros_msgs::CamIMUMatch::Request &req,
+			mavros_msgs::CamIMUMatch::Response &res)
+	{
+		res.success = match(req.image_stamp.toNSec(), req.by_seq, req.frame_seq_id, res.trigger, res.offset);
+		return true;
+	}
 };
 }	// namespace extra_plugins
 }	// namespace mavros
@@ -17,20 +17,37 @@
 #include <mavros/mavros_plugin.h>
 
 #include <mavros_msgs/msg/DebugValue.hpp>
+#include <mavros_msgs/msg/DebugValueArray.hpp>
+
+#include <mutex>
+#include <unordered_map>
 
 namespace mavros {
 namespace extra_plugins {
-//! @brief Plugin for Debug msgs from MAVLink API
+/**
+ * @brief Plugin for Debug msgs from MAVLink API
+ *
+ * With batch/rate values are merged into table keyed by type and name (index for DEBUG),
+ * names are converted once, on first frame. Values updated within period
+ * are published as one ~debug_value/values message, per type topics are not published.
+ */
 class DebugValuePlugin : public plugin::PluginBase {
 public:
 	DebugValuePlugin() : PluginBase(),
-		debug_nh("~debug_value")
+		debug_nh("~debug_value"),
+		batch(false)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
 
+		double batch_rate;
+
+		// batch params
+		debug_nh.param("batch/rate", batch_rate, 0.0);
+		batch = batch_rate > 0.0;
+
 		// subscribers
 		debug_sub = debug_nh.subscribe("send", 10, &DebugValuePlugin::debug_cb, this);
 
@@ -39,6 +56,11 @@ public:
 		debug_vector_pub = debug_nh.advertise<mavros_msgs::DebugValue>("debug_vector", 10);
 		named_value_float_pub = debug_nh.advertise<mavros_msgs::DebugValue>("named_value_float", 10);
 		named_value_int_pub = debug_nh.advertise<mavros_msgs::DebugValue>("named_value_int", 10);
+
+		if (batch) {
+			values_pub = debug_nh.advertise<mavros_msgs::DebugValueArray>("values", 10);
+			batch_timer = debug_nh.createTimer(ros::Duration(1.0 / batch_rate), &DebugValuePlugin::batch_cb, this);
+		}
 	}
 
 	Subscriptions get_subscriptions() {
@@ -59,48 +81,135 @@ private:
 	ros::Publisher debug_vector_pub;
 	ros::Publisher named_value_float_pub;
 	ros::Publisher named_value_int_pub;
+	ros::Publisher values_pub;
+	ros::Timer batch_timer;
+
+	using DV = mavros_msgs::DebugValue;
+	//! name field of DEBUG_VECT and NAMED_VALUE_*
+	using Name = std::array<char, 10>;
+
+	struct Key {
+		uint8_t type;
+		int32_t index;
+		Name name;
+
+		bool operator==(const Key &other) const {
+			return type == other.type && index == other.index && name == other.name;
+		}
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key &k) const {
+			// FNV-1a
+			uint64_t h = 1469598103934665603ULL;
+			auto mix = [&h](uint8_t b) { h = (h ^ b) * 1099511628211ULL; };
+
+			mix(k.type);
+			for (int i = 0; i < 4; i++)
+				mix((k.index >> (i * 8)) & 0xFF);
+			for (auto c : k.name)
+				mix(c);
+
+			return h;
+		}
+	};
+
+	struct Entry {
+		DV value;
+		bool updated;
+	};
+
+	bool batch;
+	std::mutex batch_mutex;
+	std::unordered_map<Key, size_t, KeyHash> batch_index;
+	std::vector<Entry> batch_table;
 
 	/* -*- helpers -*- */
 
+	//! Formats value only when debug output enabled
+	struct ValueFmt {
+		const DV &dv;
+
+		friend std::ostream &operator<<(std::ostream &os, const ValueFmt &f) {
+			if (f.dv.type == DV::TYPE_NAMED_VALUE_INT) {
+				os << f.dv.value_int;
+			}
+			else if (f.dv.type == DV::TYPE_DEBUG_VECT) {
+				os << "[";
+				for (size_t i = 0; i < f.dv.data.size(); i++)
+					os << ((i > 0) ? ", " : "") << f.dv.data[i];
+				os << "]";
+			}
+			else {
+				os << f.dv.value_float;
+			}
+
+			return os;
+		}
+	};
+
 	/**
 	 * @brief Helper function to log debug messages
 	 * @param type	Type of debug message
 	 * @param dv	Data value
 	 */
-	void debug_logger(const std::string &type, const mavros_msgs::DebugValue &dv)
+	void debug_logger(const char *type, const DV &dv)
 	{
-		using DV = mavros_msgs::DebugValue;
-
-		std::string name = (dv.name == "") ? "UNK" : dv.name;
+		// stream arguments are evaluated only if enabled
+		ROS_DEBUG_STREAM_NAMED("debug_value", type << "\t"
+							   << dv.header.stamp   << "\t"
+							   << (dv.name.empty() ? "UNK" : dv.name.c_str())    << "\t["
+							   << dv.index   << "]\tvalue:"
+							   << ValueFmt {dv});
+	}
 
-		std::ostringstream ss;
-		if (dv.type == DV::TYPE_NAMED_VALUE_INT) {
-			ss << dv.value_int;
-		}
-		else if (dv.type == DV::TYPE_DEBUG_VECT) {
-			ss << "[";
-			bool is_first = true;
-			for (auto v : dv.data) {
-				if (!is_first) {
-					ss << ", ";
-				}
-
-				ss << v;
-				is_first = false;
-			}
+	//! Table entry of value, created on first frame. batch_mutex should be locked
+	Entry &batch_entry(uint8_t type, int32_t index, const Name &name)
+	{
+		Key key {type, index, name};
+		auto it = batch_index.find(key);
+		if (it != batch_index.end())
+			return batch_table[it->second];
+
+		batch_index.emplace(key, batch_table.size());
+		batch_table.emplace_back();
+
+		auto &e = batch_table.back();
+		e.value.type = type;
+		e.value.index = index;
+		e.value.name = mavlink::to_string(name);
+		e.updated = false;
+		return e;
+	}
 
-			ss << "]";
-		}
-		else {
-			ss << dv.value_float;
+	/**
+	 * @brief Merge value into batch table or publish it
+	 * @param fill  sets value fields
+	 */
+	template<typename _Fill>
+	void publish_value(ros::Publisher &pub, const char *frame, uint8_t type, int32_t index,
+			const Name &name, const ros::Time &stamp, _Fill fill)
+	{
+		if (batch) {
+			std::lock_guard<std::mutex> lock(batch_mutex);
+			auto &e = batch_entry(type, index, name);
+			e.value.header.stamp = stamp;
+			fill(e.value);
+			e.updated = true;
+
+			debug_logger(frame, e.value);
+			return;
 		}
 
+		auto dv_msg = boost::make_shared<DV>();
+		dv_msg->header.stamp = stamp;
+		dv_msg->type = type;
+		dv_msg->index = index;
+		dv_msg->name = mavlink::to_string(name);
+		fill(*dv_msg);
 
-		ROS_DEBUG_STREAM_NAMED("debug_value", type << "\t"
-							   << dv.header.stamp   << "\t"
-							   << name    << "\t["
-							   << dv.index   << "]\tvalue:"
-							   << ss.str());
+		debug_logger(frame, *dv_msg);
+		pub.publish(dv_msg);
 	}
 
 	/* -*- message handlers -*- */
@@ -113,36 +222,9 @@ private:
 	 */
 	void handle_debug(const mavlink::mavlink_message_t *msg, mavlink::common::msg::DEBUG &debug)
 	{
-		// [[[cog:
-		// p = "dv_msg"
-		// val = "debug"
-		//
-		// def common_filler(type_, time_f, index, name):
-		//     if isinstance(index, str):
-		//         index = val + "." + index
-		//
-		//     _args = globals()
-		//     _args.update(locals())
-		//
-		//     cog.outl("""auto {p} = boost::make_shared<mavros_msgs::DebugValue>();""".format(**_args))
-		//     cog.outl("""{p}->header.stamp = m_uas->synchronise_stamp({val}.{time_f});""".format(**_args))
-		//     cog.outl("""{p}->type = mavros_msgs::DebugValue::{type_};""".format(**_args))
-		//     cog.outl("""{p}->index = {index};""".format(**_args))
-		//     if name:
-		//         cog.outl("""{p}->name = mavlink::to_string({val}.{name});""".format(**_args))
-		//
-		// common_filler("TYPE_DEBUG", "time_boot_ms", "ind", None)
-		// cog.outl("""{p}->value_float = {val}.value;""".format(**locals()))
-		// ]]]
-		auto dv_msg = boost::make_shared<mavros_msgs::DebugValue>();
-		dv_msg->header.stamp = m_uas->synchronise_stamp(debug.time_boot_ms);
-		dv_msg->type = mavros_msgs::DebugValue::TYPE_DEBUG;
-		dv_msg->index = debug.ind;
-		dv_msg->value_float = debug.value;
-		// [[[end]]] (checksum: 82e058cb699846b34885ce3defc6ac58)
-
-		debug_logger(debug.get_name(), *dv_msg);
-		debug_pub.publish(dv_msg);
+		publish_value(debug_pub, debug.NAME, DV::TYPE_DEBUG, debug.ind, Name {},
+				m_uas->synchronise_stamp(debug.time_boot_ms),
+				[&debug](DV &dv) { dv.value_float = debug.value; });
 	}
 
 	/**
@@ -153,28 +235,14 @@ private:
 	 */
 	void handle_debug_vector(const mavlink::mavlink_message_t *msg, mavlink::common::msg::DEBUG_VECT &debug)
 	{
-		// [[[cog:
-		// common_filler("TYPE_DEBUG_VECT", "time_usec", -1, "name")
-		//
-		// fields = "xyz"
-		// pd = p + "->data"
-		// cog.outl("""{pd}.resize({l});""".format(l=len(fields), **locals()))
-		// for i, f in enumerate(fields):
-		//     cog.outl("""{pd}[{i}] = {val}.{f};""".format(**locals()))
-		// ]]]
-		auto dv_msg = boost::make_shared<mavros_msgs::DebugValue>();
-		dv_msg->header.stamp = m_uas->synchronise_stamp(debug.time_usec);
-		dv_msg->type = mavros_msgs::DebugValue::TYPE_DEBUG_VECT;
-		dv_msg->index = -1;
-		dv_msg->name = mavlink::to_string(debug.name);
-		dv_msg->data.resize(3);
-		dv_msg->data[0] = debug.x;
-		dv_msg->data[1] = debug.y;
-		dv_msg->data[2] = debug.z;
-		// [[[end]]] (checksum: 966bca4d95f06349cf065f3887c69471)
-
-		debug_logger(debug.get_name(), *dv_msg);
-		debug_vector_pub.publish(dv_msg);
+		publish_value(debug_vector_pub, debug.NAME, DV::TYPE_DEBUG_VECT, -1, debug.name,
+				m_uas->synchronise_stamp(debug.time_usec),
+				[&debug](DV &dv) {
+					dv.data.resize(3);
+					dv.data[0] = debug.x;
+					dv.data[1] = debug.y;
+					dv.data[2] = debug.z;
+				});
 	}
 
 	/**
@@ -189,21 +257,9 @@ private:
 	 */
 	void handle_named_value_float(const mavlink::mavlink_message_t *msg, mavlink::common::msg::NAMED_VALUE_FLOAT &value)
 	{
-		// [[[cog:
-		// val="value"
-		// common_filler("TYPE_NAMED_VALUE_FLOAT", "time_boot_ms", -1, "name")
-		// cog.outl("""{p}->value_float = {val}.value;""".format(**locals()))
-		// ]]]
-		auto dv_msg = boost::make_shared<mavros_msgs::DebugValue>();
-		dv_msg->header.stamp = m_uas->synchronise_stamp(value.time_boot_ms);
-		dv_msg->type = mavros_msgs::DebugValue::TYPE_NAMED_VALUE_FLOAT;
-		dv_msg->index = -1;
-		dv_msg->name = mavlink::to_string(value.name);
-		dv_msg->value_float = value.value;
-		// [[[end]]] (checksum: 8d70c469d67ab346574c99d20b91a501)
-
-		debug_logger(value.get_name(), *dv_msg);
-		named_value_float_pub.publish(dv_msg);
+		publish_value(named_value_float_pub, value.NAME, DV::TYPE_NAMED_VALUE_FLOAT, -1, value.name,
+				m_uas->synchronise_stamp(value.time_boot_ms),
+				[&value](DV &dv) { dv.value_float = value.value; });
 	}
 
 	/**
@@ -214,24 +270,33 @@ private:
 	 */
 	void handle_named_value_int(const mavlink::mavlink_message_t *msg, mavlink::common::msg::NAMED_VALUE_INT &value)
 	{
-		// [[[cog:
-		// common_filler("TYPE_NAMED_VALUE_INT", "time_boot_ms", -1, "name")
-		// cog.outl("""{p}->value_int = {val}.value;""".format(**locals()))
-		// ]]]
-		auto dv_msg = boost::make_shared<mavros_msgs::DebugValue>();
-		dv_msg->header.stamp = m_uas->synchronise_stamp(value.time_boot_ms);
-		dv_msg->type = mavros_msgs::DebugValue::TYPE_NAMED_VALUE_INT;
-		dv_msg->index = -1;
-		dv_msg->name = mavlink::to_string(value.name);
-		dv_msg->value_int = value.value;
-		// [[[end]]] (checksum: b7ce125baba6e8918f6b866a9d5aa77c)
-
-		debug_logger(value.get_name(), *dv_msg);
-		named_value_int_pub.publish(dv_msg);
+		publish_value(named_value_int_pub, value.NAME, DV::TYPE_NAMED_VALUE_INT, -1, value.name,
+				m_uas->synchronise_stamp(value.time_boot_ms),
+				[&value](DV &dv) { dv.value_int = value.value; });
 	}
 
 	/* -*- callbacks -*- */
 
+	void batch_cb(const ros::TimerEvent &event)
+	{
+		auto values_msg = boost::make_shared<mavros_msgs::DebugValueArray>();
+		values_msg->header.stamp = ros::Time::now();
+
+		{
+			std::lock_guard<std::mutex> lock(batch_mutex);
+			for (auto &e : batch_table) {
+				if (!e.updated)
+					continue;
+
+				values_msg->values.push_back(e.value);
+				e.updated = false;
+			}
+		}
+
+		if (!values_msg->values.empty())
+			values_pub.publish(values_msg);
+	}
+
 	/**
 	 * @brief Debug callbacks
 	 * @param req	pointer to mavros_msgs/Debug.msg being published
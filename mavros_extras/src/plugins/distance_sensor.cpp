@@ -13,6 +13,8 @@
  * in the top-level LICENSE file of the mavros repository.
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
+#include <array>
+#include <mutex>
 #include <unordered_map>
 #include <mavros/utils.h>
 #include <mavros/mavros_plugin.h>
@@ -37,10 +39,14 @@ public:
 	DistanceSensorItem() :
 		is_subscriber(false),
 		send_tf(false),
+		optical_flow(false),
 		sensor_id(0),
 		field_of_view(0),
 		orientation(-1),
 		covariance(0),
+		ring_angle(-1),
+		min_range(0.3),
+		max_range(5.0),
 		owner(nullptr),
 		data_index(0)
 	{ }
@@ -48,12 +54,16 @@ public:
 	// params
 	bool is_subscriber;	//!< this item is a subscriber, else is a publisher
 	bool send_tf;		//!< defines if a transform is sent or not
+	bool optical_flow;	//!< ground distance of OPTICAL_FLOW_RAD, id is flow sensor_id
 	uint8_t sensor_id;	//!< id of the sensor
 	double field_of_view;	//!< FOV of the sensor
 	Eigen::Vector3d position;	//!< sensor position
 	int orientation;	//!< check orientation of sensor if != -1
 	int covariance;		//!< in centimeters, current specification
 	std::string frame_id;	//!< frame id for send
+	double ring_angle;	//!< [deg] clockwise from forward, sensor is part of ring if >= 0
+	double min_range;	//!< [m] optical flow ranger limits, not sent in OPTICAL_FLOW_RAD
+	double max_range;
 
 	// topic handle
 	ros::Publisher pub;
@@ -109,19 +119,37 @@ private:
  *
  * This plugin allows publishing distance sensor data, which is connected to
  * an offboard/companion computer through USB/Serial, to the FCU or vice-versa.
+ *
+ * In aggregated mode subscribed readings are stored in a table and a timer
+ * sends latest reading of each sensor at fixed rate. Sensors with ring angle
+ * are packed into one OBSTACLE_DISTANCE instead.
+ *
+ * Ground distance of optical flow sensors (OPTICAL_FLOW_RAD) is published
+ * by `optical_flow` mappings, same way as DISTANCE_SENSOR.
  */
 class DistanceSensorPlugin : public plugin::PluginBase {
 public:
 	DistanceSensorPlugin() : PluginBase(),
-		dist_nh("~distance_sensor")
+		dist_nh("~distance_sensor"),
+		aggregate(false),
+		ring_increment(45),
+		ring_timeout(0.5)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
 
+		double aggregate_rate;
+
 		dist_nh.param<std::string>("base_frame_id", base_frame_id, "base_link");
 
+		// aggregated mode params
+		dist_nh.param("aggregate/rate", aggregate_rate, 0.0);
+		dist_nh.param("aggregate/ring_increment", ring_increment, 45);
+		dist_nh.param("aggregate/ring_timeout", ring_timeout, 0.5);
+		aggregate = aggregate_rate > 0.0;
+
 		XmlRpc::XmlRpcValue map_dict;
 		if (!dist_nh.getParam("", map_dict)) {
 			ROS_WARN_NAMED("distance_sensor", "DS: plugin not configured!");
@@ -131,20 +159,38 @@ public:
 		ROS_ASSERT(map_dict.getType() == XmlRpc::XmlRpcValue::TypeStruct);
 
 		for (auto &pair : map_dict) {
+			// not a sensor mapping
+			if (pair.first == "aggregate" || pair.second.getType() != XmlRpc::XmlRpcValue::TypeStruct)
+				continue;
+
 			ROS_DEBUG_NAMED("distance_sensor", "DS: initializing mapping for %s", pair.first.c_str());
 			auto it = DistanceSensorItem::create_item(this, pair.first);
 
-			if (it)
+			if (it && it->optical_flow)
+				flow_map[it->sensor_id] = it;
+			else if (it)
 				sensor_map[it->sensor_id] = it;
 			else
 				ROS_ERROR_NAMED("distance_sensor", "DS: bad config for %s", pair.first.c_str());
 		}
+
+		if (aggregate) {
+			// 72 bins should cover whole circle
+			if (ring_increment < 5 || ring_increment > 180) {
+				ROS_WARN_NAMED("distance_sensor", "DS: ring_increment %d out of range, using 45", ring_increment);
+				ring_increment = 45;
+			}
+
+			aggregate_timer = dist_nh.createTimer(ros::Duration(1.0 / aggregate_rate),
+						&DistanceSensorPlugin::aggregate_cb, this);
+		}
 	}
 
 	Subscriptions get_subscriptions()
 	{
 		return {
 			       make_handler(&DistanceSensorPlugin::handle_distance_sensor),
+			       make_handler(&DistanceSensorPlugin::handle_optical_flow_rad),
 		};
 	}
 
@@ -156,6 +202,30 @@ private:
 	std::string base_frame_id;
 
 	std::unordered_map<uint8_t, DistanceSensorItem::Ptr> sensor_map;
+	//! optical_flow mappings, by OPTICAL_FLOW_RAD sensor_id
+	std::unordered_map<uint8_t, DistanceSensorItem::Ptr> flow_map;
+
+	//! Latest reading of subscribed sensor, in DISTANCE_SENSOR units
+	struct Reading {
+		bool fresh;		//!< not sent yet
+		ros::Time stamp;	//!< receive time
+		uint32_t time_boot_ms;
+		uint16_t min_distance;
+		uint16_t max_distance;
+		uint16_t current_distance;
+		uint8_t type;
+		uint8_t orientation;
+		uint8_t covariance;
+		int ring_bin;		//!< OBSTACLE_DISTANCE bin, -1 - sent as DISTANCE_SENSOR
+	};
+
+	bool aggregate;
+	int ring_increment;	//!< [deg]
+	double ring_timeout;	//!< [sec] older ring readings are unknown
+	ros::Timer aggregate_timer;
+
+	std::mutex aggregate_mutex;
+	std::array<Reading, 256> readings {};	//!< indexed by sensor id
 
 	/* -*- low-level send -*- */
 	void distance_sensor(uint32_t time_boot_ms,
@@ -193,6 +263,66 @@ private:
 
 	/* -*- mid-level helpers -*- */
 
+	//! Store reading for aggregate_cb(), replaces not sent one
+	void aggregate_store(const Reading &rd, uint8_t id)
+	{
+		std::lock_guard<std::mutex> lock(aggregate_mutex);
+		readings[id] = rd;
+	}
+
+	/**
+	 * Send fresh readings.
+	 *
+	 * Ring sensors update readings of their bin, nearest wins,
+	 * bins without reading within ring_timeout are unknown.
+	 */
+	void aggregate_cb(const ros::TimerEvent &event)
+	{
+		mavlink::common::msg::OBSTACLE_DISTANCE obstacle {};
+		std::fill(obstacle.distances.begin(), obstacle.distances.end(), UINT16_MAX);
+		obstacle.min_distance = UINT16_MAX;
+
+		bool ring_fresh = false;
+		size_t ring_count = 0;
+		auto now = ros::Time::now();
+
+		std::lock_guard<std::mutex> lock(aggregate_mutex);
+		for (size_t id = 0; id < readings.size(); id++) {
+			auto &rd = readings[id];
+			if (rd.stamp.isZero())
+				continue;
+
+			if (rd.ring_bin < 0) {
+				if (rd.fresh)
+					distance_sensor(rd.time_boot_ms, rd.min_distance, rd.max_distance, rd.current_distance,
+							rd.type, id, rd.orientation, rd.covariance);
+			}
+			else if ((now - rd.stamp).toSec() < ring_timeout) {
+				auto &bin = obstacle.distances[rd.ring_bin];
+				bin = std::min(bin, rd.current_distance);
+
+				obstacle.time_usec = std::max<uint64_t>(obstacle.time_usec, rd.time_boot_ms * 1000ULL);
+				obstacle.sensor_type = rd.type;
+				obstacle.min_distance = std::min(obstacle.min_distance, rd.min_distance);
+				obstacle.max_distance = std::max(obstacle.max_distance, rd.max_distance);
+				ring_fresh |= rd.fresh;
+				ring_count++;
+			}
+
+			rd.fresh = false;
+		}
+
+		// ring is sent only when some of its sensors were updated
+		if (!ring_fresh)
+			return;
+
+		obstacle.increment = ring_increment;		//!< [degrees]
+
+		ROS_DEBUG_NAMED("distance_sensor", "DS: ring of %zu sensors: %s", ring_count, obstacle.to_yaml().c_str());
+
+		UAS_FCU(m_uas)->send_message_ignore_drop(obstacle);
+	}
+
 	/**
 	 * Receive distance sensor data from FCU.
 	 */
@@ -226,22 +356,15 @@ private:
 						utils::to_string_enum<MAV_SENSOR_ORIENTATION>(sensor->orientation).c_str());
 		}
 
-		auto range = boost::make_shared<sensor_msgs::Range>();
-
-		range->header = m_uas->synchronized_header(sensor->frame_id, dist_sen.time_boot_ms);
-
-		range->min_range = dist_sen.min_distance * 1E-2;// in meters
-		range->max_range = dist_sen.max_distance * 1E-2;
-		range->field_of_view = sensor->field_of_view;
-
+		uint8_t radiation_type;
 		switch (dist_sen.type) {
 		case enum_value(MAV_DISTANCE_SENSOR::LASER):
 		case enum_value(MAV_DISTANCE_SENSOR::RADAR):
 		case enum_value(MAV_DISTANCE_SENSOR::UNKNOWN):
-			range->radiation_type = sensor_msgs::Range::INFRARED;
+			radiation_type = sensor_msgs::Range::INFRARED;
 			break;
 		case enum_value(MAV_DISTANCE_SENSOR::ULTRASOUND):
-			range->radiation_type = sensor_msgs::Range::ULTRASOUND;
+			radiation_type = sensor_msgs::Range::ULTRASOUND;
 			break;
 		default:
 			ROS_ERROR_NAMED("distance_sensor",
@@ -250,26 +373,74 @@ private:
 			return;
 		}
 
-		range->range = dist_sen.current_distance * 1E-2;	// in meters
+		publish_range(*sensor, m_uas->synchronized_header(sensor->frame_id, dist_sen.time_boot_ms),
+				radiation_type, dist_sen.orientation,
+				dist_sen.min_distance * 1E-2,		// in meters
+				dist_sen.max_distance * 1E-2,
+				dist_sen.current_distance * 1E-2);
+	}
+
+	/**
+	 * Receive ground distance of optical flow sensor.
+	 *
+	 * @note PX4Flow reports sonar distance only, negative one is not valid
+	 */
+	void handle_optical_flow_rad(const mavlink::mavlink_message_t *msg, mavlink::common::msg::OPTICAL_FLOW_RAD &flow_rad)
+	{
+		using mavlink::common::MAV_SENSOR_ORIENTATION;
+
+		auto it = flow_map.find(flow_rad.sensor_id);
+		if (it == flow_map.end() || flow_rad.distance < 0.0f)
+			return;
+
+		auto sensor = it->second;
+		int orientation = (sensor->orientation >= 0) ?
+				sensor->orientation : enum_value(MAV_SENSOR_ORIENTATION::PITCH_270);
+
+		publish_range(*sensor, m_uas->synchronized_header(sensor->frame_id, flow_rad.time_usec),
+				sensor_msgs::Range::ULTRASOUND, orientation,
+				sensor->min_range, sensor->max_range, flow_rad.distance);
+	}
+
+	//! Publish reading of FCU sensor and its transform, ranges in meters
+	void publish_range(DistanceSensorItem &sensor, const std_msgs::Header &header,
+			uint8_t radiation_type, uint8_t orientation,
+			float min_range, float max_range, float current)
+	{
+		using mavlink::common::MAV_SENSOR_ORIENTATION;
 
-		if (sensor->send_tf) {
+		if (sensor.send_tf) {
 			/* variables init */
-			auto q = utils::sensor_orientation_matching(static_cast<MAV_SENSOR_ORIENTATION>(dist_sen.orientation));
+			auto q = utils::sensor_orientation_matching(static_cast<MAV_SENSOR_ORIENTATION>(orientation));
 
 			geometry_msgs::TransformStamped transform;
 
-			transform.header = m_uas->synchronized_header(base_frame_id, dist_sen.time_boot_ms);
-			transform.child_frame_id = sensor->frame_id;
+			transform.header = header;
+			transform.header.frame_id = base_frame_id;
+			transform.child_frame_id = sensor.frame_id;
 
 			/* rotation and position set */
 			tf::quaternionEigenToMsg(q, transform.transform.rotation);
-			tf::vectorEigenToMsg(sensor->position, transform.transform.translation);
+			tf::vectorEigenToMsg(sensor.position, transform.transform.translation);
 
 			/* transform broadcast */
 			m_uas->tf2_broadcaster.sendTransform(transform);
 		}
 
-		sensor->pub.publish(range);
+		// flow sensors run at hundreds of Hz
+		if (sensor.pub.getNumSubscribers() == 0)
+			return;
+
+		auto range = boost::make_shared<sensor_msgs::Range>();
+
+		range->header = header;
+		range->radiation_type = radiation_type;
+		range->field_of_view = sensor.field_of_view;
+		range->min_range = min_range;
+		range->max_range = max_range;
+		range->range = current;
+
+		sensor.pub.publish(range);
 	}
 };
 
@@ -292,6 +463,29 @@ void DistanceSensorItem::range_cb(const sensor_msgs::Range::ConstPtr &msg)
 	else if (msg->radiation_type == sensor_msgs::Range::ULTRASOUND)
 		type = enum_value(MAV_DISTANCE_SENSOR::ULTRASOUND);
 
+	if (owner->aggregate) {
+		DistanceSensorPlugin::Reading rd {};
+
+		rd.fresh = true;
+		rd.stamp = ros::Time::now();
+		rd.time_boot_ms = msg->header.stamp.toNSec() / 1000000;
+		rd.min_distance = msg->min_range / 1E-2;
+		rd.max_distance = msg->max_range / 1E-2;
+		rd.current_distance = msg->range / 1E-2;
+		rd.type = type;
+		rd.orientation = orientation;
+		rd.covariance = covariance_;
+		rd.ring_bin = -1;
+
+		if (ring_angle >= 0) {
+			int bins = 360 / owner->ring_increment;
+			rd.ring_bin = int(std::round(ring_angle / owner->ring_increment)) % bins;
+		}
+
+		owner->aggregate_store(rd, sensor_id);
+		return;
+	}
+
 	owner->distance_sensor(
 				msg->header.stamp.toNSec() / 1000000,
 				msg->min_range / 1E-2,
@@ -354,6 +548,12 @@ DistanceSensorItem::Ptr DistanceSensorItem::create_item(DistanceSensorPlugin *ow
 		}
 
 		// optional
+		pnh.param("optical_flow", p->optical_flow, false);
+		if (p->optical_flow) {
+			pnh.param("min_range", p->min_range, 0.3);
+			pnh.param("max_range", p->max_range, 5.0);
+		}
+
 		pnh.param("send_tf", p->send_tf, false);
 		if (p->send_tf) {	// sensor position defined if 'send_tf' set to TRUE
 			pnh.param("sensor_position/x", p->position.x(), 0.0);
@@ -377,6 +577,7 @@ DistanceSensorItem::Ptr DistanceSensorItem::create_item(DistanceSensorPlugin *ow
 
 		// optional
 		pnh.param("covariance", p->covariance, 0);
+		pnh.param("ring_angle", p->ring_angle, -1.0);
 	}
 
 	// create topic handles
@@ -16,8 +16,10 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <mutex>
 #include <mavros/mavros_plugin.h>
 #include <mavros/setpoint_mixin.h>
+#include <mavros/setpoint_streamer.h>
 #include <eigen_conversions/eigen_msg.h>
 #include <GeographicLib/Geocentric.hpp>
 #include <GeographicLib/Geoid.hpp>
@@ -35,7 +37,11 @@ using mavlink::common::GPS_FIX_TYPE;
  * Sends fake GPS from local position estimation source data (motion capture,
  * vision) to FCU - processed in HIL mode or out of it if parameter MAV_USEHILGPS
  * is set on PX4 Pro Autopilot Firmware; Ardupilot Firmware already supports it
- * without a flag set.
+ * without a flag set. GPS_INPUT may be sent instead.
+ *
+ * Pose callbacks only store latest position, streamer thread converts and sends it
+ * at gps_rate. Geodetic position is linearized around a reference point, exact
+ * conversion is done only when position moves away from it by linearize_radius.
  */
 class FakeGPSPlugin : public plugin::PluginBase,
 	private plugin::TF2ListenerMixin<FakeGPSPlugin> {
@@ -49,12 +55,17 @@ public:
 		map_origin(0.0, 0.0, 0.0),
 		mocap_transform(true),
 		use_vision(false),
+		use_gps_input(false),
 		tf_listen(false),
 		tf_rate(10.0),
 		eph(2.0),
 		epv(2.0),
 		satellites_visible(5),
 		fix_type(GPS_FIX_TYPE::NO_GPS),
+		linearize_radius(100.0),
+		have_sample(false),
+		ref_valid(false),
+		old_stamp(0.0),
 		// WGS-84 ellipsoid (a - equatorial radius, f - flattening of ellipsoid)
 		earth(GeographicLib::Constants::WGS84_a(), GeographicLib::Constants::WGS84_f())
 	{ }
@@ -63,17 +74,17 @@ public:
 	{
 		PluginBase::initialize(uas_);
 
-		double _gps_rate;
 		double origin_lat, origin_lon, origin_alt;
-
-		last_pos_time = ros::Time(0.0);
+		double gps_timeout;
 
 		// general params
 		int ft_i;
 		fp_nh.param<int>("fix_type", ft_i, utils::enum_value(GPS_FIX_TYPE::NO_GPS));
 		fix_type = static_cast<GPS_FIX_TYPE>(ft_i);
-		fp_nh.param("gps_rate", _gps_rate, 5.0);		// GPS data rate of 5hz
-		gps_rate: _gps_rate;
+		fp_nh.param("gps_rate", gps_rate, 5.0);		// GPS data rate of 5hz
+		fp_nh.param("gps_timeout", gps_timeout, 0.5);	// no fix sent if pose is older
+		fp_nh.param("use_gps_input", use_gps_input, false);	// GPS_INPUT instead of HIL_GPS
+		fp_nh.param("linearize_radius", linearize_radius, 100.0);	// 0 - exact conversion each fix
 		fp_nh.param("eph", eph, 2.0);
 		fp_nh.param("epv", epv, 2.0);
 		fp_nh.param<int>("satellites_visible", satellites_visible, 5);
@@ -127,7 +138,14 @@ public:
 		}
 		else {
 			ROS_ERROR_NAMED("fake_gps", "No pose source!");
+			return;
 		}
+
+		gps_rate = std::max(gps_rate, 0.1);
+		gps_streamer.start(
+				std::chrono::duration_cast<SetpointStreamer::clock::duration>(std::chrono::duration<double>(1.0 / gps_rate)),
+				std::chrono::duration_cast<SetpointStreamer::clock::duration>(std::chrono::duration<double>(gps_timeout)),
+				std::bind(&FakeGPSPlugin::gps_tick, this, std::placeholders::_1));
 	}
 
 	Subscriptions get_subscriptions()
@@ -139,8 +157,7 @@ private:
 	friend class TF2ListenerMixin;
 	ros::NodeHandle fp_nh;
 
-	ros::Rate gps_rate;
-	ros::Time last_pos_time;
+	double gps_rate;
 
 	// Constructor for a ellipsoid
 	GeographicLib::Geocentric earth;
@@ -153,6 +170,7 @@ private:
 	bool use_vision;		//!< set use of vision data
 	bool mocap_transform;		//!< set use of mocap data (TransformStamped msg)
 	bool tf_listen;			//!< set use of TF Listener data
+	bool use_gps_input;		//!< send GPS_INPUT instead of HIL_GPS
 
 	double eph, epv;
 	int satellites_visible;
@@ -165,85 +183,202 @@ private:
 
 	Eigen::Vector3d map_origin;	//!< geodetic origin [lla]
 	Eigen::Vector3d ecef_origin;	//!< geocentric origin [m]
-	Eigen::Vector3d old_ecef;	//!< previous geocentric position [m]
+
+	double linearize_radius;	//!< [m] exact conversion farther from reference
+
+	//! Latest pose sample, written by callbacks
+	std::mutex sample_mutex;
+	bool have_sample;
+	ros::Time sample_stamp;
+	Eigen::Vector3d sample_enu;	//!< local position [m]
+
+	//! Linearization around reference point, only used by streamer thread
+	bool ref_valid;
+	Eigen::Vector3d ref_enu;	//!< reference local position [m]
+	Eigen::Vector3d ref_lla;	//!< reference geodetic position [deg, deg, m]
+	Eigen::Vector3d ref_scale;	//!< local ENU at reference to [deg/m, deg/m, m/m]
+	Eigen::Matrix3d ref_rotation;	//!< origin ENU to reference ENU
+	double ref_geoid;		//!< ellipsoid to geoid height at reference [m]
+
+	Eigen::Vector3d old_enu;	//!< previous sent position [m]
 	double old_stamp;		//!< previous stamp [s]
 
+	SetpointStreamer gps_streamer;
+
+	//! GPS_INPUT_IGNORE_FLAG_SPEED_ACCURACY
+	static constexpr uint16_t GPS_INPUT_IGNORE_SPEED_ACCURACY = 32;
+
 	/* -*- mid-level helpers and low-level send -*- */
 
+	//! Rotation from ENU at @a lat, @a lon [deg] to ECEF
+	static Eigen::Matrix3d enu_to_ecef_rotation(double lat, double lon)
+	{
+		double sin_lat = std::sin(lat * M_PI / 180.0), cos_lat = std::cos(lat * M_PI / 180.0);
+		double sin_lon = std::sin(lon * M_PI / 180.0), cos_lon = std::cos(lon * M_PI / 180.0);
+
+		Eigen::Matrix3d r;
+		r << -sin_lon, -sin_lat * cos_lon, cos_lat * cos_lon,
+		     cos_lon, -sin_lat * sin_lon, cos_lat * sin_lon,
+		     0.0, cos_lat, sin_lat;
+		return r;
+	}
+
 	/**
-	 * @brief Send fake GPS coordinates through HIL_GPS Mavlink msg
+	 * @brief Exact conversion of @a enu, it becomes linearization reference
 	 */
-	void send_fake_gps(const ros::Time &stamp, const Eigen::Vector3d &ecef_offset) {
-		// Throttle incoming messages to 5hz
-		if ((ros::Time::now() - last_pos_time) < ros::Duration(gps_rate)) {
-			return;
-		}
-		last_pos_time = ros::Time::now();
-
-		/**
-		 * @note: HIL_GPS messages are accepted on PX4 Firmware out of HIL mode,
-		 * if use_hil_gps flag is set (param MAV_USEHILGPS = 1).
-		 * @todo: add GPS_INPUT msg as an alternative, as Ardupilot already supports it
-		 */
-		mavlink::common::msg::HIL_GPS fix {};
-
-		Eigen::Vector3d geodetic;
-		Eigen::Vector3d current_ecef(ecef_origin.x() + ecef_offset.x(),
-					ecef_origin.y() + ecef_offset.y(),
-					ecef_origin.z() + ecef_offset.z());
+	void set_reference(const Eigen::Vector3d &enu)
+	{
+		Eigen::Vector3d current_ecef = ecef_origin + ftf::transform_frame_enu_ecef(enu, map_origin);
 
 		try {
 			earth.Reverse(current_ecef.x(), current_ecef.y(), current_ecef.z(),
-						geodetic.x(), geodetic.y(), geodetic.z());
+						ref_lla.x(), ref_lla.y(), ref_lla.z());
 		}
 		catch (const std::exception& e) {
 			ROS_INFO_STREAM("FGPS: Caught exception: " << e.what() << std::endl);
 		}
 
-		Eigen::Vector3d vel = ((old_ecef - current_ecef) / (stamp.toSec() - old_stamp)) * 1e2;// [cm/s]
+		// meridian (M) and prime vertical (N) radii of curvature
+		const double a = earth.MajorRadius();
+		const double e2 = earth.Flattening() * (2.0 - earth.Flattening());
+		const double sin_lat = std::sin(ref_lla.x() * M_PI / 180.0);
+		const double w = std::sqrt(1.0 - e2 * sin_lat * sin_lat);
+		const double M = a * (1.0 - e2) / (w * w * w);
+		const double N = a / w;
 
-		// compute course over ground
-		double cog;
-		if (vel.x() == 0 && vel.y() == 0) {
-			cog = 0;
-		}
-		else if (vel.x() >= 0 && vel.y() < 0) {
-			cog = M_PI * 5 / 2 - atan2(vel.x(), vel.y());
+		ref_scale.x() = 180.0 / M_PI / ((N + ref_lla.z()) * std::cos(ref_lla.x() * M_PI / 180.0));
+		ref_scale.y() = 180.0 / M_PI / (M + ref_lla.z());
+		ref_scale.z() = 1.0;
+
+		ref_rotation = enu_to_ecef_rotation(ref_lla.x(), ref_lla.y()).transpose() *
+				enu_to_ecef_rotation(map_origin.x(), map_origin.y());
+
+		ref_geoid = GeographicLib::Geoid::ELLIPSOIDTOGEOID * (*m_uas->egm96_5)(ref_lla.x(), ref_lla.y());
+		ref_enu = enu;
+		ref_valid = true;
+	}
+
+	/**
+	 * @brief Geodetic position of @a enu [deg, deg, m AMSL]
+	 */
+	Eigen::Vector3d enu_to_geodetic(const Eigen::Vector3d &enu)
+	{
+		if (!ref_valid || linearize_radius <= 0.0 || (enu - ref_enu).norm() > linearize_radius)
+			set_reference(enu);
+
+		Eigen::Vector3d d = (ref_rotation * (enu - ref_enu)).cwiseProduct(ref_scale);
+		return Eigen::Vector3d(ref_lla.x() + d.y(), ref_lla.y() + d.x(), ref_lla.z() + d.z() + ref_geoid);
+	}
+
+	//! Send latest sample, called by streamer thread at gps_rate
+	void gps_tick(bool stale)
+	{
+		ros::Time stamp;
+		Eigen::Vector3d enu;
+		{
+			std::lock_guard<std::mutex> lock(sample_mutex);
+			if (!have_sample || stale)
+				return;
+
+			stamp = sample_stamp;
+			enu = sample_enu;
 		}
-		else {
-			cog = M_PI / 2 - atan2(vel.x(), vel.y());
+
+		send_fake_gps(stamp, enu);
+	}
+
+	/**
+	 * @brief Send fake GPS coordinates through HIL_GPS or GPS_INPUT Mavlink msg
+	 */
+	void send_fake_gps(const ros::Time &stamp, const Eigen::Vector3d &enu) {
+		Eigen::Vector3d geodetic = enu_to_geodetic(enu);
+
+		double dt = stamp.toSec() - old_stamp;
+		Eigen::Vector3d vel_ned = Eigen::Vector3d::Zero();	// [m/s]
+		if (old_stamp > 0.0 && dt > 0.0)
+			vel_ned = ftf::transform_frame_enu_ned(Eigen::Vector3d((enu - old_enu) / dt));
+
+		// course over ground [0..2pi)
+		double cog = std::atan2(vel_ned.y(), vel_ned.x());
+		if (cog < 0.0)
+			cog += 2.0 * M_PI;
+
+		// store old values
+		old_stamp = stamp.toSec();
+		old_enu = enu;
+
+		if (use_gps_input) {
+			mavlink::common::msg::GPS_INPUT fix {};
+
+			// GPS time: epoch 1980-01-06, 18 leap seconds
+			uint64_t gps_ms = (stamp.toNSec() / 1000000) - 315964800000ULL + 18000ULL;
+
+			fix.time_usec = stamp.toNSec() / 1000;	// [useconds]
+			fix.ignore_flags = GPS_INPUT_IGNORE_SPEED_ACCURACY;
+			fix.time_week = gps_ms / 604800000ULL;
+			fix.time_week_ms = gps_ms % 604800000ULL;
+			fix.fix_type = utils::enum_value(fix_type);
+			fix.lat = geodetic.x() * 1e7;		// [degrees * 1e7]
+			fix.lon = geodetic.y() * 1e7;		// [degrees * 1e7]
+			fix.alt = geodetic.z();			// [meters]
+			fix.hdop = eph;
+			fix.vdop = epv;
+			fix.vn = vel_ned.x();			// [m/s]
+			fix.ve = vel_ned.y();
+			fix.vd = vel_ned.z();
+			fix.horiz_accuracy = eph;		// [m]
+			fix.vert_accuracy = epv;
+			fix.satellites_visible = satellites_visible;
+
+			UAS_FCU(m_uas)->send_message_ignore_drop(fix);
+			return;
 		}
 
+		/**
+		 * @note: HIL_GPS messages are accepted on PX4 Firmware out of HIL mode,
+		 * if use_hil_gps flag is set (param MAV_USEHILGPS = 1).
+		 */
+		mavlink::common::msg::HIL_GPS fix {};
+		Eigen::Vector3d vel = vel_ned * 1e2;	// [cm/s]
+
 		// Fill in and send message
 		fix.time_usec = stamp.toNSec() / 1000;	// [useconds]
 		fix.lat = geodetic.x() * 1e7;		// [degrees * 1e7]
 		fix.lon = geodetic.y() * 1e7;		// [degrees * 1e7]
-		fix.alt = (geodetic.z() + GeographicLib::Geoid::ELLIPSOIDTOGEOID *
-			  (*m_uas->egm96_5)(geodetic.x(), geodetic.y())) * 1e3;	// [meters * 1e3]
+		fix.alt = geodetic.z() * 1e3;		// [meters * 1e3]
 		fix.vel = vel.block<2, 1>(0, 0).norm();	// [cm/s]
 		fix.vn = vel.x();			// [cm/s]
 		fix.ve = vel.y();			// [cm/s]
 		fix.vd = vel.z();			// [cm/s]
-		fix.cog = cog * 1e2;			// [degrees * 1e2]
+		fix.cog = cog * 180.0 / M_PI * 1e2;	// [degrees * 1e2]
 		fix.eph = eph * 1e2;			// [cm]
 		fix.epv = epv * 1e2;			// [cm]
-		fix.fix_type = utils::enum_value(fix_type);;
+		fix.fix_type = utils::enum_value(fix_type);
 		fix.satellites_visible = satellites_visible;
 
-		// store old values
-		old_stamp = stamp.toSec();
-		old_ecef = current_ecef;
-
 		UAS_FCU(m_uas)->send_message_ignore_drop(fix);
 	}
 
+	//! Store latest pose, it replaces not sent one
+	void store_sample(const ros::Time &stamp, const Eigen::Vector3d &enu)
+	{
+		{
+			std::lock_guard<std::mutex> lock(sample_mutex);
+			sample_stamp = stamp;
+			sample_enu = enu;
+			have_sample = true;
+		}
+
+		gps_streamer.update();
+	}
+
 	/* -*- callbacks -*- */
 	void mocap_tf_cb(const geometry_msgs::TransformStamped::ConstPtr &trans)
 	{
 		Eigen::Affine3d pos_enu;
 		tf::transformMsgToEigen(trans->transform, pos_enu);
 
-		send_fake_gps(trans->header.stamp, ftf::transform_frame_enu_ecef(Eigen::Vector3d(pos_enu.translation()), map_origin));
+		store_sample(trans->header.stamp, pos_enu.translation());
 	}
 
 	void mocap_pose_cb(const geometry_msgs::PoseStamped::ConstPtr &req)
@@ -251,7 +386,7 @@ private:
 		Eigen::Affine3d pos_enu;
 		tf::poseMsgToEigen(req->pose, pos_enu);
 
-		send_fake_gps(req->header.stamp, ftf::transform_frame_enu_ecef(Eigen::Vector3d(pos_enu.translation()), map_origin));
+		store_sample(req->header.stamp, pos_enu.translation());
 	}
 
 	void vision_cb(const geometry_msgs::PoseStamped::ConstPtr &req)
@@ -259,7 +394,7 @@ private:
 		Eigen::Affine3d pos_enu;
 		tf::poseMsgToEigen(req->pose, pos_enu);
 
-		send_fake_gps(req->header.stamp, ftf::transform_frame_enu_ecef(Eigen::Vector3d(pos_enu.translation()), map_origin));
+		store_sample(req->header.stamp, pos_enu.translation());
 	}
 
 	void transform_cb(const geometry_msgs::TransformStamped &trans)
@@ -268,9 +403,11 @@ private:
 
 		tf::transformMsgToEigen(trans.transform, pos_enu);
 
-		send_fake_gps(trans.header.stamp, ftf::transform_frame_enu_ecef(Eigen::Vector3d(pos_enu.translation()), map_origin));
+		store_sample(trans.header.stamp, pos_enu.translation());
 	}
 };
+
+constexpr uint16_t FakeGPSPlugin::GPS_INPUT_IGNORE_SPEED_ACCURACY;
 }	// namespace extra_plugins
 }	// namespace mavros
 
@@ -15,26 +15,86 @@
  */
 
 #include <mavros/mavros_plugin.h>
+#include <mavros/rtcm_injector.h>
 #include <mavros_msgs/msg/RTCM.hpp>
+#include <mavconn/thread_utils.h>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <memory>
+#include <thread>
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 namespace mavros {
 namespace extra_plugins {
 /**
  * @brief GPS RTK plugin
  *
- * Publish the RTCM messages from ROS to the FCU
+ * Publish the RTCM messages from ROS to the FCU.
+ *
+ * Corrections also may be read from TCP server or NTRIP caster,
+ * then stream is split at RTCM3 frame boundaries.
+ * Output is packed into GPS_RTCM_DATA fragments and paced by bandwidth budget,
+ * see RtcmInjector.
  */
 class GpsRtkPlugin : public plugin::PluginBase {
 public:
 	GpsRtkPlugin() : PluginBase(),
-		gps_rtk_nh("~gps_rtk")
+		gps_rtk_nh("~gps_rtk"),
+		tcp_port(0),
+		client_running(false),
+		client_connected(false)
 	{ }
 
+	~GpsRtkPlugin()
+	{
+		client_running = false;
+		if (client_thread.joinable())
+			client_thread.join();
+	}
+
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+
+		int bandwidth, pool_size;
+		double epoch_gap;
+
+		// injector params
+		gps_rtk_nh.param("bandwidth", bandwidth, 0);
+		gps_rtk_nh.param("pool_size", pool_size, 64);
+		gps_rtk_nh.param("epoch_gap", epoch_gap, 0.2);
+
+		// tcp/ntrip params
+		gps_rtk_nh.param<std::string>("tcp/host", tcp_host, "");
+		gps_rtk_nh.param("tcp/port", tcp_port, 0);
+		gps_rtk_nh.param<std::string>("ntrip/mountpoint", ntrip_mountpoint, "");
+		gps_rtk_nh.param<std::string>("ntrip/user", ntrip_user, "");
+		gps_rtk_nh.param<std::string>("ntrip/password", ntrip_password, "");
+
+		RtcmInjector::Options opts;
+		opts.bandwidth = std::max(bandwidth, 0);
+		opts.pool_size = std::max(pool_size, 1);
+		opts.epoch_gap = std::chrono::duration_cast<RtcmInjector::clock::duration>(
+				std::chrono::duration<double>(epoch_gap));
+		injector.reset(new RtcmInjector(opts));
+
 		gps_rtk_sub = gps_rtk_nh.subscribe("send_rtcm", 10, &GpsRtkPlugin::rtcm_cb, this);
+
+		// data held back by bandwidth budget is sent by timer
+		if (opts.bandwidth > 0)
+			poll_timer = gps_rtk_nh.createTimer(ros::Duration(0.02), &GpsRtkPlugin::poll_cb, this);
+
+		if (tcp_port > 0 && !tcp_host.empty()) {
+			client_running = true;
+			client_thread = std::thread(&GpsRtkPlugin::client_run, this);
+		}
+
+		UAS_DIAG(m_uas).add("GPS RTK", this, &GpsRtkPlugin::diag_run);
 	}
 
 	Subscriptions get_subscriptions()
@@ -45,49 +105,217 @@ public:
 private:
 	ros::NodeHandle gps_rtk_nh;
 	ros::Subscriber gps_rtk_sub;
+	ros::Timer poll_timer;
+
+	std::unique_ptr<RtcmInjector> injector;
+
+	std::string tcp_host;
+	int tcp_port;
+	std::string ntrip_mountpoint;
+	std::string ntrip_user;
+	std::string ntrip_password;
+
+	std::atomic<bool> client_running;
+	std::atomic<bool> client_connected;
+	std::thread client_thread;
+
+	void send_fragment(const RtcmInjector::Fragment &frag)
+	{
+		mavlink::common::msg::GPS_RTCM_DATA rtcm_data;
+
+		rtcm_data.flags = frag.flags;
+		rtcm_data.len = frag.len;
+		std::copy(frag.data, frag.data + frag.len, rtcm_data.data.begin());
+		std::fill(rtcm_data.data.begin() + frag.len, rtcm_data.data.end(), 0);
+
+		UAS_FCU(m_uas)->send_message(rtcm_data);
+	}
+
+	void poll()
+	{
+		injector->poll(std::bind(&GpsRtkPlugin::send_fragment, this, std::placeholders::_1));
+	}
+
+	static std::string base64_encode(const std::string &in)
+	{
+		static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		std::string out;
+		uint32_t acc = 0;
+		int bits = 0;
+
+		for (uint8_t c : in) {
+			acc = (acc << 8) | c;
+			bits += 8;
+			while (bits >= 6) {
+				bits -= 6;
+				out.push_back(table[(acc >> bits) & 0x3F]);
+			}
+		}
+
+		if (bits > 0)
+			out.push_back(table[(acc << (6 - bits)) & 0x3F]);
+		while (out.size() % 4)
+			out.push_back('=');
+
+		return out;
+	}
+
+	/**
+	 * @brief Connect to server, send NTRIP request
+	 * @return socket or -1
+	 */
+	int client_connect()
+	{
+		addrinfo hints {}, *res = nullptr;
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+
+		auto port = std::to_string(tcp_port);
+		if (getaddrinfo(tcp_host.c_str(), port.c_str(), &hints, &res) != 0) {
+			ROS_WARN_THROTTLE_NAMED(30, "gps_rtk", "GPS RTK: can not resolve %s", tcp_host.c_str());
+			return -1;
+		}
+
+		int fd = -1;
+		for (auto ai = res; ai != nullptr; ai = ai->ai_next) {
+			fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+			if (fd < 0)
+				continue;
+
+			if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+				break;
+
+			close(fd);
+			fd = -1;
+		}
+		freeaddrinfo(res);
+
+		if (fd < 0) {
+			ROS_WARN_THROTTLE_NAMED(30, "gps_rtk", "GPS RTK: can not connect to %s:%d", tcp_host.c_str(), tcp_port);
+			return -1;
+		}
+
+		// recv() wakes up to check client_running
+		timeval tv {1, 0};
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+		if (!ntrip_mountpoint.empty()) {
+			std::string req = "GET /" + ntrip_mountpoint + " HTTP/1.0\r\n"
+					  "User-Agent: NTRIP mavros\r\n";
+			if (!ntrip_user.empty())
+				req += "Authorization: Basic " + base64_encode(ntrip_user + ":" + ntrip_password) + "\r\n";
+			req += "\r\n";
+
+			if (send(fd, req.data(), req.size(), MSG_NOSIGNAL) != ssize_t(req.size())) {
+				close(fd);
+				return -1;
+			}
+		}
+
+		return fd;
+	}
+
+	void client_run()
+	{
+		mavconn::utils::set_this_thread_name("mvrtcm");
+
+		std::array<uint8_t, 2048> buf;
+
+		for (bool first = true; client_running; first = false) {
+			// reconnect delay
+			for (int i = 0; !first && i < 5 && client_running; i++)
+				std::this_thread::sleep_for(std::chrono::seconds(1));
+
+			int fd = client_connect();
+			if (fd < 0)
+				continue;
+
+			ROS_INFO_NAMED("gps_rtk", "GPS RTK: connected to %s:%d", tcp_host.c_str(), tcp_port);
+
+			// NTRIP reply header is skipped
+			bool header = !ntrip_mountpoint.empty();
+			std::string reply;
+
+			while (client_running) {
+				auto n = recv(fd, buf.data(), buf.size(), 0);
+				if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+					continue;
+				else if (n <= 0)
+					break;
+
+				size_t offset = 0;
+				if (header) {
+					reply.append(reinterpret_cast<char *>(buf.data()), n);
+
+					// NTRIP v1 "ICY 200 OK\r\n", v2 HTTP reply with headers
+					auto eol = reply.find("\r\n");
+					if (eol == std::string::npos)
+						continue;
+
+					if (reply.find(" 200") > eol) {
+						ROS_ERROR_NAMED("gps_rtk", "GPS RTK: caster refused: %s", reply.substr(0, eol).c_str());
+						break;
+					}
+
+					size_t end = eol + 2;
+					if (reply.compare(0, 4, "ICY ") != 0) {
+						end = reply.find("\r\n\r\n");
+						if (end == std::string::npos)
+							continue;
+						end += 4;
+					}
+
+					header = false;
+					offset = n - (reply.size() - end);
+				}
+
+				client_connected = true;
+				injector->push_stream(buf.data() + offset, n - offset);
+				poll();
+			}
+
+			client_connected = false;
+			close(fd);
+			ROS_WARN_NAMED("gps_rtk", "GPS RTK: connection to %s:%d closed", tcp_host.c_str(), tcp_port);
+		}
+	}
+
+	void diag_run(diagnostic_updater::DiagnosticStatusWrapper &stat)
+	{
+		auto st = injector->get_stats();
+
+		if (tcp_port > 0 && !client_connected)
+			stat.summary(1, "Not connected");
+		else
+			stat.summary(0, "Normal");
+
+		stat.addf("Queued units", "%zu", injector->queued());
+		stat.addf("RTCM3 frames", "%llu", (unsigned long long) st.frames);
+		stat.addf("CRC errors", "%llu", (unsigned long long) st.crc_errors);
+		stat.addf("Skipped bytes", "%llu", (unsigned long long) st.skipped_bytes);
+		stat.addf("Sent fragments", "%llu", (unsigned long long) st.fragments);
+		stat.addf("Sent bytes", "%llu", (unsigned long long) st.bytes);
+		stat.addf("Stale units", "%llu", (unsigned long long) st.stale_units);
+		stat.addf("Overflow units", "%llu", (unsigned long long) st.overflow_units);
+	}
 
 	/* -*- callbacks -*- */
 	/**
 	 * @brief Handle mavros_msgs::RTCM message
 	 * It converts the message to the MAVLink GPS_RTCM_DATA message for GPS injection.
 	 * Message specification: https://mavlink.io/en/messages/common.html#GPS_RTCM_DATA
+	 * Messages longer than 4 fragments are split.
 	 * @param msg		Received ROS msg
 	 */
 	void rtcm_cb(const mavros_msgs::RTCM::ConstPtr &msg)
 	{
-		mavlink::common::msg::GPS_RTCM_DATA rtcm_data;
-		const size_t max_frag_len = rtcm_data.data.size();
-
-		uint8_t seq_u5 = uint8_t(msg->header.seq & 0x1F) << 3;
-
-		if (msg->data.size() > 4 * max_frag_len) {
-			ROS_FATAL("gps_rtk: RTCM message received is bigger than the maximal possible size.");
-			return;
-		}
+		injector->push_message(msg->data.data(), msg->data.size());
+		poll();
+	}
 
-		auto data_it = msg->data.begin();
-		auto end_it = msg->data.end();
-
-		if (msg->data.size() <= max_frag_len) {
-			rtcm_data.len = msg->data.size();
-			rtcm_data.flags = seq_u5;
-			std::copy(data_it, end_it, rtcm_data.data.begin());
-			std::fill(rtcm_data.data.begin() + rtcm_data.len, rtcm_data.data.end(), 0);
-			UAS_FCU(m_uas)->send_message(rtcm_data);
-		} else {
-			for (uint8_t fragment_id = 0; fragment_id < 4 && data_it < end_it; fragment_id++) {
-				uint8_t len = std::min((size_t) std::distance(data_it, end_it), max_frag_len);
-				rtcm_data.flags = 1;				// LSB set indicates message is fragmented
-				rtcm_data.flags |= fragment_id << 1;		// Next 2 bits are fragment id
-				rtcm_data.flags |= seq_u5;		// Next 5 bits are sequence id
-				rtcm_data.len = len;
-
-				std::copy(data_it, data_it + len, rtcm_data.data.begin());
-				std::fill(rtcm_data.data.begin() + len, rtcm_data.data.end(), 0);
-				UAS_FCU(m_uas)->send_message(rtcm_data);
-				std::advance(data_it, len);
-			}
-		}
+	void poll_cb(const ros::TimerEvent &event)
+	{
+		poll();
 	}
 };
 }	// namespace extra_plugins
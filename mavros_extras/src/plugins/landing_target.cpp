@@ -19,6 +19,7 @@
 #include <mavros/setpoint_mixin.h>
 #include <pluginlib/class_list_macros.h>
 #include <eigen_conversions/eigen_msg.h>
+#include <ros/callback_queue.h>
 
 #include <geometry_msgs/msg/PoseStamped.hpp>
 #include <geometry_msgs/Vector3Stamped.h>
@@ -34,6 +35,10 @@ using mavlink::common::LANDING_TARGET_TYPE;
  *
  * This plugin is intended to publish the location of a landing area captured from a downward facing camera
  * to the FCU and/or receive landing target tracking data coming from the FCU.
+ *
+ * Detector poses may be handled by own spinner thread and are sent right away,
+ * optionally extrapolated to send time by velocity from last two poses.
+ * Target size marker is published by low rate timer, only to subscribers.
  */
 class LandingTargetPlugin : public plugin::PluginBase,
 	private plugin::TF2ListenerMixin<LandingTargetPlugin> {
@@ -52,7 +57,11 @@ public:
 		fov_x(2.0071286398),
 		fov_y(2.0071286398),
 		focal_length(2.8),
-		land_target_type("VISION_FIDUCIAL")
+		land_target_type("VISION_FIDUCIAL"),
+		vision_offsets(false),
+		extrapolate(false),
+		max_extrapolation(0.0),
+		have_last_pose(false)
 	{ }
 
 	void initialize(UAS &uas_)
@@ -89,19 +98,53 @@ public:
 		nh.param<std::string>("tf/child_frame_id", tf_child_frame_id, "camera_center");
 		nh.param("tf/rate_limit", tf_rate, 50.0);
 
+		bool tcp_nodelay, own_thread;
+		double marker_rate;
+
+		// latency params
+		nh.param("extrapolate", extrapolate, false);
+		nh.param("max_extrapolation", max_extrapolation, 0.1);	// [sec]
+		nh.param("tcp_nodelay", tcp_nodelay, true);
+		nh.param("own_thread", own_thread, true);
+		nh.param("marker_rate", marker_rate, 1.0);
+
+		// constant part of send_landing_target()
+		fov = Eigen::Vector2f(fov_x, fov_y);
+		vision_offsets = land_target_type.find("VISION");
+		vision_size_rad = {2 * (M_PI / 180.0) * atan(target_size_x / (2 * focal_length)),
+				   2 * (M_PI / 180.0) * atan(target_size_y / (2 * focal_length))};
+		// the last char of frame_id is considered the number of the target
+		target_id = static_cast<uint8_t>(frame_id.back());
+
 		land_target_pub = nh.advertise<geometry_msgs::PoseStamped>("pose_in", 10);
 		lt_marker_pub = nh.advertise<geometry_msgs::Vector3Stamped>("lt_marker", 10);
 
+		if (marker_rate > 0.0)
+			marker_timer = nh.createTimer(ros::Duration(1.0 / marker_rate), &LandingTargetPlugin::marker_cb, this);
+
+		ros::TransportHints hints;
+		if (tcp_nodelay)
+			hints.tcpNoDelay();
+
+		ros::NodeHandle lt_nh(nh);
+		if (own_thread)
+			lt_nh.setCallbackQueue(&lt_queue);
+
 		if (listen_tf) {	// Listen to transform
 			ROS_INFO_STREAM_NAMED("landing_target", "Listen to landing_target transform " << tf_frame_id
 												      << " -> " << tf_child_frame_id);
 			tf2_start("LandingTargetTF", &LandingTargetPlugin::transform_cb);
 		}
 		else if (listen_lt) {	// Subscribe to LandingTarget msg
-			land_target_sub = nh.subscribe("raw", 10, &LandingTargetPlugin::landtarget_cb, this);
+			land_target_sub = lt_nh.subscribe("raw", 10, &LandingTargetPlugin::landtarget_cb, this, hints);
 		}
 		else {			// Subscribe to PoseStamped msg
-			pose_sub = nh.subscribe("pose", 10, &LandingTargetPlugin::pose_cb, this);
+			pose_sub = lt_nh.subscribe("pose", 10, &LandingTargetPlugin::pose_cb, this, hints);
+		}
+
+		if (own_thread && !listen_tf) {
+			lt_spinner.reset(new ros::AsyncSpinner(1, &lt_queue));
+			lt_spinner->start();
 		}
 	}
 
@@ -129,8 +172,14 @@ private:
 
 	ros::Publisher land_target_pub;
 	ros::Publisher lt_marker_pub;
+	ros::Timer marker_timer;
+
+	// declaration order matters: spinner stops first,
+	// subscribers are shut down before their queue goes away
+	ros::CallbackQueue lt_queue;
 	ros::Subscriber land_target_sub;
 	ros::Subscriber pose_sub;
+	std::unique_ptr<ros::AsyncSpinner> lt_spinner;
 
 	double target_size_x, target_size_y;
 	double fov_x, fov_y;
@@ -143,6 +192,18 @@ private:
 	LANDING_TARGET_TYPE type;
 	std::string land_target_type;
 
+	bool vision_offsets;		//!< angular offsets from image position
+	Eigen::Vector2f fov;
+	Eigen::Vector2f vision_size_rad;
+	uint8_t target_id;
+
+	// extrapolation, used by one thread: tf dispatcher or pose spinner
+	bool extrapolate;
+	double max_extrapolation;
+	bool have_last_pose;
+	ros::Time last_pose_stamp;
+	Eigen::Vector3d last_pose_pos;
+
 	/* -*- low-level send -*- */
 	void landing_target(uint64_t time_usec,
 				uint8_t target_num,
@@ -215,10 +276,51 @@ private:
 		}
 	}
 
+	//! Longest interval between poses usable for velocity [sec]
+	static constexpr double MAX_POSE_GAP = 0.5;
+
+	/**
+	 * @brief Move target position to current time by velocity from last two poses
+	 *
+	 * Position only, not extrapolated past max_extrapolation or over gap in poses.
+	 */
+	void extrapolate_to_now(ros::Time &stamp, Eigen::Affine3d &tr) {
+		Eigen::Vector3d pos = tr.translation();
+		double dt = (stamp - last_pose_stamp).toSec();
+		bool have_velocity = have_last_pose && dt > 0.0 && dt <= MAX_POSE_GAP;
+		Eigen::Vector3d velocity = (have_velocity) ? Eigen::Vector3d((pos - last_pose_pos) / dt) : Eigen::Vector3d::Zero();
+
+		have_last_pose = true;
+		last_pose_stamp = stamp;
+		last_pose_pos = pos;
+
+		if (!have_velocity)
+			return;
+
+		auto now = ros::Time::now();
+		double ahead = std::min((now - stamp).toSec(), max_extrapolation);
+		if (ahead <= 0.0)
+			return;
+
+		tr.translation() = pos + velocity * ahead;
+		stamp += ros::Duration(ahead);
+	}
+
 	/**
 	 * @brief Send landing target transform to FCU
 	 */
-	void send_landing_target(const ros::Time &stamp, const Eigen::Affine3d &tr) {
+	void send_landing_target(const ros::Time &stamp_, const Eigen::Affine3d &tr_) {
+		if (last_transform_stamp == stamp_) {
+			ROS_DEBUG_THROTTLE_NAMED(10, "landing_target", "LT: Same transform as last one, dropped.");
+			return;
+		}
+		last_transform_stamp = stamp_;
+
+		ros::Time stamp = stamp_;
+		Eigen::Affine3d tr = tr_;
+		if (extrapolate)
+			extrapolate_to_now(stamp, tr);
+
 		/**
 		 * @brief the position of the landing target WRT camera center - on the FCU,
 		 * the position WRT to the origin local NED frame can be computed to allow
@@ -232,13 +334,12 @@ private:
 
 		Eigen::Vector2f angle;
 		Eigen::Vector2f size_rad;
-		Eigen::Vector2f fov;
 
 		// the norm of the position vector is considered the distance to the landing target
 		float distance = pos.norm();
 
 		// if the landing target type is a vision type, compute the angular offsets
-		if (land_target_type.find("VISION")) {
+		if (vision_offsets) {
 			/**
 			 * @brief: the camera angular offsets can be computed by knowing the position
 			 * of the target center relative to the camera center, the field-of-view of
@@ -252,8 +353,7 @@ private:
 			 * δ = 2 * atan(d / (2 * D))
 			 * where,	d = actual diameter; D = distance to the object (or focal length of a camera)
 			 */
-			size_rad = {2 * (M_PI / 180.0) * atan(target_size_x / (2 * focal_length)),
-				    2 * (M_PI / 180.0) * atan(target_size_y / (2 * focal_length))};
+			size_rad = vision_size_rad;
 		}
 		// else, the same values are computed considering the displacement relative to X and Y axes of the camera frame reference
 		else {
@@ -262,29 +362,20 @@ private:
 				    2 * (M_PI / 180.0) * atan(target_size_y / (2 * distance))};
 		}
 
-		if (last_transform_stamp == stamp) {
-			ROS_DEBUG_THROTTLE_NAMED(10, "landing_target", "LT: Same transform as last one, dropped.");
-			return;
-		}
-		last_transform_stamp = stamp;
-
 		auto rpy = ftf::quaternion_to_rpy(q);
 
-		// the last char of frame_id is considered the number of the target
-		uint8_t id = static_cast<uint8_t>(frame_id.back());
-
 		ROS_DEBUG_THROTTLE_NAMED(10, "landing_target", "Tx landing target: "
 					"ID: %d frame: %s angular offset: X:%1.3frad, Y:%1.3frad) "
 					"distance: %1.3fm position: X:%1.3fm, Y:%1.3fm, Z:%1.3fm) "
 					"orientation: roll:%1.4frad pitch:%1.4frad yaw:%1.4frad "
 					"size: X:%1.3frad by Y:%1.3frad type: %s",
-					id, utils::to_string(static_cast<MAV_FRAME>(frame)).c_str(),
+					target_id, utils::to_string(static_cast<MAV_FRAME>(frame)).c_str(),
 					angle.x(), angle.y(), distance, pos.x(), pos.y(), pos.z(),
 					rpy.x(), rpy.y(), rpy.z(), size_rad.x(), size_rad.y(),
 					utils::to_string(static_cast<LANDING_TARGET_TYPE>(type)).c_str());
 
 		landing_target(stamp.toNSec() / 1000,
-					id,
+					target_id,
 					utils::enum_value(frame),	// by default, in LOCAL_NED
 					angle,
 					distance,
@@ -337,16 +428,25 @@ private:
 
 			m_uas->tf2_broadcaster.sendTransform(transform);
 		}
+	}
+
+	/* -*- callbacks -*- */
+
+	//! Target size marker, off the send path
+	void marker_cb(const ros::TimerEvent &event) {
+		if (lt_marker_pub.getNumSubscribers() == 0)
+			return;
 
 		auto tg_size_msg = boost::make_shared<geometry_msgs::Vector3Stamped>();
 		Eigen::Vector3d target_size(target_size_x, target_size_y, 0.0);
 
+		tg_size_msg->header.stamp = event.current_real;
+		tg_size_msg->header.frame_id = frame_id;
 		tf::vectorEigenToMsg(target_size, tg_size_msg->vector);
 
 		lt_marker_pub.publish(tg_size_msg);
 	}
 
-	/* -*- callbacks -*- */
 	/**
 	 * @brief callback for TF2 listener
 	 */
@@ -1,6 +1,16 @@
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #include <mavros/mavros_plugin.h>
 #include <mavros_msgs/msg/LogData.hpp>
+#include <mavros_msgs/msg/LogDownload.hpp>
 #include <mavros_msgs/msg/LogEntry.hpp>
+#include <mavros_msgs/msg/LogProgress.hpp>
 #include <mavros_msgs/msg/LogRequestData.hpp>
 #include <mavros_msgs/msg/LogRequestEnd.hpp>
 #include <mavros_msgs/msg/LogRequestList.hpp>
@@ -10,7 +20,16 @@ namespace extra_plugins {
 class LogTransferPlugin : public plugin::PluginBase {
 public:
 	LogTransferPlugin() :
-		nh("~log_transfer") {}
+		nh("~log_transfer"),
+		dl_active(false),
+		dl_fd(-1),
+		dl_id(0),
+		dl_size(0),
+		dl_received(0),
+		dl_first_missing(0),
+		dl_retries(0),
+		dl_reported(0)
+	{ }
 
 	void initialize(UAS& uas) override
 	{
@@ -25,6 +44,13 @@ public:
 					&LogTransferPlugin::log_request_data_cb, this);
 		log_request_end_srv = nh.advertiseService("raw/log_request_end",
 					&LogTransferPlugin::log_request_end_cb, this);
+
+		progress_pub = nh.advertise<mavros_msgs::LogProgress>("download_progress", 10);
+		download_srv = nh.advertiseService("download",
+					&LogTransferPlugin::download_cb, this);
+
+		download_timer = nh.createTimer(ros::Duration(TICK_DT), &LogTransferPlugin::download_timer_cb, this);
+		download_timer.stop();
 	}
 
 	Subscriptions get_subscriptions() override
@@ -36,12 +62,44 @@ public:
 	}
 
 private:
+	//! LOG_DATA payload, logs are requested from 0 so chunks are aligned to it
+	static constexpr size_t CHUNK_SIZE = 90;
+	//! Gaps are re-requested after that long without data [s]
+	static constexpr double STALL_DT = 0.5;
+	static constexpr double TICK_DT = 0.1;
+	static constexpr double PROGRESS_DT = 1.0;
+	//! Re-requests without any new data until download fails
+	static constexpr int RETRIES_COUNT = 5;
+
 	ros::NodeHandle nh;
-	ros::Publisher log_entry_pub, log_data_pub;
-	ros::ServiceServer log_request_list_srv, log_request_data_srv, log_request_end_srv;
+	ros::Publisher log_entry_pub, log_data_pub, progress_pub;
+	ros::ServiceServer log_request_list_srv, log_request_data_srv, log_request_end_srv, download_srv;
+	ros::Timer download_timer;
+
+	//! log sizes from LOG_ENTRY
+	std::unordered_map<uint16_t, uint32_t> log_sizes;
+
+	// log download to file, data is written by offset as it comes
+	std::mutex dl_mutex;
+	bool dl_active;
+	int dl_fd;
+	uint16_t dl_id;
+	size_t dl_size;
+	std::vector<bool> dl_chunks;		//!< received chunks bitmap
+	size_t dl_received;			//!< chunks received
+	size_t dl_first_missing;		//!< no gaps below
+	int dl_retries;
+	ros::Time dl_last_rx;
+	ros::Time dl_last_report;
+	size_t dl_reported;			//!< bytes at dl_last_report
 
 	void handle_log_entry(const mavlink::mavlink_message_t*, mavlink::common::msg::LOG_ENTRY& le)
 	{
+		{
+			std::lock_guard<std::mutex> lock(dl_mutex);
+			log_sizes[le.id] = le.size;
+		}
+
 		auto msg = boost::make_shared<mavros_msgs::LogEntry>();
 		msg->header.stamp = ros::Time::now();
 		msg->id = le.id;
@@ -54,6 +112,14 @@ private:
 
 	void handle_log_data(const mavlink::mavlink_message_t*, mavlink::common::msg::LOG_DATA& ld)
 	{
+		{
+			std::lock_guard<std::mutex> lock(dl_mutex);
+			if (dl_active && ld.id == dl_id) {
+				download_store(ld);
+				return;
+			}
+		}
+
 		auto msg = boost::make_shared<mavros_msgs::LogData>();
 		msg->header.stamp = ros::Time::now();
 		msg->id = ld.id;
@@ -67,6 +133,202 @@ private:
 		log_data_pub.publish(msg);
 	}
 
+	/* -*- download -*- */
+
+	void download_store(mavlink::common::msg::LOG_DATA &ld)
+	{
+		size_t idx = ld.ofs / CHUNK_SIZE;
+		if (ld.ofs % CHUNK_SIZE != 0 || idx >= dl_chunks.size())
+			return;
+
+		dl_last_rx = ros::Time::now();
+		if (dl_chunks[idx])
+			return;
+
+		size_t count = std::min<size_t>({ld.count, ld.data.size(), dl_size - ld.ofs});
+		if (count == 0) {
+			// log is shorter than in LOG_ENTRY
+			download_truncate(ld.ofs);
+			return;
+		}
+
+		if (::pwrite(dl_fd, ld.data.data(), count, ld.ofs) != ssize_t(count)) {
+			ROS_ERROR_NAMED("log_transfer", "LT: write failed: %s", strerror(errno));
+			download_end(false);
+			return;
+		}
+
+		dl_chunks[idx] = true;
+		dl_received++;
+		dl_retries = RETRIES_COUNT;
+
+		if (dl_received == dl_chunks.size())
+			download_end(true);
+	}
+
+	//! FCU reported end of log at @a ofs
+	void download_truncate(uint32_t ofs)
+	{
+		dl_size = ofs;
+		dl_chunks.resize((ofs + CHUNK_SIZE - 1) / CHUNK_SIZE);
+		dl_received = std::count(dl_chunks.begin(), dl_chunks.end(), true);
+		dl_first_missing = std::min(dl_first_missing, dl_chunks.size());
+
+		if (::ftruncate(dl_fd, ofs) != 0)
+			ROS_WARN_NAMED("log_transfer", "LT: truncate failed: %s", strerror(errno));
+
+		if (dl_received == dl_chunks.size())
+			download_end(true);
+	}
+
+	void send_request_data(uint16_t id, uint32_t ofs, uint32_t count)
+	{
+		mavlink::common::msg::LOG_REQUEST_DATA msg;
+		m_uas->msg_set_target(msg);
+		msg.id = id;
+		msg.ofs = ofs;
+		msg.count = count;
+
+		UAS_FCU(m_uas)->send_message_ignore_drop(msg);
+	}
+
+	void send_request_end()
+	{
+		mavlink::common::msg::LOG_REQUEST_END msg;
+		m_uas->msg_set_target(msg);
+
+		UAS_FCU(m_uas)->send_message_ignore_drop(msg);
+	}
+
+	/**
+	 * @brief Request first gap as one LOG_REQUEST_DATA
+	 *
+	 * FCU serves one request at a time, next request replaces streaming one.
+	 */
+	void request_next_gap()
+	{
+		while (dl_first_missing < dl_chunks.size() && dl_chunks[dl_first_missing])
+			dl_first_missing++;
+
+		size_t end = dl_first_missing;
+		while (end < dl_chunks.size() && !dl_chunks[end])
+			end++;
+
+		// last gap: ask for the rest, log may be longer than in LOG_ENTRY
+		uint32_t count = (end == dl_chunks.size()) ? UINT32_MAX : (end - dl_first_missing) * CHUNK_SIZE;
+
+		ROS_DEBUG_NAMED("log_transfer", "LT: request %u: ofs %zu count %u",
+				dl_id, dl_first_missing * CHUNK_SIZE, count);
+		send_request_data(dl_id, dl_first_missing * CHUNK_SIZE, count);
+		dl_last_rx = ros::Time::now();
+	}
+
+	void publish_progress(uint8_t state)
+	{
+		auto now = ros::Time::now();
+		size_t transferred = std::min(dl_received * CHUNK_SIZE, dl_size);
+		double dt = (now - dl_last_report).toSec();
+
+		auto msg = boost::make_shared<mavros_msgs::LogProgress>();
+		msg->header.stamp = now;
+		msg->id = dl_id;
+		msg->size = dl_size;
+		msg->transferred = transferred;
+		msg->rate = (dt > 0.0) ? (transferred - dl_reported) / dt : 0.0;
+		msg->state = state;
+		progress_pub.publish(msg);
+
+		dl_last_report = now;
+		dl_reported = transferred;
+	}
+
+	void download_end(bool success)
+	{
+		if (success)
+			ROS_INFO_NAMED("log_transfer", "LT: log %u downloaded, %zu bytes", dl_id, dl_size);
+		else
+			ROS_ERROR_NAMED("log_transfer", "LT: log %u download failed", dl_id);
+
+		send_request_end();
+		publish_progress(success ? mavros_msgs::LogProgress::STATE_DONE : mavros_msgs::LogProgress::STATE_FAILED);
+
+		::close(dl_fd);
+		dl_fd = -1;
+		dl_active = false;
+		dl_chunks.clear();
+		download_timer.stop();
+	}
+
+	void download_timer_cb(const ros::TimerEvent &event)
+	{
+		std::lock_guard<std::mutex> lock(dl_mutex);
+		if (!dl_active)
+			return;
+
+		auto now = ros::Time::now();
+		if ((now - dl_last_report).toSec() >= PROGRESS_DT)
+			publish_progress(mavros_msgs::LogProgress::STATE_ACTIVE);
+
+		if ((now - dl_last_rx).toSec() < STALL_DT)
+			return;
+
+		if (dl_retries-- <= 0) {
+			download_end(false);
+			return;
+		}
+
+		request_next_gap();
+	}
+
+	bool download_cb(mavros_msgs::LogDownload::Request &req,
+				mavros_msgs::LogDownload::Response &res)
+	{
+		std::lock_guard<std::mutex> lock(dl_mutex);
+
+		// previous download is replaced
+		if (dl_active)
+			download_end(false);
+
+		res.success = req.local_path.empty();
+		if (res.success)
+			return true;
+
+		size_t size = req.size;
+		if (size == 0) {
+			auto it = log_sizes.find(req.id);
+			if (it == log_sizes.end() || it->second == 0) {
+				ROS_ERROR_NAMED("log_transfer", "LT: log %u size unknown, request list first", req.id);
+				return true;
+			}
+			size = it->second;
+		}
+
+		dl_fd = ::open(req.local_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (dl_fd < 0) {
+			ROS_ERROR_NAMED("log_transfer", "LT: %s: %s", req.local_path.c_str(), strerror(errno));
+			return true;
+		}
+
+		dl_active = true;
+		dl_id = req.id;
+		dl_size = size;
+		dl_chunks.assign((size + CHUNK_SIZE - 1) / CHUNK_SIZE, false);
+		dl_received = 0;
+		dl_first_missing = 0;
+		dl_retries = RETRIES_COUNT;
+		dl_last_report = ros::Time::now();
+		dl_reported = 0;
+
+		ROS_INFO_NAMED("log_transfer", "LT: downloading log %u, %zu bytes to %s",
+				dl_id, dl_size, req.local_path.c_str());
+
+		request_next_gap();
+		download_timer.start();
+
+		res.success = true;
+		return true;
+	}
+
 	bool log_request_list_cb(mavros_msgs::LogRequestList::Request &req,
 				mavros_msgs::LogRequestList::Response &res)
 	{
@@ -116,6 +378,12 @@ private:
 		return true;
 	}
 };
+
+constexpr size_t LogTransferPlugin::CHUNK_SIZE;
+constexpr double LogTransferPlugin::STALL_DT;
+constexpr double LogTransferPlugin::TICK_DT;
+constexpr double LogTransferPlugin::PROGRESS_DT;
+constexpr int LogTransferPlugin::RETRIES_COUNT;
 }	// namespace extra_plugins
 }	// namespace mavros
 
@@ -15,8 +15,11 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <mutex>
 #include <mavros/mavros_plugin.h>
+#include <mavros/setpoint_streamer.h>
 #include <eigen_conversions/eigen_msg.h>
+#include <ros/callback_queue.h>
 
 #include <geometry_msgs/msg/PoseStamped.hpp>
 #include <geometry_msgs/msg/TransformStamped.hpp>
@@ -28,12 +31,18 @@ namespace extra_plugins{
  * @brief MocapPoseEstimate plugin
  *
  * Sends motion capture data to FCU.
+ *
+ * Samples may be handled by own spinner thread, so they do not wait in node
+ * callback queue. With @a rate set, only latest sample is sent at that rate
+ * by streamer thread, older ones are dropped.
  */
 class MocapPoseEstimatePlugin : public plugin::PluginBase
 {
 public:
 	MocapPoseEstimatePlugin() : PluginBase(),
-		mp_nh("~mocap")
+		mp_nh("~mocap"),
+		stream_rate(0.0),
+		have_sample(false)
 	{ }
 
 	void initialize(UAS &uas_)
@@ -49,14 +58,45 @@ public:
 		/** @note For Optitrack ROS package, subscribe to PoseStamped topic */
 		mp_nh.param("use_pose", use_pose, true);
 
+		bool tcp_nodelay, own_thread;
+		double stale_timeout;
+
+		// latency params
+		mp_nh.param("rate", stream_rate, 0.0);
+		mp_nh.param("timeout", stale_timeout, 0.1);
+		mp_nh.param("tcp_nodelay", tcp_nodelay, true);
+		mp_nh.param("own_thread", own_thread, true);
+
+		ros::TransportHints hints;
+		if (tcp_nodelay)
+			hints.tcpNoDelay();
+
+		if (own_thread)
+			mp_nh.setCallbackQueue(&mocap_queue);
+
 		if (use_tf && !use_pose) {
-			mocap_tf_sub = mp_nh.subscribe("tf", 1, &MocapPoseEstimatePlugin::mocap_tf_cb, this);
+			mocap_tf_sub = mp_nh.subscribe("tf", 1, &MocapPoseEstimatePlugin::mocap_tf_cb, this, hints);
 		}
 		else if (use_pose && !use_tf) {
-			mocap_pose_sub = mp_nh.subscribe("pose", 1, &MocapPoseEstimatePlugin::mocap_pose_cb, this);
+			mocap_pose_sub = mp_nh.subscribe("pose", 1, &MocapPoseEstimatePlugin::mocap_pose_cb, this, hints);
 		}
 		else {
 			ROS_ERROR_NAMED("mocap", "Use one motion capture source.");
+			return;
+		}
+
+		if (own_thread) {
+			mocap_spinner.reset(new ros::AsyncSpinner(1, &mocap_queue));
+			mocap_spinner->start();
+		}
+
+		if (stream_rate > 0.0) {
+			auto period = std::chrono::duration<double>(1.0 / stream_rate);
+			auto timeout = std::chrono::duration<double>(stale_timeout);
+
+			streamer.start(std::chrono::duration_cast<SetpointStreamer::clock::duration>(period),
+					std::chrono::duration_cast<SetpointStreamer::clock::duration>(timeout),
+					std::bind(&MocapPoseEstimatePlugin::stream_tick, this, std::placeholders::_1));
 		}
 	}
 
@@ -68,9 +108,36 @@ public:
 private:
 	ros::NodeHandle mp_nh;
 
+	// declaration order matters: spinner and streamer threads are stopped first,
+	// subscribers are shut down before their queue goes away
+	ros::CallbackQueue mocap_queue;
 	ros::Subscriber mocap_pose_sub;
 	ros::Subscriber mocap_tf_sub;
 
+	double stream_rate;		//!< [Hz] 0 - send each sample
+	std::mutex sample_mutex;
+	mavlink::common::msg::ATT_POS_MOCAP last_sample;
+	bool have_sample;		//!< last_sample not sent yet
+
+	SetpointStreamer streamer;
+	std::unique_ptr<ros::AsyncSpinner> mocap_spinner;
+
+	//! Send latest sample once, nothing if it is older than timeout
+	void stream_tick(bool stale)
+	{
+		mavlink::common::msg::ATT_POS_MOCAP pos;
+		{
+			std::lock_guard<std::mutex> lock(sample_mutex);
+			if (!have_sample || stale)
+				return;
+
+			pos = last_sample;
+			have_sample = false;
+		}
+
+		UAS_FCU(m_uas)->send_message_ignore_drop(pos);
+	}
+
 	/* -*- low-level send -*- */
 	void mocap_pose_send
 		(uint64_t usec,
@@ -85,6 +152,17 @@ private:
 		pos.y = v.y();
 		pos.z = v.z();
 
+		if (streamer.is_running()) {
+			{
+				std::lock_guard<std::mutex> lock(sample_mutex);
+				last_sample = pos;
+				have_sample = true;
+			}
+
+			streamer.update();
+			return;
+		}
+
 		UAS_FCU(m_uas)->send_message_ignore_drop(pos);
 	}
 
@@ -14,9 +14,13 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.mdA
  */
 
+#include <limits>
+#include <unordered_map>
 #include <mavros/mavros_plugin.h>
 
 #include <sensor_msgs/msg/LaserScan.hpp>
+#include <sensor_msgs/msg/PointCloud2.hpp>
+#include <sensor_msgs/point_cloud2_iterator.hpp>
 
 namespace mavros {
 namespace extra_plugins {
@@ -24,25 +28,39 @@ namespace extra_plugins {
 static constexpr double RAD_TO_DEG = 180.0 / M_PI;
 //! Mavlink MAV_DISTANCE_SENSOR enumeration
 using mavlink::common::MAV_DISTANCE_SENSOR;
+using mavlink::common::MAV_FRAME;
 
 /**
  * @brief Obstacle distance plugin
  *
  * Publishes obstacle distance array to the FCU, in order to assist in an obstacle
  * avoidance flight.
+ * Point clouds are voxel filtered and nearest voxels are sent as separate obstacles.
  * @see obstacle_cb()
+ * @see cloud_cb()
  */
 class ObstacleDistancePlugin : public plugin::PluginBase {
 public:
 	ObstacleDistancePlugin() : PluginBase(),
-		obstacle_nh("~obstacle")
+		obstacle_nh("~obstacle"),
+		voxel_size(0.5),
+		max_obstacles(20),
+		range_min(0.1),
+		range_max(30.0)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
 
+		// point cloud params
+		obstacle_nh.param("cloud/voxel_size", voxel_size, 0.5);
+		obstacle_nh.param("cloud/max_obstacles", max_obstacles, 20);
+		obstacle_nh.param("cloud/range_min", range_min, 0.1);
+		obstacle_nh.param("cloud/range_max", range_max, 30.0);
+
 		obstacle_sub = obstacle_nh.subscribe("send", 10, &ObstacleDistancePlugin::obstacle_cb, this);
+		cloud_sub = obstacle_nh.subscribe("send_3d", 2, &ObstacleDistancePlugin::cloud_cb, this);
 	}
 
 	Subscriptions get_subscriptions()
@@ -53,6 +71,61 @@ public:
 private:
 	ros::NodeHandle obstacle_nh;
 	ros::Subscriber obstacle_sub;
+	ros::Subscriber cloud_sub;
+
+	double voxel_size;		//!< [m]
+	int max_obstacles;		//!< OBSTACLE_DISTANCE_3D per cloud
+	double range_min;		//!< [m]
+	double range_max;
+
+	//! scale x bins ranges [cm], reused between scans
+	Eigen::ArrayXXf bin_buffer;
+
+	struct Voxel {
+		Eigen::Vector3f point;	//!< nearest point in voxel
+		float distance;
+	};
+
+	//! reused between clouds, so buckets are not reallocated
+	std::unordered_map<uint64_t, Voxel> voxels;
+	std::vector<Voxel> nearest;
+
+	/**
+	 * @brief Reduce ranges to bins of @a scale adjacent ranges, shortest wins.
+	 *
+	 * Ranges mapped to [cm], invalid ones to UINT16_MAX, then columns of
+	 * (scale x bins) buffer are min reduced, both steps are vectorized by Eigen.
+	 *
+	 * @param ranges      [m]
+	 * @param zero_valid  zero range is valid, otherwise it is unknown
+	 */
+	template<size_t N>
+	void bin_ranges(const std::vector<float> &ranges, size_t scale, bool zero_valid, std::array<uint16_t, N> &bins)
+	{
+		const size_t count = std::min(ranges.size(), scale * N);
+		const float lower = (zero_valid) ? 0.0f : std::numeric_limits<float>::denorm_min();
+
+		bin_buffer.setConstant(scale, N, UINT16_MAX);
+
+		Eigen::Map<const Eigen::ArrayXf> range(ranges.data(), count);
+		Eigen::Map<Eigen::ArrayXf> cm(bin_buffer.data(), count);
+
+		// NaN fails both compares
+		cm = range * 1e2f;
+		cm = (cm >= lower && cm < float(UINT16_MAX)).select(cm, float(UINT16_MAX));
+
+		Eigen::Map<Eigen::Array<uint16_t, 1, N> >(bins.data()) = bin_buffer.colwise().minCoeff().template cast<uint16_t>();
+	}
+
+	//! Pack voxel index, 21 bit per axis is enough within range_max
+	static uint64_t voxel_key(const Eigen::Vector3f &p, float size)
+	{
+		auto idx = [size](float v) {
+				   return uint64_t(int64_t(std::floor(v / size)) & 0x1fffff);
+			   };
+
+		return (idx(p.x()) << 42) | (idx(p.y()) << 21) | idx(p.z());
+	}
 
 	/**
 	 * @brief Send obstacle distance array to the FCU.
@@ -65,32 +138,14 @@ private:
 		mavlink::common::msg::OBSTACLE_DISTANCE obstacle {};
 
 		if (req->ranges.size() <= obstacle.distances.size()) {
-			// all distances from sensor will fit in obstacle distance message
-			for (int i = 0; i < req->ranges.size(); i++) {
-				float distance_cm = req->ranges[i] * 1e2;
-				if (std::isnan(distance_cm) || distance_cm >= UINT16_MAX || distance_cm < 0) {
-					obstacle.distances[i] = UINT16_MAX;
-				} else {
-					obstacle.distances[i] = static_cast<uint16_t>(distance_cm);
-				}
-			}
-			std::fill(obstacle.distances.begin() + req->ranges.size(), obstacle.distances.end(), UINT16_MAX);	//!< fill the rest of the array values as "Unknown"
+			// all distances from sensor will fit in obstacle distance message,
+			// the rest of the array values are "Unknown"
+			bin_ranges(req->ranges, 1, true, obstacle.distances);
 			obstacle.increment = req->angle_increment * RAD_TO_DEG;				//!< [degrees]
 		} else {
 			// all distances from sensor will not fit so we combine adjacent distances always taking the shortest distance
 			size_t scale_factor = ceil(double(req->ranges.size()) / obstacle.distances.size());
-			for (size_t i = 0; i < obstacle.distances.size(); i++) {
-				obstacle.distances[i] = UINT16_MAX;
-				for (size_t j = 0; j < scale_factor; j++) {
-					size_t req_index = i * scale_factor + j;
-					if (req_index < req->ranges.size()) {
-						float distance_cm = req->ranges[req_index] * 1e2;
-						if (!std::isnan(distance_cm) && distance_cm < UINT16_MAX && distance_cm > 0) {
-							obstacle.distances[i] = std::min(obstacle.distances[i], static_cast<uint16_t>(distance_cm));
-						}
-					}
-				}
-			}
+			bin_ranges(req->ranges, scale_factor, false, obstacle.distances);
 			obstacle.increment = ceil(req->angle_increment * RAD_TO_DEG * scale_factor);	//!< [degrees]
 		}
 
@@ -104,6 +159,71 @@ private:
 
 		UAS_FCU(m_uas)->send_message_ignore_drop(obstacle);
 	}
+
+	/**
+	 * @brief Send nearest obstacles of point cloud to the FCU.
+	 *
+	 * Points are expected in base_link frame. Only nearest point of each voxel
+	 * is kept, then up to max_obstacles nearest voxels are sent.
+	 *
+	 * Message specification: https://mavlink.io/en/messages/ardupilotmega.html#OBSTACLE_DISTANCE_3D
+	 * @param req	received PointCloud2 msg
+	 */
+	void cloud_cb(const sensor_msgs::PointCloud2::ConstPtr &req)
+	{
+		if (max_obstacles <= 0 || voxel_size <= 0.0)
+			return;
+
+		voxels.clear();
+
+		sensor_msgs::PointCloud2ConstIterator<float> it_x(*req, "x");
+		sensor_msgs::PointCloud2ConstIterator<float> it_y(*req, "y");
+		sensor_msgs::PointCloud2ConstIterator<float> it_z(*req, "z");
+
+		for (; it_x != it_x.end(); ++it_x, ++it_y, ++it_z) {
+			Eigen::Vector3f point(*it_x, *it_y, *it_z);
+			float distance = point.norm();
+
+			// also drops NaN points
+			if (!(distance >= range_min && distance <= range_max))
+				continue;
+
+			auto res = voxels.emplace(voxel_key(point, voxel_size), Voxel{point, distance});
+			if (!res.second && distance < res.first->second.distance)
+				res.first->second = Voxel{point, distance};
+		}
+
+		nearest.clear();
+		for (auto &kv : voxels)
+			nearest.push_back(kv.second);
+
+		auto budget = std::min<size_t>(nearest.size(), max_obstacles);
+		auto by_distance = [](const Voxel &a, const Voxel &b) {
+					   return a.distance < b.distance;
+				   };
+		std::partial_sort(nearest.begin(), nearest.begin() + budget, nearest.end(), by_distance);
+
+		mavlink::ardupilotmega::msg::OBSTACLE_DISTANCE_3D obstacle {};
+		obstacle.time_boot_ms = req->header.stamp.toNSec() / 1000000;		//!< [millisecs]
+		obstacle.sensor_type = utils::enum_value(MAV_DISTANCE_SENSOR::LASER);
+		obstacle.frame = utils::enum_value(MAV_FRAME::BODY_FRD);
+		obstacle.obstacle_id = UINT16_MAX;					//!< not tracked
+		obstacle.min_distance = range_min;					//!< [meters]
+		obstacle.max_distance = range_max;					//!< [meters]
+
+		for (size_t i = 0; i < budget; i++) {
+			auto frd = ftf::transform_frame_baselink_aircraft(nearest[i].point.cast<double>().eval());
+
+			obstacle.x = frd.x();
+			obstacle.y = frd.y();
+			obstacle.z = frd.z();
+
+			UAS_FCU(m_uas)->send_message_ignore_drop(obstacle);
+		}
+
+		ROS_DEBUG_NAMED("obstacle_distance", "OBSDIST3D: %zu points, %zu voxels, sent %zu",
+				size_t(req->width) * req->height, voxels.size(), budget);
+	}
 };
 }	// namespace extra_plugins
 }	// namespace mavros
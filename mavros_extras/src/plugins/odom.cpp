@@ -16,6 +16,7 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <chrono>
 #include <mavros/mavros_plugin.h>
 #include <tf2_eigen/tf2_eigen.h>
 #include <boost/algorithm/string.hpp>
@@ -32,11 +33,14 @@ using Matrix6d = Eigen::Matrix<double, 6, 6, Eigen::RowMajor>;
  * @brief Odometry plugin
  *
  * Sends odometry data to the FCU position and attitude estimators.
+ *
+ * Frame rotations are looked up once and cached until /tf_static changes
+ * or cache TTL expires.
  * @see odom_cb()
  */
 class OdometryPlugin : public plugin::PluginBase {
 public:
-	EIGEN_MAKE_ALIGNED_OPERATOR_NEW 	// XXX(vooon): added to try to fix #1223. Not sure that it is needed because class do not have Eigen:: fields.
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW 	// XXX(vooon): added to try to fix #1223. Now needed for FrameCache fields.
 
 	OdometryPlugin() : PluginBase(),
 		odom_nh("~odometry"),
@@ -45,7 +49,8 @@ public:
 		child_frame_id("base_link"),
 		frame_id("odom"),
 		local_frame_in("local_origin_ned"),
-		local_frame_out("vision_ned")
+		local_frame_out("vision_ned"),
+		tf_cache_ttl(1.0)
 	{ }
 
 	void initialize(UAS &uas_)
@@ -61,6 +66,9 @@ public:
 		odom_nh.param<std::string>("in/frame_tf/body_frame_orientation", body_frame_orientation_in_desired, "flu");
 		odom_nh.param<std::string>("out/frame_tf/body_frame_orientation", body_frame_orientation_out_desired, "frd");
 
+		// 0 - lookup on each message
+		odom_nh.param("frame_tf/cache_ttl", tf_cache_ttl, 1.0);
+
 		boost::algorithm::to_lower(local_frame_out);
 		boost::algorithm::to_lower(body_frame_orientation_out_desired);
 
@@ -154,24 +162,59 @@ private:
 	MAV_FRAME lf_id;				//!< local frame (pose) ID
 	MAV_FRAME bf_id;				//!< body frame (pose) ID
 
+	//! Rotations derived from looked up transforms
+	struct FrameCache {
+		std::string frame_id;
+		std::string child_frame_id;
+		bool valid = false;
+		uint64_t static_generation = 0;
+		std::chrono::steady_clock::time_point expires;
+
+		Eigen::Matrix3d parent2local;		//!< position, parent in local frame
+		Eigen::Matrix3d child2body_inv;		//!< applied after orientation
+		Eigen::Matrix3d child2local;		//!< velocity, child in local frame
+		Eigen::Matrix3d child2body;		//!< velocity, child in body frame
+		Matrix6d r_pose;			//!< pose covariance rotation
+		Matrix6d r_vel_local;			//!< twist covariance rotations
+		Matrix6d r_vel_body;
+	};
+
+	double tf_cache_ttl;				//!< [sec]
+	FrameCache cache_in;				//!< handle_odom(), FCU to ROS
+	FrameCache cache_out;				//!< odom_cb(), ROS to FCU
+
+	static Matrix6d block_rotation(const Eigen::Matrix3d &r)
+	{
+		Matrix6d out = Matrix6d::Zero();
+		out.block<3, 3>(0, 0) = out.block<3, 3>(3, 3) = r;
+		return out;
+	}
+
 	/**
-	 * @brief Lookup transforms
+	 * @brief Lookup transforms, if cached ones are not valid
 	 * @todo Implement in a more general fashion in the API IOT apply frame transforms
-	 * This should also run in parallel on a thread
+	 * @param[in,out] &cache Rotations for that frame pair
 	 * @param[in] &frame_id The parent frame of reference
 	 * @param[in] &child_frame_id The child frame of reference
 	 * @param[in] &local_frame_orientation The desired local frame orientation
 	 * @param[in] &body_frame_orientation The desired body frame orientation
-	 * @param[in,out] &tf_parent2local The affine transform from the parent frame to the local frame
-	 * @param[in,out] &tf_child2local The affine transform from the child frame to the local frame
-	 * @param[in,out] &tf_parent2body The affine transform from the parent frame to the body frame
-	 * @param[in,out] &tf_child2body The affine transform from the child frame to the body frame
+	 * @return false if lookup failed
 	 */
-	void transform_lookup(const std::string &frame_id, const std::string &child_frame_id,
-		const std::string &local_frame_orientation, const std::string &body_frame_orientation,
-		Eigen::Affine3d &tf_parent2local, Eigen::Affine3d &tf_child2local,
-		Eigen::Affine3d &tf_parent2body, Eigen::Affine3d &tf_child2body)
+	bool transform_lookup(FrameCache &cache, const std::string &frame_id, const std::string &child_frame_id,
+		const std::string &local_frame_orientation, const std::string &body_frame_orientation)
 	{
+		auto now = std::chrono::steady_clock::now();
+		auto generation = m_uas->tf2_dispatcher.get_static_generation();
+
+		if (cache.valid && now < cache.expires && cache.static_generation == generation
+				&& cache.frame_id == frame_id && cache.child_frame_id == child_frame_id)
+			return true;
+
+		Eigen::Affine3d tf_parent2local;
+		Eigen::Affine3d tf_child2local;
+		Eigen::Affine3d tf_parent2body;
+		Eigen::Affine3d tf_child2body;
+
 		try {
 			// transform lookup WRT local frame
 			tf_parent2local = tf2::transformToEigen(m_uas->tf2_buffer.lookupTransform(
@@ -190,8 +233,26 @@ private:
 				ros::Time(0)));
 		} catch (tf2::TransformException &ex) {
 			ROS_ERROR_THROTTLE_NAMED(1, "odom", "ODOM: Ex: %s", ex.what());
-			return;
+			cache.valid = false;
+			return false;
 		}
+
+		cache.frame_id = frame_id;
+		cache.child_frame_id = child_frame_id;
+		cache.static_generation = generation;
+		cache.expires = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double>(tf_cache_ttl));
+		cache.valid = true;
+
+		cache.parent2local = tf_parent2local.linear();
+		cache.child2body_inv = tf_child2body.linear().inverse();
+		cache.child2local = tf_child2local.linear();
+		cache.child2body = tf_child2body.linear();
+		cache.r_pose = block_rotation(cache.parent2local);
+		cache.r_vel_local = block_rotation(cache.child2local);
+		cache.r_vel_body = block_rotation(cache.child2body);
+
+		return true;
 	}
 
 	/**
@@ -215,18 +276,10 @@ private:
 		m_uas->tf2_broadcaster.sendTransform(transform);
 		/***************************************************/
 
-		/**
-		 * Required affine rotations to apply transforms
-		 */
-		Eigen::Affine3d tf_parent2local;
-		Eigen::Affine3d tf_child2local;
-		Eigen::Affine3d tf_parent2body;
-		Eigen::Affine3d tf_child2body;
-
 		//! Lookup to the required trans
-		transform_lookup("local_origin_ned", "fcu_frd",
-			local_frame_orientation_in, body_frame_orientation_in_desired,
-			tf_parent2local, tf_child2local, tf_parent2body, tf_child2body);
+		if (!transform_lookup(cache_in, "local_origin_ned", "fcu_frd",
+				local_frame_orientation_in, body_frame_orientation_in_desired))
+			return;
 
 		//! Build 6x6 pose covariance matrix to be transformed and sent
 		Matrix6d cov_pose = Matrix6d::Zero();
@@ -240,8 +293,7 @@ private:
 		Eigen::Quaterniond orientation {};	//!< Attitude quaternion. WRT frame_id
 		Eigen::Vector3d lin_vel {};		//!< Linear velocity vector. WRT child_frame_id
 		Eigen::Vector3d ang_vel {};		//!< Angular velocity vector. WRT child_frame_id
-		Matrix6d r_pose = Matrix6d::Zero();	//!< Zero initialized pose 6-D Covariance matrix. WRT frame_id
-		Matrix6d r_vel = Matrix6d::Zero();	//!< Zero initialized velocity 6-D Covariance matrix. WRT child_frame_id
+		const Matrix6d *r_vel = nullptr;	//!< velocity 6-D Covariance rotation. WRT child_frame_id
 
 		auto odom = boost::make_shared<nav_msgs::Odometry>();
 
@@ -251,36 +303,33 @@ private:
 		/**
 		 * Position parsing
 		 */
-		position = Eigen::Vector3d(tf_parent2local.linear() * Eigen::Vector3d(odom_msg.x, odom_msg.y, odom_msg.z));
+		position = cache_in.parent2local * Eigen::Vector3d(odom_msg.x, odom_msg.y, odom_msg.z);
 		tf::pointEigenToMsg(position, odom->pose.pose.position);
 
 		/**
 		 * Orientation parsing
 		 */
 		Eigen::Quaterniond q_parent2child(ftf::mavlink_to_quaternion(odom_msg.q));
-		Eigen::Affine3d tf_local2body = tf_parent2local * q_parent2child * tf_child2body.inverse();
-		orientation = Eigen::Quaterniond(tf_local2body.linear());
+		orientation = Eigen::Quaterniond(cache_in.parent2local * q_parent2child.toRotationMatrix() * cache_in.child2body_inv);
 		tf::quaternionEigenToMsg(orientation, odom->pose.pose.orientation);
 
-		r_pose.block<3, 3>(0, 0) = r_pose.block<3, 3>(3, 3) = tf_parent2local.linear();
-
 		/**
 		 * Velocities parsing
 		 * Linear and angular velocities are in the same frame as child_frame_id.
 		 */
-		auto set_tf = [&](Eigen::Affine3d affineTf) {
-				lin_vel = Eigen::Vector3d(affineTf.linear() * Eigen::Vector3d(odom_msg.vx, odom_msg.vy, odom_msg.vz));
-				ang_vel = Eigen::Vector3d(affineTf.linear() * Eigen::Vector3d(odom_msg.rollspeed, odom_msg.pitchspeed, odom_msg.yawspeed));
-				r_vel.block<3, 3>(0, 0) = r_vel.block<3, 3>(3, 3) = affineTf.linear();
+		auto set_tf = [&](const Eigen::Matrix3d &r, const Matrix6d &r_cov) {
+				lin_vel = r * Eigen::Vector3d(odom_msg.vx, odom_msg.vy, odom_msg.vz);
+				ang_vel = r * Eigen::Vector3d(odom_msg.rollspeed, odom_msg.pitchspeed, odom_msg.yawspeed);
+				r_vel = &r_cov;
 			};
 
 		if (odom_msg.child_frame_id == odom_msg.frame_id) {
 			// the child_frame_id would be the same reference frame as frame_id
-			set_tf(tf_child2local);
+			set_tf(cache_in.child2local, cache_in.r_vel_local);
 		}
 		else {
 			// the child_frame_id would be the WRT a body frame reference
-			set_tf(tf_child2body);
+			set_tf(cache_in.child2body, cache_in.r_vel_body);
 		}
 
 		tf::vectorEigenToMsg(lin_vel, odom->twist.twist.linear);
@@ -290,11 +339,11 @@ private:
 		 * Covariances parsing
 		 */
 		//! Transform pose covariance matrix
-		cov_pose = r_pose * cov_pose * r_pose.transpose();
+		cov_pose = cache_in.r_pose * cov_pose * cache_in.r_pose.transpose();
 		Eigen::Map<Matrix6d>(odom->pose.covariance.data(), cov_pose.rows(), cov_pose.cols()) = cov_pose;
 
 		//! Transform twist covariance matrix
-		cov_vel = r_vel * cov_vel * r_vel.transpose();
+		cov_vel = *r_vel * cov_vel * r_vel->transpose();
 		Eigen::Map<Matrix6d>(odom->twist.covariance.data(), cov_vel.rows(), cov_vel.cols()) = cov_vel;
 
 		//! Publish the data
@@ -309,18 +358,10 @@ private:
 	 */
 	void odom_cb(const nav_msgs::Odometry::ConstPtr &odom)
 	{
-		/**
-		 * Required affine rotations to apply transforms
-		 */
-		Eigen::Affine3d tf_parent2local;
-		Eigen::Affine3d tf_child2local;
-		Eigen::Affine3d tf_parent2body;
-		Eigen::Affine3d tf_child2body;
-
-		//! Build 6x6 pose covariance matrix to be transformed and sent
-		transform_lookup(odom->header.frame_id, odom->child_frame_id,
-			local_frame_orientation_out, body_frame_orientation_out_desired,
-			tf_parent2local, tf_child2local, tf_parent2body, tf_child2body);
+		//! Lookup to the required trans
+		if (!transform_lookup(cache_out, odom->header.frame_id, odom->child_frame_id,
+				local_frame_orientation_out, body_frame_orientation_out_desired))
+			return;
 
 		//! Build 6x6 pose covariance matrix to be transformed and sent
 		ftf::Covariance6d cov_pose = odom->pose.covariance;
@@ -337,8 +378,7 @@ private:
 		Eigen::Quaterniond orientation {};	//!< Attitude quaternion. WRT frame_id
 		Eigen::Vector3d lin_vel {};		//!< Linear velocity vector. WRT child_frame_id
 		Eigen::Vector3d ang_vel {};		//!< Angular velocity vector. WRT child_frame_id
-		Matrix6d r_pose = Matrix6d::Zero();	//!< Zero initialized pose 6-D Covariance matrix. WRT frame_id
-		Matrix6d r_vel = Matrix6d::Zero();	//!< Zero initialized velocity 6-D Covariance matrix. WRT child_frame_id
+		const Matrix6d *r_vel = nullptr;	//!< velocity 6-D Covariance rotation. WRT child_frame_id
 
 		mavlink::common::msg::ODOMETRY msg {};
 
@@ -348,14 +388,11 @@ private:
 		 * enum values, the default frame_id will be a local frame of
 		 * reference, so the pose is WRT a local frame.
 		 */
-		position = Eigen::Vector3d(tf_parent2local.linear() * ftf::to_eigen(odom->pose.pose.position));
+		position = cache_out.parent2local * ftf::to_eigen(odom->pose.pose.position);
 
 		// Orientation represented by a quaternion rotation from the local frame to XYZ body frame
 		Eigen::Quaterniond q_parent2child(ftf::to_eigen(odom->pose.pose.orientation));
-		Eigen::Affine3d tf_local2body = tf_parent2local * q_parent2child * tf_child2body.inverse();
-		orientation = Eigen::Quaterniond(tf_local2body.linear());
-
-		r_pose.block<3, 3>(0, 0) = r_pose.block<3, 3>(3, 3) = tf_parent2local.linear();
+		orientation = Eigen::Quaterniond(cache_out.parent2local * q_parent2child.toRotationMatrix() * cache_out.child2body_inv);
 
 		msg.frame_id = utils::enum_value(lf_id);
 
@@ -363,26 +400,26 @@ private:
 		 * Linear and angular velocities are in the same frame as child_frame_id.
 		 * Same logic here applies as above.
 		 */
-		auto set_tf = [&](Eigen::Affine3d affineTf, MAV_FRAME frame_id) {
-				lin_vel = Eigen::Vector3d(affineTf.linear() * ftf::to_eigen(odom->twist.twist.linear));
-				ang_vel = Eigen::Vector3d(affineTf.linear() * ftf::to_eigen(odom->twist.twist.angular));
-				r_vel.block<3, 3>(0, 0) = r_vel.block<3, 3>(3, 3) = affineTf.linear();
+		auto set_tf = [&](const Eigen::Matrix3d &r, const Matrix6d &r_cov, MAV_FRAME frame_id) {
+				lin_vel = r * ftf::to_eigen(odom->twist.twist.linear);
+				ang_vel = r * ftf::to_eigen(odom->twist.twist.angular);
+				r_vel = &r_cov;
 
 				msg.child_frame_id = utils::enum_value(frame_id);
 			};
 
 		if (odom->child_frame_id == "world" || odom->child_frame_id == "odom") {
 			// the child_frame_id would be the same reference frame as frame_id
-			set_tf(tf_child2local, lf_id);
+			set_tf(cache_out.child2local, cache_out.r_vel_local, lf_id);
 		}
 		else {
 			// the child_frame_id would be the WRT a body frame reference
-			set_tf(tf_child2body, bf_id);
+			set_tf(cache_out.child2body, cache_out.r_vel_body, bf_id);
 		}
 
 		/** Apply covariance transforms */
-		cov_pose_map = r_pose * cov_pose_map * r_pose.transpose();
-		cov_vel_map  = r_vel  * cov_vel_map  * r_vel.transpose();
+		cov_pose_map = cache_out.r_pose * cov_pose_map * cache_out.r_pose.transpose();
+		cov_vel_map  = *r_vel * cov_vel_map * r_vel->transpose();
 
 		ROS_DEBUG_STREAM_NAMED("odom", "ODOM: output: pose covariance matrix:" << std::endl << cov_pose_map);
 		ROS_DEBUG_STREAM_NAMED("odom", "ODOM: output: velocity covariance matrix:" << std::endl << cov_vel_map);
@@ -14,22 +14,384 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/statvfs.h>
+
 #include <mavros/mavros_plugin.h>
 
 #include <mavros_msgs/msg/OnboardComputerStatus.hpp>
 
 namespace mavros {
 namespace extra_plugins {
+/**
+ * @brief /proc and /sys file kept open, re-read by pread() into fixed buffer
+ */
+class ProcFile {
+public:
+	static constexpr size_t BUF_SIZE = 8192;
+
+	explicit ProcFile(const std::string &path = "") :
+		fd(-1),
+		len(0)
+	{
+		if (!path.empty())
+			open(path);
+	}
+
+	~ProcFile() {
+		if (fd >= 0)
+			::close(fd);
+	}
+
+	ProcFile(const ProcFile &) = delete;
+	ProcFile(ProcFile &&other) :
+		fd(other.fd),
+		len(0)
+	{
+		other.fd = -1;
+	}
+
+	bool open(const std::string &path) {
+		fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		return fd >= 0;
+	}
+
+	inline bool is_open() const {
+		return fd >= 0;
+	}
+
+	//! @return null terminated content, nullptr on error
+	const char *read() {
+		if (fd < 0)
+			return nullptr;
+
+		// seq_file regenerates content on read from offset 0
+		ssize_t ret = ::pread(fd, buf.data(), buf.size() - 1, 0);
+		if (ret < 0)
+			return nullptr;
+
+		len = ret;
+		buf[len] = '\0';
+		return buf.data();
+	}
+
+	//! first number of the file, e.g. sysfs attribute
+	bool read_value(long long &value) {
+		auto p = read();
+		if (!p)
+			return false;
+
+		char *end;
+		value = std::strtoll(p, &end, 10);
+		return end != p;
+	}
+
+private:
+	int fd;
+	size_t len;
+	std::array<char, BUF_SIZE> buf;
+};
+
+/**
+ * @brief Fills ONBOARD_COMPUTER_STATUS from the running system.
+ *
+ * CPU load is sampled at 10 Hz, which gives 100 ms slices of cpu_combined,
+ * the rest is read when status is sent. Files are opened once,
+ * parsing works in place, so sampling does not allocate.
+ */
+class StatusSampler {
+public:
+	using Status = mavlink::common::msg::ONBOARD_COMPUTER_STATUS;
+
+	static constexpr size_t MAX_CORES = 8;	// sizes of ONBOARD_COMPUTER_STATUS arrays
+	static constexpr size_t MAX_TEMPS = 8;
+	static constexpr size_t MAX_STORAGE = 4;
+	static constexpr size_t MAX_LINKS = 6;
+	static constexpr size_t COMBINED_SLICES = 10;
+
+	StatusSampler() :
+		stat("/proc/stat"),
+		meminfo("/proc/meminfo"),
+		net_dev("/proc/net/dev"),
+		cpu_prev{},
+		combined{},
+		combined_idx(0),
+		link_prev{},
+		link_stamp{}
+	{
+		combined.fill(UINT8_MAX);
+	}
+
+	/**
+	 * Open sources
+	 *
+	 * @param links    network interfaces, up to MAX_LINKS
+	 * @param storage  mount points, up to MAX_STORAGE
+	 */
+	void open(const std::vector<std::string> &links, const std::vector<std::string> &storage)
+	{
+		for (size_t i = 0; i < MAX_TEMPS; i++) {
+			ProcFile f("/sys/class/thermal/thermal_zone" + std::to_string(i) + "/temp");
+			if (!f.is_open())
+				break;
+
+			thermal.emplace_back(std::move(f));
+		}
+
+		for (size_t i = 0; i < links.size() && i < MAX_LINKS; i++) {
+			Link l;
+			auto sys_path = "/sys/class/net/" + links[i];
+
+			l.name = links[i] + ":";
+			l.wireless = ::access((sys_path + "/wireless").c_str(), F_OK) == 0;
+
+			// [Mbit/s], -1 or EINVAL when link is down
+			long long speed;
+			ProcFile speed_file(sys_path + "/speed");
+			l.max_kib = (speed_file.read_value(speed) && speed > 0) ?
+					speed * 1000000 / 8 / 1024 : UINT32_MAX;
+
+			this->links.push_back(l);
+		}
+
+		for (size_t i = 0; i < storage.size() && i < MAX_STORAGE; i++)
+			this->storage.push_back(storage[i]);
+
+		sample_cpu();
+	}
+
+	//! Called at 10 Hz
+	void sample_cpu()
+	{
+		auto p = stat.read();
+		if (!p)
+			return;
+
+		// "cpu" line first, then "cpuN"
+		for (size_t line = 0; line <= MAX_CORES; line++) {
+			if (std::strncmp(p, "cpu", 3) != 0)
+				break;
+
+			p += 3;
+			char *end;
+			size_t idx = line;
+			if (line > 0) {
+				idx = std::strtoul(p, &end, 10) + 1;
+				p = end;
+			}
+
+			// user nice system idle iowait irq softirq steal
+			uint64_t total = 0, idle = 0;
+			for (int f = 0; f < 8; f++) {
+				uint64_t v = std::strtoull(p, &end, 10);
+				if (end == p)
+					break;
+
+				p = end;
+				total += v;
+				if (f == 3 || f == 4)
+					idle += v;
+			}
+
+			if (idx <= MAX_CORES) {
+				auto &c = cpu_prev[idx];
+				uint64_t dt = total - c.total;
+				uint8_t load = (c.total != 0 && dt > 0) ? 100 - (idle - c.idle) * 100 / dt : UINT8_MAX;
+
+				c.total = total;
+				c.idle = idle;
+				c.load = load;
+			}
+
+			p = std::strchr(p, '\n');
+			if (!p)
+				break;
+
+			p++;
+		}
+
+		combined[combined_idx] = cpu_prev[0].load;
+		combined_idx = (combined_idx + 1) % COMBINED_SLICES;
+	}
+
+	void fill(Status &status)
+	{
+		timespec ts;
+		::clock_gettime(CLOCK_BOOTTIME, &ts);
+		status.uptime = ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+		for (size_t i = 0; i < MAX_CORES; i++)
+			status.cpu_cores[i] = cpu_prev[i + 1].load;
+
+		// oldest slice first
+		for (size_t i = 0; i < COMBINED_SLICES; i++)
+			status.cpu_combined[i] = combined[(combined_idx + i) % COMBINED_SLICES];
+
+		status.gpu_cores.fill(UINT8_MAX);
+		status.gpu_combined.fill(UINT8_MAX);
+		status.fan_speed.fill(INT16_MAX);
+
+		fill_temperature(status);
+		fill_memory(status);
+		fill_storage(status);
+		fill_links(status);
+	}
+
+private:
+	struct Cpu {
+		uint64_t total;
+		uint64_t idle;
+		uint8_t load;
+
+		Cpu() : total(0), idle(0), load(UINT8_MAX) { }
+	};
+
+	struct Link {
+		std::string name;	//!< "eth0:" as in /proc/net/dev
+		bool wireless;
+		uint32_t max_kib;
+	};
+
+	ProcFile stat;
+	ProcFile meminfo;
+	ProcFile net_dev;
+	std::vector<ProcFile> thermal;
+	std::vector<Link> links;
+	std::vector<std::string> storage;
+
+	std::array<Cpu, MAX_CORES + 1> cpu_prev;	//!< [0] - all CPUs
+	std::array<uint8_t, COMBINED_SLICES> combined;
+	size_t combined_idx;
+
+	std::array<std::array<uint64_t, 2>, MAX_LINKS> link_prev;	//!< rx, tx bytes
+	std::array<timespec, MAX_LINKS> link_stamp;
+
+	void fill_temperature(Status &status)
+	{
+		status.temperature_board = INT8_MAX;
+		status.temperature_core.fill(INT8_MAX);
+
+		for (size_t i = 0; i < thermal.size(); i++) {
+			long long mdeg;
+			if (thermal[i].read_value(mdeg))
+				status.temperature_core[i] = std::max<long long>(INT8_MIN, std::min<long long>(INT8_MAX - 1, mdeg / 1000));
+		}
+	}
+
+	void fill_memory(Status &status)
+	{
+		status.ram_total = UINT32_MAX;
+		status.ram_usage = UINT32_MAX;
+
+		auto p = meminfo.read();
+		if (!p)
+			return;
+
+		auto field = [p](const char *key) -> long long {
+			auto f = std::strstr(p, key);
+			return f ? std::strtoll(f + std::strlen(key), nullptr, 10) : -1;
+		};
+
+		// [kB]
+		auto total = field("MemTotal:");
+		auto available = field("MemAvailable:");
+		if (total < 0 || available < 0)
+			return;
+
+		status.ram_total = total / 1024;
+		status.ram_usage = (total - available) / 1024;
+	}
+
+	void fill_storage(Status &status)
+	{
+		status.storage_type.fill(UINT32_MAX);
+		status.storage_usage.fill(UINT32_MAX);
+		status.storage_total.fill(UINT32_MAX);
+
+		for (size_t i = 0; i < storage.size(); i++) {
+			struct statvfs st;
+			if (::statvfs(storage[i].c_str(), &st) != 0)
+				continue;
+
+			uint64_t mib = 1024 * 1024;
+			status.storage_total[i] = uint64_t(st.f_blocks) * st.f_frsize / mib;
+			status.storage_usage[i] = uint64_t(st.f_blocks - st.f_bfree) * st.f_frsize / mib;
+		}
+	}
+
+	void fill_links(Status &status)
+	{
+		status.link_type.fill(UINT32_MAX);
+		status.link_tx_rate.fill(UINT32_MAX);
+		status.link_rx_rate.fill(UINT32_MAX);
+		status.link_tx_max.fill(UINT32_MAX);
+		status.link_rx_max.fill(UINT32_MAX);
+
+		auto p = (links.empty()) ? nullptr : net_dev.read();
+		if (!p)
+			return;
+
+		timespec now;
+		::clock_gettime(CLOCK_MONOTONIC, &now);
+
+		for (size_t i = 0; i < links.size(); i++) {
+			auto &l = links[i];
+
+			status.link_type[i] = (l.wireless) ? 20 : 10;
+			status.link_tx_max[i] = l.max_kib;
+			status.link_rx_max[i] = l.max_kib;
+
+			// "  eth0: rx_bytes packets errs drop fifo frame compressed multicast tx_bytes ..."
+			auto f = std::strstr(p, l.name.c_str());
+			if (!f)
+				continue;
+
+			char *end = const_cast<char *>(f) + l.name.size();
+			uint64_t rx = std::strtoull(end, &end, 10);
+			for (int skip = 0; skip < 7; skip++)
+				std::strtoull(end, &end, 10);
+			uint64_t tx = std::strtoull(end, &end, 10);
+
+			auto &prev = link_prev[i];
+			double dt = (now.tv_sec - link_stamp[i].tv_sec) + (now.tv_nsec - link_stamp[i].tv_nsec) * 1e-9;
+			if (link_stamp[i].tv_sec != 0 && dt > 0.0 && rx >= prev[0] && tx >= prev[1]) {
+				status.link_rx_rate[i] = (rx - prev[0]) / 1024.0 / dt;
+				status.link_tx_rate[i] = (tx - prev[1]) / 1024.0 / dt;
+			}
+
+			prev = {{rx, tx}};
+			link_stamp[i] = now;
+		}
+	}
+};
+
+constexpr size_t StatusSampler::MAX_CORES;
+constexpr size_t StatusSampler::COMBINED_SLICES;
+
 /**
  * @brief Onboard Computer Status plugin
  *
- * Publishes the status of the onboard computer
+ * Sends the status of the onboard computer, relayed from ~onboard_computer/status
+ * or, with ~onboard_computer/sampler, read by the plugin itself
  * @see status_cb()
  */
 class OnboardComputerStatusPlugin : public plugin::PluginBase {
 public:
 	OnboardComputerStatusPlugin() : PluginBase(),
-		status_nh("~onboard_computer")
+		status_nh("~onboard_computer"),
+		sampler_enabled(false),
+		sampler_component(191),
+		sampler_type(0),
+		send_every(10),
+		tick_count(0)
 	{ }
 
 	void initialize(UAS &uas_)
@@ -37,6 +399,23 @@ public:
 		PluginBase::initialize(uas_);
 
 		status_sub = status_nh.subscribe("status", 10, &OnboardComputerStatusPlugin::status_cb, this);
+
+		double sampler_rate;
+		std::vector<std::string> links, storage;
+
+		status_nh.param("sampler", sampler_enabled, false);
+		status_nh.param("sampler_rate", sampler_rate, 1.0);
+		status_nh.param("sampler_component", sampler_component, 191);	// MAV_COMP_ID_ONBOARD_COMPUTER
+		status_nh.param("sampler_type", sampler_type, 0);
+		status_nh.param("sampler_links", links, {});
+		status_nh.param("sampler_storage", storage, {"/"});
+
+		if (sampler_enabled && sampler_rate > 0.0) {
+			sampler.open(links, storage);
+			send_every = std::max(1, int(std::lround(CPU_RATE / sampler_rate)));
+			sampler_timer = status_nh.createTimer(ros::Duration(1.0 / CPU_RATE),
+					&OnboardComputerStatusPlugin::sampler_cb, this);
+		}
 	}
 
 	Subscriptions get_subscriptions()
@@ -45,8 +424,34 @@ public:
 	}
 
 private:
+	static constexpr double CPU_RATE = 10.0;	//!< [Hz] cpu_combined slices
+
 	ros::NodeHandle status_nh;
 	ros::Subscriber status_sub;
+	ros::Timer sampler_timer;
+
+	StatusSampler sampler;
+	bool sampler_enabled;
+	int sampler_component;
+	int sampler_type;
+	int send_every;		//!< status sent each N CPU samples
+	int tick_count;
+
+	void sampler_cb(const ros::TimerEvent &event)
+	{
+		sampler.sample_cpu();
+		if (++tick_count < send_every)
+			return;
+
+		tick_count = 0;
+
+		mavlink::common::msg::ONBOARD_COMPUTER_STATUS status {};
+		status.time_usec = event.current_real.toNSec() / 1000;
+		status.type = sampler_type;
+		sampler.fill(status);
+
+		UAS_FCU(m_uas)->send_message_ignore_drop(status, sampler_component);
+	}
 
 	/**
 	 * @brief Send onboard computer status to FCU and groundstation
@@ -16,24 +16,30 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <cmath>
 #include <mavros/mavros_plugin.h>
+#include <eigen_conversions/eigen_msg.h>
 
 #include <mavros_msgs/msg/OpticalFlowRad.hpp>
+#include <mavros_msgs/msg/OpticalFlowRange.hpp>
 #include <sensor_msgs/msg/Temperature.hpp>
-#include <sensor_msgs/msg/Range.hpp>
 
 namespace mavros {
 namespace extra_plugins{
 /**
  * @brief PX4 Optical Flow plugin
  *
- * This plugin can publish data from PX4Flow camera to ROS
+ * This plugin can publish data from PX4Flow camera to ROS.
+ *
+ * Frame is decoded once and sent only to topics with subscribers,
+ * ~optical_flow_range has flow and ground distance in one message.
+ * Ground distance as sensor_msgs/Range is published by distance_sensor plugin,
+ * see its `optical_flow` mapping.
  */
 class PX4FlowPlugin : public plugin::PluginBase {
 public:
 	PX4FlowPlugin() : PluginBase(),
 		flow_nh("~px4flow"),
-		ranger_fov(0.0),
 		ranger_min_range(0.3),
 		ranger_max_range(5.0)
 	{ }
@@ -44,19 +50,12 @@ public:
 
 		flow_nh.param<std::string>("frame_id", frame_id, "px4flow");
 
-		/**
-		 * @note Default rangefinder is Maxbotix HRLV-EZ4
-		 * This is a narrow beam (60cm wide at 5 meters,
-		 * but also at 1 meter). 6.8 degrees at 5 meters, 31 degrees
-		 * at 1 meter
-		 */
-		flow_nh.param("ranger_fov", ranger_fov, 0.119428926);
-
+		// default rangefinder is Maxbotix HRLV-EZ4
 		flow_nh.param("ranger_min_range", ranger_min_range, 0.3);
 		flow_nh.param("ranger_max_range", ranger_max_range, 5.0);
 
 		flow_rad_pub = flow_nh.advertise<mavros_msgs::OpticalFlowRad>("raw/optical_flow_rad", 10);
-		range_pub = flow_nh.advertise<sensor_msgs::Range>("ground_distance", 10);
+		flow_range_pub = flow_nh.advertise<mavros_msgs::OpticalFlowRange>("optical_flow_range", 10);
 		temp_pub = flow_nh.advertise<sensor_msgs::Temperature>("temperature", 10);
 
 		flow_rad_sub = flow_nh.subscribe("raw/send", 1, &PX4FlowPlugin::send_cb, this);
@@ -74,21 +73,27 @@ private:
 
 	std::string frame_id;
 
-	double ranger_fov;
 	double ranger_min_range;
 	double ranger_max_range;
 
 	ros::Publisher flow_rad_pub;
-	ros::Publisher range_pub;
+	ros::Publisher flow_range_pub;
 	ros::Publisher temp_pub;
 	ros::Subscriber flow_rad_sub;
 
 	void handle_optical_flow_rad(const mavlink::mavlink_message_t *msg, mavlink::common::msg::OPTICAL_FLOW_RAD &flow_rad)
 	{
+		bool want_raw = flow_rad_pub.getNumSubscribers() > 0;
+		bool want_range = flow_range_pub.getNumSubscribers() > 0;
+		bool want_temp = temp_pub.getNumSubscribers() > 0;
+		if (!want_raw && !want_range && !want_temp)
+			return;
+
 		auto header = m_uas->synchronized_header(frame_id, flow_rad.time_usec);
+		float temperature = flow_rad.temperature / 100.0f;	// in degrees celsius
 
 		/**
-		 * Raw message with axes mapped to ROS conventions and temp in degrees celsius.
+		 * Axes mapped to ROS conventions.
 		 *
 		 * The optical flow camera is essentially an angular sensor, so conversion is like
 		 * gyroscope. (aircraft -> baselink)
@@ -104,53 +109,54 @@ private:
 					flow_rad.integrated_ygyro,
 					flow_rad.integrated_zgyro));
 
-		auto flow_rad_msg = boost::make_shared<mavros_msgs::OpticalFlowRad>();
+		if (want_raw) {
+			auto flow_rad_msg = boost::make_shared<mavros_msgs::OpticalFlowRad>();
 
-		flow_rad_msg->header = header;
-		flow_rad_msg->integration_time_us = flow_rad.integration_time_us;
+			flow_rad_msg->header = header;
+			flow_rad_msg->integration_time_us = flow_rad.integration_time_us;
 
-		flow_rad_msg->integrated_x = int_xy.x();
-		flow_rad_msg->integrated_y = int_xy.y();
+			flow_rad_msg->integrated_x = int_xy.x();
+			flow_rad_msg->integrated_y = int_xy.y();
 
-		flow_rad_msg->integrated_xgyro = int_gyro.x();
-		flow_rad_msg->integrated_ygyro = int_gyro.y();
-		flow_rad_msg->integrated_zgyro = int_gyro.z();
+			flow_rad_msg->integrated_xgyro = int_gyro.x();
+			flow_rad_msg->integrated_ygyro = int_gyro.y();
+			flow_rad_msg->integrated_zgyro = int_gyro.z();
 
-		flow_rad_msg->temperature = flow_rad.temperature / 100.0f;	// in degrees celsius
-		flow_rad_msg->time_delta_distance_us = flow_rad.time_delta_distance_us;
-		flow_rad_msg->distance = flow_rad.distance;
-		flow_rad_msg->quality = flow_rad.quality;
+			flow_rad_msg->temperature = temperature;
+			flow_rad_msg->time_delta_distance_us = flow_rad.time_delta_distance_us;
+			flow_rad_msg->distance = flow_rad.distance;
+			flow_rad_msg->quality = flow_rad.quality;
 
-		flow_rad_pub.publish(flow_rad_msg);
+			flow_rad_pub.publish(flow_rad_msg);
+		}
 
-		// Temperature
-		auto temp_msg = boost::make_shared<sensor_msgs::Temperature>();
+		if (want_range) {
+			auto flow_range_msg = boost::make_shared<mavros_msgs::OpticalFlowRange>();
 
-		temp_msg->header = header;
-		temp_msg->temperature = flow_rad_msg->temperature;
+			flow_range_msg->header = header;
+			flow_range_msg->integration_time_us = flow_rad.integration_time_us;
+			tf::vectorEigenToMsg(int_xy, flow_range_msg->integrated_flow);
+			tf::vectorEigenToMsg(int_gyro, flow_range_msg->integrated_gyro);
+			flow_range_msg->quality = flow_rad.quality;
+			flow_range_msg->temperature = temperature;
 
-		temp_pub.publish(temp_msg);
+			// negative distance - no valid reading
+			flow_range_msg->time_delta_distance_us = flow_rad.time_delta_distance_us;
+			flow_range_msg->range = (flow_rad.distance >= 0.0f) ? flow_rad.distance : NAN;
+			flow_range_msg->min_range = ranger_min_range;
+			flow_range_msg->max_range = ranger_max_range;
 
-		// Rangefinder
-		/**
-		 * @todo: use distance_sensor plugin only to publish this data
-		 * (which receives DISTANCE_SENSOR msg with multiple rangefinder
-		 * sensors data)
-		 *
-		 * @todo: suggest modification on MAVLink OPTICAL_FLOW_RAD msg
-		 * which removes sonar data fields from it
-		 */
-		auto range_msg = boost::make_shared<sensor_msgs::Range>();
+			flow_range_pub.publish(flow_range_msg);
+		}
 
-		range_msg->header = header;
+		if (want_temp) {
+			auto temp_msg = boost::make_shared<sensor_msgs::Temperature>();
 
-		range_msg->radiation_type = sensor_msgs::Range::ULTRASOUND;
-		range_msg->field_of_view = ranger_fov;
-		range_msg->min_range = ranger_min_range;
-		range_msg->max_range = ranger_max_range;
-		range_msg->range = flow_rad.distance;
+			temp_msg->header = header;
+			temp_msg->temperature = temperature;
 
-		range_pub.publish(range_msg);
+			temp_pub.publish(temp_msg);
+		}
 	}
 
 	void send_cb(const mavros_msgs::OpticalFlowRad::ConstPtr msg)
@@ -14,6 +14,7 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.mdA
  */
 
+#include <cstring>
 #include <mavros/mavros_plugin.h>
 #include <mavros_msgs/msg/Trajectory.hpp>
 #include <mavros_msgs/msg/PositionTarget.hpp>
@@ -40,13 +41,23 @@ using RosPoints = mavros_msgs::PositionTarget;
 class TrajectoryPlugin : public plugin::PluginBase {
 public:
 	TrajectoryPlugin() : PluginBase(),
-		trajectory_nh("~trajectory")
+		trajectory_nh("~trajectory"),
+		enu_batch(BATCH_ROWS, 3),
+		ned_batch(BATCH_ROWS, 3),
+		have_last_sent(false),
+		resend_period(0.2),
+		downsample_path(false)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
 
+		double resend_period_d;
+		trajectory_nh.param("resend_period", resend_period_d, 0.2);
+		trajectory_nh.param("downsample_path", downsample_path, false);
+		resend_period = ros::Duration(resend_period_d);
+
 		trajectory_generated_sub = trajectory_nh.subscribe("generated", 10, &TrajectoryPlugin::trajectory_cb, this);
 		path_sub = trajectory_nh.subscribe("path", 10, &TrajectoryPlugin::path_cb, this);
 		trajectory_desired_pub = trajectory_nh.advertise<mavros_msgs::Trajectory>("desired", 10);
@@ -67,53 +78,42 @@ private:
 
 	ros::Publisher trajectory_desired_pub;
 
-	// [[[cog:
-	// def outl_fill_points_ned_vector(x, y, z, vec_name, vec_type, point_xyz):
-	//     cog.outl(
-	//         """void fill_points_{vec_name}(MavPoints &{x}, MavPoints &{y}, MavPoints &{z}, const geometry_msgs::{vec_type} &{vec_name}, const size_t i)\n"""
-	//         """{{\n"""
-	//         """\tauto {vec_name}_ned = ftf::transform_frame_enu_ned(ftf::to_eigen({vec_name}));\n"""
-	//         .format(**locals())
-	//     )
-	//
-	//     for axis in "xyz":
-	//         cog.outl("\t{axis}[i] = {vec_name}_ned.{axis}();".format(**locals()))
-	//
-	//     cog.outl("}\n")
-	//
-	//
-	// outl_fill_points_ned_vector('x', 'y', 'z', 'position', 'Point', range(0, 3))
-	// outl_fill_points_ned_vector('x', 'y', 'z', 'velocity', 'Vector3', range(3, 6))
-	// outl_fill_points_ned_vector('x', 'y', 'z', 'acceleration', 'Vector3', range(6, 9))
-	// ]]]
-	void fill_points_position(MavPoints &x, MavPoints &y, MavPoints &z, const geometry_msgs::Point &position, const size_t i)
-	{
-		auto position_ned = ftf::transform_frame_enu_ned(ftf::to_eigen(position));
+	//! Rows of conversion batch: positions, velocities and accelerations of all points
+	static constexpr int BATCH_POS = 0;
+	static constexpr int BATCH_VEL = NUM_POINTS;
+	static constexpr int BATCH_ACC = 2 * NUM_POINTS;
+	static constexpr int BATCH_ROWS = 3 * NUM_POINTS;
 
-		x[i] = position_ned.x();
-		y[i] = position_ned.y();
-		z[i] = position_ned.z();
-	}
+	//! ENU vectors of one message, unused rows are NaN and stay NaN after conversion
+	ftf::Vector3dBatch enu_batch;
+	ftf::Vector3dBatch ned_batch;
 
-	void fill_points_velocity(MavPoints &x, MavPoints &y, MavPoints &z, const geometry_msgs::Vector3 &velocity, const size_t i)
-	{
-		auto velocity_ned = ftf::transform_frame_enu_ned(ftf::to_eigen(velocity));
+	mavlink::common::msg::TRAJECTORY_REPRESENTATION_WAYPOINTS last_sent;
+	bool have_last_sent;
+	ros::Time last_sent_time;
+	ros::Duration resend_period;	//!< unchanged trajectory is resent that often
+	bool downsample_path;		//!< spread points over whole Path, otherwise first ones
 
-		x[i] = velocity_ned.x();
-		y[i] = velocity_ned.y();
-		z[i] = velocity_ned.z();
+	template<class T>
+	void batch_set(const int row, const T &vec)
+	{
+		enu_batch.row(row) << vec.x, vec.y, vec.z;
 	}
 
-	void fill_points_acceleration(MavPoints &x, MavPoints &y, MavPoints &z, const geometry_msgs::Vector3 &acceleration, const size_t i)
+	//! Convert all rows at once, before batch_get()
+	void batch_convert()
 	{
-		auto acceleration_ned = ftf::transform_frame_enu_ned(ftf::to_eigen(acceleration));
-
-		x[i] = acceleration_ned.x();
-		y[i] = acceleration_ned.y();
-		z[i] = acceleration_ned.z();
+		ftf::transform_frame_enu_ned(enu_batch, ned_batch);
 	}
 
-	// [[[end]]] (checksum: 92ea0f7f329c90c486fdb8b738c0e7c3)
+	void batch_get(MavPoints &x, MavPoints &y, MavPoints &z, const int first)
+	{
+		for (size_t i = 0; i < NUM_POINTS; i++) {
+			x[i] = ned_batch(first + i, 0);
+			y[i] = ned_batch(first + i, 1);
+			z[i] = ned_batch(first + i, 2);
+		}
+	}
 
 
 	void fill_points_yaw_wp(MavPoints &y, const double yaw, const size_t i) {
@@ -133,31 +133,43 @@ private:
 		y[i] = wrap_pi(-yaw_wp + (M_PI / 2.0f));
 	}
 
-	auto fill_points_unused_path(mavlink::common::msg::TRAJECTORY_REPRESENTATION_WAYPOINTS & t, const size_t i) {
-		t.vel_x[i] = NAN;
-		t.vel_y[i] = NAN;
-		t.vel_z[i] = NAN;
-		t.acc_x[i] = NAN;
-		t.acc_y[i] = NAN;
-		t.acc_z[i] = NAN;
-		t.vel_yaw[i] = NAN;
+	//! Waypoints equal bit by bit, NaN of unused fields included. Time is not compared.
+	static bool same_points(const mavlink::common::msg::TRAJECTORY_REPRESENTATION_WAYPOINTS &a,
+			const mavlink::common::msg::TRAJECTORY_REPRESENTATION_WAYPOINTS &b)
+	{
+		auto same = [](const MavPoints &l, const MavPoints &r) {
+			return std::memcmp(l.data(), r.data(), sizeof(l)) == 0;
+		};
+
+		return a.valid_points == b.valid_points && a.command == b.command &&
+		       same(a.pos_x, b.pos_x) && same(a.pos_y, b.pos_y) && same(a.pos_z, b.pos_z) &&
+		       same(a.vel_x, b.vel_x) && same(a.vel_y, b.vel_y) && same(a.vel_z, b.vel_z) &&
+		       same(a.acc_x, b.acc_x) && same(a.acc_y, b.acc_y) && same(a.acc_z, b.acc_z) &&
+		       same(a.pos_yaw, b.pos_yaw) && same(a.vel_yaw, b.vel_yaw);
 	}
 
-	void fill_points_all_unused(mavlink::common::msg::TRAJECTORY_REPRESENTATION_WAYPOINTS &t, const size_t i) {
-		t.pos_x[i] = NAN;
-		t.pos_y[i] = NAN;
-		t.pos_z[i] = NAN;
+	//! Send unless same as last sent within resend_period
+	void send_trajectory(const mavlink::common::msg::TRAJECTORY_REPRESENTATION_WAYPOINTS &trajectory)
+	{
+		auto now = ros::Time::now();
+		if (have_last_sent && now - last_sent_time < resend_period && same_points(trajectory, last_sent))
+			return;
+
+		last_sent = trajectory;
+		last_sent_time = now;
+		have_last_sent = true;
 
-		t.vel_x[i] = NAN;
-		t.vel_y[i] = NAN;
-		t.vel_z[i] = NAN;
+		UAS_FCU(m_uas)->send_message_ignore_drop(trajectory);
+	}
 
-		t.acc_x[i] = NAN;
-		t.acc_y[i] = NAN;
-		t.acc_z[i] = NAN;
+	//! Path pose used for point @a i
+	size_t path_index(const size_t i, const size_t poses) const
+	{
+		if (!downsample_path || poses <= NUM_POINTS)
+			return i;
 
-		t.pos_yaw[i] = NAN;
-		t.vel_yaw[i] = NAN;
+		// first and last poses included
+		return i * (poses - 1) / (NUM_POINTS - 1);
 	}
 
 
@@ -203,19 +215,22 @@ private:
 
 		mavlink::common::msg::TRAJECTORY_REPRESENTATION_WAYPOINTS trajectory {};
 
+		enu_batch.setConstant(NAN);
+
 		auto fill_point = [&](mavlink::common::msg::TRAJECTORY_REPRESENTATION_WAYPOINTS & t, const RosPoints &rp, const size_t i) {
 			const auto valid = req->point_valid[i];
 
 			auto valid_so_far = trajectory.valid_points;
 			if (!valid) {
-				fill_points_all_unused(t, i);
+				t.pos_yaw[i] = NAN;
+				t.vel_yaw[i] = NAN;
 				return;
 			}
 
 			trajectory.valid_points = valid_so_far + 1;
-			fill_points_position(t.pos_x, t.pos_y, t.pos_z, rp.position, i);
-			fill_points_velocity(t.vel_x, t.vel_y, t.vel_z, rp.velocity, i);
-			fill_points_acceleration(t.acc_x, t.acc_y, t.acc_z, rp.acceleration_or_force, i);
+			batch_set(BATCH_POS + i, rp.position);
+			batch_set(BATCH_VEL + i, rp.velocity);
+			batch_set(BATCH_ACC + i, rp.acceleration_or_force);
 			fill_points_yaw_wp(t.pos_yaw, rp.yaw, i);
 			fill_points_yaw_speed(t.vel_yaw, rp.yaw_rate, i);
 			t.command[i] = UINT16_MAX;
@@ -237,7 +252,12 @@ private:
 		fill_point(trajectory, req->point_5, 4);
 		// [[[end]]] (checksum: 16d650d405469f331a17c2f5a892365d)
 
-		UAS_FCU(m_uas)->send_message_ignore_drop(trajectory);
+		batch_convert();
+		batch_get(trajectory.pos_x, trajectory.pos_y, trajectory.pos_z, BATCH_POS);
+		batch_get(trajectory.vel_x, trajectory.vel_y, trajectory.vel_z, BATCH_VEL);
+		batch_get(trajectory.acc_x, trajectory.acc_y, trajectory.acc_z, BATCH_ACC);
+
+		send_trajectory(trajectory);
 	}
 
 
@@ -254,17 +274,20 @@ private:
 		trajectory.time_usec = req->header.stamp.toNSec() / 1000;	//!< [milisecs]
 		trajectory.valid_points = std::min(NUM_POINTS, req->poses.size());
 
+		// velocity and acceleration rows stay NaN - unused
+		enu_batch.setConstant(NAN);
+
 		auto fill_point = [&](mavlink::common::msg::TRAJECTORY_REPRESENTATION_WAYPOINTS & t, const size_t i) {
 			t.command[i] = UINT16_MAX;
+			t.vel_yaw[i] = NAN;
 			if (req->poses.size() < i + 1) {
-				fill_points_all_unused(t, i);
+				t.pos_yaw[i] = NAN;
 			}
 			else {
-				auto &pose = req->poses[i].pose;
+				auto &pose = req->poses[path_index(i, req->poses.size())].pose;
 
-				fill_points_position(t.pos_x, t.pos_y, t.pos_z, pose.position, i);
+				batch_set(BATCH_POS + i, pose.position);
 				fill_points_yaw_q(t.pos_yaw, pose.orientation, i);
-				fill_points_unused_path(t, i);
 			}
 		};
 
@@ -280,7 +303,12 @@ private:
 		fill_point(trajectory, 4);
 		// [[[end]]] (checksum: 267a911c65a3768f04a8230fcb235bca)
 
-		UAS_FCU(m_uas)->send_message_ignore_drop(trajectory);
+		batch_convert();
+		batch_get(trajectory.pos_x, trajectory.pos_y, trajectory.pos_z, BATCH_POS);
+		batch_get(trajectory.vel_x, trajectory.vel_y, trajectory.vel_z, BATCH_VEL);
+		batch_get(trajectory.acc_x, trajectory.acc_y, trajectory.acc_z, BATCH_ACC);
+
+		send_trajectory(trajectory);
 	}
 
 	void handle_trajectory(const mavlink::mavlink_message_t *msg, mavlink::common::msg::TRAJECTORY_REPRESENTATION_WAYPOINTS &trajectory)
@@ -334,6 +362,11 @@ private:
 		return fmod(a + M_PI, 2.0f * M_PI) - M_PI;
 	}
 };
+
+constexpr int TrajectoryPlugin::BATCH_POS;
+constexpr int TrajectoryPlugin::BATCH_VEL;
+constexpr int TrajectoryPlugin::BATCH_ACC;
+constexpr int TrajectoryPlugin::BATCH_ROWS;
 }	// namespace extra_plugins
 }	// namespace mavros
 
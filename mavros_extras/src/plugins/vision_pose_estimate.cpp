@@ -15,6 +15,7 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <mutex>
 #include <mavros/mavros_plugin.h>
 #include <mavros/setpoint_mixin.h>
 #include <eigen_conversions/eigen_msg.h>
@@ -30,26 +31,44 @@ namespace extra_plugins{
  * Send pose estimation from various vision estimators
  * to FCU position and attitude estimators.
  *
+ * In tf event mode transform is sent right after TF update, without rate limit.
+ * Every @a decimation pose is sent, capture to send latency is reported
+ * to diagnostics.
  */
 class VisionPoseEstimatePlugin : public plugin::PluginBase,
 	private plugin::TF2ListenerMixin<VisionPoseEstimatePlugin> {
 public:
 	VisionPoseEstimatePlugin() : PluginBase(),
 		sp_nh("~vision_pose"),
-		tf_rate(10.0)
+		tf_rate(10.0),
+		decimation(1),
+		fcu_time(false),
+		decimation_count(0),
+		stats {}
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
 
-		bool tf_listen;
+		bool tf_listen, tf_event;
 
 		// tf params
 		sp_nh.param("tf/listen", tf_listen, false);
 		sp_nh.param<std::string>("tf/frame_id", tf_frame_id, "map");
 		sp_nh.param<std::string>("tf/child_frame_id", tf_child_frame_id, "vision_estimate");
 		sp_nh.param("tf/rate_limit", tf_rate, 10.0);
+		sp_nh.param("tf/event", tf_event, false);
+
+		sp_nh.param("decimation", decimation, 1);
+		sp_nh.param("fcu_time", fcu_time, false);
+		decimation = std::max(decimation, 1);
+
+		// dispatcher without rate limit delivers each new transform
+		if (tf_event)
+			tf_rate = 0.0;
+
+		UAS_DIAG(m_uas).add("Vision pose", this, &VisionPoseEstimatePlugin::diag_run);
 
 		if (tf_listen) {
 			ROS_INFO_STREAM_NAMED("vision_pose", "Listen to vision transform " << tf_frame_id
@@ -79,6 +98,74 @@ private:
 	double tf_rate;
 	ros::Time last_transform_stamp;
 
+	int decimation;		//!< send every Nth pose
+	bool fcu_time;		//!< send stamp converted to FCU time
+
+	//! capture to send latency since last diagnostics run
+	struct LatencyStats {
+		uint64_t sent;
+		uint64_t decimated;
+		double sum;	//!< [sec]
+		double max;
+	};
+
+	std::mutex stats_mutex;
+	int decimation_count;
+	LatencyStats stats;
+
+	//! @return true if pose should be dropped by decimation
+	bool decimate()
+	{
+		std::lock_guard<std::mutex> lock(stats_mutex);
+		if (++decimation_count < decimation) {
+			stats.decimated++;
+			return true;
+		}
+
+		decimation_count = 0;
+		return false;
+	}
+
+	void update_latency(const ros::Time &stamp)
+	{
+		double latency = (ros::Time::now() - stamp).toSec();
+
+		std::lock_guard<std::mutex> lock(stats_mutex);
+		stats.sent++;
+		stats.sum += latency;
+		stats.max = std::max(stats.max, latency);
+	}
+
+	//! Capture stamp in FCU clock if time model is known, else local [us]
+	uint64_t vision_stamp_usec(const ros::Time &stamp)
+	{
+		auto model = m_uas->get_time_model();
+		if (fcu_time && model.offset_ns != 0)
+			return model.to_remote(stamp.toNSec()) / 1000;
+
+		return stamp.toNSec() / 1000;
+	}
+
+	void diag_run(diagnostic_updater::DiagnosticStatusWrapper &stat)
+	{
+		LatencyStats st;
+		{
+			std::lock_guard<std::mutex> lock(stats_mutex);
+			st = stats;
+			stats = LatencyStats {};
+		}
+
+		if (st.sent == 0)
+			stat.summary(1, "No poses");
+		else
+			stat.summary(0, "Normal");
+
+		stat.addf("Sent", "%llu", (unsigned long long) st.sent);
+		stat.addf("Decimated", "%llu", (unsigned long long) st.decimated);
+		stat.addf("Latency mean (ms)", "%.2f", (st.sent > 0) ? st.sum / st.sent * 1e3 : 0.0);
+		stat.addf("Latency max (ms)", "%.2f", st.max * 1e3);
+	}
+
 	/* -*- low-level send -*- */
 	/**
 	 * @brief Send vision estimate transform to FCU position controller
@@ -95,6 +182,9 @@ private:
 		}
 		last_transform_stamp = stamp;
 
+		if (decimate())
+			return;
+
 		auto position = ftf::transform_frame_enu_ned(Eigen::Vector3d(tr.translation()));
 		auto rpy = ftf::quaternion_to_rpy(
 				ftf::transform_orientation_enu_ned(
@@ -108,7 +198,7 @@ private:
 
 		mavlink::common::msg::VISION_POSITION_ESTIMATE vp{};
 
-		vp.usec = stamp.toNSec() / 1000;
+		vp.usec = vision_stamp_usec(stamp);
 		// [[[cog:
 		// for f in "xyz":
 		//     cog.outl("vp.%s = position.%s();" % (f, f))
@@ -128,6 +218,7 @@ private:
 		ftf::covariance_urt_to_mavlink(cov_map, vp.covariance);
 
 		UAS_FCU(m_uas)->send_message_ignore_drop(vp);
+		update_latency(stamp);
 	}
 
 	/* -*- callbacks -*- */
@@ -14,6 +14,7 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <array>
 #include <mavros/mavros_plugin.h>
 #include <mavros_msgs/msg/WheelOdomStamped.hpp>
 
@@ -31,6 +32,7 @@ namespace extra_plugins {
  * This plugin allows computing and publishing wheel odometry coming from FCU wheel encoders.
  * Can use either wheel's RPM or WHEEL_DISTANCE messages (the latter gives better accuracy).
  *
+ * Each measurement is integrated, results are published at most at publish_rate.
  */
 class WheelOdometryPlugin : public plugin::PluginBase {
 public:
@@ -43,6 +45,9 @@ public:
 		raw_send(false),
 		twist_send(false),
 		tf_send(false),
+		count_meas(0),
+		measurement_prev{},
+		publish_period(0.0),
 		yaw_initialized(false),
 		rpose(Eigen::Vector3d::Zero()),
 		rtwist(Eigen::Vector3d::Zero()),
@@ -58,7 +63,7 @@ public:
 		wo_nh.param("send_raw", raw_send, false);
 		// Wheels configuration
 		wo_nh.param("count", count, 2);
-		count = std::max(1, count); // bound check
+		count = std::max(1, std::min<int>(MAX_WHEELS, count)); // bound check
 
 		bool use_rpm;
 		wo_nh.param("use_rpm", use_rpm, false);
@@ -72,6 +77,10 @@ public:
 		wo_nh.param<std::string>("frame_id", frame_id, "odom");
 		wo_nh.param<std::string>("child_frame_id", child_frame_id, "base_link");
 		wo_nh.param("vel_error", vel_cov, 0.1);
+		double publish_rate;
+		wo_nh.param("publish_rate", publish_rate, 0.0);	// 0 - each measurement
+		if (publish_rate > 0.0)
+			publish_period = ros::Duration(1.0 / publish_rate);
 		vel_cov = vel_cov*vel_cov; // std -> cov
 		// TF subsection
 		wo_nh.param("tf/send", tf_send, false);
@@ -178,6 +187,11 @@ private:
 	};
 	OM odom_mode; //!< odometry computation mode
 
+	//! WHEEL_DISTANCE capacity
+	static constexpr size_t MAX_WHEELS = 16;
+	//! Per wheel values, only first count_meas are used
+	using WheelArray = std::array<double, MAX_WHEELS>;
+
 	int count;		//!< requested number of wheels to compute odometry
 	bool raw_send;		//!< send wheel's RPM and cumulative distance
 	std::vector<Eigen::Vector2d> wheel_offset; //!< wheel x,y offsets (m,NED)
@@ -193,7 +207,10 @@ private:
 
 	int count_meas;				//!< number of wheels in measurements
 	ros::Time time_prev;			//!< timestamp of previous measurement
-	std::vector<double> measurement_prev;	//!< previous measurement
+	WheelArray measurement_prev;		//!< previous measurement
+
+	ros::Duration publish_period;		//!< 0 - publish each update
+	ros::Time last_publish;
 
 	bool yaw_initialized;			//!< initial yaw initialized (from IMU)
 
@@ -314,7 +331,7 @@ private:
 	 * @param distance	distance traveled by each wheel since last odometry update
 	 * @param dt		time elapse since last odometry update (s)
 	 */
-	void update_odometry_diffdrive(std::vector<double> distance, double dt)
+	void update_odometry_diffdrive(const WheelArray &distance, double dt)
 	{
 		double y0 = wheel_offset[0](1);
 		double y1 = wheel_offset[1](1);
@@ -441,12 +458,13 @@ private:
 	 * @brief Update odometry (currently, only 2-wheels differential configuration implemented).
 	 * Odometry is computed for robot's origin (IMU).
 	 * @param distance	distance traveled by each wheel since last odometry update
+	 * @param nwheels	wheels in @a distance
 	 * @param dt		time elapse since last odometry update (s)
 	 */
-	void update_odometry(std::vector<double> distance, double dt)
+	void update_odometry(const WheelArray &distance, int nwheels, double dt)
 	{
 		// Currently, only 2-wheels configuration implemented
-		int nwheels = std::min(2, (int)distance.size());
+		nwheels = std::min(2, nwheels);
 		switch (nwheels)
 		{
 		// Differential drive robot.
@@ -459,16 +477,16 @@ private:
 	/**
 	 * @brief Process wheel measurement.
 	 * @param measurement	measurement
+	 * @param size		wheels in measurement
 	 * @param rpm		whether measurement contains RPM-s or cumulative wheel distances
 	 * @param time		measurement's internal time stamp (for accurate dt computations)
 	 * @param time_pub	measurement's time stamp for publish
 	 */
-	void process_measurement(std::vector<double> measurement, bool rpm, ros::Time time, ros::Time time_pub)
+	void process_measurement(const WheelArray &measurement, int size, bool rpm, ros::Time time, ros::Time time_pub)
 	{
 		// Initial measurement
 		if (time_prev == ros::Time(0)) {
-			count_meas = measurement.size();
-			measurement_prev.resize(count_meas);
+			count_meas = size;
 			count = std::min(count, count_meas); // don't try to use more wheels than we have
 		}
 		// Same time stamp (messages are generated by FCU more often than the wheel state updated)
@@ -476,8 +494,8 @@ private:
 			return;
 		}
 		// # of wheels differs from the initial value
-		else if (measurement.size() != count_meas) {
-			ROS_WARN_THROTTLE_NAMED(10, "wo", "WO: Number of wheels in measurement (%lu) differs from the initial value (%i).", measurement.size(), count_meas);
+		else if (size != count_meas) {
+			ROS_WARN_THROTTLE_NAMED(10, "wo", "WO: Number of wheels in measurement (%i) differs from the initial value (%i).", size, count_meas);
 			return;
 		}
 		// Compute odometry
@@ -485,8 +503,7 @@ private:
 			double dt = (time - time_prev).toSec(); // Time since previous measurement (s)
 
 			// Distance traveled by each wheel since last measurement.
-			// Reserve for at least 2 wheels.
-			std::vector<double> distance(std::max(2, count));
+			WheelArray distance{};
 			// Compute using RPM-s
 			if (rpm) {
 				for (int i = 0; i < count; i++) {
@@ -507,15 +524,18 @@ private:
 				distance[1] = distance[0];
 
 			// Update odometry
-			update_odometry(distance, dt);
+			update_odometry(distance, std::max(2, count), dt);
 
-			// Publish odometry
-			publish_odometry(time_pub);
+			// Publish odometry, rate limited
+			if (publish_period.isZero() || time_pub < last_publish || time_pub - last_publish >= publish_period) {
+				publish_odometry(time_pub);
+				last_publish = time_pub;
+			}
 		}
 
 		// Time step
 		time_prev = time;
-		std::copy_n(measurement.begin(), measurement.size(), measurement_prev.begin());
+		measurement_prev = measurement;
 	}
 
 	/* -*- message handlers -*- */
@@ -545,8 +565,10 @@ private:
 
 		// Process measurement
 		if (odom_mode == OM::RPM) {
-			std::vector<double> measurement{rpm.rpm1, rpm.rpm2};
-			process_measurement(measurement, true, timestamp, timestamp);
+			WheelArray measurement{};
+			measurement[0] = rpm.rpm1;
+			measurement[1] = rpm.rpm2;
+			process_measurement(measurement, 2, true, timestamp, timestamp);
 		}
 	}
 
@@ -580,12 +602,15 @@ private:
 
 		// Process measurement
 		if (odom_mode == OM::DIST) {
-			std::vector<double> measurement(wheel_dist.count);
-			std::copy_n(wheel_dist.distance.begin(), wheel_dist.count, measurement.begin());
-			process_measurement(measurement, false, timestamp_int, timestamp);
+			int size = std::min<int>(wheel_dist.count, MAX_WHEELS);
+			WheelArray measurement{};
+			std::copy_n(wheel_dist.distance.begin(), size, measurement.begin());
+			process_measurement(measurement, size, false, timestamp_int, timestamp);
 		}
 	}
 };
+
+constexpr size_t WheelOdometryPlugin::MAX_WHEELS;
 }	// namespace extra_plugins
 }	// namespace mavros
 
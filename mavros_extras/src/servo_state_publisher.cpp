@@ -11,6 +11,8 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <vector>
+
 #include <rclcpp/rclcpp.hpp>
 #include <ros/console.h>
 
@@ -105,10 +107,16 @@ public:
 class ServoStatePublisher {
 public:
 	ServoStatePublisher() :
-		nh()
+		nh(),
+		valid_count(0),
+		have_update(false)
 	{
 		ros::NodeHandle priv_nh("~");
 
+		// 0 - publish on each RC_OUT, else latest is published at that rate
+		double publish_rate;
+		priv_nh.param("publish_rate", publish_rate, 0.0);
+
 		XmlRpc::XmlRpcValue param_dict;
 		priv_nh.getParam("", param_dict);
 
@@ -119,6 +127,10 @@ public:
 		ROS_INFO("SSP: URDF robot: %s", model.getName().c_str());
 
 		for (auto &pair : param_dict) {
+			// options are not joints
+			if (pair.second.getType() != XmlRpc::XmlRpcValue::TypeStruct)
+				continue;
+
 			ROS_DEBUG("SSP: Loading joint: %s", pair.first.c_str());
 
 			// inefficient, but easier to program
@@ -158,8 +170,20 @@ public:
 			ROS_INFO("SSP: joint '%s' (RC%d) loaded", pair.first.c_str(), rc_channel);
 		}
 
+		// names are set once, callback fills positions
+		states.name.reserve(servos.size());
+		for (auto &desc : servos)
+			states.name.push_back(desc.joint_name);
+
+		states.position.resize(servos.size());
+		valid.resize(servos.size());
+
 		rc_out_sub = nh.subscribe("rc_out", 10, &ServoStatePublisher::rc_out_cb, this);
 		joint_states_pub = nh.advertise<sensor_msgs::JointState>("joint_states", 10);
+
+		if (publish_rate > 0.0)
+			publish_timer = nh.createWallTimer(ros::WallDuration(1.0 / publish_rate),
+					&ServoStatePublisher::publish_timer_cb, this);
 	}
 
 	void spin() {
@@ -176,17 +200,27 @@ private:
 	ros::NodeHandle nh;
 	ros::Subscriber rc_out_sub;
 	ros::Publisher joint_states_pub;
+	ros::WallTimer publish_timer;
+
+	std::vector<ServoDescription> servos;
 
-	std::list<ServoDescription> servos;
+	// all joints in servos order, published by reference, so never copied
+	sensor_msgs::JointState states;
+	std::vector<bool> valid;	//!< joint channel was in last RC_OUT
+	size_t valid_count;
+	bool have_update;
 
 	void rc_out_cb(const mavros_msgs::RCOut::ConstPtr &msg) {
 		if (msg->channels.empty())
 			return;		// nothing to do
 
-		auto states = boost::make_shared<sensor_msgs::JointState>();
-		states->header.stamp = msg->header.stamp;
+		states.header.stamp = msg->header.stamp;
+		valid_count = 0;
+
+		for (size_t i = 0; i < servos.size(); i++) {
+			auto &desc = servos[i];
+			valid[i] = false;
 
-		for (auto &desc : servos) {
 			if (!(desc.rc_channel != 0 && desc.rc_channel <= msg->channels.size()))
 				continue;	// prevent crash on servos not in that message
 
@@ -194,11 +228,40 @@ private:
 			if (pwm == 0 || pwm == UINT16_MAX)
 				continue;	// exclude unset channels
 
-			states->name.emplace_back(desc.joint_name);
-			states->position.emplace_back(desc.calculate_position(pwm));
+			states.position[i] = desc.calculate_position(pwm);
+			valid[i] = true;
+			valid_count++;
+		}
+
+		have_update = true;
+		if (!publish_timer.isValid())
+			publish_states();
+	}
+
+	void publish_timer_cb(const ros::WallTimerEvent &event) {
+		if (have_update)
+			publish_states();
+	}
+
+	void publish_states() {
+		have_update = false;
+		if (valid_count == servos.size()) {
+			joint_states_pub.publish(states);
+			return;
+		}
+
+		// some outputs unset (e.g. before FCU init): only known joints
+		sensor_msgs::JointState partial;
+		partial.header = states.header;
+		for (size_t i = 0; i < servos.size(); i++) {
+			if (!valid[i])
+				continue;
+
+			partial.name.push_back(states.name[i]);
+			partial.position.push_back(states.position[i]);
 		}
 
-		joint_states_pub.publish(states);
+		joint_states_pub.publish(partial);
 	}
 };
 
@@ -11,6 +11,7 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <algorithm>
 #include <vector>
 
 #include <tf/tf.h>
@@ -28,6 +29,9 @@ static std::string fixed_frame_id;
 static std::string child_frame_id;
 static double marker_scale;
 static int max_track_size = 100;
+static double track_min_distance;	// [m] track point spacing
+static ros::Duration track_min_period;	// track point at most this often
+static ros::Duration marker_period;	// vehicle, track and wp markers publish period, 0 - each update
 
 // source subscribers
 ros::Subscriber local_position_sub;
@@ -46,11 +50,33 @@ geometry_msgs::Vector3 lt_size;
 boost::shared_ptr<visualization_msgs::MarkerArray> vehicle_marker;
 
 /**
- * @brief publish vehicle track
+ * @brief limit publish rate to marker_period
+ *
+ * @param last  time of last publication, updated if due
+ */
+static bool publish_due(ros::Time &last, const ros::Time &now)
+{
+	if (!last.isZero() && now - last < marker_period && now >= last)
+		return false;
+
+	last = now;
+	return true;
+}
+
+/**
+ * @brief add pose to vehicle track and publish it
+ *
+ * Track is a ring of max_track_size points, spaced by track_min_distance
+ * and track_min_period, so hovering does not fill it.
+ * Points are collected without subscribers, so late RViz gets the whole track.
  */
 static void publish_track_marker(const geometry_msgs::PoseStamped::ConstPtr &pose)
 {
 	static boost::shared_ptr<visualization_msgs::Marker> track_marker;
+	static geometry_msgs::Point last_point;
+	static ros::Time last_point_stamp;
+	static ros::Time last_pub;
+	static bool changed = false;
 
 	if ( !track_marker )
 	{
@@ -70,14 +96,33 @@ static void publish_track_marker(const geometry_msgs::PoseStamped::ConstPtr &pos
 
 	static int marker_idx = 0;
 
-	if ( track_marker->points.size() < max_track_size )
-		track_marker->points.push_back(pose->pose.position);
-	else track_marker->points[marker_idx] = pose->pose.position;
+	auto &p = pose->pose.position;
+	double dx = p.x - last_point.x, dy = p.y - last_point.y, dz = p.z - last_point.z;
+	auto stamp = pose->header.stamp;
+	bool first = track_marker->points.empty();
+
+	// stamp going back (sim restart, bag loop) starts spacing again
+	bool time_due = stamp < last_point_stamp || stamp - last_point_stamp >= track_min_period;
+	bool moved = dx * dx + dy * dy + dz * dz >= track_min_distance * track_min_distance;
 
-	marker_idx = ++marker_idx % max_track_size;
+	if (first || (time_due && moved)) {
+		if ( track_marker->points.size() < max_track_size )
+			track_marker->points.push_back(p);
+		else track_marker->points[marker_idx] = p;
+
+		marker_idx = (marker_idx + 1) % max_track_size;
+		last_point = p;
+		last_point_stamp = stamp;
+		changed = true;
+	}
+
+	if (!changed || track_marker_pub.getNumSubscribers() == 0 ||
+			!publish_due(last_pub, ros::Time::now()))
+		return;
 
 	track_marker->header = pose->header;
 	track_marker_pub.publish(track_marker);
+	changed = false;
 }
 
 static void publish_wp_marker(const geometry_msgs::PoseStamped::ConstPtr &wp)
@@ -103,6 +148,10 @@ static void publish_wp_marker(const geometry_msgs::PoseStamped::ConstPtr &wp)
 		marker->color.b = 0.0;
 	}
 
+	static ros::Time last_pub;
+	if (wp_marker_pub.getNumSubscribers() == 0 || !publish_due(last_pub, ros::Time::now()))
+		return;
+
 	marker->pose = wp->pose;
 	wp_marker_pub.publish(marker);
 }
@@ -247,8 +296,14 @@ static void create_vehicle_markers( int num_rotors, float arm_len, float body_wi
 
 static void local_position_sub_cb(const geometry_msgs::PoseStamped::ConstPtr &pose)
 {
+	static ros::Time last_pub;
+
 	publish_track_marker(pose);
-	if (vehicle_marker) vehicle_marker_pub.publish(vehicle_marker);
+
+	// vehicle markers are in child frame, so they only need a refresh
+	if (vehicle_marker && vehicle_marker_pub.getNumSubscribers() > 0 &&
+			publish_due(last_pub, ros::Time::now()))
+		vehicle_marker_pub.publish(vehicle_marker);
 }
 
 void setpoint_local_pos_sub_cb(const geometry_msgs::PoseStamped::ConstPtr &wp)
@@ -274,6 +329,7 @@ int main(int argc, char *argv[])
 
 	int num_rotors;
 	double arm_len, body_width, body_height;
+	double track_min_period_d, marker_rate;
 
 	priv_nh.param<std::string>("fixed_frame_id", fixed_frame_id, "map");
 	priv_nh.param<std::string>("child_frame_id", child_frame_id, "base_link");
@@ -284,6 +340,13 @@ int main(int argc, char *argv[])
 	priv_nh.param("body_width", body_width, 0.15 );
 	priv_nh.param("body_height", body_height, 0.10 );
 	priv_nh.param("max_track_size", max_track_size, 1000 );
+	priv_nh.param("track_min_distance", track_min_distance, 0.05 );
+	priv_nh.param("track_min_period", track_min_period_d, 0.1 );
+	priv_nh.param("marker_rate", marker_rate, 10.0 );
+
+	max_track_size = std::max(max_track_size, 1);
+	track_min_period = ros::Duration(track_min_period_d);
+	marker_period = ros::Duration((marker_rate > 0.0) ? 1.0 / marker_rate : 0.0);
 
 	create_vehicle_markers( num_rotors, arm_len, body_width, body_height );
 
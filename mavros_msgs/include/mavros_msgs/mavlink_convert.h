@@ -14,6 +14,8 @@
 #pragma once
 
 #include <algorithm>
+#include <cstring>
+#include <vector>
 #include <mavros_msgs/msg/mavlink.hpp>
 #include <mavconn/mavlink_dialect.h>
 
@@ -37,6 +39,12 @@ using ::mavlink::mavlink_message_t;
 // ]]]
 // [[[end]]] (checksum: d41d8cd98f00b204e9800998ecf8427e)
 
+//! payload64 words holding @a len payload bytes
+inline size_t payload64_len(uint8_t len)
+{
+	return (len + 7) / 8;
+}
+
 /**
  * @brief Convert mavros_msgs/Mavlink message to mavlink_message_t
  *
@@ -71,8 +79,9 @@ inline bool convert(const mavros_msgs::msg::Mavlink &rmsg, mavlink_message_t &mm
 	mmsg.msgid = rmsg.msgid;
 	mmsg.checksum = rmsg.checksum;
 	// [[[end]]] (checksum: 2ef42a7798f261bfd367bf4157b11ec0)
-	std::copy(rmsg.payload64.begin(), rmsg.payload64.end(), _MAV_PAYLOAD_NON_CONST(&mmsg));
-	std::copy(rmsg.signature.begin(), rmsg.signature.end(), mmsg.signature);
+	std::copy(rmsg.payload64.begin(), rmsg.payload64.end(), mmsg.payload64);
+	if (!rmsg.signature.empty())
+		std::memcpy(mmsg.signature, rmsg.signature.data(), sizeof(mmsg.signature));
 
 	return true;
 }
@@ -80,6 +89,10 @@ inline bool convert(const mavros_msgs::msg::Mavlink &rmsg, mavlink_message_t &mm
 /**
  * @brief Convert mavlink_message_t to mavros/Mavlink
  *
+ * Vectors of @a rmsg are assigned, not replaced, so reused message
+ * (e.g. from MessagePool or loaned) keeps its capacity and steady stream
+ * is converted without allocation.
+ *
  * @param[in]  mmsg	mavlink_message_t struct
  * @param[out] rmsg	mavros_msgs/Mavlink message
  * @param[in]  framing_status  framing parse result (OK, BAD_CRC or BAD_SIGNATURE)
@@ -104,17 +117,37 @@ inline bool convert(const mavlink_message_t &mmsg, mavros_msgs::msg::Mavlink &rm
 	rmsg.msgid = mmsg.msgid;
 	rmsg.checksum = mmsg.checksum;
 	// [[[end]]] (checksum: 4f0a50d2fcd7eb8823aea3e0806cd698)
-	rmsg.payload64 = std::move(mavros_msgs::msg::Mavlink::_payload64_type(
-		_MAV_PAYLOAD(&mmsg), _MAV_PAYLOAD(&mmsg) + mmsg.len));
+	rmsg.payload64.assign(mmsg.payload64, mmsg.payload64 + payload64_len(mmsg.len));
 
 	// copy signature block only if message is signed
 	if (mmsg.incompat_flags & MAVLINK_IFLAG_SIGNED)
-		rmsg.signature = std::move(mavros_msgs::msg::Mavlink::_signature_type(mmsg.signature, mmsg.signature + sizeof(mmsg.signature)));
+		rmsg.signature.assign(mmsg.signature, mmsg.signature + sizeof(mmsg.signature));
 	else
 		rmsg.signature.clear();
 
 	return true;
 }
 
+/**
+ * @brief Convert batch of received frames
+ *
+ * First @a count elements of @a rmsgs are overwritten, vector only grows,
+ * so it may be kept and reused by receive path.
+ *
+ * @param[in]  mmsgs	frames
+ * @param[in]  framings	framing status of each frame (uint8_t or its enum class, e.g. mavconn::Framing)
+ * @param[out] rmsgs	converted messages, headers are not changed
+ */
+template<typename _Framing>
+inline void convert(const mavlink_message_t *mmsgs, const _Framing *framings, size_t count,
+		std::vector<mavros_msgs::msg::Mavlink> &rmsgs)
+{
+	if (rmsgs.size() < count)
+		rmsgs.resize(count);
+
+	for (size_t i = 0; i < count; i++)
+		convert(mmsgs[i], rmsgs[i], static_cast<uint8_t>(framings[i]));
+}
+
 }	// namespace mavlink
 }	// namespace mavros_msgs
@@ -20,6 +20,7 @@
 #include <rclcpp/rclcpp.hpp>
 #include <test_mavros/sitl_test/test_setup.h>
 #include <test_mavros/tests/offboard_control.h>
+#include <test_mavros/tests/performance.h>
 
 namespace sitltest {
 /**
@@ -33,6 +34,7 @@ public:
 	SitlTest();
 	~SitlTest() {};
 
-	static void spin(int argc, char *argv[]);
+	//! @return false if test failed
+	static bool spin(int argc, char *argv[]);
 };
 };	// namespace sitltest
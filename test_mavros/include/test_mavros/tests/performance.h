@@ -0,0 +1,424 @@
+/**
+ * @brief Latency and throughput test
+ * @file performance.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup sitl_test
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <cmath>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <mavconn/interface.h>
+#include <test_mavros/sitl_test/sitl_test.h>
+#include <test_mavros/utils/perf_stats.h>
+
+#include <geometry_msgs/msg/PoseStamped.hpp>
+#include <nav_msgs/Odometry.h>
+#include <sensor_msgs/msg/Imu.hpp>
+
+namespace testsetup {
+/**
+ * @brief Latency and throughput tester
+ *
+ * Runs as MAVLink proxy between mavros and FCU SITL, so it sees frames
+ * on the wire:
+ * - setpoint topic -> SET_POSITION_TARGET_LOCAL_NED sent by mavros;
+ * - HIGHRES_IMU, LOCAL_POSITION_NED, ODOMETRY from FCU -> mavros topics.
+ *
+ * Frames are matched to ROS messages by value: setpoint carries a
+ * sequence in its position, telemetry is keyed by a field which passes
+ * frame conversion unchanged. Values seen twice in flight are skipped.
+ *
+ * Setpoints are published in stages of rising rate, each stage reports
+ * delivered ratio, latency and mavros CPU/RSS. Vehicle is not armed,
+ * FCU ignores setpoints out of offboard mode.
+ *
+ * Results are written as JSON to ~results_file; gates fail the test.
+ */
+class Performance {
+public:
+	Performance() :
+		nh_sp(test.nh),
+		sp_seq(0),
+		stage_on_wire(0)
+	{ };
+
+	void init() {
+		test.setup(nh_sp);
+
+		nh_sp.param<std::string>("fcu_url", fcu_url, "udp://:14560@localhost:14565");
+		nh_sp.param<std::string>("mavros_url", mavros_url, "udp://:14601@localhost:14600");
+		nh_sp.param<std::string>("mavros_comm", mavros_comm, "mavros_node");
+		nh_sp.param<std::string>("results_file", results_file, "mavros_perf.json");
+		nh_sp.param("stage_duration", stage_duration, 10.0);
+		nh_sp.param("warmup", warmup, 5.0);
+
+		if (!nh_sp.getParam("load_rates", load_rates))
+			load_rates = {50.0, 100.0, 200.0, 400.0, 800.0};
+
+		// 0 - gate disabled
+		nh_sp.param("max_setpoint_p99_ms", max_setpoint_p99_ms, 0.0);
+		nh_sp.param("max_telemetry_p99_ms", max_telemetry_p99_ms, 0.0);
+		nh_sp.param("max_cpu_percent", max_cpu_percent, 0.0);
+		nh_sp.param("min_sustained_rate", min_sustained_rate, 0.0);
+		nh_sp.param("min_delivered", min_delivered, 0.99);
+	}
+
+	/* -*- main routine -*- */
+
+	bool spin(int argc, char *argv[]) {
+		init();
+
+		try {
+			fcu_link = mavconn::MAVConnInterface::open_url(fcu_url);
+			mavros_link = mavconn::MAVConnInterface::open_url(mavros_url);
+		}
+		catch (mavconn::DeviceError &ex) {
+			ROS_ERROR_NAMED("sitl_test", "Performance: proxy: %s", ex.what());
+			return false;
+		}
+
+		fcu_link->message_received_cb = std::bind(&Performance::fcu_frame_cb, this,
+				std::placeholders::_1, std::placeholders::_2);
+		mavros_link->message_received_cb = std::bind(&Performance::mavros_frame_cb, this,
+				std::placeholders::_1, std::placeholders::_2);
+
+		sp_pub = nh_sp.advertise<geometry_msgs::PoseStamped>("/mavros/setpoint_position/local", 100);
+		imu_sub = nh_sp.subscribe("/mavros/imu/data_raw", 100, &Performance::imu_cb, this,
+				ros::TransportHints().tcpNoDelay());
+		pose_sub = nh_sp.subscribe("/mavros/local_position/pose", 100, &Performance::pose_cb, this,
+				ros::TransportHints().tcpNoDelay());
+		odom_sub = nh_sp.subscribe("/mavros/odometry/in", 100, &Performance::odom_cb, this,
+				ros::TransportHints().tcpNoDelay());
+
+		// callbacks stamp arrival while main thread keeps the load rate
+		ros::AsyncSpinner spinner(1);
+		spinner.start();
+
+		ROS_INFO("SITL Test: Performance test running!");
+		ros::WallDuration(warmup).sleep();
+
+		if (!mavros.find(mavros_comm))
+			ROS_WARN_NAMED("sitl_test", "Performance: process '%s' not found, no CPU/RSS", mavros_comm.c_str());
+
+		for (auto rate : load_rates) {
+			if (!ros::ok())
+				break;
+
+			run_stage(rate);
+		}
+
+		spinner.stop();
+		fcu_link->close();
+		mavros_link->close();
+
+		bool passed = write_results();
+		ROS_INFO("Test complete! Results: %s, %s", results_file.c_str(), (passed) ? "passed" : "FAILED");
+		return passed;
+	}
+
+private:
+	using clock = perfstats::clock;
+	using Key = int64_t;
+
+	struct Stage {
+		double rate;
+		size_t published;
+		size_t on_wire;
+		perfstats::LatencyStat latency;
+		double cpu_percent;
+		long rss_kib;
+	};
+
+	//! FCU frames waiting for their topic message
+	struct Pending {
+		std::unordered_map<Key, clock::time_point> sent;
+		perfstats::LatencyStat latency;
+	};
+
+	static constexpr double KEY_SCALE = 1e4;	//!< value resolution of match key
+	static constexpr size_t SP_WRAP = 1000;		//!< setpoint sequences in position
+	static constexpr double SP_STEP = 1e-4;		//!< [m] setpoint sequence step
+
+	TestSetup test;
+	ros::NodeHandle nh_sp;
+	ros::Publisher sp_pub;
+	ros::Subscriber imu_sub;
+	ros::Subscriber pose_sub;
+	ros::Subscriber odom_sub;
+
+	std::string fcu_url;
+	std::string mavros_url;
+	std::string mavros_comm;
+	std::string results_file;
+	double stage_duration;
+	double warmup;
+	std::vector<double> load_rates;
+
+	double max_setpoint_p99_ms;
+	double max_telemetry_p99_ms;
+	double max_cpu_percent;
+	double min_sustained_rate;
+	double min_delivered;
+
+	mavconn::MAVConnInterface::Ptr fcu_link;
+	mavconn::MAVConnInterface::Ptr mavros_link;
+	perfstats::ProcessStat mavros;
+
+	std::mutex mutex;
+	std::unordered_map<Key, clock::time_point> sp_sent;
+	size_t sp_seq;
+	size_t stage_on_wire;
+	perfstats::LatencyStat setpoint_latency;
+	perfstats::LatencyStat *stage_latency = nullptr;
+	Pending imu, pose, odom;
+	std::vector<Stage> stages;
+
+	static inline Key key(double value) {
+		return std::llround(value * KEY_SCALE);
+	}
+
+	/**
+	 * @brief One load stage: setpoints at @a rate for stage_duration
+	 */
+	void run_stage(double rate) {
+		Stage st {};
+		st.rate = rate;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			sp_sent.clear();
+			stage_on_wire = 0;
+			stage_latency = &st.latency;
+		}
+
+		ROS_INFO("Performance: setpoints at %.0f Hz...", rate);
+		mavros.start();
+
+		geometry_msgs::PoseStamped ps;
+		ps.header.frame_id = "map";
+		ps.pose.orientation.w = 1.0;
+		ps.pose.position.z = 1.0;
+
+		// published on wall time, so slow sim clock does not change the load
+		auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / rate));
+		auto next = clock::now();
+		auto end = next + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(stage_duration));
+
+		while (ros::ok() && next < end) {
+			std::this_thread::sleep_until(next);
+			next += period;
+
+			// setpoint y_ned = x_enu carries the sequence
+			auto seq = sp_seq++ % SP_WRAP;
+			ps.header.stamp = ros::Time::now();
+			ps.pose.position.x = seq * SP_STEP;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				sp_sent[key(ps.pose.position.x)] = clock::now();
+			}
+			sp_pub.publish(ps);
+			st.published++;
+		}
+
+		// let last frames through
+		ros::WallDuration(0.5).sleep();
+
+		st.cpu_percent = (mavros.get_pid() > 0) ? mavros.cpu_percent() : -1.0;
+		st.rss_kib = (mavros.get_pid() > 0) ? mavros.rss_kib() : -1;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		st.on_wire = stage_on_wire;
+		stage_latency = nullptr;
+		stages.push_back(std::move(st));
+
+		auto &s = stages.back();
+		ROS_INFO("Performance: %.0f Hz: %zu/%zu on wire, p99 %.2f ms, CPU %.1f%%, RSS %ld KiB",
+				rate, s.on_wire, s.published, s.latency.percentile(99), s.cpu_percent, s.rss_kib);
+	}
+
+	bool write_results() {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::ofstream os(results_file);
+		bool passed = true;
+		double sustained = 0.0, sustained_p99 = 0.0, cpu_max = 0.0;
+		bool saturated = false;
+		long rss_max = 0;
+
+		os << "{\n  \"stages\": [";
+		for (size_t i = 0; i < stages.size(); i++) {
+			auto &s = stages[i];
+			double delivered = (s.published > 0) ? double(s.on_wire) / s.published : 0.0;
+
+			// stages up to first one with drops
+			saturated |= delivered < min_delivered;
+			if (!saturated) {
+				sustained = s.rate;
+				sustained_p99 = std::max(sustained_p99, s.latency.percentile(99));
+			}
+
+			cpu_max = std::max(cpu_max, s.cpu_percent);
+			rss_max = std::max(rss_max, s.rss_kib);
+
+			os << ((i > 0) ? "," : "") << "\n    {\"rate\": " << s.rate
+			   << ", \"published\": " << s.published
+			   << ", \"on_wire\": " << s.on_wire
+			   << ", \"delivered\": " << delivered
+			   << ", \"cpu_percent\": " << s.cpu_percent
+			   << ", \"rss_kib\": " << s.rss_kib
+			   << ", \"latency_ms\": ";
+			s.latency.to_json(os);
+			os << "}";
+		}
+		os << "\n  ],\n";
+
+		double telemetry_p99 = std::max({imu.latency.percentile(99),
+				pose.latency.percentile(99), odom.latency.percentile(99)});
+
+		os << "  \"setpoint_latency_ms\": ";
+		setpoint_latency.to_json(os);
+		os << ",\n  \"imu_latency_ms\": ";
+		imu.latency.to_json(os);
+		os << ",\n  \"pose_latency_ms\": ";
+		pose.latency.to_json(os);
+		os << ",\n  \"odom_latency_ms\": ";
+		odom.latency.to_json(os);
+		os << ",\n  \"sustained_rate\": " << sustained
+		   << ",\n  \"sustained_setpoint_p99_ms\": " << sustained_p99
+		   << ",\n  \"cpu_percent_max\": " << cpu_max
+		   << ",\n  \"rss_kib_max\": " << rss_max
+		   << ",\n  \"gates\": {";
+
+		bool first_gate = true;
+		auto gate = [&](const char *name, bool enabled, bool ok) {
+			if (!enabled)
+				return;
+
+			os << ((first_gate) ? "" : ", ") << "\"" << name << "\": " << ((ok) ? "true" : "false");
+			first_gate = false;
+			passed &= ok;
+			if (!ok)
+				ROS_ERROR_NAMED("sitl_test", "Performance: gate %s failed", name);
+		};
+
+		// overloaded stages are judged by sustained_rate, not latency
+		gate("setpoint_p99", max_setpoint_p99_ms > 0.0, sustained > 0.0 && sustained_p99 <= max_setpoint_p99_ms);
+		gate("telemetry_p99", max_telemetry_p99_ms > 0.0, telemetry_p99 <= max_telemetry_p99_ms);
+		gate("cpu", max_cpu_percent > 0.0, cpu_max <= max_cpu_percent);
+		gate("sustained_rate", min_sustained_rate > 0.0, sustained >= min_sustained_rate);
+
+		os << "},\n  \"passed\": " << ((passed) ? "true" : "false") << "\n}\n";
+		return passed && os.good();
+	}
+
+	/* -*- proxy -*- */
+
+	//! FCU -> mavros
+	void fcu_frame_cb(const mavlink::mavlink_message_t *msg, const mavconn::Framing framing) {
+		auto now = clock::now();
+		mavros_link->send_message_ignore_drop(msg);
+
+		mavlink::MsgMap map(msg);
+		switch (msg->msgid) {
+		case mavlink::common::msg::HIGHRES_IMU::MSG_ID: {
+			mavlink::common::msg::HIGHRES_IMU m;
+			m.deserialize(map);
+			// aircraft -> base_link keeps x
+			frame_sent(imu, key(m.xacc), now);
+			break;
+		}
+		case mavlink::common::msg::LOCAL_POSITION_NED::MSG_ID: {
+			mavlink::common::msg::LOCAL_POSITION_NED m;
+			m.deserialize(map);
+			// NED -> ENU: x_enu = y_ned
+			frame_sent(pose, key(m.y), now);
+			break;
+		}
+		case mavlink::common::msg::ODOMETRY::MSG_ID: {
+			mavlink::common::msg::ODOMETRY m;
+			m.deserialize(map);
+			frame_sent(odom, key(m.y), now);
+			break;
+		}
+		}
+	}
+
+	//! mavros -> FCU
+	void mavros_frame_cb(const mavlink::mavlink_message_t *msg, const mavconn::Framing framing) {
+		auto now = clock::now();
+		fcu_link->send_message_ignore_drop(msg);
+
+		if (msg->msgid != mavlink::common::msg::SET_POSITION_TARGET_LOCAL_NED::MSG_ID)
+			return;
+
+		mavlink::MsgMap map(msg);
+		mavlink::common::msg::SET_POSITION_TARGET_LOCAL_NED m;
+		m.deserialize(map);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = sp_sent.find(key(m.y));
+		if (it == sp_sent.end())
+			return;
+
+		auto latency = now - it->second;
+		sp_sent.erase(it);
+		stage_on_wire++;
+		setpoint_latency.add(latency);
+		if (stage_latency)
+			stage_latency->add(latency);
+	}
+
+	void frame_sent(Pending &p, Key k, clock::time_point now) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		// same value in flight can not be told apart
+		auto ret = p.sent.emplace(k, now);
+		if (!ret.second)
+			ret.first->second = clock::time_point();
+
+		// topic may be off, do not grow
+		if (p.sent.size() > 10000)
+			p.sent.clear();
+	}
+
+	void topic_received(Pending &p, Key k) {
+		auto now = clock::now();
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = p.sent.find(k);
+		if (it == p.sent.end())
+			return;
+
+		if (it->second != clock::time_point())
+			p.latency.add(now - it->second);
+
+		p.sent.erase(it);
+	}
+
+	/* -*- callbacks -*- */
+
+	void imu_cb(const sensor_msgs::Imu::ConstPtr &msg) {
+		topic_received(imu, key(float(msg->linear_acceleration.x)));
+	}
+
+	void pose_cb(const geometry_msgs::PoseStamped::ConstPtr &msg) {
+		topic_received(pose, key(float(msg->pose.position.x)));
+	}
+
+	void odom_cb(const nav_msgs::Odometry::ConstPtr &msg) {
+		topic_received(odom, key(float(msg->pose.pose.position.x)));
+	}
+};
+};	// namespace testsetup
@@ -0,0 +1,105 @@
+/**
+ * @brief Performance measurement helpers
+ * @file perf_stats.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup test_utils
+ * @{
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+namespace perfstats {
+using clock = std::chrono::steady_clock;
+
+/**
+ * @brief Latency samples and their percentiles
+ */
+class LatencyStat
+{
+public:
+	LatencyStat() :
+		sorted(true)
+	{ };
+
+	void add(clock::duration latency);
+	void clear();
+
+	inline size_t count() const {
+		return samples_ms.size();
+	}
+
+	/**
+	 * @param p  0..100
+	 * @return [ms], 0 without samples
+	 */
+	double percentile(double p);
+	double max();
+
+	//! {"count": N, "p50": .., "p90": .., "p99": .., "max": ..}
+	void to_json(std::ostream &os);
+
+private:
+	std::vector<double> samples_ms;
+	bool sorted;
+
+	void sort();
+};
+
+/**
+ * @brief CPU and memory use of other process, from /proc/<pid>
+ */
+class ProcessStat
+{
+public:
+	ProcessStat() :
+		pid(-1),
+		prev_cpu_ticks(0)
+	{ };
+
+	/**
+	 * Find process by /proc/<pid>/comm
+	 *
+	 * @return false if not running
+	 */
+	bool find(const std::string &comm);
+
+	inline pid_t get_pid() const {
+		return pid;
+	}
+
+	//! Start CPU measurement interval
+	void start();
+
+	/**
+	 * CPU used since start()
+	 *
+	 * @return [%] of one core, may be above 100 for multithreaded process
+	 */
+	double cpu_percent();
+
+	//! [KiB] resident set size, VmRSS
+	long rss_kib();
+
+private:
+	pid_t pid;
+	uint64_t prev_cpu_ticks;
+	clock::time_point prev_stamp;
+
+	uint64_t cpu_ticks();
+};
+};	// namespace perfstats
@@ -0,0 +1,154 @@
+/**
+ * @brief Performance measurement helpers
+ * @file perf_stats.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2018 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <dirent.h>
+#include <unistd.h>
+#include <test_mavros/utils/perf_stats.h>
+
+using namespace perfstats;
+
+void LatencyStat::add(clock::duration latency)
+{
+	samples_ms.push_back(std::chrono::duration<double, std::milli>(latency).count());
+	sorted = false;
+}
+
+void LatencyStat::clear()
+{
+	samples_ms.clear();
+	sorted = true;
+}
+
+void LatencyStat::sort()
+{
+	if (!sorted)
+		std::sort(samples_ms.begin(), samples_ms.end());
+
+	sorted = true;
+}
+
+double LatencyStat::percentile(double p)
+{
+	if (samples_ms.empty())
+		return 0.0;
+
+	sort();
+
+	// nearest rank
+	size_t rank = std::ceil(p / 100.0 * samples_ms.size());
+	rank = std::min(std::max<size_t>(rank, 1), samples_ms.size());
+	return samples_ms[rank - 1];
+}
+
+double LatencyStat::max()
+{
+	return percentile(100.0);
+}
+
+void LatencyStat::to_json(std::ostream &os)
+{
+	os << "{\"count\": " << count()
+	   << ", \"p50\": " << percentile(50)
+	   << ", \"p90\": " << percentile(90)
+	   << ", \"p99\": " << percentile(99)
+	   << ", \"max\": " << max()
+	   << "}";
+}
+
+bool ProcessStat::find(const std::string &comm)
+{
+	pid = -1;
+
+	auto dir = opendir("/proc");
+	if (!dir)
+		return false;
+
+	while (auto ent = readdir(dir)) {
+		char *end;
+		long p = std::strtol(ent->d_name, &end, 10);
+		if (*end != '\0' || p <= 0)
+			continue;
+
+		std::ifstream f(std::string("/proc/") + ent->d_name + "/comm");
+		std::string name;
+		if (std::getline(f, name) && name == comm.substr(0, 15)) {	// TASK_COMM_LEN
+			pid = p;
+			break;
+		}
+	}
+
+	closedir(dir);
+	return pid > 0;
+}
+
+uint64_t ProcessStat::cpu_ticks()
+{
+	std::ifstream f("/proc/" + std::to_string(pid) + "/stat");
+	std::string line;
+	if (!std::getline(f, line))
+		return 0;
+
+	// comm may contain spaces, fields are counted after ')'
+	auto pos = line.rfind(')');
+	if (pos == std::string::npos)
+		return 0;
+
+	std::istringstream ss(line.substr(pos + 2));
+	std::string field;
+	uint64_t utime = 0, stime = 0;
+	for (int i = 3; i <= 15 && ss >> field; i++) {
+		if (i == 14)
+			utime = std::stoull(field);
+		else if (i == 15)
+			stime = std::stoull(field);
+	}
+
+	return utime + stime;
+}
+
+void ProcessStat::start()
+{
+	prev_cpu_ticks = cpu_ticks();
+	prev_stamp = clock::now();
+}
+
+double ProcessStat::cpu_percent()
+{
+	auto ticks = cpu_ticks();
+	auto now = clock::now();
+	double dt = std::chrono::duration<double>(now - prev_stamp).count();
+
+	if (dt <= 0.0 || ticks < prev_cpu_ticks)
+		return 0.0;
+
+	return (ticks - prev_cpu_ticks) / double(sysconf(_SC_CLK_TCK)) / dt * 100.0;
+}
+
+long ProcessStat::rss_kib()
+{
+	std::ifstream f("/proc/" + std::to_string(pid) + "/status");
+	std::string line;
+
+	while (std::getline(f, line)) {
+		if (line.compare(0, 6, "VmRSS:") == 0)
+			return std::strtol(line.c_str() + 6, nullptr, 10);
+	}
+
+	return -1;
+}
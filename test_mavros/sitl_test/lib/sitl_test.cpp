@@ -20,7 +20,7 @@ using namespace testsetup;
 SitlTest::SitlTest()
 {}
 
-void SitlTest::spin(int argc, char *argv[])
+bool SitlTest::spin(int argc, char *argv[])
 {
 	if (strcmp(argv[1],"offboard_control") == 0)
 	{
@@ -28,6 +28,13 @@ void SitlTest::spin(int argc, char *argv[])
 		testsetup::OffboardControl offboard_control;
 		offboard_control.spin(argc, argv);
 	}
+	else if (strcmp(argv[1],"performance") == 0)
+	{
+		ros::init(argc, argv, "performance");
+		testsetup::Performance performance;
+		return performance.spin(argc, argv);
+	}
 
 	/** @todo add more testing structures */
+	return true;
 }
@@ -19,7 +19,5 @@ int main(int argc, char *argv[])
 {
 	ROS_INFO("SITL Test node started...");
 
-	SitlTest::spin(argc, argv);
-
-	return 0;
+	return (SitlTest::spin(argc, argv)) ? 0 : 1;
 }